@@ -0,0 +1,371 @@
+/*
+ * Copyright (c) 2023, Cisco Systems, Inc.
+ *
+ * Licensed under the Apache License 2.0 (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://github.com/cisco/libamvp/LICENSE
+ */
+
+/*
+ * --batch: runs many saved request files through amvp_run_vectors_from_file()
+ * at once. The files are the *.json files of a directory, or those listed
+ * one per line in a manifest. Each file gets its own clone of the context
+ * the capabilities were registered on, and a number of threads, one per
+ * core unless --jobs says otherwise, take the files in turn. The response
+ * for <file> is saved as <file>.rsp, so it isn't picked up by a later
+ * batch over the same directory.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <dirent.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+#include "app_lcl.h"
+#include "safe_lib.h"
+
+#define APP_BATCH_EXT ".json"
+#define APP_BATCH_RSP_EXT ".rsp"
+
+typedef struct app_batch_file_t {
+    char req[JSON_FILENAME_LENGTH + 1];
+    char rsp[JSON_FILENAME_LENGTH + sizeof(APP_BATCH_RSP_EXT)]; /* room for req and the extension */
+    AMVP_RESULT rv;
+    double secs;
+} APP_BATCH_FILE;
+
+typedef struct app_batch_t {
+    AMVP_CTX *ctx;              /* Has the capabilities, cloned for each file */
+    APP_BATCH_FILE *files;
+    int count;
+    int alloc;
+    int next;                   /* Next file to be taken */
+#ifndef _WIN32
+    pthread_mutex_t lock;
+#endif
+} APP_BATCH;
+
+static double app_batch_now(void) {
+#ifdef _WIN32
+    return (double)GetTickCount64() / 1000.0;
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+#endif
+}
+
+static int app_batch_cores(void) {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+
+    GetSystemInfo(&info);
+    return (int)info.dwNumberOfProcessors;
+#else
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+
+    return n > 0 ? (int)n : 1;
+#endif
+}
+
+static int app_batch_add(APP_BATCH *batch, const char *dir, const char *name) {
+    APP_BATCH_FILE *files = NULL, *file = NULL;
+    int len, alloc;
+
+    if (batch->count == batch->alloc) {
+        alloc = batch->alloc ? batch->alloc * 2 : 64;
+        files = realloc(batch->files, alloc * sizeof(APP_BATCH_FILE));
+        if (!files) {
+            printf("Failed to malloc\n");
+            return 1;
+        }
+        batch->files = files;
+        batch->alloc = alloc;
+    }
+    file = &batch->files[batch->count];
+    memset_s(file, sizeof(APP_BATCH_FILE), 0, sizeof(APP_BATCH_FILE));
+    if (dir) {
+        len = snprintf(file->req, sizeof(file->req), "%s/%s", dir, name);
+    } else {
+        len = snprintf(file->req, sizeof(file->req), "%s", name);
+    }
+    if (len < 0 || len > JSON_FILENAME_LENGTH ||
+            len + (int)sizeof(APP_BATCH_RSP_EXT) - 1 > JSON_FILENAME_LENGTH) {
+        printf("Request file name %s is too long (max %d)\n", name, JSON_FILENAME_LENGTH);
+        return 1;
+    }
+    len = snprintf(file->rsp, sizeof(file->rsp), "%s%s", file->req, APP_BATCH_RSP_EXT);
+    if (len < 0 || len >= (int)sizeof(file->rsp)) {
+        printf("Response file name for %s is too long\n", file->req);
+        return 1;
+    }
+    batch->count++;
+    return 0;
+}
+
+/* Whether name ends in .json */
+static int app_batch_is_req(const char *name) {
+    size_t len = strnlen_s(name, JSON_FILENAME_LENGTH + 1);
+    size_t ext = sizeof(APP_BATCH_EXT) - 1;
+    int diff = 1;
+
+    if (len <= ext) {
+        return 0;
+    }
+    strcmp_s(name + len - ext, ext + 1, APP_BATCH_EXT, &diff);
+    return !diff;
+}
+
+static int app_batch_read_dir(APP_BATCH *batch, const char *dir) {
+#ifdef _WIN32
+    WIN32_FIND_DATAA data;
+    HANDLE h = INVALID_HANDLE_VALUE;
+    char pattern[JSON_FILENAME_LENGTH + 8];
+
+    snprintf(pattern, sizeof(pattern), "%s\\*%s", dir, APP_BATCH_EXT);
+    h = FindFirstFileA(pattern, &data);
+    if (h == INVALID_HANDLE_VALUE) {
+        return 0;
+    }
+    do {
+        if (!(data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) && app_batch_is_req(data.cFileName)) {
+            if (app_batch_add(batch, dir, data.cFileName)) {
+                FindClose(h);
+                return 1;
+            }
+        }
+    } while (FindNextFileA(h, &data));
+    FindClose(h);
+    return 0;
+#else
+    DIR *d = opendir(dir);
+    struct dirent *ent = NULL;
+
+    if (!d) {
+        printf("Unable to open directory %s\n", dir);
+        return 1;
+    }
+    while ((ent = readdir(d))) {
+        if (ent->d_name[0] != '.' && app_batch_is_req(ent->d_name)) {
+            if (app_batch_add(batch, dir, ent->d_name)) {
+                closedir(d);
+                return 1;
+            }
+        }
+    }
+    closedir(d);
+    return 0;
+#endif
+}
+
+/* One request file per line; blank lines and lines starting with # are skipped */
+static int app_batch_read_manifest(APP_BATCH *batch, const char *manifest) {
+    FILE *fp = fopen(manifest, "r");
+    char line[JSON_FILENAME_LENGTH + 2];
+    size_t len;
+    int rc = 0;
+
+    if (!fp) {
+        printf("Unable to open manifest %s\n", manifest);
+        return 1;
+    }
+    while (fgets(line, sizeof(line), fp)) {
+        len = strnlen_s(line, sizeof(line));
+        if (len && line[len - 1] != '\n' && !feof(fp)) {
+            printf("Line of manifest %s is too long (max %d)\n", manifest, JSON_FILENAME_LENGTH);
+            rc = 1;
+            break;
+        }
+        while (len && (line[len - 1] == '\n' || line[len - 1] == '\r' || line[len - 1] == ' ')) {
+            line[--len] = '\0';
+        }
+        if (!len || line[0] == '#') {
+            continue;
+        }
+        if (app_batch_add(batch, NULL, line)) {
+            rc = 1;
+            break;
+        }
+    }
+    fclose(fp);
+    return rc;
+}
+
+static int app_batch_cmp(const void *a, const void *b) {
+    int diff = 0;
+
+    strcmp_s(((const APP_BATCH_FILE *)a)->req, JSON_FILENAME_LENGTH + 1,
+             ((const APP_BATCH_FILE *)b)->req, &diff);
+    return diff;
+}
+
+static void app_batch_lock(APP_BATCH *batch) {
+#ifndef _WIN32
+    pthread_mutex_lock(&batch->lock);
+#else
+    (void)batch;
+#endif
+}
+
+static void app_batch_unlock(APP_BATCH *batch) {
+#ifndef _WIN32
+    pthread_mutex_unlock(&batch->lock);
+#else
+    (void)batch;
+#endif
+}
+
+static void app_batch_run_file(APP_BATCH *batch, APP_BATCH_FILE *file) {
+    AMVP_CTX *clone = NULL;
+    double start = app_batch_now();
+
+    /* Contexts are created and freed one at a time */
+    app_batch_lock(batch);
+    file->rv = amvp_ctx_clone(batch->ctx, &clone);
+    app_batch_unlock(batch);
+    if (file->rv == AMVP_SUCCESS) {
+        file->rv = amvp_run_vectors_from_file(clone, file->req, file->rsp);
+    }
+    app_batch_lock(batch);
+    amvp_free_test_session(clone);
+    app_batch_unlock(batch);
+    file->secs = app_batch_now() - start;
+}
+
+static void *app_batch_main(void *arg) {
+    APP_BATCH *batch = arg;
+    APP_BATCH_FILE *file = NULL;
+
+    while (1) {
+        app_batch_lock(batch);
+        file = batch->next < batch->count ? &batch->files[batch->next++] : NULL;
+        app_batch_unlock(batch);
+        if (!file) {
+            break;
+        }
+        app_batch_run_file(batch, file);
+    }
+    return NULL;
+}
+
+static void app_batch_summary(FILE *fp, APP_BATCH *batch, int jobs, double secs) {
+    int i, failed = 0;
+
+    for (i = 0; i < batch->count; i++) {
+        if (batch->files[i].rv != AMVP_SUCCESS) {
+            failed++;
+        }
+    }
+    fprintf(fp, "Batch of %d request files on %d threads: %d passed, %d failed, %.3fs\n",
+            batch->count, jobs, batch->count - failed, failed, secs);
+    for (i = 0; i < batch->count; i++) {
+        fprintf(fp, "  %9.3fs  %-6s  %s", batch->files[i].secs,
+                batch->files[i].rv == AMVP_SUCCESS ? "ok" : "FAILED", batch->files[i].req);
+        if (batch->files[i].rv != AMVP_SUCCESS) {
+            fprintf(fp, " (%s)", amvp_lookup_error_string(batch->files[i].rv));
+        }
+        fprintf(fp, "\n");
+    }
+}
+
+/*
+ * Runs every request file of path, a directory or a manifest, on up to jobs
+ * threads (0 for one per core). The summary is printed, and also saved to
+ * summary_file if given. Returns AMVP_SUCCESS only if every file passed.
+ */
+AMVP_RESULT app_run_batch(AMVP_CTX *ctx, const char *path, int jobs, const char *summary_file) {
+    APP_BATCH batch;
+    struct stat st;
+    AMVP_RESULT rv = AMVP_SUCCESS;
+    FILE *fp = NULL;
+    double start = 0, secs = 0;
+    int i;
+#ifndef _WIN32
+    pthread_t *tids = NULL;
+    int started = 0;
+#endif
+
+    memset_s(&batch, sizeof(batch), 0, sizeof(batch));
+    batch.ctx = ctx;
+    if (stat(path, &st)) {
+        printf("Unable to find %s\n", path);
+        return AMVP_INVALID_ARG;
+    }
+    if ((st.st_mode & S_IFMT) == S_IFDIR) {
+        if (app_batch_read_dir(&batch, path)) {
+            rv = AMVP_INVALID_ARG;
+            goto end;
+        }
+    } else if (app_batch_read_manifest(&batch, path)) {
+        rv = AMVP_INVALID_ARG;
+        goto end;
+    }
+    if (!batch.count) {
+        printf("No request files found in %s\n", path);
+        rv = AMVP_NO_DATA;
+        goto end;
+    }
+    qsort(batch.files, batch.count, sizeof(APP_BATCH_FILE), app_batch_cmp);
+
+    if (jobs <= 0) {
+        jobs = app_batch_cores();
+    }
+    if (jobs > batch.count) {
+        jobs = batch.count;
+    }
+
+    start = app_batch_now();
+#ifndef _WIN32
+    pthread_mutex_init(&batch.lock, NULL);
+    tids = calloc(jobs, sizeof(pthread_t));
+    /* The calling thread is one of the jobs */
+    for (i = 0; tids && i < jobs - 1; i++) {
+        if (pthread_create(&tids[i], NULL, app_batch_main, &batch)) {
+            break;
+        }
+        started++;
+    }
+    app_batch_main(&batch);
+    for (i = 0; i < started; i++) {
+        pthread_join(tids[i], NULL);
+    }
+    if (tids) free(tids);
+    pthread_mutex_destroy(&batch.lock);
+    jobs = started + 1;
+#else
+    app_batch_main(&batch);
+    jobs = 1;
+#endif
+
+    secs = app_batch_now() - start;
+    app_batch_summary(stdout, &batch, jobs, secs);
+    if (summary_file) {
+        fp = fopen(summary_file, "w");
+        if (!fp) {
+            printf("Unable to save the summary to %s\n", summary_file);
+        } else {
+            app_batch_summary(fp, &batch, jobs, secs);
+            fclose(fp);
+        }
+    }
+    for (i = 0; i < batch.count; i++) {
+        if (batch.files[i].rv != AMVP_SUCCESS) {
+            rv = batch.files[i].rv;
+            break;
+        }
+    }
+
+end:
+    if (batch.files) free(batch.files);
+    return rv;
+}
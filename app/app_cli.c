@@ -160,6 +160,57 @@ static void print_usage(int code) {
     printf("To post all resources a predefined resource json file:\n");
     printf("      --post_resources <resource_file>\n");
     printf("\n");
+    printf("To overlap vector set downloads and uploads with up to <n> concurrent transfers:\n");
+    printf("      --transfers <n>\n");
+    printf("\n");
+    printf("To run the crypto on a separate thread, downloading up to <n> vector sets ahead:\n");
+    printf("      --pipeline <n>\n");
+    printf("\n");
+    printf("To start the vector sets estimated to take longest first when using the above:\n");
+    printf("      --slowest_first\n");
+    printf("\n");
+    printf("To keep a binary cache next to the file saved by --vector_req, used instead of\n");
+    printf("parsing it again when running it with --vector_req and --vector_rsp:\n");
+    printf("      --vs_cache\n");
+    printf("\n");
+    printf("To negotiate HTTP/2 and TLS 1.3, multiplexing transfers over one connection:\n");
+    printf("      --http2\n");
+    printf("\n");
+    printf("To write log messages from a background thread instead of the one doing the work:\n");
+    printf("      --async_log\n");
+    printf("\n");
+    printf("To save per vector set timings and counters to a file at the end of the run:\n");
+    printf("      --metrics <file>\n");
+    printf("\n");
+    printf("To keep the server pages that validation metadata was matched on, and reuse\n");
+    printf("them while the server reports them unchanged:\n");
+    printf("      --metadata_cache <file>\n");
+    printf("\n");
+    printf("To journal the progress of each vector set next to the session file, so a\n");
+    printf("resumed session picks up where it stopped:\n");
+    printf("      --checkpoint\n");
+    printf("\n");
+    printf("To reuse the results of test cases already computed by this build of the\n");
+    printf("module, instead of computing them again:\n");
+    printf("      --crypto_cache <file>\n");
+    printf("\n");
+    printf("To split the file saved by --vector_req into <n> files, <file>.0 to <file>.<n-1>,\n");
+    printf("that can be processed separately with --vector_req and --vector_rsp:\n");
+    printf("      --shard <n>\n");
+    printf("To merge the <n> response files of those, <file>.0 to <file>.<n-1>, into the\n");
+    printf("--vector_rsp file for --vector_upload:\n");
+    printf("      --merge <n>\n");
+    printf("\n");
+    printf("To check the --vector_rsp file against the expected results saved with\n");
+    printf("--get_expected_results, without uploading it:\n");
+    printf("      --verify <expected_results_file>\n");
+    printf("\n");
+    printf("To run every request file in a directory, or listed one per line in a manifest,\n");
+    printf("saving the responses as <request_file>.rsp and a summary to --save_to if given:\n");
+    printf("      --batch <directory|manifest>\n");
+    printf("To run <n> of those at a time instead of one per core:\n");
+    printf("      --jobs <n>\n");
+    printf("\n");
 #if OPENSSL_VERSION_NUMBER >= 0x30000000L
     printf("To disable FIPS mode for this run (Note, a warning will be issued):\n");
     printf("      -disable_fips\n");
@@ -262,6 +313,21 @@ static ko_longopt_t longopts[] = {
     { "get_registration", ko_no_argument, 418 },
     { "module_cert_req", ko_required_argument, 419 },
     { "post_resources", ko_required_argument, 420 },
+    { "transfers", ko_required_argument, 421 },
+    { "pipeline", ko_required_argument, 422 },
+    { "http2", ko_no_argument, 423 },
+    { "async_log", ko_no_argument, 424 },
+    { "metrics", ko_required_argument, 425 },
+    { "metadata_cache", ko_required_argument, 426 },
+    { "checkpoint", ko_no_argument, 427 },
+    { "crypto_cache", ko_required_argument, 428 },
+    { "shard", ko_required_argument, 429 },
+    { "merge", ko_required_argument, 430 },
+    { "verify", ko_required_argument, 431 },
+    { "batch", ko_required_argument, 432 },
+    { "jobs", ko_required_argument, 433 },
+    { "slowest_first", ko_no_argument, 434 },
+    { "vs_cache", ko_no_argument, 435 },
 #if OPENSSL_VERSION_NUMBER >= 0x30000000L
     { "disable_fips", ko_no_argument, 500 },
 #endif
@@ -608,6 +674,110 @@ int ingest_cli(APP_CONFIG *cfg, int argc, char **argv) {
             strcpy_s(cfg->post_resources_filename, JSON_FILENAME_LENGTH + 1, opt.arg);
             break;
 
+        case 421:
+            cfg->max_transfers = atoi(opt.arg);
+            if (cfg->max_transfers < 1 || cfg->max_transfers > AMVP_MAX_CONCURRENT_TRANSFERS) {
+                printf(ANSI_COLOR_RED "Option --%s must be between 1 and %d\n"ANSI_COLOR_RESET,
+                       lookup_arg_name(c), AMVP_MAX_CONCURRENT_TRANSFERS);
+                return 1;
+            }
+            break;
+
+        case 422:
+            cfg->pipeline_depth = atoi(opt.arg);
+            if (cfg->pipeline_depth < 1 || cfg->pipeline_depth > AMVP_MAX_PIPELINE_DEPTH) {
+                printf(ANSI_COLOR_RED "Option --%s must be between 1 and %d\n"ANSI_COLOR_RESET,
+                       lookup_arg_name(c), AMVP_MAX_PIPELINE_DEPTH);
+                return 1;
+            }
+            break;
+
+        case 423:
+            cfg->http2 = 1;
+            break;
+
+        case 424:
+            cfg->async_log = 1;
+            break;
+
+        case 425:
+            cfg->metrics = 1;
+            if (!check_option_length(opt.arg, c, JSON_FILENAME_LENGTH)) {
+                return 1;
+            }
+            strcpy_s(cfg->metrics_filename, JSON_FILENAME_LENGTH + 1, opt.arg);
+            break;
+
+        case 426:
+            cfg->metadata_cache = 1;
+            if (!check_option_length(opt.arg, c, JSON_FILENAME_LENGTH)) {
+                return 1;
+            }
+            strcpy_s(cfg->metadata_cache_file, JSON_FILENAME_LENGTH + 1, opt.arg);
+            break;
+
+        case 427:
+            cfg->checkpoint = 1;
+            break;
+
+        case 428:
+            cfg->crypto_cache = 1;
+            if (!check_option_length(opt.arg, c, JSON_FILENAME_LENGTH)) {
+                return 1;
+            }
+            strcpy_s(cfg->crypto_cache_file, JSON_FILENAME_LENGTH + 1, opt.arg);
+            break;
+
+        case 429:
+            cfg->shard = atoi(opt.arg);
+            if (cfg->shard < 1 || cfg->shard > APP_MAX_SHARDS) {
+                printf(ANSI_COLOR_RED "Option --%s must be between 1 and %d\n"ANSI_COLOR_RESET,
+                       lookup_arg_name(c), APP_MAX_SHARDS);
+                return 1;
+            }
+            break;
+
+        case 430:
+            cfg->merge = atoi(opt.arg);
+            if (cfg->merge < 1 || cfg->merge > APP_MAX_SHARDS) {
+                printf(ANSI_COLOR_RED "Option --%s must be between 1 and %d\n"ANSI_COLOR_RESET,
+                       lookup_arg_name(c), APP_MAX_SHARDS);
+                return 1;
+            }
+            break;
+
+        case 431:
+            cfg->verify = 1;
+            if (!check_option_length(opt.arg, c, JSON_FILENAME_LENGTH)) {
+                return 1;
+            }
+            strcpy_s(cfg->verify_file, JSON_FILENAME_LENGTH + 1, opt.arg);
+            break;
+
+        case 432:
+            cfg->batch = 1;
+            if (!check_option_length(opt.arg, c, JSON_FILENAME_LENGTH)) {
+                return 1;
+            }
+            strcpy_s(cfg->batch_path, JSON_FILENAME_LENGTH + 1, opt.arg);
+            break;
+
+        case 433:
+            cfg->jobs = atoi(opt.arg);
+            if (cfg->jobs < 1) {
+                printf(ANSI_COLOR_RED "Option --%s must be at least 1\n"ANSI_COLOR_RESET, lookup_arg_name(c));
+                return 1;
+            }
+            break;
+
+        case 434:
+            cfg->slowest_first = 1;
+            break;
+
+        case 435:
+            cfg->vs_cache = 1;
+            break;
+
 #if OPENSSL_VERSION_NUMBER >= 0x30000000L
         case 500:
             cfg->disable_fips = 1;
@@ -638,10 +808,31 @@ int ingest_cli(APP_CONFIG *cfg, int argc, char **argv) {
         return 1;
     }
 
+    if (cfg->shard && (!cfg->vector_req || cfg->vector_rsp || cfg->merge)) {
+        printf(ANSI_COLOR_RED "Option --shard requires --vector_req, and no --vector_rsp\n"ANSI_COLOR_RESET);
+        return 1;
+    }
+    if (cfg->merge && (!cfg->vector_rsp || cfg->vector_req)) {
+        printf(ANSI_COLOR_RED "Option --merge requires --vector_rsp, and no --vector_req\n"ANSI_COLOR_RESET);
+        return 1;
+    }
+    if (cfg->verify && (!cfg->vector_rsp || cfg->vector_req || cfg->merge)) {
+        printf(ANSI_COLOR_RED "Option --verify requires --vector_rsp, and no --vector_req\n"ANSI_COLOR_RESET);
+        return 1;
+    }
+    if (cfg->batch && (cfg->vector_req || cfg->vector_rsp)) {
+        printf(ANSI_COLOR_RED "Option --batch can't be used with --vector_req or --vector_rsp\n"ANSI_COLOR_RESET);
+        return 1;
+    }
+    if (cfg->jobs && !cfg->batch) {
+        printf(ANSI_COLOR_RED "Option --jobs requires --batch\n"ANSI_COLOR_RESET);
+        return 1;
+    }
+
     //Many args do not need an alg specified. Todo: make cleaner
     if (cfg->empty_alg && !cfg->post && !cfg->get && !cfg->put && !cfg->get_results && !cfg->post_resources
             && !cfg->get_expected && !cfg->manual_reg && !cfg->vector_upload && !cfg->mod_cert_req
-            && !cfg->delete && !cfg->cancel_session && !(cfg->resume_session && 
+            && !cfg->delete && !cfg->cancel_session && !cfg->shard && !cfg->merge && !cfg->verify && !(cfg->resume_session && 
             cfg->vector_req)) {
         /* The user needs to select at least 1 algorithm */
         printf(ANSI_COLOR_RED "Requires at least 1 Algorithm Test Suite\n"ANSI_COLOR_RESET);
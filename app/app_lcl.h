@@ -26,6 +26,8 @@ extern "C"
 #define JSON_STRING_LENGTH 32
 #define JSON_REQUEST_LENGTH 128
 #define ALG_STR_MAX_LEN 256 /* arbitrary */
+#define APP_LOG_SLOTS 1024 /* messages --async_log can queue */
+#define APP_MAX_SHARDS 256 /* files --shard and --merge can take */
 extern char value[JSON_STRING_LENGTH];
 
 #define ANSI_COLOR_RED "\x1b[31m"
@@ -53,6 +55,12 @@ typedef struct app_config {
     int save_to;
     int get_cost;
     int get_reg;
+    int max_transfers;
+    int pipeline_depth;
+    int slowest_first;
+    int vs_cache;
+    int http2;
+    int async_log;
 #if OPENSSL_VERSION_NUMBER >= 0x30000000L
     int disable_fips;
 #endif
@@ -70,6 +78,20 @@ typedef struct app_config {
     char save_file[JSON_FILENAME_LENGTH + 1];
     char mod_cert_req_file[JSON_FILENAME_LENGTH + 1];
     char post_resources_filename[JSON_FILENAME_LENGTH + 1];
+    int metrics;
+    char metrics_filename[JSON_FILENAME_LENGTH + 1];
+    int metadata_cache;
+    char metadata_cache_file[JSON_FILENAME_LENGTH + 1];
+    int checkpoint;
+    int crypto_cache;
+    char crypto_cache_file[JSON_FILENAME_LENGTH + 1];
+    int shard;
+    int merge;
+    int verify;
+    char verify_file[JSON_FILENAME_LENGTH + 1];
+    int batch;
+    char batch_path[JSON_FILENAME_LENGTH + 1];
+    int jobs;
 
     /*
      * Algorithm Flags
@@ -100,6 +122,11 @@ const char *get_md_string_for_hash_alg(AMVP_HASH_ALG alg, int *md_size);
 char *ec_point_to_pub_key(unsigned char *x, int x_len, unsigned char *y, int y_len, int *key_len);
 
 int app_sha_handler(AMVP_TEST_CASE *test_case);
+int app_sha_batch_handler(AMVP_TEST_CASE *test_cases, int count);
+int app_sha_mct_handler(AMVP_TEST_CASE *test_case);
+void app_sha_cleanup(void);
+
+AMVP_RESULT app_run_batch(AMVP_CTX *ctx, const char *path, int jobs, const char *summary_file);
 
 #if OPENSSL_VERSION_NUMBER >= 0x30000000L
 AMVP_RESULT fips_sanity_check(void);
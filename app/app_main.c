@@ -34,6 +34,7 @@
 #include "safe_str_lib.h"
 
 static int enable_hash(AMVP_CTX *ctx);
+static void print_workload_estimate(AMVP_CTX *ctx);
 
 const char *server;
 int port;
@@ -116,6 +117,49 @@ static AMVP_RESULT progress(char *msg, AMVP_LOG_LVL level) {
 static void app_cleanup(AMVP_CTX *ctx) {
     // Routines for libamvp
     amvp_cleanup(ctx);
+    app_sha_cleanup();
+}
+
+/*
+ * Splits filename into <filename>.0 to <filename>.<count - 1> for --shard,
+ * or merges those back into filename for --merge.
+ */
+static AMVP_RESULT app_shard_files(AMVP_CTX *ctx, const char *filename, int count, int merge) {
+    AMVP_RESULT rv = AMVP_MALLOC_FAIL;
+    char (*names)[JSON_FILENAME_LENGTH + 1] = NULL;
+    const char **ptrs = NULL;
+    int i, len;
+
+    names = calloc(count, sizeof(*names));
+    ptrs = calloc(count, sizeof(*ptrs));
+    if (!names || !ptrs) {
+        printf("Failed to malloc\n");
+        goto end;
+    }
+    for (i = 0; i < count; i++) {
+        len = snprintf(names[i], JSON_FILENAME_LENGTH + 1, "%s.%d", filename, i);
+        if (len < 0 || len > JSON_FILENAME_LENGTH) {
+            printf("Shard file name for %s is too long\n", filename);
+            rv = AMVP_INVALID_ARG;
+            goto end;
+        }
+        ptrs[i] = names[i];
+    }
+
+    if (merge) {
+        rv = amvp_merge_response_files(ctx, ptrs, count, filename);
+    } else {
+        rv = amvp_shard_request_file(ctx, filename, ptrs, count);
+    }
+    if (rv != AMVP_SUCCESS) {
+        printf("Failed to %s %s (rv=%d: %s)\n", merge ? "merge" : "shard", filename, rv,
+               amvp_lookup_error_string(rv));
+    }
+
+end:
+    if (names) free(names);
+    if (ptrs) free(ptrs);
+    return rv;
 }
 
 
@@ -230,6 +274,104 @@ int main(int argc, char **argv) {
         amvp_mark_as_sample(ctx);
     }
 
+    if (cfg.max_transfers) {
+        rv = amvp_set_max_concurrent_transfers(ctx, cfg.max_transfers);
+        if (rv != AMVP_SUCCESS) {
+            printf("Failed to set concurrent transfers.\n");
+            goto end;
+        }
+    }
+
+    if (cfg.pipeline_depth) {
+        rv = amvp_set_pipeline_depth(ctx, cfg.pipeline_depth);
+        if (rv != AMVP_SUCCESS) {
+            printf("Failed to set pipeline depth.\n");
+            goto end;
+        }
+    }
+
+    if (cfg.slowest_first) {
+        rv = amvp_set_vs_schedule(ctx, AMVP_VS_SCHEDULE_COSTLIEST_FIRST);
+        if (rv != AMVP_SUCCESS) {
+            printf("Failed to set vector set schedule.\n");
+            goto end;
+        }
+    }
+
+    if (cfg.vs_cache) {
+        rv = amvp_set_vs_cache(ctx, 1);
+        if (rv != AMVP_SUCCESS) {
+            printf("Failed to enable the vector set cache.\n");
+            goto end;
+        }
+    }
+
+    if (cfg.http2) {
+        rv = amvp_set_http2(ctx, 1);
+        if (rv != AMVP_SUCCESS) {
+            printf("Failed to enable HTTP/2.\n");
+            goto end;
+        }
+    }
+
+    if (cfg.async_log) {
+        rv = amvp_set_async_logging(ctx, APP_LOG_SLOTS, NULL);
+        if (rv != AMVP_SUCCESS) {
+            printf("Failed to enable asynchronous logging.\n");
+            goto end;
+        }
+    }
+
+    if (cfg.metrics) {
+        rv = amvp_set_metrics(ctx, 1, cfg.metrics_filename);
+        if (rv != AMVP_SUCCESS) {
+            printf("Failed to enable metrics.\n");
+            goto end;
+        }
+    }
+
+    if (cfg.metadata_cache) {
+        rv = amvp_set_metadata_cache(ctx, cfg.metadata_cache_file);
+        if (rv != AMVP_SUCCESS) {
+            printf("Failed to enable the metadata cache.\n");
+            goto end;
+        }
+    }
+
+    if (cfg.checkpoint) {
+        rv = amvp_set_resume_checkpoints(ctx, 1);
+        if (rv != AMVP_SUCCESS) {
+            printf("Failed to enable resume checkpoints.\n");
+            goto end;
+        }
+    }
+
+    if (cfg.crypto_cache) {
+        rv = amvp_set_crypto_cache(ctx, 1, cfg.crypto_cache_file);
+        if (rv != AMVP_SUCCESS) {
+            printf("Failed to enable the crypto cache.\n");
+            goto end;
+        }
+    }
+
+    if (cfg.shard) {
+        rv = app_shard_files(ctx, cfg.vector_req_file, cfg.shard, 0);
+        goto end;
+    }
+
+    if (cfg.merge) {
+        rv = app_shard_files(ctx, cfg.vector_rsp_file, cfg.merge, 1);
+        goto end;
+    }
+
+    if (cfg.verify) {
+        rv = amvp_verify_expected_results(ctx, cfg.vector_rsp_file, cfg.verify_file, &diff);
+        if (rv == AMVP_SUCCESS && diff) {
+            rv = AMVP_TC_INVALID_DATA;
+        }
+        goto end;
+    }
+
     if (cfg.get) {
         rv = amvp_mark_as_get_only(ctx, cfg.get_string);
         if (rv != AMVP_SUCCESS) {
@@ -282,6 +424,7 @@ int main(int argc, char **argv) {
         } else {
             printf("The given test session context is expected to generate %d vector sets.\n\n", diff);
         }
+        print_workload_estimate(ctx);
         goto end;
     }
 
@@ -316,6 +459,11 @@ int main(int argc, char **argv) {
        goto end;
     }
 
+    if (cfg.batch) {
+        rv = app_run_batch(ctx, cfg.batch_path, cfg.jobs, cfg.save_to ? cfg.save_file : NULL);
+        goto end;
+    }
+
     strncmp_s(DEFAULT_SERVER, DEFAULT_SERVER_LEN, server, DEFAULT_SERVER_LEN, &diff);
     if (!diff) {
          printf("Warning: No server set, using default. Please define AMV_SERVER in your environment.\n");
@@ -410,11 +558,34 @@ end:
     return rv;
 }
 
+static void print_workload_estimate(AMVP_CTX *ctx) {
+    AMVP_WORKLOAD_ESTIMATE total, est;
+    int i;
+
+    if (amvp_estimate_workload(ctx, &total) != AMVP_SUCCESS) {
+        printf("Unable to estimate the workload of the given test session context.\n\n");
+        return;
+    }
+    printf("%-32s %10s %14s %12s %12s %10s\n", "Algorithm", "Tests", "Crypto ops",
+           "Download KB", "Upload KB", "CPU secs");
+    for (i = 0; amvp_get_workload_estimate(ctx, i, &est) == AMVP_SUCCESS; i++) {
+        printf("%-32s %10llu %14llu %12llu %12llu %10.1f\n", est.algorithm, est.test_cases,
+               est.crypto_ops, est.request_bytes / 1024, est.response_bytes / 1024, est.cpu_secs);
+    }
+    printf("%-32s %10llu %14llu %12llu %12llu %10.1f\n\n", "Total", total.test_cases,
+           total.crypto_ops, total.request_bytes / 1024, total.response_bytes / 1024, total.cpu_secs);
+}
+
 static int enable_hash(AMVP_CTX *ctx) {
     AMVP_RESULT rv = AMVP_SUCCESS;
 
     rv = amvp_cap_hash_enable(ctx, AMVP_HASH_SHA256, &app_sha_handler);
     CHECK_ENABLE_CAP_RV(rv);
+    /* Whole groups and whole MCT outer iterations per call, rather than one hash each */
+    rv = amvp_cap_set_batch_handler(ctx, AMVP_HASH_SHA256, &app_sha_batch_handler);
+    CHECK_ENABLE_CAP_RV(rv);
+    rv = amvp_cap_set_mct_handler(ctx, AMVP_HASH_SHA256, &app_sha_mct_handler);
+    CHECK_ENABLE_CAP_RV(rv);
     rv = amvp_cap_hash_set_domain(ctx, AMVP_HASH_SHA256, AMVP_HASH_MESSAGE_LEN,
                                   0, 65536, 8);
     CHECK_ENABLE_CAP_RV(rv);
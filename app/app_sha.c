@@ -9,33 +9,148 @@
 
 
 #include <openssl/evp.h>
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <pthread.h>
+#endif
 
 #include "amvp/amvp.h"
 #include "app_lcl.h"
+#include "safe_lib.h"
 #ifdef AMVP_NO_RUNTIME
 # include "app_fips_lcl.h"
 #endif
 
-int app_sha_handler(AMVP_TEST_CASE *test_case) {
-    AMVP_HASH_TC    *tc;
-    const EVP_MD    *md;
-    EVP_MD_CTX *md_ctx = NULL;
-    /* assume fail */
-    int rc = 1;
-    int sha3 = 0, shake = 0;
-    AMVP_SUB_HASH alg;
+/*
+ * Every thread that runs test cases keeps the digests it has looked up and
+ * one EVP_MD_CTX, so that a test case or MCT iteration costs an init, update
+ * and final and nothing else. On OpenSSL 3, a digest from EVP_sha256() and
+ * friends is fetched from the provider again on each EVP_DigestInit_ex(),
+ * and creating a context allocates; here both happen once per thread. The
+ * cache is freed when its thread exits, or by app_sha_cleanup() for the
+ * thread calling it.
+ */
+#define APP_SHA_ALGS (AMVP_SUB_HASH_SHAKE_256 - AMVP_SUB_HASH_SHA1 + 1)
 
-    if (!test_case) {
-        return 1;
+typedef struct app_sha_cache_t {
+    const EVP_MD *md[APP_SHA_ALGS];
+    EVP_MD_CTX *md_ctx;
+} APP_SHA_CACHE;
+
+static void app_sha_cache_free(void *arg) {
+    APP_SHA_CACHE *cache = arg;
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    int i;
+#endif
+
+    if (!cache) {
+        return;
     }
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    for (i = 0; i < APP_SHA_ALGS; i++) {
+        EVP_MD_free((EVP_MD *)cache->md[i]);
+    }
+#endif
+    if (cache->md_ctx) EVP_MD_CTX_destroy(cache->md_ctx);
+    free(cache);
+}
 
-    tc = test_case->tc.hash;
-    if (!tc) return rc;
+#ifdef _WIN32
+static INIT_ONCE app_sha_once = INIT_ONCE_STATIC_INIT;
+static DWORD app_sha_key = FLS_OUT_OF_INDEXES;
+
+static void WINAPI app_sha_fls_free(void *arg) {
+    app_sha_cache_free(arg);
+}
 
-    alg = amvp_get_hash_alg(tc->cipher);
+static BOOL CALLBACK app_sha_key_init(PINIT_ONCE once, void *param, void **context) {
+    (void)once; (void)param; (void)context;
+    app_sha_key = FlsAlloc(app_sha_fls_free);
+    return TRUE;
+}
+
+static APP_SHA_CACHE *app_sha_cache_get(void) {
+    InitOnceExecuteOnce(&app_sha_once, app_sha_key_init, NULL, NULL);
+    return app_sha_key == FLS_OUT_OF_INDEXES ? NULL : FlsGetValue(app_sha_key);
+}
+
+static int app_sha_cache_set(APP_SHA_CACHE *cache) {
+    return app_sha_key != FLS_OUT_OF_INDEXES && FlsSetValue(app_sha_key, cache);
+}
+#else
+static pthread_once_t app_sha_once = PTHREAD_ONCE_INIT;
+static pthread_key_t app_sha_key;
+static int app_sha_key_ok = 0;
+
+static void app_sha_key_init(void) {
+    app_sha_key_ok = !pthread_key_create(&app_sha_key, app_sha_cache_free);
+}
+
+static APP_SHA_CACHE *app_sha_cache_get(void) {
+    pthread_once(&app_sha_once, app_sha_key_init);
+    return app_sha_key_ok ? pthread_getspecific(app_sha_key) : NULL;
+}
+
+static int app_sha_cache_set(APP_SHA_CACHE *cache) {
+    return app_sha_key_ok && !pthread_setspecific(app_sha_key, cache);
+}
+#endif
+
+/* This thread's cache, created on first use */
+static APP_SHA_CACHE *app_sha_cache(void) {
+    APP_SHA_CACHE *cache = app_sha_cache_get();
+
+    if (cache) {
+        return cache;
+    }
+    cache = calloc(1, sizeof(APP_SHA_CACHE));
+    if (!cache) {
+        printf("\nCrypto module error, failed to malloc the digest cache\n");
+        return NULL;
+    }
+    cache->md_ctx = EVP_MD_CTX_create();
+    if (!cache->md_ctx || !app_sha_cache_set(cache)) {
+        printf("\nCrypto module error, failed to set up the digest cache\n");
+        app_sha_cache_free(cache);
+        return NULL;
+    }
+    return cache;
+}
+
+void app_sha_cleanup(void) {
+    APP_SHA_CACHE *cache = app_sha_cache_get();
+
+    if (cache) {
+        app_sha_cache_set(NULL);
+        app_sha_cache_free(cache);
+    }
+}
+
+/*
+ * Returns the digest for cipher from cache, looking it up the first time,
+ * and whether it is SHA-3 or SHAKE. NULL if it isn't supported.
+ */
+static const EVP_MD *app_sha_md(APP_SHA_CACHE *cache, AMVP_CIPHER cipher, int *sha3, int *shake) {
+    const EVP_MD *md = NULL;
+    AMVP_SUB_HASH alg;
+    int idx;
+
+    *sha3 = 0;
+    *shake = 0;
+    alg = amvp_get_hash_alg(cipher);
     if (alg == 0) {
         printf("Invalid cipher value");
-        return 1;
+        return NULL;
+    }
+    idx = alg - AMVP_SUB_HASH_SHA1;
+    if (alg >= AMVP_SUB_HASH_SHA3_224 && alg <= AMVP_SUB_HASH_SHA3_512) {
+        *sha3 = 1;
+    } else if (alg == AMVP_SUB_HASH_SHAKE_128 || alg == AMVP_SUB_HASH_SHAKE_256) {
+        *shake = 1;
+    }
+    if (cache->md[idx]) {
+        return cache->md[idx];
     }
 
     switch (alg) {
@@ -63,27 +178,21 @@ int app_sha_handler(AMVP_TEST_CASE *test_case) {
         break;
     case AMVP_SUB_HASH_SHA3_224:
         md = EVP_sha3_224();
-        sha3 = 1;
         break;
     case AMVP_SUB_HASH_SHA3_256:
         md = EVP_sha3_256();
-        sha3 = 1;
         break;
     case AMVP_SUB_HASH_SHA3_384:
         md = EVP_sha3_384();
-        sha3 = 1;
         break;
     case AMVP_SUB_HASH_SHA3_512:
         md = EVP_sha3_512();
-        sha3 = 1;
         break;
     case AMVP_SUB_HASH_SHAKE_128:
         md = EVP_shake128();
-        shake = 1;
         break;
     case AMVP_SUB_HASH_SHAKE_256:
         md = EVP_shake256();
-        shake = 1;
         break;
 #else
     case AMVP_SUB_HASH_SHA2_512_224:
@@ -97,14 +206,58 @@ int app_sha_handler(AMVP_TEST_CASE *test_case) {
 #endif
     default:
         printf("Error: Unsupported hash algorithm requested by AMVP server\n");
-        return AMVP_NO_CAP;
+        return NULL;
+    }
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    /* An explicit fetch, honoring the default properties such as fips=yes */
+    md = EVP_MD_fetch(NULL, EVP_MD_get0_name(md), NULL);
+    if (!md) {
+        printf("\nCrypto module error, EVP_MD_fetch failed\n");
+        return NULL;
     }
+#endif
+    cache->md[idx] = md;
+    return md;
+}
+
+/* out = H(msg), or the first xof_len bytes of it for an XOF (0 otherwise) */
+static int app_sha_digest(EVP_MD_CTX *md_ctx, const EVP_MD *md,
+                          const unsigned char *msg, unsigned int msg_len,
+                          unsigned char *out, unsigned int *out_len, unsigned int xof_len) {
+    if (!EVP_DigestInit_ex(md_ctx, md, NULL)) {
+        printf("\nCrypto module error, EVP_DigestInit_ex failed\n");
+        return 1;
+    }
+    if (!EVP_DigestUpdate(md_ctx, msg, msg_len)) {
+        printf("\nCrypto module error, EVP_DigestUpdate failed\n");
+        return 1;
+    }
+#if OPENSSL_VERSION_NUMBER >= 0x10101010L /* OpenSSL 1.1.1 or greater */
+    if (xof_len) {
+        if (!EVP_DigestFinalXOF(md_ctx, out, xof_len)) {
+            printf("\nCrypto module error, EVP_DigestFinal failed\n");
+            return 1;
+        }
+        *out_len = xof_len;
+        return 0;
+    }
+#endif
+    if (!EVP_DigestFinal_ex(md_ctx, out, out_len)) {
+        printf("\nCrypto module error, EVP_DigestFinal failed\n");
+        return 1;
+    }
+    return 0;
+}
+
+/* One AFT, VOT or MCT iteration, with md looked up by the caller */
+static int app_sha_run_tc(APP_SHA_CACHE *cache, const EVP_MD *md, int sha3, int shake, AMVP_HASH_TC *tc) {
+    EVP_MD_CTX *md_ctx = cache->md_ctx;
 
     if (!tc->md) {
         printf("\nCrypto module error, md memory not allocated by library\n");
-        goto end;
+        return 1;
     }
-    md_ctx = EVP_MD_CTX_create();
 
     if (tc->test_type == AMVP_HASH_TEST_TYPE_MCT && !sha3 && !shake) {
         /* If Monte Carlo we need to be able to init and then update
@@ -113,71 +266,188 @@ int app_sha_handler(AMVP_TEST_CASE *test_case) {
          */
         if (!tc->m1 || !tc->m2 || !tc->m3) {
             printf("\nCrypto module error, m1, m2, or m3 missing in sha mct test case\n");
-            goto end;
+            return 1;
         }
         if (!EVP_DigestInit_ex(md_ctx, md, NULL)) {
             printf("\nCrypto module error, EVP_DigestInit_ex failed\n");
-            goto end;
+            return 1;
         }
-        if (!EVP_DigestUpdate(md_ctx, tc->m1, tc->msg_len)) {
+        if (!EVP_DigestUpdate(md_ctx, tc->m1, tc->msg_len) ||
+            !EVP_DigestUpdate(md_ctx, tc->m2, tc->msg_len) ||
+            !EVP_DigestUpdate(md_ctx, tc->m3, tc->msg_len)) {
             printf("\nCrypto module error, EVP_DigestUpdate failed\n");
-            goto end;
+            return 1;
         }
-        if (!EVP_DigestUpdate(md_ctx, tc->m2, tc->msg_len)) {
-            printf("\nCrypto module error, EVP_DigestUpdate failed\n");
-            goto end;
-        }
-        if (!EVP_DigestUpdate(md_ctx, tc->m3, tc->msg_len)) {
-            printf("\nCrypto module error, EVP_DigestUpdate failed\n");
-            goto end;
-        }
-        if (!EVP_DigestFinal(md_ctx, tc->md, &tc->md_len)) {
+        if (!EVP_DigestFinal_ex(md_ctx, tc->md, &tc->md_len)) {
             printf("\nCrypto module error, EVP_DigestFinal failed\n");
-            goto end;
+            return 1;
         }
-    } else {
-        if (!tc->msg) {
-            printf("\nCrypto module error, msg missing in sha test case\n");
-            goto end;
+        return 0;
+    }
+
+    if (!tc->msg) {
+        printf("\nCrypto module error, msg missing in sha test case\n");
+        return 1;
+    }
+    /* Use the XOF oriented function for VOT and SHAKE MCT */
+    return app_sha_digest(md_ctx, md, tc->msg, tc->msg_len, tc->md, &tc->md_len,
+                          (tc->test_type == AMVP_HASH_TEST_TYPE_VOT ||
+                           (tc->test_type == AMVP_HASH_TEST_TYPE_MCT && shake)) ? tc->xof_len : 0);
+}
+
+int app_sha_handler(AMVP_TEST_CASE *test_case) {
+    AMVP_HASH_TC *tc;
+    APP_SHA_CACHE *cache = NULL;
+    const EVP_MD *md = NULL;
+    int sha3 = 0, shake = 0;
+
+    if (!test_case) {
+        return 1;
+    }
+
+    tc = test_case->tc.hash;
+    if (!tc) return 1;
+
+    cache = app_sha_cache();
+    if (!cache) return 1;
+    md = app_sha_md(cache, tc->cipher, &sha3, &shake);
+    if (!md) {
+        return AMVP_NO_CAP;
+    }
+    return app_sha_run_tc(cache, md, sha3, shake, tc);
+}
+
+/*
+ * Batch handler, see amvp_cap_set_batch_handler(). Every test case of a
+ * hash AFT or VOT group comes in one call, so the digest is looked up once
+ * for the group.
+ */
+int app_sha_batch_handler(AMVP_TEST_CASE *test_cases, int count) {
+    APP_SHA_CACHE *cache = NULL;
+    const EVP_MD *md = NULL;
+    AMVP_CIPHER cipher = 0;
+    AMVP_HASH_TC *tc = NULL;
+    int sha3 = 0, shake = 0, i;
+
+    if (!test_cases || count <= 0) {
+        return 1;
+    }
+    cache = app_sha_cache();
+    if (!cache) return 1;
+
+    for (i = 0; i < count; i++) {
+        tc = test_cases[i].tc.hash;
+        if (!tc) return 1;
+        if (!md || tc->cipher != cipher) {
+            cipher = tc->cipher;
+            md = app_sha_md(cache, cipher, &sha3, &shake);
+            if (!md) {
+                return AMVP_NO_CAP;
+            }
         }
-        if (!EVP_DigestInit_ex(md_ctx, md, NULL)) {
-            printf("\nCrypto module error, EVP_DigestInit_ex failed\n");
-            goto end;
+        if (app_sha_run_tc(cache, md, sha3, shake, tc)) {
+            return 1;
         }
+    }
+    return 0;
+}
 
-        if (!EVP_DigestUpdate(md_ctx, tc->msg, tc->msg_len)) {
-            printf("\nCrypto module error, EVP_DigestUpdate failed\n");
-            goto end;
+/*
+ * MCT handler, see amvp_cap_set_mct_handler(). Runs the AMVP_HASH_MCT_INNER
+ * iterations of one outer iteration here, with the chaining between them,
+ * instead of libamvp calling app_sha_handler() for each.
+ */
+int app_sha_mct_handler(AMVP_TEST_CASE *test_case) {
+    APP_SHA_CACHE *cache = NULL;
+    const EVP_MD *md = NULL;
+    AMVP_HASH_TC *tc = NULL;
+    unsigned char m[3][EVP_MAX_MD_SIZE];
+    unsigned char *out = NULL;
+    unsigned int out_len = 0, range = 0;
+    int sha3 = 0, shake = 0, i;
+
+    if (!test_case || !(tc = test_case->tc.hash)) {
+        return 1;
+    }
+    cache = app_sha_cache();
+    if (!cache) return 1;
+    md = app_sha_md(cache, tc->cipher, &sha3, &shake);
+    if (!md) {
+        return AMVP_NO_CAP;
+    }
+    if (!tc->md) {
+        printf("\nCrypto module error, md memory not allocated by library\n");
+        return 1;
+    }
+
+    if (shake) {
+        /* msg is the 16 byte seed, the leftmost 16 bytes of each output the next one */
+        if (!tc->msg || tc->msg_len != 16 || tc->xof_max_len < tc->xof_min_len) {
+            printf("\nCrypto module error, bad seed or output lengths in shake mct test case\n");
+            return 1;
+        }
+        range = tc->xof_max_len - tc->xof_min_len + 1;
+        for (i = 0; i < AMVP_HASH_MCT_INNER; i++) {
+            if (i) {
+                memzero_s(m[0], 16);
+                memcpy_s(m[0], 16, tc->md, tc->md_len < 16 ? tc->md_len : 16);
+            } else {
+                memcpy_s(m[0], 16, tc->msg, 16);
+            }
+            if (tc->xof_len < 2 || app_sha_digest(cache->md_ctx, md, m[0], 16, tc->md, &tc->md_len, tc->xof_len)) {
+                return 1;
+            }
+            /* The rightmost 16 bits of the output pick the next output length */
+            tc->xof_len = tc->xof_min_len + ((tc->md[tc->md_len - 2] << 8 | tc->md[tc->md_len - 1]) % range);
         }
+        return 0;
+    }
 
-#if OPENSSL_VERSION_NUMBER >= 0x10101010L /* OpenSSL 1.1.1 or greater */
-        if (tc->test_type == AMVP_HASH_TEST_TYPE_VOT ||
-            (tc->test_type == AMVP_HASH_TEST_TYPE_MCT && shake)) {
-            /*
-             * Use the XOF oriented function.
-             * Skip past the other "EVP_DigestFinal".
-             */
-            if (!EVP_DigestFinalXOF(md_ctx, tc->md, tc->xof_len)) {
-                printf("\nCrypto module error, EVP_DigestFinal failed\n");
-                goto end;
+    if (sha3) {
+        /* Each digest is the next message */
+        if (!tc->msg) {
+            printf("\nCrypto module error, msg missing in sha3 mct test case\n");
+            return 1;
+        }
+        if (app_sha_digest(cache->md_ctx, md, tc->msg, tc->msg_len, tc->md, &tc->md_len, 0)) {
+            return 1;
+        }
+        for (i = 1; i < AMVP_HASH_MCT_INNER; i++) {
+            memcpy_s(m[0], sizeof(m[0]), tc->md, tc->md_len);
+            if (app_sha_digest(cache->md_ctx, md, m[0], tc->md_len, tc->md, &tc->md_len, 0)) {
+                return 1;
             }
-            tc->md_len = tc->xof_len;
-            rc = 0;
-            goto end;
         }
-#endif
+        return 0;
+    }
 
-        if (!EVP_DigestFinal(md_ctx, tc->md, &tc->md_len)) {
+    /* SHA-1 and SHA-2: MD[i] = H(M[i-3] || M[i-2] || M[i-1]), with m holding the last three */
+    if (!tc->m1 || !tc->m2 || !tc->m3 || tc->msg_len > EVP_MAX_MD_SIZE) {
+        printf("\nCrypto module error, m1, m2, or m3 missing in sha mct test case\n");
+        return 1;
+    }
+    memcpy_s(m[0], sizeof(m[0]), tc->m1, tc->msg_len);
+    memcpy_s(m[1], sizeof(m[1]), tc->m2, tc->msg_len);
+    memcpy_s(m[2], sizeof(m[2]), tc->m3, tc->msg_len);
+    for (i = 0; i < AMVP_HASH_MCT_INNER; i++) {
+        if (!EVP_DigestInit_ex(cache->md_ctx, md, NULL)) {
+            printf("\nCrypto module error, EVP_DigestInit_ex failed\n");
+            return 1;
+        }
+        if (!EVP_DigestUpdate(cache->md_ctx, m[i % 3], tc->msg_len) ||
+            !EVP_DigestUpdate(cache->md_ctx, m[(i + 1) % 3], tc->msg_len) ||
+            !EVP_DigestUpdate(cache->md_ctx, m[(i + 2) % 3], tc->msg_len)) {
+            printf("\nCrypto module error, EVP_DigestUpdate failed\n");
+            return 1;
+        }
+        /* The digest replaces the oldest message */
+        out = m[i % 3];
+        if (!EVP_DigestFinal_ex(cache->md_ctx, out, &out_len) || out_len != tc->msg_len) {
             printf("\nCrypto module error, EVP_DigestFinal failed\n");
-            goto end;
+            return 1;
         }
     }
-
-    rc = 0;
-
-end:
-    if (md_ctx) EVP_MD_CTX_destroy(md_ctx);
-
-    return rc;
+    memcpy_s(tc->md, EVP_MAX_MD_SIZE, out, out_len);
+    tc->md_len = out_len;
+    return 0;
 }
-
@@ -16,6 +16,12 @@
 #ifndef amvp_h
 #define amvp_h
 
+#ifdef _WIN32
+#include <winsock2.h>
+#else
+#include <sys/select.h>
+#endif
+
 #ifdef __cplusplus
 extern "C"
 {
@@ -24,12 +30,19 @@ extern "C"
 #define AMVP_TOTP_LENGTH 8
 #define AMVP_TOTP_TOKEN_MAX 128
 
+#define AMVP_MAX_CONCURRENT_TRANSFERS 16 /**< Upper limit for amvp_set_max_concurrent_transfers() */
+#define AMVP_MAX_WORKER_THREADS 64       /**< Upper limit for amvp_set_worker_threads() */
+#define AMVP_MAX_WORKER_PROCESSES 64     /**< Upper limit for amvp_set_worker_processes() */
+#define AMVP_MAX_PIPELINE_DEPTH 8        /**< Upper limit for amvp_set_pipeline_depth() */
+#define AMVP_MAX_LOG_SLOTS 65536         /**< Upper limit for amvp_set_async_logging() */
+
 #define AMVP_HASH_MCT_INNER     1000
 #define AMVP_HASH_MCT_OUTER     100
 #define AMVP_AES_MCT_INNER      1000
 #define AMVP_AES_MCT_OUTER      100
 #define AMVP_DES_MCT_INNER      10000
 #define AMVP_DES_MCT_OUTER      400
+#define AMVP_SYM_MCT_OUT_STRIDE 16 /**< Spacing of AMVP_SYM_CIPHER_TC.mct_out entries */
 
 /**
  * @enum AMVP_LOG_LVL
@@ -56,6 +69,154 @@ typedef enum amvp_log_lvl {
     AMVP_LOG_LVL_MAX
 } AMVP_LOG_LVL;
 
+/**
+ * @enum AMVP_VS_SCHEDULE
+ * @brief The order in which vector sets are started when they are processed concurrently, see
+ *        amvp_set_vs_schedule().
+ */
+typedef enum amvp_vs_schedule {
+    AMVP_VS_SCHEDULE_RECEIVED = 0,   /**< As the server listed them */
+    AMVP_VS_SCHEDULE_COSTLIEST_FIRST /**< Highest estimated processing time first */
+} AMVP_VS_SCHEDULE;
+
+/**
+ * @enum AMVP_WORKER_AFFINITY
+ * @brief Where worker threads and processes are allowed to run, see amvp_set_worker_affinity().
+ */
+typedef enum amvp_worker_affinity {
+    AMVP_WORKER_AFFINITY_NONE = 0, /**< Wherever the OS schedules them */
+    AMVP_WORKER_AFFINITY_NODE,     /**< Spread over the NUMA nodes, each on the CPUs of its node */
+    AMVP_WORKER_AFFINITY_CORE      /**< Spread over the NUMA nodes, each on one CPU of its node */
+} AMVP_WORKER_AFFINITY;
+
+/**
+ * @struct AMVP_LOG_RECORD
+ * @brief Header of each record written to the file given to amvp_set_async_logging(). It is
+ *        followed by \p length bytes of message text, without a terminator. Fields are in
+ *        host byte order.
+ */
+typedef struct amvp_log_record_t {
+    unsigned long long timestamp_us; /**< Microseconds since the epoch when the message was logged */
+    unsigned int level;              /**< AMVP_LOG_LVL of the message */
+    unsigned int length;             /**< Length of the message text that follows */
+} AMVP_LOG_RECORD;
+
+#define AMVP_METRICS_ALG_MAX 64
+
+/**
+ * @struct AMVP_VS_METRICS
+ * @brief Where the time of one vector set went, see amvp_set_metrics(). Times are wall clock
+ *        milliseconds summed over every attempt, so download_ms includes downloads that were
+ *        answered with a retry.
+ */
+typedef struct amvp_vs_metrics_t {
+    int vs_id;                                /**< 0 if the set was never parsed */
+    char algorithm[AMVP_METRICS_ALG_MAX + 1]; /**< "algorithm" or "algorithm/mode" */
+    double download_ms;                       /**< Downloading the vector set */
+    double retry_wait_ms;                     /**< Waiting before retrying a download */
+    double parse_ms;                          /**< Parsing the downloaded JSON */
+    double handler_ms;                        /**< KAT handler, including crypto_ms */
+    double crypto_ms;                         /**< Spent in the crypto handler callbacks */
+    double upload_ms;                         /**< Serializing and uploading the responses */
+    double net_setup_ms;                      /**< Part of download_ms and upload_ms spent on DNS
+                                                   lookups, TCP connects and TLS handshakes */
+    double server_wait_ms;                    /**< Part of download_ms and upload_ms between a
+                                                   request going out and the first byte of the
+                                                   answer: sending it, and the server working */
+    double transfer_ms;                       /**< Part of download_ms and upload_ms receiving
+                                                   the answers */
+    int retries;                              /**< Downloads the server asked us to retry */
+    int test_cases;                           /**< Test cases in the vector set */
+    int crypto_calls;                         /**< Calls to the crypto handler, higher than
+                                                   test_cases for Monte Carlo tests */
+    unsigned long long bytes_in;              /**< Response bytes received for the set */
+    unsigned long long bytes_out;             /**< Request bytes sent for the set */
+    unsigned long long mem_peak_bytes;        /**< Most heap memory the set's JSON trees and
+                                                   arenas held at once, over what was held
+                                                   when the set started */
+    unsigned long long mem_bytes;             /**< The same when the set was done */
+    unsigned long long alloc_bytes;           /**< Allocated while the set was processed */
+    unsigned long long parse_alloc_bytes;     /**< Part of alloc_bytes allocated parsing the set */
+    unsigned long long handler_alloc_bytes;   /**< Part of alloc_bytes allocated in the KAT handler */
+    unsigned long long upload_alloc_bytes;    /**< Allocated serializing and sending the responses */
+    int allocs;                               /**< Allocations counted in alloc_bytes */
+    int parse_allocs;                         /**< Allocations counted in parse_alloc_bytes */
+    int handler_allocs;                       /**< Allocations counted in handler_alloc_bytes */
+    int upload_allocs;                        /**< Allocations counted in upload_alloc_bytes */
+} AMVP_VS_METRICS;
+
+/**
+ * @struct AMVP_ALG_METRICS
+ * @brief Totals over every vector set of one algorithm, see amvp_set_metrics()
+ */
+typedef struct amvp_alg_metrics_t {
+    int vector_sets;        /**< Number of vector sets summed up */
+    AMVP_VS_METRICS totals; /**< Sums of each field, except the highest mem_peak_bytes and
+                                 mem_bytes of any set; vs_id is 0 */
+} AMVP_ALG_METRICS;
+
+#define AMVP_NET_TIMING_URL_MAX 255
+
+/**
+ * @struct AMVP_NET_TIMING
+ * @brief libcurl's timing breakdown of one HTTP request, see amvp_get_net_timing(). Like
+ *        libcurl's, each time is counted from the start of the request, so connect_ms includes
+ *        dns_ms and so on. Times of a step that didn't happen, such as the TLS handshake on a
+ *        reused connection, are 0.
+ */
+typedef struct amvp_net_timing_t {
+    char method[8];                           /**< "GET", "POST", "PUT" or "DELETE" */
+    char url[AMVP_NET_TIMING_URL_MAX + 1];    /**< Truncated if longer */
+    long http_code;                           /**< 0 if no answer was received */
+    double started;                           /**< Wall clock start, seconds since the epoch */
+    double dns_ms;                            /**< CURLINFO_NAMELOOKUP_TIME */
+    double connect_ms;                        /**< CURLINFO_CONNECT_TIME */
+    double tls_ms;                            /**< CURLINFO_APPCONNECT_TIME */
+    double pretransfer_ms;                    /**< CURLINFO_PRETRANSFER_TIME */
+    double first_byte_ms;                     /**< CURLINFO_STARTTRANSFER_TIME */
+    double total_ms;                          /**< CURLINFO_TOTAL_TIME */
+    unsigned long long bytes_up;              /**< CURLINFO_SIZE_UPLOAD_T */
+    unsigned long long bytes_down;            /**< CURLINFO_SIZE_DOWNLOAD_T */
+    double upload_speed;                      /**< CURLINFO_SPEED_UPLOAD_T, bytes per second */
+    double download_speed;                    /**< CURLINFO_SPEED_DOWNLOAD_T, bytes per second */
+} AMVP_NET_TIMING;
+
+#define AMVP_WORKLOAD_ALG_MAX 64
+
+/**
+ * @struct AMVP_WORKLOAD_MODEL
+ * @brief What one unit of an algorithm's vector set costs, see amvp_set_workload_model(). The
+ *        server makes test groups for every value listed in properties such as "direction",
+ *        "keyLen" or "curve", and for every entry of "capabilities"; each such combination is a
+ *        unit.
+ */
+typedef struct amvp_workload_model_t {
+    int tests;                 /**< Known answer test cases per unit */
+    int mct_tests;             /**< Monte Carlo test cases per unit */
+    int mct_outer;             /**< Results of each Monte Carlo test case */
+    int mct_inner;             /**< Crypto operations behind each result */
+    double lib_us;             /**< Time libamvp spends on a test case, katbench's us/tc */
+    double crypto_us;          /**< Time the crypto handler spends on one operation */
+    int req_bytes;             /**< Bytes of a test case as downloaded, katbench's req B/tc */
+    int rsp_bytes;             /**< Bytes of a result as uploaded, katbench's rsp B/tc */
+} AMVP_WORKLOAD_MODEL;
+
+/**
+ * @struct AMVP_WORKLOAD_ESTIMATE
+ * @brief What a registration is expected to cost, see amvp_estimate_workload()
+ */
+typedef struct amvp_workload_estimate_t {
+    char algorithm[AMVP_WORKLOAD_ALG_MAX + 1]; /**< "algorithm" or "algorithm/mode", empty for
+                                                    the total */
+    int vector_sets;                           /**< Vector sets expected */
+    unsigned long long test_cases;             /**< Test cases in them */
+    unsigned long long crypto_ops;             /**< Crypto handler operations, with every
+                                                    iteration of the Monte Carlo tests */
+    unsigned long long request_bytes;          /**< Size of the vector sets to download */
+    unsigned long long response_bytes;         /**< Size of the responses to upload */
+    double cpu_secs;                           /**< Processing time, libamvp and crypto handler */
+} AMVP_WORKLOAD_ESTIMATE;
+
 /**
  * @struct AMVP_CTX
  * @brief This opaque structure is used to maintain the state of a session with an AMVP server.
@@ -74,6 +235,13 @@ typedef enum amvp_log_lvl {
  */
 typedef struct amvp_ctx_t AMVP_CTX;
 
+/**
+ * @struct AMVP_SESSION_GROUP
+ * @brief Transport state shared by several AMVP_CTX, and the threads that run their sessions.
+ *        See amvp_session_group_create().
+ */
+typedef struct amvp_session_group_t AMVP_SESSION_GROUP;
+
 /**
  * @enum AMVP_RESULT
  * @brief This enum is used to indicate error conditions to the application
@@ -634,7 +802,9 @@ typedef enum amvp_hash_param {
     AMVP_HASH_IN_EMPTY,
     AMVP_HASH_OUT_BIT, /**< Used for AMVP_HASH_SHAKE_128, AMVP_HASH_SHAKE_256 */
     AMVP_HASH_OUT_LENGTH, /**< Used for AMVP_HASH_SHAKE_128, AMVP_HASH_SHAKE_256 */
-    AMVP_HASH_MESSAGE_LEN
+    AMVP_HASH_MESSAGE_LEN,
+    AMVP_HASH_LARGE_DATA /**< Size in GiB (1, 2, 4 or 8) of a Large Data Test to run. Not for
+                              AMVP_HASH_SHAKE_*. Needs amvp_cap_set_hash_stream_handlers() */
 } AMVP_HASH_PARM;
 
 /**
@@ -978,7 +1148,8 @@ typedef enum amvp_hash_testtype {
     AMVP_HASH_TEST_TYPE_NONE = 0,
     AMVP_HASH_TEST_TYPE_AFT,
     AMVP_HASH_TEST_TYPE_MCT,
-    AMVP_HASH_TEST_TYPE_VOT
+    AMVP_HASH_TEST_TYPE_VOT,
+    AMVP_HASH_TEST_TYPE_LDT
 } AMVP_HASH_TESTTYPE;
 
 /** @enum AMVP_CMAC_TESTTYPE */
@@ -1094,6 +1265,10 @@ typedef struct amvp_sym_cipher_tc_t {
     unsigned char *iv_ret;       /**< updated IV used for TDES MCT */
     unsigned char *iv_ret_after; /**< updated IV used for TDES MCT */
     unsigned char *salt;         /**< For use with AES-XPN */
+    unsigned char *mct_out;      /**< MCT with a crypto_mct_handler: the output of each inner
+                                      iteration, AMVP_SYM_MCT_OUT_STRIDE bytes apart */
+    unsigned char *mct_iv_ret;   /**< TDES MCT with a crypto_mct_handler: iv_ret after each inner
+                                      iteration, AMVP_SYM_MCT_OUT_STRIDE bytes apart */
     AMVP_SYM_KW_MODE kwcipher;
     AMVP_SYM_CIPH_TWEAK_MODE tw_mode;
     unsigned int seq_num;
@@ -1124,7 +1299,7 @@ typedef struct amvp_sym_cipher_tc_t {
 typedef struct amvp_hash_tc_t {
     AMVP_CIPHER cipher;
     unsigned int tc_id;           /**< Test case id */
-    AMVP_HASH_TESTTYPE test_type; /**< KAT or MCT or VOT */
+    AMVP_HASH_TESTTYPE test_type; /**< KAT or MCT or VOT or LDT */
     unsigned char *msg; /**< Message input */
     unsigned char *m1; /**< Mesage input #1
                             Provided when \ref AMVP_HASH_TC.test_type is MCT */
@@ -1141,6 +1316,13 @@ typedef struct amvp_hash_tc_t {
     unsigned int xof_bit_len; /**< XOF (extendable output format) length
                                    The expected length (in bits) of \ref AMVP_HASH_TC.md
                                    Only provided when \ref AMVP_HASH_TC.test_type is VOT */
+    unsigned int xof_min_len; /**< Smallest output length (in bytes) in SHAKE MCT
+                                   Only used by a crypto_mct_handler, see amvp_cap_set_mct_handler() */
+    unsigned int xof_max_len; /**< Largest output length (in bytes) in SHAKE MCT
+                                   Only used by a crypto_mct_handler, see amvp_cap_set_mct_handler() */
+    unsigned long long ldt_len; /**< Length (in bytes) of the whole message of an LDT, which
+                                     repeats \ref AMVP_HASH_TC.msg . Only provided when
+                                     \ref AMVP_HASH_TC.test_type is LDT */
     unsigned char *md; /**< The resulting digest calculated for the test case.
                             SUPPLIED BY USER */
     unsigned int md_len; /**< The length (in bytes) of \ref AMVP_HASH_TC.md
@@ -1602,6 +1784,7 @@ typedef struct amvp_ecdsa_tc_t {
     AMVP_TEST_DISPOSITION ver_disposition; /**< Indicates pass/fail (only in "verify" direction)*/
     unsigned char *message;
     int msg_len;
+    void *group_ctx;    /**< From the cap's group_init, see amvp_cap_set_group_handlers() */
 } AMVP_ECDSA_TC;
 
 /**
@@ -1698,6 +1881,7 @@ typedef struct amvp_dsa_tc_t {
     int s_len;
     unsigned char *seed;
     unsigned char *msg;
+    void *group_ctx;    /**< From the cap's group_init, see amvp_cap_set_group_handlers() */
 } AMVP_DSA_TC;
 
 /** @enum AMVP_KAS_ECC_MODE */
@@ -1793,6 +1977,7 @@ typedef struct amvp_kas_ecc_tc_t {
     int dlen;
     int zlen;
     int chashlen;
+    void *group_ctx;    /**< From the cap's group_init, see amvp_cap_set_group_handlers() */
 } AMVP_KAS_ECC_TC;
 
 /** @enum AMVP_KAS_FFC_MODE */
@@ -1900,6 +2085,7 @@ typedef struct amvp_kas_ffc_tc_t {
     int epuilen;
     int chashlen;
     int piutlen;
+    void *group_ctx;    /**< From the cap's group_init, see amvp_cap_set_group_handlers() */
 } AMVP_KAS_FFC_TC;
 
 /** @enum AMVP_SAFE_PRIMES_PARAM */
@@ -3970,6 +4156,143 @@ AMVP_RESULT amvp_cap_set_prereq(AMVP_CTX *ctx,
                                 AMVP_PREREQ_ALG pre_req_cap,
                                 char *value);
 
+/**
+ * @brief amvp_cap_set_batch_handler() registers an optional handler that is given all the test
+ *        cases of a test group in one call, instead of one test case per crypto_handler call.
+ *        This lets the module set up its contexts once per group or process several test cases
+ *        together. The test cases are in tcId order, and the handler fills in their results as
+ *        crypto_handler would. MCT groups still go through crypto_handler. The same applies to
+ *        algorithms whose KAT handler does not batch; currently only hash AFT/VOT groups are
+ *        batched, and RSA KeyGen, DSA pqgGen and safe primes pass every test case of the vector
+ *        set in one call. When a batch handler is set, it is used instead of the worker
+ *        threads from amvp_set_worker_threads() for those groups.
+ *
+ *        The AMVP_CIPHER value passed to this function should already have been setup by
+ *        invoking the matching amvp_cap_*_enable() function.
+ *
+ * @param ctx Pointer to AMVP_CTX that was previously created by calling amvp_create_test_session.
+ * @param cipher AMVP_CIPHER enum value identifying the crypto capability.
+ * @param crypto_batch_handler Address of function implemented by application that is invoked
+ *        with an array of count test cases. It is expected to return 0 on success and 1 for
+ *        failure. Pass NULL to go back to per test case calls.
+ *
+ * @return AMVP_RESULT
+ */
+AMVP_RESULT amvp_cap_set_batch_handler(AMVP_CTX *ctx,
+                                       AMVP_CIPHER cipher,
+                                       int (*crypto_batch_handler)(AMVP_TEST_CASE *test_cases, int count));
+
+/**
+ * @brief amvp_cap_set_mct_handler() lets the module run the inner loop of Monte Carlo tests
+ *        itself. Without it, every inner iteration is a crypto_handler call with libamvp
+ *        chaining the values in between; with it, the handler is called once per outer
+ *        iteration, runs all of its inner iterations and returns the outer iteration's result.
+ *        libamvp still does the steps between outer iterations. Currently honored by hash, AES
+ *        and TDES MCT:
+ *
+ *        SHA-1 and SHA-2: m1, m2 and m3 hold the seed, each msg_len bytes. Return the digest
+ *        of the last of the AMVP_HASH_MCT_INNER iterations in md and md_len.
+ *
+ *        SHA-3: msg holds the seed, msg_len bytes. Each iteration hashes msg and uses the
+ *        digest as the next msg. Return the last digest in md and md_len.
+ *
+ *        SHAKE: msg holds the 16 byte seed and xof_len the output length of the first
+ *        iteration. Each iteration uses the leftmost 16 bytes of the output as the next msg
+ *        and derives the next xof_len from its rightmost 16 bits, between xof_min_len and
+ *        xof_max_len. Return the last output in md and md_len, and the next output length in
+ *        xof_len.
+ *
+ *        AES and TDES (ECB, CBC, OFB, CFB): key, iv and pt (encrypt) or ct (decrypt) hold the
+ *        inputs of the first inner iteration. Run the AMVP_AES_MCT_INNER or
+ *        AMVP_DES_MCT_INNER iterations, chaining them as the MCT specification says, and
+ *        write the ct (encrypt) or pt (decrypt) of iteration j to mct_out + j *
+ *        AMVP_SYM_MCT_OUT_STRIDE; for CFB1 that is the one bit, in the top of the byte. TDES
+ *        also writes iv_ret of each iteration to mct_iv_ret the same way, and sets
+ *        iv_ret_after as after the last one. Changes to the other fields are discarded;
+ *        libamvp rebuilds the chaining from the outputs to compute the next key.
+ *
+ *        The AMVP_CIPHER value passed to this function should already have been setup by
+ *        invoking the matching amvp_cap_*_enable() function.
+ *
+ * @param ctx Pointer to AMVP_CTX that was previously created by calling amvp_create_test_session.
+ * @param cipher AMVP_CIPHER enum value identifying the crypto capability.
+ * @param crypto_mct_handler Address of function implemented by application that is invoked
+ *        once per MCT outer iteration. It is expected to return 0 on success and 1 for
+ *        failure. Pass NULL to go back to per iteration crypto_handler calls.
+ *
+ * @return AMVP_RESULT
+ */
+AMVP_RESULT amvp_cap_set_mct_handler(AMVP_CTX *ctx,
+                                     AMVP_CIPHER cipher,
+                                     int (*crypto_mct_handler)(AMVP_TEST_CASE *test_case));
+
+/**
+ * @brief amvp_cap_set_group_handlers() registers optional hooks that are called once per test
+ *        group, so the module can build the objects shared by the group's test cases (the
+ *        EC_GROUP of a curve, DH or DSA domain parameters, precomputation tables) once instead
+ *        of for every test case. Honored by ECDSA, KAS-ECC, KAS-FFC, and DSA keyGen, sigGen,
+ *        sigVer and pqgVer.
+ *
+ *        group_init is called before the first crypto_handler call of a group, with that
+ *        group's first test case. Only its group level fields are meant to be used: the curve
+ *        and hash, or p, q and g where the server sends them per group. Whatever it stores in
+ *        *group_ctx is passed to crypto_handler in the group_ctx field of each test case of
+ *        the group. group_fini is called with it once the group is done, or when processing
+ *        stops early.
+ *
+ *        The AMVP_CIPHER value passed to this function should already have been setup by
+ *        invoking the matching amvp_cap_*_enable() function.
+ *
+ * @param ctx Pointer to AMVP_CTX that was previously created by calling amvp_create_test_session.
+ * @param cipher AMVP_CIPHER enum value identifying the crypto capability.
+ * @param group_init Address of function implemented by application that is invoked once per
+ *        test group. It is expected to return 0 on success and 1 for failure, which fails the
+ *        group like a crypto_handler failure would.
+ * @param group_fini Address of function implemented by application that releases what
+ *        group_init stored. May be NULL. Pass NULL for both to turn the hooks off.
+ *
+ * @return AMVP_RESULT
+ */
+AMVP_RESULT amvp_cap_set_group_handlers(AMVP_CTX *ctx,
+                                        AMVP_CIPHER cipher,
+                                        int (*group_init)(AMVP_TEST_CASE *test_case, void **group_ctx),
+                                        void (*group_fini)(void *group_ctx));
+
+/**
+ * @brief amvp_cap_set_hash_stream_handlers() registers the streaming hash interface used for
+ *        the SHA-1, SHA-2 and SHA-3 Large Data Test (LDT), see AMVP_HASH_LARGE_DATA. The LDT
+ *        message is gigabytes long, so libamvp never builds it: it expands the server's
+ *        content pattern once into a chunk of about a megabyte and feeds that chunk to
+ *        hash_update until ldt_len bytes have gone in. Memory use does not depend on the
+ *        message length.
+ *
+ *        hash_init is called once per LDT test case, with msg holding the content pattern and
+ *        ldt_len the full message length. Whatever it stores in *stream_ctx is passed to
+ *        hash_update and hash_final. hash_final writes the digest to md and md_len and
+ *        releases stream_ctx; once hash_init succeeded it is always called, also after a failed
+ *        hash_update, in which case its digest is discarded. The calls are made from the
+ *        thread processing the vector set, never from worker threads.
+ *
+ *        The AMVP_CIPHER value passed to this function should already have been setup by
+ *        invoking amvp_cap_hash_enable().
+ *
+ * @param ctx Pointer to AMVP_CTX that was previously created by calling amvp_create_test_session.
+ * @param cipher AMVP_CIPHER enum value identifying the crypto capability.
+ * @param hash_init Address of function implemented by application that starts a digest.
+ * @param hash_update Address of function implemented by application that hashes the next len
+ *        bytes of the message.
+ * @param hash_final Address of function implemented by application that finishes the digest.
+ *        All three are expected to return 0 on success and 1 for failure. Pass NULL for all
+ *        three to remove the handlers.
+ *
+ * @return AMVP_RESULT
+ */
+AMVP_RESULT amvp_cap_set_hash_stream_handlers(AMVP_CTX *ctx,
+                                              AMVP_CIPHER cipher,
+                                              int (*hash_init)(AMVP_TEST_CASE *test_case, void **stream_ctx),
+                                              int (*hash_update)(void *stream_ctx, const unsigned char *data, unsigned int len),
+                                              int (*hash_final)(void *stream_ctx, AMVP_TEST_CASE *test_case));
+
 /**
  * @brief amvp_create_test_session() creates a context that can be used to commence a test session
  *        with an AMVP server. This function should be called first to create a context that is
@@ -4002,6 +4325,21 @@ AMVP_RESULT amvp_create_test_session(AMVP_CTX **ctx,
  */
 AMVP_RESULT amvp_free_test_session(AMVP_CTX *ctx);
 
+/**
+ * @brief amvp_ctx_clone() creates a context with the registered capabilities and server settings
+ *        of an existing one, for running several test sessions with the same capabilities at
+ *        once. The capabilities are shared rather than copied, so cloning takes the same time
+ *        however many are registered; they can't be changed on either context while any clone
+ *        of it is alive. Session state, credentials, files and the optional caches, metrics and
+ *        logging settings are not carried over. Free the clone with amvp_free_test_session().
+ *
+ * @param src Pointer to the AMVP_CTX to copy, with all of its capabilities registered
+ * @param dst Address of an AMVP_CTX pointer, which must be NULL, that receives the new context
+ *
+ * @return AMVP_RESULT
+ */
+AMVP_RESULT amvp_ctx_clone(AMVP_CTX *src, AMVP_CTX **dst);
+
 /**
  * @brief amvp_set_server() specifies the AMVP server and TCP port number to use when contacting
  *        the server. This function is used to specify the hostname or IP address of the AMVP
@@ -4076,6 +4414,504 @@ AMVP_RESULT amvp_set_cacerts(AMVP_CTX *ctx, const char *ca_file);
  */
 AMVP_RESULT amvp_set_certkey(AMVP_CTX *ctx, char *cert_file, char *key_file);
 
+/**
+ * @brief amvp_set_max_concurrent_transfers() sets how many vector set downloads and response
+ *        uploads libamvp may keep in flight at once while processing a test session. Vector
+ *        sets are still processed one at a time; only the network traffic overlaps. The
+ *        same limit applies to the listing pages fetched while verifying FIPS validation
+ *        metadata, when the server says how many there are. The default of 1 processes
+ *        each vector set, and each page, in turn.
+ *
+ * @param ctx Pointer to AMVP_CTX that was previously created by calling amvp_create_test_session.
+ * @param max_transfers Number of concurrent transfers, between 1 and AMVP_MAX_CONCURRENT_TRANSFERS
+ *
+ * @return AMVP_RESULT
+ */
+AMVP_RESULT amvp_set_max_concurrent_transfers(AMVP_CTX *ctx, int max_transfers);
+
+/**
+ * @brief amvp_set_vs_schedule() sets the order in which vector sets are started when they are
+ *        processed concurrently, see amvp_set_max_concurrent_transfers() and
+ *        amvp_set_pipeline_depth(). With AMVP_VS_SCHEDULE_COSTLIEST_FIRST the sets expected to
+ *        take longest, such as RSA key generation or DSA PQG generation, are downloaded and
+ *        processed first and cheaper sets fill in around them, so that a slow set started last
+ *        doesn't hold up the end of the session. The cost of each set comes from
+ *        amvp_estimate_workload(), and is matched to it by the position of its registration
+ *        entry, so this only applies when the server sent one vector set per entry. Otherwise,
+ *        and by default, sets are started in the order the server sent them.
+ *
+ * @param ctx Pointer to AMVP_CTX that was previously created by calling amvp_create_test_session.
+ * @param schedule The AMVP_VS_SCHEDULE to use
+ *
+ * @return AMVP_RESULT
+ */
+AMVP_RESULT amvp_set_vs_schedule(AMVP_CTX *ctx, AMVP_VS_SCHEDULE schedule);
+
+/**
+ * @brief amvp_set_worker_threads() sets how many threads libamvp uses to run the test cases of
+ *        a test group. With more than one thread, the crypto handler callbacks are invoked
+ *        concurrently for different test cases and MUST be thread-safe. Each invocation gets
+ *        its own AMVP_TEST_CASE, and responses are still written in tcId order. The default
+ *        of 1 runs every test case on the calling thread. Currently honored by RSA KeyGen
+ *        and hash AFT/VOT groups; other algorithms run serially. Not supported on Windows,
+ *        where test cases always run serially.
+ *
+ * @param ctx Pointer to AMVP_CTX that was previously created by calling amvp_create_test_session.
+ * @param threads Number of threads including the calling thread, between 1 and
+ *        AMVP_MAX_WORKER_THREADS
+ *
+ * @return AMVP_RESULT
+ */
+AMVP_RESULT amvp_set_worker_threads(AMVP_CTX *ctx, int threads);
+
+/**
+ * @brief amvp_set_worker_processes() forks \p processes worker processes that run the test
+ *        cases of a test group in parallel, for crypto modules that keep global state and are
+ *        not thread-safe. Each worker has its own copy of the module, as initialized when this
+ *        is called, so call it after initializing the module and before any other threads are
+ *        started. The test cases are copied to the workers and their results copied back;
+ *        the crypto handler callbacks run in the workers and must not rely on state changed in
+ *        the calling process afterwards. Replaces worker threads. Currently honored by RSA
+ *        KeyGen and hash AFT/VOT groups; other algorithms run on the calling thread. Buffers an
+ *        RSA KeyGen handler puts in fields libamvp doesn't allocate, such as prime_result or
+ *        p_rand, are freed by the worker once the test case is sent back, so they must come
+ *        from malloc(). A value of 0 stops the workers. Not supported on Windows, where test
+ *        cases always run serially.
+ *
+ * @param ctx Pointer to AMVP_CTX that was previously created by calling amvp_create_test_session.
+ * @param processes Number of worker processes, between 0 and AMVP_MAX_WORKER_PROCESSES
+ *
+ * @return AMVP_RESULT
+ */
+AMVP_RESULT amvp_set_worker_processes(AMVP_CTX *ctx, int processes);
+
+/**
+ * @brief amvp_set_worker_affinity() pins the worker threads or processes started afterwards by
+ *        amvp_set_worker_threads() or amvp_set_worker_processes(), so call it first. Workers
+ *        are dealt out to the NUMA nodes in turn, so each socket gets its share of them, and
+ *        are kept on the CPUs of their node, or on one CPU each. Their stacks and heaps, and
+ *        the test case buffers of worker processes, are then allocated on their own node. The
+ *        worker threads take work left on their own node before taking any from another.
+ *        Only CPUs the process is allowed to run on are used. Supported on Linux; elsewhere it
+ *        has no effect. AMVP_WORKER_AFFINITY_NONE by default.
+ *
+ * @param ctx Pointer to AMVP_CTX that was previously created by calling amvp_create_test_session.
+ * @param affinity Where the workers may run
+ *
+ * @return AMVP_RESULT
+ */
+AMVP_RESULT amvp_set_worker_affinity(AMVP_CTX *ctx, AMVP_WORKER_AFFINITY affinity);
+
+/**
+ * @brief amvp_set_lazy_file_parsing() changes how amvp_run_vectors_from_file() and
+ *        amvp_upload_vectors_from_file() read their input. When enabled, the file is memory
+ *        mapped and its top level array is parsed one element at a time, each vector set being
+ *        processed and freed before the next is parsed, so peak memory follows the largest
+ *        vector set rather than the whole file. Uploads go further and send each saved
+ *        response straight from the mapped file without parsing it at all, unless upload
+ *        compression is enabled. Disabled by default.
+ *
+ * @param ctx Pointer to AMVP_CTX that was previously created by calling amvp_create_test_session.
+ * @param enable 1 to parse lazily, 0 to parse the whole file up front
+ *
+ * @return AMVP_RESULT
+ */
+AMVP_RESULT amvp_set_lazy_file_parsing(AMVP_CTX *ctx, int enable);
+
+/**
+ * @brief amvp_set_vs_cache() keeps a binary cache next to each saved vector set request file,
+ *        named after it with ".amvb" appended. The cache is written when the vector sets are
+ *        saved with amvp_mark_as_request_only(), or the first time amvp_run_vectors_from_file()
+ *        reads the file. Later runs memory map the cache instead of parsing the JSON, and the
+ *        hex fields come out of it already decoded. A cache is only used while the request file
+ *        has the size and modification time it was made from; it is not portable between
+ *        hosts of different byte order. Takes precedence over amvp_set_lazy_file_parsing() when
+ *        running vectors. Disabled by default.
+ *
+ * @param ctx Pointer to AMVP_CTX that was previously created by calling amvp_create_test_session.
+ * @param enable 1 to write and use the cache, 0 to always parse the request file
+ *
+ * @return AMVP_RESULT
+ */
+AMVP_RESULT amvp_set_vs_cache(AMVP_CTX *ctx, int enable);
+
+/**
+ * @brief amvp_set_json_arena() makes libamvp allocate the JSON parse tree of each vector set,
+ *        and the response tree built for it, from an arena owned by the context. The arena is
+ *        dropped in one step once the responses are sent or saved, instead of freeing every
+ *        value, object and string. The allocator is only installed on the thread processing
+ *        the vector set, so other threads and test sessions using parson are not affected.
+ *        Disabled by default.
+ *
+ * @param ctx Pointer to AMVP_CTX that was previously created by calling amvp_create_test_session.
+ * @param enable 1 to use the arena, 0 to use malloc and free
+ *
+ * @return AMVP_RESULT
+ */
+AMVP_RESULT amvp_set_json_arena(AMVP_CTX *ctx, int enable);
+
+/**
+ * @brief amvp_set_json_compact() makes libamvp serialize the JSON it sends to the server and
+ *        the request, response and session files it saves without indentation. The output is
+ *        smaller and faster to produce. Vector set responses are always sent compact. Debug
+ *        output in the log stays pretty printed. Disabled by default.
+ *
+ * @param ctx Pointer to AMVP_CTX that was previously created by calling amvp_create_test_session.
+ * @param enable 1 for compact output, 0 to pretty print
+ *
+ * @return AMVP_RESULT
+ */
+AMVP_RESULT amvp_set_json_compact(AMVP_CTX *ctx, int enable);
+
+/**
+ * @brief amvp_set_upload_compression() makes libamvp gzip the bodies of large POST and PUT
+ *        requests, such as vector set responses, and send them with "Content-Encoding: gzip".
+ *        Only use this with servers that accept compressed requests. Responses from the server
+ *        are always requested with Accept-Encoding and decoded by libcurl, whether or not this
+ *        is enabled. Requires libamvp to be built with zlib. Disabled by default.
+ *
+ *        Uncompressed vector set responses are serialized as they are sent, with chunked
+ *        transfer encoding; a compressed one has to be serialized in full first.
+ *
+ * @param ctx Pointer to AMVP_CTX that was previously created by calling amvp_create_test_session.
+ * @param enable 1 to compress request bodies, 0 to send them as is
+ *
+ * @return AMVP_RESULT AMVP_UNSUPPORTED_OP if built without zlib
+ */
+AMVP_RESULT amvp_set_upload_compression(AMVP_CTX *ctx, int enable);
+
+/**
+ * @brief amvp_set_chunked_upload() makes libamvp send vector set responses larger than \p kbytes
+ *        in chunks of that size, so that a dropped connection only costs the chunk in flight
+ *        rather than the whole upload. Each chunk is its own POST (or PUT) to the results URL
+ *        with a "Content-Range: bytes <first>-<last>/<total>" header. The server acknowledges
+ *        each chunk but the last with 308 and a "Range: bytes=0-<last>" header naming how much
+ *        of the response it holds, and answers the last one as it would the whole response.
+ *        After a failed chunk libamvp asks the server how far it got, with an empty request
+ *        that has "*" in place of the byte range, and resumes from there, backing off between
+ *        attempts. The same empty request completes an upload the server holds all of without
+ *        having answered for it. A 308 that doesn't move the upload forward counts as a failed
+ *        chunk. Only use this with servers that support resumable uploads.
+ *        Uploads made by concurrent transfers, see amvp_set_max_concurrent_transfers(), are
+ *        chunked too; there, a chunk that fails leaves the vector set to be retried on its own
+ *        once the other transfers are done, like any other failed transfer.
+ *        Compressed uploads, see amvp_set_upload_compression(), are always sent whole.
+ *        Disabled by default.
+ *
+ * @param ctx Pointer to AMVP_CTX that was previously created by calling amvp_create_test_session.
+ * @param kbytes Size of each chunk in kilobytes, 0 to send responses whole
+ *
+ * @return AMVP_RESULT AMVP_UNSUPPORTED_OP if built with murl
+ */
+AMVP_RESULT amvp_set_chunked_upload(AMVP_CTX *ctx, int kbytes);
+
+/**
+ * @brief amvp_set_response_memory_budget() bounds the memory a vector set response takes while
+ *        it is being built, for test controllers with little RAM. Once more than \p kbytes of
+ *        the response are in memory, the completed part is moved to a temporary file and freed.
+ *        The response is then uploaded, or written to the offline response file, straight from
+ *        that file. Applies to the algorithms whose responses are streamed as they are built
+ *        (hash and DRBG); the others still build theirs in memory. Uploads that need the whole
+ *        body at once (upload compression, resume checkpoints, pipelined or concurrent
+ *        transfers) read it back into memory first. Disabled (0) by default.
+ *
+ * @param ctx Pointer to AMVP_CTX that was previously created by calling amvp_create_test_session.
+ * @param kbytes Response bytes to keep in memory, in KiB; 0 keeps all of it in memory
+ *
+ * @return AMVP_RESULT
+ */
+AMVP_RESULT amvp_set_response_memory_budget(AMVP_CTX *ctx, int kbytes);
+
+/**
+ * @brief amvp_set_jwt_renewal() sets how long before it expires the access token is renewed.
+ *        The expiry is read from each token the server hands out, and a background thread
+ *        logs in to renew the token ahead of time, so requests, concurrent ones included, never
+ *        go out with an expired token and stall on a login. The TOTP callback, if set, is then
+ *        called from that thread. Where there is no such thread, or the renewal hasn't come back
+ *        by AMVP_JWT_RENEW_MIN seconds before expiry, the token is renewed before the next
+ *        request instead. On by default, renewing a quarter of the token's lifetime ahead.
+ *
+ * @param ctx Pointer to AMVP_CTX that was previously created by calling amvp_create_test_session.
+ * @param margin Seconds before expiry to renew at; 0 for a quarter of the token's lifetime;
+ *        negative to only log in again once the server rejects the token
+ *
+ * @return AMVP_RESULT
+ */
+AMVP_RESULT amvp_set_jwt_renewal(AMVP_CTX *ctx, int margin);
+
+/**
+ * @brief How often the vector request file saved with amvp_mark_as_request_only() is flushed
+ *        to disk, see amvp_set_request_file_buffer()
+ */
+typedef enum amvp_fsync_policy {
+    AMVP_FSYNC_NONE = 0,    /**< Leave it to the operating system */
+    AMVP_FSYNC_ON_CLOSE,    /**< Once the file is complete */
+    AMVP_FSYNC_EACH_SET     /**< After every vector set */
+} AMVP_FSYNC_POLICY;
+
+/**
+ * @brief amvp_set_request_file_buffer() configures how vector sets are saved to the file given
+ *        to amvp_mark_as_request_only(). The file is opened once, when the first vector set is
+ *        saved, and each set is serialized straight into it through a buffer of \p kbytes KiB.
+ *        The enclosing array is closed, and the file with it, once every set has been saved.
+ *        \p fsync decides whether, and how often, the file is flushed to disk as it is written.
+ *        Defaults to a 256 KiB buffer and AMVP_FSYNC_NONE.
+ *
+ * @param ctx Pointer to AMVP_CTX that was previously created by calling amvp_create_test_session.
+ * @param kbytes Size of the write buffer in KiB, at most 1048576; 0 for the default
+ * @param fsync One of AMVP_FSYNC_POLICY
+ *
+ * @return AMVP_RESULT
+ */
+AMVP_RESULT amvp_set_request_file_buffer(AMVP_CTX *ctx, int kbytes, AMVP_FSYNC_POLICY fsync);
+
+/**
+ * @brief amvp_set_incremental_parse() makes libamvp process the test groups of a vector set
+ *        while the rest of it is still downloading. Each test group is parsed and run through
+ *        the KAT handler as soon as it has arrived, on a separate thread, and the responses are
+ *        collected into one vector set response as usual. Should the set not be laid out as
+ *        expected, it is parsed and processed once fully downloaded instead. This applies to
+ *        vector sets downloaded one at a time, and has no effect when checkpointing, saving
+ *        vector set requests to file, or with amvp_set_pipeline_depth(). The crypto handlers
+ *        may then be called from that thread rather than the caller's. Disabled by default.
+ *
+ * @param ctx Pointer to AMVP_CTX that was previously created by calling amvp_create_test_session.
+ * @param enable 1 to process test groups as they arrive, 0 to wait for the whole vector set
+ *
+ * @return AMVP_RESULT
+ */
+AMVP_RESULT amvp_set_incremental_parse(AMVP_CTX *ctx, int enable);
+
+/**
+ * @brief amvp_set_pipeline_depth() overlaps the network traffic of a test session with the
+ *        crypto work. Each vector set is run through the KAT handlers on a separate thread
+ *        while libamvp goes on downloading the next ones and uploading finished responses.
+ *        Vector sets are still processed one at a time and in the order they are downloaded;
+ *        \p depth limits how many may be downloaded ahead of the one being processed, so no
+ *        more than depth + 1 are held in memory. This applies to vector sets and to TE sets,
+ *        and combines with amvp_set_max_concurrent_transfers(). It has no effect when saving
+ *        vector set requests to file. The crypto handlers and the logging callback are then
+ *        called from that thread rather than the caller's. Disabled (0) by default.
+ *
+ * @param ctx Pointer to AMVP_CTX that was previously created by calling amvp_create_test_session.
+ * @param depth Vector sets to download ahead, between 0 and AMVP_MAX_PIPELINE_DEPTH
+ *
+ * @return AMVP_RESULT
+ */
+AMVP_RESULT amvp_set_pipeline_depth(AMVP_CTX *ctx, int depth);
+
+/**
+ * @brief amvp_set_http2() makes libamvp offer HTTP/2 to the server, falling back to HTTP/1.1
+ *        when the server doesn't accept it. Concurrent vector set transfers (see
+ *        amvp_set_max_concurrent_transfers()) are then multiplexed as streams over a single
+ *        connection instead of each opening its own. TLS 1.3 is also allowed, and TLS sessions
+ *        are resumed on later connections to the server. Requires libcurl built with HTTP/2
+ *        support. Disabled by default, in which case HTTP/1.1 over TLS 1.2 is used.
+ *
+ * @param ctx Pointer to AMVP_CTX that was previously created by calling amvp_create_test_session.
+ * @param enable 1 to negotiate HTTP/2 and TLS 1.3, 0 to use HTTP/1.1 over TLS 1.2
+ *
+ * @return AMVP_RESULT AMVP_UNSUPPORTED_OP if libcurl has no HTTP/2 support
+ */
+AMVP_RESULT amvp_set_http2(AMVP_CTX *ctx, int enable);
+
+/**
+ * @brief amvp_set_async_logging() moves logging off the threads doing the work. Messages are
+ *        queued in a ring of \p slots entries and a background thread passes them to the
+ *        progress callback given to amvp_create_test_session() in batches, flushing stdout
+ *        once per batch instead of after every message. If \p record_file is given, messages
+ *        are instead written to that file as AMVP_LOG_RECORDs, and the callback isn't called.
+ *        When the ring is full, logging waits for the background thread rather than dropping
+ *        messages. Queued messages are written before amvp_free_test_session() returns.
+ *        Must be called before amvp_run() or amvp_run_async(), and not on a context in a
+ *        session group. Not available on Windows. Disabled by default.
+ *
+ * @param ctx Pointer to AMVP_CTX that was previously created by calling amvp_create_test_session.
+ * @param slots Messages that can be queued, rounded up to a power of 2; 0 goes back to
+ *        synchronous logging. At most AMVP_MAX_LOG_SLOTS.
+ * @param record_file Path of a file to write binary records to, or NULL to use the callback
+ *
+ * @return AMVP_RESULT
+ */
+AMVP_RESULT amvp_set_async_logging(AMVP_CTX *ctx, int slots, const char *record_file);
+
+/**
+ * @brief amvp_set_metrics() records where the time of each vector set goes: downloading,
+ *        waiting on retries, parsing, the KAT handler and crypto callbacks, and uploading, along
+ *        with test case counts and bytes sent and received. It also counts the library's heap
+ *        allocations, including parson's, to report the bytes and number of allocations of each
+ *        phase and the most memory held while a set was processed. Memory is counted over the
+ *        whole process, so sets processed at the same time in another context show up in each
+ *        other's peak. Query the results with
+ *        amvp_get_vs_metrics(), amvp_get_alg_metrics() or amvp_get_metrics_json() once the
+ *        vector sets have been processed. If \p json_file is given, the JSON form is also
+ *        written there when amvp_run() (or an amvp_run_async() session) finishes. Must be
+ *        called before the session is run. Disabling it drops what was recorded.
+ *        Disabled by default.
+ *
+ * @param ctx Pointer to AMVP_CTX that was previously created by calling amvp_create_test_session.
+ * @param enable 1 to collect metrics, 0 to stop
+ * @param json_file File to write the metrics to at the end of the run, or NULL
+ *
+ * @return AMVP_RESULT
+ */
+AMVP_RESULT amvp_set_metrics(AMVP_CTX *ctx, int enable, const char *json_file);
+
+/**
+ * @brief amvp_get_vs_metrics() copies the metrics of one vector set, in the order the sets were
+ *        first downloaded.
+ *
+ * @param ctx Pointer to AMVP_CTX that was previously created by calling amvp_create_test_session.
+ * @param index Index of the vector set, starting at 0
+ * @param metrics Filled in with the metrics of the set
+ *
+ * @return AMVP_RESULT AMVP_NO_DATA once index is past the last set, or if metrics are disabled
+ */
+AMVP_RESULT amvp_get_vs_metrics(AMVP_CTX *ctx, int index, AMVP_VS_METRICS *metrics);
+
+/**
+ * @brief amvp_get_alg_metrics() copies the metrics of every vector set of one algorithm summed
+ *        up, in the order each algorithm was first seen.
+ *
+ * @param ctx Pointer to AMVP_CTX that was previously created by calling amvp_create_test_session.
+ * @param index Index of the algorithm, starting at 0
+ * @param metrics Filled in with the totals for the algorithm
+ *
+ * @return AMVP_RESULT AMVP_NO_DATA once index is past the last algorithm
+ */
+AMVP_RESULT amvp_get_alg_metrics(AMVP_CTX *ctx, int index, AMVP_ALG_METRICS *metrics);
+
+/**
+ * @brief amvp_get_metrics_json() returns the metrics of every vector set, and the totals per
+ *        algorithm, as a JSON string. The caller frees it with free().
+ *
+ * @param ctx Pointer to AMVP_CTX that was previously created by calling amvp_create_test_session.
+ * @param len Set to the length of the string if not NULL
+ *
+ * @return char* NULL if metrics are disabled or on failure
+ */
+char *amvp_get_metrics_json(AMVP_CTX *ctx, int *len);
+
+/**
+ * @brief amvp_get_net_timing() copies libcurl's timing breakdown of one HTTP request made
+ *        while metrics were on, in the order the requests finished. Requests for a vector set
+ *        are also summed up into its net_setup_ms, server_wait_ms and transfer_ms, so a slow
+ *        server can be told apart from TLS overhead and a slow link.
+ *
+ * @param ctx Pointer to AMVP_CTX that was previously created by calling amvp_create_test_session.
+ * @param index Index of the request, starting at 0
+ * @param timing Filled in with the timings of the request
+ *
+ * @return AMVP_RESULT AMVP_NO_DATA once index is past the last request, or if metrics are
+ *         disabled
+ */
+AMVP_RESULT amvp_get_net_timing(AMVP_CTX *ctx, int index, AMVP_NET_TIMING *timing);
+
+/**
+ * @brief amvp_set_net_trace() writes the timing breakdown of every HTTP request, see
+ *        amvp_get_net_timing(), to \p har_file in the HTTP Archive (HAR) format browsers and
+ *        HAR viewers read, when amvp_run() (or an amvp_run_async() session) finishes. Headers
+ *        and bodies are left out. Needs amvp_set_metrics() to be enabled first, and is dropped
+ *        with them.
+ *
+ * @param ctx Pointer to AMVP_CTX that was previously created by calling amvp_create_test_session.
+ * @param har_file File to write the trace to, or NULL to stop writing it
+ *
+ * @return AMVP_RESULT AMVP_UNSUPPORTED_OP if metrics are disabled
+ */
+AMVP_RESULT amvp_set_net_trace(AMVP_CTX *ctx, const char *har_file);
+
+/**
+ * @brief amvp_set_metadata_cache() keeps the server listing pages that the module, vendor,
+ *        OE and dependency lookups of a FIPS validation were matched on in \p cache_file. The
+ *        next validation revalidates each page with its ETag, and when the server answers
+ *        304 Not Modified matches against the cached copy instead of paging through the
+ *        listing again. The file is read now and written when the session is freed.
+ *        Disabled by default.
+ *
+ * @param ctx Pointer to AMVP_CTX that was previously created by calling amvp_create_test_session.
+ * @param cache_file Path of the cache file, created if it doesn't exist; NULL disables the cache
+ *
+ * @return AMVP_RESULT
+ */
+AMVP_RESULT amvp_set_metadata_cache(AMVP_CTX *ctx, const char *cache_file);
+
+/**
+ * @brief amvp_set_evidence_store() loads the evidence for the automated TEs of IE sets from
+ *        \p store_file, a JSON object keyed by TE id. Each value is either the evidence string
+ *        itself, or {"file": path} naming an artifact (a PDF, a log) to send base64 encoded. A
+ *        relative path is taken from the directory of \p store_file. Files are only opened
+ *        when an IE set asks for them, and are encoded a chunk at a time as the response is
+ *        built, so they are never held in memory as a whole. TEs that have no evidence are
+ *        skipped as not automated. Replaces any evidence loaded or added before; without any,
+ *        built in example evidence is used.
+ *
+ * @param ctx Pointer to AMVP_CTX that was previously created by calling amvp_create_test_session.
+ * @param store_file Path of the mapping file; NULL drops the store
+ *
+ * @return AMVP_RESULT AMVP_JSON_ERR if the file is missing or malformed, leaving the store as it was
+ */
+AMVP_RESULT amvp_set_evidence_store(AMVP_CTX *ctx, const char *store_file);
+
+/**
+ * @brief amvp_add_evidence() adds the evidence string for one TE to the evidence store,
+ *        replacing any it already has. See amvp_set_evidence_store().
+ *
+ * @param ctx Pointer to AMVP_CTX that was previously created by calling amvp_create_test_session.
+ * @param te_id TE id, e.g. "TE02.20.01"
+ * @param evidence Evidence to send as is
+ *
+ * @return AMVP_RESULT
+ */
+AMVP_RESULT amvp_add_evidence(AMVP_CTX *ctx, const char *te_id, const char *evidence);
+
+/**
+ * @brief amvp_add_evidence_file() adds a file as the evidence for one TE to the evidence store,
+ *        replacing any it already has. The file is read and base64 encoded when an IE set asks
+ *        for the TE. See amvp_set_evidence_store().
+ *
+ * @param ctx Pointer to AMVP_CTX that was previously created by calling amvp_create_test_session.
+ * @param te_id TE id, e.g. "TE04.11.01"
+ * @param path Path of the artifact
+ *
+ * @return AMVP_RESULT
+ */
+AMVP_RESULT amvp_add_evidence_file(AMVP_CTX *ctx, const char *te_id, const char *path);
+
+/**
+ * @brief amvp_set_resume_checkpoints() journals each vector set as it is downloaded,
+ *        processed and uploaded, in <session>.journal next to the session info file, and
+ *        keeps the downloaded vector sets and finished responses there until the server has
+ *        them. amvp_resume_test_session() then finishes those vector sets from disk,
+ *        without downloading them again or repeating the crypto. A resumed session uses the
+ *        journal whenever one exists. Disabled by default.
+ *
+ * @param ctx Pointer to AMVP_CTX that was previously created by calling amvp_create_test_session.
+ * @param enable 1 to write checkpoints, 0 to not
+ *
+ * @return AMVP_RESULT
+ */
+AMVP_RESULT amvp_set_resume_checkpoints(AMVP_CTX *ctx, int enable);
+
+/**
+ * @brief amvp_set_crypto_cache() remembers the results of the test cases whose outputs only
+ *        depend on their inputs (hash AFT and VOT, HMAC and CMAC generate), keyed by the
+ *        cipher, test type and inputs. A test case seen before, in this session or in one
+ *        that used the same \p cache_file, gets its results from the cache instead of the
+ *        crypto_handler. Randomized test cases, such as DRBG, keygen and siggen, are never
+ *        cached. The cache file is only valid for one build of the module: use a new file
+ *        after changing it. The file is read now and written when the session is freed.
+ *        Disabled by default.
+ *
+ * @param ctx Pointer to AMVP_CTX that was previously created by calling amvp_create_test_session.
+ * @param enable 1 to cache the results, 0 to not
+ * @param cache_file Path of the cache file, created if it doesn't exist; NULL keeps the cache
+ *        in memory only
+ *
+ * @return AMVP_RESULT
+ */
+AMVP_RESULT amvp_set_crypto_cache(AMVP_CTX *ctx, int enable, const char *cache_file);
+
 /**
  * @brief amvp_mark_as_sample() marks the registration as a sample. This function sets a flag that
  *        will allow the client to retrieve the correct answers later on, allowing for comparison
@@ -4169,6 +5005,46 @@ AMVP_RESULT amvp_mark_as_put_after_test(AMVP_CTX *ctx, char *filename);
  */
 int amvp_get_vector_set_count(AMVP_CTX *ctx);
 
+/**
+ * @brief amvp_estimate_workload() estimates the test cases, payload sizes and processing time of
+ *        a session from the current registration, before it is started. Each registration entry
+ *        is expected to be one vector set, costed with the model of its algorithm. The built in
+ *        models are rough averages, calibrate them with amvp_set_workload_model() for closer
+ *        figures. The estimate of each vector set can be read with amvp_get_workload_estimate().
+ *
+ * @param ctx Pointer to AMVP_CTX with registered algorithms
+ * @param total Set to the sums over every vector set
+ *
+ * @return AMVP_RESULT, AMVP_NO_DATA if nothing is registered
+ */
+AMVP_RESULT amvp_estimate_workload(AMVP_CTX *ctx, AMVP_WORKLOAD_ESTIMATE *total);
+
+/**
+ * @brief amvp_get_workload_estimate() returns the estimate of one vector set, as of the last
+ *        amvp_estimate_workload(), in the order of the registration.
+ *
+ * @param ctx Pointer to AMVP_CTX that was previously created by calling amvp_create_test_session.
+ * @param index 0 based index of the vector set
+ * @param estimate Set to the vector set's estimate
+ *
+ * @return AMVP_RESULT, AMVP_NO_DATA once index is past the last vector set
+ */
+AMVP_RESULT amvp_get_workload_estimate(AMVP_CTX *ctx, int index, AMVP_WORKLOAD_ESTIMATE *estimate);
+
+/**
+ * @brief amvp_set_workload_model() replaces the cost model amvp_estimate_workload() uses for an
+ *        algorithm, for instance with figures measured by katbench ("make bench") and with the
+ *        module's own crypto timings. A model set for "algorithm/mode" wins over one set for
+ *        "algorithm".
+ *
+ * @param ctx Pointer to AMVP_CTX that was previously created by calling amvp_create_test_session.
+ * @param algorithm The registration's "algorithm", or "algorithm/mode"
+ * @param model The costs, copied
+ *
+ * @return AMVP_RESULT
+ */
+AMVP_RESULT amvp_set_workload_model(AMVP_CTX *ctx, const char *algorithm, const AMVP_WORKLOAD_MODEL *model);
+
 /**
  * @brief Performs the AMVP testing procedures.
  *        This function will do the following actions:
@@ -4189,6 +5065,120 @@ int amvp_get_vector_set_count(AMVP_CTX *ctx);
  */
 AMVP_RESULT amvp_run(AMVP_CTX *ctx, int fips_validation);
 
+/**
+ * @brief amvp_run_async() starts the same procedure as amvp_run() without blocking the caller.
+ *        The session is then moved along by calling amvp_step() whenever one of the sockets
+ *        given by amvp_async_fdset() is ready or the time given by amvp_async_timeout() has
+ *        passed. Since no call waits on the server, one thread can drive many sessions, each
+ *        on its own AMVP_CTX, from a single select() loop.
+ *
+ *        Vector set downloads and uploads, and the waits the server asks for before retrying
+ *        them or while results are pending, never block. Login, registration, the results
+ *        query itself and the final validation are each made as one request within a step.
+ *        Saving vector set requests to file, builds without the curl multi interface and
+ *        one-off operations (GET, POST, DELETE...) run to completion inside a single step.
+ *
+ * @param ctx Pointer to AMVP_CTX that was previously created by calling amvp_create_test_session.
+ * @param fips_validation A flag to indicate whether a fips validation is being performed on the
+ *        test session
+ * @return AMVP_RESULT AMVP_UNSUPPORTED_OP if a session is already running on \p ctx
+ */
+AMVP_RESULT amvp_run_async(AMVP_CTX *ctx, int fips_validation);
+
+/**
+ * @brief amvp_step() does the work that is ready for a session started with amvp_run_async().
+ *        Calling it early is harmless; it returns without doing anything if the session is
+ *        waiting on the server.
+ *
+ * @param ctx Pointer to AMVP_CTX that was previously created by calling amvp_create_test_session.
+ * @param done Set to 1 once the session has finished, in which case the return value is the
+ *        outcome of the session as amvp_run() would have returned it
+ * @return AMVP_RESULT AMVP_SUCCESS while the session is still in progress
+ */
+AMVP_RESULT amvp_step(AMVP_CTX *ctx, int *done);
+
+/**
+ * @brief amvp_async_fdset() adds the sockets a session started with amvp_run_async() is
+ *        waiting on to the given sets, for use with select(). Sets for several sessions can
+ *        be built up by calling this once for each context.
+ *
+ * @param ctx Pointer to AMVP_CTX that was previously created by calling amvp_create_test_session.
+ * @param read_fds Set of sockets to wait for reading on
+ * @param write_fds Set of sockets to wait for writing on
+ * @param exc_fds Set of sockets to wait for exceptions on
+ * @param max_fd Raised to the highest socket added, left unchanged if none are
+ * @return AMVP_RESULT
+ */
+AMVP_RESULT amvp_async_fdset(AMVP_CTX *ctx, fd_set *read_fds, fd_set *write_fds,
+                             fd_set *exc_fds, int *max_fd);
+
+/**
+ * @brief amvp_async_timeout() gives the longest time the caller may wait before calling
+ *        amvp_step() again when none of the sockets become ready.
+ *
+ * @param ctx Pointer to AMVP_CTX that was previously created by calling amvp_create_test_session.
+ * @param timeout_ms Set to the timeout in milliseconds, 0 to step right away, or -1 if no
+ *        session is running
+ * @return AMVP_RESULT
+ */
+AMVP_RESULT amvp_async_timeout(AMVP_CTX *ctx, long *timeout_ms);
+
+/**
+ * @brief amvp_session_group_create() creates a group for running many test sessions, one per
+ *        AMVP_CTX, from one process. The contexts attached to the group share one libcurl
+ *        connection, DNS and TLS session cache, so only the first session to reach the server
+ *        pays for a full TLS handshake. The HTTP user-agent is worked out once for the group,
+ *        and curl_global_init() is called here instead of implicitly on each context's first
+ *        request.
+ *
+ * @param group Pointer to the group to create, must point to NULL
+ * @param threads Number of sessions amvp_session_group_run() runs at once, between 1 and
+ *        AMVP_MAX_WORKER_THREADS
+ *
+ * @return AMVP_RESULT
+ */
+AMVP_RESULT amvp_session_group_create(AMVP_SESSION_GROUP **group, int threads);
+
+/**
+ * @brief amvp_session_group_attach() adds a context to the group. Attach it before calling
+ *        amvp_set_server() on it so the user-agent probing is skipped. A context can be in one
+ *        group at a time; freeing it with amvp_free_test_session() takes it out of the group.
+ *        Each context still logs in and registers on its own, since its credentials and JWT
+ *        are its own.
+ *
+ * @param group The group to add \p ctx to
+ * @param ctx Pointer to AMVP_CTX that was previously created by calling amvp_create_test_session.
+ *
+ * @return AMVP_RESULT
+ */
+AMVP_RESULT amvp_session_group_attach(AMVP_SESSION_GROUP *group, AMVP_CTX *ctx);
+
+/**
+ * @brief amvp_session_group_run() calls amvp_run() for every context in the group, running up
+ *        to the group's thread count of them at once, and returns when all have finished. The
+ *        crypto handlers and logging callbacks of different contexts may then be called at the
+ *        same time from different threads.
+ *
+ * @param group The group to run
+ * @param fips_validation Passed to amvp_run() for every context
+ * @param results Optional array, one entry per attached context in attach order, that receives
+ *        the result of each amvp_run()
+ *
+ * @return AMVP_RESULT AMVP_SUCCESS if every session succeeded, otherwise the first failure in
+ *         attach order
+ */
+AMVP_RESULT amvp_session_group_run(AMVP_SESSION_GROUP *group, int fips_validation, AMVP_RESULT *results);
+
+/**
+ * @brief amvp_session_group_free() frees the group. Contexts still attached are taken out of it
+ *        and can go on being used, or freed, on their own.
+ *
+ * @param group The group to free, may be NULL
+ *
+ * @return AMVP_RESULT
+ */
+AMVP_RESULT amvp_session_group_free(AMVP_SESSION_GROUP *group);
+
 AMVP_RESULT amvp_oe_ingest_metadata(AMVP_CTX *ctx, const char *metadata_file);
 
 AMVP_RESULT amvp_oe_set_fips_validation_metadata(AMVP_CTX *ctx,
@@ -4272,6 +5262,38 @@ AMVP_RESULT amvp_upload_vectors_from_file(AMVP_CTX *ctx, const char *rsp_filenam
  */
 AMVP_RESULT amvp_run_vectors_from_file(AMVP_CTX *ctx, const char *req_filename, const char *rsp_filename);
 
+/**
+ * @brief Splits an offline vector set file, as saved by amvp_mark_as_request_only(), into
+ *        \p shard_count files that amvp_run_vectors_from_file() can process independently, on
+ *        separate processes or hosts. Vector sets are spread so the shards are about the same
+ *        size; each shard keeps the session identifiers of the original file.
+ *
+ * @param ctx Pointer to AMVP_CTX that was previously created by calling amvp_create_test_session.
+ * @param req_filename Name of the file that contains the unprocessed vector sets
+ * @param shard_filenames Names of the \p shard_count files to write the shards to
+ * @param shard_count Number of shards, at least 1
+ *
+ * @return AMVP_RESULT
+ */
+AMVP_RESULT amvp_shard_request_file(AMVP_CTX *ctx, const char *req_filename,
+                                    const char **shard_filenames, int shard_count);
+
+/**
+ * @brief Merges the response files that amvp_run_vectors_from_file() wrote for the shards of
+ *        one request file into a single file for amvp_upload_vectors_from_file(). The files
+ *        must all belong to the same test session, and have a response for each of their
+ *        vector sets.
+ *
+ * @param ctx Pointer to AMVP_CTX that was previously created by calling amvp_create_test_session.
+ * @param rsp_filenames Names of the \p rsp_count shard response files
+ * @param rsp_count Number of shard response files, at least 1
+ * @param rsp_filename Name of the file to save the merged responses to
+ *
+ * @return AMVP_RESULT
+ */
+AMVP_RESULT amvp_merge_response_files(AMVP_CTX *ctx, const char **rsp_filenames, int rsp_count,
+                                      const char *rsp_filename);
+
 /**
  * @brief performs an HTTP PUT on a given libamvp JSON file to the ACV server
  *
@@ -4304,6 +5326,24 @@ AMVP_RESULT amvp_get_results_from_server(AMVP_CTX *ctx, const char *request_file
  */
 AMVP_RESULT amvp_get_expected_results(AMVP_CTX *ctx, const char *request_filename, const char *save_filename);
 
+/**
+ * @brief Checks the responses in a file against the expected results of a sample test session,
+ *        locally instead of uploading them and waiting for the server to grade them. Test cases
+ *        are matched up by vsId, tgId and tcId and compared on several threads (see
+ *        amvp_set_worker_threads()). Each mismatch is logged, up to a limit per algorithm, and a
+ *        summary per algorithm is logged at the end.
+ *
+ * @param ctx Pointer to AMVP_CTX that was previously created by calling amvp_create_test_session.
+ * @param rsp_filename Response file, as written by amvp_run_vectors_from_file()
+ * @param expected_filename Expected results, as saved by amvp_get_expected_results()
+ * @param mismatches Set to the number of test cases that did not match, including ones missing
+ *        from either file. OPTIONAL.
+ *
+ * @return AMVP_RESULT, AMVP_SUCCESS if the files could be compared, whether they match or not
+ */
+AMVP_RESULT amvp_verify_expected_results(AMVP_CTX *ctx, const char *rsp_filename,
+                                         const char *expected_filename, int *mismatches);
+
 /**
  * @brief Queries the server for any vector sets that have not received a response (e.x. in case of
  *        lose of connectivity during testing), downloads those vector sets, and continues to
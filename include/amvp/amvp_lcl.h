@@ -10,40 +10,74 @@
 #ifndef amvp_lcl_h
 #define amvp_lcl_h
 
+#include <stdio.h>
+#include <stdarg.h>
+#include <time.h>
+#include <stdlib.h>
+#include <string.h>
 #include "parson.h"
 
+/*
+ * Counting versions of the C library allocation functions, for the memory
+ * figures of amvp_set_metrics(). They call the C library directly while no
+ * context has metrics on. Only allocations made through them are counted;
+ * free their blocks with amvp_mem_free() to keep the live byte count right.
+ */
+void *amvp_mem_malloc(size_t size);
+void *amvp_mem_calloc(size_t num, size_t size);
+void *amvp_mem_realloc(void *ptr, size_t size);
+char *amvp_mem_strdup(const char *str);
+void amvp_mem_free(void *ptr);
+
 #define AMVP_VERSION    "1.0"
 #define AMVP_LIBRARY_VERSION_NUMBER "0.1.0"
 #define AMVP_LIBRARY_VERSION    "libamvp_oss-0.1.0"
 
+/*
+ * The logging macros check the level before calling amvp_log_msg(), so the
+ * arguments to a message that won't be shown are never evaluated or
+ * formatted. Wrap anything expensive that is only built for a log message,
+ * such as a serialized JSON dump, in AMVP_LOG_ENABLED() as well.
+ */
+#define AMVP_LOG_ENABLED(lvl) (ctx && (ctx->test_progress_cb || ctx->log_sink) && ctx->log_lvl >= (lvl))
 
 #ifndef AMVP_LOG_ERR
 #define AMVP_LOG_ERR(msg, ...) do { \
-        amvp_log_msg(ctx, AMVP_LOG_LVL_ERR, __func__, __LINE__, msg, ##__VA_ARGS__); \
+        if (AMVP_LOG_ENABLED(AMVP_LOG_LVL_ERR)) { \
+            amvp_log_msg(ctx, AMVP_LOG_LVL_ERR, __func__, __LINE__, msg, ##__VA_ARGS__); \
+        } \
 } while (0)
 #endif
 
 #ifndef AMVP_LOG_WARN
 #define AMVP_LOG_WARN(msg, ...) do { \
-        amvp_log_msg(ctx, AMVP_LOG_LVL_WARN, __func__, __LINE__, msg, ##__VA_ARGS__); \
+        if (AMVP_LOG_ENABLED(AMVP_LOG_LVL_WARN)) { \
+            amvp_log_msg(ctx, AMVP_LOG_LVL_WARN, __func__, __LINE__, msg, ##__VA_ARGS__); \
+        } \
 } while (0)
 #endif
 
 #ifndef AMVP_LOG_STATUS
 #define AMVP_LOG_STATUS(msg, ...)  do { \
-        amvp_log_msg(ctx, AMVP_LOG_LVL_STATUS, __func__, __LINE__, msg, ##__VA_ARGS__); \
+        if (AMVP_LOG_ENABLED(AMVP_LOG_LVL_STATUS)) { \
+            amvp_log_msg(ctx, AMVP_LOG_LVL_STATUS, __func__, __LINE__, msg, ##__VA_ARGS__); \
+        } \
 } while (0)
 #endif
 
 #ifndef AMVP_LOG_INFO
 #define AMVP_LOG_INFO(msg, ...) do { \
-        amvp_log_msg(ctx, AMVP_LOG_LVL_INFO, __func__, __LINE__, msg, ##__VA_ARGS__); \
+        if (AMVP_LOG_ENABLED(AMVP_LOG_LVL_INFO)) { \
+            amvp_log_msg(ctx, AMVP_LOG_LVL_INFO, __func__, __LINE__, msg, ##__VA_ARGS__); \
+        } \
 } while (0)
 #endif
 
 #ifndef AMVP_LOG_VERBOSE
 #define AMVP_LOG_VERBOSE(msg, ...) do { \
-        amvp_log_msg(ctx, AMVP_LOG_LVL_VERBOSE, __func__, __LINE__, msg, ##__VA_ARGS__); \
+        if (AMVP_LOG_ENABLED(AMVP_LOG_LVL_VERBOSE)) { \
+            amvp_log_msg(ctx, AMVP_LOG_LVL_VERBOSE, __func__, __LINE__, msg, ##__VA_ARGS__); \
+        } \
 } while (0)
 #endif
 
@@ -58,6 +92,33 @@
 #define AMVP_LOG_TRUNCATED_STR_LEN 14
 #define AMVP_LOG_MAX_MSG_LEN 2048
 
+/*
+ * Static tracepoints (USDT) for bpftrace, perf or SystemTap, built in with
+ * --enable-usdt, which defines AMVP_USDT and needs <sys/sdt.h>. Otherwise
+ * they compile to nothing and their arguments aren't evaluated. Each one is
+ * a nop instruction when built in and no tracer is attached. Provider
+ * "libamvp", probes and arguments:
+ *
+ *   vs__start(vs_id, algorithm, mode)    vs__done(vs_id, rv)
+ *   tc__start(cipher, tc)                tc__done(cipher, ret)
+ *   mct__iter(cipher, iteration)
+ *   json__parse__start(buf)              json__parse__done(buf, ok)
+ *   json__serialize__start(vs_id)        json__serialize__done(vs_id, len)
+ *   http__start(action, url)             http__done(action, http_code, rv)
+ *
+ * e.g. bpftrace -e 'usdt:/usr/local/lib/libamvp.so:libamvp:tc__start { @[arg0] = count(); }'
+ */
+#ifdef AMVP_USDT
+#include <sys/sdt.h>
+#define AMVP_TRACE1(probe, a) DTRACE_PROBE1(libamvp, probe, a)
+#define AMVP_TRACE2(probe, a, b) DTRACE_PROBE2(libamvp, probe, a, b)
+#define AMVP_TRACE3(probe, a, b, c) DTRACE_PROBE3(libamvp, probe, a, b, c)
+#else
+#define AMVP_TRACE1(probe, a) do { } while (0)
+#define AMVP_TRACE2(probe, a, b) do { } while (0)
+#define AMVP_TRACE3(probe, a, b, c) do { } while (0)
+#endif
+
 #define AMVP_BIT2BYTE(x) ((x + 7) >> 3) /**< Convert bit length (x, of type integer) into byte length */
 
 #define AMVP_ALG_MAX AMVP_CIPHER_END - 1  /* Used by alg_tbl[] */
@@ -515,6 +576,8 @@
 #define AMVP_HASH_MSG_BIT_MAX 65536                         /**< 65536 bits */
 #define AMVP_HASH_MSG_STR_MAX (AMVP_HASH_MSG_BIT_MAX >> 2)  /**< 16384 characters */
 #define AMVP_HASH_MSG_BYTE_MAX (AMVP_HASH_MSG_BIT_MAX >> 3) /**< 8192 bytes */
+#define AMVP_HASH_LDT_CHUNK_BYTES (1 << 20) /**< LDT content is fed to hash_update in chunks of about this size */
+#define AMVP_HASH_LDT_BIT_MAX (8ULL << 33)  /**< 8 GiB */
 #define AMVP_HASH_MD_BIT_MAX 512                            /**< 512 bits */
 #define AMVP_HASH_MD_STR_MAX (AMVP_HASH_MD_BIT_MAX >> 2)    /**< 128 characters */
 #define AMVP_HASH_MD_BYTE_MAX (AMVP_HASH_MD_BIT_MAX >> 3)   /**< 64 bytes */
@@ -857,13 +920,16 @@
 #define AMVP_KDA_Z_BYTE_MAX (AMVP_KDA_Z_BIT_MAX >> 3)
 
 
-#define AMVP_CURL_BUF_MAX       (1024 * 1024 * 64) /**< 64 MB */
+#define AMVP_CURL_BUF_MAX       (1024 * 1024 * 64) /**< 64 MB, bound used when scanning server error strings */
+#define AMVP_CURL_BUF_INIT_SIZE (1024 * 16) /**< Starting size of curl_buf when no Content-Length is given */
 #define AMVP_RETRY_TIME_MIN     5 /* seconds */
 #define AMVP_RETRY_TIME_MAX     300 
 #define AMVP_MAX_WAIT_TIME      7200
 #define AMVP_RETRY_TIME         30
 #define AMVP_RETRY_MODIFIER_MAX 10
 #define AMVP_JWT_TOKEN_MAX      2048
+#define AMVP_JWT_RENEW_MIN      30 /* seconds before expiry a token is renewed at the latest */
+#define AMVP_JWT_RENEW_RETRY    30 /* seconds between attempts when a renewal fails */
 #define AMVP_ATTR_URL_MAX       2083 /* MS IE's limit - arbitrary */
 
 #define AMVP_SESSION_PARAMS_STR_LEN_MAX 256
@@ -1015,21 +1081,38 @@ typedef enum amvp_capability_type {
 } AMVP_CAP_TYPE;
 
 /*
- * Supported length list
- */
-typedef struct amvp_sl_list_t {
-    int length;
-    struct amvp_sl_list_t *next;
-} AMVP_SL_LIST;
-
-/*
- * Supported param list
+ * Ordered param list, for sequences such as a KDA fixedInfoPattern where
+ * the order is part of the value
  */
 typedef struct amvp_param_list_t {
     int param;
     struct amvp_param_list_t *next;
 } AMVP_PARAM_LIST;
 
+/*
+ * Set of supported lengths or enumerated parameter values, see
+ * amvp_value_set_add(). Values under AMVP_VALUE_SET_BITS, which covers
+ * nearly every key, tag and IV length and every parameter enum, are bits
+ * in a bitmap; larger ones go in a sorted array of ranges that is only
+ * allocated, from the arena given to amvp_value_set_add(), when needed.
+ * An all zero set is empty, so zeroed caps need no setup. amvp_value_set_next() walks the values in ascending order.
+ */
+#define AMVP_VALUE_SET_BITS 512
+#define AMVP_VALUE_SET_WORD_BITS 64
+
+typedef struct amvp_value_range_t {
+    int min;
+    int max;
+} AMVP_VALUE_RANGE;
+
+typedef struct amvp_value_set_t {
+    unsigned long long bits[AMVP_VALUE_SET_BITS / AMVP_VALUE_SET_WORD_BITS];
+    AMVP_VALUE_RANGE *ranges;   /* Sorted, neither overlapping nor adjacent */
+    int range_cnt;
+    int range_max;
+    int count;                  /* Values in the set */
+} AMVP_VALUE_SET;
+
 /*
  * list of STATIC strings to be used for supported algs,
  * prime_tests, etc.
@@ -1048,6 +1131,16 @@ typedef struct amvp_string_list_t {
     struct amvp_string_list_t *next;
 } AMVP_STRING_LIST;
 
+/*
+ * Open addressed set of CALLOC'd strings, for membership tests over
+ * lists that would be slow to walk, see amvp_str_set_add()
+ */
+typedef struct amvp_str_set_t {
+    char **slots;
+    size_t size;                /* Power of 2, 0 until the first add */
+    size_t count;
+} AMVP_STR_SET;
+
 /**
  * @struct AMVP_KV_LIST
  * @brief This struct is a list of key/value pairs.
@@ -1063,7 +1156,7 @@ typedef struct amvp_json_domain_obj_t {
     int min;
     int max;
     int increment;
-    struct amvp_sl_list_t *values;
+    AMVP_VALUE_SET values;
 } AMVP_JSON_DOMAIN_OBJ;
 
 typedef struct amvp_prereq_alg_val {
@@ -1087,12 +1180,12 @@ typedef struct amvp_sym_cipher_capability {
     unsigned int ctr_incr;
     unsigned int ctr_ovrflw;
     unsigned int dulen_matches_paylen;
-    AMVP_SL_LIST *keylen;
-    AMVP_SL_LIST *ptlen;
-    AMVP_SL_LIST *tweak;
-    AMVP_SL_LIST *ivlen;
-    AMVP_SL_LIST *aadlen;
-    AMVP_SL_LIST *taglen;
+    AMVP_VALUE_SET keylen;
+    AMVP_VALUE_SET ptlen;
+    AMVP_VALUE_SET tweak;
+    AMVP_VALUE_SET ivlen;
+    AMVP_VALUE_SET aadlen;
+    AMVP_VALUE_SET taglen;
 
     //Support domains for most lengths - APIs should check
     //and allow either/or SL_LIST or domain for not but not both
@@ -1113,10 +1206,11 @@ typedef struct amvp_hash_capability {
                       Only for AMVP_HASH_SHAKE_* */
     AMVP_JSON_DOMAIN_OBJ out_len; /**< Required for AMVP_HASH_SHAKE_* */
     AMVP_JSON_DOMAIN_OBJ msg_length;
+    AMVP_VALUE_SET large_data; /* LDT sizes in GiB, not for AMVP_HASH_SHAKE_* */
 } AMVP_HASH_CAP;
 
 typedef struct amvp_kdf135_snmp_capability {
-    AMVP_SL_LIST *pass_lens;
+    AMVP_VALUE_SET pass_lens;
     AMVP_NAME_LIST *eng_ids;
 } AMVP_KDF135_SNMP_CAP;
 
@@ -1125,7 +1219,7 @@ typedef struct amvp_kdf108_mode_params {
     AMVP_NAME_LIST *mac_mode;
     AMVP_JSON_DOMAIN_OBJ supported_lens;
     AMVP_NAME_LIST *data_order;
-    AMVP_SL_LIST *counter_lens;
+    AMVP_VALUE_SET counter_lens;
     int empty_iv_support;
     int requires_empty_iv;
 } AMVP_KDF108_MODE_PARAMS;
@@ -1144,7 +1238,7 @@ typedef struct amvp_kdf135_ssh_capability {
 typedef struct amvp_kdf135_srtp_capability {
     int supports_zero_kdr;
     int kdr_exp[AMVP_KDF135_SRTP_KDR_MAX];
-    AMVP_SL_LIST *aes_keylens;
+    AMVP_VALUE_SET aes_keylens;
 } AMVP_KDF135_SRTP_CAP;
 
 typedef struct amvp_kdf135_ikev2_capability {
@@ -1177,9 +1271,9 @@ typedef struct amvp_kdf135_x942_capability {
 
 typedef struct amvp_kdf135_x963_capability {
     AMVP_NAME_LIST *hash_algs;
-    AMVP_SL_LIST *shared_info_lengths;
-    AMVP_SL_LIST *field_sizes;
-    AMVP_SL_LIST *key_data_lengths;
+    AMVP_VALUE_SET shared_info_lengths;
+    AMVP_VALUE_SET field_sizes;
+    AMVP_VALUE_SET key_data_lengths;
 } AMVP_KDF135_X963_CAP;
 
 typedef struct amvp_pbkdf_capability {
@@ -1196,7 +1290,7 @@ typedef struct amvp_kdf_tls12_capability {
 
 typedef struct amvp_kdf_tls13_capability {
     AMVP_NAME_LIST *hmac_algs;
-    AMVP_PARAM_LIST *running_mode;
+    AMVP_VALUE_SET running_mode;
 } AMVP_KDF_TLS13_CAP;
 
 typedef struct amvp_hmac_capability {
@@ -1209,8 +1303,8 @@ typedef struct amvp_cmac_capability {
     AMVP_JSON_DOMAIN_OBJ msg_len;
     int direction_gen;
     int direction_ver;
-    AMVP_SL_LIST *key_len;       // 128,192,256
-    AMVP_SL_LIST *keying_option;
+    AMVP_VALUE_SET key_len;       // 128,192,256
+    AMVP_VALUE_SET keying_option;
 } AMVP_CMAC_CAP;
 
 typedef struct amvp_kmac_capability {
@@ -1352,7 +1446,7 @@ typedef struct amvp_dsa_capability {
 typedef struct amvp_kas_ecc_mac {
     int alg;
     int curve;
-    AMVP_PARAM_LIST *key;
+    AMVP_VALUE_SET key;
     int nonce;
     int maclen;
     struct amvp_kas_ecc_mac *next;
@@ -1361,7 +1455,7 @@ typedef struct amvp_kas_ecc_mac {
 typedef struct amvp_kas_ecc_pset {
     unsigned int set;
     int curve;
-    AMVP_PARAM_LIST *sha;
+    AMVP_VALUE_SET sha;
     AMVP_KAS_ECC_MAC *mac;
     struct amvp_kas_ecc_pset *next;
 } AMVP_KAS_ECC_PSET;
@@ -1369,7 +1463,7 @@ typedef struct amvp_kas_ecc_pset {
 typedef struct amvp_kas_ecc_scheme {
     AMVP_KAS_ECC_SCHEMES scheme;
     AMVP_KAS_ECC_SET kdf;
-    AMVP_PARAM_LIST *role;
+    AMVP_VALUE_SET role;
     AMVP_KAS_ECC_PSET *pset;
     struct amvp_kas_ecc_scheme *next;
 } AMVP_KAS_ECC_SCHEME;
@@ -1378,9 +1472,9 @@ typedef struct amvp_kas_ecc_scheme {
 typedef struct amvp_kas_ecc_cap_mode_t {
     AMVP_KAS_ECC_MODE cap_mode;
     AMVP_PREREQ_LIST *prereq_vals;
-    AMVP_PARAM_LIST *curve;    /* CDH mode only */
+    AMVP_VALUE_SET curve;    /* CDH mode only */
     AMVP_REVISION revision; /* Empty if default is used */
-    AMVP_PARAM_LIST *function;
+    AMVP_VALUE_SET function;
     AMVP_KAS_ECC_SCHEME *scheme; /* other modes use schemes */
     int hash;     /* only a single sha for KAS-ECC-SSC */
 } AMVP_KAS_ECC_CAP_MODE;
@@ -1393,7 +1487,7 @@ typedef struct amvp_kas_ecc_capability_t {
 typedef struct amvp_kas_ffc_mac {
     int alg;
     int curve;
-    AMVP_PARAM_LIST *key;
+    AMVP_VALUE_SET key;
     int nonce;
     int maclen;
     struct amvp_kas_ffc_mac *next;
@@ -1401,7 +1495,7 @@ typedef struct amvp_kas_ffc_mac {
 
 typedef struct amvp_kas_ffc_pset {
     unsigned int set;
-    AMVP_PARAM_LIST *sha;
+    AMVP_VALUE_SET sha;
     AMVP_KAS_FFC_MAC *mac;
     struct amvp_kas_ffc_pset *next;
 } AMVP_KAS_FFC_PSET;
@@ -1409,7 +1503,7 @@ typedef struct amvp_kas_ffc_pset {
 typedef struct amvp_kas_ffc_scheme {
     AMVP_KAS_FFC_SCHEMES scheme;
     AMVP_KAS_FFC_SET kdf;
-    AMVP_PARAM_LIST *role;
+    AMVP_VALUE_SET role;
     AMVP_KAS_FFC_PSET *pset;
     struct amvp_kas_ffc_scheme *next;
 } AMVP_KAS_FFC_SCHEME;
@@ -1418,8 +1512,8 @@ typedef struct amvp_kas_ffc_scheme {
 typedef struct amvp_kas_ffc_cap_mode_t {
     AMVP_KAS_FFC_MODE cap_mode;
     AMVP_PREREQ_LIST *prereq_vals;
-    AMVP_PARAM_LIST *function;
-    AMVP_PARAM_LIST *genmeth;
+    AMVP_VALUE_SET function;
+    AMVP_VALUE_SET genmeth;
     int hash;
     AMVP_KAS_FFC_SCHEME *scheme; /* other modes use schemes */
 } AMVP_KAS_FFC_CAP_MODE;
@@ -1433,16 +1527,16 @@ typedef struct amvp_kas_ifc_capability_t {
     AMVP_CIPHER cipher;
     int hash;
     char *fixed_pub_exp;
-    AMVP_PARAM_LIST *kas1_roles;
-    AMVP_PARAM_LIST *kas2_roles;
-    AMVP_PARAM_LIST *keygen_method;
-    AMVP_SL_LIST *modulo;
+    AMVP_VALUE_SET kas1_roles;
+    AMVP_VALUE_SET kas2_roles;
+    AMVP_VALUE_SET keygen_method;
+    AMVP_VALUE_SET modulo;
 } AMVP_KAS_IFC_CAP;
 
 
 
 typedef struct amvp_safe_primes_cap_mode_t {
-    AMVP_PARAM_LIST *genmeth;
+    AMVP_VALUE_SET genmeth;
 } AMVP_SAFE_PRIMES_CAP_MODE;
 
 typedef struct amvp_safe_primes_capability_t {
@@ -1457,7 +1551,7 @@ typedef struct amvp_kda_onestep_capability_t {
     AMVP_NAME_LIST *mac_salt_methods;
     AMVP_PARAM_LIST *patterns;
     char *literal_pattern_candidate; //optional - only filled if "literal" pattern is used - hex only
-    AMVP_PARAM_LIST *encodings;
+    AMVP_VALUE_SET encodings;
     AMVP_JSON_DOMAIN_OBJ z;
     int l;
 } AMVP_KDA_ONESTEP_CAP;
@@ -1468,7 +1562,7 @@ typedef struct amvp_kda_twostep_capability_t {
     AMVP_NAME_LIST *mac_salt_methods;
     AMVP_PARAM_LIST *patterns;
     char *literal_pattern_candidate; //optional - only filled if "literal" pattern is used - hex only
-    AMVP_PARAM_LIST *encodings;
+    AMVP_VALUE_SET encodings;
     AMVP_JSON_DOMAIN_OBJ z;
     int l;
     int perform_multi_expansion_tests; /* 56Cr2 only */
@@ -1482,7 +1576,7 @@ typedef struct amvp_kda_hkdf_t {
     AMVP_PARAM_LIST *patterns;
     AMVP_REVISION revision;
     char *literal_pattern_candidate; //optional - only filled if "literal" pattern is used - hex only
-    AMVP_PARAM_LIST *encodings;
+    AMVP_VALUE_SET encodings;
     AMVP_NAME_LIST *hmac_algs;
     AMVP_NAME_LIST *mac_salt_methods;
     AMVP_JSON_DOMAIN_OBJ z;
@@ -1502,9 +1596,9 @@ typedef struct amvp_kts_ifc_macs_t {
 typedef struct amvp_kts_ifc_schemes_t {
     AMVP_KTS_IFC_SCHEME_TYPE scheme;
     int l;
-    AMVP_PARAM_LIST *roles;
+    AMVP_VALUE_SET roles;
     AMVP_KTS_IFC_MACS *macs;  /* not yet supported */
-    AMVP_PARAM_LIST *hash;
+    AMVP_VALUE_SET hash;
     int null_assoc_data;
     char *assoc_data_pattern;
     char *encodings;      /* may need to change to SL_LIST */
@@ -1516,10 +1610,10 @@ typedef struct amvp_kts_ifc_capability_t {
     AMVP_CIPHER cipher;
     char *fixed_pub_exp;
     char *iut_id;
-    AMVP_PARAM_LIST *functions;
+    AMVP_VALUE_SET functions;
     AMVP_KTS_IFC_SCHEMES *schemes;
-    AMVP_PARAM_LIST *keygen_method;
-    AMVP_SL_LIST *modulo;
+    AMVP_VALUE_SET keygen_method;
+    AMVP_VALUE_SET modulo;
 } AMVP_KTS_IFC_CAP;
 
 typedef struct amvp_caps_list_t {
@@ -1566,6 +1660,13 @@ typedef struct amvp_caps_list_t {
     } cap;
 
     int (*crypto_handler)(AMVP_TEST_CASE *test_case);
+    int (*crypto_batch_handler)(AMVP_TEST_CASE *test_cases, int count); /* Optional, whole group at once */
+    int (*crypto_mct_handler)(AMVP_TEST_CASE *test_case); /* Optional, one MCT outer iteration at once */
+    int (*group_init)(AMVP_TEST_CASE *test_case, void **group_ctx); /* Optional, once per test group */
+    void (*group_fini)(void *group_ctx);
+    int (*hash_init)(AMVP_TEST_CASE *test_case, void **stream_ctx); /* Optional, hash LDT only */
+    int (*hash_update)(void *stream_ctx, const unsigned char *data, unsigned int len);
+    int (*hash_final)(void *stream_ctx, AMVP_TEST_CASE *test_case);
 
     struct amvp_caps_list_t *next;
 } AMVP_CAPS_LIST;
@@ -1700,6 +1801,250 @@ typedef struct amvp_fips_t {
     AMVP_OE *oe; /* Pointer to the Operating Environment to use for this validation */
 } AMVP_FIPS;
 
+/*
+ * Bump allocator for test case buffers. Memory handed out is zeroed and
+ * stays valid until the next amvp_arena_reset() or amvp_arena_free().
+ */
+#define AMVP_ARENA_BLOCK_SIZE (1024 * 64)
+
+typedef struct amvp_arena_block_t {
+    struct amvp_arena_block_t *next;
+    size_t size;    /* usable bytes following the header */
+    size_t used;
+} AMVP_ARENA_BLOCK;
+
+typedef struct amvp_arena_t {
+    AMVP_ARENA_BLOCK *blocks; /* newest block first */
+} AMVP_ARENA;
+
+/*
+ * Every capability structure, list node and string of a context comes
+ * from one arena, so they are all freed at once. amvp_ctx_clone() shares
+ * the store with the new context; it is read only while shared and freed
+ * with the last context using it.
+ */
+typedef struct amvp_cap_store_t {
+    AMVP_ARENA arena;
+    int refs;               /* Contexts using it */
+} AMVP_CAP_STORE;
+
+/*
+ * Borrowed view of a string inside a parsed vector set, see
+ * amvp_json_view(). Valid as long as the vector set JSON is.
+ */
+typedef struct amvp_str_view_t {
+    const char *str;    /* NULL when the member is missing or not a string */
+    size_t len;         /* not counting the terminator */
+    const unsigned char *bin; /* str already hex decoded, from a vector set cache, or NULL */
+} AMVP_STR_VIEW;
+
+/*
+ * Append-only writer for compact JSON, see amvp_json_writer.c. Handlers
+ * can stream the vector set response into ctx->kat_writer instead of
+ * building it under ctx->kat_resp.
+ */
+#define AMVP_JSON_WRITER_DEPTH_MAX 16
+
+typedef struct amvp_json_writer_t {
+    char *buf;
+    size_t len;             /* bytes written, not counting the terminator */
+    size_t size;            /* bytes allocated */
+    int depth;              /* number of open objects/arrays */
+    unsigned char first[AMVP_JSON_WRITER_DEPTH_MAX]; /* nothing written yet at this level */
+    AMVP_RESULT status;     /* first error hit, sticky until amvp_jw_reset() */
+    size_t spill_at;        /* move buf to spill once len reaches this, 0 = never */
+    FILE *spill;            /* temp file, opened on the first spill */
+    size_t spilled;         /* bytes of output in spill, ahead of buf */
+    int pretty;             /* indent like parson's pretty output, scalars only for amvp_jw_value() */
+} AMVP_JSON_WRITER;
+
+/*
+ * Serializes a parson tree a piece at a time, as the reader asks for it,
+ * with the same output as amvp_jw_value(). Only the value being written
+ * out is ever held in memory, see amvp_jp_read().
+ */
+typedef struct amvp_json_producer_t {
+    AMVP_JSON_WRITER w;         /* output not yet handed to the reader */
+    size_t pos;                 /* bytes of w already handed out */
+    const JSON_Value *root;
+    const JSON_Value *stack[AMVP_JSON_WRITER_DEPTH_MAX];
+    size_t idx[AMVP_JSON_WRITER_DEPTH_MAX]; /* next member of each open object/array */
+    int started;
+    size_t total;               /* bytes handed out so far */
+} AMVP_JSON_PRODUCER;
+
+/*
+ * The file vector sets are saved to with amvp_mark_as_request_only(),
+ * kept open for the whole session, see amvp_req_file_begin()
+ */
+#define AMVP_REQ_FILE_BUF_DEFAULT (256 * 1024)
+#define AMVP_REQ_FILE_BUF_MAX_KB (1024 * 1024)
+
+typedef struct amvp_req_file_t {
+    FILE *fp;                   /* NULL until the first set is saved */
+    char *buf;                  /* stdio buffer of fp */
+    size_t buf_size;            /* set by amvp_set_request_file_buffer(), 0 = default */
+    AMVP_FSYNC_POLICY fsync;
+    AMVP_JSON_PRODUCER prod;    /* serializes each set into fp */
+} AMVP_REQ_FILE;
+
+/*
+ * Reads the top level array of an offline JSON file one element at a
+ * time, see amvp_json_reader.c
+ */
+typedef struct amvp_json_file_reader_t {
+    const char *data;   /* mapped (or loaded) file contents */
+    size_t size;
+    size_t pos;         /* offset of the next unread byte */
+    int count;          /* elements returned so far */
+    char *elem;         /* terminated copy of the current element for parson */
+    size_t elem_size;
+} AMVP_JSON_FILE_READER;
+
+/*
+ * A vector set cache file mapped for reading, see amvp_vs_cache.c. The
+ * strings of a tree loaded from it point into data.
+ */
+#define AMVP_VS_CACHE_EXT ".amvb"
+
+typedef struct amvp_vs_cache_map_t {
+    const char *data;
+    size_t size;
+} AMVP_VS_CACHE_MAP;
+
+/* Opaque, defined in amvp_worker.c */
+typedef struct amvp_worker_pool_t AMVP_WORKER_POOL;
+
+/* Opaque, defined in amvp_worker_proc.c */
+typedef struct amvp_proc_pool_t AMVP_PROC_POOL;
+
+/* Opaque, defined in amvp_affinity.c */
+typedef struct amvp_affinity_t AMVP_AFFINITY;
+
+/* Opaque, defined in amvp_transport.c */
+typedef struct amvp_vs_multi_t AMVP_VS_MULTI;
+
+/* Opaque, defined in amvp_log.c */
+typedef struct amvp_log_sink_t AMVP_LOG_SINK;
+
+/* Opaque, defined in amvp_metrics.c */
+typedef struct amvp_metrics_t AMVP_METRICS;
+
+/* Opaque, defined in amvp_meta_cache.c */
+typedef struct amvp_meta_cache_t AMVP_META_CACHE;
+
+/* Opaque, defined in amvp_estimate.c */
+typedef struct amvp_workload_t AMVP_WORKLOAD;
+
+/* Opaque, defined in amvp_transport.c */
+typedef struct amvp_jwt_renew_t AMVP_JWT_RENEW;
+
+/* Opaque, defined in amvp_evidence.c */
+typedef struct amvp_evidence_store_t AMVP_EVIDENCE_STORE;
+
+/* Opaque, defined in amvp_vs_stream.c */
+typedef struct amvp_vs_stream_t AMVP_VS_STREAM;
+
+/* ctx->kat_rsp_cont, while a streamed vector set is handled a group at a time */
+#define AMVP_RSP_CONT_FIRST 1   /* First group, the response is started but left open */
+#define AMVP_RSP_CONT_MORE 2    /* Later groups, written into the open response */
+
+/* amvp_verify_expected_results() */
+#define AMVP_VERIFY_THREADS 4   /* Threads used unless amvp_set_worker_threads() asked for more */
+#define AMVP_VERIFY_LOG_MAX 10  /* Mismatches logged per algorithm, the rest are only counted */
+
+#define AMVP_EVIDENCE_TE_ID_MAX 64
+#define AMVP_EVIDENCE_STR_MAX 65536    /* Longest evidence string, files can be any size */
+#define AMVP_EVIDENCE_PATH_MAX 4096
+/* IE set responses spill past this even without a response memory budget */
+#define AMVP_EVIDENCE_SPILL_AT (256 * 1024)
+
+/* A query answered by a cached listing page, see amvp_meta_cache.c */
+typedef struct amvp_meta_cache_entry_t {
+    char *key;                  /* Endpoint and filters of the query */
+    char *page;                 /* Page the match was on, NULL for the first */
+    char *etag;
+    char *body;
+    int body_len;
+    struct amvp_meta_cache_entry_t *next;
+} AMVP_META_CACHE_ENTRY;
+
+#define AMVP_HTTP_ETAG_MAX 256
+#define AMVP_HTTP_DATE_MAX 64
+
+/* The validators of a GET response, for conditional requests */
+typedef struct amvp_http_validators_t {
+    char etag[AMVP_HTTP_ETAG_MAX + 1];
+    char last_modified[AMVP_HTTP_DATE_MAX + 1];
+} AMVP_HTTP_VALIDATORS;
+
+/* Opaque, defined in amvp_crypto_cache.c */
+typedef struct amvp_crypto_cache_t AMVP_CRYPTO_CACHE;
+
+/* Opaque, defined in amvp_checkpoint.c */
+typedef struct amvp_checkpoint_t AMVP_CHECKPOINT;
+
+/* How far a vector set got, as recorded in the checkpoint journal */
+typedef enum amvp_ckpt_state {
+    AMVP_CKPT_NONE = 0,
+    AMVP_CKPT_DOWNLOADED,   /* vector set saved locally */
+    AMVP_CKPT_PROCESSED,    /* responses saved locally */
+    AMVP_CKPT_UPLOADED      /* responses accepted by the server */
+} AMVP_CKPT_STATE;
+
+/* Allocation counters at some point in time, see amvp_mem_mark() */
+typedef struct amvp_mem_mark_t {
+    unsigned long long allocs;
+    unsigned long long alloc_bytes;
+} AMVP_MEM_MARK;
+
+typedef enum amvp_metrics_phase {
+    AMVP_METRICS_PARSE = 0,
+    AMVP_METRICS_HANDLER,
+    AMVP_METRICS_UPLOAD
+} AMVP_METRICS_PHASE;
+
+/* One vector set's entry in the metrics, see amvp_metrics.c */
+typedef struct amvp_vs_metrics_rec_t {
+    AMVP_VS_METRICS m;
+    char *vsid_url;
+    double wait_since;          /* When the last retry response came in, 0 when not waiting */
+    AMVP_MEM_MARK mem;          /* Counters when amvp_metrics_begin() was called */
+    struct amvp_vs_metrics_rec_t *next;
+} AMVP_VS_METRICS_REC;
+
+/*
+ * Phases of a session started with amvp_run_async(), in order
+ */
+typedef enum amvp_async_state {
+    AMVP_ASYNC_LOGIN = 0,
+    AMVP_ASYNC_REGISTER,
+    AMVP_ASYNC_VECTOR_SETS,     /* Concurrent transfers, stepped without blocking */
+    AMVP_ASYNC_VECTOR_RETRY,    /* Sets whose transfers failed, handled serially */
+    AMVP_ASYNC_RESULTS,         /* Polling for the session results every wake_at */
+    AMVP_ASYNC_FINISH,          /* Validation and PUT, if requested */
+    AMVP_ASYNC_DONE
+} AMVP_ASYNC_STATE;
+
+/* State kept between polls of the session results, see amvp_get_result_test_session() */
+typedef struct amvp_results_poll_t {
+    int period;                 /* Seconds until the next poll, see amvp_retry_check() */
+    unsigned int waited;
+    int completed;              /* Vector sets complete as of the last poll */
+    int hint;                   /* The server's retry hint in the last results */
+    AMVP_HTTP_VALIDATORS validators; /* Of the last results, sent with the next poll */
+} AMVP_RESULTS_POLL;
+
+typedef struct amvp_async_t {
+    AMVP_ASYNC_STATE state;
+    int fips_validation;
+    AMVP_VS_MULTI *vs_multi;
+    AMVP_STRING_LIST *failed;   /* Vector sets left over by vs_multi */
+    time_t wake_at;             /* Don't step before this time */
+    AMVP_RESULTS_POLL results;  /* Polling state during AMVP_ASYNC_RESULTS */
+    AMVP_RESULT result;         /* Outcome once state is AMVP_ASYNC_DONE */
+} AMVP_ASYNC;
+
 /*
  * This struct holds all the global data for a test session, such
  * as the server name, port#, etc.  Some of the values in this
@@ -1718,6 +2063,39 @@ struct amvp_ctx_t {
     int verify_peer;        /* enables TLS peer verification via Curl */
     char *tls_cert;         /* Location of PEM encoded X509 cert to use for TLS client auth */
     char *tls_key;          /* Location of PEM encoded priv key to use for TLS client auth */
+    int max_transfers;      /* Max vector set transfers to keep in flight at once, 1 = serial */
+    int pipeline_depth;     /* Vector sets to download ahead of the one being processed, 0 = inline */
+    AMVP_VS_SCHEDULE vs_schedule; /* Order concurrently processed vector sets are started in */
+    int worker_threads;     /* Threads used to run the test cases of a group, 1 = serial */
+    AMVP_WORKER_POOL *worker_pool; /* Pool backing worker_threads, NULL when serial */
+    AMVP_PROC_POOL *proc_pool;  /* Set by amvp_set_worker_processes(), NULL when not in use */
+    AMVP_WORKER_AFFINITY worker_affinity; /* Where the workers of later pools are pinned */
+    int lazy_file_parse;    /* Parse offline files one vector set at a time, see amvp_json_reader.c */
+    int vs_cache;           /* Keep a binary cache of request files, see amvp_vs_cache.c */
+    int json_arena_enabled; /* Put each vector set's JSON trees in json_arena */
+    int json_compact;       /* Serialize uploads and saved files without indentation */
+    int upload_compress;    /* gzip large POST/PUT bodies, needs AMVP_HAVE_ZLIB */
+    size_t upload_chunk;    /* Send vector set responses in chunks of this many bytes, 0 = whole */
+    size_t rsp_mem_budget;  /* Spill kat_writer to a temp file past this many bytes, 0 = never */
+    int http2;              /* Negotiate HTTP/2 and TLS 1.3, multiplexing concurrent transfers */
+    AMVP_ASYNC *async;      /* Set between amvp_run_async() and the end of the session */
+    AMVP_SESSION_GROUP *session_group; /* Group whose curl share this ctx uses, if any */
+    AMVP_LOG_SINK *log_sink; /* Set by amvp_set_async_logging(), NULL logs synchronously */
+    AMVP_METRICS *metrics;  /* Set by amvp_set_metrics(), NULL when not collecting */
+    AMVP_META_CACHE *meta_cache; /* Set by amvp_set_metadata_cache() */
+    AMVP_WORKLOAD *workload; /* Cost models and the last estimate, see amvp_estimate_workload() */
+    AMVP_EVIDENCE_STORE *evidence; /* TE evidence for IE sets, NULL uses the built in entries */
+    int incremental_parse;  /* Process test groups as a vector set downloads, see amvp_vs_stream.c */
+    AMVP_VS_STREAM *vs_stream; /* Set while a vector set is being streamed */
+    const char *http_if_none_match; /* ETag to send with the next GET, if any */
+    const char *http_if_modified_since; /* Last-Modified date to send with the next GET, if any */
+    AMVP_HTTP_VALIDATORS http_validators; /* ETag and Last-Modified of the last GET response */
+    int http_not_modified;  /* The last GET came back 304 */
+    const char *rsp_slice;  /* Vector set response to upload straight from the mapped offline file */
+    size_t rsp_slice_len;
+    int checkpoint_enable;  /* Set by amvp_set_resume_checkpoints() */
+    AMVP_CHECKPOINT *checkpoint; /* Journal of the session's progress, once the session file exists */
+    AMVP_CRYPTO_CACHE *crypto_cache; /* Set by amvp_set_crypto_cache() */
 
     char *http_user_agent;   /* String containing info to be sent with HTTP requests, currently OE info */
     char *session_file_path; /* String containing the path of the testSession file after it is created when applicable */
@@ -1731,6 +2109,7 @@ struct amvp_ctx_t {
     int use_json;           /* flag to indicate a JSON file is being used for registration */
     int is_sample;          /* flag to idicate that we are requesting sample vector responses */
     char *vector_req_file;  /* filename to use to store vector request JSON */
+    AMVP_REQ_FILE req_file; /* open handle on vector_req_file while sets are saved */
     int vector_req;         /* flag to indicate we are storing vector request JSON in a file */
     int vector_rsp;         /* flag to indicate we are storing vector responses JSON in a file */
     int get;                /* flag to indicate we are only getting status or metadata */
@@ -1754,10 +2133,20 @@ struct amvp_ctx_t {
     char *jwt_token; /* access_token provided by server for authenticating REST calls */
     char *tmp_jwt; /* access_token provided by server for authenticating a single REST call */
     int use_tmp_jwt; /* 1 if the tmp_jwt should be used */
+    time_t jwt_expiry;      /* exp claim of jwt_token, 0 if it has none */
+    time_t jwt_renew_at;    /* When to renew jwt_token, 0 for never, see amvp_jwt_track() */
+    int jwt_renew_margin;   /* Set by amvp_set_jwt_renewal(), 0 picks one, < 0 only refreshes on 401 */
+    AMVP_JWT_RENEW *jwt_renew; /* Background renewal thread, started for the first token that expires */
     JSON_Value *registration; /* The capability registration string sent when creating a test session */
+    char *registration_str;   /* Compact serialization of registration, built on first use */
+    int registration_len;
+    int registration_dirty;   /* A capability changed since registration was built */
 
     /* crypto module capabilities list */
     AMVP_CAPS_LIST *caps_list;
+    AMVP_CAP_STORE *cap_store; /* Memory behind caps_list, see amvp_cap_alloc() */
+    /* Entries of caps_list indexed by AMVP_CIPHER, for amvp_locate_cap_entry() */
+    AMVP_CAPS_LIST *caps_tbl[AMVP_CIPHER_END];
     /* Maintain a count of the number of registered vector sets so we can evaluate cost. This can be >= caps_list size */
     int vs_count;
 
@@ -1771,9 +2160,20 @@ struct amvp_ctx_t {
     int vs_id;      /* vs_id currently being processed */
 
     JSON_Value *kat_resp; /* holds the current set of vector responses */
+    AMVP_JSON_WRITER kat_writer; /* or the streamed responses, when kat_resp is NULL */
+    int kat_rsp_cont;     /* AMVP_RSP_CONT_*, 0 unless handling a streamed vector set */
+    const char *kat_rsp_mode; /* "mode" of the streamed response, written at its end */
+    AMVP_ARENA tc_arena;  /* buffers of the test case being processed, reset by each init_tc */
+    AMVP_ARENA json_arena; /* JSON trees of the vector set being processed, see amvp_json_arena_begin */
+    JSON_Allocator json_alloc; /* parson allocator backed by json_arena */
+    const JSON_Allocator *json_prev_alloc; /* thread allocator to restore in amvp_json_arena_end */
+    int json_arena_active;
 
     char *curl_buf;       /**< Data buffer for inbound Curl messages */
     int curl_read_ctr;    /**< Total number of bytes written to the curl_buf */
+    int curl_buf_size;    /**< Allocated size of curl_buf; grows as needed */
+    void *curl_hnd;       /**< Reusable curl easy handle, kept between requests */
+    void *curl_share;     /**< Curl share object holding the connection, DNS and TLS session caches */
     int post_size_constraint;  /**< The number of bytes that the body of an HTTP POST may contain
                                     without requiring the use of the /large endpoint. If the POST body
                                     is larger than this value, then use of the /large endpoint is necessary */
@@ -1798,6 +2198,187 @@ AMVP_RESULT amvp_transport_put(AMVP_CTX *ctx, const char *endpoint, const char *
 
 AMVP_RESULT amvp_transport_delete(AMVP_CTX *ctx, const char *endpoint);
 
+void amvp_transport_cleanup(AMVP_CTX *ctx);
+
+/*
+ * Called by amvp_transport_process_vector_sets() for each downloaded vector set.
+ * Either sets retry_period and returns AMVP_KAT_DOWNLOAD_RETRY, or processes the
+ * vectors and returns the serialized responses to upload in rsp/rsp_len. The
+ * transport frees rsp with free().
+ */
+typedef AMVP_RESULT (*AMVP_VS_PROCESS_CB)(AMVP_CTX *ctx, const char *vsid_url, char *body,
+                                          int *retry_period, char **rsp, int *rsp_len);
+
+AMVP_RESULT amvp_transport_process_vector_sets(AMVP_CTX *ctx, AMVP_VS_PROCESS_CB process_cb,
+                                               AMVP_STRING_LIST **failed);
+
+/*
+ * Called by amvp_transport_get_pages() with each page of a listing in
+ * ctx->curl_buf, in order. Setting *done stops the download.
+ */
+typedef AMVP_RESULT (*AMVP_PAGE_CB)(AMVP_CTX *ctx, const char *url, void *arg, int *done);
+
+AMVP_RESULT amvp_transport_get_pages(AMVP_CTX *ctx, char **urls, int count,
+                                     AMVP_PAGE_CB page_cb, void *arg);
+
+/*
+ * The loop behind amvp_transport_process_vector_sets(), broken out so
+ * amvp_step() can drive it from the application's event loop.
+ */
+AMVP_RESULT amvp_vs_multi_init(AMVP_CTX *ctx, AMVP_VS_PROCESS_CB process_cb, AMVP_VS_MULTI **out);
+
+AMVP_RESULT amvp_vs_multi_step(AMVP_CTX *ctx, AMVP_VS_MULTI *m, int *remaining);
+
+AMVP_RESULT amvp_vs_multi_fdset(AMVP_VS_MULTI *m, fd_set *read_fds, fd_set *write_fds,
+                                fd_set *exc_fds, int *max_fd);
+
+long amvp_vs_multi_timeout(AMVP_VS_MULTI *m);
+
+void amvp_vs_multi_free(AMVP_VS_MULTI *m, AMVP_STRING_LIST **failed);
+
+/*
+ * Worker pool used by KAT handlers to run crypto_handler over the test
+ * cases of one group. amvp_worker_run_tcs() returns once every test case
+ * has been run, or with AMVP_CRYPTO_MODULE_FAIL once any of them fails.
+ * If the cap has a crypto_batch_handler, the whole group is passed to it
+ * in a single call instead.
+ *
+ * amvp_worker_run_tcs_cost() takes an estimated cost per test case, in
+ * the units of the amvp_*_cost() estimators, and schedules the most
+ * expensive ones first. amvp_worker_order() fills order with the test
+ * case indices sorted that way. amvp_worker_steals() counts the test
+ * cases that a worker took from another worker's queue.
+ */
+AMVP_RESULT amvp_worker_pool_init(AMVP_CTX *ctx, int threads);
+
+void amvp_worker_pool_free(AMVP_CTX *ctx);
+
+AMVP_RESULT amvp_worker_run_tcs(AMVP_CTX *ctx, AMVP_CAPS_LIST *cap, AMVP_TEST_CASE *tcs, int count);
+
+AMVP_RESULT amvp_worker_run_tcs_cost(AMVP_CTX *ctx, AMVP_CAPS_LIST *cap, AMVP_TEST_CASE *tcs,
+                                     const double *costs, int count);
+
+void amvp_worker_order(const double *costs, int count, int *order);
+
+int amvp_worker_steals(AMVP_CTX *ctx);
+
+/*
+ * The test cases of every group in a vector set, gathered so they can be
+ * run as one batch. amvp_tc_batch_init() sizes it from the tests arrays
+ * of groups; r_tobjs[i] is the response object of tcs[i].
+ */
+typedef struct amvp_tc_batch_t {
+    AMVP_TEST_CASE *tcs;
+    JSON_Object **r_tobjs;
+    double *costs;
+    int count;                  /* Test cases added so far */
+    int max;
+} AMVP_TC_BATCH;
+
+AMVP_RESULT amvp_tc_batch_init(AMVP_TC_BATCH *batch, JSON_Array *groups);
+
+void amvp_tc_batch_free(AMVP_TC_BATCH *batch);
+
+/*
+ * Table driven KAT handling, see amvp_kat_engine.c. A handler describes
+ * the members of its test groups and test cases and where each one goes
+ * in its test case struct, and amvp_kat_engine_run() does the rest: it
+ * finds the cap, reads and decodes the members, runs each group on the
+ * worker pool and streams the response out.
+ *
+ * The members of a group are read once, into a template each of its test
+ * cases starts from, so hex values of the group are decoded only once and
+ * shared by its test cases. Lists of fields end with a NULL name.
+ *
+ * A required member that is missing is AMVP_MISSING_ARG, or with
+ * AMVP_KAT_MISSING_INVALID the AMVP_INVALID_ARG some handlers have always
+ * returned. The "algorithm" and "mode" of the vector set are checked the
+ * same way for every handler: missing "algorithm" is AMVP_MISSING_ARG, one
+ * with no cap AMVP_UNSUPPORTED_OP and the cap of another handler
+ * AMVP_INVALID_ARG.
+ */
+typedef enum amvp_kat_field_type {
+    AMVP_KAT_NUM = 1,       /* Number, into an int */
+    AMVP_KAT_BITS,          /* Number of bits, into an int number of bytes */
+    AMVP_KAT_HEX,           /* Hex string, decoded into a buffer as long as it, or max bytes without a len_off */
+    AMVP_KAT_STR,           /* String, the pointer into the vector set is kept */
+    AMVP_KAT_HASH           /* Hash algorithm name, into an AMVP_HASH_ALG */
+} AMVP_KAT_FIELD_TYPE;
+
+#define AMVP_KAT_REQUIRED   0x1 /* Missing, or a number of 0, is an error */
+#define AMVP_KAT_CHECK_LEN  0x2 /* HEX, STR: has to be as long as the bytes already at len_off */
+#define AMVP_KAT_MISSING_INVALID 0x4 /* Missing is AMVP_INVALID_ARG, not AMVP_MISSING_ARG */
+#define AMVP_KAT_NO_LEN     ((size_t)-1)
+
+typedef struct amvp_kat_field_t {
+    const char *name;
+    AMVP_KAT_FIELD_TYPE type;
+    int flags;
+    size_t off;             /* Of the value in the test case struct */
+    size_t len_off;         /* HEX, STR: of its int length in bytes, or AMVP_KAT_NO_LEN */
+    int max;                /* HEX: largest value in bytes, the size of an out buffer */
+} AMVP_KAT_FIELD;
+
+typedef struct amvp_kat_schema_t {
+    AMVP_CAP_TYPE cap_type;
+    const char *rsp_mode;       /* "mode" of the response, or NULL for none */
+    size_t tc_size;             /* Of the test case struct */
+    size_t cipher_off;
+    size_t tc_id_off;
+    const AMVP_KAT_FIELD *group;
+    const AMVP_KAT_FIELD *test;
+    const AMVP_KAT_FIELD *out;  /* HEX, a buffer of max bytes for the module to fill */
+    void (*bind)(AMVP_TEST_CASE *tc, void *stc);            /* Points tc at stc */
+    AMVP_RESULT (*check)(AMVP_CTX *ctx, void *stc);         /* Optional, once a test case is read */
+} AMVP_KAT_SCHEMA;
+
+AMVP_RESULT amvp_kat_engine_run(AMVP_CTX *ctx, JSON_Object *obj, const AMVP_KAT_SCHEMA *schema);
+
+/*
+ * Relative cost of one test case, 1 being about one symmetric cipher
+ * test case. Used to seed amvp_worker_run_tcs_cost().
+ */
+double amvp_rsa_keygen_cost(int modulo, AMVP_RSA_KEYGEN_MODE rand_pq, AMVP_RSA_TESTTYPE test_type);
+
+double amvp_dsa_pqggen_cost(int l, AMVP_DSA_GEN_PARM gpq);
+
+double amvp_safe_primes_cost(AMVP_CIPHER alg_id, AMVP_SAFE_PRIMES_MODE dgm);
+
+/*
+ * Worker processes, see amvp_worker_proc.c. amvp_worker_run_tcs() hands
+ * a group to amvp_proc_pool_run() when amvp_proc_pool_can_run() says the
+ * algorithm's test cases can be sent to another process.
+ */
+AMVP_RESULT amvp_proc_pool_init(AMVP_CTX *ctx, int procs);
+
+void amvp_proc_pool_free(AMVP_CTX *ctx);
+
+int amvp_proc_pool_can_run(AMVP_CTX *ctx, AMVP_CAPS_LIST *cap);
+
+AMVP_RESULT amvp_proc_pool_run(AMVP_CTX *ctx, AMVP_CAPS_LIST *cap, AMVP_TEST_CASE *tcs,
+                               const int *order, int count);
+
+/*
+ * Worker placement, see amvp_affinity.c. amvp_affinity_new() reads the
+ * NUMA nodes for the context's worker_affinity, or returns NULL when the
+ * workers aren't to be pinned. Worker i is placed on node index
+ * amvp_affinity_worker_node(), and amvp_affinity_bind() pins the calling
+ * thread, or a freshly forked process, there; it returns 0 if it didn't.
+ * amvp_affinity_cur_node() is the node index of the CPU the caller is on,
+ * -1 if it isn't one of the nodes'.
+ */
+AMVP_AFFINITY *amvp_affinity_new(AMVP_CTX *ctx);
+
+void amvp_affinity_free(AMVP_AFFINITY *aff);
+
+int amvp_affinity_node_cnt(const AMVP_AFFINITY *aff);
+
+int amvp_affinity_worker_node(const AMVP_AFFINITY *aff, int worker);
+
+int amvp_affinity_cur_node(const AMVP_AFFINITY *aff);
+
+int amvp_affinity_bind(const AMVP_AFFINITY *aff, int worker);
+
 AMVP_RESULT amvp_retrieve_vector_set(AMVP_CTX *ctx, char *vsid_url);
 
 AMVP_RESULT amvp_retrieve_vector_set_result(AMVP_CTX *ctx, const char *vsid_url);
@@ -1809,6 +2390,145 @@ AMVP_RESULT amvp_submit_vector_responses(AMVP_CTX *ctx, char *vsid_url);
 void amvp_log_msg(AMVP_CTX *ctx, AMVP_LOG_LVL level, const char *func, int line, const char *format, ...);
 void amvp_log_newline(AMVP_CTX *ctx);
 
+/*
+ * With amvp_set_async_logging() enabled, amvp_log_msg() formats messages
+ * into the sink's ring rather than calling the progress callback, see
+ * amvp_log.c. amvp_log_sink_put() returns 0 when ctx has no sink.
+ */
+int amvp_log_sink_put(AMVP_CTX *ctx, AMVP_LOG_LVL level, const char *func, int line, const char *fmt, va_list args);
+
+void amvp_log_sink_free(AMVP_CTX *ctx);
+
+/*
+ * Metrics collection, see amvp_metrics.c. Everything here is a no-op, and
+ * the record functions return NULL, when amvp_set_metrics() is off.
+ * amvp_metrics_begin()/end() bracket the processing of a set on the thread
+ * doing it; amvp_crypto_call() is how the KAT handlers invoke the crypto
+ * handler, so its time and call count are charged to that set.
+ */
+double amvp_metrics_now(void);
+
+AMVP_VS_METRICS_REC *amvp_metrics_vs(AMVP_CTX *ctx, const char *vsid_url);
+
+AMVP_VS_METRICS_REC *amvp_metrics_begin(AMVP_CTX *ctx, const char *vsid_url);
+
+void amvp_metrics_end(AMVP_CTX *ctx);
+
+AMVP_VS_METRICS_REC *amvp_metrics_cur(AMVP_CTX *ctx);
+
+void amvp_metrics_set_net(AMVP_CTX *ctx, AMVP_VS_METRICS_REC *rec);
+
+void amvp_metrics_retry(AMVP_VS_METRICS_REC *rec);
+
+void amvp_metrics_download_start(AMVP_VS_METRICS_REC *rec);
+
+void amvp_metrics_net(AMVP_CTX *ctx, int upload, double start, size_t bytes_out, size_t bytes_in);
+
+void amvp_metrics_xfer(AMVP_VS_METRICS_REC *rec, int upload, double start, size_t bytes_out, size_t bytes_in);
+
+AMVP_VS_METRICS_REC *amvp_metrics_get_net(AMVP_CTX *ctx);
+
+/* Records the timings of a finished request, and charges them to rec if not NULL */
+void amvp_metrics_request(AMVP_CTX *ctx, AMVP_VS_METRICS_REC *rec, AMVP_NET_TIMING *timing);
+
+/*
+ * amvp_mem_mark() takes the allocation counters before a phase of a set,
+ * amvp_metrics_mem_phase() charges what was allocated since to the set
+ */
+void amvp_mem_mark(AMVP_MEM_MARK *mark);
+
+void amvp_metrics_mem_phase(AMVP_VS_METRICS_REC *rec, AMVP_METRICS_PHASE phase, const AMVP_MEM_MARK *mark);
+
+int amvp_crypto_call(AMVP_CTX *ctx, AMVP_CAPS_LIST *cap, AMVP_TEST_CASE *tc);
+
+int amvp_crypto_mct_call(AMVP_CTX *ctx, AMVP_CAPS_LIST *cap, AMVP_TEST_CASE *tc);
+
+int amvp_sym_mct_call(AMVP_CTX *ctx, AMVP_CAPS_LIST *cap, AMVP_TEST_CASE *tc);
+
+/*
+ * The cap's group_init/group_fini for the test group a KAT handler is on.
+ * amvp_group_begin() calls group_init unless it already ran for this group
+ * and copies the module's group context to *tc_group_ctx, so the handlers
+ * call it before each crypto call. amvp_group_end() calls group_fini once
+ * the group is done or processing stops.
+ */
+typedef struct amvp_group_state_t {
+    void *group_ctx;            /* Set by the module's group_init */
+    int active;                 /* group_init has run, group_fini has not */
+} AMVP_GROUP_STATE;
+
+int amvp_group_begin(AMVP_CTX *ctx, AMVP_CAPS_LIST *cap, AMVP_TEST_CASE *tc,
+                     AMVP_GROUP_STATE *group, void **tc_group_ctx);
+
+void amvp_group_end(AMVP_CAPS_LIST *cap, AMVP_GROUP_STATE *group);
+
+void amvp_metrics_emit(AMVP_CTX *ctx);
+
+void amvp_metrics_free(AMVP_CTX *ctx);
+
+/*
+ * Fills costs with the estimated seconds of each of the count vector sets,
+ * when the registration has count entries. AMVP_NO_DATA otherwise.
+ */
+AMVP_RESULT amvp_workload_vs_costs(AMVP_CTX *ctx, int count, double *costs);
+
+void amvp_workload_free(AMVP_CTX *ctx);
+
+char *amvp_meta_cache_key(const char *endpoint, const AMVP_KV_LIST *parameters);
+
+AMVP_META_CACHE_ENTRY *amvp_meta_cache_find(AMVP_CTX *ctx, const char *key);
+
+AMVP_RESULT amvp_meta_cache_store(AMVP_CTX *ctx, const char *key, const char *page,
+                                  const char *etag, char *body, int body_len);
+
+AMVP_RESULT amvp_meta_cache_load_body(AMVP_CTX *ctx, const AMVP_META_CACHE_ENTRY *entry);
+
+AMVP_RESULT amvp_meta_cache_flush(AMVP_CTX *ctx);
+
+void amvp_meta_cache_free(AMVP_CTX *ctx);
+
+AMVP_RESULT amvp_evidence_write(AMVP_CTX *ctx, const char *te_id);
+
+void amvp_evidence_free(AMVP_CTX *ctx);
+
+typedef AMVP_RESULT (*AMVP_VS_DISPATCH_CB)(AMVP_CTX *ctx, JSON_Object *obj);
+
+AMVP_RESULT amvp_vs_stream_begin(AMVP_CTX *ctx, AMVP_VS_DISPATCH_CB dispatch);
+
+AMVP_RESULT amvp_vs_stream_feed(AMVP_CTX *ctx, int first);
+
+AMVP_RESULT amvp_vs_stream_end(AMVP_CTX *ctx, int *streamed);
+
+AMVP_RESULT amvp_checkpoint_open(AMVP_CTX *ctx, const char *session_file);
+
+AMVP_CKPT_STATE amvp_checkpoint_state(AMVP_CTX *ctx, const char *vsid_url);
+
+AMVP_RESULT amvp_checkpoint_downloaded(AMVP_CTX *ctx, const char *vsid_url, int vs_id,
+                                       const char *body, size_t body_len);
+
+AMVP_RESULT amvp_checkpoint_processed(AMVP_CTX *ctx, const char *vsid_url,
+                                      const char *rsp, size_t rsp_len);
+
+AMVP_RESULT amvp_checkpoint_uploaded(AMVP_CTX *ctx, const char *vsid_url);
+
+AMVP_RESULT amvp_checkpoint_load(AMVP_CTX *ctx, const char *vsid_url, AMVP_CKPT_STATE state,
+                                 char **data, size_t *data_len);
+
+void amvp_checkpoint_free(AMVP_CTX *ctx);
+
+/*
+ * Crypto result cache, see amvp_crypto_cache.c. amvp_crypto_cache_call()
+ * stands in for cap->crypto_handler, and just calls it when the cache is
+ * off or the test case can't be cached.
+ */
+int amvp_crypto_cache_call(AMVP_CTX *ctx, AMVP_CAPS_LIST *cap, AMVP_TEST_CASE *tc);
+
+int amvp_crypto_cache_lookup(AMVP_CTX *ctx, AMVP_CAPS_LIST *cap, AMVP_TEST_CASE *tc);
+
+void amvp_crypto_cache_store(AMVP_CTX *ctx, AMVP_CAPS_LIST *cap, AMVP_TEST_CASE *tc);
+
+void amvp_crypto_cache_free(AMVP_CTX *ctx);
+
 /*
  * These are the handler routines for each KAT operation
  */
@@ -1893,6 +2613,12 @@ AMVP_RESULT amvp_safe_primes_kat_handler(AMVP_CTX *ctx, JSON_Object *obj);
 /* AMVP build registration functions used internally */
 AMVP_RESULT amvp_build_registration_json(AMVP_CTX *ctx, JSON_Value **reg);
 
+AMVP_RESULT amvp_get_registration(AMVP_CTX *ctx, JSON_Value **reg);
+
+void amvp_set_registration(AMVP_CTX *ctx, JSON_Value *reg);
+
+void amvp_registration_invalidate(AMVP_CTX *ctx);
+
 AMVP_RESULT amvp_build_full_registration(AMVP_CTX *ctx, char **out, int *out_len);
 
 AMVP_RESULT amvp_build_validation(AMVP_CTX *ctx, char **out, int *out_len);
@@ -1913,9 +2639,18 @@ AMVP_RESULT amvp_notify_large(AMVP_CTX *ctx,
  * AMVP utility functions used internally
  */
 AMVP_CAPS_LIST *amvp_locate_cap_entry(AMVP_CTX *ctx, AMVP_CIPHER cipher);
+int amvp_cap_store_shared(AMVP_CTX *ctx);
+AMVP_ARENA *amvp_cap_arena(AMVP_CTX *ctx);
+void *amvp_cap_alloc(AMVP_CTX *ctx, size_t size);
+void amvp_cap_store_share(AMVP_CTX *src, AMVP_CTX *dst);
+void amvp_cap_store_release(AMVP_CTX *ctx);
 
 const char *amvp_lookup_cipher_name(AMVP_CIPHER alg);
 
+void amvp_alg_index_init(void);
+
+int amvp_lookup_alg_tbl_index(const char *algorithm, const char *mode);
+
 AMVP_CIPHER amvp_lookup_cipher_index(const char *algorithm);
 
 AMVP_CIPHER amvp_lookup_cipher_w_mode_index(const char *algorithm,
@@ -1929,9 +2664,9 @@ const char *amvp_lookup_alt_revision_string(AMVP_REVISION rev);
 AMVP_DRBG_MODE amvp_lookup_drbg_mode_index(const char *mode);
 
 AMVP_DRBG_MODE_LIST *amvp_locate_drbg_mode_entry(AMVP_CAPS_LIST *cap, AMVP_DRBG_MODE mode);
-AMVP_DRBG_MODE_LIST *amvp_create_drbg_mode_entry(AMVP_CAPS_LIST *cap, AMVP_DRBG_MODE mode);
+AMVP_DRBG_MODE_LIST *amvp_create_drbg_mode_entry(AMVP_ARENA *arena, AMVP_CAPS_LIST *cap, AMVP_DRBG_MODE mode);
 AMVP_DRBG_CAP_GROUP *amvp_locate_drbg_group_entry(AMVP_DRBG_MODE_LIST *mode, int group);
-AMVP_DRBG_CAP_GROUP *amvp_create_drbg_group(AMVP_DRBG_MODE_LIST *mode, int group);
+AMVP_DRBG_CAP_GROUP *amvp_create_drbg_group(AMVP_ARENA *arena, AMVP_DRBG_MODE_LIST *mode, int group);
 
 const char *amvp_lookup_rsa_randpq_name(int value);
 
@@ -1954,13 +2689,17 @@ const char *amvp_lookup_ec_curve_name(AMVP_CIPHER cipher, AMVP_EC_CURVE id);
 
 AMVP_RESULT amvp_refresh(AMVP_CTX *ctx);
 
+AMVP_RESULT amvp_build_login(AMVP_CTX *ctx, char **login, int *login_len, const char *refresh_jwt);
+
+time_t amvp_jwt_expiry(const char *jwt, time_t *issued);
+
+void amvp_jwt_track(AMVP_CTX *ctx);
+
+void amvp_jwt_renew_free(AMVP_CTX *ctx);
+
 void amvp_http_user_agent_handler(AMVP_CTX *ctx);
 
-AMVP_RESULT amvp_setup_json_ev_group(AMVP_CTX **ctx,
-                                      JSON_Value **outer_arr_val,
-                                      JSON_Value **r_vs_val,
-                                      JSON_Object **r_vs,
-                                      JSON_Array **groups_arr);
+void amvp_session_group_detach(AMVP_CTX *ctx);
 
 AMVP_RESULT amvp_setup_json_rsp_group(AMVP_CTX **ctx,
                                       JSON_Value **outer_arr_val,
@@ -1983,13 +2722,17 @@ AMVP_RESULT amvp_kv_list_append(AMVP_KV_LIST **kv_list,
 void amvp_kv_list_free(AMVP_KV_LIST *kv_list);
 
 void amvp_free_str_list(AMVP_STRING_LIST **list);
-AMVP_RESULT amvp_append_sl_list(AMVP_SL_LIST **list, int length);
-AMVP_RESULT amvp_append_param_list(AMVP_PARAM_LIST **list, int param);
-AMVP_RESULT amvp_append_name_list(AMVP_NAME_LIST **list, const char *string);
+AMVP_RESULT amvp_append_param_list(AMVP_ARENA *arena, AMVP_PARAM_LIST **list, int param);
+AMVP_RESULT amvp_value_set_add(AMVP_ARENA *arena, AMVP_VALUE_SET *set, int value);
+int amvp_value_set_has(const AMVP_VALUE_SET *set, int value);
+int amvp_value_set_next(const AMVP_VALUE_SET *set, int *value);
+AMVP_RESULT amvp_append_name_list(AMVP_ARENA *arena, AMVP_NAME_LIST **list, const char *string);
 int amvp_is_in_name_list(AMVP_NAME_LIST *list, const char *string);
 AMVP_RESULT amvp_append_str_list(AMVP_STRING_LIST **list, const char *string);
 int amvp_lookup_str_list(AMVP_STRING_LIST **list, const char *string);
-int amvp_lookup_param_list(AMVP_PARAM_LIST *list, int value);
+int amvp_str_set_add(AMVP_STR_SET *set, const char *string);
+int amvp_str_set_has(const AMVP_STR_SET *set, const char *string);
+void amvp_str_set_free(AMVP_STR_SET *set);
 const char* amvp_lookup_aux_function_alg_str(AMVP_CIPHER alg);
 AMVP_CIPHER amvp_lookup_aux_function_alg_tbl(const char *str);
 int amvp_is_domain_already_set(AMVP_JSON_DOMAIN_OBJ *domain);
@@ -2001,6 +2744,67 @@ AMVP_KDF108_MODE read_mode(const char *str);
 
 AMVP_RESULT amvp_json_serialize_to_file_pretty_a(const JSON_Value *value, const char *filename);
 AMVP_RESULT amvp_json_serialize_to_file_pretty_w(const JSON_Value *value, const char *filename);
+AMVP_RESULT amvp_json_serialize_to_file_a(AMVP_CTX *ctx, const JSON_Value *value, const char *filename);
+AMVP_RESULT amvp_json_serialize_to_file_w(AMVP_CTX *ctx, const JSON_Value *value, const char *filename);
+char *amvp_json_serialize(AMVP_CTX *ctx, const JSON_Value *value, int *len);
+
+AMVP_STR_VIEW amvp_json_view(const JSON_Object *obj, const char *name);
+AMVP_STR_VIEW amvp_json_view_key(const JSON_Object *obj, const JSON_Key *key);
+AMVP_RESULT amvp_view_to_bin(AMVP_STR_VIEW src, unsigned char *dest, int dest_max, int *converted_len);
+AMVP_RESULT amvp_json_set_hex(JSON_Object *obj, const char *name, const unsigned char *bin, int bin_len);
+
+void *amvp_arena_alloc(AMVP_ARENA *arena, size_t size);
+unsigned char *amvp_arena_alloc_hex(AMVP_ARENA *arena, const char *hex, int min_len, int max_len);
+AMVP_RESULT amvp_arena_decode_hex(AMVP_ARENA *arena, AMVP_STR_VIEW hex, int min_len, int max_len,
+                                  unsigned char **out, int *converted_len);
+void amvp_arena_reset(AMVP_ARENA *arena);
+void amvp_arena_free(AMVP_ARENA *arena);
+void amvp_json_arena_begin(AMVP_CTX *ctx);
+void amvp_json_arena_end(AMVP_CTX *ctx, JSON_Value **val);
+
+AMVP_RESULT amvp_jw_begin_object(AMVP_JSON_WRITER *w, const char *key);
+AMVP_RESULT amvp_jw_end_object(AMVP_JSON_WRITER *w);
+AMVP_RESULT amvp_jw_begin_array(AMVP_JSON_WRITER *w, const char *key);
+AMVP_RESULT amvp_jw_end_array(AMVP_JSON_WRITER *w);
+AMVP_RESULT amvp_jw_string(AMVP_JSON_WRITER *w, const char *key, const char *str);
+AMVP_RESULT amvp_jw_number(AMVP_JSON_WRITER *w, const char *key, double num);
+AMVP_RESULT amvp_jw_bool(AMVP_JSON_WRITER *w, const char *key, int val);
+AMVP_RESULT amvp_jw_hex(AMVP_JSON_WRITER *w, const char *key, const unsigned char *bin, int bin_len);
+AMVP_RESULT amvp_jw_value(AMVP_JSON_WRITER *w, const char *key, const JSON_Value *val);
+AMVP_RESULT amvp_jw_base64_file(AMVP_JSON_WRITER *w, const char *key, FILE *fp);
+char *amvp_jw_detach(AMVP_JSON_WRITER *w, int *len);
+size_t amvp_jw_read_at(AMVP_JSON_WRITER *w, size_t off, char *buf, size_t len);
+void amvp_jw_reset(AMVP_JSON_WRITER *w);
+void amvp_jw_free(AMVP_JSON_WRITER *w);
+AMVP_RESULT amvp_jw_begin_vs_rsp(AMVP_CTX *ctx, const char *alg_str, const char *mode_str);
+AMVP_RESULT amvp_jw_begin_ie_rsp(AMVP_CTX *ctx);
+AMVP_RESULT amvp_jw_end_vs_rsp(AMVP_CTX *ctx);
+AMVP_RESULT amvp_kat_resp_serialize(AMVP_CTX *ctx, char **out, int *out_len);
+AMVP_RESULT amvp_kat_resp_write_vs(AMVP_CTX *ctx, FILE *fp);
+
+void amvp_jp_init(AMVP_JSON_PRODUCER *p, const JSON_Value *root);
+size_t amvp_jp_read(AMVP_JSON_PRODUCER *p, char *buf, size_t len);
+void amvp_jp_free(AMVP_JSON_PRODUCER *p);
+
+AMVP_RESULT amvp_req_file_begin(AMVP_CTX *ctx, const JSON_Value *ids);
+AMVP_RESULT amvp_req_file_add(AMVP_CTX *ctx, const JSON_Value *val);
+AMVP_RESULT amvp_req_file_end(AMVP_CTX *ctx);
+void amvp_req_file_free(AMVP_REQ_FILE *rf);
+
+AMVP_RESULT amvp_json_reader_open(AMVP_JSON_FILE_READER *rdr, const char *filename);
+AMVP_RESULT amvp_json_reader_next(AMVP_JSON_FILE_READER *rdr, JSON_Value **val);
+AMVP_RESULT amvp_json_reader_next_in_place(AMVP_JSON_FILE_READER *rdr, JSON_Value **val);
+AMVP_RESULT amvp_json_reader_next_slice(AMVP_JSON_FILE_READER *rdr, const char **elem, size_t *elem_len);
+AMVP_RESULT amvp_json_reader_slice_int(const char *elem, size_t elem_len, const char *key, int *out);
+void amvp_json_reader_close(AMVP_JSON_FILE_READER *rdr);
+
+AMVP_RESULT amvp_vs_cache_write(AMVP_CTX *ctx, const char *req_filename, const JSON_Value *val);
+AMVP_RESULT amvp_vs_cache_load(AMVP_CTX *ctx, const char *req_filename, AMVP_VS_CACHE_MAP *map,
+                               JSON_Value **val);
+JSON_Value *amvp_vs_cache_open(AMVP_CTX *ctx, const char *req_filename, AMVP_VS_CACHE_MAP *map);
+AMVP_RESULT amvp_vs_cache_find(const AMVP_VS_CACHE_MAP *map, int vs_id, int tc_id, int *tg_id,
+                               JSON_Value **tc);
+void amvp_vs_cache_unmap(AMVP_VS_CACHE_MAP *map);
 
 
 #endif
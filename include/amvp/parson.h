@@ -62,6 +62,23 @@ typedef void   (*JSON_Free_Function)(void *);
    from stdlib will be used for all allocations */
 void json_set_allocation_functions(JSON_Malloc_Function malloc_fun, JSON_Free_Function free_fun);
 
+/* The functions set with json_set_allocation_functions, malloc and free if it wasn't called */
+void json_get_allocation_functions(JSON_Malloc_Function *malloc_fun, JSON_Free_Function *free_fun);
+
+/* Allocator with a context pointer, e.g. for putting a parse tree in an arena. */
+typedef struct json_allocator_t {
+    void * (*malloc_fun)(void *opaque, size_t size);
+    void   (*free_fun)(void *opaque, void *ptr);
+    void   *opaque;
+} JSON_Allocator;
+
+/* Makes the calling thread use allocator for all values, objects, arrays and strings it creates
+   or frees, until it is called again; NULL goes back to the functions passed to
+   json_set_allocation_functions. Returns the previous thread allocator. Serialized strings are
+   always allocated with the global functions so they can be freed with json_free_serialized_string.
+   Only affects the calling thread. */
+const JSON_Allocator * json_set_thread_allocator(const JSON_Allocator *allocator);
+
 /* Sets if slashes should be escaped or not when serializing JSON. By default slashes are escaped.
  This function sets a global setting and is not thread safe. */
 void json_set_escape_slashes(int escape_slashes);
@@ -69,6 +86,9 @@ void json_set_escape_slashes(int escape_slashes);
 /* Parses first JSON value in a file, returns NULL in case of error */
 JSON_Value * json_parse_file(const char *filename);
 
+/* Like json_parse_string, with every allocation of the parse made from allocator */
+JSON_Value * json_parse_string_with_allocator(const char *string, const JSON_Allocator *allocator);
+
 /* Parses first JSON value in a file and ignores comments (/ * * / and //),
    returns NULL in case of error */
 #if 0
@@ -78,6 +98,11 @@ JSON_Value * json_parse_file_with_comments(const char *filename);
 /*  Parses first JSON value in a string, returns NULL in case of error */
 JSON_Value * json_parse_string(const char *string);
 
+/*  Like json_parse_string, but parses string in place: it is modified, and the string values of
+    the result point into it instead of being copied, so it must be kept and left alone until the
+    result is freed. Meant for large documents that are only read, like vector sets. */
+JSON_Value * json_parse_string_in_place(char *string);
+
 /*  Parses first JSON value in a string and ignores comments (/ * * / and //),
     returns NULL in case of error */
 #if 0
@@ -124,6 +149,23 @@ JSON_Array  * json_object_get_array  (const JSON_Object *object, const char *nam
 double        json_object_get_number (const JSON_Object *object, const char *name); /* returns 0 on fail */
 int           json_object_get_boolean(const JSON_Object *object, const char *name); /* returns -1 on fail */
 
+/* Lookups with a key whose length and hash are computed once by json_key_init, for names that are
+ looked up in many objects, e.g. every test case of a vector set. Larger objects are searched through
+ a hash index kept up to date as members are added, so lookups never modify the object and a
+ read-only object can be shared between threads; the key must outlive its uses. */
+typedef struct json_key_t {
+    const char   *name;
+    size_t        len;
+    unsigned long hash;
+} JSON_Key;
+
+void          json_key_init(JSON_Key *key, const char *name);
+JSON_Value  * json_object_get_value_key (const JSON_Object *object, const JSON_Key *key);
+const char  * json_object_get_string_key(const JSON_Object *object, const JSON_Key *key);
+JSON_Object * json_object_get_object_key(const JSON_Object *object, const JSON_Key *key);
+JSON_Array  * json_object_get_array_key (const JSON_Object *object, const JSON_Key *key);
+double        json_object_get_number_key(const JSON_Object *object, const JSON_Key *key); /* returns 0 on fail */
+
 /* dotget functions enable addressing values with dot notation in nested objects,
  just like in structs or c++/java/c# objects (e.g. objectA.objectB.value).
  Because valid names in JSON can contain dots, some values may be inaccessible
@@ -211,6 +253,9 @@ JSON_Status json_array_replace_null(JSON_Array *array, size_t i);
 /* Frees and removes all values from array */
 JSON_Status json_array_clear(JSON_Array *array);
 
+/* Added by AMVP: moves all values of from to the end of to WITHOUT copying, leaving from empty */
+JSON_Status json_array_move_values(JSON_Array *to, JSON_Array *from);
+
 /* Appends new value at the end of array.
  * json_array_append_value does not copy passed value so it shouldn't be freed afterwards. */
 JSON_Status json_array_append_value(JSON_Array *array, JSON_Value *value);
@@ -227,6 +272,8 @@ JSON_Value * json_value_init_object (void);
 JSON_Value * json_value_init_array  (void);
 JSON_Value * json_value_init_string (const char *string); /* copies passed string */
 JSON_Value * json_value_init_string_with_len(const char *string, size_t length); /* copies passed string, length shouldn't include last null character */
+JSON_Value * json_value_init_string_buffer(size_t length, char **chars); /* caller writes 'length' valid UTF-8 characters to *chars */
+JSON_Value * json_value_init_string_ref(const char *chars, size_t length, int has_bin); /* doesn't copy, chars must outlive the value; with has_bin the hex decoded bytes follow the null character */
 JSON_Value * json_value_init_number (double number);
 JSON_Value * json_value_init_boolean(int boolean);
 JSON_Value * json_value_init_null   (void);
@@ -238,6 +285,7 @@ JSON_Object *   json_value_get_object (const JSON_Value *value);
 JSON_Array  *   json_value_get_array  (const JSON_Value *value);
 const char  *   json_value_get_string (const JSON_Value *value);
 size_t          json_value_get_string_len(const JSON_Value *value); /* doesn't account for last null character */
+const unsigned char * json_value_get_string_bin(const JSON_Value *value); /* decoded bytes of a json_value_init_string_ref() string, NULL otherwise */
 double          json_value_get_number (const JSON_Value *value);
 int             json_value_get_boolean(const JSON_Value *value);
 JSON_Value  *   json_value_get_parent (const JSON_Value *value);
@@ -18,6 +18,10 @@
 #include <unistd.h>
 #endif
 #include <math.h>
+#include <time.h>
+#if !defined AMVP_OFFLINE && !defined USE_MURL
+#include <curl/curl.h>
+#endif
 #include "amvp.h"
 #include "amvp_lcl.h"
 #include "amvp_error.h"
@@ -42,7 +46,11 @@ static AMVP_RESULT amvp_parse_test_session_register(AMVP_CTX *ctx);
 
 static AMVP_RESULT amvp_parse_session_info_file(AMVP_CTX *ctx, const char *filename);
 
-static AMVP_RESULT amvp_process_vsid(AMVP_CTX *ctx, char *vsid_url, int count);
+static AMVP_RESULT amvp_process_vsid(AMVP_CTX *ctx, char *vsid_url, int count, int *retry_period);
+
+static AMVP_RESULT amvp_process_vsid_list(AMVP_CTX *ctx, AMVP_STRING_LIST *list, int first_count);
+
+static void amvp_async_free(AMVP_CTX *ctx);
 
 static AMVP_RESULT amvp_process_vector_set(AMVP_CTX *ctx, JSON_Object *obj);
 
@@ -50,21 +58,13 @@ static AMVP_RESULT amvp_process_ie_set(AMVP_CTX *ctx, JSON_Object *obj);
 
 static AMVP_RESULT amvp_dispatch_vector_set(AMVP_CTX *ctx, JSON_Object *obj);
 
-static void amvp_cap_free_sl(AMVP_SL_LIST *list);
-
-static void amvp_cap_free_nl(AMVP_NAME_LIST *list);
-
-static void amvp_cap_free_pl(AMVP_PARAM_LIST *list);
-
-static void amvp_cap_free_domain(AMVP_JSON_DOMAIN_OBJ *domain);
-
-static void amvp_cap_free_hash_pairs(AMVP_RSA_HASH_PAIR_LIST *list);
-
-static AMVP_RESULT amvp_get_result_test_session(AMVP_CTX *ctx, char *session_url);
+static AMVP_RESULT amvp_get_result_test_session(AMVP_CTX *ctx, char *session_url, AMVP_RESULTS_POLL *poll);
 
 static AMVP_RESULT amvp_put_data_from_ctx(AMVP_CTX *ctx);
 
 static AMVP_RESULT amvp_retry_handler(AMVP_CTX *ctx, int *retry_period, unsigned int *waited_so_far, int modifier, AMVP_WAITING_STATUS situation);
+static AMVP_RESULT amvp_retry_check(AMVP_CTX *ctx, int *retry_period, unsigned int *waited_so_far, AMVP_WAITING_STATUS situation);
+static void amvp_retry_advance(AMVP_CTX *ctx, int *retry_period, unsigned int *waited_so_far, int modifier);
 
 static AMVP_RESULT amvp_handle_protocol_error(AMVP_CTX *ctx, AMVP_PROTOCOL_ERR *err);
 
@@ -208,406 +208,132 @@ AMVP_RESULT amvp_create_test_session(AMVP_CTX **ctx,
     if (level >= AMVP_LOG_LVL_DEBUG) {
         (*ctx)->debug = 1;
     }
+    (*ctx)->max_transfers = 1;
+    (*ctx)->worker_threads = 1;
+    amvp_alg_index_init();
 
     return AMVP_SUCCESS;
 }
 
-AMVP_RESULT amvp_set_2fa_callback(AMVP_CTX *ctx, AMVP_RESULT (*totp_cb)(char **token, int token_max)) {
-    if (totp_cb == NULL) {
-        return AMVP_MISSING_ARG;
-    }
-    if (ctx == NULL) {
-        return AMVP_NO_CTX;
-    }
-    ctx->totp_cb = totp_cb;
-    return AMVP_SUCCESS;
-}
-
-static void amvp_free_prereqs(AMVP_CAPS_LIST *cap_list) {
-    while (cap_list->prereq_vals) {
-        AMVP_PREREQ_LIST *temp_ptr;
-        temp_ptr = cap_list->prereq_vals;
-        cap_list->prereq_vals = cap_list->prereq_vals->next;
-        free(temp_ptr);
-    }
-}
-
-/*
- * Free internal memory for EC curve/hash alg list
- */
-static void amvp_cap_free_ec_alg_list(AMVP_CURVE_ALG_COMPAT_LIST *list) {
-    AMVP_CURVE_ALG_COMPAT_LIST *tmp = NULL, *tmp2 = NULL;
-
-    if (!list) {
-        return;
-    }
-
-    tmp = list;
-    while (tmp) {
-        tmp2 = tmp;
-        tmp = tmp->next;
-        free(tmp2);
-    }
-}
-
 /*
- * Free Internal memory for DSA operations. Since it supports
- * multiple modes, we have to free the whole list
+ * Creates a context with the capabilities and server settings of src.
+ * The capabilities aren't copied, the new context shares them, so this
+ * costs the same however many were registered. Session state, files,
+ * credentials and the optional caches, metrics and logging are not
+ * carried over.
  */
-static void amvp_cap_free_dsa_attrs(AMVP_CAPS_LIST *cap_entry) {
-    AMVP_DSA_ATTRS *attrs = NULL, *next = NULL;
-    AMVP_DSA_CAP_MODE *dsa_cap_mode = NULL;
-    int i;
-
-    for (i = 0; i <= AMVP_DSA_MAX_MODES - 1; i++) {
-        dsa_cap_mode = &cap_entry->cap.dsa_cap->dsa_cap_mode[i];
-        if (dsa_cap_mode->defined) {
-            next = dsa_cap_mode->dsa_attrs;
-            while (next) {
-                attrs = next;
-                next = attrs->next;
-                free(attrs);
-            }
-        }
-    }
-    dsa_cap_mode = cap_entry->cap.dsa_cap->dsa_cap_mode;
-    free(dsa_cap_mode);
-}
-
-/*
- * Free Internal memory for keygen struct. Since it supports
- * multiple modes, we have to free the whole list
- */
-static void amvp_cap_free_rsa_keygen_list(AMVP_CAPS_LIST *cap_list) {
-    AMVP_RSA_KEYGEN_CAP *keygen_cap = cap_list->cap.rsa_keygen_cap;
-    AMVP_RSA_KEYGEN_CAP *temp_keygen_cap;
-
-    amvp_free_prereqs(cap_list);
-
-    while (keygen_cap) {
-        if (keygen_cap->fixed_pub_exp) {
-            free(keygen_cap->fixed_pub_exp);
-        }
-
-        AMVP_RSA_MODE_CAPS_LIST *mode_list = keygen_cap->mode_capabilities;
-        AMVP_RSA_MODE_CAPS_LIST *temp_mode_list;
-
-        while (mode_list) {
-            amvp_cap_free_nl(mode_list->hash_algs);
-            amvp_cap_free_nl(mode_list->prime_tests);
-
-            temp_mode_list = mode_list;
-            mode_list = mode_list->next;
-            free(temp_mode_list);
-            temp_mode_list = NULL;
-        }
+AMVP_RESULT amvp_ctx_clone(AMVP_CTX *src, AMVP_CTX **dst) {
+    AMVP_CTX *ctx = src;
+    AMVP_CTX *clone = NULL;
+    AMVP_RESULT rv = AMVP_SUCCESS;
 
-        temp_keygen_cap = keygen_cap;
-        keygen_cap = keygen_cap->next;
-        free(temp_keygen_cap);
-        temp_keygen_cap = NULL;
+    if (!src) {
+        return AMVP_NO_CTX;
     }
-}
-
-/*
- * Free Internal memory for keygen struct. Since it supports
- * multiple modes, we have to free the whole list
- */
-static void amvp_cap_free_rsa_sig_list(AMVP_CAPS_LIST *cap_list) {
-    AMVP_RSA_SIG_CAP *sig_cap = NULL, *temp_sig_cap = NULL;
-
-    if (cap_list->cipher == AMVP_RSA_SIGGEN) {
-        sig_cap = cap_list->cap.rsa_siggen_cap;
-    } else if (cap_list->cipher == AMVP_RSA_SIGVER) {
-        sig_cap = cap_list->cap.rsa_sigver_cap;
-    } else {
-        return;
+    if (!dst) {
+        return AMVP_INVALID_ARG;
     }
-
-    amvp_free_prereqs(cap_list);
-
-    while (sig_cap) {
-        AMVP_RSA_MODE_CAPS_LIST *mode_list = sig_cap->mode_capabilities;
-        AMVP_RSA_MODE_CAPS_LIST *temp_mode_list;
-
-        if (sig_cap->fixed_pub_exp) {
-            free(sig_cap->fixed_pub_exp);
-        }
-        while (mode_list) {
-            amvp_cap_free_hash_pairs(mode_list->hash_pair);
-
-            temp_mode_list = mode_list;
-            mode_list = mode_list->next;
-            free(temp_mode_list);
-            temp_mode_list = NULL;
-        }
-
-        temp_sig_cap = sig_cap;
-        sig_cap = sig_cap->next;
-        free(temp_sig_cap);
-        temp_sig_cap = NULL;
+    if (*dst) {
+        return AMVP_CTX_NOT_EMPTY;
     }
-}
-
-/*
- * Free Internal memory for KAS-ECC Data struct
- */
-static void amvp_cap_free_kas_ecc_mode(AMVP_CAPS_LIST *cap_list) {
-    AMVP_KAS_ECC_CAP *kas_ecc_cap = cap_list->cap.kas_ecc_cap;
-    AMVP_KAS_ECC_CAP_MODE *mode;
-    int i;
 
-    if (kas_ecc_cap) {
-        AMVP_PREREQ_LIST *current_pre_req_vals;
-        AMVP_PREREQ_LIST *next_pre_req_vals;
-        AMVP_KAS_ECC_PSET *current_pset;
-        AMVP_KAS_ECC_PSET *next_pset;
-        AMVP_KAS_ECC_SCHEME *current_scheme;
-        AMVP_KAS_ECC_SCHEME *next_scheme;
-
-        if (kas_ecc_cap->kas_ecc_mode) {
-            for (i = 0; i < AMVP_KAS_ECC_MAX_MODES; i++) {
-                mode = &kas_ecc_cap->kas_ecc_mode[i];
-                current_pre_req_vals = mode->prereq_vals;
-                /*
-                 * Delete all pre_req
-                 */
-                if (current_pre_req_vals) {
-                    do {
-                        next_pre_req_vals = current_pre_req_vals->next;
-                        free(current_pre_req_vals);
-                        current_pre_req_vals = next_pre_req_vals;
-                    } while (current_pre_req_vals);
-                }
-                /*
-                 * Delete all function name lists
-                 */
-                amvp_cap_free_pl(mode->function);
-
-                /*
-                 * Delete all curve name lists
-                 */
-                amvp_cap_free_pl(mode->curve);
-
-                /*
-                 * Delete all schemes, psets and their param lists
-                 */
-                current_scheme = mode->scheme;
-                if (current_scheme) {
-                    do {
-                        amvp_cap_free_pl(current_scheme->role);
-                        current_pset = current_scheme->pset;
-                        if (current_pset) {
-                            do {
-                                amvp_cap_free_pl(current_pset->sha);
-                                next_pset = current_pset->next;
-                                free(current_pset);
-                                current_pset = next_pset;
-                            } while (current_pset);
-                        }
-                        next_scheme = current_scheme->next;
-                        free(current_scheme);
-                        current_scheme = next_scheme;
-                    } while (current_scheme);
-                }
-            }
-        }
+    rv = amvp_create_test_session(&clone, src->test_progress_cb, src->log_lvl);
+    if (rv != AMVP_SUCCESS) {
+        return rv;
     }
-    free(cap_list->cap.kas_ecc_cap->kas_ecc_mode);
-    free(cap_list->cap.kas_ecc_cap);
-}
-
-/*
- * Free Internal memory for KAS-FFC Data struct
- */
-static void amvp_cap_free_kas_ffc_mode(AMVP_CAPS_LIST *cap_list) {
-    AMVP_KAS_FFC_CAP *kas_ffc_cap = cap_list->cap.kas_ffc_cap;
-    AMVP_KAS_FFC_CAP_MODE *mode;
-    int i;
-
-    if (kas_ffc_cap) {
-        AMVP_PREREQ_LIST *current_pre_req_vals;
-        AMVP_PREREQ_LIST *next_pre_req_vals;
-        AMVP_KAS_FFC_PSET *current_pset;
-        AMVP_KAS_FFC_PSET *next_pset;
-        AMVP_KAS_FFC_SCHEME *current_scheme;
-        AMVP_KAS_FFC_SCHEME *next_scheme;
-
-        if (kas_ffc_cap->kas_ffc_mode) {
-            for (i = 0; i < AMVP_KAS_FFC_MAX_MODES; i++) {
-                mode = &kas_ffc_cap->kas_ffc_mode[i];
-                current_pre_req_vals = mode->prereq_vals;
-                /*
-                 * Delete all pre_req
-                 */
-                if (current_pre_req_vals) {
-                    do {
-                        next_pre_req_vals = current_pre_req_vals->next;
-                        free(current_pre_req_vals);
-                        current_pre_req_vals = next_pre_req_vals;
-                    } while (current_pre_req_vals);
-                }
-                /*
-                 * Delete all generation methods
-                 */
-                amvp_cap_free_pl(mode->genmeth);
-
-                /*
-                 * Delete all function name lists
-                 */
-                amvp_cap_free_pl(mode->function);
+    clone->totp_cb = src->totp_cb;
+
+    if (src->server_name) {
+        rv = amvp_set_server(clone, src->server_name, src->server_port);
+        if (rv != AMVP_SUCCESS) goto err;
+    }
+    if (src->path_segment) {
+        rv = amvp_set_path_segment(clone, src->path_segment);
+        if (rv != AMVP_SUCCESS) goto err;
+    }
+    if (src->api_context) {
+        rv = amvp_set_api_context(clone, src->api_context);
+        if (rv != AMVP_SUCCESS) goto err;
+    }
+    if (src->cacerts_file) {
+        rv = amvp_set_cacerts(clone, src->cacerts_file);
+        if (rv != AMVP_SUCCESS) goto err;
+    }
+    if (src->tls_cert && src->tls_key) {
+        rv = amvp_set_certkey(clone, src->tls_cert, src->tls_key);
+        if (rv != AMVP_SUCCESS) goto err;
+    }
+    clone->verify_peer = src->verify_peer;
+    clone->http2 = src->http2;
+    clone->max_transfers = src->max_transfers;
+    clone->vs_schedule = src->vs_schedule;
+    clone->pipeline_depth = src->pipeline_depth;
+    clone->lazy_file_parse = src->lazy_file_parse;
+    clone->vs_cache = src->vs_cache;
+    clone->json_arena_enabled = src->json_arena_enabled;
+    clone->json_compact = src->json_compact;
+    clone->upload_compress = src->upload_compress;
+    clone->upload_chunk = src->upload_chunk;
+    clone->rsp_mem_budget = src->rsp_mem_budget;
+    clone->jwt_renew_margin = src->jwt_renew_margin;
+    clone->incremental_parse = src->incremental_parse;
+    clone->req_file.buf_size = src->req_file.buf_size;
+    clone->req_file.fsync = src->req_file.fsync;
+    clone->worker_affinity = src->worker_affinity;
+    if (src->worker_threads > 1) {
+        rv = amvp_set_worker_threads(clone, src->worker_threads);
+        if (rv != AMVP_SUCCESS) goto err;
+    }
+
+    amvp_cap_store_share(src, clone);
+    *dst = clone;
+    return AMVP_SUCCESS;
 
-                /*
-                 * Delete all schemes, psets and their param lists
-                 */
-                current_scheme = mode->scheme;
-                if (current_scheme) {
-                    do {
-                        amvp_cap_free_pl(current_scheme->role);
-                        current_pset = current_scheme->pset;
-                        if (current_pset) {
-                            do {
-                                amvp_cap_free_pl(current_pset->sha);
-                                next_pset = current_pset->next;
-                                free(current_pset);
-                                current_pset = next_pset;
-                            } while (current_pset);
-                        }
-                        next_scheme = current_scheme->next;
-                        free(current_scheme);
-                        current_scheme = next_scheme;
-                    } while (current_scheme);
-                }
-            }
-        }
-    }
-    free(cap_list->cap.kas_ffc_cap->kas_ffc_mode);
-    free(cap_list->cap.kas_ffc_cap);
+err:
+    AMVP_LOG_ERR("Failed to clone context");
+    amvp_free_test_session(clone);
+    return rv;
 }
 
-/*
- * Free Internal memory for DRBG Data struct
- */
-static void amvp_free_drbg_struct(AMVP_CAPS_LIST *cap_list) {
-    AMVP_DRBG_CAP *drbg_cap = cap_list->cap.drbg_cap;
-
-    if (drbg_cap) {
-        AMVP_DRBG_MODE_LIST *mode_list = drbg_cap->drbg_cap_mode;
-        AMVP_DRBG_MODE_LIST *next_mode_list;
-        AMVP_DRBG_GROUP_LIST *group_list;
-        AMVP_DRBG_GROUP_LIST *next_group_list;
-        AMVP_PREREQ_LIST *current_pre_req_vals;
-        AMVP_PREREQ_LIST *next_pre_req_vals;
-
-        current_pre_req_vals = drbg_cap->prereq_vals;
-        while (current_pre_req_vals) {
-            next_pre_req_vals = current_pre_req_vals->next;
-            free(current_pre_req_vals);
-            current_pre_req_vals = next_pre_req_vals;
-        }
-
-        while (mode_list) {
-            group_list = mode_list->groups;
-            while (group_list) {
-                next_group_list = group_list->next;
-                if (group_list->group) {
-                    free(group_list->group);
-                }
-                free(group_list);
-                group_list = next_group_list;
-            }
-            next_mode_list = mode_list->next;
-            free(mode_list);
-            mode_list = next_mode_list;
-        }
-        free(drbg_cap);
-        drbg_cap = NULL;
-        cap_list->cap.drbg_cap = NULL;
+AMVP_RESULT amvp_set_2fa_callback(AMVP_CTX *ctx, AMVP_RESULT (*totp_cb)(char **token, int token_max)) {
+    if (totp_cb == NULL) {
+        return AMVP_MISSING_ARG;
     }
-}
-
-/*
- * Free Internal memory for KDF108 Cap struct
- */
-static void amvp_cap_free_kdf108(AMVP_KDF108_CAP *cap) {
-    AMVP_KDF108_MODE_PARAMS *mode_obj = NULL;
-
-    if (cap) {
-        if (cap->counter_mode.kdf_mode) {
-            mode_obj = &cap->counter_mode;
-            if (mode_obj->mac_mode) {
-                amvp_cap_free_nl(mode_obj->mac_mode);
-            }
-            if (mode_obj->data_order) {
-                amvp_cap_free_nl(mode_obj->data_order);
-            }
-            if (mode_obj->counter_lens) {
-                amvp_cap_free_sl(mode_obj->counter_lens);
-            }
-            amvp_cap_free_domain(&mode_obj->supported_lens);
-        }
-
-        if (cap->feedback_mode.kdf_mode) {
-            mode_obj = &cap->feedback_mode;
-            if (mode_obj->mac_mode) {
-                amvp_cap_free_nl(mode_obj->mac_mode);
-            }
-            if (mode_obj->data_order) {
-                amvp_cap_free_nl(mode_obj->data_order);
-            }
-            if (mode_obj->counter_lens) {
-                amvp_cap_free_sl(mode_obj->counter_lens);
-            }
-            amvp_cap_free_domain(&mode_obj->supported_lens);
-        }
-
-        if (cap->dpi_mode.kdf_mode) {
-            mode_obj = &cap->dpi_mode;
-            if (mode_obj->mac_mode) {
-                amvp_cap_free_nl(mode_obj->mac_mode);
-            }
-            if (mode_obj->data_order) {
-                amvp_cap_free_nl(mode_obj->data_order);
-            }
-            if (mode_obj->counter_lens) {
-                amvp_cap_free_sl(mode_obj->counter_lens);
-            }
-            amvp_cap_free_domain(&mode_obj->supported_lens);
-        }
-
-        cap = NULL;
+    if (ctx == NULL) {
+        return AMVP_NO_CTX;
     }
+    ctx->totp_cb = totp_cb;
+    return AMVP_SUCCESS;
 }
 
-static void amvp_cap_free_kts_ifc_schemes(AMVP_CAPS_LIST *cap_entry) {
-    AMVP_KTS_IFC_SCHEMES *current_scheme;
-
-
-    current_scheme = cap_entry->cap.kts_ifc_cap->schemes;
-    while (current_scheme) {
-        amvp_cap_free_pl(current_scheme->roles);
-        amvp_cap_free_pl(current_scheme->hash);
-        free(current_scheme->assoc_data_pattern);
-        free(current_scheme->encodings);
-        current_scheme = current_scheme->next;
-    }
-    free(cap_entry->cap.kts_ifc_cap->schemes);
-}
 /*
  * The application will invoke this to free the AMVP context
  * when the test session is finished.
  */
 AMVP_RESULT amvp_free_test_session(AMVP_CTX *ctx) {
     AMVP_VS_LIST *vs_entry, *vs_e2;
-    AMVP_CAPS_LIST *cap_entry, *cap_e2;
 
     if (!ctx) {
         AMVP_LOG_STATUS("No ctx to free");
         return AMVP_SUCCESS;
     }
 
+    amvp_session_group_detach(ctx);
+    amvp_jwt_renew_free(ctx);
+    amvp_transport_cleanup(ctx);
+    amvp_async_free(ctx);
+    amvp_worker_pool_free(ctx);
+    amvp_proc_pool_free(ctx);
+    amvp_arena_free(&ctx->tc_arena);
+    if (ctx->json_arena_active) {
+        ctx->kat_resp = NULL;
+        json_set_thread_allocator(ctx->json_prev_alloc);
+    }
+    amvp_arena_free(&ctx->json_arena);
     if (ctx->kat_resp) { json_value_free(ctx->kat_resp); }
-    if (ctx->curl_buf) { free(ctx->curl_buf); }
+    amvp_jw_free(&ctx->kat_writer);
+    amvp_req_file_free(&ctx->req_file);
+    if (ctx->curl_buf) { amvp_mem_free(ctx->curl_buf); }
     if (ctx->server_name) { free(ctx->server_name); }
     if (ctx->path_segment) { free(ctx->path_segment); }
     if (ctx->api_context) { free(ctx->api_context); }
@@ -639,299 +365,30 @@ AMVP_RESULT amvp_free_test_session(AMVP_CTX *ctx) {
     if (ctx->vsid_url_list) {
         amvp_free_str_list(&ctx->vsid_url_list);
     }
-    if (ctx->registration) {
-            json_value_free(ctx->registration);
-    }
-    if (ctx->caps_list) {
-        cap_entry = ctx->caps_list;
-        while (cap_entry) {
-            cap_e2 = cap_entry->next;
-            if (cap_entry->prereq_vals) {
-                amvp_free_prereqs(cap_entry);
-            }
-            switch (cap_entry->cap_type) {
-            case AMVP_SYM_TYPE:
-                amvp_cap_free_sl(cap_entry->cap.sym_cap->keylen);
-                amvp_cap_free_sl(cap_entry->cap.sym_cap->ptlen);
-                amvp_cap_free_sl(cap_entry->cap.sym_cap->ivlen);
-                amvp_cap_free_sl(cap_entry->cap.sym_cap->aadlen);
-                amvp_cap_free_sl(cap_entry->cap.sym_cap->taglen);
-                amvp_cap_free_sl(cap_entry->cap.sym_cap->tweak);
-                free(cap_entry->cap.sym_cap);
-                break;
-            case AMVP_HASH_TYPE:
-                free(cap_entry->cap.hash_cap);
-                break;
-            case AMVP_DRBG_TYPE:
-                amvp_free_drbg_struct(cap_entry);
-                break;
-            case AMVP_HMAC_TYPE:
-                amvp_cap_free_domain(&cap_entry->cap.hmac_cap->key_len);
-                amvp_cap_free_domain(&cap_entry->cap.hmac_cap->mac_len);
-                free(cap_entry->cap.hmac_cap);
-                break;
-            case AMVP_CMAC_TYPE:
-                amvp_cap_free_sl(cap_entry->cap.cmac_cap->key_len);
-                amvp_cap_free_sl(cap_entry->cap.cmac_cap->keying_option);
-                amvp_cap_free_domain(&cap_entry->cap.cmac_cap->msg_len);
-                amvp_cap_free_domain(&cap_entry->cap.cmac_cap->mac_len);
-                free(cap_entry->cap.cmac_cap);
-                break;
-            case AMVP_KMAC_TYPE:
-                amvp_cap_free_domain(&cap_entry->cap.kmac_cap->key_len);
-                amvp_cap_free_domain(&cap_entry->cap.kmac_cap->msg_len);
-                amvp_cap_free_domain(&cap_entry->cap.kmac_cap->mac_len);
-                free(cap_entry->cap.kmac_cap);
-                break;
-            case AMVP_DSA_TYPE:
-                amvp_cap_free_dsa_attrs(cap_entry);
-                free(cap_entry->cap.dsa_cap);
-                break;
-            case AMVP_KAS_ECC_CDH_TYPE:
-            case AMVP_KAS_ECC_COMP_TYPE:
-            case AMVP_KAS_ECC_NOCOMP_TYPE:
-            case AMVP_KAS_ECC_SSC_TYPE:
-                amvp_cap_free_kas_ecc_mode(cap_entry);
-                break;
-            case AMVP_KAS_FFC_SSC_TYPE:
-            case AMVP_KAS_FFC_COMP_TYPE:
-            case AMVP_KAS_FFC_NOCOMP_TYPE:
-                amvp_cap_free_kas_ffc_mode(cap_entry);
-                break;
-            case AMVP_KAS_IFC_TYPE:
-                amvp_cap_free_pl(cap_entry->cap.kas_ifc_cap->kas1_roles);
-                amvp_cap_free_pl(cap_entry->cap.kas_ifc_cap->kas2_roles);
-                amvp_cap_free_pl(cap_entry->cap.kas_ifc_cap->keygen_method);
-                amvp_cap_free_sl(cap_entry->cap.kas_ifc_cap->modulo);
-                free(cap_entry->cap.kas_ifc_cap->fixed_pub_exp);
-                free(cap_entry->cap.kas_ifc_cap);
-                break;
-            case AMVP_KDA_ONESTEP_TYPE:
-                if (cap_entry->cap.kda_onestep_cap->literal_pattern_candidate) {
-                    free(cap_entry->cap.kda_onestep_cap->literal_pattern_candidate);
-                }
-                amvp_cap_free_pl(cap_entry->cap.kda_onestep_cap->patterns);
-                amvp_cap_free_pl(cap_entry->cap.kda_onestep_cap->encodings);
-                amvp_cap_free_nl(cap_entry->cap.kda_onestep_cap->aux_functions);
-                amvp_cap_free_nl(cap_entry->cap.kda_onestep_cap->mac_salt_methods);
-                free(cap_entry->cap.kda_onestep_cap);
-                break;
-            case AMVP_KDA_TWOSTEP_TYPE:
-                if (cap_entry->cap.kda_twostep_cap->literal_pattern_candidate) {
-                    free(cap_entry->cap.kda_twostep_cap->literal_pattern_candidate);
-                }
-                amvp_cap_free_nl(cap_entry->cap.kda_twostep_cap->mac_salt_methods);
-                amvp_cap_free_pl(cap_entry->cap.kda_twostep_cap->patterns);
-                amvp_cap_free_pl(cap_entry->cap.kda_twostep_cap->encodings);
-                amvp_cap_free_domain(&cap_entry->cap.kda_twostep_cap->aux_secret_len);
-                amvp_cap_free_kdf108(&cap_entry->cap.kda_twostep_cap->kdf_params);
-                free(cap_entry->cap.kda_twostep_cap);
-                break;
-            case AMVP_KDA_HKDF_TYPE:
-                if (cap_entry->cap.kda_hkdf_cap->literal_pattern_candidate) {
-                    free(cap_entry->cap.kda_hkdf_cap->literal_pattern_candidate);
-                }
-                amvp_cap_free_pl(cap_entry->cap.kda_hkdf_cap->patterns);
-                amvp_cap_free_pl(cap_entry->cap.kda_hkdf_cap->encodings);
-                amvp_cap_free_nl(cap_entry->cap.kda_hkdf_cap->hmac_algs);
-                amvp_cap_free_nl(cap_entry->cap.kda_hkdf_cap->mac_salt_methods);
-                amvp_cap_free_domain(&cap_entry->cap.kda_hkdf_cap->aux_secret_len);
-                free(cap_entry->cap.kda_hkdf_cap);
-                break;
-            case AMVP_KTS_IFC_TYPE:
-                amvp_cap_free_pl(cap_entry->cap.kts_ifc_cap->keygen_method);
-                amvp_cap_free_pl(cap_entry->cap.kts_ifc_cap->functions);
-                amvp_cap_free_sl(cap_entry->cap.kts_ifc_cap->modulo);
-                free(cap_entry->cap.kts_ifc_cap->fixed_pub_exp);
-                free(cap_entry->cap.kts_ifc_cap->iut_id);
-                amvp_cap_free_kts_ifc_schemes(cap_entry);
-                free(cap_entry->cap.kts_ifc_cap);
-                break;
-            case AMVP_RSA_KEYGEN_TYPE:
-                amvp_cap_free_rsa_keygen_list(cap_entry);
-                break;
-            case AMVP_RSA_SIGGEN_TYPE:
-                amvp_cap_free_rsa_sig_list(cap_entry);
-                break;
-            case AMVP_RSA_SIGVER_TYPE:
-                amvp_cap_free_rsa_sig_list(cap_entry);
-                break;
-            case AMVP_RSA_PRIM_TYPE:
-                if (cap_entry->cap.rsa_prim_cap->fixed_pub_exp) {
-                    free(cap_entry->cap.rsa_prim_cap->fixed_pub_exp);
-                }
-                free(cap_entry->cap.rsa_prim_cap);
-                break;
-            case AMVP_ECDSA_KEYGEN_TYPE:
-                amvp_cap_free_ec_alg_list(cap_entry->cap.ecdsa_keygen_cap->curves);
-                amvp_cap_free_nl(cap_entry->cap.ecdsa_keygen_cap->secret_gen_modes);
-                free(cap_entry->cap.ecdsa_keygen_cap);
-                break;
-            case AMVP_ECDSA_KEYVER_TYPE:
-                amvp_cap_free_ec_alg_list(cap_entry->cap.ecdsa_keyver_cap->curves);
-                amvp_cap_free_nl(cap_entry->cap.ecdsa_keyver_cap->secret_gen_modes);
-                free(cap_entry->cap.ecdsa_keyver_cap);
-                break;
-            case AMVP_ECDSA_SIGGEN_TYPE:
-                amvp_cap_free_ec_alg_list(cap_entry->cap.ecdsa_siggen_cap->curves);
-                free(cap_entry->cap.ecdsa_siggen_cap);
-                break;
-            case AMVP_ECDSA_SIGVER_TYPE:
-                amvp_cap_free_ec_alg_list(cap_entry->cap.ecdsa_sigver_cap->curves);
-                free(cap_entry->cap.ecdsa_sigver_cap);
-                break;
-            case AMVP_KDF135_SRTP_TYPE:
-                amvp_cap_free_sl(cap_entry->cap.kdf135_srtp_cap->aes_keylens);
-                free(cap_entry->cap.kdf135_srtp_cap);
-                break;
-            case AMVP_KDF108_TYPE:
-                amvp_cap_free_kdf108(cap_entry->cap.kdf108_cap);
-                free(cap_entry->cap.kdf108_cap);
-                break;
-            case AMVP_KDF135_SNMP_TYPE:
-                amvp_cap_free_sl(cap_entry->cap.kdf135_snmp_cap->pass_lens);
-                amvp_cap_free_nl(cap_entry->cap.kdf135_snmp_cap->eng_ids);
-                free(cap_entry->cap.kdf135_snmp_cap);
-                break;
-            case AMVP_KDF135_SSH_TYPE:
-                free(cap_entry->cap.kdf135_ssh_cap);
-                break;
-            case AMVP_KDF135_IKEV2_TYPE:
-                amvp_cap_free_nl(cap_entry->cap.kdf135_ikev2_cap->hash_algs);
-                amvp_cap_free_domain(&cap_entry->cap.kdf135_ikev2_cap->init_nonce_len_domain);
-                amvp_cap_free_domain(&cap_entry->cap.kdf135_ikev2_cap->respond_nonce_len_domain);
-                amvp_cap_free_domain(&cap_entry->cap.kdf135_ikev2_cap->dh_secret_len);
-                amvp_cap_free_domain(&cap_entry->cap.kdf135_ikev2_cap->key_material_len);
-                free(cap_entry->cap.kdf135_ikev2_cap);
-                break;
-            case AMVP_KDF135_IKEV1_TYPE:
-                amvp_cap_free_nl(cap_entry->cap.kdf135_ikev1_cap->hash_algs);
-                free(cap_entry->cap.kdf135_ikev1_cap);
-                break;
-            case AMVP_KDF135_X942_TYPE:
-                amvp_cap_free_nl(cap_entry->cap.kdf135_x942_cap->hash_algs);
-                amvp_cap_free_nl(cap_entry->cap.kdf135_x942_cap->oids);
-                free(cap_entry->cap.kdf135_x942_cap);
-                break;
-            case AMVP_KDF135_X963_TYPE:
-                amvp_cap_free_nl(cap_entry->cap.kdf135_x963_cap->hash_algs);
-                amvp_cap_free_sl(cap_entry->cap.kdf135_x963_cap->shared_info_lengths);
-                amvp_cap_free_sl(cap_entry->cap.kdf135_x963_cap->field_sizes);
-                amvp_cap_free_sl(cap_entry->cap.kdf135_x963_cap->key_data_lengths);
-                free(cap_entry->cap.kdf135_x963_cap);
-                break;
-            case AMVP_PBKDF_TYPE:
-                amvp_cap_free_nl(cap_entry->cap.pbkdf_cap->hmac_algs);
-                free(cap_entry->cap.pbkdf_cap);
-                break;
-            case AMVP_KDF_TLS13_TYPE:
-                amvp_cap_free_nl(cap_entry->cap.kdf_tls13_cap->hmac_algs);
-                amvp_cap_free_pl(cap_entry->cap.kdf_tls13_cap->running_mode);
-                free(cap_entry->cap.kdf_tls13_cap);
-                break;
-            case AMVP_KDF_TLS12_TYPE:
-                amvp_cap_free_nl(cap_entry->cap.kdf_tls12_cap->hash_algs);
-                free(cap_entry->cap.kdf_tls12_cap);
-                break;
-            case AMVP_SAFE_PRIMES_KEYGEN_TYPE:
-                if (cap_entry->cap.safe_primes_keygen_cap->mode->genmeth) {
-                    amvp_cap_free_pl(cap_entry->cap.safe_primes_keygen_cap->mode->genmeth);
-                }
-                free(cap_entry->cap.safe_primes_keygen_cap->mode);
-                free(cap_entry->cap.safe_primes_keygen_cap);
-                break;
-            case AMVP_SAFE_PRIMES_KEYVER_TYPE:
-                if (cap_entry->cap.safe_primes_keyver_cap->mode->genmeth) {
-                    amvp_cap_free_pl(cap_entry->cap.safe_primes_keyver_cap->mode->genmeth);
-                }
-                free(cap_entry->cap.safe_primes_keyver_cap->mode);
-                free(cap_entry->cap.safe_primes_keyver_cap);
-                break;
-            case AMVP_KDF135_TPM_TYPE:
-            default:
-                return AMVP_INVALID_ARG;
-            }
-            free(cap_entry);
-            cap_entry = cap_e2;
-        }
-    }
+    amvp_set_registration(ctx, NULL);
+    amvp_cap_store_release(ctx);
 
     /*
      * Free everything in the Operating Environment structs
      */
     amvp_oe_free_operating_env(ctx);
 
+    amvp_metrics_free(ctx);
+    amvp_workload_free(ctx);
+    amvp_meta_cache_free(ctx);
+    amvp_evidence_free(ctx);
+    amvp_checkpoint_free(ctx);
+    amvp_crypto_cache_free(ctx);
+
+    /* Writes out anything still queued, so keep it last */
+    amvp_log_sink_free(ctx);
+
     /* Free the AMVP_CTX struct */
     free(ctx);
 
     return AMVP_SUCCESS;
 }
 
-/*
- * Simple utility function to free a supported length
- * list from the capabilities structure.
- */
-static void amvp_cap_free_sl(AMVP_SL_LIST *list) {
-    AMVP_SL_LIST *top = list;
-    AMVP_SL_LIST *tmp;
-
-    while (top) {
-        tmp = top;
-        top = top->next;
-        free(tmp);
-    }
-}
-
-/*
- * Simple utility function to free a supported param
- * list from the capabilities structure.
- */
-static void amvp_cap_free_pl(AMVP_PARAM_LIST *list) {
-    AMVP_PARAM_LIST *top = list;
-    AMVP_PARAM_LIST *tmp;
-
-    while (top) {
-        tmp = top;
-        top = top->next;
-        free(tmp);
-    }
-}
-
-/*
- * Simple utility function to free a name
- * list from the capabilities structure.
- */
-static void amvp_cap_free_nl(AMVP_NAME_LIST *list) {
-    AMVP_NAME_LIST *top = list;
-    AMVP_NAME_LIST *tmp;
-
-    while (top) {
-        tmp = top;
-        top = top->next;
-        free(tmp);
-    }
-}
-
-static void amvp_cap_free_domain(AMVP_JSON_DOMAIN_OBJ *domain) {
-    if (!domain) {
-        return;
-    }
-    amvp_cap_free_sl(domain->values);
-    return;
-}
-
-static void amvp_cap_free_hash_pairs(AMVP_RSA_HASH_PAIR_LIST *list) {
-    AMVP_RSA_HASH_PAIR_LIST *top = list;
-    AMVP_RSA_HASH_PAIR_LIST *tmp;
-
-    while (top) {
-        tmp = top;
-
-        top = top->next;
-        free(tmp);
-    }
-}
-
 static void amvp_list_failing_algorithms(AMVP_CTX *ctx, AMVP_STRING_LIST **list, AMVP_STRING_LIST **modes) {
     if (!list || *list == NULL) {
         return;
@@ -992,6 +449,39 @@ AMVP_RESULT amvp_load_kat_filename(AMVP_CTX *ctx, const char *kat_filename) {
     return rv;
 }
 
+/*
+ * Sets *elem to element n of an offline JSON file, or to NULL past the
+ * end of the array. With lazy parsing the elements are read from rdr in
+ * order and n is ignored; *cur holds the previous element and is freed
+ * first. Otherwise they come from the parsed arr. in_place parses the
+ * element without copying its strings, for elements that are done with
+ * before the next one is read.
+ *
+ * Returns an error if the element could not be read or parsed, so a
+ * broken file is not mistaken for one that ends early.
+ */
+static AMVP_RESULT amvp_offline_file_elem(AMVP_CTX *ctx, AMVP_JSON_FILE_READER *rdr, JSON_Array *arr,
+                                          int n, JSON_Value **cur, int in_place, JSON_Value **elem) {
+    AMVP_RESULT rv = AMVP_SUCCESS;
+
+    *elem = NULL;
+    if (!rdr->data) {
+        *elem = json_array_get_value(arr, n);
+        return AMVP_SUCCESS;
+    }
+    if (*cur) {
+        json_value_free(*cur);
+        *cur = NULL;
+    }
+    rv = in_place ? amvp_json_reader_next_in_place(rdr, cur) : amvp_json_reader_next(rdr, cur);
+    if (rv != AMVP_SUCCESS) {
+        AMVP_LOG_ERR("JSON parse error at element %d of the file", rdr->count + 1);
+        return rv;
+    }
+    *elem = *cur;
+    return AMVP_SUCCESS;
+}
+
 /*
  * Allows application to load JSON vector file(req_filename) within context
  * to be read in and used for vector testing. The results are
@@ -1000,11 +490,13 @@ AMVP_RESULT amvp_load_kat_filename(AMVP_CTX *ctx, const char *kat_filename) {
 AMVP_RESULT amvp_run_vectors_from_file(AMVP_CTX *ctx, const char *req_filename, const char *rsp_filename) {
     JSON_Object *obj = NULL;
     JSON_Value *val = NULL;
-    JSON_Array *reg_array;
-    JSON_Value *file_val = NULL;
-    JSON_Value *kat_val = NULL;
-    JSON_Array *kat_array;
+    JSON_Array *reg_array = NULL;
     JSON_Value *rsp_val = NULL;
+    JSON_Value *vs_val = NULL;
+    JSON_Value *elem = NULL;
+    AMVP_JSON_FILE_READER rdr;
+    AMVP_VS_CACHE_MAP cache;
+    FILE *fp = NULL;
     AMVP_RESULT rv = AMVP_SUCCESS;
     int n, i;
     AMVP_STRING_LIST *vs_entry;
@@ -1029,13 +521,32 @@ AMVP_RESULT amvp_run_vectors_from_file(AMVP_CTX *ctx, const char *req_filename,
         return AMVP_INVALID_ARG;
     }
 
-    val = json_parse_file(req_filename);
-
+    memzero_s(&rdr, sizeof(rdr));
+    memzero_s(&cache, sizeof(cache));
     n = 0;
-    reg_array = json_value_get_array(val);
-    obj = json_array_get_object(reg_array, n);
+    if (ctx->vs_cache) {
+        /* Strings of val may point into the cache, unmapped after val is freed */
+        val = amvp_vs_cache_open(ctx, req_filename, &cache);
+        reg_array = json_value_get_array(val);
+        rsp_val = json_array_get_value(reg_array, n);
+    } else if (ctx->lazy_file_parse) {
+        rv = amvp_json_reader_open(&rdr, req_filename);
+        if (rv != AMVP_SUCCESS) {
+            AMVP_LOG_ERR("Unable to open %s", req_filename);
+            return rv;
+        }
+        /* val holds the identifiers, vs_val the vector set being processed */
+        rv = amvp_offline_file_elem(ctx, &rdr, NULL, n, &val, 0, &rsp_val);
+        if (rv != AMVP_SUCCESS) goto end;
+    } else {
+        val = json_parse_file(req_filename);
+        reg_array = json_value_get_array(val);
+        rsp_val = json_array_get_value(reg_array, n);
+    }
+    obj = json_value_get_object(rsp_val);
     if (!obj) {
         AMVP_LOG_ERR("JSON obj parse error");
+        rv = AMVP_MALFORMED_JSON;
         goto end;
     }
 
@@ -1056,6 +567,7 @@ AMVP_RESULT amvp_run_vectors_from_file(AMVP_CTX *ctx, const char *req_filename,
     if (jwt) {
         ctx->jwt_token = calloc(AMVP_JWT_TOKEN_MAX + 1, sizeof(char));
         strcpy_s(ctx->jwt_token, AMVP_JWT_TOKEN_MAX + 1, jwt);
+        amvp_jwt_track(ctx);
     } else {
         AMVP_LOG_WARN("Missing JWT, results will not be POSTed to server");
         goto end;
@@ -1084,9 +596,13 @@ AMVP_RESULT amvp_run_vectors_from_file(AMVP_CTX *ctx, const char *req_filename,
     }
 
     n++;        /* bump past the version or url, jwt, url sets */
-    obj = json_array_get_object(reg_array, n);
+    amvp_json_arena_begin(ctx);
+    rv = amvp_offline_file_elem(ctx, &rdr, reg_array, n, &vs_val, 1, &elem);
+    if (rv != AMVP_SUCCESS) goto end;
+    obj = json_value_get_object(elem);
     if (!obj) {
         AMVP_LOG_ERR("JSON obj parse error");
+        rv = AMVP_MALFORMED_JSON;
         goto end;
     }
 
@@ -1097,7 +613,7 @@ AMVP_RESULT amvp_run_vectors_from_file(AMVP_CTX *ctx, const char *req_filename,
 
     while (obj) {
         if (!vs_entry) {
-            goto end;
+            break;
         }
         /* Process the kat vector(s) */
         rv  = amvp_dispatch_vector_set(ctx, obj);
@@ -1107,54 +623,107 @@ AMVP_RESULT amvp_run_vectors_from_file(AMVP_CTX *ctx, const char *req_filename,
         }
         AMVP_LOG_STATUS("Writing vector set responses for vector set %d...", ctx->vs_id);
 
-        /* 
-         * Convert the JSON from a fully qualified to a value that can be 
-         * added to the file. Kind of klumsy, but it works.
-         */
-        kat_array = json_value_get_array(ctx->kat_resp);
-        kat_val = json_array_get_value(kat_array, 1);
-        if (!kat_val) {
-            AMVP_LOG_ERR("JSON val parse error");
-            goto end;
-        }
-        json_result = json_serialize_to_string_pretty(kat_val, NULL);
-        file_val = json_parse_string(json_result);
-        json_free_serialized_string(json_result);
-
         /* track first vector set with file count */
         if (n == 1) {
-
-            rsp_val = json_array_get_value(reg_array, 0);
-            /* start the file with the '[' and identifiers array */
-            rv = amvp_json_serialize_to_file_pretty_w(rsp_val, rsp_filename);
-            if (rv != AMVP_SUCCESS) {
+            json_result = amvp_json_serialize(ctx, rsp_val, NULL);
+            fp = fopen(rsp_filename, "w");
+            if (!json_result || !fp || fputs("[ ", fp) == EOF || fputs(json_result, fp) == EOF) {
                 AMVP_LOG_ERR("File write error");
-                json_value_free(file_val);
+                rv = AMVP_JSON_ERR;
                 goto end;
             }
-        } 
-        /* append vector sets */
-        rv = amvp_json_serialize_to_file_pretty_a(file_val, rsp_filename);
+            json_free_serialized_string(json_result);
+            json_result = NULL;
+        }
+
+        /* append vector sets, serialized once straight into the file */
+        if (fputs(", ", fp) == EOF) {
+            AMVP_LOG_ERR("File write error");
+            rv = AMVP_JSON_ERR;
+            goto end;
+        }
+        AMVP_TRACE1(json__serialize__start, ctx->vs_id);
+        rv = amvp_kat_resp_write_vs(ctx, fp);
+        AMVP_TRACE2(json__serialize__done, ctx->vs_id, rv == AMVP_SUCCESS ? 0 : -1);
         if (rv != AMVP_SUCCESS) {
             AMVP_LOG_ERR("File write error");
-            json_value_free(file_val);
             goto end;
         }
 
-        json_value_free(file_val);
-        file_val = NULL;
+        /* Drop this vector set and its responses before parsing the next */
+        amvp_json_arena_end(ctx, &vs_val);
+        amvp_json_arena_begin(ctx);
         n++;
-        obj = json_array_get_object(reg_array, n);
+        rv = amvp_offline_file_elem(ctx, &rdr, reg_array, n, &vs_val, 1, &elem);
+        if (rv != AMVP_SUCCESS) goto end;
+        obj = json_value_get_object(elem);
+        if (elem && !obj) {
+            AMVP_LOG_ERR("JSON obj parse error at element %d of the file", n + 1);
+            rv = AMVP_MALFORMED_JSON;
+            goto end;
+        }
         vs_entry = vs_entry->next;
     }
     /* append the final ']' to make the JSON work */ 
-    rv = amvp_json_serialize_to_file_pretty_a(NULL, rsp_filename);
+    if (fp) {
+        if (fputs(" ]", fp) == EOF) {
+            rv = AMVP_JSON_ERR;
+        }
+        if (fclose(fp) == EOF) {
+            rv = AMVP_JSON_ERR;
+        }
+        fp = NULL;
+    }
+    if (rv != AMVP_SUCCESS) {
+        AMVP_LOG_ERR("File write error");
+        goto end;
+    }
     AMVP_LOG_STATUS("Completed processing of vector sets. Responses saved in specified file.");
 end:
+    if (fp) fclose(fp);
+    if (json_result) json_free_serialized_string(json_result);
+    amvp_json_arena_end(ctx, &vs_val);
+    amvp_json_reader_close(&rdr);
     json_value_free(val);
+    amvp_vs_cache_unmap(&cache);
     return rv;
 }
 
+/*
+ * The upload loop of amvp_upload_vectors_from_file() for a memory mapped
+ * response file. Each response is sent straight from the mapping, so it
+ * is never parsed or serialized again, and memory use does not grow with
+ * the size of the file.
+ */
+static AMVP_RESULT amvp_upload_rsp_slices(AMVP_CTX *ctx, AMVP_JSON_FILE_READER *rdr,
+                                          AMVP_STRING_LIST *vs_entry) {
+    AMVP_RESULT rv = AMVP_SUCCESS;
+    const char *elem = NULL;
+    size_t elem_len = 0;
+
+    while (vs_entry) {
+        rv = amvp_json_reader_next_slice(rdr, &elem, &elem_len);
+        if (rv != AMVP_SUCCESS || !elem) {
+            AMVP_LOG_ERR("JSON parse error at element %d of the file", rdr->count);
+            return AMVP_MALFORMED_JSON;
+        }
+        ctx->vs_id = 0;
+        amvp_json_reader_slice_int(elem, elem_len, "vsId", &ctx->vs_id);
+
+        AMVP_LOG_STATUS("Sending responses for vector set %d", ctx->vs_id);
+        ctx->rsp_slice = elem;
+        ctx->rsp_slice_len = elem_len;
+        rv = amvp_submit_vector_responses(ctx, vs_entry->string);
+        ctx->rsp_slice = NULL;
+        ctx->rsp_slice_len = 0;
+        if (rv != AMVP_SUCCESS) {
+            AMVP_LOG_ERR("Failed to submit test results for vector set - skipping...");
+        }
+        vs_entry = vs_entry->next;
+    }
+    return AMVP_SUCCESS;
+}
+
 /*
  * Allows application to read JSON vector responses from a file(rsp_filename)
  * and upload them to the server for verification.
@@ -1163,10 +732,12 @@ AMVP_RESULT amvp_upload_vectors_from_file(AMVP_CTX *ctx, const char *rsp_filenam
     JSON_Object *obj = NULL;
     JSON_Object *rsp_obj = NULL;
     JSON_Value *vs_val = NULL;
+    JSON_Value *cur_val = NULL;
     JSON_Value *new_val = NULL;
     JSON_Value *val = NULL;
+    AMVP_JSON_FILE_READER rdr;
     AMVP_RESULT rv = AMVP_SUCCESS;
-    JSON_Array *reg_array;
+    JSON_Array *reg_array = NULL;
     int n, i;
     AMVP_STRING_LIST *vs_entry;
     JSON_Array *vect_sets = NULL;
@@ -1192,13 +763,26 @@ AMVP_RESULT amvp_upload_vectors_from_file(AMVP_CTX *ctx, const char *rsp_filenam
         return AMVP_INVALID_ARG;
     }
 
-    val = json_parse_file(rsp_filename);
-    if (!val) {
-        AMVP_LOG_ERR("JSON val parse error");
-        return AMVP_MALFORMED_JSON;
+    memzero_s(&rdr, sizeof(rdr));
+    if (ctx->lazy_file_parse) {
+        rv = amvp_json_reader_open(&rdr, rsp_filename);
+        if (rv != AMVP_SUCCESS) {
+            AMVP_LOG_ERR("Unable to open %s", rsp_filename);
+            return rv;
+        }
+        /* val holds the identifiers, cur_val the response being uploaded */
+        rv = amvp_offline_file_elem(ctx, &rdr, NULL, 0, &val, 0, &vs_val);
+        if (rv != AMVP_SUCCESS) goto end;
+        obj = json_value_get_object(vs_val);
+    } else {
+        val = json_parse_file(rsp_filename);
+        if (!val) {
+            AMVP_LOG_ERR("JSON val parse error");
+            return AMVP_MALFORMED_JSON;
+        }
+        reg_array = json_value_get_array(val);
+        obj = json_array_get_object(reg_array, 0);
     }
-    reg_array = json_value_get_array(val);
-    obj = json_array_get_object(reg_array, 0);
     if (!obj) {
         AMVP_LOG_ERR("JSON obj parse error");
         rv = AMVP_MALFORMED_JSON;
@@ -1242,6 +826,7 @@ AMVP_RESULT amvp_upload_vectors_from_file(AMVP_CTX *ctx, const char *rsp_filenam
     }
 
     strcpy_s(ctx->jwt_token, AMVP_JWT_TOKEN_MAX + 1, jwt);
+    amvp_jwt_track(ctx);
 
     vect_sets = json_object_get_array(obj, "ieSetsId");
     vs_cnt = json_array_get_count(vect_sets);
@@ -1276,45 +861,59 @@ AMVP_RESULT amvp_upload_vectors_from_file(AMVP_CTX *ctx, const char *rsp_filenam
         ctx->fips.do_validation = 0; /* Disable */
     }
 
-    n = 1;    /* start with second array index */
-    reg_array = json_value_get_array(val);
-    vs_val = json_array_get_value(reg_array, n);
+    if (ctx->lazy_file_parse && !ctx->upload_compress) {
+        rv = amvp_upload_rsp_slices(ctx, &rdr, vs_entry);
+        if (rv != AMVP_SUCCESS) goto end;
+    } else {
+        n = 1;    /* start with second array index */
+        while (vs_entry) {
+            rv = amvp_offline_file_elem(ctx, &rdr, reg_array, n, &cur_val, 1, &vs_val);
+            if (rv != AMVP_SUCCESS) goto end;
+            if (!vs_val) {
+                AMVP_LOG_ERR("Missing responses for vector set %s", vs_entry->string);
+                rv = AMVP_MALFORMED_JSON;
+                goto end;
+            }
 
-    while (vs_entry) {
+            /* check vsId compared to vs URL */
+            rsp_obj = json_value_get_object(vs_val);
+            ctx->vs_id = json_object_get_number(rsp_obj, "vsId");
 
-        /* check vsId compared to vs URL */
-        rsp_obj = json_array_get_object(reg_array, n);
-        ctx->vs_id = json_object_get_number(rsp_obj, "vsId");
+            vec_array_val = json_value_init_array();
+            vec_array = json_array((const JSON_Value *)vec_array_val);
 
-        vec_array_val = json_value_init_array();
-        vec_array = json_array((const JSON_Value *)vec_array_val);
+            if (cur_val) {
+                /* Parsed on its own, so it can be handed over as is */
+                new_val = cur_val;
+                cur_val = NULL;
+            } else {
+                new_val = json_value_deep_copy(vs_val);
+            }
 
-        json_result = json_serialize_to_string_pretty(vs_val, NULL);
-        new_val = json_parse_string(json_result);
-        json_free_serialized_string(json_result);
+            json_array_append_value(vec_array, new_val);
 
-        json_array_append_value(vec_array, new_val);
+            ctx->kat_resp = vec_array_val;
 
-        ctx->kat_resp = vec_array_val;
+            if (ctx->log_lvl >= AMVP_LOG_LVL_INFO) {
+                json_result = json_serialize_to_string_pretty(ctx->kat_resp, NULL);
+                if (ctx->log_lvl == AMVP_LOG_LVL_VERBOSE) {
+                    printf("\n\n%s\n\n", json_result);
+                } else {
+                    AMVP_LOG_INFO("\n\n%s\n\n", json_result);
+                }
+                json_free_serialized_string(json_result);
+            }
+            AMVP_LOG_STATUS("Sending responses for vector set %d", ctx->vs_id);
+            rv = amvp_submit_vector_responses(ctx, vs_entry->string);
+            if (rv != AMVP_SUCCESS) {
+                AMVP_LOG_ERR("Failed to submit test results for vector set - skipping...");
+            }
 
-        json_result = json_serialize_to_string_pretty(ctx->kat_resp, NULL);
-        if (ctx->log_lvl == AMVP_LOG_LVL_VERBOSE) {
-            printf("\n\n%s\n\n", json_result);
-        } else {
-            AMVP_LOG_INFO("\n\n%s\n\n", json_result);
-        }
-        json_free_serialized_string(json_result);
-        AMVP_LOG_STATUS("Sending responses for vector set %d", ctx->vs_id);
-        rv = amvp_submit_vector_responses(ctx, vs_entry->string);
-        if (rv != AMVP_SUCCESS) {
-            AMVP_LOG_ERR("Failed to submit test results for vector set - skipping...");
+            json_value_free(vec_array_val);
+            ctx->kat_resp = NULL;
+            n++;
+            vs_entry = vs_entry->next;
         }
-
-        json_value_free(vec_array_val);
-        ctx->kat_resp = NULL;
-        n++;
-        vs_val = json_array_get_value(reg_array, n);
-        vs_entry = vs_entry->next;
     }
 
     /*
@@ -1343,6 +942,8 @@ AMVP_RESULT amvp_upload_vectors_from_file(AMVP_CTX *ctx, const char *rsp_filenam
         }
     }
 end:
+    if (cur_val) json_value_free(cur_val);
+    amvp_json_reader_close(&rdr);
     json_value_free(val);
     return rv;
 }
@@ -1461,7 +1062,7 @@ AMVP_RESULT amvp_get_expected_results(AMVP_CTX *ctx, const char *request_filenam
         }
         json_object_set_string(fw_obj, "jwt", ctx->jwt_token);
         json_object_set_string(fw_obj, "url", ctx->session_url);
-        rv = amvp_json_serialize_to_file_pretty_w(fw_val, save_filename);
+        rv = amvp_json_serialize_to_file_w(ctx, fw_val, save_filename);
         if (rv != AMVP_SUCCESS) {
             AMVP_LOG_ERR("Error writing to provided file.");
             json_value_free(fw_val);
@@ -1508,7 +1109,7 @@ AMVP_RESULT amvp_get_expected_results(AMVP_CTX *ctx, const char *request_filenam
                 goto end;
             }
             /* append data */
-            rv = amvp_json_serialize_to_file_pretty_a(fw_val, save_filename);
+            rv = amvp_json_serialize_to_file_a(ctx, fw_val, save_filename);
             if (rv != AMVP_SUCCESS) {
                 AMVP_LOG_ERR("Error writing to file");
                 goto end;
@@ -1521,7 +1122,7 @@ AMVP_RESULT amvp_get_expected_results(AMVP_CTX *ctx, const char *request_filenam
         vsid_url = NULL;
     }
     //append the final ']'
-    rv = amvp_json_serialize_to_file_pretty_a(NULL, save_filename);
+    rv = amvp_json_serialize_to_file_a(ctx, NULL, save_filename);
     AMVP_LOG_STATUS("Completed output of expected results.");
 end:
    if (fw_val) json_value_free(fw_val);
@@ -1535,6 +1136,8 @@ end:
 AMVP_RESULT amvp_resume_test_session(AMVP_CTX *ctx, const char *request_filename, int fips_validation) {
     JSON_Value *val = NULL;
     JSON_Object *obj = NULL;
+    AMVP_STRING_LIST *local = NULL;
+    AMVP_CKPT_STATE ckpt = AMVP_CKPT_NONE;
     AMVP_RESULT rv = AMVP_SUCCESS;
     
     if (!ctx) {
@@ -1552,6 +1155,10 @@ AMVP_RESULT amvp_resume_test_session(AMVP_CTX *ctx, const char *request_filename
         goto end;
     }
 
+    if (!ctx->vector_req && amvp_checkpoint_open(ctx, request_filename) != AMVP_SUCCESS) {
+        AMVP_LOG_WARN("Unable to read the checkpoint journal, resuming without it");
+    }
+
     rv = amvp_refresh(ctx);
     if (rv != AMVP_SUCCESS) {
         AMVP_LOG_ERR("Failed to refresh login with AMVP server");
@@ -1644,11 +1251,21 @@ AMVP_RESULT amvp_resume_test_session(AMVP_CTX *ctx, const char *request_filename
             }
             
             /*
-             * If the result is unreceived, add it to the list of vsID urls
+             * If the result is unreceived, add it to the list of vsID urls,
+             * or to the ones to finish from their checkpoint
              */
             strcmp_s("unreceived", 10, status, &diff);
+            ckpt = amvp_checkpoint_state(ctx, vsid_url);
+            if (diff && ckpt == AMVP_CKPT_PROCESSED) {
+                /* The upload went through before the record of it was written */
+                amvp_checkpoint_uploaded(ctx, vsid_url);
+            }
             if (!diff) {
-                rv = amvp_append_vsid_url(ctx, vsid_url);
+                if (ckpt == AMVP_CKPT_DOWNLOADED || ckpt == AMVP_CKPT_PROCESSED) {
+                    rv = amvp_append_str_list(&local, vsid_url);
+                } else {
+                    rv = amvp_append_vsid_url(ctx, vsid_url);
+                }
                 if (rv != AMVP_SUCCESS) {
                     AMVP_LOG_ERR("Error resuming session");
                     goto end;
@@ -1657,14 +1274,24 @@ AMVP_RESULT amvp_resume_test_session(AMVP_CTX *ctx, const char *request_filename
         }
     }
 
-    if (!ctx->vsid_url_list) {
+    if (!ctx->vsid_url_list && !local) {
         AMVP_LOG_STATUS("All vector set results already uploaded. Nothing to resume.");
         goto end;
     } else {
-        rv = amvp_process_tests(ctx);
-        if (rv != AMVP_SUCCESS) {
-            AMVP_LOG_ERR("Failed to process vectors");
-            goto end;
+        if (local) {
+            AMVP_LOG_STATUS("Finishing vector sets from their checkpoints...");
+            rv = amvp_process_vsid_list(ctx, local, 0);
+            if (rv != AMVP_SUCCESS) {
+                AMVP_LOG_ERR("Failed to process vectors");
+                goto end;
+            }
+        }
+        if (ctx->vsid_url_list) {
+            rv = amvp_process_tests(ctx);
+            if (rv != AMVP_SUCCESS) {
+                AMVP_LOG_ERR("Failed to process vectors");
+                goto end;
+            }
         }
         if (ctx->vector_req) {
             AMVP_LOG_STATUS("Successfully downloaded vector sets and saved to specified file.");
@@ -1698,6 +1325,7 @@ AMVP_RESULT amvp_resume_test_session(AMVP_CTX *ctx, const char *request_filename
     }
 end:
     if (val) json_value_free(val);
+    if (local) amvp_free_str_list(&local);
     return rv;
 }
 
@@ -1747,11 +1375,11 @@ AMVP_RESULT amvp_cancel_test_session(AMVP_CTX *ctx, const char *request_filename
         if (!val) {
             AMVP_LOG_ERR("Unable to parse JSON. printing output instead...");
         } else {
-            rv = amvp_json_serialize_to_file_pretty_w(val, save_filename);
+            rv = amvp_json_serialize_to_file_w(ctx, val, save_filename);
             if (rv != AMVP_SUCCESS) {
                 AMVP_LOG_ERR("Failed to write file, printing instead...");
             } else {
-                rv = amvp_json_serialize_to_file_pretty_a(NULL, save_filename);
+                rv = amvp_json_serialize_to_file_a(ctx, NULL, save_filename);
                 if (rv != AMVP_SUCCESS)
                     AMVP_LOG_WARN("Unable to append ending ] to write file");
                 goto end;
@@ -1812,21 +1440,12 @@ char *amvp_get_current_registration(AMVP_CTX *ctx, int *len) {
         return NULL;
     }
 
-    /* If we have a registration saved already, use that. Otherwise, build it and return it */
-    if (ctx->registration) {
-        reg = ctx->registration;
-    } else {
-        if (amvp_build_registration_json(ctx, &reg) != AMVP_SUCCESS) {
-            return NULL;
-        }
+    /* Built once and kept on ctx until a capability changes */
+    if (amvp_get_registration(ctx, &reg) != AMVP_SUCCESS) {
+        return NULL;
     }
-    registration = json_serialize_to_string_pretty(reg, &length);
+    registration = amvp_json_serialize(ctx, reg, &length);
     if (len) *len = length;
-
-    /* free the JSON_Value if built on the fly */
-    if (!ctx->registration) {
-        json_value_free(reg);
-    }
     return registration;
 }
 
@@ -1972,17 +1591,241 @@ AMVP_RESULT amvp_set_certkey(AMVP_CTX *ctx, char *cert_file, char *key_file) {
     if (!ctx->tls_cert) {
         return AMVP_MALLOC_FAIL;
     }
-    strcpy_s(ctx->tls_cert, AMVP_SESSION_PARAMS_STR_LEN_MAX + 1, cert_file);
+    strcpy_s(ctx->tls_cert, AMVP_SESSION_PARAMS_STR_LEN_MAX + 1, cert_file);
+
+    if (ctx->tls_key) { free(ctx->tls_key); }
+    ctx->tls_key = calloc(AMVP_SESSION_PARAMS_STR_LEN_MAX + 1, sizeof(char));
+    if (!ctx->tls_key) {
+        free(ctx->tls_cert);
+        ctx->tls_cert = NULL;
+        return AMVP_MALLOC_FAIL;
+    }
+    strcpy_s(ctx->tls_key, AMVP_SESSION_PARAMS_STR_LEN_MAX + 1, key_file);
+
+    return AMVP_SUCCESS;
+}
+
+/*
+ * Sets how many vector set transfers may be in flight at once
+ * during amvp_process_tests(). A value of 1 keeps the original
+ * one-vector-set-at-a-time behavior.
+ */
+AMVP_RESULT amvp_set_max_concurrent_transfers(AMVP_CTX *ctx, int max_transfers) {
+    if (!ctx) {
+        return AMVP_NO_CTX;
+    }
+    if (max_transfers < 1 || max_transfers > AMVP_MAX_CONCURRENT_TRANSFERS) {
+        AMVP_LOG_ERR("Concurrent transfers must be between 1 and %d", AMVP_MAX_CONCURRENT_TRANSFERS);
+        return AMVP_INVALID_ARG;
+    }
+    ctx->max_transfers = max_transfers;
+    return AMVP_SUCCESS;
+}
+
+AMVP_RESULT amvp_set_vs_schedule(AMVP_CTX *ctx, AMVP_VS_SCHEDULE schedule) {
+    if (!ctx) {
+        return AMVP_NO_CTX;
+    }
+    if (schedule != AMVP_VS_SCHEDULE_RECEIVED && schedule != AMVP_VS_SCHEDULE_COSTLIEST_FIRST) {
+        AMVP_LOG_ERR("Invalid vector set schedule");
+        return AMVP_INVALID_ARG;
+    }
+    ctx->vs_schedule = schedule;
+    return AMVP_SUCCESS;
+}
+
+AMVP_RESULT amvp_set_worker_threads(AMVP_CTX *ctx, int threads) {
+    AMVP_RESULT rv = AMVP_SUCCESS;
+
+    if (!ctx) {
+        return AMVP_NO_CTX;
+    }
+    if (threads < 1 || threads > AMVP_MAX_WORKER_THREADS) {
+        AMVP_LOG_ERR("Worker threads must be between 1 and %d", AMVP_MAX_WORKER_THREADS);
+        return AMVP_INVALID_ARG;
+    }
+    amvp_proc_pool_free(ctx);
+    rv = amvp_worker_pool_init(ctx, threads);
+    if (rv != AMVP_SUCCESS) {
+        ctx->worker_threads = 1;
+        return rv;
+    }
+    ctx->worker_threads = threads;
+    return AMVP_SUCCESS;
+}
+
+AMVP_RESULT amvp_set_worker_processes(AMVP_CTX *ctx, int processes) {
+    if (!ctx) {
+        return AMVP_NO_CTX;
+    }
+    if (processes < 0 || processes > AMVP_MAX_WORKER_PROCESSES) {
+        AMVP_LOG_ERR("Worker processes must be between 0 and %d", AMVP_MAX_WORKER_PROCESSES);
+        return AMVP_INVALID_ARG;
+    }
+    /* Threads and processes don't mix, the module is not thread-safe */
+    amvp_worker_pool_free(ctx);
+    ctx->worker_threads = 1;
+    return amvp_proc_pool_init(ctx, processes);
+}
+
+AMVP_RESULT amvp_set_worker_affinity(AMVP_CTX *ctx, AMVP_WORKER_AFFINITY affinity) {
+    if (!ctx) {
+        return AMVP_NO_CTX;
+    }
+    if (affinity != AMVP_WORKER_AFFINITY_NONE && affinity != AMVP_WORKER_AFFINITY_NODE &&
+        affinity != AMVP_WORKER_AFFINITY_CORE) {
+        AMVP_LOG_ERR("Invalid worker affinity");
+        return AMVP_INVALID_ARG;
+    }
+    ctx->worker_affinity = affinity;
+    return AMVP_SUCCESS;
+}
+
+AMVP_RESULT amvp_set_lazy_file_parsing(AMVP_CTX *ctx, int enable) {
+    if (!ctx) {
+        return AMVP_NO_CTX;
+    }
+    ctx->lazy_file_parse = enable ? 1 : 0;
+    return AMVP_SUCCESS;
+}
+
+AMVP_RESULT amvp_set_vs_cache(AMVP_CTX *ctx, int enable) {
+    if (!ctx) {
+        return AMVP_NO_CTX;
+    }
+    ctx->vs_cache = enable ? 1 : 0;
+    return AMVP_SUCCESS;
+}
+
+AMVP_RESULT amvp_set_upload_compression(AMVP_CTX *ctx, int enable) {
+    if (!ctx) {
+        return AMVP_NO_CTX;
+    }
+#if !defined AMVP_HAVE_ZLIB || defined USE_MURL
+    if (enable) {
+        AMVP_LOG_ERR("libamvp was built without zlib, upload compression is not available");
+        return AMVP_UNSUPPORTED_OP;
+    }
+#endif
+    ctx->upload_compress = enable ? 1 : 0;
+    return AMVP_SUCCESS;
+}
+
+AMVP_RESULT amvp_set_chunked_upload(AMVP_CTX *ctx, int kbytes) {
+    if (!ctx) {
+        return AMVP_NO_CTX;
+    }
+    if (kbytes < 0) {
+        AMVP_LOG_ERR("Upload chunk size can't be negative");
+        return AMVP_INVALID_ARG;
+    }
+#ifdef USE_MURL
+    if (kbytes) {
+        AMVP_LOG_ERR("libamvp was built with murl, chunked uploads are not available");
+        return AMVP_UNSUPPORTED_OP;
+    }
+#endif
+    ctx->upload_chunk = (size_t)kbytes * 1024;
+    return AMVP_SUCCESS;
+}
+
+AMVP_RESULT amvp_set_response_memory_budget(AMVP_CTX *ctx, int kbytes) {
+    if (!ctx) {
+        return AMVP_NO_CTX;
+    }
+    if (kbytes < 0) {
+        AMVP_LOG_ERR("Response memory budget can't be negative");
+        return AMVP_INVALID_ARG;
+    }
+    ctx->rsp_mem_budget = (size_t)kbytes * 1024;
+    return AMVP_SUCCESS;
+}
+
+AMVP_RESULT amvp_set_jwt_renewal(AMVP_CTX *ctx, int margin) {
+    if (!ctx) {
+        return AMVP_NO_CTX;
+    }
+    ctx->jwt_renew_margin = margin < 0 ? -1 : margin;
+    /* Reschedule the current token, if there is one */
+    if (ctx->jwt_token) {
+        amvp_jwt_track(ctx);
+    }
+    return AMVP_SUCCESS;
+}
+
+AMVP_RESULT amvp_set_incremental_parse(AMVP_CTX *ctx, int enable) {
+    if (!ctx) {
+        return AMVP_NO_CTX;
+    }
+    ctx->incremental_parse = enable ? 1 : 0;
+    return AMVP_SUCCESS;
+}
+
+AMVP_RESULT amvp_set_request_file_buffer(AMVP_CTX *ctx, int kbytes, AMVP_FSYNC_POLICY fsync) {
+    if (!ctx) {
+        return AMVP_NO_CTX;
+    }
+    if (kbytes < 0 || kbytes > AMVP_REQ_FILE_BUF_MAX_KB) {
+        return AMVP_INVALID_ARG;
+    }
+    if (fsync != AMVP_FSYNC_NONE && fsync != AMVP_FSYNC_ON_CLOSE && fsync != AMVP_FSYNC_EACH_SET) {
+        return AMVP_INVALID_ARG;
+    }
+    ctx->req_file.buf_size = (size_t)kbytes * 1024;
+    ctx->req_file.fsync = fsync;
+    return AMVP_SUCCESS;
+}
+
+AMVP_RESULT amvp_set_pipeline_depth(AMVP_CTX *ctx, int depth) {
+    if (!ctx) {
+        return AMVP_NO_CTX;
+    }
+    if (depth < 0 || depth > AMVP_MAX_PIPELINE_DEPTH) {
+        AMVP_LOG_ERR("Pipeline depth must be between 0 and %d", AMVP_MAX_PIPELINE_DEPTH);
+        return AMVP_INVALID_ARG;
+    }
+    ctx->pipeline_depth = depth;
+    return AMVP_SUCCESS;
+}
+
+AMVP_RESULT amvp_set_http2(AMVP_CTX *ctx, int enable) {
+    if (!ctx) {
+        return AMVP_NO_CTX;
+    }
+    if (enable) {
+#if defined AMVP_OFFLINE || defined USE_MURL || LIBCURL_VERSION_NUM < 0x073600
+        AMVP_LOG_ERR("libamvp was built without HTTP/2 support");
+        return AMVP_UNSUPPORTED_OP;
+#else
+        if (!(curl_version_info(CURLVERSION_NOW)->features & CURL_VERSION_HTTP2)) {
+            AMVP_LOG_ERR("libcurl was built without HTTP/2 support");
+            return AMVP_UNSUPPORTED_OP;
+        }
+#endif
+    }
+    ctx->http2 = enable ? 1 : 0;
+    return AMVP_SUCCESS;
+}
 
-    if (ctx->tls_key) { free(ctx->tls_key); }
-    ctx->tls_key = calloc(AMVP_SESSION_PARAMS_STR_LEN_MAX + 1, sizeof(char));
-    if (!ctx->tls_key) {
-        free(ctx->tls_cert);
-        ctx->tls_cert = NULL;
-        return AMVP_MALLOC_FAIL;
+AMVP_RESULT amvp_set_json_compact(AMVP_CTX *ctx, int enable) {
+    if (!ctx) {
+        return AMVP_NO_CTX;
     }
-    strcpy_s(ctx->tls_key, AMVP_SESSION_PARAMS_STR_LEN_MAX + 1, key_file);
+    ctx->json_compact = enable ? 1 : 0;
+    return AMVP_SUCCESS;
+}
 
+AMVP_RESULT amvp_set_json_arena(AMVP_CTX *ctx, int enable) {
+    if (!ctx) {
+        return AMVP_NO_CTX;
+    }
+    if (ctx->json_arena_active) {
+        return AMVP_UNSUPPORTED_OP;
+    }
+    ctx->json_arena_enabled = enable ? 1 : 0;
+    if (!enable) {
+        amvp_arena_free(&ctx->json_arena);
+    }
     return AMVP_SUCCESS;
 }
 
@@ -2193,9 +2036,11 @@ int amvp_get_vector_set_count(AMVP_CTX *ctx) {
  * This function builds the JSON login message that
  * will be sent to the AMVP server. If enabled,
  * it will perform the second of the two-factor
- * authentications using a TOTP.
+ * authentications using a TOTP. With refresh_jwt set it asks for
+ * that token to be renewed. This is also used by the JWT renewal
+ * thread, so it only reads ctx's settings.
  */
-static AMVP_RESULT amvp_build_login(AMVP_CTX *ctx, char **login, int *login_len, int refresh) {
+AMVP_RESULT amvp_build_login(AMVP_CTX *ctx, char **login, int *login_len, const char *refresh_jwt) {
     AMVP_RESULT rv = AMVP_SUCCESS;
     JSON_Value *reg_arry_val = NULL;
     JSON_Value *pw_val = NULL;
@@ -2211,7 +2056,7 @@ static AMVP_RESULT amvp_build_login(AMVP_CTX *ctx, char **login, int *login_len,
     reg_arry_val = json_value_init_array();
     reg_arry = json_array((const JSON_Value *)reg_arry_val);
 
-    if (ctx->totp_cb || refresh) {
+    if (ctx->totp_cb || refresh_jwt) {
         pw_val = json_value_init_object();
         pw_obj = json_value_get_object(pw_val);
     }
@@ -2235,8 +2080,8 @@ static AMVP_RESULT amvp_build_login(AMVP_CTX *ctx, char **login, int *login_len,
         json_object_set_string(pw_obj, "password", token);
     }
 
-    if (refresh) {
-        json_object_set_string(pw_obj, "accessToken", ctx->jwt_token);
+    if (refresh_jwt) {
+        json_object_set_string(pw_obj, "accessToken", refresh_jwt);
     }
     if (pw_val) json_array_append_value(reg_arry, pw_val);
 
@@ -2289,15 +2134,13 @@ static AMVP_RESULT amvp_register(AMVP_CTX *ctx) {
             rv = AMVP_JSON_ERR;
             goto end;
         }
-        ctx->registration = tmp_json;
+        amvp_set_registration(ctx, tmp_json);
     } else {
         AMVP_LOG_STATUS("Building registration of capabilities...");
-        rv = amvp_build_registration_json(ctx, &tmp_json);
+        rv = amvp_get_registration(ctx, &tmp_json);
         if (rv != AMVP_SUCCESS) {
             AMVP_LOG_ERR("Unable to build registration");
             goto end;
-        } else {
-            ctx->registration = tmp_json;
         }
     }
 
@@ -2323,7 +2166,7 @@ static AMVP_RESULT amvp_register(AMVP_CTX *ctx) {
     }
 
 end:
-    if (reg) json_free_serialized_string(reg);
+    if (reg) free(reg);
     return rv;
 }
 
@@ -2377,6 +2220,7 @@ static AMVP_RESULT amvp_parse_mod_cert_req(AMVP_CTX *ctx) {
     }
     memzero_s(ctx->jwt_token, AMVP_JWT_TOKEN_MAX + 1);
     strcpy_s(ctx->jwt_token, AMVP_JWT_TOKEN_MAX + 1, access_token);
+    amvp_jwt_track(ctx);
 
     /*
      * Identify the TE identifiers provided by the server, save them for
@@ -2485,7 +2329,7 @@ static AMVP_RESULT amvp_process_teid(AMVP_CTX *ctx, char *vsid_url, int count) {
                         vs_entry = vs_entry->next;
                     }
                     /* Start with identifiers */
-                    rv = amvp_json_serialize_to_file_pretty_w(ts_val, ctx->vector_req_file);
+                    rv = amvp_req_file_begin(ctx, ts_val);
                     if (rv != AMVP_SUCCESS) {
                         AMVP_LOG_ERR("File write error");
                         json_value_free(ts_val);
@@ -2493,7 +2337,7 @@ static AMVP_RESULT amvp_process_teid(AMVP_CTX *ctx, char *vsid_url, int count) {
                     }
                 } 
                 /* append the TE groups */
-                rv = amvp_json_serialize_to_file_pretty_a(set_val, ctx->vector_req_file);
+                rv = amvp_req_file_add(ctx, set_val);
                 json_value_free(ts_val);
                 goto end;
             }
@@ -2521,6 +2365,67 @@ end:
     return rv;
 }
 
+/*
+ * The AMVP_VS_PROCESS_CB for TE sets, counterpart of amvp_process_vs_body()
+ * for amvp_process_teid()
+ */
+static AMVP_RESULT amvp_process_te_body(AMVP_CTX *ctx,
+                                        const char *vsid_url,
+                                        char *body,
+                                        int *retry_period,
+                                        char **rsp,
+                                        int *rsp_len) {
+    AMVP_RESULT rv = AMVP_SUCCESS;
+    JSON_Value *val = NULL;
+    JSON_Object *obj = NULL;
+
+    val = json_parse_string(body);
+    if (!val) {
+        AMVP_LOG_ERR("JSON parse error for TE set %s", vsid_url);
+        return AMVP_JSON_ERR;
+    }
+    obj = amvp_get_obj_from_rsp(ctx, val);
+
+    *retry_period = json_object_get_number(obj, "retry");
+    if (*retry_period) {
+        rv = AMVP_KAT_DOWNLOAD_RETRY;
+        goto end;
+    }
+
+    rv = amvp_process_ie_set(ctx, obj);
+    if (rv != AMVP_SUCCESS) goto end;
+
+    rv = amvp_kat_resp_serialize(ctx, rsp, rsp_len);
+    if (rv != AMVP_SUCCESS) {
+        AMVP_LOG_ERR("Failed to serialize TE set responses");
+    }
+
+end:
+    json_value_free(val);
+    return rv;
+}
+
+/*
+ * Journals as uploaded the vector sets in list that the concurrent
+ * transfer loop got processed responses for and didn't return in failed.
+ */
+static void amvp_checkpoint_uploaded_except(AMVP_CTX *ctx, AMVP_STRING_LIST *list, AMVP_STRING_LIST *failed) {
+    AMVP_STRING_LIST *entry = NULL, *f = NULL;
+    int diff = 1;
+
+    for (entry = list; entry; entry = entry->next) {
+        if (amvp_checkpoint_state(ctx, entry->string) != AMVP_CKPT_PROCESSED) {
+            continue;
+        }
+        for (f = failed, diff = 1; f && diff; f = f->next) {
+            strcmp_s(f->string, AMVP_ATTR_URL_MAX, entry->string, &diff);
+        }
+        if (diff) {
+            amvp_checkpoint_uploaded(ctx, entry->string);
+        }
+    }
+}
+
 /*
  * This function is used by the application after registration
  * to commence the testing.  All the testing will be handled
@@ -2531,6 +2436,7 @@ static
 AMVP_RESULT amvp_process_amvp_tes(AMVP_CTX *ctx) {
     AMVP_RESULT rv = AMVP_SUCCESS;
     AMVP_STRING_LIST *vs_entry = NULL;
+    AMVP_STRING_LIST *failed = NULL;
     int count = 0;
 
     if (!ctx) {
@@ -2546,19 +2452,34 @@ AMVP_RESULT amvp_process_amvp_tes(AMVP_CTX *ctx) {
     if (!vs_entry) {
         return AMVP_MISSING_ARG;
     }
+
+    /* Same as amvp_process_tests(): overlap transfers and crypto when asked to */
+    if ((ctx->max_transfers > 1 || ctx->pipeline_depth) && !ctx->vector_req) {
+        rv = amvp_transport_process_vector_sets(ctx, amvp_process_te_body, &failed);
+        if (rv == AMVP_SUCCESS) {
+            vs_entry = failed;
+        } else if (rv != AMVP_UNSUPPORTED_OP) {
+            AMVP_LOG_ERR("Unable to process TE sets concurrently! Error: %d", rv);
+            goto end;
+        }
+        rv = AMVP_SUCCESS;
+    }
+
     while (vs_entry) {
         rv = amvp_process_teid(ctx, vs_entry->string, count);
         if (rv != AMVP_SUCCESS) {
             AMVP_LOG_ERR("Unable to process vector set! Error: %d", rv);
-            return rv;
+            goto end;
         }
         vs_entry = vs_entry->next;
         count++;
     }
     /* Need to add the ending ']' here */
     if (ctx->vector_req) {
-        rv = amvp_json_serialize_to_file_pretty_a(NULL, ctx->vector_req_file);
+        rv = amvp_req_file_end(ctx);
     }
+end:
+    if (failed) amvp_free_str_list(&failed);
     return rv;
 }
 
@@ -2604,7 +2525,7 @@ AMVP_RESULT amvp_mod_cert_req(AMVP_CTX *ctx) {
         rv = AMVP_JSON_ERR;
         goto end;
     }
-    ctx->registration = tmp_json;
+    amvp_set_registration(ctx, tmp_json);
     reg = json_serialize_to_string(tmp_json, &reg_len);
     
     AMVP_LOG_STATUS("Sending module cert request...");
@@ -2726,6 +2647,7 @@ static AMVP_RESULT amvp_parse_login(AMVP_CTX *ctx) {
 
         ctx->jwt_token = calloc(AMVP_JWT_TOKEN_MAX + 1, sizeof(char));
         strcpy_s(ctx->jwt_token, AMVP_JWT_TOKEN_MAX + 1, jwt);
+        amvp_jwt_track(ctx);
     }
 end:
     json_value_free(val);
@@ -2797,12 +2719,12 @@ static AMVP_RESULT amvp_parse_validation(AMVP_CTX *ctx) {
             AMVP_LOG_WARN("Failed to save request URL to test session file. Make sure you save it from output!");
             goto end;  
         }
-        rv = amvp_json_serialize_to_file_pretty_w(new_ts, ctx->session_file_path);
+        rv = amvp_json_serialize_to_file_w(ctx, new_ts, ctx->session_file_path);
         if (rv) {
             AMVP_LOG_WARN("Failed to save request URL to test session file. Make sure you save it from output!");
             goto end;
         } else {
-            amvp_json_serialize_to_file_pretty_a(NULL, ctx->session_file_path);
+            amvp_json_serialize_to_file_a(ctx, NULL, ctx->session_file_path);
         }
     }
 
@@ -2972,6 +2894,7 @@ static AMVP_RESULT amvp_parse_test_session_register(AMVP_CTX *ctx) {
     }
     memzero_s(ctx->jwt_token, AMVP_JWT_TOKEN_MAX + 1);
     strcpy_s(ctx->jwt_token, AMVP_JWT_TOKEN_MAX + 1, access_token);
+    amvp_jwt_track(ctx);
 
     /*
      * Identify the VS identifiers provided by the server, save them for
@@ -3062,6 +2985,7 @@ static AMVP_RESULT amvp_parse_session_info_file(AMVP_CTX *ctx, const char *filen
         goto end;
     }
     strcpy_s(ctx->jwt_token, AMVP_JWT_TOKEN_MAX + 1, jwt);
+    amvp_jwt_track(ctx);
 
     isSample = json_object_get_boolean(obj, "isSample");
     if (json_object_has_value(obj, "isSample")) {
@@ -3075,6 +2999,78 @@ end:
     return rv;
 }
 
+/*
+ * Used by the concurrent transfer loop with the body of a downloaded
+ * vector set. This is steps b) through d) of amvp_process_vsid(); the
+ * transport takes care of downloading and submitting the responses.
+ * The body belongs to the transfer and is only read again once the set
+ * is done with, so it is parsed in place unless it still has to be
+ * checkpointed.
+ */
+static AMVP_RESULT amvp_process_vs_body(AMVP_CTX *ctx,
+                                        const char *vsid_url,
+                                        char *body,
+                                        int *retry_period,
+                                        char **rsp,
+                                        int *rsp_len) {
+    AMVP_RESULT rv = AMVP_SUCCESS;
+    JSON_Value *val = NULL;
+    JSON_Object *obj = NULL;
+    AMVP_VS_METRICS_REC *rec = NULL;
+    AMVP_MEM_MARK mem;
+    double start = 0;
+
+    rec = amvp_metrics_begin(ctx, vsid_url);
+    amvp_json_arena_begin(ctx);
+    if (rec) start = amvp_metrics_now();
+    if (rec) amvp_mem_mark(&mem);
+    AMVP_TRACE1(json__parse__start, body);
+    val = ctx->checkpoint ? json_parse_string(body) : json_parse_string_in_place(body);
+    AMVP_TRACE2(json__parse__done, body, val != NULL);
+    if (rec) rec->m.parse_ms += amvp_metrics_now() - start;
+    amvp_metrics_mem_phase(rec, AMVP_METRICS_PARSE, &mem);
+    if (!val) {
+        AMVP_LOG_ERR("JSON parse error for vector set %s", vsid_url);
+        rv = AMVP_JSON_ERR;
+        goto end;
+    }
+    obj = amvp_get_obj_from_rsp(ctx, val);
+
+    /*
+     * Check if we received a retry response
+     */
+    *retry_period = json_object_get_number(obj, "retry");
+    if (*retry_period) {
+        rv = AMVP_KAT_DOWNLOAD_RETRY;
+        goto end;
+    }
+
+    if (ctx->checkpoint) {
+        rv = amvp_checkpoint_downloaded(ctx, vsid_url, (int)json_object_get_number(obj, "vsId"),
+                                        body, strnlen_s(body, AMVP_CURL_BUF_MAX));
+        if (rv != AMVP_SUCCESS) goto end;
+    }
+
+    rv = amvp_process_vector_set(ctx, obj);
+    if (rv != AMVP_SUCCESS) goto end;
+
+    if (rec) start = amvp_metrics_now();
+    if (rec) amvp_mem_mark(&mem);
+    rv = amvp_kat_resp_serialize(ctx, rsp, rsp_len);
+    if (rec) rec->m.upload_ms += amvp_metrics_now() - start;
+    amvp_metrics_mem_phase(rec, AMVP_METRICS_UPLOAD, &mem);
+    if (rv != AMVP_SUCCESS) {
+        AMVP_LOG_ERR("Failed to serialize vector set responses");
+    } else if (ctx->checkpoint) {
+        rv = amvp_checkpoint_processed(ctx, vsid_url, *rsp, (size_t)*rsp_len);
+    }
+
+end:
+    amvp_json_arena_end(ctx, &val);
+    amvp_metrics_end(ctx);
+    return rv;
+}
+
 /*
  * This function is used by the application after registration
  * to commence the testing.  All the testing will be handled
@@ -3084,7 +3080,7 @@ end:
 AMVP_RESULT amvp_process_tests(AMVP_CTX *ctx) {
     AMVP_RESULT rv = AMVP_SUCCESS;
     AMVP_STRING_LIST *vs_entry = NULL;
-    int count = 0;
+    AMVP_STRING_LIST *failed = NULL;
 
     if (!ctx) {
         return AMVP_NO_CTX;
@@ -3099,19 +3095,38 @@ AMVP_RESULT amvp_process_tests(AMVP_CTX *ctx) {
     if (!vs_entry) {
         return AMVP_MISSING_ARG;
     }
-    while (vs_entry) {
-        rv = amvp_process_vsid(ctx, vs_entry->string, count);
-        if (rv != AMVP_SUCCESS) {
-            AMVP_LOG_ERR("Unable to process vector set! Error: %d", rv);
-            return rv;
+
+    /*
+     * When allowed, overlap the downloads and uploads of the vector sets,
+     * and with a pipeline depth the crypto work too. Saving the requests
+     * to file relies on the sets arriving in order, so that mode is always
+     * handled serially.
+     */
+    if ((ctx->max_transfers > 1 || ctx->pipeline_depth) && !ctx->vector_req) {
+        rv = amvp_transport_process_vector_sets(ctx, amvp_process_vs_body, &failed);
+        if (rv == AMVP_SUCCESS) {
+            if (ctx->checkpoint) {
+                amvp_checkpoint_uploaded_except(ctx, vs_entry, failed);
+            }
+            /* Anything that hit an HTTP error gets another go the usual way */
+            vs_entry = failed;
+        } else if (rv != AMVP_UNSUPPORTED_OP) {
+            AMVP_LOG_ERR("Unable to process vector sets concurrently! Error: %d", rv);
+            goto end;
         }
-        vs_entry = vs_entry->next;
-        count++;
+    }
+
+    rv = amvp_process_vsid_list(ctx, vs_entry, 0);
+    if (rv != AMVP_SUCCESS) {
+        AMVP_LOG_ERR("Unable to process vector set! Error: %d", rv);
+        goto end;
     }
     /* Need to add the ending ']' here */
     if (ctx->vector_req) {
-        rv = amvp_json_serialize_to_file_pretty_a(NULL, ctx->vector_req_file);
+        rv = amvp_req_file_end(ctx);
     }
+end:
+    if (failed) amvp_free_str_list(&failed);
     return rv;
 }
 
@@ -3125,6 +3140,28 @@ AMVP_RESULT amvp_process_tests(AMVP_CTX *ctx) {
  * function will ensure that retry periods will sum to no longer than AMVP_MAX_WAIT_TIME.
  */
 static AMVP_RESULT amvp_retry_handler(AMVP_CTX *ctx, int *retry_period, unsigned int *waited_so_far, int modifier, AMVP_WAITING_STATUS situation) {
+    if (amvp_retry_check(ctx, retry_period, waited_so_far, situation) != AMVP_SUCCESS) {
+        return AMVP_TRANSPORT_FAIL;
+    }
+
+    #ifdef _WIN32
+    /*
+     * Windows uses milliseconds
+     */
+    Sleep(*retry_period * 1000);
+    #else
+    sleep(*retry_period);
+    #endif
+
+    amvp_retry_advance(ctx, retry_period, waited_so_far, modifier);
+    return AMVP_KAT_DOWNLOAD_RETRY;
+}
+
+/*
+ * First half of amvp_retry_handler(): clamps retry_period to the limits
+ * and the time left out of AMVP_MAX_WAIT_TIME. Fails once that is used up.
+ */
+static AMVP_RESULT amvp_retry_check(AMVP_CTX *ctx, int *retry_period, unsigned int *waited_so_far, AMVP_WAITING_STATUS situation) {
     /* perform check at beginning of function call, so library can check one more time when max
      * time is reached to see if server status has changed */
     if (*waited_so_far >= AMVP_MAX_WAIT_TIME) {
@@ -3145,16 +3182,14 @@ static AMVP_RESULT amvp_retry_handler(AMVP_CTX *ctx, int *retry_period, unsigned
     } else {
         AMVP_LOG_STATUS("200 OK, waiting %u seconds and trying again...", *retry_period);
     }
+    return AMVP_SUCCESS;
+}
 
-    #ifdef _WIN32
-    /*
-     * Windows uses milliseconds
-     */
-    Sleep(*retry_period * 1000);
-    #else
-    sleep(*retry_period);
-    #endif
-
+/*
+ * Second half of amvp_retry_handler(), once the wait is over: applies
+ * the backoff modifier and accounts for the time waited.
+ */
+static void amvp_retry_advance(AMVP_CTX *ctx, int *retry_period, unsigned int *waited_so_far, int modifier) {
     /* ensure that all parameters are valid and that we do not wait longer than AMVP_MAX_WAIT_TIME */
     if (modifier < 1 || modifier > AMVP_RETRY_MODIFIER_MAX) {
         AMVP_LOG_WARN("retry modifier not valid, defaulting to 1 (no change)");
@@ -3165,8 +3200,98 @@ static AMVP_RESULT amvp_retry_handler(AMVP_CTX *ctx, int *retry_period, unsigned
     }
 
     *waited_so_far += *retry_period;
+}
 
-    return AMVP_KAT_DOWNLOAD_RETRY;
+/*
+ * Per vector set state for amvp_process_vsid_list()
+ */
+typedef struct amvp_vs_sched_t {
+    char *vsid_url;
+    int count;                  /* position in the list, for amvp_process_vsid() */
+    time_t ready_at;            /* earliest time to ask the server again */
+    int retry_period;
+    unsigned int waited;        /* total seconds this set has been waited on */
+    int done;
+} AMVP_VS_SCHED;
+
+/*
+ * Process the vector sets in list. Sets the server isn't ready with are
+ * not waited on one after the other; each gets its own next-ready time
+ * from the server's retry hint, and whichever set is due is polled next.
+ * The calling thread only sleeps when no set is ready, so the total wait
+ * is about that of the slowest set instead of the sum. When saving the
+ * requests to file the sets still have to be handled in order.
+ */
+static AMVP_RESULT amvp_process_vsid_list(AMVP_CTX *ctx, AMVP_STRING_LIST *list, int first_count) {
+    AMVP_RESULT rv = AMVP_SUCCESS;
+    AMVP_STRING_LIST *entry = NULL;
+    AMVP_VS_SCHED *sched = NULL;
+    int cnt = 0, remaining = 0, i;
+
+    for (entry = list; entry; entry = entry->next) {
+        cnt++;
+    }
+    if (!cnt) {
+        return AMVP_SUCCESS;
+    }
+    sched = calloc(cnt, sizeof(AMVP_VS_SCHED));
+    if (!sched) {
+        return AMVP_MALLOC_FAIL;
+    }
+    for (entry = list, i = 0; entry; entry = entry->next, i++) {
+        sched[i].vsid_url = entry->string;
+        sched[i].count = first_count + i;
+    }
+    remaining = cnt;
+
+    while (remaining) {
+        AMVP_VS_SCHED *next = NULL;
+        time_t now = 0;
+
+        /* Earliest due set; ties go to the one listed first */
+        for (i = 0; i < cnt; i++) {
+            if (sched[i].done) {
+                continue;
+            }
+            if (!next || sched[i].ready_at < next->ready_at) {
+                next = &sched[i];
+            }
+            if (ctx->vector_req) {
+                break;
+            }
+        }
+
+        now = time(NULL);
+        if (next->ready_at > now) {
+#ifdef _WIN32
+            Sleep((DWORD)(next->ready_at - now) * 1000);
+#else
+            sleep((unsigned int)(next->ready_at - now));
+#endif
+        }
+
+        rv = amvp_process_vsid(ctx, next->vsid_url, next->count, &next->retry_period);
+        if (rv == AMVP_KAT_DOWNLOAD_RETRY) {
+            if (amvp_retry_check(ctx, &next->retry_period, &next->waited, AMVP_WAITING_FOR_TESTS) != AMVP_SUCCESS) {
+                AMVP_LOG_STATUS("Maximum wait time with server reached! (Max: %d seconds)", AMVP_MAX_WAIT_TIME);
+                rv = AMVP_TRANSPORT_FAIL;
+                goto end;
+            }
+            next->ready_at = time(NULL) + next->retry_period;
+            amvp_retry_advance(ctx, &next->retry_period, &next->waited, 1);
+            continue;
+        }
+        if (rv != AMVP_SUCCESS) {
+            AMVP_LOG_ERR("Unable to process vector set %s! Error: %d", next->vsid_url, rv);
+            goto end;
+        }
+        next->done = 1;
+        remaining--;
+    }
+
+end:
+    free(sched);
+    return rv;
 }
 
 /*
@@ -3180,7 +3305,7 @@ AMVP_RESULT amvp_check_test_results(AMVP_CTX *ctx) {
         return AMVP_NO_CTX;
     }
 
-    rv = amvp_get_result_test_session(ctx, ctx->session_url);
+    rv = amvp_get_result_test_session(ctx, ctx->session_url, NULL);
     return rv;
 }
 
@@ -3195,7 +3320,7 @@ static AMVP_RESULT amvp_login(AMVP_CTX *ctx, int refresh) {
     int login_len = 0;
 
     AMVP_LOG_STATUS("Logging in...");
-    rv = amvp_build_login(ctx, &login, &login_len, refresh);
+    rv = amvp_build_login(ctx, &login, &login_len, refresh ? ctx->jwt_token : NULL);
     if (rv != AMVP_SUCCESS) {
         AMVP_LOG_ERR("Unable to build login message");
         goto end;
@@ -3245,8 +3370,12 @@ AMVP_RESULT amvp_refresh(AMVP_CTX *ctx) {
  *    c) Process each test case in the KAT vector set
  *    d) Generate the response data
  *    e) Send the response data back to the AMVP server
+ *
+ * If the server isn't ready with the vector set yet, this returns
+ * AMVP_KAT_DOWNLOAD_RETRY with the wait it asked for in retry_period
+ * and the caller decides when to try again.
  */
-static AMVP_RESULT amvp_process_vsid(AMVP_CTX *ctx, char *vsid_url, int count) {
+static AMVP_RESULT amvp_process_vsid(AMVP_CTX *ctx, char *vsid_url, int count, int *retry_period) {
     AMVP_RESULT rv = AMVP_SUCCESS;
     JSON_Value *val = NULL;
     JSON_Value *alg_val = NULL;
@@ -3256,99 +3385,187 @@ static AMVP_RESULT amvp_process_vsid(AMVP_CTX *ctx, char *vsid_url, int count) {
     JSON_Object *ts_obj = NULL;
     JSON_Object *obj = NULL;
     AMVP_STRING_LIST *vs_entry = NULL;
-    int retry_period = 0;
-    int retry = 1;
-    unsigned int time_waited_so_far = 0;
-    while (retry) {
-        /*
-         * Get the KAT vector set
-         */
+    AMVP_VS_METRICS_REC *rec = NULL;
+    AMVP_CKPT_STATE ckpt = AMVP_CKPT_NONE;
+    AMVP_MEM_MARK mem;
+    char *saved = NULL;
+    size_t saved_len = 0;
+    int rsp_len = 0, streamed = 0;
+    double start = 0;
+    AMVP_RESULT stream_rv = AMVP_SUCCESS;
+
+    *retry_period = 0;
+    rec = amvp_metrics_begin(ctx, vsid_url);
+    amvp_metrics_download_start(rec);
+    amvp_metrics_set_net(ctx, rec);
+
+    /*
+     * Pick up from the checkpoint of a previous run, if there is one
+     */
+    if (!ctx->vector_req) {
+        ckpt = amvp_checkpoint_state(ctx, vsid_url);
+    }
+    if (ckpt == AMVP_CKPT_DOWNLOADED || ckpt == AMVP_CKPT_PROCESSED) {
+        if (amvp_checkpoint_load(ctx, vsid_url, ckpt, &saved, &saved_len) != AMVP_SUCCESS) {
+            AMVP_LOG_WARN("Starting vector set %s over", vsid_url);
+            ckpt = AMVP_CKPT_NONE;
+        }
+    }
+    if (ckpt == AMVP_CKPT_PROCESSED) {
+        AMVP_LOG_STATUS("Posting saved vector set responses for %s...", vsid_url);
+        goto submit;
+    }
+
+    /*
+     * Get the KAT vector set
+     */
+    if (ckpt == AMVP_CKPT_DOWNLOADED) {
+        AMVP_LOG_STATUS("Using saved copy of vector set %s", vsid_url);
+    } else {
+        /* The test groups may be processed while the set downloads, see amvp_vs_stream.c */
+        if (!ctx->vector_req && !ctx->checkpoint) {
+            rv = amvp_vs_stream_begin(ctx, amvp_dispatch_vector_set);
+            if (rv != AMVP_SUCCESS) goto end;
+        }
         rv = amvp_retrieve_vector_set(ctx, vsid_url);
+        /* A handler failing aborts the download, report that instead */
+        stream_rv = amvp_vs_stream_end(ctx, &streamed);
+        if (stream_rv != AMVP_SUCCESS) rv = stream_rv;
         if (rv != AMVP_SUCCESS) goto end;
+        if (streamed) {
+            AMVP_LOG_STATUS("Successfully processed vector set");
+            goto processed;
+        }
+    }
 
+    if (rec) start = amvp_metrics_now();
+    if (rec) amvp_mem_mark(&mem);
+    /*
+     * The set is freed before the next request reuses curl_buf, so its
+     * strings can point into the buffer, unless the download still has to
+     * be checkpointed from it
+     */
+    AMVP_TRACE1(json__parse__start, saved ? saved : ctx->curl_buf);
+    if (saved) {
+        val = json_parse_string_in_place(saved);
+    } else if (ctx->checkpoint) {
         val = json_parse_string(ctx->curl_buf);
-        if (!val) {
-            AMVP_LOG_ERR("JSON parse error");
-            rv = AMVP_JSON_ERR;
-            goto end;
-        }
-        obj = amvp_get_obj_from_rsp(ctx, val);
+    } else {
+        val = json_parse_string_in_place(ctx->curl_buf);
+    }
+    AMVP_TRACE2(json__parse__done, saved ? saved : ctx->curl_buf, val != NULL);
+    if (rec) rec->m.parse_ms += amvp_metrics_now() - start;
+    amvp_metrics_mem_phase(rec, AMVP_METRICS_PARSE, &mem);
+    if (!val) {
+        AMVP_LOG_ERR("JSON parse error");
+        rv = AMVP_JSON_ERR;
+        goto end;
+    }
+    obj = amvp_get_obj_from_rsp(ctx, val);
 
-        /*
-         * Check if we received a retry response
-         */
-        retry_period = json_object_get_number(obj, "retry");
-        if (retry_period) {
-            /*
-             * Wait and try again to retrieve the VectorSet
-             */
-            if (amvp_retry_handler(ctx, &retry_period, &time_waited_so_far, 1, AMVP_WAITING_FOR_TESTS) != AMVP_KAT_DOWNLOAD_RETRY) {
-                AMVP_LOG_STATUS("Maximum wait time with server reached! (Max: %d seconds)", AMVP_MAX_WAIT_TIME);
-                rv = AMVP_TRANSPORT_FAIL;
-                goto end;
-            };
-            retry = 1;
-        } else {
-            /*
-             * Save the KAT VectorSet to file
-             */
-            if (ctx->vector_req) {
-                
-                AMVP_LOG_STATUS("Saving vector set %s to file...", vsid_url);
-                alg_array = json_value_get_array(val);
-                alg_val = json_array_get_value(alg_array, 1);
+    /*
+     * Check if we received a retry response
+     */
+    *retry_period = json_object_get_number(obj, "retry");
+    if (*retry_period) {
+        amvp_metrics_retry(rec);
+        rv = AMVP_KAT_DOWNLOAD_RETRY;
+        goto end;
+    }
 
-                /* track first vector set with file count */
-                if (count == 0) {
-                    ts_val = json_value_init_object();
-                    ts_obj = json_value_get_object(ts_val);
+    /*
+     * Save the KAT VectorSet to file
+     */
+    if (ctx->vector_req) {
+        AMVP_LOG_STATUS("Saving vector set %s to file...", vsid_url);
+        alg_array = json_value_get_array(val);
+        alg_val = json_array_get_value(alg_array, 1);
 
-                    json_object_set_string(ts_obj, "jwt", ctx->jwt_token);
-                    json_object_set_string(ts_obj, "url", ctx->session_url);
-                    json_object_set_boolean(ts_obj, "isSample", ctx->is_sample);
+        /* track first vector set with file count */
+        if (count == 0) {
+            ts_val = json_value_init_object();
+            ts_obj = json_value_get_object(ts_val);
+
+            json_object_set_string(ts_obj, "jwt", ctx->jwt_token);
+            json_object_set_string(ts_obj, "url", ctx->session_url);
+            json_object_set_boolean(ts_obj, "isSample", ctx->is_sample);
 
-                    json_object_set_value(ts_obj, "vectorSetUrls", json_value_init_array());
-                    url_arr = json_object_get_array(ts_obj, "vectorSetUrls");
+            json_object_set_value(ts_obj, "vectorSetUrls", json_value_init_array());
+            url_arr = json_object_get_array(ts_obj, "vectorSetUrls");
 
-                    vs_entry = ctx->vsid_url_list;
-                    while (vs_entry) {
-                        json_array_append_string(url_arr, vs_entry->string);
-                        vs_entry = vs_entry->next;
-                    }
-                    /* Start with identifiers */
-                    rv = amvp_json_serialize_to_file_pretty_w(ts_val, ctx->vector_req_file);
-                    if (rv != AMVP_SUCCESS) {
-                        AMVP_LOG_ERR("File write error");
-                        json_value_free(ts_val);
-                        goto end;
-                    }
-                } 
-                /* append vector set */
-                rv = amvp_json_serialize_to_file_pretty_a(alg_val, ctx->vector_req_file);
+            vs_entry = ctx->vsid_url_list;
+            while (vs_entry) {
+                json_array_append_string(url_arr, vs_entry->string);
+                vs_entry = vs_entry->next;
+            }
+            /* Start with identifiers */
+            rv = amvp_req_file_begin(ctx, ts_val);
+            if (rv != AMVP_SUCCESS) {
+                AMVP_LOG_ERR("File write error");
                 json_value_free(ts_val);
                 goto end;
             }
-            /*
-             * Process the KAT VectorSet
-             */
-            rv = amvp_process_vector_set(ctx, obj);
-            json_value_free(ts_val);
-            retry = 0;
         }
+        /* append vector set */
+        rv = amvp_req_file_add(ctx, alg_val);
+        json_value_free(ts_val);
+        goto end;
+    }
 
+    if (ctx->checkpoint && ckpt == AMVP_CKPT_NONE) {
+        rv = amvp_checkpoint_downloaded(ctx, vsid_url, (int)json_object_get_number(obj, "vsId"),
+                                        ctx->curl_buf, ctx->curl_read_ctr);
+        if (rv != AMVP_SUCCESS) goto end;
+    }
+
+    /*
+     * Process the KAT VectorSet
+     */
+    rv = amvp_process_vector_set(ctx, obj);
+    if (rv != AMVP_SUCCESS) goto end;
+    json_value_free(val);
+    val = NULL;
+    if (saved) free(saved);
+    saved = NULL;
+
+processed:
+    if (ctx->checkpoint) {
+        /* Sent from the saved copy, the same way as when resuming */
+        rv = amvp_kat_resp_serialize(ctx, &saved, &rsp_len);
+        if (rv != AMVP_SUCCESS) goto end;
+        saved_len = (size_t)rsp_len;
+        rv = amvp_checkpoint_processed(ctx, vsid_url, saved, saved_len);
         if (rv != AMVP_SUCCESS) goto end;
-        json_value_free(val);
-        val = NULL;
     }
 
     /*
      * Send the responses to the AMVP server
      */
     AMVP_LOG_STATUS("Posting vector set responses for vsId %d...", ctx->vs_id);
+submit:
+    if (saved) {
+        /* The saved body is the whole [ ] array */
+        if (saved_len < 2) {
+            rv = AMVP_MALFORMED_JSON;
+            goto end;
+        }
+        ctx->rsp_slice = saved + 1;
+        ctx->rsp_slice_len = saved_len - 2;
+    }
+    if (rec) amvp_mem_mark(&mem);
     rv = amvp_submit_vector_responses(ctx, vsid_url);
+    amvp_metrics_mem_phase(rec, AMVP_METRICS_UPLOAD, &mem);
+    ctx->rsp_slice = NULL;
+    ctx->rsp_slice_len = 0;
+    if (rv == AMVP_SUCCESS && ctx->checkpoint) {
+        amvp_checkpoint_uploaded(ctx, vsid_url);
+    }
 
 end:
+    amvp_metrics_set_net(ctx, NULL);
+    amvp_metrics_end(ctx);
     if (val) json_value_free(val);
+    if (saved) free(saved);
     return rv;
 }
 
@@ -3364,7 +3581,11 @@ static AMVP_RESULT amvp_dispatch_vector_set(AMVP_CTX *ctx, JSON_Object *obj) {
     const char *alg = json_object_get_string(obj, "algorithm");
     const char *mode = json_object_get_string(obj, "mode");
     int vs_id = json_object_get_number(obj, "vsId");
-    int diff = 1;
+    AMVP_VS_METRICS_REC *rec = amvp_metrics_cur(ctx);
+    AMVP_MEM_MARK mem;
+    double start = 0;
+    /* A streamed set comes here once per group, see amvp_vs_stream.c */
+    int more = ctx->kat_rsp_cont == AMVP_RSP_CONT_MORE;
 
     ctx->vs_id = vs_id;
     AMVP_RESULT rv;
@@ -3374,124 +3595,74 @@ static AMVP_RESULT amvp_dispatch_vector_set(AMVP_CTX *ctx, JSON_Object *obj) {
         return AMVP_JSON_ERR;
     }
 
-    AMVP_LOG_STATUS("Processing vector set: %d", vs_id);
-    AMVP_LOG_STATUS("Algorithm: %s", alg);
-    if (mode) {
-        AMVP_LOG_STATUS("Mode: %s", mode);
-    }
-    for (i = 0; i < AMVP_ALG_MAX; i++) {
-        strcmp_s(alg_tbl[i].name,
-                 AMVP_ALG_NAME_MAX,
-                 alg, &diff);
-        if (!diff) {
-            if (mode == NULL) {
-                rv = (alg_tbl[i].handler)(ctx, obj);
-                return rv;
-            }
-
-            if (alg_tbl[i].mode != NULL) {
-                strcmp_s(alg_tbl[i].mode,
-                        AMVP_ALG_MODE_MAX,
-                        mode, &diff);
-                if (!diff) {
-                    rv = (alg_tbl[i].handler)(ctx, obj);
-                    return rv;
-                }
-            }
+    if (!more) {
+        AMVP_LOG_STATUS("Processing vector set: %d", vs_id);
+        AMVP_LOG_STATUS("Algorithm: %s", alg);
+        if (mode) {
+            AMVP_LOG_STATUS("Mode: %s", mode);
         }
     }
-    return AMVP_UNSUPPORTED_OP;
-}
-
-typedef struct amvp_evidence_t AMVP_EVIDENCE;
-struct amvp_evidence_t {
-    const char *evidence_name;
-    const char *evidence;
-};
-
-AMVP_EVIDENCE amvp_evidence_tbl[9] = {
-       {"TE02.20.01", "/acvp/v1/validations/41763"},
-       {"TE02.20.02", "none"},
-       {"TE11.16.01", "Version X.Y.Z of the module meets the assertion" },
-       {"TE04.11.01", "<BASE64(table of services.pdf) compliant with SP800-140Br>" },
-       {"TE04.11.02", "/wwwin.cisco.com/cryptomod/log_te041102_04172023.txt" },
-       {"TE10.10.01", "Degraded mode not supported, no algorithms can be used...goes directly into SP." },
-       {"TE10.10.02", "/wwwin.cisco.com/cryptomod/log_te041102_04172023.txt" },
-       {"TE11.08.01", "/wwwin.cisco.com/cryptomod/FSM.pdf" },
-       {"TE11.08.02", "See TE11.08.01"}
-};
-
+    i = amvp_lookup_alg_tbl_index(alg, mode);
+    if (i < 0) {
+        return AMVP_UNSUPPORTED_OP;
+    }
+    if (rec) {
+        JSON_Array *groups = json_object_get_array(obj, "testGroups");
+        size_t g;
 
-static const char *amvp_locate_auto_entry(AMVP_CTX *ctx, const char *evidence)
-{
-    int i;
-    int diff;
-    
-    for (i=0; i<9; i++) {
-        strcmp_s(evidence, strlen(amvp_evidence_tbl[i].evidence_name), amvp_evidence_tbl[i].evidence_name, &diff);
-        if (!diff) {
-            return (amvp_evidence_tbl[i].evidence);
+        rec->m.vs_id = vs_id;
+        snprintf(rec->m.algorithm, sizeof(rec->m.algorithm), mode ? "%s/%s" : "%s", alg, mode);
+        if (!more) rec->m.test_cases = 0;
+        for (g = 0; g < json_array_get_count(groups); g++) {
+            rec->m.test_cases += (int)json_array_get_count(
+                json_object_get_array(json_array_get_object(groups, g), "tests"));
         }
-    }
-    return NULL;
+        start = amvp_metrics_now();
+        amvp_mem_mark(&mem);
+    }
+    AMVP_TRACE3(vs__start, vs_id, alg, mode);
+    rv = (alg_tbl[i].handler)(ctx, obj);
+    AMVP_TRACE2(vs__done, vs_id, rv);
+    if (rec) rec->m.handler_ms += amvp_metrics_now() - start;
+    amvp_metrics_mem_phase(rec, AMVP_METRICS_HANDLER, &mem);
+    return rv;
 }
 
-
 /*
- * This function is used to invoke the appropriate handler function
- * for a given ACV operation.  The operation is specified in the
- * KAT vector set that was previously downloaded.  The handler function
- * is looked up in the alg_tbl[] and invoked here.
+ * This function builds the response for an IE set. The evidence for each
+ * automated TE comes from the evidence store, see amvp_evidence.c, and is
+ * streamed into ctx->kat_writer; TEs it has no evidence for are skipped.
  */
 static AMVP_RESULT amvp_dispatch_ie_set(AMVP_CTX *ctx, JSON_Object *obj) {
     int ie_id = json_object_get_number(obj, "ievSetsId");
+    AMVP_JSON_WRITER *w = &ctx->kat_writer;
     JSON_Value *groupval;
     JSON_Object *groupobj = NULL;
     JSON_Array *groups;
     JSON_Array *tests;
 
-    JSON_Value *reg_arry_val = NULL;
-    JSON_Object *reg_obj = NULL;
-    JSON_Array *reg_arry = NULL;
-
-    int i, g_cnt, ieset_len;
+    int i, g_cnt;
     int j, t_cnt;
 
-    JSON_Value *r_vs_val = NULL;
-    JSON_Object *r_vs = NULL;
-    JSON_Array *r_tarr = NULL, *r_garr = NULL;  /* Response testarray, grouparray */
-    JSON_Value *r_tval = NULL, *r_gval = NULL;  /* Response testval, groupval */
-    JSON_Object *r_tobj = NULL, *r_gobj = NULL; /* Response testobj, groupobj */
     const char *evidence;
-    const char *ev_str;
-    char *json_result;
 
     ctx->vs_id = ie_id;
     AMVP_RESULT rv;
 
     AMVP_LOG_STATUS("Processing ie set: %d", ie_id);
-    /*
-     * Create AMVP array for response
-     */
-    rv = amvp_create_array(&reg_obj, &reg_arry_val, &reg_arry);
-    if (rv != AMVP_SUCCESS) {
-        AMVP_LOG_ERR("Failed to create JSON response struct. ");
-        return rv;
+
+    groups = json_object_get_array(obj, "teGroups");
+    if (!groups) {
+        AMVP_LOG_ERR("Failed to include testGroups. ");
+        return AMVP_MISSING_ARG;
     }
-    
+
     /*
      * Start to build the JSON response
      */
-    rv = amvp_setup_json_ev_group(&ctx, &reg_arry_val, &r_vs_val, &r_vs, &r_garr);
+    rv = amvp_jw_begin_ie_rsp(ctx);
     if (rv != AMVP_SUCCESS) {
         AMVP_LOG_ERR("Failed to setup json response");
-        return rv;
-    }
-
-    groups = json_object_get_array(obj, "teGroups");
-    if (!groups) {
-        AMVP_LOG_ERR("Failed to include testGroups. ");
-        rv = AMVP_MISSING_ARG;
         goto err;
     }
 
@@ -3501,22 +3672,12 @@ static AMVP_RESULT amvp_dispatch_ie_set(AMVP_CTX *ctx, JSON_Object *obj) {
         groupval = json_array_get_value(groups, i);
         groupobj = json_value_get_object(groupval);
 
-        /*
-         * Create a new group in the response with the teid
-         * and an array of tests
-         */
-        r_gval = json_value_init_object();
-        r_gobj = json_value_get_object(r_gval);
-        
         teId = json_object_get_number(groupobj, "teId");
         if (!teId) {
             AMVP_LOG_ERR("Missing teId from server JSON groub obj");
             rv = AMVP_MALFORMED_JSON;
             goto err;
         }
-        json_object_set_number(r_gobj, "teId", teId);
-        json_object_set_value(r_gobj, "evidence", json_value_init_array());
-        r_tarr = json_object_get_array(r_gobj, "evidence");
 
         AMVP_LOG_VERBOSE("    Test group: %d", i);
 
@@ -3534,6 +3695,14 @@ static AMVP_RESULT amvp_dispatch_ie_set(AMVP_CTX *ctx, JSON_Object *obj) {
             goto err;
         }
 
+        /*
+         * Create a new group in the response with the teid
+         * and an array of evidence
+         */
+        amvp_jw_begin_object(w, NULL);
+        amvp_jw_number(w, "teId", teId);
+        amvp_jw_begin_array(w, "evidence");
+
         for (j = 0; j < t_cnt; j++) {
             AMVP_LOG_VERBOSE("Found new TE ...");
             evidence = json_array_get_string(tests, j);
@@ -3547,37 +3716,34 @@ static AMVP_RESULT amvp_dispatch_ie_set(AMVP_CTX *ctx, JSON_Object *obj) {
             AMVP_LOG_VERBOSE("        Test case: %d", j);
             AMVP_LOG_VERBOSE("         evidence: %s", evidence);
 
-            /*
-             * Create a new test case in the response
-             */
-            r_tval = json_value_init_object();
-            r_tobj = json_value_get_object(r_tval);
-
-            /* Determine if automated, if so gather the evidence information */
-            ev_str = amvp_locate_auto_entry(ctx, evidence);
-            if (!ev_str) {
+            /* Determine if automated, if so write the evidence out */
+            rv = amvp_evidence_write(ctx, evidence);
+            if (rv == AMVP_NO_DATA) {
                 AMVP_LOG_INFO("AMVP skipping TE that is not automated");
                 continue;
             }
-
-            json_object_set_string(r_tobj, evidence, ev_str);
-
-            /* Append the test response value to array */
-            json_array_append_value(r_tarr, r_tval);
+            if (rv != AMVP_SUCCESS) {
+                goto err;
+            }
         }
-        json_array_append_value(r_garr, r_gval);
+        amvp_jw_end_array(w);
+        amvp_jw_end_object(w);
     }
 
-    json_array_append_value(reg_arry, r_vs_val);
+    rv = amvp_jw_end_vs_rsp(ctx);
+    if (rv != AMVP_SUCCESS) {
+        AMVP_LOG_ERR("Failed to build the IE set response");
+        goto err;
+    }
 
-    json_result = json_serialize_to_string_pretty(ctx->kat_resp, &ieset_len);
-    AMVP_LOG_VERBOSE("\n\n%s\n\n", json_result);
-    json_free_serialized_string(json_result);
-    rv = AMVP_SUCCESS;
+    /* Evidence files can make the response large, only log it if it all stayed in memory */
+    if (AMVP_LOG_ENABLED(AMVP_LOG_LVL_VERBOSE) && !w->spilled) {
+        AMVP_LOG_VERBOSE("\n\n%s\n\n", w->buf);
+    }
 
 err:
     if (rv != AMVP_SUCCESS) {
-        amvp_release_json(r_vs_val, r_gval);
+        amvp_jw_reset(w);
     }
 
     return rv;
@@ -3636,40 +3802,116 @@ static AMVP_RESULT amvp_process_ie_set(AMVP_CTX *ctx, JSON_Object *obj) {
 }
 
 /*
- * This function will get the test results for a test session by checking the results of each vector set
+ * Picks how long to wait before polling the results again: the server's
+ * retry hint if it gave one, the base period again if more vector sets
+ * completed since the last poll, and double the last wait otherwise. Up
+ * to a quarter is added at random, so clients started together do not
+ * keep polling the server in step.
+ */
+static void amvp_results_poll_period(AMVP_CTX *ctx, AMVP_RESULTS_POLL *poll, int progress) {
+    unsigned int seed = 0;
+
+    if (poll->hint > 0) {
+        poll->period = poll->hint;
+    } else if (progress || !poll->waited) {
+        poll->period = AMVP_RETRY_TIME;
+    } else if ((poll->period *= 2) > AMVP_RETRY_TIME_MAX) {
+        poll->period = AMVP_RETRY_TIME_MAX;
+    }
+    /* amvp_retry_check() treats anything this short as unset */
+    if (poll->period <= AMVP_RETRY_TIME_MIN) {
+        poll->period = AMVP_RETRY_TIME_MIN + 1;
+    }
+    seed = (unsigned int)time(NULL) ^ (unsigned int)(size_t)ctx ^ poll->waited;
+    seed = seed * 1103515245u + 12345u;
+    poll->period += (int)((seed >> 16) % (unsigned int)(poll->period / 4 + 1));
+    if (poll->period > AMVP_RETRY_TIME_MAX) {
+        poll->period = AMVP_RETRY_TIME_MAX;
+    }
+}
+
+/*
+ * Waits before the results are polled again, see amvp_get_result_test_session().
+ * Returns AMVP_KAT_DOWNLOAD_RETRY to poll again. When polling for the caller
+ * (wait is 0) it does not wait, but leaves poll->period for the caller to wait.
+ */
+static AMVP_RESULT amvp_results_poll_wait(AMVP_CTX *ctx, AMVP_RESULTS_POLL *poll, int progress, int wait) {
+    amvp_results_poll_period(ctx, poll, progress);
+    if (!wait) {
+        if (amvp_retry_check(ctx, &poll->period, &poll->waited, AMVP_WAITING_FOR_RESULTS) != AMVP_SUCCESS) {
+            AMVP_LOG_STATUS("Maximum wait time with server reached! (Max: %d seconds)", AMVP_MAX_WAIT_TIME);
+            return AMVP_TRANSPORT_FAIL;
+        }
+        return AMVP_KAT_DOWNLOAD_RETRY;
+    }
+    if (amvp_retry_handler(ctx, &poll->period, &poll->waited, 1, AMVP_WAITING_FOR_RESULTS) != AMVP_KAT_DOWNLOAD_RETRY) {
+        AMVP_LOG_STATUS("Maximum wait time with server reached! (Max: %d seconds)", AMVP_MAX_WAIT_TIME);
+        return AMVP_TRANSPORT_FAIL;
+    }
+    return AMVP_KAT_DOWNLOAD_RETRY;
+}
+
+/*
+ * This function will get the test results for a test session by checking the results of each vector set.
+ * With poll NULL it waits until the results are complete. Otherwise the results are fetched only once:
+ * if they are incomplete, poll->period is set to how long to wait before the next attempt and
+ * AMVP_KAT_DOWNLOAD_RETRY is returned. The caller then applies amvp_retry_advance() to poll->period
+ * and calls again with the same poll.
+ *
+ * The results are polled with the validators of the last response, so a poll that
+ * finds nothing new costs the server a 304 rather than the full results. The wait
+ * between polls backs off while nothing changes, see amvp_results_poll_period().
  */
-static AMVP_RESULT amvp_get_result_test_session(AMVP_CTX *ctx, char *session_url) {
+static AMVP_RESULT amvp_get_result_test_session(AMVP_CTX *ctx, char *session_url, AMVP_RESULTS_POLL *poll) {
     AMVP_RESULT rv = AMVP_SUCCESS;
     JSON_Value *val = NULL;
     JSON_Value *val2 = NULL;
     JSON_Object *obj = NULL;
     JSON_Object *obj2 = NULL;
-    int count = 0, i = 0, passed = 0;
+    int count = 0, i = 0, passed = 0, wait = 0;
     JSON_Array *results = NULL;
     JSON_Object *current = NULL;
     const char *status = NULL, *alg = NULL, *mode = NULL;
-    unsigned int time_waited_so_far = 0;
-    int retry_interval = AMVP_RETRY_TIME;
+    AMVP_RESULTS_POLL blocking_poll;
     //Maintains a list of names of algorithms that have failed
     AMVP_STRING_LIST *failedAlgList = NULL;
     AMVP_STRING_LIST *failedModeList = NULL;
     /*
-     * Maintains a list of the vector set URLs we have already looked up,
+     * Maintains a set of the vector set URLs we have already looked up,
      * so we don't redownload failed vector sets every time a retry is done
      */
-     AMVP_STRING_LIST *failedVsList = NULL;
+    AMVP_STR_SET failedVsSet = { NULL, 0, 0 };
 
+    if (!poll) {
+        memzero_s(&blocking_poll, sizeof(blocking_poll));
+        blocking_poll.period = AMVP_RETRY_TIME;
+        poll = &blocking_poll;
+        wait = 1;
+    }
     while (1) {
         int testsCompleted = 0;
 
         /*
          * Get the KAT vector set
          */
+        ctx->http_if_none_match = poll->validators.etag[0] ? poll->validators.etag : NULL;
+        ctx->http_if_modified_since = poll->validators.last_modified[0] ? poll->validators.last_modified : NULL;
         rv = amvp_retrieve_vector_set_result(ctx, session_url);
+        ctx->http_if_none_match = NULL;
+        ctx->http_if_modified_since = NULL;
         if (rv != AMVP_SUCCESS) {
             AMVP_LOG_ERR("Error retrieving vector set results!");
             goto end;
         }
+        if (ctx->http_not_modified) {
+            AMVP_LOG_STATUS("TestSession results unchanged...");
+            rv = amvp_results_poll_wait(ctx, poll, 0, wait);
+            if (!wait || rv != AMVP_KAT_DOWNLOAD_RETRY) {
+                goto end;
+            }
+            continue;
+        }
+        poll->validators = ctx->http_validators;
 
         val = json_parse_string(ctx->curl_buf);
         if (!val) {
@@ -3688,6 +3930,7 @@ static AMVP_RESULT amvp_get_result_test_session(AMVP_CTX *ctx, char *session_url
          * Check the results for each vector set - flag if some are incomplete,
          * or name failed algorithms (even if others are still incomplete)
          */
+        poll->hint = (int)json_object_get_number(obj, "retry");
         results = json_object_get_array(obj, "results");
         count = (int)json_array_get_count(results);
         for (i = 0; i < count; i++) {
@@ -3725,10 +3968,9 @@ static AMVP_RESULT amvp_get_result_test_session(AMVP_CTX *ctx, char *session_url
                     AMVP_LOG_ERR("No vector set URL when generating failed algorithm list");
                     break;
                 }
-                if (!amvp_lookup_str_list(&failedVsList, vsurl)) {
-                    //append the vsurl to the list so we dont download/check same one twice
-                    rv = amvp_append_str_list(&failedVsList, vsurl);
-                    if (rv != AMVP_SUCCESS) {
+                if (!amvp_str_set_has(&failedVsSet, vsurl)) {
+                    //add the vsurl to the set so we dont download/check same one twice
+                    if (amvp_str_set_add(&failedVsSet, vsurl) < 0) {
                         AMVP_LOG_ERR("Error appending failed algorithm name to list, skipping...");
                         continue;
                     }
@@ -3816,9 +4058,9 @@ static AMVP_RESULT amvp_get_result_test_session(AMVP_CTX *ctx, char *session_url
              */
             amvp_list_failing_algorithms(ctx, &failedAlgList, &failedModeList);
             AMVP_LOG_STATUS("TestSession results incomplete...");
-            if (amvp_retry_handler(ctx, &retry_interval, &time_waited_so_far, 1, AMVP_WAITING_FOR_RESULTS) != AMVP_KAT_DOWNLOAD_RETRY) {
-                AMVP_LOG_STATUS("Maximum wait time with server reached! (Max: %d seconds)", AMVP_MAX_WAIT_TIME);
-                rv = AMVP_TRANSPORT_FAIL;
+            rv = amvp_results_poll_wait(ctx, poll, testsCompleted > poll->completed, wait);
+            poll->completed = testsCompleted;
+            if (!wait || rv != AMVP_KAT_DOWNLOAD_RETRY) {
                 goto end;
             }
 
@@ -3861,9 +4103,7 @@ end:
     if (failedModeList) {
         amvp_free_str_list(&failedModeList);
     }
-    if (failedVsList) {
-        amvp_free_str_list(&failedVsList);
-    }
+    amvp_str_set_free(&failedVsSet);
     return rv;
 }
 
@@ -3953,14 +4193,14 @@ AMVP_RESULT amvp_post_data(AMVP_CTX *ctx, char *filename) {
     }
 
     raw_val = json_array_get_value(data_array, 1);
-    json_result = json_serialize_to_string_pretty(raw_val, NULL);
+    json_result = json_serialize_to_string(raw_val, NULL);
     post_val = json_parse_string(json_result);
     json_free_serialized_string(json_result);
 
     rv = amvp_create_array(&reg_obj, &reg_arry_val, &reg_arry);
     json_array_append_value(reg_arry, post_val);
 
-    json_result = json_serialize_to_string_pretty(reg_arry_val, &len);
+    json_result = amvp_json_serialize(ctx, reg_arry_val, &len);
     AMVP_LOG_STATUS("\nPOST Data: %s, %s\n\n", path, json_result);
     json_value_free(reg_arry_val);
 
@@ -4016,7 +4256,7 @@ AMVP_RESULT amvp_post_resources(AMVP_CTX *ctx, const char *resource_file) {
     }
 
     raw_val = json_array_get_value(vendor_array, 0);
-    json_result = json_serialize_to_string_pretty(raw_val, &len);
+    json_result = amvp_json_serialize(ctx, raw_val, &len);
     post_val = json_parse_string(json_result);
 
 
@@ -4035,7 +4275,7 @@ AMVP_RESULT amvp_post_resources(AMVP_CTX *ctx, const char *resource_file) {
     }
 
     raw_val = json_array_get_value(vendor_array, 0);
-    json_result = json_serialize_to_string_pretty(raw_val, &len);
+    json_result = amvp_json_serialize(ctx, raw_val, &len);
     post_val = json_parse_string(json_result);
 
     AMVP_LOG_INFO("\nPOST Data: %s, %s\n\n", "/amv/v1/vendors", json_result);
@@ -4053,7 +4293,7 @@ AMVP_RESULT amvp_post_resources(AMVP_CTX *ctx, const char *resource_file) {
     }
 
     raw_val = json_array_get_value(vendor_array, 0);
-    json_result = json_serialize_to_string_pretty(raw_val, &len);
+    json_result = amvp_json_serialize(ctx, raw_val, &len);
     post_val = json_parse_string(json_result);
 
 
@@ -4159,13 +4399,13 @@ static AMVP_RESULT amvp_write_session_info(AMVP_CTX *ctx) {
         rv = AMVP_UNSUPPORTED_OP;
         goto end;
     }
-    rv = amvp_json_serialize_to_file_pretty_w(ts_val, filename);
+    rv = amvp_json_serialize_to_file_w(ctx, ts_val, filename);
     if (rv != AMVP_SUCCESS) {
         AMVP_LOG_ERR("File write error. Check that directory exists and allows writes.");
         goto end;
     }
 
-    rv = amvp_json_serialize_to_file_pretty_a(NULL, filename);
+    rv = amvp_json_serialize_to_file_a(ctx, NULL, filename);
     if (rv != AMVP_SUCCESS) {
         AMVP_LOG_ERR("File write error. Check that directory exists and allows writes.");
         goto end;
@@ -4278,11 +4518,11 @@ AMVP_RESULT amvp_run(AMVP_CTX *ctx, int fips_validation) {
             if (!val) {
                 AMVP_LOG_ERR("Unable to parse JSON. printing output instead...");
             } else {
-                rv = amvp_json_serialize_to_file_pretty_w(val, ctx->save_filename);
+                rv = amvp_json_serialize_to_file_w(ctx, val, ctx->save_filename);
                 if (rv != AMVP_SUCCESS) {
                     AMVP_LOG_ERR("Failed to write file, printing instead...");
                 } else {
-                    rv = amvp_json_serialize_to_file_pretty_a(NULL, ctx->save_filename);
+                    rv = amvp_json_serialize_to_file_a(ctx, NULL, ctx->save_filename);
                     if (rv != AMVP_SUCCESS)
                         AMVP_LOG_WARN("Unable to append ending ] to write file");
                     goto end;
@@ -4320,11 +4560,11 @@ AMVP_RESULT amvp_run(AMVP_CTX *ctx, int fips_validation) {
             if (!val) {
                 AMVP_LOG_ERR("Unable to parse JSON. printing output instead...");
             } else {
-                rv = amvp_json_serialize_to_file_pretty_w(val, ctx->save_filename);
+                rv = amvp_json_serialize_to_file_w(ctx, val, ctx->save_filename);
                 if (rv != AMVP_SUCCESS) {
                     AMVP_LOG_ERR("Failed to write file, printing instead...");
                 } else {
-                    rv = amvp_json_serialize_to_file_pretty_a(NULL, ctx->save_filename);
+                    rv = amvp_json_serialize_to_file_a(ctx, NULL, ctx->save_filename);
                     if (rv != AMVP_SUCCESS)
                         AMVP_LOG_WARN("Unable to append ending ] to write file");
                     goto end;
@@ -4365,6 +4605,9 @@ AMVP_RESULT amvp_run(AMVP_CTX *ctx, int fips_validation) {
     if (!ctx->put) {
         if (amvp_write_session_info(ctx) != AMVP_SUCCESS) {
             AMVP_LOG_ERR("Error writing the session info file. Continuing, but session will not be able to be resumed or checked later on");
+        } else if (ctx->checkpoint_enable && !ctx->vector_req &&
+                   amvp_checkpoint_open(ctx, ctx->session_file_path) != AMVP_SUCCESS) {
+            AMVP_LOG_WARN("Unable to start the checkpoint journal, continuing without checkpoints");
         }
     }
 
@@ -4382,7 +4625,8 @@ AMVP_RESULT amvp_run(AMVP_CTX *ctx, int fips_validation) {
 check:
     if (ctx->vector_req) {
         AMVP_LOG_STATUS("Successfully downloaded evidence and saved to specified file.");
-        return AMVP_SUCCESS;
+        rv = AMVP_SUCCESS;
+        goto end;
     }
 
     /*
@@ -4414,10 +4658,254 @@ check:
        rv = amvp_put_data_from_ctx(ctx);
    }
 end:
+    amvp_metrics_emit(ctx);
     if (val) json_value_free(val);
     return rv;
 }
 
+/*
+ * Releases the state of a session started with amvp_run_async()
+ */
+static void amvp_async_free(AMVP_CTX *ctx) {
+    if (!ctx->async) {
+        return;
+    }
+    if (ctx->async->vs_multi) amvp_vs_multi_free(ctx->async->vs_multi, NULL);
+    if (ctx->async->failed) amvp_free_str_list(&ctx->async->failed);
+    free(ctx->async);
+    ctx->async = NULL;
+}
+
+AMVP_RESULT amvp_run_async(AMVP_CTX *ctx, int fips_validation) {
+    if (ctx == NULL) return AMVP_NO_CTX;
+
+    if (ctx->async && ctx->async->state != AMVP_ASYNC_DONE) {
+        AMVP_LOG_ERR("A session is already running on this context");
+        return AMVP_UNSUPPORTED_OP;
+    }
+    amvp_async_free(ctx);
+
+    ctx->async = calloc(1, sizeof(AMVP_ASYNC));
+    if (!ctx->async) {
+        return AMVP_MALLOC_FAIL;
+    }
+    ctx->async->fips_validation = fips_validation;
+    ctx->async->results.period = AMVP_RETRY_TIME;
+    ctx->async->state = AMVP_ASYNC_LOGIN;
+    return AMVP_SUCCESS;
+}
+
+/*
+ * Moves the session on by one phase, or in AMVP_ASYNC_VECTOR_SETS by
+ * whatever the transfers have ready. Returns AMVP_SUCCESS while more
+ * steps are needed.
+ */
+static AMVP_RESULT amvp_async_advance(AMVP_CTX *ctx, AMVP_ASYNC *as) {
+    AMVP_RESULT rv = AMVP_SUCCESS;
+    int remaining = 0;
+
+    switch (as->state) {
+    case AMVP_ASYNC_LOGIN:
+        /* One-off requests (GET, POST, DELETE...) have no phases worth stepping through */
+        if (ctx->get || ctx->post || ctx->post_resources || ctx->mod_cert_req || ctx->delete) {
+            as->result = amvp_run(ctx, as->fips_validation);
+            as->state = AMVP_ASYNC_DONE;
+            return as->result;
+        }
+        if (!getenv("AMVP_NO_LOGIN")) {
+            rv = amvp_login(ctx, 0);
+            if (rv != AMVP_SUCCESS) {
+                AMVP_LOG_ERR("Failed to login with AMVP server");
+                return rv;
+            }
+        }
+        as->state = AMVP_ASYNC_REGISTER;
+        return AMVP_SUCCESS;
+
+    case AMVP_ASYNC_REGISTER:
+        if (as->fips_validation) {
+            rv = amvp_verify_fips_validation_metadata(ctx);
+            if (AMVP_SUCCESS != rv) {
+                AMVP_LOG_ERR("Issue(s) with validation metadata, not continuing with session.");
+                return AMVP_UNSUPPORTED_OP;
+            }
+        }
+        ctx->fips.do_validation = as->fips_validation ? 1 : 0;
+
+        rv = amvp_register(ctx);
+        if (rv != AMVP_SUCCESS) {
+            AMVP_LOG_ERR("Failed to register with AMVP server");
+            return rv;
+        }
+        if (!ctx->put) {
+            if (amvp_write_session_info(ctx) != AMVP_SUCCESS) {
+                AMVP_LOG_ERR("Error writing the session info file. Continuing, but session will not be able to be resumed or checked later on");
+            } else if (ctx->checkpoint_enable && !ctx->vector_req &&
+                       amvp_checkpoint_open(ctx, ctx->session_file_path) != AMVP_SUCCESS) {
+                AMVP_LOG_WARN("Unable to start the checkpoint journal, continuing without checkpoints");
+            }
+        }
+
+        AMVP_LOG_STATUS("Beginning to download and process vector sets...");
+        if (ctx->vector_req) {
+            /* Saved requests have to be written in order, so this one blocks */
+            rv = amvp_process_tests(ctx);
+            if (rv != AMVP_SUCCESS) {
+                AMVP_LOG_ERR("Failed to process vectors");
+                return rv;
+            }
+            AMVP_LOG_STATUS("Successfully downloaded evidence and saved to specified file.");
+            as->state = AMVP_ASYNC_DONE;
+            return AMVP_SUCCESS;
+        }
+        rv = amvp_vs_multi_init(ctx, amvp_process_vs_body, &as->vs_multi);
+        if (rv == AMVP_UNSUPPORTED_OP) {
+            /* No multi interface in this build, fall back to the blocking path */
+            rv = amvp_process_tests(ctx);
+            if (rv != AMVP_SUCCESS) {
+                AMVP_LOG_ERR("Failed to process vectors");
+                return rv;
+            }
+            as->state = AMVP_ASYNC_RESULTS;
+            return AMVP_SUCCESS;
+        }
+        if (rv != AMVP_SUCCESS) {
+            AMVP_LOG_ERR("Unable to start vector set transfers! Error: %d", rv);
+            return rv;
+        }
+        as->state = AMVP_ASYNC_VECTOR_SETS;
+        return AMVP_SUCCESS;
+
+    case AMVP_ASYNC_VECTOR_SETS:
+        rv = amvp_vs_multi_step(ctx, as->vs_multi, &remaining);
+        if (rv != AMVP_SUCCESS) {
+            AMVP_LOG_ERR("Unable to process vector sets concurrently! Error: %d", rv);
+            return rv;
+        }
+        if (remaining) {
+            return AMVP_SUCCESS;
+        }
+        amvp_vs_multi_free(as->vs_multi, &as->failed);
+        as->vs_multi = NULL;
+        as->state = as->failed ? AMVP_ASYNC_VECTOR_RETRY : AMVP_ASYNC_RESULTS;
+        return AMVP_SUCCESS;
+
+    case AMVP_ASYNC_VECTOR_RETRY:
+        /* Rare, and needs the serial path's JWT refresh and error handling */
+        rv = amvp_process_vsid_list(ctx, as->failed, 0);
+        if (rv != AMVP_SUCCESS) {
+            AMVP_LOG_ERR("Unable to process vector set! Error: %d", rv);
+            return rv;
+        }
+        amvp_free_str_list(&as->failed);
+        as->state = AMVP_ASYNC_RESULTS;
+        return AMVP_SUCCESS;
+
+    case AMVP_ASYNC_RESULTS:
+        if (!as->results.waited) {
+            AMVP_LOG_STATUS("Tests complete, checking results...");
+        }
+        rv = amvp_get_result_test_session(ctx, ctx->session_url, &as->results);
+        if (rv == AMVP_KAT_DOWNLOAD_RETRY) {
+            as->wake_at = time(NULL) + as->results.period;
+            amvp_retry_advance(ctx, &as->results.period, &as->results.waited, 1);
+            return AMVP_SUCCESS;
+        }
+        if (rv != AMVP_SUCCESS) {
+            AMVP_LOG_ERR("Unable to retrieve test results");
+            return rv;
+        }
+        as->state = AMVP_ASYNC_FINISH;
+        return AMVP_SUCCESS;
+
+    case AMVP_ASYNC_FINISH:
+        if (as->fips_validation) {
+            rv = amvp_validate_test_session(ctx);
+            if (rv != AMVP_SUCCESS) {
+                AMVP_LOG_ERR("Failed to perform Validation of testSession");
+                return rv;
+            }
+        }
+        if (ctx->put) {
+            rv = amvp_put_data_from_ctx(ctx);
+            if (rv != AMVP_SUCCESS) return rv;
+        }
+        as->state = AMVP_ASYNC_DONE;
+        return AMVP_SUCCESS;
+
+    case AMVP_ASYNC_DONE:
+    default:
+        return AMVP_SUCCESS;
+    }
+}
+
+AMVP_RESULT amvp_step(AMVP_CTX *ctx, int *done) {
+    AMVP_ASYNC *as = NULL;
+    AMVP_RESULT rv = AMVP_SUCCESS;
+
+    if (ctx == NULL) return AMVP_NO_CTX;
+    if (!done) return AMVP_INVALID_ARG;
+    *done = 0;
+
+    as = ctx->async;
+    if (!as) {
+        AMVP_LOG_ERR("No session started, call amvp_run_async() first");
+        return AMVP_UNSUPPORTED_OP;
+    }
+
+    if (as->state != AMVP_ASYNC_DONE && (!as->wake_at || time(NULL) >= as->wake_at)) {
+        as->wake_at = 0;
+        rv = amvp_async_advance(ctx, as);
+        if (rv != AMVP_SUCCESS) {
+            as->result = rv;
+            as->state = AMVP_ASYNC_DONE;
+        }
+    }
+
+    if (as->state == AMVP_ASYNC_DONE) {
+        *done = 1;
+        rv = as->result;
+        amvp_async_free(ctx);
+        amvp_metrics_emit(ctx);
+        return rv;
+    }
+    return AMVP_SUCCESS;
+}
+
+AMVP_RESULT amvp_async_fdset(AMVP_CTX *ctx, fd_set *read_fds, fd_set *write_fds,
+                             fd_set *exc_fds, int *max_fd) {
+    if (ctx == NULL) return AMVP_NO_CTX;
+    if (!read_fds || !write_fds || !exc_fds || !max_fd) return AMVP_INVALID_ARG;
+
+    if (!ctx->async || !ctx->async->vs_multi) {
+        return AMVP_SUCCESS;
+    }
+    return amvp_vs_multi_fdset(ctx->async->vs_multi, read_fds, write_fds, exc_fds, max_fd);
+}
+
+AMVP_RESULT amvp_async_timeout(AMVP_CTX *ctx, long *timeout_ms) {
+    AMVP_ASYNC *as = NULL;
+    time_t now = 0;
+
+    if (ctx == NULL) return AMVP_NO_CTX;
+    if (!timeout_ms) return AMVP_INVALID_ARG;
+
+    as = ctx->async;
+    if (!as) {
+        *timeout_ms = -1;
+        return AMVP_SUCCESS;
+    }
+    now = time(NULL);
+    if (as->wake_at > now) {
+        *timeout_ms = (long)(as->wake_at - now) * 1000;
+    } else if (as->state == AMVP_ASYNC_VECTOR_SETS && as->vs_multi) {
+        *timeout_ms = amvp_vs_multi_timeout(as->vs_multi);
+    } else {
+        *timeout_ms = 0;
+    }
+    return AMVP_SUCCESS;
+}
+
 const char *amvp_version(void) {
     return AMVP_LIBRARY_VERSION;
 }
@@ -4487,6 +4975,7 @@ AMVP_RESULT amvp_put_data_from_file(AMVP_CTX *ctx, const char *put_filename) {
             goto end;
         }
         strcpy_s(ctx->jwt_token, AMVP_JWT_TOKEN_MAX + 1, jwt);
+        amvp_jwt_track(ctx);
     } else {
         rv = amvp_login(ctx, 0);
         if (rv != AMVP_SUCCESS) {
@@ -4518,7 +5007,7 @@ AMVP_RESULT amvp_put_data_from_file(AMVP_CTX *ctx, const char *put_filename) {
         goto end;
     }
     json_array_append_value(reg_arry, put_val);
-    json_result = json_serialize_to_string_pretty(reg_arry_val, &len);
+    json_result = amvp_json_serialize(ctx, reg_arry_val, &len);
 
     rv = amvp_transport_put(ctx, test_session_url, json_result, len);
     if (rv != AMVP_SUCCESS) {
@@ -4593,7 +5082,7 @@ static AMVP_RESULT amvp_put_data_from_ctx(AMVP_CTX *ctx) {
         goto end;
     }
     json_array_append_value(reg_arry, put_val);
-    json_result = json_serialize_to_string_pretty(reg_arry_val, &len);
+    json_result = amvp_json_serialize(ctx, reg_arry_val, &len);
 
     rv = amvp_transport_put(ctx, ctx->session_url, json_result, len);
     if (rv != AMVP_SUCCESS) {
@@ -28,13 +28,13 @@ static AMVP_RESULT amvp_aes_init_tc(AMVP_CTX *ctx,
                                     AMVP_SYM_CIPHER_TC *stc,
                                     unsigned int tc_id,
                                     AMVP_SYM_CIPH_TESTTYPE test_type,
-                                    const char *j_key,
-                                    const char *j_pt,
-                                    const char *j_ct,
-                                    const char *j_iv,
-                                    const char *j_tag,
-                                    const char *j_aad,
-                                    const char *j_salt,
+                                    AMVP_STR_VIEW j_key,
+                                    AMVP_STR_VIEW j_pt,
+                                    AMVP_STR_VIEW j_ct,
+                                    AMVP_STR_VIEW j_iv,
+                                    AMVP_STR_VIEW j_tag,
+                                    AMVP_STR_VIEW j_aad,
+                                    AMVP_STR_VIEW j_salt,
                                     AMVP_SYM_KW_MODE kwcipher,
                                     unsigned int key_len,
                                     unsigned int iv_len,
@@ -63,10 +63,17 @@ static AMVP_RESULT amvp_aes_release_tc(AMVP_SYM_CIPHER_TC *stc);
 #define IV_ROW_LEN 16
 #define TEXT_COL_LEN 1001
 #define TEXT_ROW_LEN 32
-static unsigned char mkey[KEY_COL_LEN][KEY_ROW_LEN];
-static unsigned char miv[IV_COL_LEN][IV_ROW_LEN];
-static unsigned char ptext[TEXT_COL_LEN][TEXT_ROW_LEN];
-static unsigned char ctext[TEXT_COL_LEN][TEXT_ROW_LEN];
+
+/*
+ * Intermediate values of one AES Monte Carlo test. Allocated for each
+ * MCT test case so that several MCTs can run at the same time.
+ */
+typedef struct amvp_aes_mct_state_t {
+    unsigned char mkey[KEY_COL_LEN][KEY_ROW_LEN];
+    unsigned char miv[IV_COL_LEN][IV_ROW_LEN];
+    unsigned char ptext[TEXT_COL_LEN][TEXT_ROW_LEN];
+    unsigned char ctext[TEXT_COL_LEN][TEXT_ROW_LEN];
+} AMVP_AES_MCT_STATE;
 
 #define gb(a, b) (((a)[(b) / 8] >> (7 - (b) % 8)) & 1)
 #define sb(a, b, v) ((a)[(b) / 8] = ((a)[(b) / 8] & ~(1 << (7 - (b) % 8))) | (!!(v) << (7 - (b) % 8)))
@@ -76,19 +83,22 @@ static unsigned char ctext[TEXT_COL_LEN][TEXT_ROW_LEN];
  * and/or pt/ct information may need to be modified.  This function
  * performs the iteration depdedent upon the cipher type and direction.
  */
-static AMVP_RESULT amvp_aes_mct_iterate_tc(AMVP_CTX *ctx, AMVP_SYM_CIPHER_TC *stc, int i) {
+static AMVP_RESULT amvp_aes_mct_iterate_tc(AMVP_CTX *ctx,
+                                           AMVP_SYM_CIPHER_TC *stc,
+                                           AMVP_AES_MCT_STATE *mct,
+                                           int i) {
     int j = stc->mct_index;
     AMVP_SUB_AES alg;
 
     if (stc->cipher != AMVP_AES_CFB1) {
-        memcpy_s(ctext[j], TEXT_ROW_LEN, stc->ct, stc->ct_len);
-        memcpy_s(ptext[j], TEXT_ROW_LEN, stc->pt, stc->pt_len);
+        memcpy_s(mct->ctext[j], TEXT_ROW_LEN, stc->ct, stc->ct_len);
+        memcpy_s(mct->ptext[j], TEXT_ROW_LEN, stc->pt, stc->pt_len);
     } else {
-        ctext[j][0] = stc->ct[0];
-        ptext[j][0] = stc->pt[0];
+        mct->ctext[j][0] = stc->ct[0];
+        mct->ptext[j][0] = stc->pt[0];
     }
     if (j == 0) {
-        memcpy_s(mkey[j], KEY_ROW_LEN, stc->key, stc->key_len / 8);
+        memcpy_s(mct->mkey[j], KEY_ROW_LEN, stc->key, stc->key_len / 8);
     }
 
     alg = amvp_get_aes_alg(stc->cipher);
@@ -100,9 +110,9 @@ static AMVP_RESULT amvp_aes_mct_iterate_tc(AMVP_CTX *ctx, AMVP_SYM_CIPHER_TC *st
     switch (alg) {
     case AMVP_SUB_AES_ECB:
         if (stc->direction == AMVP_SYM_CIPH_DIR_ENCRYPT) {
-            memcpy_s(stc->pt, AMVP_SYM_PT_BYTE_MAX, ctext[j], stc->ct_len);
+            memcpy_s(stc->pt, AMVP_SYM_PT_BYTE_MAX, mct->ctext[j], stc->ct_len);
         } else {
-            memcpy_s(stc->ct, AMVP_SYM_CT_BYTE_MAX, ptext[j], stc->pt_len);
+            memcpy_s(stc->ct, AMVP_SYM_CT_BYTE_MAX, mct->ptext[j], stc->pt_len);
         }
         break;
     case AMVP_SUB_AES_CBC:
@@ -116,11 +126,11 @@ static AMVP_RESULT amvp_aes_mct_iterate_tc(AMVP_CTX *ctx, AMVP_SYM_CIPHER_TC *st
             }
         } else {
             if (stc->direction == AMVP_SYM_CIPH_DIR_ENCRYPT) {
-                memcpy_s(stc->pt, AMVP_SYM_PT_BYTE_MAX, ctext[j - 1], stc->ct_len);
-                memcpy_s(stc->iv, AMVP_SYM_IV_BYTE_MAX, ctext[j], stc->ct_len);
+                memcpy_s(stc->pt, AMVP_SYM_PT_BYTE_MAX, mct->ctext[j - 1], stc->ct_len);
+                memcpy_s(stc->iv, AMVP_SYM_IV_BYTE_MAX, mct->ctext[j], stc->ct_len);
             } else {
-                memcpy_s(stc->ct, AMVP_SYM_CT_BYTE_MAX, ptext[j - 1], stc->pt_len);
-                memcpy_s(stc->iv, AMVP_SYM_IV_BYTE_MAX, ptext[j], stc->pt_len);
+                memcpy_s(stc->ct, AMVP_SYM_CT_BYTE_MAX, mct->ptext[j - 1], stc->pt_len);
+                memcpy_s(stc->iv, AMVP_SYM_IV_BYTE_MAX, mct->ptext[j], stc->pt_len);
             }
         }
         break;
@@ -129,31 +139,31 @@ static AMVP_RESULT amvp_aes_mct_iterate_tc(AMVP_CTX *ctx, AMVP_SYM_CIPHER_TC *st
             if (j < 16) {
                 memcpy_s(stc->pt, AMVP_SYM_PT_BYTE_MAX, &stc->iv[j], stc->iv_len);
             } else {
-                memcpy_s(stc->pt, AMVP_SYM_PT_BYTE_MAX, ctext[j - 16], stc->ct_len);
+                memcpy_s(stc->pt, AMVP_SYM_PT_BYTE_MAX, mct->ctext[j - 16], stc->ct_len);
             }
         } else {
             if (j < 16) {
                 memcpy_s(stc->ct, AMVP_SYM_CT_BYTE_MAX, &stc->iv[j], stc->iv_len);
             } else {
-                memcpy_s(stc->ct, AMVP_SYM_CT_BYTE_MAX, ptext[j - 16], stc->pt_len);
+                memcpy_s(stc->ct, AMVP_SYM_CT_BYTE_MAX, mct->ptext[j - 16], stc->pt_len);
             }
         }
         break;
     case AMVP_SUB_AES_CFB1:
         if (stc->direction == AMVP_SYM_CIPH_DIR_ENCRYPT) {
             if (j < 128) {
-                sb(ptext[j + 1], 0, gb(miv[i], j));
+                sb(mct->ptext[j + 1], 0, gb(mct->miv[i], j));
             } else {
-                sb(ptext[j + 1], 0, gb(ctext[j - 128], 0));
+                sb(mct->ptext[j + 1], 0, gb(mct->ctext[j - 128], 0));
             }
-            stc->pt[0] = ptext[j + 1][0];
+            stc->pt[0] = mct->ptext[j + 1][0];
         } else {
             if (j < 128) {
-                sb(ctext[j + 1], 0, gb(miv[i], j));
+                sb(mct->ctext[j + 1], 0, gb(mct->miv[i], j));
             } else {
-                sb(ctext[j + 1], 0, gb(ptext[j - 128], 0));
+                sb(mct->ctext[j + 1], 0, gb(mct->ptext[j - 128], 0));
             }
-            stc->ct[0] = ctext[j + 1][0];
+            stc->ct[0] = mct->ctext[j + 1][0];
         }
         break;
     case AMVP_SUB_AES_CBC_CS1:
@@ -183,69 +193,33 @@ static AMVP_RESULT amvp_aes_mct_iterate_tc(AMVP_CTX *ctx, AMVP_SYM_CIPHER_TC *st
  */
 static AMVP_RESULT amvp_aes_output_mct_tc(AMVP_CTX *ctx, AMVP_SYM_CIPHER_TC *stc, JSON_Object *r_tobj) {
     AMVP_RESULT rv = AMVP_SUCCESS;
-    char *tmp = NULL;
-
-    tmp = calloc(AMVP_SYM_CT_MAX + 1, sizeof(char));
-    if (!tmp) {
-        AMVP_LOG_ERR("Unable to malloc in amvp_aes_output_mct_tc");
-        return AMVP_MALLOC_FAIL;
-    }
 
-    rv = amvp_bin_to_hexstr(stc->key, stc->key_len / 8, tmp, AMVP_SYM_CT_MAX);
+    rv = amvp_json_set_hex(r_tobj, "key", stc->key, stc->key_len / 8);
     if (rv != AMVP_SUCCESS) {
         AMVP_LOG_ERR("hex conversion failure (key)");
-        goto end;
+        return rv;
     }
-    json_object_set_string(r_tobj, "key", tmp);
 
     if (stc->cipher != AMVP_AES_ECB) {
-        memzero_s(tmp, AMVP_SYM_CT_MAX);
-        rv = amvp_bin_to_hexstr(stc->iv, stc->iv_len, tmp, AMVP_SYM_CT_MAX);
+        rv = amvp_json_set_hex(r_tobj, "iv", stc->iv, stc->iv_len);
         if (rv != AMVP_SUCCESS) {
             AMVP_LOG_ERR("hex conversion failure (iv)");
-            goto end;
+            return rv;
         }
-        json_object_set_string(r_tobj, "iv", tmp);
     }
 
     if (stc->direction == AMVP_SYM_CIPH_DIR_ENCRYPT) {
-        memzero_s(tmp, AMVP_SYM_CT_MAX);
-
-        if (stc->cipher == AMVP_AES_CFB1) {
-            rv = amvp_bin_to_hexstr(stc->pt, 1, tmp, AMVP_SYM_PT_MAX);
-            if (rv != AMVP_SUCCESS) {
-                AMVP_LOG_ERR("hex conversion failure (pt)");
-                goto end;
-            }
-        } else {
-            rv = amvp_bin_to_hexstr(stc->pt, stc->pt_len, tmp, AMVP_SYM_PT_MAX);
-            if (rv != AMVP_SUCCESS) {
-                AMVP_LOG_ERR("hex conversion failure (pt)");
-                goto end;
-            }
+        rv = amvp_json_set_hex(r_tobj, "pt", stc->pt, stc->cipher == AMVP_AES_CFB1 ? 1 : stc->pt_len);
+        if (rv != AMVP_SUCCESS) {
+            AMVP_LOG_ERR("hex conversion failure (pt)");
         }
-        json_object_set_string(r_tobj, "pt", tmp);
     } else {
-        memzero_s(tmp, AMVP_SYM_CT_MAX);
-        if (stc->cipher == AMVP_AES_CFB1) {
-            rv = amvp_bin_to_hexstr(stc->ct, 1, tmp, AMVP_SYM_CT_MAX);
-            if (rv != AMVP_SUCCESS) {
-                AMVP_LOG_ERR("hex conversion failure (ct)");
-                goto end;
-            }
-        } else {
-            rv = amvp_bin_to_hexstr(stc->ct, stc->ct_len, tmp, AMVP_SYM_CT_MAX);
-            if (rv != AMVP_SUCCESS) {
-                AMVP_LOG_ERR("hex conversion failure (ct)");
-                goto end;
-            }
+        rv = amvp_json_set_hex(r_tobj, "ct", stc->ct, stc->cipher == AMVP_AES_CFB1 ? 1 : stc->ct_len);
+        if (rv != AMVP_SUCCESS) {
+            AMVP_LOG_ERR("hex conversion failure (ct)");
         }
-        json_object_set_string(r_tobj, "ct", tmp);
     }
 
-end:
-    if (tmp) free(tmp);
-
     return rv;
 }
 
@@ -264,18 +238,28 @@ static AMVP_RESULT amvp_aes_mct_tc(AMVP_CTX *ctx,
     AMVP_RESULT rv;
     JSON_Value *r_tval = NULL;  /* Response testval */
     JSON_Object *r_tobj = NULL; /* Response testobj */
-    char *tmp = NULL;
+    AMVP_AES_MCT_STATE *mct = NULL;
 #define MCT_CT_LEN 68 /* 64 + 4 */
     unsigned char ciphertext[MCT_CT_LEN] = { 0 };
 
-    tmp = calloc(AMVP_SYM_CT_MAX + 1, sizeof(char));
-    if (!tmp) {
+    mct = calloc(1, sizeof(AMVP_AES_MCT_STATE));
+    if (!mct) {
         AMVP_LOG_ERR("Unable to malloc in amvp_aes_mct_tc");
         return AMVP_MALLOC_FAIL;
     }
 
-    memcpy_s(miv[0], IV_ROW_LEN, stc->iv, stc->iv_len);
+    if (cap->crypto_mct_handler) {
+        stc->mct_out = calloc(AMVP_AES_MCT_INNER, AMVP_SYM_MCT_OUT_STRIDE);
+        if (!stc->mct_out) {
+            AMVP_LOG_ERR("Unable to malloc in amvp_aes_mct_tc");
+            rv = AMVP_MALLOC_FAIL;
+            goto end;
+        }
+    }
+
+    memcpy_s(mct->miv[0], IV_ROW_LEN, stc->iv, stc->iv_len);
     for (i = 0; i < AMVP_AES_MCT_OUTER; ++i) {
+        AMVP_TRACE2(mct__iter, stc->cipher, i);
         /*
          * Create a new test case in the response
          */
@@ -289,85 +273,95 @@ static AMVP_RESULT amvp_aes_mct_tc(AMVP_CTX *ctx,
         if (rv != AMVP_SUCCESS) {
             AMVP_LOG_ERR("JSON output failure in AES module");
             json_value_free(r_tval);
-            free(tmp);
-            return rv;
+            goto end;
+        }
+
+        if (stc->mct_out) {
+            /* The module runs the inner loop at once */
+            stc->mct_index = 0;
+            if (amvp_sym_mct_call(ctx, cap, tc)) {
+                AMVP_LOG_ERR("crypto module failed the operation");
+                json_value_free(r_tval);
+                rv = AMVP_CRYPTO_MODULE_FAIL;
+                goto end;
+            }
         }
 
         for (j = 0; j < AMVP_AES_MCT_INNER; ++j) {
             stc->mct_index = j;    /* indicates init vs. update */
-            /* Process the current AES encrypt test vector... */
-            if ((cap->crypto_handler)(tc)) {
+            if (stc->mct_out) {
+                /* Replay the module's outputs through the chaining */
+                unsigned char *out = stc->mct_out + j * AMVP_SYM_MCT_OUT_STRIDE;
+
+                if (stc->direction == AMVP_SYM_CIPH_DIR_ENCRYPT) {
+                    memcpy_s(stc->ct, AMVP_SYM_CT_BYTE_MAX, out,
+                             stc->cipher == AMVP_AES_CFB1 ? 1 : stc->ct_len);
+                } else {
+                    memcpy_s(stc->pt, AMVP_SYM_PT_BYTE_MAX, out,
+                             stc->cipher == AMVP_AES_CFB1 ? 1 : stc->pt_len);
+                }
+            } else if (amvp_crypto_call(ctx, cap, tc)) {
+                /* Process the current AES encrypt test vector... */
                 AMVP_LOG_ERR("crypto module failed the operation");
-                free(tmp);
                 json_value_free(r_tval);
-                return AMVP_CRYPTO_MODULE_FAIL;
+                rv = AMVP_CRYPTO_MODULE_FAIL;
+                goto end;
             }
 
             /*
              * Adjust the parameters for next iteration if needed.
              */
-            rv = amvp_aes_mct_iterate_tc(ctx, stc, i);
+            rv = amvp_aes_mct_iterate_tc(ctx, stc, mct, i);
             if (rv != AMVP_SUCCESS) {
                 AMVP_LOG_ERR("Failed the MCT iteration changes");
-                free(tmp);
-                return rv;
+                json_value_free(r_tval);
+                goto end;
             }
         }
 
         j = 999;
         if (stc->direction == AMVP_SYM_CIPH_DIR_ENCRYPT) {
-            memzero_s(tmp, AMVP_SYM_CT_MAX);
-            if (stc->cipher == AMVP_AES_CFB1) {
-                rv = amvp_bin_to_hexstr(stc->ct, 1, tmp, AMVP_SYM_CT_MAX);
-                if (rv != AMVP_SUCCESS) {
-                    AMVP_LOG_ERR("hex conversion failure (ct)");
-                    free(tmp);
-                    return rv;
-                }
-            } else {
-                rv = amvp_bin_to_hexstr(stc->ct, stc->ct_len, tmp, AMVP_SYM_CT_MAX);
-                if (rv != AMVP_SUCCESS) {
-                    AMVP_LOG_ERR("hex conversion failure (ct)");
-                    free(tmp);
-                    return rv;
-                }
+            rv = amvp_json_set_hex(r_tobj, "ct", stc->ct, stc->cipher == AMVP_AES_CFB1 ? 1 : stc->ct_len);
+            if (rv != AMVP_SUCCESS) {
+                AMVP_LOG_ERR("hex conversion failure (ct)");
+                json_value_free(r_tval);
+                goto end;
             }
-            json_object_set_string(r_tobj, "ct", tmp);
 
             if (stc->cipher == AMVP_AES_CFB8) {
                 /* ct = CT[j-15] || CT[j-14] || ... || CT[j] */
                 for (n1 = 0, n2 = stc->key_len / 8 - 1; n1 < stc->key_len / 8; ++n1, --n2) {
-                    ciphertext[n1] = ctext[j - n2][0];
+                    ciphertext[n1] = mct->ctext[j - n2][0];
                 }
 
                 /* IV[i+1] = ct */
                 for (n1 = 0, n2 = 15; n1 < 16; ++n1, --n2) {
-                    stc->iv[n1] = ctext[j - n2][0];
+                    stc->iv[n1] = mct->ctext[j - n2][0];
                 }
-                ptext[0][0] = ctext[j - 16][0];
+                mct->ptext[0][0] = mct->ctext[j - 16][0];
             } else if (stc->cipher == AMVP_AES_CFB1) {
                 for (n1 = 0, n2 = stc->key_len - 1; n1 < stc->key_len; ++n1, --n2) {
-                    sb(ciphertext, n1, gb(ctext[j - n2], 0));
+                    sb(ciphertext, n1, gb(mct->ctext[j - n2], 0));
                 }
 
                 for (n1 = 0, n2 = 127; n1 < 128; ++n1, --n2) {
-                    sb(miv[i + 1], n1, gb(ctext[j - n2], 0));
+                    sb(mct->miv[i + 1], n1, gb(mct->ctext[j - n2], 0));
                 }
-                ptext[0][0] = ctext[j - 128][0] & 0x80;
-                stc->pt[0] = ptext[0][0];
-                memcpy_s(stc->iv, AMVP_SYM_IV_BYTE_MAX, miv[i + 1], stc->iv_len);
+                mct->ptext[0][0] = mct->ctext[j - 128][0] & 0x80;
+                stc->pt[0] = mct->ptext[0][0];
+                memcpy_s(stc->iv, AMVP_SYM_IV_BYTE_MAX, mct->miv[i + 1], stc->iv_len);
             } else {
                 switch (stc->key_len) {
                 case 128:
-                    memcpy_s(ciphertext, MCT_CT_LEN, ctext[j], 16);
+                    memcpy_s(ciphertext, MCT_CT_LEN, mct->ctext[j], 16);
                     break;
                 case 192:
-                    memcpy_s(ciphertext, MCT_CT_LEN, ctext[j - 1] + 8, 8);
-                    memcpy_s(ciphertext + 8, (MCT_CT_LEN - 8), ctext[j], 16);
+                    memcpy_s(ciphertext, MCT_CT_LEN, mct->ctext[j - 1] + 8, 8);
+                    memcpy_s(ciphertext + 8, (MCT_CT_LEN - 8), mct->ctext[j], 16);
                     break;
                 case 256:
-                    memcpy_s(ciphertext, MCT_CT_LEN, ctext[j - 1], 16);
-                    memcpy_s(ciphertext + 16, (MCT_CT_LEN - 16), ctext[j], 16);
+                    memcpy_s(ciphertext, MCT_CT_LEN, mct->ctext[j - 1], 16);
+                    memcpy_s(ciphertext + 16, (MCT_CT_LEN - 16), mct->ctext[j], 16);
                     break;
                 default:
                     AMVP_LOG_ERR("Illegal case switch %d", stc->key_len);
@@ -375,60 +369,46 @@ static AMVP_RESULT amvp_aes_mct_tc(AMVP_CTX *ctx,
                 }
             }
         } else {
-            memzero_s(tmp, AMVP_SYM_CT_MAX);
-
-            if (stc->cipher == AMVP_AES_CFB1) {
-                rv = amvp_bin_to_hexstr(stc->pt, 1, tmp, AMVP_SYM_PT_MAX);
-                if (rv != AMVP_SUCCESS) {
-                    AMVP_LOG_ERR("hex conversion failure (pt)");
-                    json_value_free(r_tval);
-                    free(tmp);
-                    return rv;
-                }
-            } else {
-                rv = amvp_bin_to_hexstr(stc->pt, stc->pt_len, tmp, AMVP_SYM_CT_MAX);
-                if (rv != AMVP_SUCCESS) {
-                    AMVP_LOG_ERR("hex conversion failure (pt)");
-                    free(tmp);
-                    json_value_free(r_tval);
-                    return rv;
-                }
+            rv = amvp_json_set_hex(r_tobj, "pt", stc->pt, stc->cipher == AMVP_AES_CFB1 ? 1 : stc->pt_len);
+            if (rv != AMVP_SUCCESS) {
+                AMVP_LOG_ERR("hex conversion failure (pt)");
+                json_value_free(r_tval);
+                goto end;
             }
-            json_object_set_string(r_tobj, "pt", tmp);
 
             if (stc->cipher == AMVP_AES_CFB8) {
                 /* ct = CT[j-15] || CT[j-14] || ... || CT[j] */
                 for (n1 = 0, n2 = stc->key_len / 8 - 1; n1 < stc->key_len / 8; ++n1, --n2) {
-                    ciphertext[n1] = ptext[j - n2][0];
+                    ciphertext[n1] = mct->ptext[j - n2][0];
                 }
 
                 for (n1 = 0, n2 = 15; n1 < 16; ++n1, --n2) {
-                    stc->iv[n1] = ptext[j - n2][0];
+                    stc->iv[n1] = mct->ptext[j - n2][0];
                 }
-                ctext[0][0] = ptext[j - 16][0];
+                mct->ctext[0][0] = mct->ptext[j - 16][0];
             } else if (stc->cipher == AMVP_AES_CFB1) {
                 for (n1 = 0, n2 = stc->key_len - 1; n1 < stc->key_len; ++n1, --n2) {
-                    sb(ciphertext, n1, gb(ptext[j - n2], 0));
+                    sb(ciphertext, n1, gb(mct->ptext[j - n2], 0));
                 }
 
                 for (n1 = 0, n2 = 127; n1 < 128; ++n1, --n2) {
-                    sb(miv[i + 1], n1, gb(ptext[j - n2], 0));
+                    sb(mct->miv[i + 1], n1, gb(mct->ptext[j - n2], 0));
                 }
-                ctext[0][0] = ptext[j - 128][0] & 0x80;
-                stc->ct[0] = ctext[0][0];
-                memcpy_s(stc->iv, AMVP_SYM_IV_BYTE_MAX, miv[i + 1], stc->iv_len);
+                mct->ctext[0][0] = mct->ptext[j - 128][0] & 0x80;
+                stc->ct[0] = mct->ctext[0][0];
+                memcpy_s(stc->iv, AMVP_SYM_IV_BYTE_MAX, mct->miv[i + 1], stc->iv_len);
             } else {
                 switch (stc->key_len) {
                 case 128:
-                    memcpy_s(ciphertext, MCT_CT_LEN, ptext[j], 16);
+                    memcpy_s(ciphertext, MCT_CT_LEN, mct->ptext[j], 16);
                     break;
                 case 192:
-                    memcpy_s(ciphertext, MCT_CT_LEN, ptext[j - 1] + 8, 8);
-                    memcpy_s(ciphertext + 8, (MCT_CT_LEN - 8), ptext[j], 16);
+                    memcpy_s(ciphertext, MCT_CT_LEN, mct->ptext[j - 1] + 8, 8);
+                    memcpy_s(ciphertext + 8, (MCT_CT_LEN - 8), mct->ptext[j], 16);
                     break;
                 case 256:
-                    memcpy_s(ciphertext, MCT_CT_LEN, ptext[j - 1], 16);
-                    memcpy_s(ciphertext + 16, (MCT_CT_LEN - 16), ptext[j], 16);
+                    memcpy_s(ciphertext, MCT_CT_LEN, mct->ptext[j - 1], 16);
+                    memcpy_s(ciphertext + 16, (MCT_CT_LEN - 16), mct->ptext[j], 16);
                     break;
                 default:
                     AMVP_LOG_ERR("Illegal case switch %d", stc->key_len);
@@ -439,15 +419,22 @@ static AMVP_RESULT amvp_aes_mct_tc(AMVP_CTX *ctx,
 
         /* create the key for the next loop */
         for (n = 0; n < stc->key_len / 8; ++n) {
-            stc->key[n] = mkey[0][n] ^ ciphertext[n];
+            stc->key[n] = mct->mkey[0][n] ^ ciphertext[n];
         }
 
         /* Append the test response value to array */
         json_array_append_value(res_array, r_tval);
     }
 
-    free(tmp);
-    return AMVP_SUCCESS;
+    rv = AMVP_SUCCESS;
+
+end:
+    if (mct) free(mct);
+    if (stc->mct_out) {
+        free(stc->mct_out);
+        stc->mct_out = NULL;
+    }
+    return rv;
 }
 
 static AMVP_SYM_CIPH_TWEAK_MODE read_tw_mode(const char *str) {
@@ -620,6 +607,29 @@ static AMVP_SYM_CIPH_DIR read_direction(const char *str) {
  * parsed, processed, and a response is generated to be sent
  * back to the ACV server by the transport layer.
  */
+/*
+ * Names looked up in every test case, hashed once per vector set
+ */
+typedef struct amvp_aes_tc_keys_t {
+    JSON_Key tc_id, key, payload_len, data_unit_len, pt, ct, tag, iv;
+    JSON_Key tweak_value, seq_num, aad, salt;
+} AMVP_AES_TC_KEYS;
+
+static void amvp_aes_init_tc_keys(AMVP_AES_TC_KEYS *keys) {
+    json_key_init(&keys->tc_id, "tcId");
+    json_key_init(&keys->key, "key");
+    json_key_init(&keys->payload_len, "payloadLen");
+    json_key_init(&keys->data_unit_len, "dataUnitLen");
+    json_key_init(&keys->pt, "pt");
+    json_key_init(&keys->ct, "ct");
+    json_key_init(&keys->tag, "tag");
+    json_key_init(&keys->iv, "iv");
+    json_key_init(&keys->tweak_value, "tweakValue");
+    json_key_init(&keys->seq_num, "sequenceNumber");
+    json_key_init(&keys->aad, "aad");
+    json_key_init(&keys->salt, "salt");
+}
+
 AMVP_RESULT amvp_aes_kat_handler(AMVP_CTX *ctx, JSON_Object *obj) {
     JSON_Value *groupval;
     JSON_Object *groupobj = NULL;
@@ -652,6 +662,7 @@ AMVP_RESULT amvp_aes_kat_handler(AMVP_CTX *ctx, JSON_Object *obj) {
     AMVP_SYM_CIPH_TWEAK_MODE tweak_mode = 0;
     AMVP_CONFORMANCE conformance = 0;
     int seq_num = 0;
+    AMVP_AES_TC_KEYS keys;
 
     if (!ctx) {
         AMVP_LOG_ERR("No ctx for handler operation");
@@ -662,6 +673,7 @@ AMVP_RESULT amvp_aes_kat_handler(AMVP_CTX *ctx, JSON_Object *obj) {
         AMVP_LOG_ERR("Missing JSON object for AES handler");
         return AMVP_JSON_ERR;
     }
+    amvp_aes_init_tc_keys(&keys);
 
     alg_str = json_object_get_string(obj, "algorithm");
     if (!alg_str) {
@@ -972,8 +984,8 @@ AMVP_RESULT amvp_aes_kat_handler(AMVP_CTX *ctx, JSON_Object *obj) {
         t_cnt = json_array_get_count(tests);
 
         for (j = 0; j < t_cnt; j++) {
-            const char *pt = NULL, *ct = NULL, *iv = NULL,
-                       *key = NULL, *tag = NULL, *aad = NULL, *salt = NULL;
+            AMVP_STR_VIEW pt = { 0 }, ct = { 0 }, iv = { 0 },
+                          key = { 0 }, tag = { 0 }, aad = { 0 }, salt = { 0 };
             unsigned int tc_id = 0;
 
             if (ctx->log_lvl == AMVP_LOG_LVL_VERBOSE) AMVP_LOG_NEWLINE;
@@ -981,26 +993,26 @@ AMVP_RESULT amvp_aes_kat_handler(AMVP_CTX *ctx, JSON_Object *obj) {
             testval = json_array_get_value(tests, j);
             testobj = json_value_get_object(testval);
 
-            tc_id = json_object_get_number(testobj, "tcId");
+            tc_id = json_object_get_number_key(testobj, &keys.tc_id);
             if (!json_object_has_value(testobj, "tcId")) {
                 AMVP_LOG_ERR("Server JSON missing 'tcId'");
                 rv = AMVP_TC_MISSING_DATA;
                 goto err;
             }
-            key = json_object_get_string(testobj, "key");
-            if (!key) {
+            key = amvp_json_view_key(testobj, &keys.key);
+            if (!key.str) {
                 AMVP_LOG_ERR("Server JSON missing 'key'");
                 rv = AMVP_TC_MISSING_DATA;
                 goto err;
             }
-            if (strnlen_s(key, AMVP_SYM_KEY_MAX_STR + 1) > AMVP_SYM_KEY_MAX_STR) {
+            if (key.len > AMVP_SYM_KEY_MAX_STR) {
                 AMVP_LOG_ERR("'key' length exceeds max aes key string length (%d)", AMVP_SYM_KEY_MAX_STR);
                 rv = AMVP_TC_INVALID_DATA;
                 goto err;
             }
 
             if (alg_id == AMVP_AES_CFB1) {
-                datalen = json_object_get_number(testobj, "payloadLen");
+                datalen = json_object_get_number_key(testobj, &keys.payload_len);
                 if (datalen > AMVP_SYM_PT_BIT_MAX) {
                     AMVP_LOG_ERR("'dataLen' too large (%u), max allowed=(%d)",
                                  datalen, AMVP_SYM_PT_BIT_MAX);
@@ -1010,7 +1022,7 @@ AMVP_RESULT amvp_aes_kat_handler(AMVP_CTX *ctx, JSON_Object *obj) {
             }
 
             if (alg_id == AMVP_AES_XTS) {
-                dataUnitLen = json_object_get_number(testobj, "dataUnitLen");
+                dataUnitLen = json_object_get_number_key(testobj, &keys.data_unit_len);
                 if (dataUnitLen > AMVP_SYM_PT_BIT_MAX) {
                     AMVP_LOG_ERR("'dataUnitLen' too large (%u), max allowed=(%d)",
                                    dataUnitLen, AMVP_SYM_PT_BIT_MAX);
@@ -1020,22 +1032,20 @@ AMVP_RESULT amvp_aes_kat_handler(AMVP_CTX *ctx, JSON_Object *obj) {
             }
 
             if (dir == AMVP_SYM_CIPH_DIR_ENCRYPT) {
-                unsigned int tmp_pt_len = 0;
-                pt = json_object_get_string(testobj, "pt");
+                pt = amvp_json_view_key(testobj, &keys.pt);
                 if (alg_id == AMVP_AES_GMAC) {
-                    if (pt) {
+                    if (pt.str) {
                         AMVP_LOG_ERR("'pt' not allowed for AES-GMAC");
                         rv = AMVP_TC_INVALID_DATA;
                         goto err;
                     }
                 } else {
-                    if (!pt) {
+                    if (!pt.str) {
                         AMVP_LOG_ERR("Server JSON missing 'pt'");
                         rv = AMVP_TC_MISSING_DATA;
                         goto err;
                     }
-                    tmp_pt_len = strnlen_s(pt, AMVP_SYM_PT_MAX + 1);
-                    if (tmp_pt_len > AMVP_SYM_PT_MAX) {
+                    if (pt.len > AMVP_SYM_PT_MAX) {
                         AMVP_LOG_ERR("'pt' too long, max allowed=(%d)",
                                     AMVP_SYM_PT_MAX);
                         rv = AMVP_TC_INVALID_DATA;
@@ -1043,23 +1053,21 @@ AMVP_RESULT amvp_aes_kat_handler(AMVP_CTX *ctx, JSON_Object *obj) {
                     }
                 }
             } else {
-                unsigned int tmp_ct_len = 0;
 
-                ct = json_object_get_string(testobj, "ct");
+                ct = amvp_json_view_key(testobj, &keys.ct);
                 if (alg_id == AMVP_AES_GMAC) {
-                    if (ct) {
+                    if (ct.str) {
                         AMVP_LOG_ERR("'ct' not allowed for AES-GMAC");
                         rv = AMVP_TC_INVALID_DATA;
                         goto err;
                     }
                 } else {
-                    if (!ct) {
+                    if (!ct.str) {
                         AMVP_LOG_ERR("Server JSON missing 'ct'");
                         rv = AMVP_TC_MISSING_DATA;
                         goto err;
                     }
-                    tmp_ct_len = strnlen_s(ct, AMVP_SYM_CT_MAX + 1);
-                    if (tmp_ct_len > AMVP_SYM_CT_MAX) {
+                    if (ct.len > AMVP_SYM_CT_MAX) {
                         AMVP_LOG_ERR("'ct' too long, max allowed=(%d)",
                                     AMVP_SYM_CT_MAX);
                         rv = AMVP_TC_INVALID_DATA;
@@ -1068,13 +1076,13 @@ AMVP_RESULT amvp_aes_kat_handler(AMVP_CTX *ctx, JSON_Object *obj) {
                 }
 
                 if (alg_id == AMVP_AES_GCM || alg_id == AMVP_AES_GMAC) {
-                    tag = json_object_get_string(testobj, "tag");
-                    if (!tag) {
+                    tag = amvp_json_view_key(testobj, &keys.tag);
+                    if (!tag.str) {
                         AMVP_LOG_ERR("Server JSON missing 'tag'");
                         rv = AMVP_TC_MISSING_DATA;
                         goto err;
                     }
-                    if (strnlen_s(tag, AMVP_SYM_TAG_MAX + 1) > AMVP_SYM_TAG_MAX) {
+                    if (tag.len > AMVP_SYM_TAG_MAX) {
                         AMVP_LOG_ERR("'tag' too long, max allowed=(%d)",
                                      AMVP_SYM_TAG_MAX);
                         rv = AMVP_TC_INVALID_DATA;
@@ -1101,13 +1109,13 @@ AMVP_RESULT amvp_aes_kat_handler(AMVP_CTX *ctx, JSON_Object *obj) {
             }
 
             if (readIv) {
-                iv = json_object_get_string(testobj, "iv");
-                if (!iv) {
+                iv = amvp_json_view_key(testobj, &keys.iv);
+                if (!iv.str) {
                     AMVP_LOG_ERR("Server JSON missing 'iv'");
                     rv = AMVP_TC_MISSING_DATA;
                     goto err;
                 }
-                if (strnlen_s(iv, AMVP_SYM_IV_MAX + 1) > AMVP_SYM_IV_MAX) {
+                if (iv.len > AMVP_SYM_IV_MAX) {
                     AMVP_LOG_ERR("'iv' too long, max allowed=(%d)",
                                     AMVP_SYM_IV_MAX);
                     rv = AMVP_TC_INVALID_DATA;
@@ -1125,13 +1133,13 @@ AMVP_RESULT amvp_aes_kat_handler(AMVP_CTX *ctx, JSON_Object *obj) {
                 switch (tweak_mode) {
                 case AMVP_SYM_CIPH_TWEAK_HEX:
                     /* XTS may call it tweak value, but we treat it as an IV */
-                    iv = json_object_get_string(testobj, "tweakValue");
-                    if (!iv) {
+                    iv = amvp_json_view_key(testobj, &keys.tweak_value);
+                    if (!iv.str) {
                         AMVP_LOG_ERR("Server JSON missing hex 'tweakValue'");
                         rv = AMVP_TC_MISSING_DATA;
                         goto err;
                     }
-                    if (strnlen_s(iv, AMVP_SYM_IV_MAX + 1) > AMVP_SYM_IV_MAX) {
+                    if (iv.len > AMVP_SYM_IV_MAX) {
                         AMVP_LOG_ERR("'i' too long, max allowed=(%d)",
                                         AMVP_SYM_IV_MAX);
                         rv = AMVP_TC_INVALID_DATA;
@@ -1139,7 +1147,7 @@ AMVP_RESULT amvp_aes_kat_handler(AMVP_CTX *ctx, JSON_Object *obj) {
                     }
                     break;
                 case AMVP_SYM_CIPH_TWEAK_NUM:
-                    seq_num = json_object_get_number(testobj, "sequenceNumber");
+                    seq_num = json_object_get_number_key(testobj, &keys.seq_num);
                     if ((seq_num < 0) || (seq_num > 255)) {
                         AMVP_LOG_ERR("Server JSON invalid number 'tweakValue'");
                         rv = AMVP_TC_INVALID_DATA;
@@ -1157,13 +1165,13 @@ AMVP_RESULT amvp_aes_kat_handler(AMVP_CTX *ctx, JSON_Object *obj) {
 
             if (alg_id == AMVP_AES_GCM || alg_id == AMVP_AES_GCM_SIV || alg_id == AMVP_AES_CCM || 
                                           alg_id == AMVP_AES_GMAC || alg_id == AMVP_AES_XPN) {
-                aad = json_object_get_string(testobj, "aad");
-                if (!aad) {
+                aad = amvp_json_view_key(testobj, &keys.aad);
+                if (!aad.str) {
                     AMVP_LOG_ERR("Server JSON missing 'aad'");
                     rv = AMVP_TC_MISSING_DATA;
                     goto err;
                 }
-                if (strnlen_s(aad, AMVP_SYM_AAD_MAX + 1) > AMVP_SYM_AAD_MAX) {
+                if (aad.len > AMVP_SYM_AAD_MAX) {
                     AMVP_LOG_ERR("'aad' too long, max allowed=(%d)",
                                  AMVP_SYM_AAD_MAX);
                     rv = AMVP_TC_INVALID_DATA;
@@ -1172,24 +1180,24 @@ AMVP_RESULT amvp_aes_kat_handler(AMVP_CTX *ctx, JSON_Object *obj) {
             }
 
             if (alg_id == AMVP_AES_XPN && salt_src == AMVP_SYM_CIPH_SALT_SRC_EXT) {
-                salt = json_object_get_string(testobj, "salt");
+                salt = amvp_json_view_key(testobj, &keys.salt);
             }
 
             AMVP_LOG_VERBOSE("        Test case: %d", j);
             AMVP_LOG_VERBOSE("             tcId: %d", tc_id);
-            AMVP_LOG_VERBOSE("              key: %s", key);
+            AMVP_LOG_VERBOSE("              key: %s", key.str);
             if (datalen)
                 AMVP_LOG_VERBOSE("       payloadLen: %d", datalen);
-            if (pt)
-                AMVP_LOG_VERBOSE("               pt: %s", pt);
-            else if (ct)
-                AMVP_LOG_VERBOSE("               ct: %s", ct);
-            if (iv)
-                AMVP_LOG_VERBOSE("               iv: %s", iv);
-            if (tag)
-                AMVP_LOG_VERBOSE("              tag: %s", tag);
-            if (aad)
-                AMVP_LOG_VERBOSE("              aad: %s", aad);
+            if (pt.str)
+                AMVP_LOG_VERBOSE("               pt: %s", pt.str);
+            else if (ct.str)
+                AMVP_LOG_VERBOSE("               ct: %s", ct.str);
+            if (iv.str)
+                AMVP_LOG_VERBOSE("               iv: %s", iv.str);
+            if (tag.str)
+                AMVP_LOG_VERBOSE("              tag: %s", tag.str);
+            if (aad.str)
+                AMVP_LOG_VERBOSE("              aad: %s", aad.str);
 
             /*
              * Create a new test case in the response
@@ -1226,7 +1234,7 @@ AMVP_RESULT amvp_aes_kat_handler(AMVP_CTX *ctx, JSON_Object *obj) {
                 }
             } else {
                 /* Process the current AES KAT test vector... */
-                int t_rv = (cap->crypto_handler)(&tc);
+                int t_rv = amvp_crypto_call(ctx, cap, &tc);
                 if (t_rv) {
                     if (alg_id != AMVP_AES_KW && alg_id != AMVP_AES_GCM &&
                             alg_id != AMVP_AES_GCM_SIV && alg_id != AMVP_AES_CCM 
@@ -1264,9 +1272,11 @@ AMVP_RESULT amvp_aes_kat_handler(AMVP_CTX *ctx, JSON_Object *obj) {
     json_array_append_value(reg_arry, r_vs_val);
     rv = AMVP_SUCCESS;
 
-    json_result = json_serialize_to_string_pretty(ctx->kat_resp, NULL);
-    AMVP_LOG_VERBOSE("\n\n%s\n\n", json_result);
-    json_free_serialized_string(json_result);
+    if (AMVP_LOG_ENABLED(AMVP_LOG_LVL_VERBOSE)) {
+        json_result = json_serialize_to_string_pretty(ctx->kat_resp, NULL);
+        AMVP_LOG_VERBOSE("\n\n%s\n\n", json_result);
+        json_free_serialized_string(json_result);
+    }
 
 err:
     if (rv != AMVP_SUCCESS) {
@@ -1286,13 +1296,7 @@ static AMVP_RESULT amvp_aes_output_tc(AMVP_CTX *ctx,
                                       JSON_Object *tc_rsp,
                                       int opt_rv) {
     AMVP_RESULT rv;
-    char *tmp = NULL;
-
-    tmp = calloc(AMVP_SYM_CT_MAX + 1, sizeof(char));
-    if (!tmp) {
-        AMVP_LOG_ERR("Unable to malloc in amvp_aes_output_tc");
-        return AMVP_MALLOC_FAIL;
-    }
+    int len = 0;
 
     /*
      * Only return IV on AES ciphers with internal IV generation
@@ -1300,51 +1304,50 @@ static AMVP_RESULT amvp_aes_output_tc(AMVP_CTX *ctx,
     if (stc->ivgen_source == AMVP_SYM_CIPH_IVGEN_SRC_INT &&
           (stc->cipher == AMVP_AES_GCM || stc->cipher == AMVP_AES_GMAC || stc->cipher == AMVP_AES_XPN ||
           (stc->cipher == AMVP_AES_CTR && stc->conformance == AMVP_CONFORMANCE_RFC3686))) {
-        rv = amvp_bin_to_hexstr(stc->iv, stc->iv_len, tmp, AMVP_SYM_CT_MAX);
+        rv = amvp_json_set_hex(tc_rsp, "iv", stc->iv, stc->iv_len);
         if (rv != AMVP_SUCCESS) {
             AMVP_LOG_ERR("hex conversion failure (iv)");
-            goto err;
+            return rv;
         }
-        json_object_set_string(tc_rsp, "iv", tmp);
     }
 
     if (stc->cipher == AMVP_AES_XPN && stc->salt_source == AMVP_SYM_CIPH_SALT_SRC_INT) {
-        rv = amvp_bin_to_hexstr(stc->salt, stc->salt_len, tmp, AMVP_AES_XPN_SALTLEN);
+        rv = amvp_json_set_hex(tc_rsp, "salt", stc->salt, stc->salt_len);
         if (rv != AMVP_SUCCESS) {
             AMVP_LOG_ERR("hex conversion failure (salt)");
-            goto err;
+            return rv;
         }
-        json_object_set_string(tc_rsp, "salt", tmp);
     }
 
     if (stc->direction == AMVP_SYM_CIPH_DIR_ENCRYPT) {
-        memzero_s(tmp, AMVP_SYM_CT_MAX);
         if (stc->cipher == AMVP_AES_CFB1) {
-            rv = amvp_bin_to_hexstr(stc->ct, (stc->ct_len + 7) / 8, tmp, AMVP_SYM_CT_MAX);
+            len = (stc->ct_len + 7) / 8;
         } else if (stc->cipher == AMVP_AES_GCM) {
-            rv = amvp_bin_to_hexstr(stc->ct, stc->pt_len, tmp, AMVP_SYM_CT_MAX);
+            len = stc->pt_len;
         } else {
-            rv = amvp_bin_to_hexstr(stc->ct, stc->ct_len, tmp, AMVP_SYM_CT_MAX);
+            len = stc->ct_len;
         }
-        if (rv != AMVP_SUCCESS) {
+        if (len * 2 > AMVP_SYM_CT_MAX) {
             AMVP_LOG_ERR("hex conversion failure (ct)");
-            goto err;
+            return AMVP_CONVERT_DATA_ERR;
         }
         if (stc->cipher != AMVP_AES_GMAC) {
-            json_object_set_string(tc_rsp, "ct", tmp);
+            rv = amvp_json_set_hex(tc_rsp, "ct", stc->ct, len);
+            if (rv != AMVP_SUCCESS) {
+                AMVP_LOG_ERR("hex conversion failure (ct)");
+                return rv;
+            }
         }
 
         /*
          * AES-GCM ciphers need to include the tag
          */
         if (stc->cipher == AMVP_AES_GCM || stc->cipher == AMVP_AES_GMAC || stc->cipher == AMVP_AES_XPN) {
-            memzero_s(tmp, AMVP_SYM_CT_MAX);
-            rv = amvp_bin_to_hexstr(stc->tag, stc->tag_len, tmp, AMVP_SYM_CT_MAX);
+            rv = amvp_json_set_hex(tc_rsp, "tag", stc->tag, stc->tag_len);
             if (rv != AMVP_SUCCESS) {
                 AMVP_LOG_ERR("hex conversion failure (tag)");
-                goto err;
+                return rv;
             }
-            json_object_set_string(tc_rsp, "tag", tmp);
         }
     } else {
         if (stc->cipher == AMVP_AES_GCM || stc->cipher == AMVP_AES_CCM ||
@@ -1353,7 +1356,6 @@ static AMVP_RESULT amvp_aes_output_tc(AMVP_CTX *ctx,
                 stc->cipher == AMVP_AES_XPN) {
             if (opt_rv != 0) {
                 json_object_set_boolean(tc_rsp, "testPassed", 0);
-                free(tmp);
                 return AMVP_SUCCESS;
             } else {
                 json_object_set_boolean(tc_rsp, "testPassed", 1);
@@ -1361,27 +1363,26 @@ static AMVP_RESULT amvp_aes_output_tc(AMVP_CTX *ctx,
         }
 
         if (stc->cipher == AMVP_AES_CFB1) {
-            rv = amvp_bin_to_hexstr(stc->pt, (stc->pt_len + 7) / 8, tmp, AMVP_SYM_PT_MAX);
+            len = (stc->pt_len + 7) / 8;
         } else if (stc->cipher == AMVP_AES_GCM) {
-            rv = amvp_bin_to_hexstr(stc->pt, stc->ct_len, tmp, AMVP_SYM_PT_MAX);
+            len = stc->ct_len;
         } else {
-            rv = amvp_bin_to_hexstr(stc->pt, stc->pt_len, tmp, AMVP_SYM_PT_MAX);
+            len = stc->pt_len;
         }
-        if (rv != AMVP_SUCCESS) {
+        if (len * 2 > AMVP_SYM_PT_MAX) {
             AMVP_LOG_ERR("hex conversion failure (pt)");
-            goto err;
+            return AMVP_CONVERT_DATA_ERR;
         }
         if (stc->cipher != AMVP_AES_GMAC) {
-            json_object_set_string(tc_rsp, "pt", tmp);
+            rv = amvp_json_set_hex(tc_rsp, "pt", stc->pt, len);
+            if (rv != AMVP_SUCCESS) {
+                AMVP_LOG_ERR("hex conversion failure (pt)");
+                return rv;
+            }
         }
     }
-    free(tmp);
 
     return AMVP_SUCCESS;
-
-err:
-    if (tmp) free(tmp);
-    return rv;
 }
 
 /*
@@ -1397,13 +1398,13 @@ static AMVP_RESULT amvp_aes_init_tc(AMVP_CTX *ctx,
                                     AMVP_SYM_CIPHER_TC *stc,
                                     unsigned int tc_id,
                                     AMVP_SYM_CIPH_TESTTYPE test_type,
-                                    const char *j_key,
-                                    const char *j_pt,
-                                    const char *j_ct,
-                                    const char *j_iv,
-                                    const char *j_tag,
-                                    const char *j_aad,
-                                    const char *j_salt,
+                                    AMVP_STR_VIEW j_key,
+                                    AMVP_STR_VIEW j_pt,
+                                    AMVP_STR_VIEW j_ct,
+                                    AMVP_STR_VIEW j_iv,
+                                    AMVP_STR_VIEW j_tag,
+                                    AMVP_STR_VIEW j_aad,
+                                    AMVP_STR_VIEW j_salt,
                                     AMVP_SYM_KW_MODE kwcipher,
                                     unsigned int key_len,
                                     unsigned int iv_len,
@@ -1428,19 +1429,30 @@ static AMVP_RESULT amvp_aes_init_tc(AMVP_CTX *ctx,
 
     memzero_s(stc, sizeof(AMVP_SYM_CIPHER_TC));
 
-    stc->key = calloc(AMVP_SYM_KEY_MAX_BYTES, 1);
+    /*
+     * Buffers come from the context's test case arena, which is recycled
+     * for every test case. The crypto module may write pt, ct, tag and iv,
+     * so those keep their maximum sizes; aad is only read and is decoded
+     * straight from the vector set string into a buffer of its own size.
+     */
+    amvp_arena_reset(&ctx->tc_arena);
+    stc->key = amvp_arena_alloc(&ctx->tc_arena, AMVP_SYM_KEY_MAX_BYTES);
     if (!stc->key) { return AMVP_MALLOC_FAIL; }
-    stc->pt = calloc( AMVP_SYM_PT_BYTE_MAX, 1);
+    stc->pt = amvp_arena_alloc(&ctx->tc_arena, AMVP_SYM_PT_BYTE_MAX);
     if (!stc->pt) { return AMVP_MALLOC_FAIL; }
-    stc->ct = calloc(AMVP_SYM_CT_BYTE_MAX, 1);
+    stc->ct = amvp_arena_alloc(&ctx->tc_arena, AMVP_SYM_CT_BYTE_MAX);
     if (!stc->ct) { return AMVP_MALLOC_FAIL; }
-    stc->tag = calloc(AMVP_SYM_TAG_BYTE_MAX, 1);
+    stc->tag = amvp_arena_alloc(&ctx->tc_arena, AMVP_SYM_TAG_BYTE_MAX);
     if (!stc->tag) { return AMVP_MALLOC_FAIL; }
-    stc->iv = calloc(AMVP_SYM_IV_BYTE_MAX, 1);
+    stc->iv = amvp_arena_alloc(&ctx->tc_arena, AMVP_SYM_IV_BYTE_MAX);
     if (!stc->iv) { return AMVP_MALLOC_FAIL; }
-    stc->aad = calloc(AMVP_SYM_AAD_BYTE_MAX, 1);
-    if (!stc->aad) { return AMVP_MALLOC_FAIL; }
-    stc->salt = calloc(AMVP_AES_XPN_SALTLEN, 1);
+    rv = amvp_arena_decode_hex(&ctx->tc_arena, j_aad, AMVP_BIT2BYTE(aad_len),
+                               AMVP_SYM_AAD_BYTE_MAX, &stc->aad, NULL);
+    if (rv != AMVP_SUCCESS) {
+        AMVP_LOG_ERR("Hex conversion failure (aad)");
+        return rv;
+    }
+    stc->salt = amvp_arena_alloc(&ctx->tc_arena, AMVP_AES_XPN_SALTLEN);
     if (!stc->salt) { return AMVP_MALLOC_FAIL; }
 
     /*
@@ -1470,15 +1482,15 @@ static AMVP_RESULT amvp_aes_init_tc(AMVP_CTX *ctx,
     stc->seq_num = seq_num;
     stc->salt_source = salt_src;
 
-    rv = amvp_hexstr_to_bin(j_key, stc->key, AMVP_SYM_KEY_MAX_BYTES, NULL);
+    rv = amvp_view_to_bin(j_key, stc->key, AMVP_SYM_KEY_MAX_BYTES, NULL);
     if (rv != AMVP_SUCCESS) {
         AMVP_LOG_ERR("Hex conversion failure (key)");
         return rv;
     }
 
-    if (j_pt) {
+    if (j_pt.str) {
         if (alg_id == AMVP_AES_CFB1) {
-            rv = amvp_hexstr_to_bin(j_pt, stc->pt, AMVP_SYM_PT_BYTE_MAX, NULL);
+            rv = amvp_view_to_bin(j_pt, stc->pt, AMVP_SYM_PT_BYTE_MAX, NULL);
             if (rv != AMVP_SUCCESS) {
                 AMVP_LOG_ERR("Hex conversion failure (pt)");
                 return rv;
@@ -1486,7 +1498,7 @@ static AMVP_RESULT amvp_aes_init_tc(AMVP_CTX *ctx,
             stc->data_len = data_len;
             stc->pt_len = data_len;
         } else {
-            rv = amvp_hexstr_to_bin(j_pt, stc->pt, AMVP_SYM_PT_BYTE_MAX, NULL);
+            rv = amvp_view_to_bin(j_pt, stc->pt, AMVP_SYM_PT_BYTE_MAX, NULL);
             if (rv != AMVP_SUCCESS) {
                 AMVP_LOG_ERR("Hex conversion failure (pt)");
                 return rv;
@@ -1494,14 +1506,14 @@ static AMVP_RESULT amvp_aes_init_tc(AMVP_CTX *ctx,
             if (alg_id == AMVP_AES_CCM) {
                 stc->pt_len = pt_len / 8;
             } else {
-                stc->pt_len = strnlen_s(j_pt, AMVP_SYM_PT_MAX) / 2;
+                stc->pt_len = j_pt.len / 2;
             }
         }
     }
 
-    if (j_ct) {
+    if (j_ct.str) {
         if (alg_id == AMVP_AES_CFB1) {
-            rv = amvp_hexstr_to_bin(j_ct, stc->ct, AMVP_SYM_CT_BYTE_MAX, NULL);
+            rv = amvp_view_to_bin(j_ct, stc->ct, AMVP_SYM_CT_BYTE_MAX, NULL);
             if (rv != AMVP_SUCCESS) {
                 AMVP_LOG_ERR("Hex conversion failure (ct)");
                 return rv;
@@ -1509,7 +1521,7 @@ static AMVP_RESULT amvp_aes_init_tc(AMVP_CTX *ctx,
             stc->data_len = data_len;
             stc->ct_len = data_len;
         } else {
-            rv = amvp_hexstr_to_bin(j_ct, stc->ct, AMVP_SYM_CT_BYTE_MAX, NULL);
+            rv = amvp_view_to_bin(j_ct, stc->ct, AMVP_SYM_CT_BYTE_MAX, NULL);
             if (rv != AMVP_SUCCESS) {
                 AMVP_LOG_ERR("Hex conversion failure (ct)");
                 return rv;
@@ -1517,17 +1529,17 @@ static AMVP_RESULT amvp_aes_init_tc(AMVP_CTX *ctx,
             if (alg_id == AMVP_AES_CCM) {
                 stc->ct_len = pt_len / 8;
             } else {
-                stc->ct_len = strnlen_s(j_ct, AMVP_SYM_CT_MAX) / 2;
+                stc->ct_len = j_ct.len / 2;
             }
         }
     }
-    if (j_iv) {
+    if (j_iv.str) {
         if (alg_id == AMVP_AES_CBC_CS1 || alg_id == AMVP_AES_CBC_CS2 || alg_id == AMVP_AES_CBC_CS3) {
             int tmp = 0; //avoid warning
-            rv = amvp_hexstr_to_bin(j_iv, stc->iv, AMVP_SYM_IV_BYTE_MAX, &tmp);
+            rv = amvp_view_to_bin(j_iv, stc->iv, AMVP_SYM_IV_BYTE_MAX, &tmp);
             stc->iv_len = (unsigned int)tmp;
         } else {
-            rv = amvp_hexstr_to_bin(j_iv, stc->iv, AMVP_SYM_IV_BYTE_MAX, NULL);
+            rv = amvp_view_to_bin(j_iv, stc->iv, AMVP_SYM_IV_BYTE_MAX, NULL);
         }
         if (rv != AMVP_SUCCESS) {
             AMVP_LOG_ERR("Hex conversion failure (iv)");
@@ -1535,24 +1547,16 @@ static AMVP_RESULT amvp_aes_init_tc(AMVP_CTX *ctx,
         }
     }
 
-    if (j_tag) {
-        rv = amvp_hexstr_to_bin(j_tag, stc->tag, AMVP_SYM_TAG_BYTE_MAX, NULL);
+    if (j_tag.str) {
+        rv = amvp_view_to_bin(j_tag, stc->tag, AMVP_SYM_TAG_BYTE_MAX, NULL);
         if (rv != AMVP_SUCCESS) {
             AMVP_LOG_ERR("Hex conversion failure (tag)");
             return rv;
         }
     }
 
-    if (j_aad) {
-        rv = amvp_hexstr_to_bin(j_aad, stc->aad, AMVP_SYM_AAD_BYTE_MAX, NULL);
-        if (rv != AMVP_SUCCESS) {
-            AMVP_LOG_ERR("Hex conversion failure (aad)");
-            return rv;
-        }
-    }
-
-    if (j_salt) {
-        rv = amvp_hexstr_to_bin(j_salt, stc->salt, AMVP_AES_XPN_SALTLEN, NULL);
+    if (j_salt.str) {
+        rv = amvp_view_to_bin(j_salt, stc->salt, AMVP_AES_XPN_SALTLEN, NULL);
         if (rv != AMVP_SUCCESS) {
             AMVP_LOG_ERR("Hex conversion failure (salt)");
             return rv;
@@ -1567,13 +1571,7 @@ static AMVP_RESULT amvp_aes_init_tc(AMVP_CTX *ctx,
  * a test case.
  */
 static AMVP_RESULT amvp_aes_release_tc(AMVP_SYM_CIPHER_TC *stc) {
-    if (stc->key) free(stc->key);
-    if (stc->pt) free(stc->pt);
-    if (stc->ct) free(stc->ct);
-    if (stc->tag) free(stc->tag);
-    if (stc->iv) free(stc->iv);
-    if (stc->aad) free(stc->aad);
-    if (stc->salt) free(stc->salt);
+    /* The buffers belong to ctx->tc_arena, which the next init_tc resets */
     memzero_s(stc, sizeof(AMVP_SYM_CIPHER_TC));
 
     return AMVP_SUCCESS;
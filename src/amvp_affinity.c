@@ -0,0 +1,242 @@
+/** @file */
+/*
+ * Copyright (c) 2021, Cisco Systems, Inc.
+ *
+ * Licensed under the Apache License 2.0 (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://github.com/cisco/libamvp/LICENSE
+ */
+
+/*
+ * Placement of the worker threads and processes, see
+ * amvp_set_worker_affinity().
+ *
+ * The NUMA nodes and their CPUs are read from sysfs, limited to the CPUs
+ * the process may run on, so a taskset or cgroup restriction is honored.
+ * Workers are dealt out to the nodes in turn, so each node added gets its
+ * share of them, and within a node to its CPUs in the order the kernel
+ * lists them, which puts one worker on each core before using SMT
+ * siblings. Each worker pins itself before it allocates or touches any
+ * memory, so its stack, its malloc arena and, for worker processes, the
+ * test case buffers it rebuilds are first touched, and so placed, on its
+ * own node. The thread pool uses the node of each worker to steal work on
+ * the same node before going to another (see amvp_worker.c).
+ *
+ * Only Linux is supported; elsewhere the workers are left where the OS
+ * puts them.
+ */
+
+#ifdef __linux__
+#define _GNU_SOURCE
+#include <sched.h>
+#endif
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "amvp.h"
+#include "amvp_lcl.h"
+#include "safe_lib.h"
+
+#ifndef AMVP_NUMA_SYSFS
+#define AMVP_NUMA_SYSFS "/sys/devices/system/node"
+#endif
+#define AMVP_AFFINITY_NODE_MAX 64
+#define AMVP_AFFINITY_LIST_MAX 1024
+
+#ifdef __linux__
+struct amvp_affinity_t {
+    AMVP_WORKER_AFFINITY mode;
+    int node_cnt;
+    cpu_set_t node_cpus[AMVP_AFFINITY_NODE_MAX];    /* Allowed CPUs of each node */
+    int cpu_cnt[AMVP_AFFINITY_NODE_MAX];
+    short cpu_node[CPU_SETSIZE];                    /* Node index of each CPU, -1 if not used */
+};
+
+/*
+ * Reads a sysfs list such as "0-3,8-11" into set. Returns 0 if the file
+ * can't be read.
+ */
+static int amvp_affinity_read_list(const char *path, cpu_set_t *set) {
+    char buf[AMVP_AFFINITY_LIST_MAX];
+    char *p = buf, *end = NULL;
+    long first, last;
+    FILE *fp = fopen(path, "r");
+
+    CPU_ZERO(set);
+    if (!fp) {
+        return 0;
+    }
+    if (!fgets(buf, sizeof(buf), fp)) {
+        fclose(fp);
+        return 0;
+    }
+    fclose(fp);
+
+    while (*p && *p != '\n') {
+        first = strtol(p, &end, 10);
+        if (end == p || first < 0) {
+            break;
+        }
+        last = first;
+        p = end;
+        if (*p == '-') {
+            last = strtol(p + 1, &end, 10);
+            if (end == p + 1 || last < first) {
+                break;
+            }
+            p = end;
+        }
+        for (; first <= last && first < CPU_SETSIZE; first++) {
+            CPU_SET((int)first, set);
+        }
+        if (*p == ',') {
+            p++;
+        }
+    }
+    return 1;
+}
+
+static void amvp_affinity_add_node(AMVP_AFFINITY *aff, const cpu_set_t *cpus) {
+    int cpu;
+
+    aff->node_cpus[aff->node_cnt] = *cpus;
+    aff->cpu_cnt[aff->node_cnt] = CPU_COUNT(cpus);
+    for (cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (CPU_ISSET(cpu, cpus) && aff->cpu_node[cpu] < 0) {
+            aff->cpu_node[cpu] = (short)aff->node_cnt;
+        }
+    }
+    aff->node_cnt++;
+}
+#endif
+
+AMVP_AFFINITY *amvp_affinity_new(AMVP_CTX *ctx) {
+#ifdef __linux__
+    AMVP_AFFINITY *aff = NULL;
+    cpu_set_t allowed, nodes, cpus;
+    char path[128];
+    int node, cpu;
+
+    if (!ctx || ctx->worker_affinity == AMVP_WORKER_AFFINITY_NONE) {
+        return NULL;
+    }
+    if (sched_getaffinity(0, sizeof(allowed), &allowed)) {
+        AMVP_LOG_WARN("Unable to read the allowed CPUs, workers will not be pinned");
+        return NULL;
+    }
+    aff = calloc(1, sizeof(AMVP_AFFINITY));
+    if (!aff) {
+        return NULL;
+    }
+    aff->mode = ctx->worker_affinity;
+    for (cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        aff->cpu_node[cpu] = -1;
+    }
+
+    /* Without sysfs, or if none of the nodes have CPUs we can use, it's all one node */
+    if (!amvp_affinity_read_list(AMVP_NUMA_SYSFS "/online", &nodes)) {
+        CPU_ZERO(&nodes);
+    }
+    for (node = 0; node < CPU_SETSIZE && aff->node_cnt < AMVP_AFFINITY_NODE_MAX; node++) {
+        if (!CPU_ISSET(node, &nodes)) {
+            continue;
+        }
+        snprintf(path, sizeof(path), AMVP_NUMA_SYSFS "/node%d/cpulist", node);
+        if (!amvp_affinity_read_list(path, &cpus)) {
+            continue;
+        }
+        CPU_AND(&cpus, &cpus, &allowed);
+        /* Memory only nodes, and those with none of our CPUs, get no workers */
+        if (CPU_COUNT(&cpus)) {
+            amvp_affinity_add_node(aff, &cpus);
+        }
+    }
+    if (!aff->node_cnt) {
+        amvp_affinity_add_node(aff, &allowed);
+    }
+    AMVP_LOG_INFO("Placing workers over %d NUMA node(s), pinned to %s", aff->node_cnt,
+                  aff->mode == AMVP_WORKER_AFFINITY_CORE ? "one CPU each" : "the CPUs of their node");
+    return aff;
+#else
+    if (ctx && ctx->worker_affinity != AMVP_WORKER_AFFINITY_NONE) {
+        AMVP_LOG_WARN("Worker affinity is not supported on this platform, workers will not be pinned");
+    }
+    return NULL;
+#endif
+}
+
+void amvp_affinity_free(AMVP_AFFINITY *aff) {
+    if (aff) free(aff);
+}
+
+int amvp_affinity_node_cnt(const AMVP_AFFINITY *aff) {
+#ifdef __linux__
+    return aff ? aff->node_cnt : 0;
+#else
+    (void)aff;
+    return 0;
+#endif
+}
+
+int amvp_affinity_worker_node(const AMVP_AFFINITY *aff, int worker) {
+#ifdef __linux__
+    if (!aff || worker < 0) {
+        return -1;
+    }
+    return worker % aff->node_cnt;
+#else
+    (void)aff;
+    (void)worker;
+    return -1;
+#endif
+}
+
+int amvp_affinity_cur_node(const AMVP_AFFINITY *aff) {
+#ifdef __linux__
+    int cpu;
+
+    if (!aff) {
+        return -1;
+    }
+    cpu = sched_getcpu();
+    if (cpu < 0 || cpu >= CPU_SETSIZE) {
+        return -1;
+    }
+    return aff->cpu_node[cpu];
+#else
+    (void)aff;
+    return -1;
+#endif
+}
+
+int amvp_affinity_bind(const AMVP_AFFINITY *aff, int worker) {
+#ifdef __linux__
+    cpu_set_t set;
+    int node, k, cpu;
+
+    node = amvp_affinity_worker_node(aff, worker);
+    if (node < 0) {
+        return 0;
+    }
+    if (aff->mode != AMVP_WORKER_AFFINITY_CORE) {
+        return !sched_setaffinity(0, sizeof(cpu_set_t), &aff->node_cpus[node]);
+    }
+
+    /* The k-th allowed CPU of the node, wrapping when it has fewer than its workers */
+    k = (worker / aff->node_cnt) % aff->cpu_cnt[node];
+    for (cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (CPU_ISSET(cpu, &aff->node_cpus[node]) && !k--) {
+            break;
+        }
+    }
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return !sched_setaffinity(0, sizeof(cpu_set_t), &set);
+#else
+    (void)aff;
+    (void)worker;
+    return 0;
+#endif
+}
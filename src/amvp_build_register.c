@@ -147,6 +147,16 @@ static AMVP_RESULT amvp_build_hash_register_cap(JSON_Object *cap_obj, AMVP_CAPS_
         json_object_set_number(msg_obj, "max", hash_cap->msg_length.max);
         json_object_set_number(msg_obj, "increment", hash_cap->msg_length.increment);
         json_array_append_value(msg_array, msg_val);
+
+        if (hash_cap->large_data.count) {
+            int ldt = -1;
+
+            json_object_set_value(cap_obj, "performLargeDataTest", json_value_init_array());
+            msg_array = json_object_get_array(cap_obj, "performLargeDataTest");
+            while (amvp_value_set_next(&hash_cap->large_data, &ldt)) {
+                json_array_append_number(msg_array, ldt);
+            }
+        }
     }
 
     return AMVP_SUCCESS;
@@ -156,7 +166,7 @@ static AMVP_RESULT amvp_build_hmac_register_cap(JSON_Object *cap_obj, AMVP_CAPS_
     JSON_Array *temp_arr = NULL;
     AMVP_RESULT result;
     AMVP_HMAC_CAP *hmac_cap = cap_entry->cap.hmac_cap;
-    AMVP_SL_LIST *list = NULL;
+    int len = 0;
     const char *revision = NULL;
 
     if (!cap_entry->cap.hmac_cap) {
@@ -188,10 +198,9 @@ static AMVP_RESULT amvp_build_hmac_register_cap(JSON_Object *cap_obj, AMVP_CAPS_
         json_array_append_value(temp_arr, key_len_val);
     }
 
-    list = hmac_cap->key_len.values;
-    while (list) {
-        json_array_append_number(temp_arr, list->length);
-        list = list->next;
+    len = -1;
+    while (amvp_value_set_next(&hmac_cap->key_len.values, &len)) {
+        json_array_append_number(temp_arr, len);
     }
 
     /*
@@ -211,10 +220,9 @@ static AMVP_RESULT amvp_build_hmac_register_cap(JSON_Object *cap_obj, AMVP_CAPS_
         json_array_append_value(temp_arr, mac_len_val);
     }
 
-    list = hmac_cap->mac_len.values;
-    while (list) {
-        json_array_append_number(temp_arr, list->length);
-        list = list->next;
+    len = -1;
+    while (amvp_value_set_next(&hmac_cap->mac_len.values, &len)) {
+        json_array_append_number(temp_arr, len);
     }
 
     return AMVP_SUCCESS;
@@ -224,7 +232,7 @@ static AMVP_RESULT amvp_build_cmac_register_cap(JSON_Object *cap_obj, AMVP_CAPS_
     JSON_Array *temp_arr = NULL, *capabilities_arr = NULL;
     JSON_Value *capabilities_val = NULL, *msg_len_val = NULL, *mac_len_val = NULL;
     JSON_Object *capabilities_obj = NULL, *msg_len_obj = NULL, *mac_len_obj = NULL;
-    AMVP_SL_LIST *sl_list;
+    int len = 0;
     AMVP_RESULT result;
     AMVP_CMAC_CAP *cmac_cap = cap_entry->cap.cmac_cap;
     const char *revision = NULL;
@@ -265,10 +273,9 @@ static AMVP_RESULT amvp_build_cmac_register_cap(JSON_Object *cap_obj, AMVP_CAPS_
         json_array_append_value(temp_arr, msg_len_val);
     }
 
-    sl_list = cap_entry->cap.cmac_cap->msg_len.values;
-    while (sl_list) {
-        json_array_append_number(temp_arr, sl_list->length);
-        sl_list = sl_list->next;
+    len = -1;
+    while (amvp_value_set_next(&cap_entry->cap.cmac_cap->msg_len.values, &len)) {
+        json_array_append_number(temp_arr, len);
     }
 
     /*
@@ -286,10 +293,9 @@ static AMVP_RESULT amvp_build_cmac_register_cap(JSON_Object *cap_obj, AMVP_CAPS_
         json_array_append_value(temp_arr, mac_len_val);
     }
 
-    sl_list = cap_entry->cap.cmac_cap->mac_len.values;
-    while (sl_list) {
-        json_array_append_number(temp_arr, sl_list->length);
-        sl_list = sl_list->next;
+    len = -1;
+    while (amvp_value_set_next(&cap_entry->cap.cmac_cap->mac_len.values, &len)) {
+        json_array_append_number(temp_arr, len);
     }
 
     if (cap_entry->cipher == AMVP_CMAC_AES) {
@@ -298,10 +304,9 @@ static AMVP_RESULT amvp_build_cmac_register_cap(JSON_Object *cap_obj, AMVP_CAPS_
          */
         json_object_set_value(capabilities_obj, "keyLen", json_value_init_array());
         temp_arr = json_object_get_array(capabilities_obj, "keyLen");
-        sl_list = cap_entry->cap.cmac_cap->key_len;
-        while (sl_list) {
-            json_array_append_number(temp_arr, sl_list->length);
-            sl_list = sl_list->next;
+        len = -1;
+        while (amvp_value_set_next(&cap_entry->cap.cmac_cap->key_len, &len)) {
+            json_array_append_number(temp_arr, len);
         }
     } else if (cap_entry->cipher == AMVP_CMAC_TDES) {
         /*
@@ -309,14 +314,13 @@ static AMVP_RESULT amvp_build_cmac_register_cap(JSON_Object *cap_obj, AMVP_CAPS_
          */
         json_object_set_value(capabilities_obj, "keyingOption", json_value_init_array());
         temp_arr = json_object_get_array(capabilities_obj, "keyingOption");
-        sl_list = cap_entry->cap.cmac_cap->keying_option;
-        if (!sl_list) {
+        if (!cap_entry->cap.cmac_cap->keying_option.count) {
             json_value_free(capabilities_val);
             return AMVP_MISSING_ARG;
         }
-        while (sl_list) {
-            json_array_append_number(temp_arr, sl_list->length);
-            sl_list = sl_list->next;
+        len = -1;
+        while (amvp_value_set_next(&cap_entry->cap.cmac_cap->keying_option, &len)) {
+            json_array_append_number(temp_arr, len);
         }
     }
 
@@ -331,7 +335,7 @@ static AMVP_RESULT amvp_build_kmac_register_cap(JSON_Object *cap_obj, AMVP_CAPS_
     JSON_Object *msg_len_obj = NULL, *mac_len_obj = NULL, *key_len_obj = NULL;
     AMVP_RESULT result;
     AMVP_KMAC_CAP *kmac_cap = cap_entry->cap.kmac_cap;
-    AMVP_SL_LIST *list = NULL;
+    int len = 0;
     const char *revision = NULL;
 
     json_object_set_string(cap_obj, "algorithm", amvp_lookup_cipher_name(cap_entry->cipher));
@@ -374,10 +378,9 @@ static AMVP_RESULT amvp_build_kmac_register_cap(JSON_Object *cap_obj, AMVP_CAPS_
         json_array_append_value(temp_arr, msg_len_val);
     }
 
-    list = kmac_cap->msg_len.values;
-    while (list) {
-        json_array_append_number(temp_arr, list->length);
-        list = list->next;
+    len = -1;
+    while (amvp_value_set_next(&kmac_cap->msg_len.values, &len)) {
+        json_array_append_number(temp_arr, len);
     }
 
     /* Set the supported mac lengths */
@@ -393,10 +396,9 @@ static AMVP_RESULT amvp_build_kmac_register_cap(JSON_Object *cap_obj, AMVP_CAPS_
         json_array_append_value(temp_arr, mac_len_val);
     }
 
-    list = kmac_cap->mac_len.values;
-    while (list) {
-        json_array_append_number(temp_arr, list->length);
-        list = list->next;
+    len = -1;
+    while (amvp_value_set_next(&kmac_cap->mac_len.values, &len)) {
+        json_array_append_number(temp_arr, len);
     }
 
     /* Set the supported key lengths */
@@ -412,20 +414,25 @@ static AMVP_RESULT amvp_build_kmac_register_cap(JSON_Object *cap_obj, AMVP_CAPS_
         json_array_append_value(temp_arr, key_len_val);
     }
 
-    list = kmac_cap->key_len.values;
-    while (list) {
-        json_array_append_number(temp_arr, list->length);
-        list = list->next;
+    len = -1;
+    while (amvp_value_set_next(&kmac_cap->key_len.values, &len)) {
+        json_array_append_number(temp_arr, len);
     }
 
     return AMVP_SUCCESS;
 }
 
-static AMVP_RESULT amvp_build_sym_cipher_register_cap(JSON_Object *cap_obj, AMVP_CAPS_LIST *cap_entry) {
+/*
+ * ivgen_source is passed in rather than read from the cap so that a cap
+ * registered with AMVP_SYM_CIPH_IVGEN_SRC_EITHER can be advertised once per
+ * source without writing to it; clones of a context share their caps.
+ */
+static AMVP_RESULT amvp_build_sym_cipher_register_cap(JSON_Object *cap_obj, AMVP_CAPS_LIST *cap_entry,
+                                                      AMVP_SYM_CIPH_IVGEN_SRC ivgen_source) {
     JSON_Array *kwc_arr = NULL;
     JSON_Array *mode_arr = NULL;
     JSON_Array *opts_arr = NULL;
-    AMVP_SL_LIST *sl_list;
+    int len = 0;
     AMVP_RESULT result;
     AMVP_SYM_CIPHER_CAP *sym_cap;
     JSON_Object *tmp_obj = NULL;
@@ -509,7 +516,7 @@ static AMVP_RESULT amvp_build_sym_cipher_register_cap(JSON_Object *cap_obj, AMVP
     } else {
         ivGenLabel = AMVP_AES_IVGEN_STR;
     }
-    switch (sym_cap->ivgen_source) {
+    switch (ivgen_source) {
     case AMVP_SYM_CIPH_IVGEN_SRC_INT:
         json_object_set_string(cap_obj, ivGenLabel, "internal");
         break;
@@ -546,7 +553,7 @@ static AMVP_RESULT amvp_build_sym_cipher_register_cap(JSON_Object *cap_obj, AMVP
     }
 
     /* Set the IV generation mode if applicable */
-    if (sym_cap->ivgen_source == AMVP_SYM_CIPH_IVGEN_SRC_INT) {
+    if (ivgen_source == AMVP_SYM_CIPH_IVGEN_SRC_INT) {
         switch (sym_cap->ivgen_mode) {
         case AMVP_SYM_CIPH_IVGEN_MODE_821:
             json_object_set_string(cap_obj, "ivGenMode", "8.2.1");
@@ -582,13 +589,12 @@ static AMVP_RESULT amvp_build_sym_cipher_register_cap(JSON_Object *cap_obj, AMVP
     /*
      * Set the supported key lengths
      */
-    sl_list = sym_cap->keylen;
-    if (sl_list) {
+    if (sym_cap->keylen.count) {
         json_object_set_value(cap_obj, "keyLen", json_value_init_array());
         opts_arr = json_object_get_array(cap_obj, "keyLen");
-        while (sl_list) {
-            json_array_append_number(opts_arr, sl_list->length);
-            sl_list = sl_list->next;
+        len = -1;
+        while (amvp_value_set_next(&sym_cap->keylen, &len)) {
+            json_array_append_number(opts_arr, len);
         }
     } else {
         //If cipher is AES, we need keylengths. If TDES, we do not. 
@@ -625,10 +631,9 @@ static AMVP_RESULT amvp_build_sym_cipher_register_cap(JSON_Object *cap_obj, AMVP
           || (cap_entry->cipher == AMVP_AES_GMAC) || (cap_entry->cipher == AMVP_AES_XPN)) {
         json_object_set_value(cap_obj, "tagLen", json_value_init_array());
         opts_arr = json_object_get_array(cap_obj, "tagLen");
-        sl_list = sym_cap->taglen;
-        while (sl_list) {
-            json_array_append_number(opts_arr, sl_list->length);
-            sl_list = sl_list->next;
+        len = -1;
+        while (amvp_value_set_next(&sym_cap->taglen, &len)) {
+            json_array_append_number(opts_arr, len);
         }
     }
 
@@ -743,11 +748,10 @@ static AMVP_RESULT amvp_build_sym_cipher_register_cap(JSON_Object *cap_obj, AMVP
     default:
         json_object_set_value(cap_obj, "ivLen", json_value_init_array());
         opts_arr = json_object_get_array(cap_obj, "ivLen");
-        if (sym_cap->ivlen) {
-            sl_list = sym_cap->ivlen;
-            while (sl_list) {
-                json_array_append_number(opts_arr, sl_list->length);
-                sl_list = sl_list->next;
+        if (sym_cap->ivlen.count) {
+            len = -1;
+            while (amvp_value_set_next(&sym_cap->ivlen, &len)) {
+                json_array_append_number(opts_arr, len);
             }
         } else {
             tmp_val = json_value_init_object();
@@ -763,13 +767,12 @@ static AMVP_RESULT amvp_build_sym_cipher_register_cap(JSON_Object *cap_obj, AMVP
      * Set the supported lengths (could be pt, ct, data, etc.
      * see alg spec for more details)
      */
-    if (sym_cap->ptlen) {
+    if (sym_cap->ptlen.count) {
         json_object_set_value(cap_obj, "payloadLen", json_value_init_array());
         opts_arr = json_object_get_array(cap_obj, "payloadLen");
-        sl_list = sym_cap->ptlen;
-        while (sl_list) {
-            json_array_append_number(opts_arr, sl_list->length);
-            sl_list = sl_list->next;
+        len = -1;
+        while (amvp_value_set_next(&sym_cap->ptlen, &len)) {
+            json_array_append_number(opts_arr, len);
         }
     } else if (sym_cap->payload_len.min || sym_cap->payload_len.max ||
                 sym_cap->payload_len.increment) {
@@ -812,9 +815,9 @@ static AMVP_RESULT amvp_build_sym_cipher_register_cap(JSON_Object *cap_obj, AMVP
     if (cap_entry->cipher == AMVP_AES_XTS) {
         json_object_set_value(cap_obj, "tweakMode", json_value_init_array());
         opts_arr = json_object_get_array(cap_obj, "tweakMode");
-        sl_list = sym_cap->tweak;
-        while (sl_list) {
-            switch (sl_list->length) {
+        len = -1;
+        while (amvp_value_set_next(&sym_cap->tweak, &len)) {
+            switch (len) {
             case AMVP_SYM_CIPH_TWEAK_HEX:
                 json_array_append_string(opts_arr, "hex");
                 break;
@@ -824,7 +827,6 @@ static AMVP_RESULT amvp_build_sym_cipher_register_cap(JSON_Object *cap_obj, AMVP
             default:
                 break;
             }
-            sl_list = sl_list->next;
         }
 
         json_object_set_boolean(cap_obj, "dataUnitLenMatchesPayload", sym_cap->dulen_matches_paylen);
@@ -848,11 +850,10 @@ static AMVP_RESULT amvp_build_sym_cipher_register_cap(JSON_Object *cap_obj, AMVP
             || (cap_entry->cipher == AMVP_AES_XPN)) {
         json_object_set_value(cap_obj, "aadLen", json_value_init_array());
         opts_arr = json_object_get_array(cap_obj, "aadLen");
-        if (sym_cap->aadlen) {
-            sl_list = sym_cap->aadlen;
-            while (sl_list) {
-                json_array_append_number(opts_arr, sl_list->length);
-                sl_list = sl_list->next;
+        if (sym_cap->aadlen.count) {
+            len = -1;
+            while (amvp_value_set_next(&sym_cap->aadlen, &len)) {
+                json_array_append_number(opts_arr, len);
             }
         } else {
             tmp_val = json_value_init_object();
@@ -1310,7 +1311,31 @@ static AMVP_RESULT amvp_build_rsa_prim_register_cap(JSON_Object *cap_obj, AMVP_C
     return AMVP_SUCCESS;
 }
 
-static AMVP_RESULT amvp_build_ecdsa_register_cap(AMVP_CTX *ctx, AMVP_CIPHER cipher, JSON_Object *cap_obj, AMVP_CAPS_LIST *cap_entry) {
+/*
+ * Copies the hash algs registered for one curve into algs, adding the ones
+ * registered for every curve (universal_algs, may be NULL). The cap is left
+ * untouched; clones of a context share their caps and may build their
+ * registrations concurrently.
+ */
+static void amvp_ecdsa_curve_algs(const AMVP_CURVE_ALG_COMPAT_LIST *curve, const int *universal_algs,
+                                  AMVP_HASH_ALG *algs) {
+    int i = 0;
+
+    for (i = 0; i < AMVP_HASH_ALG_MAX; i++) {
+        algs[i] = curve->algs[i];
+        if (universal_algs && universal_algs[i]) {
+            algs[i] = 1;
+        }
+    }
+}
+
+/*
+ * component is passed in rather than read from the cap so that a sigGen or
+ * sigVer cap registered with AMVP_ECDSA_COMPONENT_MODE_BOTH can be
+ * advertised once per mode without writing to it.
+ */
+static AMVP_RESULT amvp_build_ecdsa_register_cap(AMVP_CTX *ctx, AMVP_CIPHER cipher, JSON_Object *cap_obj, AMVP_CAPS_LIST *cap_entry,
+                                                 AMVP_ECDSA_COMPONENT_MODE component) {
     AMVP_RESULT result;
     JSON_Array *caps_arr = NULL, *curves_arr = NULL, *secret_modes_arr = NULL, *hash_arr = NULL;
     AMVP_CURVE_ALG_COMPAT_LIST *current_curve = NULL, *iter = NULL;
@@ -1320,6 +1345,8 @@ static AMVP_RESULT amvp_build_ecdsa_register_cap(AMVP_CTX *ctx, AMVP_CIPHER ciph
     const char *revision = NULL, *tmp = NULL;
     int i = 0, diff = 0;
     AMVP_EC_CURVE track[AMVP_EC_CURVE_END + 1] = { 0 };
+    AMVP_HASH_ALG cur_algs[AMVP_HASH_ALG_MAX] = { 0 }, iter_algs[AMVP_HASH_ALG_MAX] = { 0 };
+    const int *universal_algs = NULL;
     AMVP_SUB_ECDSA alg;
 
     json_object_set_string(cap_obj, "algorithm", "ECDSA");
@@ -1355,21 +1382,13 @@ static AMVP_RESULT amvp_build_ecdsa_register_cap(AMVP_CTX *ctx, AMVP_CIPHER ciph
         if (!cap_entry->cap.ecdsa_siggen_cap) {
             return AMVP_NO_CAP;
         }
-        if (cap_entry->cap.ecdsa_siggen_cap->component == AMVP_ECDSA_COMPONENT_MODE_YES) {
+        if (component == AMVP_ECDSA_COMPONENT_MODE_YES) {
             json_object_set_boolean(cap_obj, "componentTest", 1);
         } else {
             json_object_set_boolean(cap_obj, "componentTest", 0);
         }
-        current_curve = cap_entry->cap.ecdsa_siggen_cap->curves;
-        //add "universally" set hash algs here instead of later to be resliant to different combos of API calls
-        while (current_curve) {
-            for (i = 0; i < AMVP_HASH_ALG_MAX; i++) {
-                if (cap_entry->cap.ecdsa_siggen_cap->hash_algs[i]) {
-                    current_curve->algs[i] = 1;
-                }
-            }
-            current_curve = current_curve->next;
-        }
+        //"universally" set hash algs are merged per curve below to be resliant to different combos of API calls
+        universal_algs = cap_entry->cap.ecdsa_siggen_cap->hash_algs;
         current_curve = cap_entry->cap.ecdsa_siggen_cap->curves;
         break;
     case AMVP_SUB_ECDSA_SIGVER:
@@ -1377,21 +1396,13 @@ static AMVP_RESULT amvp_build_ecdsa_register_cap(AMVP_CTX *ctx, AMVP_CIPHER ciph
         if (!cap_entry->cap.ecdsa_sigver_cap) {
             return AMVP_NO_CAP;
         }
-        if (cap_entry->cap.ecdsa_sigver_cap->component == AMVP_ECDSA_COMPONENT_MODE_YES) {
+        if (component == AMVP_ECDSA_COMPONENT_MODE_YES) {
             json_object_set_boolean(cap_obj, "componentTest", 1);
         } else {
             json_object_set_boolean(cap_obj, "componentTest", 0);
         }
-        current_curve = cap_entry->cap.ecdsa_sigver_cap->curves;
-        //add "universally" set hash algs here instead of later to be resliant to different combos of API calls
-        while (current_curve) {
-            for (i = 0; i < AMVP_HASH_ALG_MAX; i++) {
-                if (cap_entry->cap.ecdsa_sigver_cap->hash_algs[i]) {
-                    current_curve->algs[i] = 1;
-                }
-            }
-            current_curve = current_curve->next;
-        }
+        //"universally" set hash algs are merged per curve below to be resliant to different combos of API calls
+        universal_algs = cap_entry->cap.ecdsa_sigver_cap->hash_algs;
         current_curve = cap_entry->cap.ecdsa_sigver_cap->curves;
         break;
     default:
@@ -1475,8 +1486,9 @@ static AMVP_RESULT amvp_build_ecdsa_register_cap(AMVP_CTX *ctx, AMVP_CIPHER ciph
 
             //Add current curve and its hash algs to current obj
             json_array_append_string(curves_arr, tmp);
+            amvp_ecdsa_curve_algs(current_curve, universal_algs, cur_algs);
             for (i = 0; i < AMVP_HASH_ALG_MAX; i++) {
-                if (current_curve->algs[i]) {
+                if (cur_algs[i]) {
                     tmp = amvp_lookup_hash_alg_name(i);
                     if (!tmp) {
                         if (alg_caps_val) json_value_free(alg_caps_val);
@@ -1497,7 +1509,8 @@ static AMVP_RESULT amvp_build_ecdsa_register_cap(AMVP_CTX *ctx, AMVP_CIPHER ciph
                     iter = iter->next;
                     continue;
                 }
-                memcmp_s(current_curve->algs, sizeof(current_curve->algs), iter->algs, sizeof(iter->algs), &diff);
+                amvp_ecdsa_curve_algs(iter, universal_algs, iter_algs);
+                memcmp_s(cur_algs, sizeof(cur_algs), iter_algs, sizeof(iter_algs), &diff);
                 if (!diff) {
                     //if they have the same algs arrays, they go in the same obj in the capabilities array
                     tmp = amvp_lookup_ec_curve_name(cipher, iter->curve);
@@ -1524,7 +1537,7 @@ static AMVP_RESULT amvp_build_kdf135_snmp_register_cap(JSON_Object *cap_obj, AMV
     AMVP_RESULT result;
     JSON_Array *temp_arr = NULL;
     AMVP_NAME_LIST *current_engid;
-    AMVP_SL_LIST *current_val;
+    int len = 0;
     const char *revision = NULL;
 
     json_object_set_string(cap_obj, "algorithm", AMVP_KDF135_ALG_STR);
@@ -1550,10 +1563,9 @@ static AMVP_RESULT amvp_build_kdf135_snmp_register_cap(JSON_Object *cap_obj, AMV
     json_object_set_value(cap_obj, "passwordLength", json_value_init_array());
     temp_arr = json_object_get_array(cap_obj, "passwordLength");
 
-    current_val = cap_entry->cap.kdf135_snmp_cap->pass_lens;
-    while (current_val) {
-        json_array_append_number(temp_arr, current_val->length);
-        current_val = current_val->next;
+    len = -1;
+    while (amvp_value_set_next(&cap_entry->cap.kdf135_snmp_cap->pass_lens, &len)) {
+        json_array_append_number(temp_arr, len);
     }
 
     return AMVP_SUCCESS;
@@ -1564,7 +1576,7 @@ static AMVP_RESULT amvp_build_kdf108_mode_register(JSON_Object **mode_obj, AMVP_
     JSON_Value *tmp_val = NULL;
     JSON_Object *tmp_obj = NULL;
     AMVP_NAME_LIST *nl_obj;
-    AMVP_SL_LIST *sl_obj;
+    int len = 0;
 
     /* mac mode list */
     json_object_set_value(*mode_obj, "macMode", json_value_init_array());
@@ -1587,10 +1599,9 @@ static AMVP_RESULT amvp_build_kdf108_mode_register(JSON_Object **mode_obj, AMVP_
         json_array_append_value(tmp_arr, tmp_val);
     }
 
-    sl_obj = mode_params->supported_lens.values;
-    while (sl_obj) {
-        json_array_append_number(tmp_arr, sl_obj->length);
-        sl_obj = sl_obj->next;
+    len = -1;
+    while (amvp_value_set_next(&mode_params->supported_lens.values, &len)) {
+        json_array_append_number(tmp_arr, len);
     }
 
     /* fixed data order list */
@@ -1605,10 +1616,9 @@ static AMVP_RESULT amvp_build_kdf108_mode_register(JSON_Object **mode_obj, AMVP_
     /* counter length list */
     json_object_set_value(*mode_obj, "counterLength", json_value_init_array());
     tmp_arr = json_object_get_array(*mode_obj, "counterLength");
-    sl_obj = mode_params->counter_lens;
-    while (sl_obj) {
-        json_array_append_number(tmp_arr, sl_obj->length);
-        sl_obj = sl_obj->next;
+    len = -1;
+    while (amvp_value_set_next(&mode_params->counter_lens, &len)) {
+        json_array_append_number(tmp_arr, len);
     }
 
     json_object_set_boolean(*mode_obj, "supportsEmptyIv", mode_params->empty_iv_support);
@@ -1771,7 +1781,7 @@ static AMVP_RESULT amvp_build_kdf135_x963_register_cap(JSON_Object *cap_obj, AMV
     AMVP_RESULT result;
     JSON_Array *tmp_arr = NULL;
     AMVP_NAME_LIST *nl_obj;
-    AMVP_SL_LIST *sl_obj;
+    int len = 0;
     const char *revision = NULL;
 
     json_object_set_string(cap_obj, "algorithm", AMVP_KDF135_ALG_STR);
@@ -1797,28 +1807,25 @@ static AMVP_RESULT amvp_build_kdf135_x963_register_cap(JSON_Object *cap_obj, AMV
     /* key data length list */
     json_object_set_value(cap_obj, "keyDataLength", json_value_init_array());
     tmp_arr = json_object_get_array(cap_obj, "keyDataLength");
-    sl_obj = cap_entry->cap.kdf135_x963_cap->key_data_lengths;
-    while (sl_obj) {
-        json_array_append_number(tmp_arr, sl_obj->length);
-        sl_obj = sl_obj->next;
+    len = -1;
+    while (amvp_value_set_next(&cap_entry->cap.kdf135_x963_cap->key_data_lengths, &len)) {
+        json_array_append_number(tmp_arr, len);
     }
 
     /* field size list */
     json_object_set_value(cap_obj, "fieldSize", json_value_init_array());
     tmp_arr = json_object_get_array(cap_obj, "fieldSize");
-    sl_obj = cap_entry->cap.kdf135_x963_cap->field_sizes;
-    while (sl_obj) {
-        json_array_append_number(tmp_arr, sl_obj->length);
-        sl_obj = sl_obj->next;
+    len = -1;
+    while (amvp_value_set_next(&cap_entry->cap.kdf135_x963_cap->field_sizes, &len)) {
+        json_array_append_number(tmp_arr, len);
     }
 
     /* shared info length list */
     json_object_set_value(cap_obj, "sharedInfoLength", json_value_init_array());
     tmp_arr = json_object_get_array(cap_obj, "sharedInfoLength");
-    sl_obj = cap_entry->cap.kdf135_x963_cap->shared_info_lengths;
-    while (sl_obj) {
-        json_array_append_number(tmp_arr, sl_obj->length);
-        sl_obj = sl_obj->next;
+    len = -1;
+    while (amvp_value_set_next(&cap_entry->cap.kdf135_x963_cap->shared_info_lengths, &len)) {
+        json_array_append_number(tmp_arr, len);
     }
 
     return AMVP_SUCCESS;
@@ -1830,7 +1837,7 @@ static AMVP_RESULT amvp_build_kdf135_ikev2_register_cap(JSON_Object *cap_obj, AM
     JSON_Value *tmp_val = NULL, *alg_specs_val = NULL;
     JSON_Object *tmp_obj = NULL, *alg_specs_obj = NULL;
     AMVP_NAME_LIST *current_hash;
-    AMVP_SL_LIST *list;
+    int len = 0;
     AMVP_KDF135_IKEV2_CAP *cap = cap_entry->cap.kdf135_ikev2_cap;
     const char *revision = NULL;
 
@@ -1863,10 +1870,9 @@ static AMVP_RESULT amvp_build_kdf135_ikev2_register_cap(JSON_Object *cap_obj, AM
         json_array_append_value(tmp_arr, tmp_val);
     }
 
-    list = cap->init_nonce_len_domain.values;
-    while (list) {
-        json_array_append_number(tmp_arr, list->length);
-        list = list->next;
+    len = -1;
+    while (amvp_value_set_next(&cap->init_nonce_len_domain.values, &len)) {
+        json_array_append_number(tmp_arr, len);
     }
 
     /* responder nonce len */
@@ -1882,10 +1888,9 @@ static AMVP_RESULT amvp_build_kdf135_ikev2_register_cap(JSON_Object *cap_obj, AM
         json_array_append_value(tmp_arr, tmp_val);
     }
 
-    list = cap->respond_nonce_len_domain.values;
-    while (list) {
-        json_array_append_number(tmp_arr, list->length);
-        list = list->next;
+    len = -1;
+    while (amvp_value_set_next(&cap->respond_nonce_len_domain.values, &len)) {
+        json_array_append_number(tmp_arr, len);
     }
 
     /* Diffie Hellman shared secret len */
@@ -1901,10 +1906,9 @@ static AMVP_RESULT amvp_build_kdf135_ikev2_register_cap(JSON_Object *cap_obj, AM
         json_array_append_value(tmp_arr, tmp_val);
     }
 
-    list = cap->dh_secret_len.values;
-    while (list) {
-        json_array_append_number(tmp_arr, list->length);
-        list = list->next;
+    len = -1;
+    while (amvp_value_set_next(&cap->dh_secret_len.values, &len)) {
+        json_array_append_number(tmp_arr, len);
     }
 
     /* Derived keying material len */
@@ -1919,10 +1923,9 @@ static AMVP_RESULT amvp_build_kdf135_ikev2_register_cap(JSON_Object *cap_obj, AM
         json_object_set_number(tmp_obj, "increment", cap->key_material_len.increment);
         json_array_append_value(tmp_arr, tmp_val);
     }
-    list = cap->key_material_len.values;
-    while (list) {
-        json_array_append_number(tmp_arr, list->length);
-        list = list->next;
+    len = -1;
+    while (amvp_value_set_next(&cap->key_material_len.values, &len)) {
+        json_array_append_number(tmp_arr, len);
     }
 
     /* Array of hash algs */
@@ -2023,7 +2026,7 @@ static AMVP_RESULT amvp_build_kdf135_srtp_register_cap(JSON_Object *cap_obj, AMV
     AMVP_RESULT result;
     JSON_Array *tmp_arr = NULL;
     int i;
-    AMVP_SL_LIST *current_aes_keylen;
+    int keylen = 0;
     const char *revision = NULL;
 
     json_object_set_string(cap_obj, "algorithm", AMVP_KDF135_ALG_STR);
@@ -2039,10 +2042,9 @@ static AMVP_RESULT amvp_build_kdf135_srtp_register_cap(JSON_Object *cap_obj, AMV
 
     json_object_set_value(cap_obj, "aesKeyLength", json_value_init_array());
     tmp_arr = json_object_get_array(cap_obj, "aesKeyLength");
-    current_aes_keylen = cap_entry->cap.kdf135_srtp_cap->aes_keylens;
-    while (current_aes_keylen) {
-        json_array_append_number(tmp_arr, current_aes_keylen->length);
-        current_aes_keylen = current_aes_keylen->next;
+    keylen = -1;
+    while (amvp_value_set_next(&cap_entry->cap.kdf135_srtp_cap->aes_keylens, &keylen)) {
+        json_array_append_number(tmp_arr, keylen);
     }
 
     json_object_set_boolean(cap_obj, "supportsZeroKdr", cap_entry->cap.kdf135_srtp_cap->supports_zero_kdr);
@@ -2222,7 +2224,7 @@ static AMVP_RESULT amvp_build_kdf_tls12_register_cap(JSON_Object *cap_obj, AMVP_
 static AMVP_RESULT amvp_build_kdf_tls13_register_cap(JSON_Object *cap_obj, AMVP_CAPS_LIST *cap_entry) {
     JSON_Array *temp_arr = NULL;
     AMVP_NAME_LIST *hmac_alg_list = NULL;
-    AMVP_PARAM_LIST *run_mode_list = NULL;
+    int run_mode = 0;
     AMVP_RESULT result;
     const char *revision = NULL, *mode = NULL;
 
@@ -2251,18 +2253,17 @@ static AMVP_RESULT amvp_build_kdf_tls13_register_cap(JSON_Object *cap_obj, AMVP_
     //create the "runningMode" array and populate it
     json_object_set_value(cap_obj, "runningMode", json_value_init_array());
     temp_arr = json_object_get_array(cap_obj, "runningMode");
-    run_mode_list = cap_entry->cap.kdf_tls13_cap->running_mode;
-    while (run_mode_list) {
-        if (run_mode_list->param == AMVP_KDF_TLS13_RUN_MODE_PSK) {
+    run_mode = -1;
+    while (amvp_value_set_next(&cap_entry->cap.kdf_tls13_cap->running_mode, &run_mode)) {
+        if (run_mode == AMVP_KDF_TLS13_RUN_MODE_PSK) {
             json_array_append_string(temp_arr, AMVP_STR_KDF_TLS13_PSK);
-        } else if (run_mode_list->param == AMVP_KDF_TLS13_RUN_MODE_DHE) {
+        } else if (run_mode == AMVP_KDF_TLS13_RUN_MODE_DHE) {
             json_array_append_string(temp_arr, AMVP_STR_KDF_TLS13_DHE);
-        } else if (run_mode_list->param == AMVP_KDF_TLS13_RUN_MODE_PSK_DHE) {
+        } else if (run_mode == AMVP_KDF_TLS13_RUN_MODE_PSK_DHE) {
             json_array_append_string(temp_arr, AMVP_STR_KDF_TLS13_PSK_DHE);
         } else {
             return AMVP_INVALID_ARG;
         }
-        run_mode_list = run_mode_list->next;
     }
 
     return AMVP_SUCCESS;
@@ -2719,8 +2720,8 @@ static AMVP_RESULT amvp_build_kas_ecc_register_cap(AMVP_CTX *ctx,
     AMVP_RESULT result;
     AMVP_KAS_ECC_CAP_MODE *kas_ecc_mode;
     AMVP_KAS_ECC_CAP *kas_ecc_cap;
-    AMVP_PARAM_LIST *current_func;
-    AMVP_PARAM_LIST *current_curve;
+    int func = 0;
+    int curve = 0;
     JSON_Value *func_val = NULL;
     JSON_Object *func_obj = NULL;
     JSON_Value *sch_val = NULL;
@@ -2733,7 +2734,7 @@ static AMVP_RESULT amvp_build_kas_ecc_register_cap(AMVP_CTX *ctx,
     JSON_Object *set_obj = NULL;
     AMVP_KAS_ECC_SCHEME *current_scheme;
     AMVP_KAS_ECC_PSET *current_pset;
-    AMVP_PARAM_LIST *sha, *role;
+    int sha = 0, role = 0;
     AMVP_KAS_ECC_SET kdf;
     AMVP_KAS_ECC_SCHEMES scheme;
     int set;
@@ -2779,9 +2780,9 @@ static AMVP_RESULT amvp_build_kas_ecc_register_cap(AMVP_CTX *ctx,
 
             json_object_set_value(cap_obj, "function", json_value_init_array());
             temp_arr = json_object_get_array(cap_obj, "function");
-            current_func = kas_ecc_mode->function;
-            while (current_func) {
-                switch (current_func->param) {
+            func = -1;
+            while (amvp_value_set_next(&kas_ecc_mode->function, &func)) {
+                switch (func) {
                 case AMVP_KAS_ECC_FUNC_PARTIAL:
                     json_array_append_string(temp_arr, "partialVal");
                     break;
@@ -2801,30 +2802,28 @@ static AMVP_RESULT amvp_build_kas_ecc_register_cap(AMVP_CTX *ctx,
                     json_array_append_string(temp_arr, "fullVal");
                     break;
                 default:
-                    AMVP_LOG_ERR("Unsupported KAS-ECC function %d", current_func->param);
+                    AMVP_LOG_ERR("Unsupported KAS-ECC function %d", func);
                     return AMVP_INVALID_ARG;
 
                     break;
                 }
-                current_func = current_func->next;
             }
             json_object_set_value(cap_obj, "curve", json_value_init_array());
             temp_arr = json_object_get_array(cap_obj, "curve");
-            current_curve = kas_ecc_mode->curve;
-            while (current_curve) {
+            curve = -1;
+            while (amvp_value_set_next(&kas_ecc_mode->curve, &curve)) {
                 const char *curve_str = NULL;
 
                 curve_str = amvp_lookup_ec_curve_name(kas_ecc_cap->cipher,
-                                                      current_curve->param);
+                                                      curve);
                 if (!curve_str) {
                     AMVP_LOG_ERR("Unsupported curve %d",
-                                 current_curve->param);
+                                 curve);
                     return AMVP_INVALID_ARG;
                 }
 
                 json_array_append_string(temp_arr, curve_str);
 
-                current_curve = current_curve->next;
             }
             break;
        /* SP800-56Ar3 does not use a mode, so it is identified with NONE */
@@ -2841,9 +2840,9 @@ static AMVP_RESULT amvp_build_kas_ecc_register_cap(AMVP_CTX *ctx,
 
                 json_object_set_value(func_obj, "kasRole", json_value_init_array());
                 temp_arr = json_object_get_array(func_obj, "kasRole");
-                role = current_scheme->role;
-                while (role) {
-                    switch (role->param) {
+                role = -1;
+                while (amvp_value_set_next(&current_scheme->role, &role)) {
+                    switch (role) {
                     case AMVP_KAS_ECC_ROLE_INITIATOR:
                         json_array_append_string(temp_arr, "initiator");
                         break;
@@ -2851,12 +2850,11 @@ static AMVP_RESULT amvp_build_kas_ecc_register_cap(AMVP_CTX *ctx,
                         json_array_append_string(temp_arr, "responder");
                         break;
                     default:
-                        AMVP_LOG_ERR("Unsupported KAS-ECC role %d", role->param);
+                        AMVP_LOG_ERR("Unsupported KAS-ECC role %d", role);
                         return AMVP_INVALID_ARG;
 
                         break;
                     }
-                    role = role->next;
                 }
                 switch (scheme) {
                 case AMVP_KAS_ECC_EPHEMERAL_UNIFIED:
@@ -2881,21 +2879,20 @@ static AMVP_RESULT amvp_build_kas_ecc_register_cap(AMVP_CTX *ctx,
 
             json_object_set_value(cap_obj, "domainParameterGenerationMethods", json_value_init_array());
             temp_arr = json_object_get_array(cap_obj, "domainParameterGenerationMethods");
-            current_curve = kas_ecc_mode->curve;
-            while (current_curve) {
+            curve = -1;
+            while (amvp_value_set_next(&kas_ecc_mode->curve, &curve)) {
                 const char *curve_str = NULL;
 
                 curve_str = amvp_lookup_ec_curve_name(kas_ecc_cap->cipher,
-                                                      current_curve->param);
+                                                      curve);
                 if (!curve_str) {
                     AMVP_LOG_ERR("Unsupported curve %d",
-                                 current_curve->param);
+                                 curve);
                     return AMVP_INVALID_ARG;
                 }
 
                 json_array_append_string(temp_arr, curve_str);
 
-                current_curve = current_curve->next;
             }
             switch (kas_ecc_mode->hash) {
                 case AMVP_SHA224:
@@ -2939,9 +2936,9 @@ static AMVP_RESULT amvp_build_kas_ecc_register_cap(AMVP_CTX *ctx,
         case AMVP_KAS_ECC_MODE_COMPONENT:
             json_object_set_value(cap_obj, "function", json_value_init_array());
             temp_arr = json_object_get_array(cap_obj, "function");
-            current_func = kas_ecc_mode->function;
-            while (current_func) {
-                switch (current_func->param) {
+            func = -1;
+            while (amvp_value_set_next(&kas_ecc_mode->function, &func)) {
+                switch (func) {
                 case AMVP_KAS_ECC_FUNC_PARTIAL:
                     json_array_append_string(temp_arr, "partialVal");
                     break;
@@ -2951,12 +2948,11 @@ static AMVP_RESULT amvp_build_kas_ecc_register_cap(AMVP_CTX *ctx,
                 case AMVP_KAS_ECC_FUNC_KEYREGEN:
                 case AMVP_KAS_ECC_FUNC_FULL:
                 default:
-                    AMVP_LOG_ERR("Unsupported KAS-ECC function %d", current_func->param);
+                    AMVP_LOG_ERR("Unsupported KAS-ECC function %d", func);
                     return AMVP_INVALID_ARG;
 
                     break;
                 }
-                current_func = current_func->next;
             }
 
             sch_val = json_value_init_object();
@@ -2994,9 +2990,9 @@ static AMVP_RESULT amvp_build_kas_ecc_register_cap(AMVP_CTX *ctx,
 
                     json_object_set_value(set_obj, "hashAlg", json_value_init_array());
                     temp_arr = json_object_get_array(set_obj, "hashAlg");
-                    sha = current_pset->sha;
-                    while (sha) {
-                        switch (sha->param) {
+                    sha = -1;
+                    while (amvp_value_set_next(&current_pset->sha, &sha)) {
+                        switch (sha) {
                         case AMVP_SHA224:
                             json_array_append_string(temp_arr, "SHA2-224");
                             break;
@@ -3010,12 +3006,11 @@ static AMVP_RESULT amvp_build_kas_ecc_register_cap(AMVP_CTX *ctx,
                             json_array_append_string(temp_arr, "SHA2-512");
                             break;
                         default:
-                            AMVP_LOG_ERR("Unsupported KAS-ECC sha param %d", sha->param);
+                            AMVP_LOG_ERR("Unsupported KAS-ECC sha param %d", sha);
                             return AMVP_INVALID_ARG;
 
                             break;
                         }
-                        sha = sha->next;
                     }
                     switch (set) {
                     case AMVP_KAS_ECC_EB:
@@ -3042,9 +3037,9 @@ static AMVP_RESULT amvp_build_kas_ecc_register_cap(AMVP_CTX *ctx,
 
                 json_object_set_value(func_obj, "kasRole", json_value_init_array());
                 temp_arr = json_object_get_array(func_obj, "kasRole");
-                role = current_scheme->role;
-                while (role) {
-                    switch (role->param) {
+                role = -1;
+                while (amvp_value_set_next(&current_scheme->role, &role)) {
+                    switch (role) {
                     case AMVP_KAS_ECC_ROLE_INITIATOR:
                         json_array_append_string(temp_arr, "initiator");
                         break;
@@ -3052,12 +3047,11 @@ static AMVP_RESULT amvp_build_kas_ecc_register_cap(AMVP_CTX *ctx,
                         json_array_append_string(temp_arr, "responder");
                         break;
                     default:
-                        AMVP_LOG_ERR("Unsupported KAS-ECC role %d", role->param);
+                        AMVP_LOG_ERR("Unsupported KAS-ECC role %d", role);
                         return AMVP_INVALID_ARG;
 
                         break;
                     }
-                    role = role->next;
                 }
                 switch (kdf) {
                 case AMVP_KAS_ECC_NOKDFNOKC:
@@ -3162,7 +3156,7 @@ static AMVP_RESULT amvp_build_kas_ffc_register_cap(AMVP_CTX *ctx,
     AMVP_RESULT result;
     AMVP_KAS_FFC_CAP_MODE *kas_ffc_mode;
     AMVP_KAS_FFC_CAP *kas_ffc_cap;
-    AMVP_PARAM_LIST *current_func;
+    int func = 0;
     JSON_Value *func_val = NULL;
     JSON_Object *func_obj = NULL;
     JSON_Value *sch_val = NULL;
@@ -3175,7 +3169,7 @@ static AMVP_RESULT amvp_build_kas_ffc_register_cap(AMVP_CTX *ctx,
     JSON_Object *set_obj = NULL;
     AMVP_KAS_FFC_SCHEME *current_scheme;
     AMVP_KAS_FFC_PSET *current_pset;
-    AMVP_PARAM_LIST *sha, *role, *genmeth;
+    int sha = 0, role = 0, genmeth = 0;
     AMVP_KAS_FFC_SET kdf;
     AMVP_KAS_FFC_SCHEMES scheme;
     int set;
@@ -3213,9 +3207,9 @@ static AMVP_RESULT amvp_build_kas_ffc_register_cap(AMVP_CTX *ctx,
         case AMVP_KAS_FFC_MODE_COMPONENT:
             json_object_set_value(cap_obj, "function", json_value_init_array());
             temp_arr = json_object_get_array(cap_obj, "function");
-            current_func = kas_ffc_mode->function;
-            while (current_func) {
-                switch (current_func->param) {
+            func = -1;
+            while (amvp_value_set_next(&kas_ffc_mode->function, &func)) {
+                switch (func) {
                 case AMVP_KAS_FFC_FUNC_DPGEN:
                     json_array_append_string(temp_arr, "dpGen");
                     break;
@@ -3232,12 +3226,11 @@ static AMVP_RESULT amvp_build_kas_ffc_register_cap(AMVP_CTX *ctx,
                     json_array_append_string(temp_arr, "fullVal");
                     break;
                 default:
-                    AMVP_LOG_ERR("Unsupported KAS-FFC function %d", current_func->param);
+                    AMVP_LOG_ERR("Unsupported KAS-FFC function %d", func);
                     return AMVP_INVALID_ARG;
 
                     break;
                 }
-                current_func = current_func->next;
             }
 
             sch_val = json_value_init_object();
@@ -3265,9 +3258,9 @@ static AMVP_RESULT amvp_build_kas_ffc_register_cap(AMVP_CTX *ctx,
 
                     json_object_set_value(set_obj, "hashAlg", json_value_init_array());
                     temp_arr = json_object_get_array(set_obj, "hashAlg");
-                    sha = current_pset->sha;
-                    while (sha) {
-                        switch (sha->param) {
+                    sha = -1;
+                    while (amvp_value_set_next(&current_pset->sha, &sha)) {
+                        switch (sha) {
                         case AMVP_SHA224:
                             json_array_append_string(temp_arr, "SHA2-224");
                             break;
@@ -3281,12 +3274,11 @@ static AMVP_RESULT amvp_build_kas_ffc_register_cap(AMVP_CTX *ctx,
                             json_array_append_string(temp_arr, "SHA2-512");
                             break;
                         default:
-                            AMVP_LOG_ERR("Unsupported KAS-FFC sha param %d", sha->param);
+                            AMVP_LOG_ERR("Unsupported KAS-FFC sha param %d", sha);
                             return AMVP_INVALID_ARG;
 
                             break;
                         }
-                        sha = sha->next;
                     }
                     switch (set) {
                     case AMVP_KAS_FFC_FB:
@@ -3307,9 +3299,9 @@ static AMVP_RESULT amvp_build_kas_ffc_register_cap(AMVP_CTX *ctx,
 
                 json_object_set_value(func_obj, "kasRole", json_value_init_array());
                 temp_arr = json_object_get_array(func_obj, "kasRole");
-                role = current_scheme->role;
-                while (role) {
-                    switch (role->param) {
+                role = -1;
+                while (amvp_value_set_next(&current_scheme->role, &role)) {
+                    switch (role) {
                     case AMVP_KAS_FFC_ROLE_INITIATOR:
                         json_array_append_string(temp_arr, "initiator");
                         break;
@@ -3317,12 +3309,11 @@ static AMVP_RESULT amvp_build_kas_ffc_register_cap(AMVP_CTX *ctx,
                         json_array_append_string(temp_arr, "responder");
                         break;
                     default:
-                        AMVP_LOG_ERR("Unsupported KAS-FFC role %d", role->param);
+                        AMVP_LOG_ERR("Unsupported KAS-FFC role %d", role);
                         return AMVP_INVALID_ARG;
 
                         break;
                     }
-                    role = role->next;
                 }
                 switch (kdf) {
                 case AMVP_KAS_FFC_NOKDFNOKC:
@@ -3374,9 +3365,9 @@ static AMVP_RESULT amvp_build_kas_ffc_register_cap(AMVP_CTX *ctx,
                 scheme = current_scheme->scheme;
                 json_object_set_value(func_obj, "kasRole", json_value_init_array());
                 temp_arr = json_object_get_array(func_obj, "kasRole");
-                role = current_scheme->role;
-                while (role) {
-                    switch (role->param) {
+                role = -1;
+                while (amvp_value_set_next(&current_scheme->role, &role)) {
+                    switch (role) {
                     case AMVP_KAS_FFC_ROLE_INITIATOR:
                         json_array_append_string(temp_arr, "initiator");
                         break;
@@ -3384,12 +3375,11 @@ static AMVP_RESULT amvp_build_kas_ffc_register_cap(AMVP_CTX *ctx,
                         json_array_append_string(temp_arr, "responder");
                         break;
                     default:
-                        AMVP_LOG_ERR("Unsupported KAS-FFC role %d", role->param);
+                        AMVP_LOG_ERR("Unsupported KAS-FFC role %d", role);
                         return AMVP_INVALID_ARG;
 
                         break;
                     }
-                    role = role->next;
                 }
                 switch (scheme) {
                 case AMVP_KAS_FFC_DH_EPHEMERAL:
@@ -3451,11 +3441,11 @@ static AMVP_RESULT amvp_build_kas_ffc_register_cap(AMVP_CTX *ctx,
                     return AMVP_INVALID_ARG;
                     break;
             }
-            genmeth = kas_ffc_mode->genmeth;
             json_object_set_value(cap_obj, "domainParameterGenerationMethods", json_value_init_array());
             temp_arr = json_object_get_array(cap_obj, "domainParameterGenerationMethods");
-            while (genmeth) {
-                switch (genmeth->param) {
+            genmeth = -1;
+            while (amvp_value_set_next(&kas_ffc_mode->genmeth, &genmeth)) {
+                switch (genmeth) {
                     case AMVP_KAS_FFC_FB:
                         json_array_append_string(temp_arr, "FB");
                         break;
@@ -3494,12 +3484,11 @@ static AMVP_RESULT amvp_build_kas_ffc_register_cap(AMVP_CTX *ctx,
                         break;
 
                     default:
-                        AMVP_LOG_ERR("Unsupported KAS-FFC sha param %d", genmeth->param);
+                        AMVP_LOG_ERR("Unsupported KAS-FFC sha param %d", genmeth);
                         return AMVP_INVALID_ARG;
 
                         break;
                 }
-                genmeth = genmeth->next;
             }
             break;
 
@@ -3522,8 +3511,8 @@ static AMVP_RESULT amvp_build_kas_ifc_register_cap(AMVP_CTX *ctx,
     AMVP_RESULT result;
     const char *revision = NULL;
     AMVP_KAS_IFC_CAP *kas_ifc_cap = NULL;
-    AMVP_PARAM_LIST *current_param;
-    AMVP_SL_LIST *current_len;
+    int param = 0;
+    int len = 0;
     JSON_Value *sch_val = NULL;
     JSON_Object *sch_obj = NULL;
     JSON_Value *role_val = NULL;
@@ -3585,17 +3574,16 @@ static AMVP_RESULT amvp_build_kas_ifc_register_cap(AMVP_CTX *ctx,
 
     json_object_set_value(cap_obj, "modulo", json_value_init_array());
     temp_arr = json_object_get_array(cap_obj, "modulo");
-    current_len = kas_ifc_cap->modulo;
-    while (current_len) {
-        json_array_append_number(temp_arr, current_len->length);
-        current_len = current_len->next;
+    len = -1;
+    while (amvp_value_set_next(&kas_ifc_cap->modulo, &len)) {
+        json_array_append_number(temp_arr, len);
     }
 
     json_object_set_value(cap_obj, "keyGenerationMethods", json_value_init_array());
     temp_arr = json_object_get_array(cap_obj, "keyGenerationMethods");
-    current_param = kas_ifc_cap->keygen_method;
-    while (current_param) {
-        switch (current_param->param)
+    param = -1;
+    while (amvp_value_set_next(&kas_ifc_cap->keygen_method, &param)) {
+        switch (param)
         {
             case AMVP_KAS_IFC_RSAKPG1_BASIC:
                 json_array_append_string(temp_arr, "rsakpg1-basic");
@@ -3616,24 +3604,23 @@ static AMVP_RESULT amvp_build_kas_ifc_register_cap(AMVP_CTX *ctx,
                 json_array_append_string(temp_arr, "rsakpg2-crt");
                 break;
             default:
-                AMVP_LOG_ERR("Unsupported KAS-IFC keygen param %d", current_param->param);
+                AMVP_LOG_ERR("Unsupported KAS-IFC keygen param %d", param);
                 return AMVP_INVALID_ARG;
                 break;
         }
-        current_param = current_param->next;
     }
 
     sch_val = json_value_init_object();
     sch_obj = json_value_get_object(sch_val);
 
-    current_param = kas_ifc_cap->kas1_roles;
-    if (current_param) {
+    param = -1;
+    if (kas_ifc_cap->kas1_roles.count) {
         role_val = json_value_init_object();
         role_obj = json_value_get_object(role_val);
         json_object_set_value(role_obj, "kasRole", json_value_init_array());
         temp_arr = json_object_get_array(role_obj, "kasRole");
-        while (current_param) {
-            switch (current_param->param)
+        while (amvp_value_set_next(&kas_ifc_cap->kas1_roles, &param)) {
+            switch (param)
             {
                 case AMVP_KAS_IFC_INITIATOR:
                     json_array_append_string(temp_arr, "initiator");
@@ -3642,24 +3629,23 @@ static AMVP_RESULT amvp_build_kas_ifc_register_cap(AMVP_CTX *ctx,
                     json_array_append_string(temp_arr, "responder");
                     break;
                 default:
-                    AMVP_LOG_ERR("Unsupported KAS-IFC KAS1 role param %d", current_param->param);
+                    AMVP_LOG_ERR("Unsupported KAS-IFC KAS1 role param %d", param);
                     return AMVP_INVALID_ARG;
                     break;
             }
-            current_param = current_param->next;
         }
     }
-    if (kas_ifc_cap->kas1_roles) {
+    if (kas_ifc_cap->kas1_roles.count) {
         json_object_set_value(sch_obj, "KAS1", role_val);
     }
-    current_param = kas_ifc_cap->kas2_roles;
-    if (current_param) {
+    param = -1;
+    if (kas_ifc_cap->kas2_roles.count) {
         role_val = json_value_init_object();
         role_obj = json_value_get_object(role_val);
         json_object_set_value(role_obj, "kasRole", json_value_init_array());
         temp_arr = json_object_get_array(role_obj, "kasRole");
-        while (current_param) {
-            switch (current_param->param)
+        while (amvp_value_set_next(&kas_ifc_cap->kas2_roles, &param)) {
+            switch (param)
             {
                 case AMVP_KAS_IFC_INITIATOR:
                     json_array_append_string(temp_arr, "initiator");
@@ -3668,14 +3654,13 @@ static AMVP_RESULT amvp_build_kas_ifc_register_cap(AMVP_CTX *ctx,
                     json_array_append_string(temp_arr, "responder");
                     break;
                 default:
-                    AMVP_LOG_ERR("Unsupported KAS-IFC KAS2 role param %d", current_param->param);
+                    AMVP_LOG_ERR("Unsupported KAS-IFC KAS2 role param %d", param);
                     return AMVP_INVALID_ARG;
                     break;
             }
-            current_param = current_param->next;
         }
     }    
-    if (kas_ifc_cap->kas2_roles) {
+    if (kas_ifc_cap->kas2_roles.count) {
         json_object_set_value(sch_obj, "KAS2", role_val);
     }
     json_object_set_value(cap_obj, "scheme", sch_val);
@@ -3692,6 +3677,7 @@ static AMVP_RESULT amvp_build_kda_onestep_register_cap(AMVP_CTX *ctx,
     JSON_Object *tmp_obj = NULL;
     AMVP_NAME_LIST *tmp_name_list = NULL, *tmp_name_list2 = NULL;
     AMVP_PARAM_LIST *tmp_param_list;
+    int encoding = 0;
     const char *revision = NULL;
     const char *mode = NULL;
     char *pattern_str = NULL;
@@ -3800,9 +3786,9 @@ static AMVP_RESULT amvp_build_kda_onestep_register_cap(AMVP_CTX *ctx,
     //create the "encodings" array and populate it
     json_object_set_value(cap_obj, "encoding", json_value_init_array());
     temp_arr = json_object_get_array(cap_obj, "encoding");
-    tmp_param_list = cap_entry->cap.kda_onestep_cap->encodings;
-    while (tmp_param_list) {
-        switch (tmp_param_list->param) {
+    encoding = -1;
+    while (amvp_value_set_next(&cap_entry->cap.kda_onestep_cap->encodings, &encoding)) {
+        switch (encoding) {
         case AMVP_KDA_ENCODING_CONCAT:
             json_array_append_string(temp_arr, AMVP_KDA_ENCODING_CONCATENATION_STR);
             break;
@@ -3811,7 +3797,6 @@ static AMVP_RESULT amvp_build_kda_onestep_register_cap(AMVP_CTX *ctx,
             rv = AMVP_INVALID_ARG;
             goto err;
         }
-        tmp_param_list = tmp_param_list->next;
     }
 
     //create the "auxFunctions" array and populate it
@@ -3863,7 +3848,8 @@ static AMVP_RESULT amvp_build_kda_twostep_register_cap(AMVP_CTX *ctx,
     JSON_Object *alg_specs_counter_obj = NULL, *alg_specs_feedback_obj = NULL, *alg_specs_dpi_obj = NULL;
     AMVP_NAME_LIST *tmp_name_list = NULL;
     AMVP_PARAM_LIST *tmp_param_list;
-    AMVP_SL_LIST *list = NULL;
+    int encoding = 0;
+    int len = 0;
     const char *revision = NULL;
     const char *mode = NULL;
     char *pattern_str = NULL;
@@ -3939,10 +3925,9 @@ static AMVP_RESULT amvp_build_kda_twostep_register_cap(AMVP_CTX *ctx,
             json_array_append_value(tmp_arr, tmp_val);
         }
 
-        list = cap_entry->cap.kda_twostep_cap->aux_secret_len.values;
-        while (list) {
-            json_array_append_number(tmp_arr, list->length);
-            list = list->next;
+        len = -1;
+        while (amvp_value_set_next(&cap_entry->cap.kda_twostep_cap->aux_secret_len.values, &len)) {
+            json_array_append_number(tmp_arr, len);
         }
     } else if (!cap_entry->cap.kda_twostep_cap->revision) {
         /* Only applies if using default revision */
@@ -3954,10 +3939,10 @@ static AMVP_RESULT amvp_build_kda_twostep_register_cap(AMVP_CTX *ctx,
     common_val = json_value_init_object();
     common_obj = json_value_get_object(common_val);
 
-    //pattern string is list of pattern values separated by '||'
+    //pattern string is len of pattern values separated by '||'
     tmp_param_list = cap->patterns;
     if (!tmp_param_list) {
-        AMVP_LOG_ERR("Missing patterns list when building registration");
+        AMVP_LOG_ERR("Missing patterns len when building registration");
         rv = AMVP_UNSUPPORTED_OP;
         goto err;
     }
@@ -4014,7 +3999,7 @@ static AMVP_RESULT amvp_build_kda_twostep_register_cap(AMVP_CTX *ctx,
                       sizeof(AMVP_KDA_PATTERN_T_STR) - 1);
             break;
         default:
-            AMVP_LOG_ERR("Invalid pattern value in pattern list");
+            AMVP_LOG_ERR("Invalid pattern value in pattern len");
             rv = AMVP_INVALID_ARG;
             goto err;
         }
@@ -4029,18 +4014,17 @@ static AMVP_RESULT amvp_build_kda_twostep_register_cap(AMVP_CTX *ctx,
     //create the "encodings" array and populate it
     json_object_set_value(common_obj, "encoding", json_value_init_array());
     tmp_arr = json_object_get_array(common_obj, "encoding");
-    tmp_param_list = cap->encodings;
-    while (tmp_param_list) {
-        switch (tmp_param_list->param) {
+    encoding = -1;
+    while (amvp_value_set_next(&cap->encodings, &encoding)) {
+        switch (encoding) {
         case AMVP_KDA_ENCODING_CONCAT:
             json_array_append_string(tmp_arr, AMVP_KDA_ENCODING_CONCATENATION_STR);
             break;
         default:
-            AMVP_LOG_ERR("Invalid encoding value in encoding list");
+            AMVP_LOG_ERR("Invalid encoding value in encoding len");
             rv = AMVP_INVALID_ARG;
             goto err;
         }
-        tmp_param_list = tmp_param_list->next;
     }
 
     //create the "macSaltMethods" array and populate it
@@ -4092,7 +4076,8 @@ static AMVP_RESULT amvp_build_kda_hkdf_register_cap(AMVP_CTX *ctx,
     JSON_Object *tmp_obj = NULL;
     AMVP_NAME_LIST *tmp_name_list = NULL;
     AMVP_PARAM_LIST *tmp_param_list;
-    AMVP_SL_LIST *list = NULL;
+    int encoding = 0;
+    int len = 0;
     const char *revision = NULL;
     const char *mode = NULL;
     char *pattern_str = NULL;
@@ -4127,10 +4112,10 @@ static AMVP_RESULT amvp_build_kda_hkdf_register_cap(AMVP_CTX *ctx,
     rv = amvp_lookup_prereqVals(cap_obj, cap_entry);
     if (rv != AMVP_SUCCESS) { goto err; }
 
-    //pattern string is list of pattern values separated by '||'
+    //pattern string is len of pattern values separated by '||'
     tmp_param_list = cap->patterns;
     if (!tmp_param_list) {
-        AMVP_LOG_ERR("Missing patterns list when building registration");
+        AMVP_LOG_ERR("Missing patterns len when building registration");
         rv = AMVP_UNSUPPORTED_OP;
         goto err;
     }
@@ -4187,7 +4172,7 @@ static AMVP_RESULT amvp_build_kda_hkdf_register_cap(AMVP_CTX *ctx,
                       sizeof(AMVP_KDA_PATTERN_T_STR) - 1);
             break;
         default:
-            AMVP_LOG_ERR("Invalid pattern value in pattern list");
+            AMVP_LOG_ERR("Invalid pattern value in pattern len");
             rv = AMVP_INVALID_ARG;
             goto err;
         }
@@ -4202,18 +4187,17 @@ static AMVP_RESULT amvp_build_kda_hkdf_register_cap(AMVP_CTX *ctx,
     //create the "encodings" array and populate it
     json_object_set_value(cap_obj, "encoding", json_value_init_array());
     temp_arr = json_object_get_array(cap_obj, "encoding");
-    tmp_param_list = cap->encodings;
-    while (tmp_param_list) {
-        switch (tmp_param_list->param) {
+    encoding = -1;
+    while (amvp_value_set_next(&cap->encodings, &encoding)) {
+        switch (encoding) {
         case AMVP_KDA_ENCODING_CONCAT:
             json_array_append_string(temp_arr, AMVP_KDA_ENCODING_CONCATENATION_STR);
             break;
         default:
-            AMVP_LOG_ERR("Invalid encoding value in encoding list");
+            AMVP_LOG_ERR("Invalid encoding value in encoding len");
             rv = AMVP_INVALID_ARG;
             goto err;
         }
-        tmp_param_list = tmp_param_list->next;
     }
 
     //create the "hmacAlg" array and populate it
@@ -4269,10 +4253,9 @@ static AMVP_RESULT amvp_build_kda_hkdf_register_cap(AMVP_CTX *ctx,
             json_array_append_value(temp_arr, tmp_val);
         }
 
-        list = cap_entry->cap.kda_hkdf_cap->aux_secret_len.values;
-        while (list) {
-            json_array_append_number(temp_arr, list->length);
-            list = list->next;
+        len = -1;
+        while (amvp_value_set_next(&cap_entry->cap.kda_hkdf_cap->aux_secret_len.values, &len)) {
+            json_array_append_number(temp_arr, len);
         }
     } else if (!cap_entry->cap.kda_hkdf_cap->revision) {
         /* Only applies if using default revision */
@@ -4290,9 +4273,9 @@ static AMVP_RESULT amvp_build_kts_ifc_register_cap(AMVP_CTX *ctx,
     AMVP_RESULT result;
     const char *revision = NULL, *hash = NULL;
     AMVP_KTS_IFC_CAP *kts_ifc_cap = NULL;
-    AMVP_PARAM_LIST *current_param;
+    int param = 0;
     AMVP_KTS_IFC_SCHEMES *current_scheme;
-    AMVP_SL_LIST *current_len;
+    int len = 0;
     JSON_Value *sch_val = NULL;
     JSON_Object *sch_obj = NULL;
     JSON_Value *meth_val = NULL;
@@ -4319,17 +4302,16 @@ static AMVP_RESULT amvp_build_kts_ifc_register_cap(AMVP_CTX *ctx,
 
     json_object_set_value(cap_obj, "modulo", json_value_init_array());
     temp_arr = json_object_get_array(cap_obj, "modulo");
-    current_len = kts_ifc_cap->modulo;
-    while (current_len) {
-        json_array_append_number(temp_arr, current_len->length);
-        current_len = current_len->next;
+    len = -1;
+    while (amvp_value_set_next(&kts_ifc_cap->modulo, &len)) {
+        json_array_append_number(temp_arr, len);
     }
 
     json_object_set_value(cap_obj, "keyGenerationMethods", json_value_init_array());
     temp_arr = json_object_get_array(cap_obj, "keyGenerationMethods");
-    current_param = kts_ifc_cap->keygen_method;
-    while (current_param) {
-        switch (current_param->param)
+    param = -1;
+    while (amvp_value_set_next(&kts_ifc_cap->keygen_method, &param)) {
+        switch (param)
         {
             case AMVP_KTS_IFC_RSAKPG1_BASIC:
                 json_array_append_string(temp_arr, "rsakpg1-basic");
@@ -4350,18 +4332,17 @@ static AMVP_RESULT amvp_build_kts_ifc_register_cap(AMVP_CTX *ctx,
                 json_array_append_string(temp_arr, "rsakpg2-crt");
                 break;
             default:
-                AMVP_LOG_ERR("Unsupported KTS-IFC keygen param %d", current_param->param);
+                AMVP_LOG_ERR("Unsupported KTS-IFC keygen param %d", param);
                 return AMVP_INVALID_ARG;
                 break;
         }
-        current_param = current_param->next;
     }
 
     json_object_set_value(cap_obj, "function", json_value_init_array());
     temp_arr = json_object_get_array(cap_obj, "function");
-    current_param = kts_ifc_cap->functions;
-    while (current_param) {
-        switch (current_param->param)
+    param = -1;
+    while (amvp_value_set_next(&kts_ifc_cap->functions, &param)) {
+        switch (param)
         {
             case AMVP_KTS_IFC_KEYPAIR_GEN:
                 json_array_append_string(temp_arr, "keyPairGen");
@@ -4370,11 +4351,10 @@ static AMVP_RESULT amvp_build_kts_ifc_register_cap(AMVP_CTX *ctx,
                 json_array_append_string(temp_arr, "partialVal");
                 break;
             default:
-                AMVP_LOG_ERR("Unsupported KTS-IFC function param %d", current_param->param);
+                AMVP_LOG_ERR("Unsupported KTS-IFC function param %d", param);
                 return AMVP_INVALID_ARG;
                 break;
         }
-        current_param = current_param->next;
     }
 
     current_scheme = kts_ifc_cap->schemes;
@@ -4391,12 +4371,12 @@ static AMVP_RESULT amvp_build_kts_ifc_register_cap(AMVP_CTX *ctx,
 
         json_object_set_number(guts_obj, "l", current_scheme->l);
 
-        current_param = current_scheme->roles;
-        if (current_param) {
+        param = -1;
+        if (current_scheme->roles.count) {
             json_object_set_value(guts_obj, "kasRole", json_value_init_array());
             temp_arr = json_object_get_array(guts_obj, "kasRole");
-            while (current_param) {
-                switch (current_param->param)
+            while (amvp_value_set_next(&current_scheme->roles, &param)) {
+                switch (param)
                 {
                     case AMVP_KTS_IFC_INITIATOR:
                         json_array_append_string(temp_arr, "initiator");
@@ -4405,30 +4385,28 @@ static AMVP_RESULT amvp_build_kts_ifc_register_cap(AMVP_CTX *ctx,
                         json_array_append_string(temp_arr, "responder");
                         break;
                     default:
-                        AMVP_LOG_ERR("Unsupported KTS-IFC role param %d", current_param->param);
+                        AMVP_LOG_ERR("Unsupported KTS-IFC role param %d", param);
                         return AMVP_INVALID_ARG;
                         break;
                 }
-                current_param = current_param->next;
             }
         }
 
         meth_val = json_value_init_object();
         meth_obj = json_value_get_object(meth_val);
 
-        current_param = current_scheme->hash;
-        if (current_param) {
+        param = -1;
+        if (current_scheme->hash.count) {
             json_object_set_value(meth_obj, "hashAlgs", json_value_init_array());
             temp_arr = json_object_get_array(meth_obj, "hashAlgs");
-            while (current_param) {
-                hash = amvp_lookup_hash_alg_name(current_param->param);
+            while (amvp_value_set_next(&current_scheme->hash, &param)) {
+                hash = amvp_lookup_hash_alg_name(param);
                 if (!hash) {
-                    AMVP_LOG_ERR("Unsupported KTS-IFC sha param %d", current_param->param);
+                    AMVP_LOG_ERR("Unsupported KTS-IFC sha param %d", param);
                     return AMVP_INVALID_ARG;
                     break;
                 }
                 json_array_append_string(temp_arr, hash);
-                current_param = current_param->next;
             }
         }
         json_object_set_boolean(meth_obj, "supportsNullAssociatedData", current_scheme->null_assoc_data);
@@ -4457,7 +4435,7 @@ static AMVP_RESULT amvp_build_safe_primes_register_cap(AMVP_CTX *ctx,
     const char *revision = NULL;
     AMVP_SAFE_PRIMES_CAP *safe_primes_cap = NULL;
     AMVP_SAFE_PRIMES_CAP_MODE *safe_primes_cap_mode = NULL;
-    AMVP_PARAM_LIST *current_genmeth;
+    int genmeth = 0;
 
 
     if (cap_entry->prereq_vals) {
@@ -4490,10 +4468,10 @@ static AMVP_RESULT amvp_build_safe_primes_register_cap(AMVP_CTX *ctx,
     json_object_set_value(cap_obj, "safePrimeGroups", json_value_init_array());
     temp_arr = json_object_get_array(cap_obj, "safePrimeGroups");
 
-    current_genmeth = safe_primes_cap_mode->genmeth;
-    if (current_genmeth) {
-        while (current_genmeth) {
-            switch (current_genmeth->param) {
+    genmeth = -1;
+    if (safe_primes_cap_mode->genmeth.count) {
+        while (amvp_value_set_next(&safe_primes_cap_mode->genmeth, &genmeth)) {
+            switch (genmeth) {
                 case AMVP_SAFE_PRIMES_MODP2048:
                     json_array_append_string(temp_arr, "modp-2048");
                     break;
@@ -4525,10 +4503,9 @@ static AMVP_RESULT amvp_build_safe_primes_register_cap(AMVP_CTX *ctx,
                     json_array_append_string(temp_arr, "ffdhe8192");
                     break;
                 default:
-                    AMVP_LOG_ERR("Unsupported SAFE-PRIMES param %d", current_genmeth->param);
+                    AMVP_LOG_ERR("Unsupported SAFE-PRIMES param %d", genmeth);
                     return AMVP_INVALID_ARG;
             }
-            current_genmeth = current_genmeth->next;
         }
     }
     return AMVP_SUCCESS;
@@ -4584,21 +4561,19 @@ AMVP_RESULT amvp_build_registration_json(AMVP_CTX *ctx, JSON_Value **reg) {
                  * If we need to test both internal and external IV gen, we need two different
                  * algorithm registrations/vector sets currently.
                  */
-                if (cap_entry->cap.sym_cap->ivgen_source == AMVP_SYM_CIPH_IVGEN_SRC_EITHER) {
-                    cap_entry->cap.sym_cap->ivgen_source = AMVP_SYM_CIPH_IVGEN_SRC_INT;
-                    rv = amvp_build_sym_cipher_register_cap(cap_obj, cap_entry);
+                if (!cap_entry->cap.sym_cap) {
+                    rv = AMVP_MISSING_ARG;
+                } else if (cap_entry->cap.sym_cap->ivgen_source == AMVP_SYM_CIPH_IVGEN_SRC_EITHER) {
+                    rv = amvp_build_sym_cipher_register_cap(cap_obj, cap_entry, AMVP_SYM_CIPH_IVGEN_SRC_INT);
                     if (rv != AMVP_SUCCESS) {
-                        cap_entry->cap.sym_cap->ivgen_source = AMVP_SYM_CIPH_IVGEN_SRC_EITHER;
                         break;
                     }
                     json_array_append_value(caps_arr, cap_val);
                     cap_val = json_value_init_object();
                     cap_obj = json_value_get_object(cap_val);
-                    cap_entry->cap.sym_cap->ivgen_source = AMVP_SYM_CIPH_IVGEN_SRC_EXT;
-                    rv = amvp_build_sym_cipher_register_cap(cap_obj, cap_entry);
-                    cap_entry->cap.sym_cap->ivgen_source = AMVP_SYM_CIPH_IVGEN_SRC_EITHER;
+                    rv = amvp_build_sym_cipher_register_cap(cap_obj, cap_entry, AMVP_SYM_CIPH_IVGEN_SRC_EXT);
                 } else {
-                    rv = amvp_build_sym_cipher_register_cap(cap_obj, cap_entry);
+                    rv = amvp_build_sym_cipher_register_cap(cap_obj, cap_entry, cap_entry->cap.sym_cap->ivgen_source);
                 }
                 break;
             case AMVP_AES_GCM_SIV:
@@ -4628,7 +4603,9 @@ AMVP_RESULT amvp_build_registration_json(AMVP_CTX *ctx, JSON_Value **reg) {
             case AMVP_TDES_CFBP8:
             case AMVP_TDES_CFBP64:
             case AMVP_TDES_KW:
-                rv = amvp_build_sym_cipher_register_cap(cap_obj, cap_entry);
+                rv = amvp_build_sym_cipher_register_cap(cap_obj, cap_entry,
+                                                        cap_entry->cap.sym_cap ? cap_entry->cap.sym_cap->ivgen_source
+                                                                               : AMVP_SYM_CIPH_IVGEN_SRC_NA);
                 break;
             case AMVP_HASH_SHA1:
             case AMVP_HASH_SHA224:
@@ -4699,44 +4676,42 @@ AMVP_RESULT amvp_build_registration_json(AMVP_CTX *ctx, JSON_Value **reg) {
                 break;
             case AMVP_ECDSA_KEYGEN:
             case AMVP_ECDSA_KEYVER:
-                rv = amvp_build_ecdsa_register_cap(ctx, cap_entry->cipher, cap_obj, cap_entry);
+                rv = amvp_build_ecdsa_register_cap(ctx, cap_entry->cipher, cap_obj, cap_entry, AMVP_ECDSA_COMPONENT_MODE_NO);
                 break;
             case AMVP_ECDSA_SIGGEN:
                 /* If component_test = BOTH, we need two registrations */
-                if (cap_entry->cap.ecdsa_siggen_cap->component == AMVP_ECDSA_COMPONENT_MODE_BOTH) {
-                    cap_entry->cap.ecdsa_siggen_cap->component = AMVP_ECDSA_COMPONENT_MODE_NO;
-                    rv = amvp_build_ecdsa_register_cap(ctx, cap_entry->cipher, cap_obj, cap_entry);
+                if (!cap_entry->cap.ecdsa_siggen_cap) {
+                    rv = AMVP_NO_CAP;
+                } else if (cap_entry->cap.ecdsa_siggen_cap->component == AMVP_ECDSA_COMPONENT_MODE_BOTH) {
+                    rv = amvp_build_ecdsa_register_cap(ctx, cap_entry->cipher, cap_obj, cap_entry, AMVP_ECDSA_COMPONENT_MODE_NO);
                     if (rv != AMVP_SUCCESS) {
-                        cap_entry->cap.ecdsa_siggen_cap->component = AMVP_ECDSA_COMPONENT_MODE_BOTH;
                         break;
                     }
                     json_array_append_value(caps_arr, cap_val);
                     cap_val = json_value_init_object();
                     cap_obj = json_value_get_object(cap_val);
-                    cap_entry->cap.ecdsa_siggen_cap->component = AMVP_ECDSA_COMPONENT_MODE_YES;
-                    rv = amvp_build_ecdsa_register_cap(ctx, cap_entry->cipher, cap_obj, cap_entry);
-                    cap_entry->cap.ecdsa_siggen_cap->component = AMVP_ECDSA_COMPONENT_MODE_BOTH;
+                    rv = amvp_build_ecdsa_register_cap(ctx, cap_entry->cipher, cap_obj, cap_entry, AMVP_ECDSA_COMPONENT_MODE_YES);
                 } else {
-                    rv = amvp_build_ecdsa_register_cap(ctx, cap_entry->cipher, cap_obj, cap_entry);
+                    rv = amvp_build_ecdsa_register_cap(ctx, cap_entry->cipher, cap_obj, cap_entry,
+                                                       cap_entry->cap.ecdsa_siggen_cap->component);
                 }
                 break;
             case AMVP_ECDSA_SIGVER:
                 /* If component_test = BOTH, we need two registrations */
-                if (cap_entry->cap.ecdsa_sigver_cap->component == AMVP_ECDSA_COMPONENT_MODE_BOTH) {
-                    cap_entry->cap.ecdsa_sigver_cap->component = AMVP_ECDSA_COMPONENT_MODE_NO;
-                    rv = amvp_build_ecdsa_register_cap(ctx, cap_entry->cipher, cap_obj, cap_entry);
+                if (!cap_entry->cap.ecdsa_sigver_cap) {
+                    rv = AMVP_NO_CAP;
+                } else if (cap_entry->cap.ecdsa_sigver_cap->component == AMVP_ECDSA_COMPONENT_MODE_BOTH) {
+                    rv = amvp_build_ecdsa_register_cap(ctx, cap_entry->cipher, cap_obj, cap_entry, AMVP_ECDSA_COMPONENT_MODE_NO);
                     if (rv != AMVP_SUCCESS) {
-                        cap_entry->cap.ecdsa_sigver_cap->component = AMVP_ECDSA_COMPONENT_MODE_BOTH;
                         break;
                     }
                     json_array_append_value(caps_arr, cap_val);
                     cap_val = json_value_init_object();
                     cap_obj = json_value_get_object(cap_val);
-                    cap_entry->cap.ecdsa_sigver_cap->component = AMVP_ECDSA_COMPONENT_MODE_YES;
-                    rv = amvp_build_ecdsa_register_cap(ctx, cap_entry->cipher, cap_obj, cap_entry);
-                    cap_entry->cap.ecdsa_sigver_cap->component = AMVP_ECDSA_COMPONENT_MODE_BOTH;
+                    rv = amvp_build_ecdsa_register_cap(ctx, cap_entry->cipher, cap_obj, cap_entry, AMVP_ECDSA_COMPONENT_MODE_YES);
                 } else {
-                    rv = amvp_build_ecdsa_register_cap(ctx, cap_entry->cipher, cap_obj, cap_entry);
+                    rv = amvp_build_ecdsa_register_cap(ctx, cap_entry->cipher, cap_obj, cap_entry,
+                                                       cap_entry->cap.ecdsa_sigver_cap->component);
                 }
                 break;
             case AMVP_KDF135_SNMP:
@@ -4848,31 +4823,95 @@ AMVP_RESULT amvp_build_registration_json(AMVP_CTX *ctx, JSON_Value **reg) {
     return AMVP_SUCCESS;
 }
 
-AMVP_RESULT amvp_build_full_registration(AMVP_CTX *ctx, char **out, int *out_len) {
-    JSON_Value *top_array_val = NULL, *val = NULL;
-    JSON_Array *top_array = NULL;
-    JSON_Object *obj = NULL;
+/*
+ * Replaces the registration held on ctx, which then owns reg, and drops
+ * the serialized form of the old one.
+ */
+void amvp_set_registration(AMVP_CTX *ctx, JSON_Value *reg) {
+    if (ctx->registration && ctx->registration != reg) {
+        json_value_free(ctx->registration);
+    }
+    if (ctx->registration_str) {
+        json_free_serialized_string(ctx->registration_str);
+    }
+    ctx->registration = reg;
+    ctx->registration_str = NULL;
+    ctx->registration_len = 0;
+    ctx->registration_dirty = 0;
+}
 
-    /*
-     * Start top-level array
-     */
-    top_array_val = json_value_init_array();
-    if (!top_array_val) {
-        return AMVP_MALLOC_FAIL;
+/*
+ * Called by the amvp_cap_* setters, so the registration is rebuilt the
+ * next time it is needed.
+ */
+void amvp_registration_invalidate(AMVP_CTX *ctx) {
+    if (!ctx) {
+        return;
     }
-    top_array = json_array((const JSON_Value *)top_array_val);
+    ctx->registration_dirty = 1;
+    if (ctx->registration_str) {
+        json_free_serialized_string(ctx->registration_str);
+        ctx->registration_str = NULL;
+        ctx->registration_len = 0;
+    }
+}
 
-    val = json_value_init_object();
-    obj = json_value_get_object(val);
+/*
+ * Returns the registration of ctx's capabilities, which stays owned by
+ * ctx. It is only built again if a capability changed since the last
+ * call. A registration read from a file is returned as is.
+ */
+AMVP_RESULT amvp_get_registration(AMVP_CTX *ctx, JSON_Value **reg) {
+    JSON_Value *val = NULL;
+    AMVP_RESULT rv = AMVP_SUCCESS;
 
-    json_object_set_boolean(obj, "isSample", ctx->is_sample);
-    json_object_set_value(obj, "algorithms", ctx->registration);
+    if (!ctx) {
+        return AMVP_NO_CTX;
+    }
+    if (ctx->registration && (!ctx->registration_dirty || ctx->use_json)) {
+        *reg = ctx->registration;
+        return AMVP_SUCCESS;
+    }
+    rv = amvp_build_registration_json(ctx, &val);
+    if (rv != AMVP_SUCCESS) {
+        return rv;
+    }
+    amvp_set_registration(ctx, val);
+    *reg = val;
+    return AMVP_SUCCESS;
+}
 
-    json_array_append_value(top_array, val);
-    *out = json_serialize_to_string(top_array_val, out_len);
+AMVP_RESULT amvp_build_full_registration(AMVP_CTX *ctx, char **out, int *out_len) {
+    static const char prefix_true[] = "[{\"isSample\":true,\"algorithms\":";
+    static const char prefix_false[] = "[{\"isSample\":false,\"algorithms\":";
+    const char *prefix = ctx->is_sample ? prefix_true : prefix_false;
+    int prefix_len = ctx->is_sample ? sizeof(prefix_true) - 1 : sizeof(prefix_false) - 1;
+    int len = 0;
+
+    if (!ctx->registration) {
+        return AMVP_NO_DATA;
+    }
+    if (!ctx->registration_str) {
+        ctx->registration_str = json_serialize_to_string(ctx->registration, &ctx->registration_len);
+        if (!ctx->registration_str) {
+            return AMVP_JSON_ERR;
+        }
+    }
 
-    json_object_soft_remove(obj, "algorithms");
-    if (top_array_val) json_value_free(top_array_val);
+    /*
+     * Same output as serializing the top level array with the cached
+     * registration in it, without walking the registration again. The
+     * caller frees the result with free().
+     */
+    len = prefix_len + ctx->registration_len + 2;
+    *out = malloc(len + 1);
+    if (!*out) {
+        return AMVP_MALLOC_FAIL;
+    }
+    memcpy_s(*out, len + 1, prefix, prefix_len);
+    memcpy_s(*out + prefix_len, len + 1 - prefix_len, ctx->registration_str, ctx->registration_len);
+    memcpy_s(*out + prefix_len + ctx->registration_len, 3, "}]", 3);
+    if (out_len) *out_len = len;
     return AMVP_SUCCESS;
 }
 
@@ -28,19 +28,37 @@ static AMVP_RESULT validate_domain_range(int min, int max, int inc) {
     return AMVP_SUCCESS;
 }
 
-static AMVP_DSA_CAP *allocate_dsa_cap(void) {
+/*
+ * Setters change the entry they find here, so it refuses to hand one out
+ * while the capabilities are shared with a clone, and marks the cached
+ * registration as out of date when it does
+ */
+static AMVP_CAPS_LIST *amvp_cap_entry_for_update(AMVP_CTX *ctx, AMVP_CIPHER cipher) {
+    AMVP_CAPS_LIST *cap_list = NULL;
+
+    if (amvp_cap_store_shared(ctx)) {
+        AMVP_LOG_ERR("Capabilities are shared with a cloned context and can't be changed");
+        return NULL;
+    }
+    cap_list = amvp_locate_cap_entry(ctx, cipher);
+    if (cap_list) {
+        amvp_registration_invalidate(ctx);
+    }
+    return cap_list;
+}
+
+static AMVP_DSA_CAP *allocate_dsa_cap(AMVP_CTX *ctx) {
     AMVP_DSA_CAP *cap = NULL;
     AMVP_DSA_CAP_MODE *modes = NULL;
     int i = 0;
 
     // Allocate the capability object
-    cap = calloc(1, sizeof(AMVP_DSA_CAP));
+    cap = amvp_cap_alloc(ctx, sizeof(AMVP_DSA_CAP));
     if (!cap) return NULL;
 
     // Allocate the array of dsa_mode
-    modes = calloc(AMVP_DSA_MAX_MODES, sizeof(AMVP_DSA_CAP_MODE));
+    modes = amvp_cap_alloc(ctx, AMVP_DSA_MAX_MODES * sizeof(AMVP_DSA_CAP_MODE));
     if (!modes) {
-        free(cap);
         return NULL;
     }
     cap->dsa_cap_mode = modes;
@@ -56,19 +74,18 @@ static AMVP_DSA_CAP *allocate_dsa_cap(void) {
     return cap;
 }
 
-static AMVP_KAS_ECC_CAP *allocate_kas_ecc_cap(void) {
+static AMVP_KAS_ECC_CAP *allocate_kas_ecc_cap(AMVP_CTX *ctx) {
     AMVP_KAS_ECC_CAP *cap = NULL;
     AMVP_KAS_ECC_CAP_MODE *modes = NULL;
     int i = 0;
 
-    cap = calloc(1, sizeof(AMVP_KAS_ECC_CAP));
+    cap = amvp_cap_alloc(ctx, sizeof(AMVP_KAS_ECC_CAP));
     if (!cap) {
         return NULL;
     }
 
-    modes = calloc(AMVP_KAS_ECC_MAX_MODES, sizeof(AMVP_KAS_ECC_CAP_MODE));
+    modes = amvp_cap_alloc(ctx, AMVP_KAS_ECC_MAX_MODES * sizeof(AMVP_KAS_ECC_CAP_MODE));
     if (!modes) {
-        free(cap);
         return NULL;
     }
     cap->kas_ecc_mode = (AMVP_KAS_ECC_CAP_MODE *)modes;
@@ -80,19 +97,18 @@ static AMVP_KAS_ECC_CAP *allocate_kas_ecc_cap(void) {
     return cap;
 }
 
-static AMVP_KAS_FFC_CAP *allocate_kas_ffc_cap(void) {
+static AMVP_KAS_FFC_CAP *allocate_kas_ffc_cap(AMVP_CTX *ctx) {
     AMVP_KAS_FFC_CAP *cap = NULL;
     AMVP_KAS_FFC_MODE *modes = NULL;
     int i = 0;
 
-    cap = calloc(1, sizeof(AMVP_KAS_FFC_CAP));
+    cap = amvp_cap_alloc(ctx, sizeof(AMVP_KAS_FFC_CAP));
     if (!cap) {
         return NULL;
     }
 
-    modes = calloc(AMVP_KAS_FFC_MAX_MODES, sizeof(AMVP_KAS_FFC_CAP_MODE));
+    modes = amvp_cap_alloc(ctx, AMVP_KAS_FFC_MAX_MODES * sizeof(AMVP_KAS_FFC_CAP_MODE));
     if (!modes) {
-        free(cap);
         return NULL;
     }
 
@@ -104,10 +120,10 @@ static AMVP_KAS_FFC_CAP *allocate_kas_ffc_cap(void) {
     return cap;
 }
 
-static AMVP_KAS_IFC_CAP *allocate_kas_ifc_cap(void) {
+static AMVP_KAS_IFC_CAP *allocate_kas_ifc_cap(AMVP_CTX *ctx) {
     AMVP_KAS_IFC_CAP *cap = NULL;
 
-    cap = calloc(1, sizeof(AMVP_KAS_IFC_CAP));
+    cap = amvp_cap_alloc(ctx, sizeof(AMVP_KAS_IFC_CAP));
     if (!cap) {
         return NULL;
     }
@@ -115,10 +131,10 @@ static AMVP_KAS_IFC_CAP *allocate_kas_ifc_cap(void) {
     return cap;
 }
 
-static AMVP_KTS_IFC_CAP *allocate_kts_ifc_cap(void) {
+static AMVP_KTS_IFC_CAP *allocate_kts_ifc_cap(AMVP_CTX *ctx) {
     AMVP_KTS_IFC_CAP *cap = NULL;
 
-    cap = calloc(1, sizeof(AMVP_KTS_IFC_CAP));
+    cap = amvp_cap_alloc(ctx, sizeof(AMVP_KTS_IFC_CAP));
     if (!cap) {
         return NULL;
     }
@@ -126,10 +142,10 @@ static AMVP_KTS_IFC_CAP *allocate_kts_ifc_cap(void) {
     return cap;
 }
 
-static AMVP_SAFE_PRIMES_CAP *allocate_safe_primes_cap(void) {
+static AMVP_SAFE_PRIMES_CAP *allocate_safe_primes_cap(AMVP_CTX *ctx) {
     AMVP_SAFE_PRIMES_CAP *cap = NULL;
 
-    cap = calloc(1, sizeof(AMVP_SAFE_PRIMES_CAP));
+    cap = amvp_cap_alloc(ctx, sizeof(AMVP_SAFE_PRIMES_CAP));
     if (!cap) {
         return NULL;
     }
@@ -158,6 +174,11 @@ static AMVP_RESULT amvp_cap_list_append(AMVP_CTX *ctx,
     AMVP_CAPS_LIST *cap_entry, *cap_e2;
     AMVP_RESULT rv = AMVP_SUCCESS;
 
+    if (amvp_cap_store_shared(ctx)) {
+        AMVP_LOG_ERR("Capabilities are shared with a cloned context and can't be changed");
+        return AMVP_UNSUPPORTED_OP;
+    }
+
     /*
      * Check for duplicate entry
      */
@@ -165,14 +186,14 @@ static AMVP_RESULT amvp_cap_list_append(AMVP_CTX *ctx,
         return AMVP_DUP_CIPHER;
     }
 
-    cap_entry = calloc(1, sizeof(AMVP_CAPS_LIST));
+    cap_entry = amvp_cap_alloc(ctx, sizeof(AMVP_CAPS_LIST));
     if (!cap_entry) {
         return AMVP_MALLOC_FAIL;
     }
 
     switch (type) {
     case AMVP_CMAC_TYPE:
-        cap_entry->cap.cmac_cap = calloc(1, sizeof(AMVP_CMAC_CAP));
+        cap_entry->cap.cmac_cap = amvp_cap_alloc(ctx, sizeof(AMVP_CMAC_CAP));
         if (!cap_entry->cap.cmac_cap) {
             rv = AMVP_MALLOC_FAIL;
             goto err;
@@ -180,7 +201,7 @@ static AMVP_RESULT amvp_cap_list_append(AMVP_CTX *ctx,
         break;
 
     case AMVP_KMAC_TYPE:
-        cap_entry->cap.kmac_cap = calloc(1, sizeof(AMVP_KMAC_CAP));
+        cap_entry->cap.kmac_cap = amvp_cap_alloc(ctx, sizeof(AMVP_KMAC_CAP));
         if (!cap_entry->cap.kmac_cap) {
             rv = AMVP_MALLOC_FAIL;
             goto err;
@@ -188,7 +209,7 @@ static AMVP_RESULT amvp_cap_list_append(AMVP_CTX *ctx,
         break;
 
     case AMVP_DRBG_TYPE:
-        cap_entry->cap.drbg_cap = calloc(1, sizeof(AMVP_DRBG_CAP));
+        cap_entry->cap.drbg_cap = amvp_cap_alloc(ctx, sizeof(AMVP_DRBG_CAP));
         if (!cap_entry->cap.drbg_cap) {
             rv = AMVP_MALLOC_FAIL;
             goto err;
@@ -196,7 +217,7 @@ static AMVP_RESULT amvp_cap_list_append(AMVP_CTX *ctx,
         break;
 
     case AMVP_DSA_TYPE:
-        cap_entry->cap.dsa_cap = allocate_dsa_cap();
+        cap_entry->cap.dsa_cap = allocate_dsa_cap(ctx);
         if (!cap_entry->cap.dsa_cap) {
             rv = AMVP_MALLOC_FAIL;
             goto err;
@@ -208,7 +229,7 @@ static AMVP_RESULT amvp_cap_list_append(AMVP_CTX *ctx,
             rv = AMVP_INVALID_ARG;
             goto err;
         }
-        cap_entry->cap.ecdsa_keygen_cap = calloc(1, sizeof(AMVP_ECDSA_CAP));
+        cap_entry->cap.ecdsa_keygen_cap = amvp_cap_alloc(ctx, sizeof(AMVP_ECDSA_CAP));
         if (!cap_entry->cap.ecdsa_keygen_cap) {
             rv = AMVP_MALLOC_FAIL;
             goto err;
@@ -220,7 +241,7 @@ static AMVP_RESULT amvp_cap_list_append(AMVP_CTX *ctx,
             rv = AMVP_INVALID_ARG;
             goto err;
         }
-        cap_entry->cap.ecdsa_keyver_cap = calloc(1, sizeof(AMVP_ECDSA_CAP));
+        cap_entry->cap.ecdsa_keyver_cap = amvp_cap_alloc(ctx, sizeof(AMVP_ECDSA_CAP));
         if (!cap_entry->cap.ecdsa_keyver_cap) {
             rv = AMVP_MALLOC_FAIL;
             goto err;
@@ -232,7 +253,7 @@ static AMVP_RESULT amvp_cap_list_append(AMVP_CTX *ctx,
             rv = AMVP_INVALID_ARG;
             goto err;
         }
-        cap_entry->cap.ecdsa_siggen_cap = calloc(1, sizeof(AMVP_ECDSA_CAP));
+        cap_entry->cap.ecdsa_siggen_cap = amvp_cap_alloc(ctx, sizeof(AMVP_ECDSA_CAP));
         if (!cap_entry->cap.ecdsa_siggen_cap) {
             rv = AMVP_MALLOC_FAIL;
             goto err;
@@ -244,7 +265,7 @@ static AMVP_RESULT amvp_cap_list_append(AMVP_CTX *ctx,
             rv = AMVP_INVALID_ARG;
             goto err;
         }
-        cap_entry->cap.ecdsa_sigver_cap = calloc(1, sizeof(AMVP_ECDSA_CAP));
+        cap_entry->cap.ecdsa_sigver_cap = amvp_cap_alloc(ctx, sizeof(AMVP_ECDSA_CAP));
         if (!cap_entry->cap.ecdsa_sigver_cap) {
             rv = AMVP_MALLOC_FAIL;
             goto err;
@@ -252,7 +273,7 @@ static AMVP_RESULT amvp_cap_list_append(AMVP_CTX *ctx,
         break;
 
     case AMVP_HASH_TYPE:
-        cap_entry->cap.hash_cap = calloc(1, sizeof(AMVP_HASH_CAP));
+        cap_entry->cap.hash_cap = amvp_cap_alloc(ctx, sizeof(AMVP_HASH_CAP));
         if (!cap_entry->cap.hash_cap) {
             rv = AMVP_MALLOC_FAIL;
             goto err;
@@ -260,7 +281,7 @@ static AMVP_RESULT amvp_cap_list_append(AMVP_CTX *ctx,
         break;
 
     case AMVP_HMAC_TYPE:
-        cap_entry->cap.hmac_cap = calloc(1, sizeof(AMVP_HMAC_CAP));
+        cap_entry->cap.hmac_cap = amvp_cap_alloc(ctx, sizeof(AMVP_HMAC_CAP));
         if (!cap_entry->cap.hmac_cap) {
             rv = AMVP_MALLOC_FAIL;
             goto err;
@@ -272,7 +293,7 @@ static AMVP_RESULT amvp_cap_list_append(AMVP_CTX *ctx,
             rv = AMVP_INVALID_ARG;
             goto err;
         }
-        cap_entry->cap.kas_ecc_cap = allocate_kas_ecc_cap();
+        cap_entry->cap.kas_ecc_cap = allocate_kas_ecc_cap(ctx);
         if (!cap_entry->cap.kas_ecc_cap) {
             rv = AMVP_MALLOC_FAIL;
             goto err;
@@ -284,7 +305,7 @@ static AMVP_RESULT amvp_cap_list_append(AMVP_CTX *ctx,
             rv = AMVP_INVALID_ARG;
             goto err;
         }
-        cap_entry->cap.kas_ecc_cap = allocate_kas_ecc_cap();
+        cap_entry->cap.kas_ecc_cap = allocate_kas_ecc_cap(ctx);
         if (!cap_entry->cap.kas_ecc_cap) {
             rv = AMVP_MALLOC_FAIL;
             goto err;
@@ -296,7 +317,7 @@ static AMVP_RESULT amvp_cap_list_append(AMVP_CTX *ctx,
             rv = AMVP_INVALID_ARG;
             goto err;
         }
-        cap_entry->cap.kas_ecc_cap = allocate_kas_ecc_cap();
+        cap_entry->cap.kas_ecc_cap = allocate_kas_ecc_cap(ctx);
         if (!cap_entry->cap.kas_ecc_cap) {
             rv = AMVP_MALLOC_FAIL;
             goto err;
@@ -308,7 +329,7 @@ static AMVP_RESULT amvp_cap_list_append(AMVP_CTX *ctx,
             rv = AMVP_INVALID_ARG;
             goto err;
         }
-        cap_entry->cap.kas_ecc_cap = allocate_kas_ecc_cap();
+        cap_entry->cap.kas_ecc_cap = allocate_kas_ecc_cap(ctx);
         if (!cap_entry->cap.kas_ecc_cap) {
             rv = AMVP_MALLOC_FAIL;
             goto err;
@@ -320,7 +341,7 @@ static AMVP_RESULT amvp_cap_list_append(AMVP_CTX *ctx,
             rv = AMVP_INVALID_ARG;
             goto err;
         }
-        cap_entry->cap.kas_ffc_cap = allocate_kas_ffc_cap();
+        cap_entry->cap.kas_ffc_cap = allocate_kas_ffc_cap(ctx);
         if (!cap_entry->cap.kas_ffc_cap) {
             rv = AMVP_MALLOC_FAIL;
             goto err;
@@ -331,7 +352,7 @@ static AMVP_RESULT amvp_cap_list_append(AMVP_CTX *ctx,
             rv = AMVP_INVALID_ARG;
             goto err;
         }
-        cap_entry->cap.kas_ffc_cap = allocate_kas_ffc_cap();
+        cap_entry->cap.kas_ffc_cap = allocate_kas_ffc_cap(ctx);
         if (!cap_entry->cap.kas_ffc_cap) {
             rv = AMVP_MALLOC_FAIL;
             goto err;
@@ -343,7 +364,7 @@ static AMVP_RESULT amvp_cap_list_append(AMVP_CTX *ctx,
             rv = AMVP_INVALID_ARG;
             goto err;
         }
-        cap_entry->cap.kas_ffc_cap = allocate_kas_ffc_cap();
+        cap_entry->cap.kas_ffc_cap = allocate_kas_ffc_cap(ctx);
         if (!cap_entry->cap.kas_ffc_cap) {
             rv = AMVP_MALLOC_FAIL;
             goto err;
@@ -355,7 +376,7 @@ static AMVP_RESULT amvp_cap_list_append(AMVP_CTX *ctx,
             rv = AMVP_INVALID_ARG;
             goto err;
         }
-        cap_entry->cap.kda_hkdf_cap = calloc(1, sizeof(AMVP_KDA_HKDF_CAP));
+        cap_entry->cap.kda_hkdf_cap = amvp_cap_alloc(ctx, sizeof(AMVP_KDA_HKDF_CAP));
         if (!cap_entry->cap.kda_hkdf_cap) {
             rv = AMVP_MALLOC_FAIL;
             goto err;
@@ -367,7 +388,7 @@ static AMVP_RESULT amvp_cap_list_append(AMVP_CTX *ctx,
             rv = AMVP_INVALID_ARG;
             goto err;
         }
-        cap_entry->cap.kda_onestep_cap = calloc(1, sizeof(AMVP_KDA_ONESTEP_CAP));
+        cap_entry->cap.kda_onestep_cap = amvp_cap_alloc(ctx, sizeof(AMVP_KDA_ONESTEP_CAP));
         if (!cap_entry->cap.kda_onestep_cap) {
             rv = AMVP_MALLOC_FAIL;
             goto err;
@@ -379,7 +400,7 @@ static AMVP_RESULT amvp_cap_list_append(AMVP_CTX *ctx,
             rv = AMVP_INVALID_ARG;
             goto err;
         }
-        cap_entry->cap.kda_twostep_cap = calloc(1, sizeof(AMVP_KDA_TWOSTEP_CAP));
+        cap_entry->cap.kda_twostep_cap = amvp_cap_alloc(ctx, sizeof(AMVP_KDA_TWOSTEP_CAP));
         if (!cap_entry->cap.kda_twostep_cap) {
             rv = AMVP_MALLOC_FAIL;
             goto err;
@@ -391,7 +412,7 @@ static AMVP_RESULT amvp_cap_list_append(AMVP_CTX *ctx,
             rv = AMVP_INVALID_ARG;
             goto err;
         }
-        cap_entry->cap.kas_ifc_cap = allocate_kas_ifc_cap();
+        cap_entry->cap.kas_ifc_cap = allocate_kas_ifc_cap(ctx);
         if (!cap_entry->cap.kas_ifc_cap) {
             rv = AMVP_MALLOC_FAIL;
             goto err;
@@ -403,7 +424,7 @@ static AMVP_RESULT amvp_cap_list_append(AMVP_CTX *ctx,
             rv = AMVP_INVALID_ARG;
             goto err;
         }
-        cap_entry->cap.kts_ifc_cap = allocate_kts_ifc_cap();
+        cap_entry->cap.kts_ifc_cap = allocate_kts_ifc_cap(ctx);
         if (!cap_entry->cap.kts_ifc_cap) {
             rv = AMVP_MALLOC_FAIL;
             goto err;
@@ -415,7 +436,7 @@ static AMVP_RESULT amvp_cap_list_append(AMVP_CTX *ctx,
             rv = AMVP_INVALID_ARG;
             goto err;
         }
-        cap_entry->cap.kdf108_cap = calloc(1, sizeof(AMVP_KDF108_CAP));
+        cap_entry->cap.kdf108_cap = amvp_cap_alloc(ctx, sizeof(AMVP_KDF108_CAP));
         if (!cap_entry->cap.kdf108_cap) {
             rv = AMVP_MALLOC_FAIL;
             goto err;
@@ -427,7 +448,7 @@ static AMVP_RESULT amvp_cap_list_append(AMVP_CTX *ctx,
             rv = AMVP_INVALID_ARG;
             goto err;
         }
-        cap_entry->cap.kdf135_ikev1_cap = calloc(1, sizeof(AMVP_KDF135_IKEV1_CAP));
+        cap_entry->cap.kdf135_ikev1_cap = amvp_cap_alloc(ctx, sizeof(AMVP_KDF135_IKEV1_CAP));
         if (!cap_entry->cap.kdf135_ikev1_cap) {
             rv = AMVP_MALLOC_FAIL;
             goto err;
@@ -439,7 +460,7 @@ static AMVP_RESULT amvp_cap_list_append(AMVP_CTX *ctx,
             rv = AMVP_INVALID_ARG;
             goto err;
         }
-        cap_entry->cap.kdf135_ikev2_cap = calloc(1, sizeof(AMVP_KDF135_IKEV2_CAP));
+        cap_entry->cap.kdf135_ikev2_cap = amvp_cap_alloc(ctx, sizeof(AMVP_KDF135_IKEV2_CAP));
         if (!cap_entry->cap.kdf135_ikev2_cap) {
             rv = AMVP_MALLOC_FAIL;
             goto err;
@@ -451,7 +472,7 @@ static AMVP_RESULT amvp_cap_list_append(AMVP_CTX *ctx,
             rv = AMVP_INVALID_ARG;
             goto err;
         }
-        cap_entry->cap.kdf135_snmp_cap = calloc(1, sizeof(AMVP_KDF135_SNMP_CAP));
+        cap_entry->cap.kdf135_snmp_cap = amvp_cap_alloc(ctx, sizeof(AMVP_KDF135_SNMP_CAP));
         if (!cap_entry->cap.kdf135_snmp_cap) {
             rv = AMVP_MALLOC_FAIL;
             goto err;
@@ -463,7 +484,7 @@ static AMVP_RESULT amvp_cap_list_append(AMVP_CTX *ctx,
             rv = AMVP_INVALID_ARG;
             goto err;
         }
-        cap_entry->cap.kdf135_srtp_cap = calloc(1, sizeof(AMVP_KDF135_SRTP_CAP));
+        cap_entry->cap.kdf135_srtp_cap = amvp_cap_alloc(ctx, sizeof(AMVP_KDF135_SRTP_CAP));
         if (!cap_entry->cap.kdf135_srtp_cap) {
             rv = AMVP_MALLOC_FAIL;
             goto err;
@@ -475,7 +496,7 @@ static AMVP_RESULT amvp_cap_list_append(AMVP_CTX *ctx,
             rv = AMVP_INVALID_ARG;
             goto err;
         }
-        cap_entry->cap.kdf135_ssh_cap = calloc(1, sizeof(AMVP_KDF135_SSH_CAP));
+        cap_entry->cap.kdf135_ssh_cap = amvp_cap_alloc(ctx, sizeof(AMVP_KDF135_SSH_CAP));
         if (!cap_entry->cap.kdf135_ssh_cap) {
             rv = AMVP_MALLOC_FAIL;
             goto err;
@@ -487,7 +508,7 @@ static AMVP_RESULT amvp_cap_list_append(AMVP_CTX *ctx,
             rv = AMVP_INVALID_ARG;
             goto err;
         }
-        cap_entry->cap.kdf135_x942_cap = calloc(1, sizeof(AMVP_KDF135_X942_CAP));
+        cap_entry->cap.kdf135_x942_cap = amvp_cap_alloc(ctx, sizeof(AMVP_KDF135_X942_CAP));
         if (!cap_entry->cap.kdf135_x942_cap) {
             rv = AMVP_MALLOC_FAIL;
             goto err;
@@ -499,7 +520,7 @@ static AMVP_RESULT amvp_cap_list_append(AMVP_CTX *ctx,
             rv = AMVP_INVALID_ARG;
             goto err;
         }
-        cap_entry->cap.kdf135_x963_cap = calloc(1, sizeof(AMVP_KDF135_X963_CAP));
+        cap_entry->cap.kdf135_x963_cap = amvp_cap_alloc(ctx, sizeof(AMVP_KDF135_X963_CAP));
         if (!cap_entry->cap.kdf135_x963_cap) {
             rv = AMVP_MALLOC_FAIL;
             goto err;
@@ -511,7 +532,7 @@ static AMVP_RESULT amvp_cap_list_append(AMVP_CTX *ctx,
             rv = AMVP_INVALID_ARG;
             goto err;
         }
-        cap_entry->cap.pbkdf_cap = calloc(1, sizeof(AMVP_PBKDF_CAP));
+        cap_entry->cap.pbkdf_cap = amvp_cap_alloc(ctx, sizeof(AMVP_PBKDF_CAP));
         if (!cap_entry->cap.pbkdf_cap) {
             rv = AMVP_MALLOC_FAIL;
             goto err;
@@ -523,7 +544,7 @@ static AMVP_RESULT amvp_cap_list_append(AMVP_CTX *ctx,
             rv = AMVP_INVALID_ARG;
             goto err;
         }
-        cap_entry->cap.kdf_tls12_cap = calloc(1, sizeof(AMVP_KDF_TLS12_CAP));
+        cap_entry->cap.kdf_tls12_cap = amvp_cap_alloc(ctx, sizeof(AMVP_KDF_TLS12_CAP));
         if (!cap_entry->cap.kdf_tls12_cap) {
             rv = AMVP_MALLOC_FAIL;
             goto err;
@@ -535,7 +556,7 @@ static AMVP_RESULT amvp_cap_list_append(AMVP_CTX *ctx,
             rv = AMVP_INVALID_ARG;
             goto err;
         }
-        cap_entry->cap.kdf_tls13_cap = calloc(1, sizeof(AMVP_KDF_TLS13_CAP));
+        cap_entry->cap.kdf_tls13_cap = amvp_cap_alloc(ctx, sizeof(AMVP_KDF_TLS13_CAP));
         if (!cap_entry->cap.kdf_tls13_cap) {
             rv = AMVP_MALLOC_FAIL;
             goto err;
@@ -547,7 +568,7 @@ static AMVP_RESULT amvp_cap_list_append(AMVP_CTX *ctx,
             rv = AMVP_INVALID_ARG;
             goto err;
         }
-        cap_entry->cap.rsa_keygen_cap = calloc(1, sizeof(AMVP_RSA_KEYGEN_CAP));
+        cap_entry->cap.rsa_keygen_cap = amvp_cap_alloc(ctx, sizeof(AMVP_RSA_KEYGEN_CAP));
         if (!cap_entry->cap.rsa_keygen_cap) {
             rv = AMVP_MALLOC_FAIL;
             goto err;
@@ -559,7 +580,7 @@ static AMVP_RESULT amvp_cap_list_append(AMVP_CTX *ctx,
             rv = AMVP_INVALID_ARG;
             goto err;
         }
-        cap_entry->cap.rsa_siggen_cap = calloc(1, sizeof(AMVP_RSA_SIG_CAP));
+        cap_entry->cap.rsa_siggen_cap = amvp_cap_alloc(ctx, sizeof(AMVP_RSA_SIG_CAP));
         if (!cap_entry->cap.rsa_siggen_cap) {
             rv = AMVP_MALLOC_FAIL;
             goto err;
@@ -570,7 +591,7 @@ static AMVP_RESULT amvp_cap_list_append(AMVP_CTX *ctx,
             rv = AMVP_INVALID_ARG;
             goto err;
         }
-        cap_entry->cap.rsa_sigver_cap = calloc(1, sizeof(AMVP_RSA_SIG_CAP));
+        cap_entry->cap.rsa_sigver_cap = amvp_cap_alloc(ctx, sizeof(AMVP_RSA_SIG_CAP));
         if (!cap_entry->cap.rsa_sigver_cap) {
             rv = AMVP_MALLOC_FAIL;
             goto err;
@@ -581,14 +602,14 @@ static AMVP_RESULT amvp_cap_list_append(AMVP_CTX *ctx,
             rv = AMVP_INVALID_ARG;
             goto err;
         }
-        cap_entry->cap.rsa_prim_cap = calloc(1, sizeof(AMVP_RSA_PRIM_CAP));
+        cap_entry->cap.rsa_prim_cap = amvp_cap_alloc(ctx, sizeof(AMVP_RSA_PRIM_CAP));
         if (!cap_entry->cap.rsa_prim_cap) {
             rv = AMVP_MALLOC_FAIL;
             goto err;
         }
         break;
     case AMVP_SYM_TYPE:
-        cap_entry->cap.sym_cap = calloc(1, sizeof(AMVP_SYM_CIPHER_CAP));
+        cap_entry->cap.sym_cap = amvp_cap_alloc(ctx, sizeof(AMVP_SYM_CIPHER_CAP));
         if (!cap_entry->cap.sym_cap) {
             rv = AMVP_MALLOC_FAIL;
             goto err;
@@ -598,7 +619,7 @@ static AMVP_RESULT amvp_cap_list_append(AMVP_CTX *ctx,
         break;
 
     case AMVP_SAFE_PRIMES_KEYGEN_TYPE:
-        cap_entry->cap.safe_primes_keygen_cap = allocate_safe_primes_cap();
+        cap_entry->cap.safe_primes_keygen_cap = allocate_safe_primes_cap(ctx);
         if (!cap_entry->cap.safe_primes_keygen_cap) {
             rv = AMVP_MALLOC_FAIL;
             goto err;
@@ -606,7 +627,7 @@ static AMVP_RESULT amvp_cap_list_append(AMVP_CTX *ctx,
         break;
 
     case AMVP_SAFE_PRIMES_KEYVER_TYPE:
-        cap_entry->cap.safe_primes_keyver_cap = allocate_safe_primes_cap();
+        cap_entry->cap.safe_primes_keyver_cap = allocate_safe_primes_cap(ctx);
         if (!cap_entry->cap.safe_primes_keyver_cap) {
             rv = AMVP_MALLOC_FAIL;
             goto err;
@@ -635,14 +656,14 @@ static AMVP_RESULT amvp_cap_list_append(AMVP_CTX *ctx,
         }
         cap_e2->next = cap_entry;
     }
+    ctx->caps_tbl[cipher] = cap_entry;
 
     /* Assume here one cap = one vector set; for special cases we will handle those as the parameter is set */
     ctx->vs_count++;
     return AMVP_SUCCESS;
 
 err:
-    if (cap_entry) free(cap_entry);
-
+    /* Anything allocated so far goes with the rest of the capabilities */
     return rv;
 }
 
@@ -756,7 +777,8 @@ static AMVP_RESULT amvp_validate_kdf108_param_value(AMVP_CTX *ctx, AMVP_KDF108_P
     return retval;
 }
 
-static AMVP_RESULT amvp_dsa_set_modulo(AMVP_DSA_CAP_MODE *dsa_cap_mode,
+static AMVP_RESULT amvp_dsa_set_modulo(AMVP_CTX *ctx,
+                                       AMVP_DSA_CAP_MODE *dsa_cap_mode,
                                        AMVP_DSA_PARM param,
                                        AMVP_HASH_ALG value) {
     AMVP_DSA_ATTRS *attrs;
@@ -767,7 +789,7 @@ static AMVP_RESULT amvp_dsa_set_modulo(AMVP_DSA_CAP_MODE *dsa_cap_mode,
 
     attrs = dsa_cap_mode->dsa_attrs;
     if (!attrs) {
-        attrs = calloc(1, sizeof(AMVP_DSA_ATTRS));
+        attrs = amvp_cap_alloc(ctx, sizeof(AMVP_DSA_ATTRS));
         if (!attrs) {
             return AMVP_MALLOC_FAIL;
         }
@@ -785,7 +807,7 @@ static AMVP_RESULT amvp_dsa_set_modulo(AMVP_DSA_CAP_MODE *dsa_cap_mode,
         }
         attrs = attrs->next;
     }
-    attrs->next = calloc(1, sizeof(AMVP_DSA_ATTRS));
+    attrs->next = amvp_cap_alloc(ctx, sizeof(AMVP_DSA_ATTRS));
     if (!attrs->next) {
         return AMVP_MALLOC_FAIL;
     }
@@ -816,7 +838,7 @@ static AMVP_RESULT amvp_add_dsa_mode_parm(AMVP_CTX *ctx,
         return AMVP_NO_CTX;
     }
 
-    rv = amvp_dsa_set_modulo(dsa_cap_mode, param, value);
+    rv = amvp_dsa_set_modulo(ctx, dsa_cap_mode, param, value);
     if (rv != AMVP_SUCCESS) {
         return rv;
     }
@@ -2076,25 +2098,25 @@ static AMVP_RESULT amvp_validate_prereq_val(AMVP_CIPHER cipher, AMVP_PREREQ_ALG
 /*
  * Append a pre req val to the list of prereqs
  */
-static AMVP_RESULT amvp_add_prereq_val(AMVP_CIPHER cipher,
+static AMVP_RESULT amvp_add_prereq_val(AMVP_CTX *ctx,
+                                       AMVP_CIPHER cipher,
                                        AMVP_CAPS_LIST *cap_list,
                                        AMVP_PREREQ_ALG pre_req,
                                        char *value) {
     AMVP_PREREQ_LIST *prereq_entry, *prereq_entry_2;
     AMVP_RESULT result;
 
-    prereq_entry = calloc(1, sizeof(AMVP_PREREQ_LIST));
+    result = amvp_validate_prereq_val(cipher, pre_req);
+    if (result != AMVP_SUCCESS) {
+        return result;
+    }
+
+    prereq_entry = amvp_cap_alloc(ctx, sizeof(AMVP_PREREQ_LIST));
     if (!prereq_entry) {
         return AMVP_MALLOC_FAIL;
     }
     prereq_entry->prereq_alg_val.alg = pre_req;
     prereq_entry->prereq_alg_val.val = value;
-
-    result = amvp_validate_prereq_val(cipher, pre_req);
-    if (result != AMVP_SUCCESS) {
-        free(prereq_entry);
-        return result;
-    }
     /*
      * 1st entry
      */
@@ -2129,7 +2151,7 @@ AMVP_RESULT amvp_cap_set_prereq(AMVP_CTX *ctx,
     /*
      * Locate this cipher in the caps array
      */
-    cap_list = amvp_locate_cap_entry(ctx, cipher);
+    cap_list = amvp_cap_entry_for_update(ctx, cipher);
     if (!cap_list) {
         AMVP_LOG_ERR("Cap entry not found.");
         return AMVP_NO_CAP;
@@ -2139,7 +2161,102 @@ AMVP_RESULT amvp_cap_set_prereq(AMVP_CTX *ctx,
     /*
      * Add the value to the cap
      */
-    return amvp_add_prereq_val(cipher, cap_list, pre_req_cap, value);
+    return amvp_add_prereq_val(ctx, cipher, cap_list, pre_req_cap, value);
+}
+
+AMVP_RESULT amvp_cap_set_batch_handler(AMVP_CTX *ctx,
+                                       AMVP_CIPHER cipher,
+                                       int (*crypto_batch_handler)(AMVP_TEST_CASE *test_cases, int count)) {
+    AMVP_CAPS_LIST *cap_list;
+
+    if (!ctx) {
+        return AMVP_NO_CTX;
+    }
+
+    cap_list = amvp_cap_entry_for_update(ctx, cipher);
+    if (!cap_list) {
+        AMVP_LOG_ERR("Cap entry not found.");
+        return AMVP_NO_CAP;
+    }
+
+    cap_list->crypto_batch_handler = crypto_batch_handler;
+    return AMVP_SUCCESS;
+}
+
+AMVP_RESULT amvp_cap_set_mct_handler(AMVP_CTX *ctx,
+                                     AMVP_CIPHER cipher,
+                                     int (*crypto_mct_handler)(AMVP_TEST_CASE *test_case)) {
+    AMVP_CAPS_LIST *cap_list;
+
+    if (!ctx) {
+        return AMVP_NO_CTX;
+    }
+
+    cap_list = amvp_cap_entry_for_update(ctx, cipher);
+    if (!cap_list) {
+        AMVP_LOG_ERR("Cap entry not found.");
+        return AMVP_NO_CAP;
+    }
+
+    cap_list->crypto_mct_handler = crypto_mct_handler;
+    return AMVP_SUCCESS;
+}
+
+AMVP_RESULT amvp_cap_set_group_handlers(AMVP_CTX *ctx,
+                                        AMVP_CIPHER cipher,
+                                        int (*group_init)(AMVP_TEST_CASE *test_case, void **group_ctx),
+                                        void (*group_fini)(void *group_ctx)) {
+    AMVP_CAPS_LIST *cap_list;
+
+    if (!ctx) {
+        return AMVP_NO_CTX;
+    }
+    if (group_fini && !group_init) {
+        AMVP_LOG_ERR("group_fini given without group_init");
+        return AMVP_INVALID_ARG;
+    }
+
+    cap_list = amvp_cap_entry_for_update(ctx, cipher);
+    if (!cap_list) {
+        AMVP_LOG_ERR("Cap entry not found.");
+        return AMVP_NO_CAP;
+    }
+
+    cap_list->group_init = group_init;
+    cap_list->group_fini = group_fini;
+    return AMVP_SUCCESS;
+}
+
+AMVP_RESULT amvp_cap_set_hash_stream_handlers(AMVP_CTX *ctx,
+                                              AMVP_CIPHER cipher,
+                                              int (*hash_init)(AMVP_TEST_CASE *test_case, void **stream_ctx),
+                                              int (*hash_update)(void *stream_ctx, const unsigned char *data, unsigned int len),
+                                              int (*hash_final)(void *stream_ctx, AMVP_TEST_CASE *test_case)) {
+    AMVP_CAPS_LIST *cap_list;
+
+    if (!ctx) {
+        return AMVP_NO_CTX;
+    }
+    if (!(hash_init && hash_update && hash_final) && (hash_init || hash_update || hash_final)) {
+        AMVP_LOG_ERR("hash_init, hash_update and hash_final must be given together");
+        return AMVP_INVALID_ARG;
+    }
+
+    cap_list = amvp_cap_entry_for_update(ctx, cipher);
+    if (!cap_list) {
+        AMVP_LOG_ERR("Cap entry not found.");
+        return AMVP_NO_CAP;
+    }
+    if (cap_list->cap_type != AMVP_HASH_TYPE ||
+        cipher == AMVP_HASH_SHAKE_128 || cipher == AMVP_HASH_SHAKE_256) {
+        AMVP_LOG_ERR("Stream handlers are only used by SHA-1, SHA-2 and SHA-3");
+        return AMVP_INVALID_ARG;
+    }
+
+    cap_list->hash_init = hash_init;
+    cap_list->hash_update = hash_update;
+    cap_list->hash_final = hash_final;
+    return AMVP_SUCCESS;
 }
 
 /*
@@ -2277,7 +2394,7 @@ AMVP_RESULT amvp_cap_sym_cipher_set_domain(AMVP_CTX *ctx,
     /*
      * Locate this cipher in the caps array
      */
-    cap = amvp_locate_cap_entry(ctx, cipher);
+    cap = amvp_cap_entry_for_update(ctx, cipher);
     if (!cap) {
         AMVP_LOG_ERR("Cap entry not found, use amvp_enable_sym_cipher_cap() first.");
         return AMVP_NO_CAP;
@@ -2290,7 +2407,7 @@ AMVP_RESULT amvp_cap_sym_cipher_set_domain(AMVP_CTX *ctx,
 
     switch (parm) {
     case AMVP_SYM_CIPH_DOMAIN_IVLEN:
-        if (symcap->ivlen) {
+        if (symcap->ivlen.count) {
             AMVP_LOG_ERR("ivLen already defined using amvp_sym_cipher_set_parm. Please set ivLen using only one function "
                          "(Using set_parm for ivLen will eventually be depreciated).");
             return AMVP_INVALID_ARG;
@@ -2305,7 +2422,7 @@ AMVP_RESULT amvp_cap_sym_cipher_set_domain(AMVP_CTX *ctx,
         symcap->iv_len.increment = increment;
         break;
     case AMVP_SYM_CIPH_DOMAIN_PTLEN:
-        if (symcap->ptlen) {
+        if (symcap->ptlen.count) {
             AMVP_LOG_ERR("ptLen already defined using amvp_sym_cipher_set_parm. Please set ptLen using only one function "
                          "(Using set_parm for ptLen will eventually be depreciated).");
             return AMVP_INVALID_ARG;
@@ -2320,7 +2437,7 @@ AMVP_RESULT amvp_cap_sym_cipher_set_domain(AMVP_CTX *ctx,
         symcap->payload_len.increment = increment;
         break;
     case AMVP_SYM_CIPH_DOMAIN_AADLEN:
-        if (symcap->aadlen) {
+        if (symcap->aadlen.count) {
             AMVP_LOG_ERR("aadLen already defined using amvp_sym_cipher_set_parm. Please set aadLen using only one function "
                          "(Using set_parm for aadLen will eventually be depreciated).");
             return AMVP_INVALID_ARG;
@@ -2488,7 +2605,7 @@ AMVP_RESULT amvp_cap_sym_cipher_set_parm(AMVP_CTX *ctx,
     /*
      * Locate this cipher in the caps array
      */
-    cap = amvp_locate_cap_entry(ctx, cipher);
+    cap = amvp_cap_entry_for_update(ctx, cipher);
     if (!cap) {
         AMVP_LOG_ERR("Cap entry not found, use amvp_cap_sym_cipher_enable() first.");
         return AMVP_NO_CAP;
@@ -2631,10 +2748,10 @@ AMVP_RESULT amvp_cap_sym_cipher_set_parm(AMVP_CTX *ctx,
 
     switch (parm) {
     case AMVP_SYM_CIPH_KEYLEN:
-        amvp_append_sl_list(&cap->cap.sym_cap->keylen, value);
+        amvp_value_set_add(amvp_cap_arena(ctx), &cap->cap.sym_cap->keylen, value);
         break;
     case AMVP_SYM_CIPH_TAGLEN:
-        amvp_append_sl_list(&cap->cap.sym_cap->taglen, value);
+        amvp_value_set_add(amvp_cap_arena(ctx), &cap->cap.sym_cap->taglen, value);
         break;
     case AMVP_SYM_CIPH_IVLEN:
         if (amvp_is_domain_already_set(&cap->cap.sym_cap->iv_len)) {
@@ -2642,7 +2759,7 @@ AMVP_RESULT amvp_cap_sym_cipher_set_parm(AMVP_CTX *ctx,
                         "(Using set_parm for ivLen will eventually be depreciated).");
             return AMVP_INVALID_ARG;
         }
-        amvp_append_sl_list(&cap->cap.sym_cap->ivlen, value);
+        amvp_value_set_add(amvp_cap_arena(ctx), &cap->cap.sym_cap->ivlen, value);
         break;
     case AMVP_SYM_CIPH_PTLEN:
         if (amvp_is_domain_already_set(&cap->cap.sym_cap->payload_len)) {
@@ -2650,10 +2767,10 @@ AMVP_RESULT amvp_cap_sym_cipher_set_parm(AMVP_CTX *ctx,
                          "(Using set_parm for payloadLen will eventually be depreciated).");
             return AMVP_INVALID_ARG;
         }
-        amvp_append_sl_list(&cap->cap.sym_cap->ptlen, value);
+        amvp_value_set_add(amvp_cap_arena(ctx), &cap->cap.sym_cap->ptlen, value);
         break;
     case AMVP_SYM_CIPH_TWEAK:
-        amvp_append_sl_list(&cap->cap.sym_cap->tweak, value);
+        amvp_value_set_add(amvp_cap_arena(ctx), &cap->cap.sym_cap->tweak, value);
         break;
     case AMVP_SYM_CIPH_AADLEN:
         if (amvp_is_domain_already_set(&cap->cap.sym_cap->aad_len)) {
@@ -2661,7 +2778,7 @@ AMVP_RESULT amvp_cap_sym_cipher_set_parm(AMVP_CTX *ctx,
                          "(Using set_parm for aadLen will eventually be depreciated).");
             return AMVP_INVALID_ARG;
         }
-        amvp_append_sl_list(&cap->cap.sym_cap->aadlen, value);
+        amvp_value_set_add(amvp_cap_arena(ctx), &cap->cap.sym_cap->aadlen, value);
         break;
     case AMVP_SYM_CIPH_KW_MODE:
     case AMVP_SYM_CIPH_PARM_DIR:
@@ -2701,6 +2818,7 @@ AMVP_RESULT amvp_cap_sym_cipher_enable(AMVP_CTX *ctx,
     if (!ctx) {
         return AMVP_NO_CTX;
     }
+    amvp_registration_invalidate(ctx);
     if (!crypto_handler) {
         AMVP_LOG_ERR("NULL parameter 'crypto_handler'");
         return AMVP_INVALID_ARG;
@@ -2835,6 +2953,7 @@ AMVP_RESULT amvp_cap_hash_enable(AMVP_CTX *ctx,
     if (!ctx) {
         return AMVP_NO_CTX;
     }
+    amvp_registration_invalidate(ctx);
     if (!crypto_handler) {
         AMVP_LOG_ERR("NULL parameter 'crypto_handler'");
         return AMVP_INVALID_ARG;
@@ -2886,6 +3005,11 @@ static AMVP_RESULT amvp_validate_hash_parm_value(AMVP_HASH_PARM parm, int value)
     case AMVP_HASH_OUT_BIT:
         retval = is_valid_tf_param(value);
         break;
+    case AMVP_HASH_LARGE_DATA:
+        if (value == 1 || value == 2 || value == 4 || value == 8) {
+            retval = AMVP_SUCCESS;
+        }
+        break;
     case AMVP_HASH_OUT_LENGTH:
     case AMVP_HASH_MESSAGE_LEN:
     default:
@@ -2928,11 +3052,16 @@ AMVP_RESULT amvp_cap_hash_set_parm(AMVP_CTX *ctx,
     case AMVP_SUB_HASH_SHA2_512:
     case AMVP_SUB_HASH_SHA2_512_224:
     case AMVP_SUB_HASH_SHA2_512_256:
+        /* SHA-1 and SHA-2 only take the LDT sizes */
+        if (param == AMVP_HASH_LARGE_DATA) {
+            break;
+        }
+        return AMVP_INVALID_ARG;
     default:
         return AMVP_INVALID_ARG;
     }
 
-    cap = amvp_locate_cap_entry(ctx, cipher);
+    cap = amvp_cap_entry_for_update(ctx, cipher);
     if (!cap) {
         return AMVP_NO_CAP;
     }
@@ -2976,6 +3105,12 @@ AMVP_RESULT amvp_cap_hash_set_parm(AMVP_CTX *ctx,
 
         hash_cap->out_bit = value;
         break;
+    case AMVP_HASH_LARGE_DATA:
+        if (alg == AMVP_SUB_HASH_SHAKE_128 || alg == AMVP_SUB_HASH_SHAKE_256) {
+            AMVP_LOG_ERR("parm 'AMVP_HASH_LARGE_DATA' not allowed for AMVP_HASH_SHAKE_*");
+            return AMVP_INVALID_ARG;
+        }
+        return amvp_value_set_add(amvp_cap_arena(ctx), &hash_cap->large_data, value);
     case AMVP_HASH_OUT_LENGTH:
     case AMVP_HASH_MESSAGE_LEN:
     default:
@@ -3028,7 +3163,7 @@ AMVP_RESULT amvp_cap_hash_set_domain(AMVP_CTX *ctx,
         return AMVP_INVALID_ARG;
     }
 
-    cap = amvp_locate_cap_entry(ctx, cipher);
+    cap = amvp_cap_entry_for_update(ctx, cipher);
     if (!cap) {
         AMVP_LOG_ERR("Cap entry not found.");
         return AMVP_NO_CAP;
@@ -3165,6 +3300,7 @@ AMVP_RESULT amvp_cap_hmac_enable(AMVP_CTX *ctx,
     if (!ctx) {
         return AMVP_NO_CTX;
     }
+    amvp_registration_invalidate(ctx);
 
     if (!crypto_handler) {
         AMVP_LOG_ERR("NULL parameter 'crypto_handler'");
@@ -3214,7 +3350,7 @@ AMVP_RESULT amvp_cap_hmac_set_domain(AMVP_CTX *ctx,
     AMVP_JSON_DOMAIN_OBJ *domain;
     AMVP_HMAC_CAP *current_hmac_cap;
 
-    cap_list = amvp_locate_cap_entry(ctx, cipher);
+    cap_list = amvp_cap_entry_for_update(ctx, cipher);
     if (!cap_list) {
         AMVP_LOG_ERR("Cap entry not found.");
         return AMVP_NO_CAP;
@@ -3270,7 +3406,7 @@ AMVP_RESULT amvp_cap_hmac_set_parm(AMVP_CTX *ctx,
     /*
      * Locate this cipher in the caps array
      */
-    cap = amvp_locate_cap_entry(ctx, cipher);
+    cap = amvp_cap_entry_for_update(ctx, cipher);
     if (!cap) {
         AMVP_LOG_ERR("Cap entry not found, use amvp_enable_hmac_cipher_cap() first.");
         return AMVP_NO_CAP;
@@ -3283,13 +3419,13 @@ AMVP_RESULT amvp_cap_hmac_set_parm(AMVP_CTX *ctx,
 
     switch (parm) {
     case AMVP_HMAC_KEYLEN:
-        if (amvp_append_sl_list(&cap->cap.hmac_cap->key_len.values, value) != AMVP_SUCCESS) {
+        if (amvp_value_set_add(amvp_cap_arena(ctx), &cap->cap.hmac_cap->key_len.values, value) != AMVP_SUCCESS) {
             AMVP_LOG_ERR("Error adding HMAC key length to list");
             return AMVP_MALLOC_FAIL;
         }
         break;
     case AMVP_HMAC_MACLEN:
-        if (amvp_append_sl_list(&cap->cap.hmac_cap->mac_len.values, value) != AMVP_SUCCESS) {
+        if (amvp_value_set_add(amvp_cap_arena(ctx), &cap->cap.hmac_cap->mac_len.values, value) != AMVP_SUCCESS) {
             AMVP_LOG_ERR("Error adding HMAC mac length to list");
             return AMVP_MALLOC_FAIL;
         }
@@ -3352,6 +3488,7 @@ AMVP_RESULT amvp_cap_cmac_enable(AMVP_CTX *ctx,
     if (!ctx) {
         return AMVP_NO_CTX;
     }
+    amvp_registration_invalidate(ctx);
     if (!crypto_handler) {
         AMVP_LOG_ERR("NULL parameter 'crypto_handler'");
         return AMVP_INVALID_ARG;
@@ -3391,7 +3528,7 @@ AMVP_RESULT amvp_cap_cmac_set_domain(AMVP_CTX *ctx,
     AMVP_JSON_DOMAIN_OBJ *domain;
     AMVP_CMAC_CAP *current_cmac_cap;
 
-    cap_list = amvp_locate_cap_entry(ctx, cipher);
+    cap_list = amvp_cap_entry_for_update(ctx, cipher);
     if (!cap_list) {
         AMVP_LOG_ERR("Cap entry not found.");
         return AMVP_NO_CAP;
@@ -3450,7 +3587,7 @@ AMVP_RESULT amvp_cap_cmac_set_parm(AMVP_CTX *ctx,
     /*
      * Locate this cipher in the caps array
      */
-    cap = amvp_locate_cap_entry(ctx, cipher);
+    cap = amvp_cap_entry_for_update(ctx, cipher);
     if (!cap) {
         AMVP_LOG_ERR("Cap entry not found, use amvp_enable_cmac_cipher_cap() first.");
         return AMVP_NO_CAP;
@@ -3462,13 +3599,13 @@ AMVP_RESULT amvp_cap_cmac_set_parm(AMVP_CTX *ctx,
 
     switch (parm) {
     case AMVP_CMAC_MSGLEN:
-        if (amvp_append_sl_list(&current_cmac_cap->msg_len.values, value) != AMVP_SUCCESS) {
+        if (amvp_value_set_add(amvp_cap_arena(ctx), &current_cmac_cap->msg_len.values, value) != AMVP_SUCCESS) {
             AMVP_LOG_ERR("Error adding CMAC msg len to list");
             return AMVP_MALLOC_FAIL;
         }
         break;
     case AMVP_CMAC_MACLEN:
-        if (amvp_append_sl_list(&current_cmac_cap->mac_len.values, value) != AMVP_SUCCESS) {
+        if (amvp_value_set_add(amvp_cap_arena(ctx), &current_cmac_cap->mac_len.values, value) != AMVP_SUCCESS) {
             AMVP_LOG_ERR("Error adding CMAC mac len to list");
             return AMVP_MALLOC_FAIL;
         }
@@ -3480,11 +3617,11 @@ AMVP_RESULT amvp_cap_cmac_set_parm(AMVP_CTX *ctx,
         cap->cap.cmac_cap->direction_ver = value;
         break;
     case AMVP_CMAC_KEYLEN:
-        amvp_append_sl_list(&cap->cap.cmac_cap->key_len, value);
+        amvp_value_set_add(amvp_cap_arena(ctx), &cap->cap.cmac_cap->key_len, value);
         break;
     case AMVP_CMAC_KEYING_OPTION:
         if (cipher == AMVP_CMAC_TDES) {
-            amvp_append_sl_list(&cap->cap.cmac_cap->keying_option, value);
+            amvp_value_set_add(amvp_cap_arena(ctx), &cap->cap.cmac_cap->keying_option, value);
             break;
         }
         return AMVP_INVALID_ARG;
@@ -3504,6 +3641,7 @@ AMVP_RESULT amvp_cap_kmac_enable(AMVP_CTX *ctx,
     if (!ctx) {
         return AMVP_NO_CTX;
     }
+    amvp_registration_invalidate(ctx);
     if (!crypto_handler) {
         AMVP_LOG_ERR("NULL parameter 'crypto_handler'");
         return AMVP_INVALID_ARG;
@@ -3543,7 +3681,7 @@ AMVP_RESULT amvp_cap_kmac_set_parm(AMVP_CTX *ctx,
     /*
      * Locate this cipher in the caps array
      */
-    cap = amvp_locate_cap_entry(ctx, cipher);
+    cap = amvp_cap_entry_for_update(ctx, cipher);
     if (!cap) {
         AMVP_LOG_ERR("Cap entry not found, use amvp_enable_kmac_cipher_cap() first.");
         return AMVP_NO_CAP;
@@ -3595,7 +3733,7 @@ AMVP_RESULT amvp_cap_kmac_set_domain(AMVP_CTX *ctx,
     /*
      * Locate this cipher in the caps array
      */
-    cap = amvp_locate_cap_entry(ctx, cipher);
+    cap = amvp_cap_entry_for_update(ctx, cipher);
     if (!cap) {
         AMVP_LOG_ERR("Cap entry not found, use amvp_enable_kmac_cipher_cap() first.");
         return AMVP_NO_CAP;
@@ -3712,7 +3850,7 @@ AMVP_RESULT amvp_cap_drbg_set_length(AMVP_CTX *ctx,
     /*
      * Locate this cipher in the caps array
      */
-    cap_list = amvp_locate_cap_entry(ctx, cipher);
+    cap_list = amvp_cap_entry_for_update(ctx, cipher);
     if (!cap_list) {
         AMVP_LOG_ERR("Cap entry not found.");
         return AMVP_NO_CAP;
@@ -3724,7 +3862,7 @@ AMVP_RESULT amvp_cap_drbg_set_length(AMVP_CTX *ctx,
      */
     drbg_cap_mode  = amvp_locate_drbg_mode_entry(cap_list, mode);
     if (!drbg_cap_mode) {
-        drbg_cap_mode = amvp_create_drbg_mode_entry(cap_list, mode);
+        drbg_cap_mode = amvp_create_drbg_mode_entry(amvp_cap_arena(ctx), cap_list, mode);
         if (!drbg_cap_mode) {
             AMVP_LOG_ERR("Malloc Failed.");
             return AMVP_MALLOC_FAIL;
@@ -3733,7 +3871,7 @@ AMVP_RESULT amvp_cap_drbg_set_length(AMVP_CTX *ctx,
 
     grp = amvp_locate_drbg_group_entry(drbg_cap_mode, group);
     if (!grp) {
-        grp = amvp_create_drbg_group(drbg_cap_mode, group);
+        grp = amvp_create_drbg_group(amvp_cap_arena(ctx), drbg_cap_mode, group);
         if (!grp) {
             AMVP_LOG_ERR("Error creating group for DRBG capabilities");
             return AMVP_MALLOC_FAIL;
@@ -3855,7 +3993,7 @@ AMVP_RESULT amvp_cap_drbg_set_parm(AMVP_CTX *ctx,
     /*
      * Locate this cipher in the caps array
      */
-    cap_list = amvp_locate_cap_entry(ctx, cipher);
+    cap_list = amvp_cap_entry_for_update(ctx, cipher);
     if (!cap_list) {
         AMVP_LOG_ERR("Cap entry not found.");
         return AMVP_NO_CAP;
@@ -3872,7 +4010,7 @@ AMVP_RESULT amvp_cap_drbg_set_parm(AMVP_CTX *ctx,
 
     cap_mode = amvp_locate_drbg_mode_entry(cap_list, mode);
     if (!cap_mode) {
-        cap_mode = amvp_create_drbg_mode_entry(cap_list, mode);
+        cap_mode = amvp_create_drbg_mode_entry(amvp_cap_arena(ctx), cap_list, mode);
         if (!cap_mode) {
             AMVP_LOG_ERR("Malloc Failed.");
             return AMVP_MALLOC_FAIL;
@@ -3881,7 +4019,7 @@ AMVP_RESULT amvp_cap_drbg_set_parm(AMVP_CTX *ctx,
 
     grp = amvp_locate_drbg_group_entry(cap_mode, group);
     if (!grp) {
-        grp = amvp_create_drbg_group(cap_mode, group);
+        grp = amvp_create_drbg_group(amvp_cap_arena(ctx), cap_mode, group);
         if (!grp) {
             AMVP_LOG_ERR("Error creating group for DRBG capabilities");
             return AMVP_MALLOC_FAIL;
@@ -3946,6 +4084,7 @@ AMVP_RESULT amvp_cap_drbg_enable(AMVP_CTX *ctx,
     if (!ctx) {
         return AMVP_NO_CTX;
     }
+    amvp_registration_invalidate(ctx);
     if (!crypto_handler) {
         AMVP_LOG_ERR("NULL parameter 'crypto_handler'");
         return AMVP_INVALID_ARG;
@@ -3971,14 +4110,14 @@ AMVP_RESULT amvp_cap_rsa_keygen_set_mode(AMVP_CTX *ctx,
     AMVP_RSA_KEYGEN_CAP *keygen_cap;
     AMVP_RESULT result = AMVP_SUCCESS;
 
-    cap_list = amvp_locate_cap_entry(ctx, AMVP_RSA_KEYGEN);
+    cap_list = amvp_cap_entry_for_update(ctx, AMVP_RSA_KEYGEN);
     if (!cap_list) {
         AMVP_LOG_ERR("Cap entry not found.");
         return AMVP_NO_CAP;
     }
 
     if (!cap_list->cap.rsa_keygen_cap) {
-        cap_list->cap.rsa_keygen_cap = calloc(1, sizeof(AMVP_RSA_KEYGEN_CAP));
+        cap_list->cap.rsa_keygen_cap = amvp_cap_alloc(ctx, sizeof(AMVP_RSA_KEYGEN_CAP));
     }
     keygen_cap = cap_list->cap.rsa_keygen_cap;
 
@@ -3994,7 +4133,7 @@ AMVP_RESULT amvp_cap_rsa_keygen_set_mode(AMVP_CTX *ctx,
             return AMVP_DUP_CIPHER;
         }
         if (!keygen_cap->next) {
-            keygen_cap->next = calloc(1, sizeof(AMVP_RSA_KEYGEN_CAP));
+            keygen_cap->next = amvp_cap_alloc(ctx, sizeof(AMVP_RSA_KEYGEN_CAP));
             keygen_cap = keygen_cap->next;
             break;
         }
@@ -4034,7 +4173,7 @@ AMVP_RESULT amvp_cap_rsa_keygen_set_parm(AMVP_CTX *ctx,
     AMVP_CAPS_LIST *cap_list;
     AMVP_RESULT rv = AMVP_SUCCESS;
 
-    cap_list = amvp_locate_cap_entry(ctx, AMVP_RSA_KEYGEN);
+    cap_list = amvp_cap_entry_for_update(ctx, AMVP_RSA_KEYGEN);
     if (!cap_list) {
         AMVP_LOG_ERR("Cap entry not found.");
         return AMVP_NO_CAP;
@@ -4078,6 +4217,7 @@ AMVP_RESULT amvp_cap_rsa_keygen_enable(AMVP_CTX *ctx,
     if (!ctx) {
         return AMVP_NO_CTX;
     }
+    amvp_registration_invalidate(ctx);
 
     if (!crypto_handler) {
         AMVP_LOG_ERR("NULL parameter 'crypto_handler'");
@@ -4108,7 +4248,7 @@ AMVP_RESULT amvp_cap_rsa_sigver_set_parm(AMVP_CTX *ctx,
                                          int value) {
     AMVP_CAPS_LIST *cap_list;
 
-    cap_list = amvp_locate_cap_entry(ctx, AMVP_RSA_SIGVER);
+    cap_list = amvp_cap_entry_for_update(ctx, AMVP_RSA_SIGVER);
     if (!cap_list) {
         AMVP_LOG_ERR("Cap entry not found.");
         return AMVP_NO_CAP;
@@ -4139,14 +4279,14 @@ AMVP_RESULT amvp_cap_rsa_sigver_set_type(AMVP_CTX *ctx,
     AMVP_RSA_SIG_CAP *sigver_cap;
     AMVP_RESULT result = AMVP_SUCCESS;
 
-    cap_list = amvp_locate_cap_entry(ctx, AMVP_RSA_SIGVER);
+    cap_list = amvp_cap_entry_for_update(ctx, AMVP_RSA_SIGVER);
     if (!cap_list) {
         AMVP_LOG_ERR("Cap entry not found.");
         return AMVP_NO_CAP;
     }
 
     if (!cap_list->cap.rsa_sigver_cap) {
-        cap_list->cap.rsa_sigver_cap = calloc(1, sizeof(AMVP_RSA_SIG_CAP));
+        cap_list->cap.rsa_sigver_cap = amvp_cap_alloc(ctx, sizeof(AMVP_RSA_SIG_CAP));
     }
     sigver_cap = cap_list->cap.rsa_sigver_cap;
 
@@ -4158,7 +4298,7 @@ AMVP_RESULT amvp_cap_rsa_sigver_set_type(AMVP_CTX *ctx,
             return AMVP_DUP_CIPHER;
         }
         if (!sigver_cap->next) {
-            sigver_cap->next = calloc(1, sizeof(AMVP_RSA_SIG_CAP));
+            sigver_cap->next = amvp_cap_alloc(ctx, sizeof(AMVP_RSA_SIG_CAP));
             sigver_cap = sigver_cap->next;
             break;
         }
@@ -4192,14 +4332,14 @@ AMVP_RESULT amvp_cap_rsa_siggen_set_type(AMVP_CTX *ctx,
     AMVP_RSA_SIG_CAP *siggen_cap;
     AMVP_RESULT result = AMVP_SUCCESS;
 
-    cap_list = amvp_locate_cap_entry(ctx, AMVP_RSA_SIGGEN);
+    cap_list = amvp_cap_entry_for_update(ctx, AMVP_RSA_SIGGEN);
     if (!cap_list) {
         AMVP_LOG_ERR("Cap entry not found.");
         return AMVP_NO_CAP;
     }
 
     if (!cap_list->cap.rsa_siggen_cap) {
-        cap_list->cap.rsa_siggen_cap = calloc(1, sizeof(AMVP_RSA_SIG_CAP));
+        cap_list->cap.rsa_siggen_cap = amvp_cap_alloc(ctx, sizeof(AMVP_RSA_SIG_CAP));
     }
     siggen_cap = cap_list->cap.rsa_siggen_cap;
 
@@ -4211,7 +4351,7 @@ AMVP_RESULT amvp_cap_rsa_siggen_set_type(AMVP_CTX *ctx,
             return AMVP_DUP_CIPHER;
         }
         if (!siggen_cap->next) {
-            siggen_cap->next = calloc(1, sizeof(AMVP_RSA_SIG_CAP));
+            siggen_cap->next = amvp_cap_alloc(ctx, sizeof(AMVP_RSA_SIG_CAP));
             siggen_cap = siggen_cap->next;
             break;
         }
@@ -4245,7 +4385,7 @@ AMVP_RESULT amvp_cap_rsa_keygen_set_exponent(AMVP_CTX *ctx,
     AMVP_CAPS_LIST *cap_list = NULL;
     AMVP_RSA_KEYGEN_CAP *cap = NULL;
 
-    cap_list = amvp_locate_cap_entry(ctx, AMVP_RSA_KEYGEN);
+    cap_list = amvp_cap_entry_for_update(ctx, AMVP_RSA_KEYGEN);
     if (!cap_list) {
         AMVP_LOG_ERR("Cap entry not found.");
         return AMVP_NO_CAP;
@@ -4270,7 +4410,7 @@ AMVP_RESULT amvp_cap_rsa_keygen_set_exponent(AMVP_CTX *ctx,
                     return AMVP_INVALID_ARG;
                 }
 
-                cap->fixed_pub_exp = calloc(len + 1, sizeof(char));
+                cap->fixed_pub_exp = amvp_cap_alloc(ctx, len + 1);
                 strcpy_s(cap->fixed_pub_exp, len + 1, value);
             } else {
                 AMVP_LOG_ERR("AMVP_FIXED_PUB_EXP_VAL has already been set.");
@@ -4298,7 +4438,7 @@ AMVP_RESULT amvp_cap_rsa_sigver_set_exponent(AMVP_CTX *ctx,
     AMVP_CAPS_LIST *cap_list = NULL;
     AMVP_RSA_SIG_CAP *cap = NULL;
 
-    cap_list = amvp_locate_cap_entry(ctx, AMVP_RSA_SIGVER);
+    cap_list = amvp_cap_entry_for_update(ctx, AMVP_RSA_SIGVER);
     if (!cap_list) {
         AMVP_LOG_ERR("Cap entry not found.");
         return AMVP_NO_CAP;
@@ -4323,7 +4463,7 @@ AMVP_RESULT amvp_cap_rsa_sigver_set_exponent(AMVP_CTX *ctx,
                     return AMVP_INVALID_ARG;
                 }
 
-                cap->fixed_pub_exp = calloc(len + 1, sizeof(char));
+                cap->fixed_pub_exp = amvp_cap_alloc(ctx, len + 1);
                 strcpy_s(cap->fixed_pub_exp, len + 1, value);
             } else {
                 AMVP_LOG_ERR("AMVP_FIXED_PUB_EXP_VAL has already been set.");
@@ -4358,7 +4498,7 @@ AMVP_RESULT amvp_cap_rsa_keygen_set_primes(AMVP_CTX *ctx,
     int found = 0;
     const char *string = NULL;
 
-    cap_list = amvp_locate_cap_entry(ctx, AMVP_RSA_KEYGEN);
+    cap_list = amvp_cap_entry_for_update(ctx, AMVP_RSA_KEYGEN);
     if (!cap_list) {
         AMVP_LOG_ERR("Cap entry not found.");
         return AMVP_NO_CAP;
@@ -4384,7 +4524,7 @@ AMVP_RESULT amvp_cap_rsa_keygen_set_primes(AMVP_CTX *ctx,
     }
 
     if (!keygen_cap->mode_capabilities) {
-        keygen_cap->mode_capabilities = calloc(1, sizeof(AMVP_RSA_MODE_CAPS_LIST));
+        keygen_cap->mode_capabilities = amvp_cap_alloc(ctx, sizeof(AMVP_RSA_MODE_CAPS_LIST));
         if (!keygen_cap->mode_capabilities) {
             AMVP_LOG_ERR("Malloc Failed -- enable rsa cap parm");
             return AMVP_MALLOC_FAIL;
@@ -4398,7 +4538,7 @@ AMVP_RESULT amvp_cap_rsa_keygen_set_primes(AMVP_CTX *ctx,
         do {
             if (current_prime->modulo != mod) {
                 if (current_prime->next == NULL) {
-                    current_prime->next = calloc(1, sizeof(AMVP_RSA_MODE_CAPS_LIST));
+                    current_prime->next = amvp_cap_alloc(ctx, sizeof(AMVP_RSA_MODE_CAPS_LIST));
                     if (!current_prime->next) {
                         AMVP_LOG_ERR("Malloc Failed -- enable rsa cap parm");
                         return AMVP_MALLOC_FAIL;
@@ -4421,14 +4561,14 @@ AMVP_RESULT amvp_cap_rsa_keygen_set_primes(AMVP_CTX *ctx,
             AMVP_LOG_ERR("Invalid 'value' for AMVP_RSA_HASH_ALG");
             return AMVP_INVALID_ARG;
         }
-        result = amvp_append_name_list(&current_prime->hash_algs, string);
+        result = amvp_append_name_list(amvp_cap_arena(ctx), &current_prime->hash_algs, string);
     } else if (param == AMVP_RSA_PRIME_TEST) {
         string = amvp_lookup_rsa_prime_test_name(value);
         if (!string) {
             AMVP_LOG_ERR("Invalid 'value' for AMVP_RSA_PRIME_TEST");
             return AMVP_INVALID_ARG;
         }
-        result = amvp_append_name_list(&current_prime->prime_tests, string);
+        result = amvp_append_name_list(amvp_cap_arena(ctx), &current_prime->prime_tests, string);
     } else {
         AMVP_LOG_ERR("Invalid parameter 'param'");
         return AMVP_INVALID_ARG;
@@ -4464,7 +4604,7 @@ AMVP_RESULT amvp_cap_rsa_sigver_set_mod_parm(AMVP_CTX *ctx,
         return AMVP_INVALID_ARG;
     }
 
-    cap_list = amvp_locate_cap_entry(ctx, AMVP_RSA_SIGVER);
+    cap_list = amvp_cap_entry_for_update(ctx, AMVP_RSA_SIGVER);
     if (!cap_list) {
         AMVP_LOG_ERR("Cap entry not found.");
         return AMVP_NO_CAP;
@@ -4483,7 +4623,7 @@ AMVP_RESULT amvp_cap_rsa_sigver_set_mod_parm(AMVP_CTX *ctx,
     }
 
     if (!sigver_cap->mode_capabilities) {
-        sigver_cap->mode_capabilities = calloc(1, sizeof(AMVP_RSA_MODE_CAPS_LIST));
+        sigver_cap->mode_capabilities = amvp_cap_alloc(ctx, sizeof(AMVP_RSA_MODE_CAPS_LIST));
         if (!sigver_cap->mode_capabilities) {
             AMVP_LOG_ERR("Malloc Failed -- enable rsa cap parm");
             return AMVP_MALLOC_FAIL;
@@ -4497,7 +4637,7 @@ AMVP_RESULT amvp_cap_rsa_sigver_set_mod_parm(AMVP_CTX *ctx,
         do {
             if (current_cap->modulo != mod) {
                 if (current_cap->next == NULL) {
-                    current_cap->next = calloc(1, sizeof(AMVP_RSA_MODE_CAPS_LIST));
+                    current_cap->next = amvp_cap_alloc(ctx, sizeof(AMVP_RSA_MODE_CAPS_LIST));
                     if (!current_cap->next) {
                         AMVP_LOG_ERR("Malloc Failed -- enable rsa cap parm");
                         return AMVP_MALLOC_FAIL;
@@ -4520,7 +4660,7 @@ AMVP_RESULT amvp_cap_rsa_sigver_set_mod_parm(AMVP_CTX *ctx,
     }
 
     if (!current_cap->hash_pair) {
-        current_cap->hash_pair = calloc(1, sizeof(AMVP_RSA_HASH_PAIR_LIST));
+        current_cap->hash_pair = amvp_cap_alloc(ctx, sizeof(AMVP_RSA_HASH_PAIR_LIST));
         if (!current_cap->hash_pair) {
             AMVP_LOG_ERR("Malloc Failed -- enable rsa cap parm");
             return AMVP_MALLOC_FAIL;
@@ -4534,7 +4674,7 @@ AMVP_RESULT amvp_cap_rsa_sigver_set_mod_parm(AMVP_CTX *ctx,
         while (current_hash->next != NULL) {
             current_hash = current_hash->next;
         }
-        current_hash->next = calloc(1, sizeof(AMVP_RSA_HASH_PAIR_LIST));
+        current_hash->next = amvp_cap_alloc(ctx, sizeof(AMVP_RSA_HASH_PAIR_LIST));
         if (!current_hash->next) {
             AMVP_LOG_ERR("Malloc Failed -- enable rsa cap parm");
             return AMVP_MALLOC_FAIL;
@@ -4573,7 +4713,7 @@ AMVP_RESULT amvp_cap_rsa_siggen_set_mod_parm(AMVP_CTX *ctx,
         return AMVP_INVALID_ARG;
     }
 
-    cap_list = amvp_locate_cap_entry(ctx, AMVP_RSA_SIGGEN);
+    cap_list = amvp_cap_entry_for_update(ctx, AMVP_RSA_SIGGEN);
     if (!cap_list) {
         AMVP_LOG_ERR("Cap entry not found.");
         return AMVP_NO_CAP;
@@ -4592,7 +4732,7 @@ AMVP_RESULT amvp_cap_rsa_siggen_set_mod_parm(AMVP_CTX *ctx,
     }
 
     if (!siggen_cap->mode_capabilities) {
-        siggen_cap->mode_capabilities = calloc(1, sizeof(AMVP_RSA_MODE_CAPS_LIST));
+        siggen_cap->mode_capabilities = amvp_cap_alloc(ctx, sizeof(AMVP_RSA_MODE_CAPS_LIST));
         if (!siggen_cap->mode_capabilities) {
             AMVP_LOG_ERR("Malloc Failed -- enable rsa cap parm");
             return AMVP_MALLOC_FAIL;
@@ -4606,7 +4746,7 @@ AMVP_RESULT amvp_cap_rsa_siggen_set_mod_parm(AMVP_CTX *ctx,
         do {
             if (current_cap->modulo != mod) {
                 if (current_cap->next == NULL) {
-                    current_cap->next = calloc(1, sizeof(AMVP_RSA_MODE_CAPS_LIST));
+                    current_cap->next = amvp_cap_alloc(ctx, sizeof(AMVP_RSA_MODE_CAPS_LIST));
                     if (!current_cap->next) {
                         AMVP_LOG_ERR("Malloc Failed -- enable rsa cap parm");
                         return AMVP_MALLOC_FAIL;
@@ -4629,7 +4769,7 @@ AMVP_RESULT amvp_cap_rsa_siggen_set_mod_parm(AMVP_CTX *ctx,
     }
 
     if (!current_cap->hash_pair) {
-        current_cap->hash_pair = calloc(1, sizeof(AMVP_RSA_HASH_PAIR_LIST));
+        current_cap->hash_pair = amvp_cap_alloc(ctx, sizeof(AMVP_RSA_HASH_PAIR_LIST));
         if (!current_cap->hash_pair) {
             AMVP_LOG_ERR("Malloc Failed -- enable rsa cap parm");
             return AMVP_MALLOC_FAIL;
@@ -4643,7 +4783,7 @@ AMVP_RESULT amvp_cap_rsa_siggen_set_mod_parm(AMVP_CTX *ctx,
         while (current_hash->next != NULL) {
             current_hash = current_hash->next;
         }
-        current_hash->next = calloc(1, sizeof(AMVP_RSA_HASH_PAIR_LIST));
+        current_hash->next = amvp_cap_alloc(ctx, sizeof(AMVP_RSA_HASH_PAIR_LIST));
         if (!current_hash->next) {
             AMVP_LOG_ERR("Malloc Failed -- enable rsa cap parm");
             return AMVP_MALLOC_FAIL;
@@ -4708,6 +4848,7 @@ AMVP_RESULT amvp_cap_rsa_sig_enable(AMVP_CTX *ctx,
     if (!ctx) {
         return AMVP_NO_CTX;
     }
+    amvp_registration_invalidate(ctx);
 
     if (!crypto_handler) {
         AMVP_LOG_ERR("NULL parameter 'crypto_handler'");
@@ -4754,6 +4895,7 @@ AMVP_RESULT amvp_cap_rsa_prim_enable(AMVP_CTX *ctx,
     if (!ctx) {
         return AMVP_NO_CTX;
     }
+    amvp_registration_invalidate(ctx);
 
     if (!crypto_handler) {
         AMVP_LOG_ERR("NULL parameter 'crypto_handler'");
@@ -4785,7 +4927,7 @@ AMVP_RESULT amvp_cap_rsa_prim_set_parm(AMVP_CTX *ctx,
     AMVP_CAPS_LIST *cap_list;
     AMVP_RESULT rv = AMVP_SUCCESS;
 
-    cap_list = amvp_locate_cap_entry(ctx, AMVP_RSA_SIGPRIM);
+    cap_list = amvp_cap_entry_for_update(ctx, AMVP_RSA_SIGPRIM);
     if (!cap_list) {
         AMVP_LOG_ERR("Cap entry not found.");
         return AMVP_NO_CAP;
@@ -4821,7 +4963,7 @@ AMVP_RESULT amvp_cap_rsa_prim_set_exponent(AMVP_CTX *ctx,
     AMVP_CAPS_LIST *cap_list = NULL;
     AMVP_RSA_PRIM_CAP *cap = NULL;
 
-    cap_list = amvp_locate_cap_entry(ctx, AMVP_RSA_SIGPRIM);
+    cap_list = amvp_cap_entry_for_update(ctx, AMVP_RSA_SIGPRIM);
     if (!cap_list) {
         AMVP_LOG_ERR("Cap entry not found.");
         return AMVP_NO_CAP;
@@ -4846,7 +4988,7 @@ AMVP_RESULT amvp_cap_rsa_prim_set_exponent(AMVP_CTX *ctx,
                     return AMVP_INVALID_ARG;
                 }
 
-                cap->fixed_pub_exp = calloc(len + 1, sizeof(char));
+                cap->fixed_pub_exp = amvp_cap_alloc(ctx, len + 1);
                 strcpy_s(cap->fixed_pub_exp, len + 1, value);
             } else {
                 AMVP_LOG_ERR("AMVP_FIXED_PUB_EXP_VAL has already been set.");
@@ -4880,7 +5022,7 @@ AMVP_RESULT amvp_cap_ecdsa_set_parm(AMVP_CTX *ctx,
     AMVP_SUB_ECDSA alg;
     AMVP_RESULT result = AMVP_SUCCESS;
 
-    cap_list = amvp_locate_cap_entry(ctx, cipher);
+    cap_list = amvp_cap_entry_for_update(ctx, cipher);
     if (!cap_list) {
         AMVP_LOG_ERR("Cap entry not found.");
         return AMVP_NO_CAP;
@@ -4924,10 +5066,10 @@ AMVP_RESULT amvp_cap_ecdsa_set_parm(AMVP_CTX *ctx,
             while (current_curve->next) {
                 current_curve = current_curve->next;
             }
-            current_curve->next = calloc(1, sizeof(AMVP_CURVE_ALG_COMPAT_LIST));
+            current_curve->next = amvp_cap_alloc(ctx, sizeof(AMVP_CURVE_ALG_COMPAT_LIST));
             current_curve->next->curve = value;
         } else {
-            cap->curves = calloc(1, sizeof(AMVP_CURVE_ALG_COMPAT_LIST));
+            cap->curves = amvp_cap_alloc(ctx, sizeof(AMVP_CURVE_ALG_COMPAT_LIST));
             cap->curves->curve = value;
         }
         break;
@@ -4948,7 +5090,7 @@ AMVP_RESULT amvp_cap_ecdsa_set_parm(AMVP_CTX *ctx,
             return AMVP_INVALID_ARG;
         }
 
-        result = amvp_append_name_list(&cap->secret_gen_modes, string);
+        result = amvp_append_name_list(amvp_cap_arena(ctx), &cap->secret_gen_modes, string);
         break;
     case AMVP_ECDSA_HASH_ALG:
         if (cipher != AMVP_ECDSA_SIGGEN && cipher != AMVP_ECDSA_SIGVER) {
@@ -5006,7 +5148,7 @@ AMVP_RESULT amvp_cap_ecdsa_set_curve_hash_alg(AMVP_CTX *ctx, AMVP_CIPHER cipher,
         return AMVP_INVALID_ARG;
     }
 
-    cap = amvp_locate_cap_entry(ctx, cipher);
+    cap = amvp_cap_entry_for_update(ctx, cipher);
     if (!cap) {
         return AMVP_NO_CAP;
     }
@@ -5044,6 +5186,7 @@ AMVP_RESULT amvp_cap_ecdsa_enable(AMVP_CTX *ctx,
     if (!ctx) {
         return AMVP_NO_CTX;
     }
+    amvp_registration_invalidate(ctx);
 
     if (!crypto_handler) {
         AMVP_LOG_ERR("NULL parameter 'crypto_handler'");
@@ -5101,7 +5244,7 @@ AMVP_RESULT amvp_cap_dsa_set_parm(AMVP_CTX *ctx,
     /*
      * Locate this cipher in the caps array
      */
-    cap_list = amvp_locate_cap_entry(ctx, cipher);
+    cap_list = amvp_cap_entry_for_update(ctx, cipher);
     if (!cap_list) {
         AMVP_LOG_ERR("Cap entry not found.");
         return AMVP_NO_CAP;
@@ -5173,7 +5316,7 @@ AMVP_RESULT amvp_cap_kdf135_snmp_set_parm(AMVP_CTX *ctx,
         return AMVP_INVALID_ARG;
     }
 
-    cap = amvp_locate_cap_entry(ctx, kcap);
+    cap = amvp_cap_entry_for_update(ctx, kcap);
     if (!cap) {
         return AMVP_NO_CAP;
     }
@@ -5183,7 +5326,7 @@ AMVP_RESULT amvp_cap_kdf135_snmp_set_parm(AMVP_CTX *ctx,
         return AMVP_NO_CAP;
     }
 
-    amvp_append_sl_list(&kdf135_snmp_cap->pass_lens, value);
+    amvp_value_set_add(amvp_cap_arena(ctx), &kdf135_snmp_cap->pass_lens, value);
 
     return AMVP_SUCCESS;
 }
@@ -5212,7 +5355,7 @@ AMVP_RESULT amvp_cap_kdf135_snmp_set_engid(AMVP_CTX *ctx,
         return AMVP_INVALID_ARG;
     }
 
-    cap = amvp_locate_cap_entry(ctx, kcap);
+    cap = amvp_cap_entry_for_update(ctx, kcap);
     if (!cap) {
         return AMVP_NO_CAP;
     }
@@ -5222,7 +5365,7 @@ AMVP_RESULT amvp_cap_kdf135_snmp_set_engid(AMVP_CTX *ctx,
         return AMVP_NO_CAP;
     }
 
-    result = amvp_append_name_list(&kdf135_snmp_cap->eng_ids, engid);
+    result = amvp_append_name_list(amvp_cap_arena(ctx), &kdf135_snmp_cap->eng_ids, engid);
 
     return result;
 }
@@ -5234,6 +5377,7 @@ AMVP_RESULT amvp_cap_kdf135_srtp_enable(AMVP_CTX *ctx,
     if (!ctx) {
         return AMVP_NO_CTX;
     }
+    amvp_registration_invalidate(ctx);
     if (!crypto_handler) {
         AMVP_LOG_ERR("NULL parameter 'crypto_handler'");
         return AMVP_INVALID_ARG;
@@ -5257,6 +5401,7 @@ AMVP_RESULT amvp_cap_kdf135_ikev2_enable(AMVP_CTX *ctx,
     if (!ctx) {
         return AMVP_NO_CTX;
     }
+    amvp_registration_invalidate(ctx);
     if (!crypto_handler) {
         AMVP_LOG_ERR("NULL parameter 'crypto_handler'");
         return AMVP_INVALID_ARG;
@@ -5281,6 +5426,7 @@ AMVP_RESULT amvp_cap_kdf135_x942_enable(AMVP_CTX *ctx,
     if (!ctx) {
         return AMVP_NO_CTX;
     }
+    amvp_registration_invalidate(ctx);
     if (!crypto_handler) {
         AMVP_LOG_ERR("NULL parameter 'crypto_handler'");
         return AMVP_INVALID_ARG;
@@ -5305,6 +5451,7 @@ AMVP_RESULT amvp_cap_kdf135_x963_enable(AMVP_CTX *ctx,
     if (!ctx) {
         return AMVP_NO_CTX;
     }
+    amvp_registration_invalidate(ctx);
     if (!crypto_handler) {
         AMVP_LOG_ERR("NULL parameter 'crypto_handler'");
         return AMVP_INVALID_ARG;
@@ -5328,6 +5475,7 @@ AMVP_RESULT amvp_cap_kdf135_ikev1_enable(AMVP_CTX *ctx,
     if (!ctx) {
         return AMVP_NO_CTX;
     }
+    amvp_registration_invalidate(ctx);
     if (!crypto_handler) {
         AMVP_LOG_ERR("NULL parameter 'crypto_handler'");
         return AMVP_INVALID_ARG;
@@ -5351,6 +5499,7 @@ AMVP_RESULT amvp_cap_kdf108_enable(AMVP_CTX *ctx,
     if (!ctx) {
         return AMVP_NO_CTX;
     }
+    amvp_registration_invalidate(ctx);
     if (!crypto_handler) {
         AMVP_LOG_ERR("NULL parameter 'crypto_handler'");
         return AMVP_INVALID_ARG;
@@ -5374,6 +5523,7 @@ AMVP_RESULT amvp_cap_kdf135_snmp_enable(AMVP_CTX *ctx,
     if (!ctx) {
         return AMVP_NO_CTX;
     }
+    amvp_registration_invalidate(ctx);
 
     if (!crypto_handler) {
         AMVP_LOG_ERR("NULL parameter 'crypto_handler'");
@@ -5398,6 +5548,7 @@ AMVP_RESULT amvp_cap_kdf135_ssh_enable(AMVP_CTX *ctx,
     if (!ctx) {
         return AMVP_NO_CTX;
     }
+    amvp_registration_invalidate(ctx);
 
     if (!crypto_handler) {
         AMVP_LOG_ERR("NULL parameter 'crypto_handler'");
@@ -5422,6 +5573,7 @@ AMVP_RESULT amvp_cap_pbkdf_enable(AMVP_CTX *ctx,
     if (!ctx) {
         return AMVP_NO_CTX;
     }
+    amvp_registration_invalidate(ctx);
 
     if (!crypto_handler) {
         AMVP_LOG_ERR("NULL parameter 'crypto_handler'");
@@ -5446,7 +5598,7 @@ AMVP_RESULT amvp_cap_pbkdf_set_domain(AMVP_CTX *ctx,
     AMVP_CAPS_LIST *cap_list;
     AMVP_JSON_DOMAIN_OBJ *domain;
 
-    cap_list = amvp_locate_cap_entry(ctx, AMVP_PBKDF);
+    cap_list = amvp_cap_entry_for_update(ctx, AMVP_PBKDF);
     if (!cap_list) {
         AMVP_LOG_ERR("Cap entry not found.");
         return AMVP_NO_CAP;
@@ -5510,7 +5662,7 @@ AMVP_RESULT amvp_cap_pbkdf_set_parm(AMVP_CTX *ctx,
     const char *alg_str = NULL;
     AMVP_RESULT result = AMVP_SUCCESS;
 
-    cap_list = amvp_locate_cap_entry(ctx, AMVP_PBKDF);
+    cap_list = amvp_cap_entry_for_update(ctx, AMVP_PBKDF);
     if (!cap_list) {
         AMVP_LOG_ERR("Cap entry not found. You must enable algorithm before setting parameters.");
         return AMVP_NO_CAP;
@@ -5530,7 +5682,7 @@ AMVP_RESULT amvp_cap_pbkdf_set_parm(AMVP_CTX *ctx,
     if (amvp_is_in_name_list(cap->hmac_algs, alg_str)) {
         AMVP_LOG_WARN("Attempting to register an hmac alg with PBKDF that has already been registered, skipping.");
     } else {
-        result = amvp_append_name_list(&cap->hmac_algs, alg_str);
+        result = amvp_append_name_list(amvp_cap_arena(ctx), &cap->hmac_algs, alg_str);
     }
     return result;
 }
@@ -5550,7 +5702,7 @@ AMVP_RESULT amvp_cap_kdf135_ssh_set_parm(AMVP_CTX *ctx,
         return AMVP_NO_CTX;
     }
 
-    cap = amvp_locate_cap_entry(ctx, kcap);
+    cap = amvp_cap_entry_for_update(ctx, kcap);
     if (!cap) {
         return AMVP_NO_CAP;
     }
@@ -5605,7 +5757,7 @@ AMVP_RESULT amvp_cap_kdf108_set_parm(AMVP_CTX *ctx,
         return AMVP_NO_CTX;
     }
 
-    cap = amvp_locate_cap_entry(ctx, AMVP_KDF108);
+    cap = amvp_cap_entry_for_update(ctx, AMVP_KDF108);
 
     if (!cap) {
         return AMVP_NO_CAP;
@@ -5648,31 +5800,31 @@ AMVP_RESULT amvp_cap_kdf108_set_parm(AMVP_CTX *ctx,
     case AMVP_KDF108_MAC_MODE:
         switch (value) {
         case AMVP_KDF108_MAC_MODE_CMAC_AES128:
-            result = amvp_append_name_list(&mode_obj->mac_mode, AMVP_ALG_CMAC_AES_128);
+            result = amvp_append_name_list(amvp_cap_arena(ctx), &mode_obj->mac_mode, AMVP_ALG_CMAC_AES_128);
             break;
         case AMVP_KDF108_MAC_MODE_CMAC_AES192:
-            result = amvp_append_name_list(&mode_obj->mac_mode, AMVP_ALG_CMAC_AES_192);
+            result = amvp_append_name_list(amvp_cap_arena(ctx), &mode_obj->mac_mode, AMVP_ALG_CMAC_AES_192);
             break;
         case AMVP_KDF108_MAC_MODE_CMAC_AES256:
-            result = amvp_append_name_list(&mode_obj->mac_mode, AMVP_ALG_CMAC_AES_256);
+            result = amvp_append_name_list(amvp_cap_arena(ctx), &mode_obj->mac_mode, AMVP_ALG_CMAC_AES_256);
             break;
         case AMVP_KDF108_MAC_MODE_CMAC_TDES:
-            result = amvp_append_name_list(&mode_obj->mac_mode, AMVP_ALG_CMAC_TDES);
+            result = amvp_append_name_list(amvp_cap_arena(ctx), &mode_obj->mac_mode, AMVP_ALG_CMAC_TDES);
             break;
         case AMVP_KDF108_MAC_MODE_HMAC_SHA1:
-            result = amvp_append_name_list(&mode_obj->mac_mode, AMVP_ALG_HMAC_SHA1);
+            result = amvp_append_name_list(amvp_cap_arena(ctx), &mode_obj->mac_mode, AMVP_ALG_HMAC_SHA1);
             break;
         case AMVP_KDF108_MAC_MODE_HMAC_SHA224:
-            result = amvp_append_name_list(&mode_obj->mac_mode, AMVP_ALG_HMAC_SHA2_224);
+            result = amvp_append_name_list(amvp_cap_arena(ctx), &mode_obj->mac_mode, AMVP_ALG_HMAC_SHA2_224);
             break;
         case AMVP_KDF108_MAC_MODE_HMAC_SHA256:
-            result = amvp_append_name_list(&mode_obj->mac_mode, AMVP_ALG_HMAC_SHA2_256);
+            result = amvp_append_name_list(amvp_cap_arena(ctx), &mode_obj->mac_mode, AMVP_ALG_HMAC_SHA2_256);
             break;
         case AMVP_KDF108_MAC_MODE_HMAC_SHA384:
-            result = amvp_append_name_list(&mode_obj->mac_mode, AMVP_ALG_HMAC_SHA2_384);
+            result = amvp_append_name_list(amvp_cap_arena(ctx), &mode_obj->mac_mode, AMVP_ALG_HMAC_SHA2_384);
             break;
         case AMVP_KDF108_MAC_MODE_HMAC_SHA512:
-            result = amvp_append_name_list(&mode_obj->mac_mode, AMVP_ALG_HMAC_SHA2_512);
+            result = amvp_append_name_list(amvp_cap_arena(ctx), &mode_obj->mac_mode, AMVP_ALG_HMAC_SHA2_512);
             break;
         case AMVP_KDF108_MAC_MODE_HMAC_SHA512_224:
         case AMVP_KDF108_MAC_MODE_HMAC_SHA512_256:
@@ -5685,24 +5837,24 @@ AMVP_RESULT amvp_cap_kdf108_set_parm(AMVP_CTX *ctx,
         }
         break;
     case AMVP_KDF108_COUNTER_LEN:
-        amvp_append_sl_list(&mode_obj->counter_lens, value);
+        amvp_value_set_add(amvp_cap_arena(ctx), &mode_obj->counter_lens, value);
         break;
     case AMVP_KDF108_FIXED_DATA_ORDER:
         switch (value) {
         case AMVP_KDF108_FIXED_DATA_ORDER_AFTER:
-            result = amvp_append_name_list(&mode_obj->data_order, AMVP_FIXED_DATA_ORDER_AFTER_STR);
+            result = amvp_append_name_list(amvp_cap_arena(ctx), &mode_obj->data_order, AMVP_FIXED_DATA_ORDER_AFTER_STR);
             break;
         case AMVP_KDF108_FIXED_DATA_ORDER_BEFORE:
-            result = amvp_append_name_list(&mode_obj->data_order, AMVP_FIXED_DATA_ORDER_BEFORE_STR);
+            result = amvp_append_name_list(amvp_cap_arena(ctx), &mode_obj->data_order, AMVP_FIXED_DATA_ORDER_BEFORE_STR);
             break;
         case AMVP_KDF108_FIXED_DATA_ORDER_MIDDLE:
-            result = amvp_append_name_list(&mode_obj->data_order, AMVP_FIXED_DATA_ORDER_MIDDLE_STR);
+            result = amvp_append_name_list(amvp_cap_arena(ctx), &mode_obj->data_order, AMVP_FIXED_DATA_ORDER_MIDDLE_STR);
             break;
         case AMVP_KDF108_FIXED_DATA_ORDER_NONE:
-            result = amvp_append_name_list(&mode_obj->data_order, AMVP_FIXED_DATA_ORDER_NONE_STR);
+            result = amvp_append_name_list(amvp_cap_arena(ctx), &mode_obj->data_order, AMVP_FIXED_DATA_ORDER_NONE_STR);
             break;
         case AMVP_KDF108_FIXED_DATA_ORDER_BEFORE_ITERATOR:
-            result = amvp_append_name_list(&mode_obj->data_order, AMVP_FIXED_DATA_ORDER_BEFORE_ITERATOR_STR);
+            result = amvp_append_name_list(amvp_cap_arena(ctx), &mode_obj->data_order, AMVP_FIXED_DATA_ORDER_BEFORE_ITERATOR_STR);
             break;
         default:
             return AMVP_INVALID_ARG;
@@ -5720,7 +5872,7 @@ AMVP_RESULT amvp_cap_kdf108_set_parm(AMVP_CTX *ctx,
        }
        break;
     case AMVP_KDF108_SUPPORTED_LEN:
-        if (amvp_append_sl_list(&mode_obj->supported_lens.values, value) != AMVP_SUCCESS) {
+        if (amvp_value_set_add(amvp_cap_arena(ctx), &mode_obj->supported_lens.values, value) != AMVP_SUCCESS) {
             AMVP_LOG_ERR("Error adding supported length for KDF108 to list");
             return AMVP_MALLOC_FAIL;
         }
@@ -5754,7 +5906,7 @@ AMVP_RESULT amvp_cap_kdf135_srtp_set_parm(AMVP_CTX *ctx,
         return AMVP_INVALID_ARG;
     }
 
-    cap = amvp_locate_cap_entry(ctx, cipher);
+    cap = amvp_cap_entry_for_update(ctx, cipher);
     if (!cap) {
         return AMVP_NO_CAP;
     }
@@ -5775,7 +5927,7 @@ AMVP_RESULT amvp_cap_kdf135_srtp_set_parm(AMVP_CTX *ctx,
             AMVP_LOG_ERR("invalid aes keylen");
             return AMVP_INVALID_ARG;
         }
-        amvp_append_sl_list(&kdf135_srtp_cap->aes_keylens, value);
+        amvp_value_set_add(amvp_cap_arena(ctx), &kdf135_srtp_cap->aes_keylens, value);
         break;
     case AMVP_SRTP_SUPPORT_ZERO_KDR:
         if (is_valid_tf_param(value) != AMVP_SUCCESS) {
@@ -5806,6 +5958,7 @@ AMVP_RESULT amvp_cap_dsa_enable(AMVP_CTX *ctx,
     if (!ctx) {
         return AMVP_NO_CTX;
     }
+    amvp_registration_invalidate(ctx);
     if (!crypto_handler) {
         AMVP_LOG_ERR("NULL parameter 'crypto_handler'");
         return AMVP_INVALID_ARG;
@@ -5829,7 +5982,7 @@ AMVP_RESULT amvp_cap_kdf135_ikev2_set_parm(AMVP_CTX *ctx,
     AMVP_KDF135_IKEV2_CAP *cap = NULL;
     AMVP_RESULT result = AMVP_SUCCESS;
 
-    cap_list = amvp_locate_cap_entry(ctx, AMVP_KDF135_IKEV2);
+    cap_list = amvp_cap_entry_for_update(ctx, AMVP_KDF135_IKEV2);
     if (!cap_list) {
         AMVP_LOG_ERR("Cap entry not found.");
         return AMVP_NO_CAP;
@@ -5843,19 +5996,19 @@ AMVP_RESULT amvp_cap_kdf135_ikev2_set_parm(AMVP_CTX *ctx,
 
     switch (value) {
     case AMVP_SHA1:
-        result = amvp_append_name_list(&cap->hash_algs, AMVP_STR_SHA_1);
+        result = amvp_append_name_list(amvp_cap_arena(ctx), &cap->hash_algs, AMVP_STR_SHA_1);
         break;
     case AMVP_SHA224:
-        result = amvp_append_name_list(&cap->hash_algs, AMVP_STR_SHA2_224);
+        result = amvp_append_name_list(amvp_cap_arena(ctx), &cap->hash_algs, AMVP_STR_SHA2_224);
         break;
     case AMVP_SHA256:
-        result = amvp_append_name_list(&cap->hash_algs, AMVP_STR_SHA2_256);
+        result = amvp_append_name_list(amvp_cap_arena(ctx), &cap->hash_algs, AMVP_STR_SHA2_256);
         break;
     case AMVP_SHA384:
-        result = amvp_append_name_list(&cap->hash_algs, AMVP_STR_SHA2_384);
+        result = amvp_append_name_list(amvp_cap_arena(ctx), &cap->hash_algs, AMVP_STR_SHA2_384);
         break;
     case AMVP_SHA512:
-        result = amvp_append_name_list(&cap->hash_algs, AMVP_STR_SHA2_512);
+        result = amvp_append_name_list(amvp_cap_arena(ctx), &cap->hash_algs, AMVP_STR_SHA2_512);
         break;
     default:
         AMVP_LOG_ERR("Invalid hash algorithm.");
@@ -5872,7 +6025,7 @@ AMVP_RESULT amvp_cap_kdf135_ikev2_set_length(AMVP_CTX *ctx,
     AMVP_KDF135_IKEV2_CAP *cap;
     AMVP_JSON_DOMAIN_OBJ *domain;
 
-    cap_list = amvp_locate_cap_entry(ctx, AMVP_KDF135_IKEV2);
+    cap_list = amvp_cap_entry_for_update(ctx, AMVP_KDF135_IKEV2);
     if (!cap_list) {
         AMVP_LOG_ERR("Cap entry not found.");
         return AMVP_NO_CAP;
@@ -5917,7 +6070,7 @@ AMVP_RESULT amvp_cap_kdf135_ikev2_set_length(AMVP_CTX *ctx,
         return AMVP_INVALID_ARG;
     }
 
-    if (amvp_append_sl_list(&domain->values, value) != AMVP_SUCCESS) {
+    if (amvp_value_set_add(amvp_cap_arena(ctx), &domain->values, value) != AMVP_SUCCESS) {
         AMVP_LOG_ERR("Error adding provided length to list for IKEV2");
         return AMVP_MALLOC_FAIL;
     }
@@ -5932,7 +6085,7 @@ AMVP_RESULT amvp_cap_kdf135_ikev1_set_parm(AMVP_CTX *ctx,
     AMVP_RESULT result = AMVP_SUCCESS;
     AMVP_KDF135_IKEV1_CAP *cap;
 
-    cap_list = amvp_locate_cap_entry(ctx, AMVP_KDF135_IKEV1);
+    cap_list = amvp_cap_entry_for_update(ctx, AMVP_KDF135_IKEV1);
     if (!cap_list) {
         AMVP_LOG_ERR("Cap entry not found.");
         return AMVP_NO_CAP;
@@ -5942,19 +6095,19 @@ AMVP_RESULT amvp_cap_kdf135_ikev1_set_parm(AMVP_CTX *ctx,
     if (param == AMVP_KDF_IKEv1_HASH_ALG) {
         switch (value) {
         case AMVP_SHA1:
-            result = amvp_append_name_list(&cap->hash_algs, AMVP_STR_SHA_1);
+            result = amvp_append_name_list(amvp_cap_arena(ctx), &cap->hash_algs, AMVP_STR_SHA_1);
             break;
         case AMVP_SHA224:
-            result = amvp_append_name_list(&cap->hash_algs, AMVP_STR_SHA2_224);
+            result = amvp_append_name_list(amvp_cap_arena(ctx), &cap->hash_algs, AMVP_STR_SHA2_224);
             break;
         case AMVP_SHA256:
-            result = amvp_append_name_list(&cap->hash_algs, AMVP_STR_SHA2_256);
+            result = amvp_append_name_list(amvp_cap_arena(ctx), &cap->hash_algs, AMVP_STR_SHA2_256);
             break;
         case AMVP_SHA384:
-            result = amvp_append_name_list(&cap->hash_algs, AMVP_STR_SHA2_384);
+            result = amvp_append_name_list(amvp_cap_arena(ctx), &cap->hash_algs, AMVP_STR_SHA2_384);
             break;
         case AMVP_SHA512:
-            result = amvp_append_name_list(&cap->hash_algs, AMVP_STR_SHA2_512);
+            result = amvp_append_name_list(amvp_cap_arena(ctx), &cap->hash_algs, AMVP_STR_SHA2_512);
             break;
         default:
             AMVP_LOG_ERR("Invalid hash algorithm.");
@@ -5995,7 +6148,7 @@ AMVP_RESULT amvp_cap_kdf135_x942_set_domain(AMVP_CTX *ctx,
     AMVP_KDF135_X942_CAP *cap = NULL;
     AMVP_JSON_DOMAIN_OBJ *domain = NULL;
 
-    cap_list = amvp_locate_cap_entry(ctx, AMVP_KDF135_X942);
+    cap_list = amvp_cap_entry_for_update(ctx, AMVP_KDF135_X942);
     if (!cap_list) {
         AMVP_LOG_ERR("Cap entry not found.");
         return AMVP_NO_CAP;
@@ -6042,7 +6195,7 @@ AMVP_RESULT amvp_cap_kdf135_x942_set_parm(AMVP_CTX *ctx,
     AMVP_KDF135_X942_CAP *cap;
     const char *alg = NULL;
 
-    cap_list = amvp_locate_cap_entry(ctx, AMVP_KDF135_X942);
+    cap_list = amvp_cap_entry_for_update(ctx, AMVP_KDF135_X942);
     if (!cap_list) {
         AMVP_LOG_ERR("Cap entry not found.");
         return AMVP_NO_CAP;
@@ -6064,21 +6217,21 @@ AMVP_RESULT amvp_cap_kdf135_x942_set_parm(AMVP_CTX *ctx,
             AMVP_LOG_ERR("Invalid hash alg provided for kdf135-x942");
             return AMVP_INVALID_ARG;
         }
-        amvp_append_name_list(&cap->hash_algs, alg);
+        amvp_append_name_list(amvp_cap_arena(ctx), &cap->hash_algs, alg);
         break;
     case AMVP_KDF_X942_OID:
         switch (value) {
         case AMVP_KDF_X942_OID_TDES:
-            amvp_append_name_list(&cap->oids, "TDES");
+            amvp_append_name_list(amvp_cap_arena(ctx), &cap->oids, "TDES");
             break;
         case AMVP_KDF_X942_OID_AES128KW:
-            amvp_append_name_list(&cap->oids, "AES-128-KW");
+            amvp_append_name_list(amvp_cap_arena(ctx), &cap->oids, "AES-128-KW");
             break;
         case AMVP_KDF_X942_OID_AES192KW:
-            amvp_append_name_list(&cap->oids, "AES-192-KW");
+            amvp_append_name_list(amvp_cap_arena(ctx), &cap->oids, "AES-192-KW");
             break;
         case AMVP_KDF_X942_OID_AES256KW:
-            amvp_append_name_list(&cap->oids, "AES-256-KW");
+            amvp_append_name_list(amvp_cap_arena(ctx), &cap->oids, "AES-256-KW");
             break;
         default:
             AMVP_LOG_ERR("Invalid OID provided for kdf135-x942");
@@ -6105,7 +6258,7 @@ AMVP_RESULT amvp_cap_kdf135_x963_set_parm(AMVP_CTX *ctx,
     AMVP_KDF135_X963_CAP *cap;
     AMVP_RESULT result = AMVP_SUCCESS;
 
-    cap_list = amvp_locate_cap_entry(ctx, AMVP_KDF135_X963);
+    cap_list = amvp_cap_entry_for_update(ctx, AMVP_KDF135_X963);
     if (!cap_list) {
         AMVP_LOG_ERR("Cap entry not found.");
         return AMVP_NO_CAP;
@@ -6115,16 +6268,16 @@ AMVP_RESULT amvp_cap_kdf135_x963_set_parm(AMVP_CTX *ctx,
     if (param == AMVP_KDF_X963_HASH_ALG) {
         switch (value) {
         case AMVP_SHA224:
-            result = amvp_append_name_list(&cap->hash_algs, AMVP_STR_SHA2_224);
+            result = amvp_append_name_list(amvp_cap_arena(ctx), &cap->hash_algs, AMVP_STR_SHA2_224);
             break;
         case AMVP_SHA256:
-            result = amvp_append_name_list(&cap->hash_algs, AMVP_STR_SHA2_256);
+            result = amvp_append_name_list(amvp_cap_arena(ctx), &cap->hash_algs, AMVP_STR_SHA2_256);
             break;
         case AMVP_SHA384:
-            result = amvp_append_name_list(&cap->hash_algs, AMVP_STR_SHA2_384);
+            result = amvp_append_name_list(amvp_cap_arena(ctx), &cap->hash_algs, AMVP_STR_SHA2_384);
             break;
         case AMVP_SHA512:
-            result = amvp_append_name_list(&cap->hash_algs, AMVP_STR_SHA2_512);
+            result = amvp_append_name_list(amvp_cap_arena(ctx), &cap->hash_algs, AMVP_STR_SHA2_512);
             break;
         default:
             AMVP_LOG_ERR("Invalid hash alg");
@@ -6138,7 +6291,7 @@ AMVP_RESULT amvp_cap_kdf135_x963_set_parm(AMVP_CTX *ctx,
                 AMVP_LOG_ERR("invalid key len value");
                 return AMVP_INVALID_ARG;
             }
-            amvp_append_sl_list(&cap->key_data_lengths, value);
+            amvp_value_set_add(amvp_cap_arena(ctx), &cap->key_data_lengths, value);
             break;
         case AMVP_KDF_X963_FIELD_SIZE:
             if (value != AMVP_KDF135_X963_FIELD_SIZE_224 &&
@@ -6152,7 +6305,7 @@ AMVP_RESULT amvp_cap_kdf135_x963_set_parm(AMVP_CTX *ctx,
                 AMVP_LOG_ERR("invalid field size value");
                 return AMVP_INVALID_ARG;
             }
-            amvp_append_sl_list(&cap->field_sizes, value);
+            amvp_value_set_add(amvp_cap_arena(ctx), &cap->field_sizes, value);
             break;
         case AMVP_KDF_X963_SHARED_INFO_LEN:
             if (value < AMVP_KDF135_X963_SHARED_INFO_LEN_MIN ||
@@ -6160,7 +6313,7 @@ AMVP_RESULT amvp_cap_kdf135_x963_set_parm(AMVP_CTX *ctx,
                 AMVP_LOG_ERR("invalid shared info len value");
                 return AMVP_INVALID_ARG;
             }
-            amvp_append_sl_list(&cap->shared_info_lengths, value);
+            amvp_value_set_add(amvp_cap_arena(ctx), &cap->shared_info_lengths, value);
             break;
         case AMVP_KDF_X963_HASH_ALG:
         default:
@@ -6179,7 +6332,7 @@ AMVP_RESULT amvp_cap_kdf135_ikev2_set_domain(AMVP_CTX *ctx,
     AMVP_CAPS_LIST *cap_list;
     AMVP_JSON_DOMAIN_OBJ *domain;
 
-    cap_list = amvp_locate_cap_entry(ctx, AMVP_KDF135_IKEV2);
+    cap_list = amvp_cap_entry_for_update(ctx, AMVP_KDF135_IKEV2);
     if (!cap_list) {
         AMVP_LOG_ERR("Cap entry not found.");
         return AMVP_NO_CAP;
@@ -6238,7 +6391,7 @@ AMVP_RESULT amvp_cap_kdf135_ikev1_set_domain(AMVP_CTX *ctx,
     AMVP_CAPS_LIST *cap_list;
     AMVP_JSON_DOMAIN_OBJ *domain;
 
-    cap_list = amvp_locate_cap_entry(ctx, AMVP_KDF135_IKEV1);
+    cap_list = amvp_cap_entry_for_update(ctx, AMVP_KDF135_IKEV1);
     if (!cap_list) {
         AMVP_LOG_ERR("Cap entry not found.");
         return AMVP_NO_CAP;
@@ -6299,7 +6452,7 @@ AMVP_RESULT amvp_cap_kdf108_set_domain(AMVP_CTX *ctx,
     AMVP_JSON_DOMAIN_OBJ *domain;
     AMVP_KDF108_MODE_PARAMS *mode_obj;
 
-    cap_list = amvp_locate_cap_entry(ctx, AMVP_KDF108);
+    cap_list = amvp_cap_entry_for_update(ctx, AMVP_KDF108);
     if (!cap_list) {
         AMVP_LOG_ERR("Cap entry not found.");
         return AMVP_NO_CAP;
@@ -6352,6 +6505,7 @@ AMVP_RESULT amvp_cap_kdf_tls12_enable(AMVP_CTX *ctx,
     if (!ctx) {
         return AMVP_NO_CTX;
     }
+    amvp_registration_invalidate(ctx);
 
     if (!crypto_handler) {
         return AMVP_INVALID_ARG;
@@ -6385,7 +6539,7 @@ AMVP_RESULT amvp_cap_kdf_tls12_set_parm(AMVP_CTX *ctx,
         return AMVP_NO_CTX;
     }
 
-    cap_list = amvp_locate_cap_entry(ctx, AMVP_KDF_TLS12);
+    cap_list = amvp_cap_entry_for_update(ctx, AMVP_KDF_TLS12);
     if (!cap_list) {
         AMVP_LOG_ERR("Cap entry not found. You must enable algorithm before setting parameters.");
         return AMVP_NO_CAP;
@@ -6407,7 +6561,7 @@ AMVP_RESULT amvp_cap_kdf_tls12_set_parm(AMVP_CTX *ctx,
             AMVP_LOG_WARN("Attempting to register a hash alg with TLS 1.2 KDF that has already been registered, skipping.");
             return AMVP_SUCCESS;
         } else {
-            result = amvp_append_name_list(&cap->hash_algs, alg_str);
+            result = amvp_append_name_list(amvp_cap_arena(ctx), &cap->hash_algs, alg_str);
         }
         break;
     case AMVP_KDF_TLS12_PARAM_MIN:
@@ -6427,6 +6581,7 @@ AMVP_RESULT amvp_cap_kdf_tls13_enable(AMVP_CTX *ctx,
     if (!ctx) {
         return AMVP_NO_CTX;
     }
+    amvp_registration_invalidate(ctx);
 
     if (!crypto_handler) {
         AMVP_LOG_ERR("NULL parameter 'crypto_handler'");
@@ -6452,7 +6607,7 @@ AMVP_RESULT amvp_cap_kdf_tls13_set_parm(AMVP_CTX *ctx,
     AMVP_RESULT result = AMVP_SUCCESS;
     const char *alg_str = NULL;
 
-    cap_list = amvp_locate_cap_entry(ctx, AMVP_KDF_TLS13);
+    cap_list = amvp_cap_entry_for_update(ctx, AMVP_KDF_TLS13);
     if (!cap_list) {
         AMVP_LOG_ERR("Cap entry not found. You must enable algorithm before setting parameters.");
         return AMVP_NO_CAP;
@@ -6470,7 +6625,7 @@ AMVP_RESULT amvp_cap_kdf_tls13_set_parm(AMVP_CTX *ctx,
             AMVP_LOG_WARN("Attempting to register an hmac alg with TLS 1.3 KDF that has already been registered, skipping.");
             return AMVP_SUCCESS;
         } else {
-            result = amvp_append_name_list(&cap->hmac_algs, alg_str);
+            result = amvp_append_name_list(amvp_cap_arena(ctx), &cap->hmac_algs, alg_str);
         }
         break;
     case AMVP_KDF_TLS13_RUNNING_MODE:
@@ -6478,7 +6633,7 @@ AMVP_RESULT amvp_cap_kdf_tls13_set_parm(AMVP_CTX *ctx,
             AMVP_LOG_ERR("Invalid TLS 1.3 KDF running mode provided");
             return AMVP_INVALID_ARG;
         }
-        result = amvp_append_param_list(&cap->running_mode, value);
+        result = amvp_value_set_add(amvp_cap_arena(ctx), &cap->running_mode, value);
         break;
     case AMVP_KDF_TLS13_PARAM_MIN:
     default:
@@ -6498,7 +6653,7 @@ static AMVP_RESULT amvp_add_kas_ecc_prereq_val(AMVP_CTX *ctx, AMVP_KAS_ECC_CAP_M
     AMVP_PREREQ_LIST *prereq_entry, *prereq_entry_2;
 
     AMVP_LOG_INFO("KAS-ECC mode %d", mode);
-    prereq_entry = calloc(1, sizeof(AMVP_PREREQ_LIST));
+    prereq_entry = amvp_cap_alloc(ctx, sizeof(AMVP_PREREQ_LIST));
     if (!prereq_entry) {
         return AMVP_MALLOC_FAIL;
     }
@@ -6560,7 +6715,7 @@ AMVP_RESULT amvp_cap_kas_ecc_set_prereq(AMVP_CTX *ctx,
     /*
      * Locate this cipher in the caps array
      */
-    cap_list = amvp_locate_cap_entry(ctx, cipher);
+    cap_list = amvp_cap_entry_for_update(ctx, cipher);
     if (!cap_list) {
         AMVP_LOG_ERR("Cap entry not found.");
         return AMVP_NO_CAP;
@@ -6588,6 +6743,7 @@ AMVP_RESULT amvp_cap_kas_ecc_enable(AMVP_CTX *ctx,
     if (!ctx) {
         return AMVP_NO_CTX;
     }
+    amvp_registration_invalidate(ctx);
     if (!crypto_handler) {
         AMVP_LOG_ERR("NULL parameter 'crypto_handler'");
         return AMVP_INVALID_ARG;
@@ -6678,7 +6834,7 @@ AMVP_RESULT amvp_cap_kas_ecc_set_parm(AMVP_CTX *ctx,
         return AMVP_INVALID_ARG;
     }
 
-    cap = amvp_locate_cap_entry(ctx, cipher);
+    cap = amvp_cap_entry_for_update(ctx, cipher);
     if (!cap) {
         return AMVP_NO_CAP;
     }
@@ -6697,7 +6853,7 @@ AMVP_RESULT amvp_cap_kas_ecc_set_parm(AMVP_CTX *ctx,
                 AMVP_LOG_ERR("invalid kas ecc function");
                 return AMVP_INVALID_ARG;
             }
-            result = amvp_append_param_list(&kas_ecc_cap_mode->function, value);
+            result = amvp_value_set_add(amvp_cap_arena(ctx), &kas_ecc_cap_mode->function, value);
             break;
         case AMVP_KAS_ECC_REVISION:
             if (cipher == AMVP_KAS_ECC_CDH) {
@@ -6724,7 +6880,7 @@ AMVP_RESULT amvp_cap_kas_ecc_set_parm(AMVP_CTX *ctx,
                 AMVP_LOG_ERR("invalid kas ecc curve attr");
                 return AMVP_INVALID_ARG;
             }
-            result = amvp_append_param_list(&kas_ecc_cap_mode->curve, value);
+            result = amvp_value_set_add(amvp_cap_arena(ctx), &kas_ecc_cap_mode->curve, value);
             break;
         case AMVP_KAS_ECC_NONE:
             if (cipher == AMVP_KAS_ECC_SSC) {
@@ -6753,7 +6909,7 @@ AMVP_RESULT amvp_cap_kas_ecc_set_parm(AMVP_CTX *ctx,
                 AMVP_LOG_ERR("invalid kas ecc function");
                 return AMVP_INVALID_ARG;
             }
-            result = amvp_append_param_list(&kas_ecc_cap_mode->function, value);
+            result = amvp_value_set_add(amvp_cap_arena(ctx), &kas_ecc_cap_mode->function, value);
             break;
         case AMVP_KAS_ECC_REVISION:
         case AMVP_KAS_ECC_CURVE:
@@ -6829,7 +6985,7 @@ AMVP_RESULT amvp_cap_kas_ecc_set_scheme(AMVP_CTX *ctx,
         return AMVP_INVALID_ARG;
     }
 
-    cap = amvp_locate_cap_entry(ctx, cipher);
+    cap = amvp_cap_entry_for_update(ctx, cipher);
     if (!cap) {
         return AMVP_NO_CAP;
     }
@@ -6857,7 +7013,7 @@ AMVP_RESULT amvp_cap_kas_ecc_set_scheme(AMVP_CTX *ctx,
         }
         /* if there are none or didn't find the one we're looking for... */
         if (current_scheme == NULL) {
-            kas_ecc_cap_mode->scheme = calloc(1, sizeof(AMVP_KAS_ECC_SCHEME));
+            kas_ecc_cap_mode->scheme = amvp_cap_alloc(ctx, sizeof(AMVP_KAS_ECC_SCHEME));
             kas_ecc_cap_mode->scheme->scheme = scheme;
             current_scheme = kas_ecc_cap_mode->scheme;
         }
@@ -6873,7 +7029,7 @@ AMVP_RESULT amvp_cap_kas_ecc_set_scheme(AMVP_CTX *ctx,
                 value != AMVP_KAS_ECC_ROLE_RESPONDER) {
                 return AMVP_INVALID_ARG;
             }
-            result = amvp_append_param_list(&current_scheme->role, value);
+            result = amvp_value_set_add(amvp_cap_arena(ctx), &current_scheme->role, value);
             break;
         case AMVP_KAS_ECC_EB:
         case AMVP_KAS_ECC_EC:
@@ -6889,7 +7045,7 @@ AMVP_RESULT amvp_cap_kas_ecc_set_scheme(AMVP_CTX *ctx,
                 }
             }
             if (!current_pset) {
-                current_pset = calloc(1, sizeof(AMVP_KAS_ECC_PSET));
+                current_pset = amvp_cap_alloc(ctx, sizeof(AMVP_KAS_ECC_PSET));
                 if (current_scheme->pset == NULL) {
                     current_scheme->pset = current_pset;
                 } else {
@@ -6899,7 +7055,7 @@ AMVP_RESULT amvp_cap_kas_ecc_set_scheme(AMVP_CTX *ctx,
                 current_pset->curve = option;
             }
             //then set sha in a param list
-            result = amvp_append_param_list(&current_pset->sha, value);
+            result = amvp_value_set_add(amvp_cap_arena(ctx), &current_pset->sha, value);
             break;
         case AMVP_KAS_ECC_NONE:
             break;
@@ -6935,7 +7091,7 @@ static AMVP_RESULT amvp_add_kas_ffc_prereq_val(AMVP_CTX *ctx, AMVP_KAS_FFC_CAP_M
     AMVP_PREREQ_LIST *prereq_entry, *prereq_entry_2;
 
     AMVP_LOG_INFO("KAS-FFC mode %d", mode);
-    prereq_entry = calloc(1, sizeof(AMVP_PREREQ_LIST));
+    prereq_entry = amvp_cap_alloc(ctx, sizeof(AMVP_PREREQ_LIST));
     if (!prereq_entry) {
         return AMVP_MALLOC_FAIL;
     }
@@ -6997,7 +7153,7 @@ AMVP_RESULT amvp_cap_kas_ffc_set_prereq(AMVP_CTX *ctx,
     /*
      * Locate this cipher in the caps array
      */
-    cap_list = amvp_locate_cap_entry(ctx, cipher);
+    cap_list = amvp_cap_entry_for_update(ctx, cipher);
     if (!cap_list) {
         AMVP_LOG_ERR("Cap entry not found.");
         return AMVP_NO_CAP;
@@ -7025,6 +7181,7 @@ AMVP_RESULT amvp_cap_kas_ffc_enable(AMVP_CTX *ctx,
     if (!ctx) {
         return AMVP_NO_CTX;
     }
+    amvp_registration_invalidate(ctx);
     if (!crypto_handler) {
         AMVP_LOG_ERR("NULL parameter 'crypto_handler'");
         return AMVP_INVALID_ARG;
@@ -7113,7 +7270,7 @@ AMVP_RESULT amvp_cap_kas_ffc_set_parm(AMVP_CTX *ctx,
         return AMVP_INVALID_ARG;
     }
 
-    cap = amvp_locate_cap_entry(ctx, cipher);
+    cap = amvp_cap_entry_for_update(ctx, cipher);
     if (!cap) {
         return AMVP_NO_CAP;
     }
@@ -7131,7 +7288,7 @@ AMVP_RESULT amvp_cap_kas_ffc_set_parm(AMVP_CTX *ctx,
                 AMVP_LOG_ERR("invalid kas ffc function");
                 return AMVP_INVALID_ARG;
             }
-            result = amvp_append_param_list(&kas_ffc_cap_mode->function, value);
+            result = amvp_value_set_add(amvp_cap_arena(ctx), &kas_ffc_cap_mode->function, value);
             break;
         case AMVP_KAS_FFC_CURVE:
         case AMVP_KAS_FFC_ROLE:
@@ -7160,7 +7317,7 @@ AMVP_RESULT amvp_cap_kas_ffc_set_parm(AMVP_CTX *ctx,
     case AMVP_KAS_FFC_MODE_NONE:
         switch (param) {
         case AMVP_KAS_FFC_GEN_METH:
-            result = amvp_append_param_list(&kas_ffc_cap_mode->genmeth, value);
+            result = amvp_value_set_add(amvp_cap_arena(ctx), &kas_ffc_cap_mode->genmeth, value);
             break;
         case AMVP_KAS_FFC_HASH:
             if ((value < AMVP_NO_SHA || value >= AMVP_HASH_ALG_MAX) && !(value & (value - 1))) {
@@ -7221,7 +7378,7 @@ AMVP_RESULT amvp_cap_kas_ffc_set_scheme(AMVP_CTX *ctx,
         return AMVP_NO_CTX;
     }
 
-    cap = amvp_locate_cap_entry(ctx, cipher);
+    cap = amvp_cap_entry_for_update(ctx, cipher);
     if (!cap) {
         return AMVP_NO_CAP;
     }
@@ -7249,7 +7406,7 @@ AMVP_RESULT amvp_cap_kas_ffc_set_scheme(AMVP_CTX *ctx,
         }
         /* if there are none or didn't find the one we're looking for... */
         if (current_scheme == NULL) {
-            kas_ffc_cap_mode->scheme = calloc(1, sizeof(AMVP_KAS_FFC_SCHEME));
+            kas_ffc_cap_mode->scheme = amvp_cap_alloc(ctx, sizeof(AMVP_KAS_FFC_SCHEME));
             kas_ffc_cap_mode->scheme->scheme = scheme;
             current_scheme = kas_ffc_cap_mode->scheme;
         }
@@ -7265,7 +7422,7 @@ AMVP_RESULT amvp_cap_kas_ffc_set_scheme(AMVP_CTX *ctx,
                 value != AMVP_KAS_FFC_ROLE_RESPONDER) {
                 return AMVP_INVALID_ARG;
             }
-            result = amvp_append_param_list(&current_scheme->role, value);
+            result = amvp_value_set_add(amvp_cap_arena(ctx), &current_scheme->role, value);
             break;
         case AMVP_KAS_FFC_FB:
         case AMVP_KAS_FFC_FC:
@@ -7289,7 +7446,7 @@ AMVP_RESULT amvp_cap_kas_ffc_set_scheme(AMVP_CTX *ctx,
                 }
             }
             if (!current_pset) {
-                current_pset = calloc(1, sizeof(AMVP_KAS_FFC_PSET));
+                current_pset = amvp_cap_alloc(ctx, sizeof(AMVP_KAS_FFC_PSET));
                 if (current_scheme->pset == NULL) {
                     current_scheme->pset = current_pset;
                 } else {
@@ -7298,7 +7455,7 @@ AMVP_RESULT amvp_cap_kas_ffc_set_scheme(AMVP_CTX *ctx,
                 current_pset->set = param;
             }
             //then set sha in a param list
-            result = amvp_append_param_list(&current_pset->sha, value);
+            result = amvp_value_set_add(amvp_cap_arena(ctx), &current_pset->sha, value);
             break;
         case AMVP_KAS_FFC_FUNCTION:
         case AMVP_KAS_FFC_CURVE:
@@ -7330,6 +7487,7 @@ AMVP_RESULT amvp_cap_kas_ifc_enable(AMVP_CTX *ctx,
     if (!ctx) {
         return AMVP_NO_CTX;
     }
+    amvp_registration_invalidate(ctx);
     if (!crypto_handler) {
         AMVP_LOG_ERR("NULL parameter 'crypto_handler'");
         return AMVP_INVALID_ARG;
@@ -7359,7 +7517,7 @@ AMVP_RESULT amvp_cap_kas_ifc_set_parm(AMVP_CTX *ctx,
         return AMVP_NO_CTX;
     }
 
-    cap = amvp_locate_cap_entry(ctx, cipher);
+    cap = amvp_cap_entry_for_update(ctx, cipher);
     if (!cap) {
         return AMVP_NO_CAP;
     }
@@ -7372,16 +7530,16 @@ AMVP_RESULT amvp_cap_kas_ifc_set_parm(AMVP_CTX *ctx,
     switch (param)
     {
     case AMVP_KAS_IFC_KAS1:
-        result = amvp_append_param_list(&kas_ifc_cap->kas1_roles, value);
+        result = amvp_value_set_add(amvp_cap_arena(ctx), &kas_ifc_cap->kas1_roles, value);
         break;
     case AMVP_KAS_IFC_KAS2:
-        result = amvp_append_param_list(&kas_ifc_cap->kas2_roles, value);
+        result = amvp_value_set_add(amvp_cap_arena(ctx), &kas_ifc_cap->kas2_roles, value);
         break;
     case AMVP_KAS_IFC_KEYGEN_METHOD:
-        result = amvp_append_param_list(&kas_ifc_cap->keygen_method, value);
+        result = amvp_value_set_add(amvp_cap_arena(ctx), &kas_ifc_cap->keygen_method, value);
         break;
     case AMVP_KAS_IFC_MODULO:
-        amvp_append_sl_list(&kas_ifc_cap->modulo, value);
+        amvp_value_set_add(amvp_cap_arena(ctx), &kas_ifc_cap->modulo, value);
         break;
     case AMVP_KAS_IFC_HASH:
         if ((value < AMVP_NO_SHA || value >= AMVP_HASH_ALG_MAX) && !(value & (value - 1))) {
@@ -7411,7 +7569,7 @@ AMVP_RESULT amvp_cap_kas_ifc_set_exponent(AMVP_CTX *ctx,
         return AMVP_NO_CTX;
     }
 
-    cap = amvp_locate_cap_entry(ctx, cipher);
+    cap = amvp_cap_entry_for_update(ctx, cipher);
     if (!cap) {
         return AMVP_NO_CAP;
     }
@@ -7431,7 +7589,7 @@ AMVP_RESULT amvp_cap_kas_ifc_set_exponent(AMVP_CTX *ctx,
     if (param != AMVP_KAS_IFC_FIXEDPUBEXP) {
         return AMVP_INVALID_ARG;
     }        
-    kas_ifc_cap->fixed_pub_exp = calloc(len + 1, sizeof(char));
+    kas_ifc_cap->fixed_pub_exp = amvp_cap_alloc(ctx, len + 1);
     strcpy_s(kas_ifc_cap->fixed_pub_exp, len + 1, value);
     return AMVP_SUCCESS;
 }
@@ -7446,6 +7604,7 @@ AMVP_RESULT amvp_cap_kda_enable(AMVP_CTX *ctx,
     if (!ctx) {
         return AMVP_NO_CTX;
     }
+    amvp_registration_invalidate(ctx);
     if (!crypto_handler) {
         AMVP_LOG_ERR("NULL parameter 'crypto_handler'");
         return AMVP_INVALID_ARG;
@@ -7520,7 +7679,7 @@ AMVP_RESULT amvp_cap_kda_set_parm(AMVP_CTX *ctx, AMVP_CIPHER cipher, AMVP_KDA_PA
     /*
      * Locate this cipher in the caps array
      */
-    cap_list = amvp_locate_cap_entry(ctx, cipher);
+    cap_list = amvp_cap_entry_for_update(ctx, cipher);
     if (!cap_list) {
         AMVP_LOG_ERR("Cap entry not found.");
         return AMVP_NO_CAP;
@@ -7543,7 +7702,6 @@ AMVP_RESULT amvp_cap_kda_set_parm(AMVP_CTX *ctx, AMVP_CIPHER cipher, AMVP_KDA_PA
         case AMVP_KDA_PATTERN:
             if (value == AMVP_KDA_PATTERN_LITERAL && os_cap->literal_pattern_candidate) {
                 AMVP_LOG_WARN("Literal pattern candidate was already previously set. Replacing...");
-                free(os_cap->literal_pattern_candidate);
                 os_cap->literal_pattern_candidate = NULL;
             }
             if (value == AMVP_KDA_PATTERN_LITERAL) {
@@ -7555,7 +7713,7 @@ AMVP_RESULT amvp_cap_kda_set_parm(AMVP_CTX *ctx, AMVP_CIPHER cipher, AMVP_KDA_PA
                     AMVP_LOG_ERR("Provided literal string empty");
                     return AMVP_INVALID_ARG;
                 }
-                os_cap->literal_pattern_candidate = calloc(AMVP_KDA_PATTERN_LITERAL_STR_LEN_MAX + 1, sizeof(char));
+                os_cap->literal_pattern_candidate = amvp_cap_alloc(ctx, AMVP_KDA_PATTERN_LITERAL_STR_LEN_MAX + 1);
                 if (!os_cap->literal_pattern_candidate) {
                     AMVP_LOG_ERR("Unable to allocate memory for literal pattern candidate");
                     return AMVP_MALLOC_FAIL;
@@ -7564,7 +7722,7 @@ AMVP_RESULT amvp_cap_kda_set_parm(AMVP_CTX *ctx, AMVP_CIPHER cipher, AMVP_KDA_PA
                           AMVP_KDA_PATTERN_LITERAL_STR_LEN_MAX, string, len);
             }
             if (value > AMVP_KDA_PATTERN_NONE && value < AMVP_KDA_PATTERN_MAX) {
-                result = amvp_append_param_list(&os_cap->patterns, value);
+                result = amvp_append_param_list(amvp_cap_arena(ctx), &os_cap->patterns, value);
             } else {
                 AMVP_LOG_ERR("Invalid pattern type specified when setting param for KDA onestep.");
                 return AMVP_INVALID_ARG;
@@ -7579,7 +7737,7 @@ AMVP_RESULT amvp_cap_kda_set_parm(AMVP_CTX *ctx, AMVP_CIPHER cipher, AMVP_KDA_PA
             break;
         case AMVP_KDA_ENCODING_TYPE:
             if (value > AMVP_KDA_ENCODING_NONE && value < AMVP_KDA_ENCODING_MAX) {
-                result = amvp_append_param_list(&os_cap->encodings, value);
+                result = amvp_value_set_add(amvp_cap_arena(ctx), &os_cap->encodings, value);
             } else {
                 AMVP_LOG_ERR("Invalid encoding type specified when setting param for KDA onestep.");
                 return AMVP_INVALID_ARG;
@@ -7598,10 +7756,10 @@ AMVP_RESULT amvp_cap_kda_set_parm(AMVP_CTX *ctx, AMVP_CIPHER cipher, AMVP_KDA_PA
             break;
         case AMVP_KDA_MAC_SALT:
             if (value == AMVP_KDA_MAC_SALT_METHOD_DEFAULT) {
-                result = amvp_append_name_list(&os_cap->mac_salt_methods,
+                result = amvp_append_name_list(amvp_cap_arena(ctx), &os_cap->mac_salt_methods,
                                                AMVP_KDA_MAC_SALT_METHOD_DEFAULT_STR);
             } else if (value == AMVP_KDA_MAC_SALT_METHOD_RANDOM) {
-                result = amvp_append_name_list(&os_cap->mac_salt_methods,
+                result = amvp_append_name_list(amvp_cap_arena(ctx), &os_cap->mac_salt_methods,
                                                AMVP_KDA_MAC_SALT_METHOD_RANDOM_STR);
             } else {
                 AMVP_LOG_ERR("Invalid value for ACVK_KDA_MAC_SALT");
@@ -7614,7 +7772,7 @@ AMVP_RESULT amvp_cap_kda_set_parm(AMVP_CTX *ctx, AMVP_CIPHER cipher, AMVP_KDA_PA
                 AMVP_LOG_ERR("Invalid aux function cipher provided");
                 return AMVP_INVALID_ARG;
             }
-            result = amvp_append_name_list(&os_cap->aux_functions, tmp);
+            result = amvp_append_name_list(amvp_cap_arena(ctx), &os_cap->aux_functions, tmp);
             break;
         case AMVP_KDA_Z:
         case AMVP_KDA_USE_HYBRID_SECRET:
@@ -7640,7 +7798,6 @@ AMVP_RESULT amvp_cap_kda_set_parm(AMVP_CTX *ctx, AMVP_CIPHER cipher, AMVP_KDA_PA
         case AMVP_KDA_PATTERN:
             if (value == AMVP_KDA_PATTERN_LITERAL && hkdf_cap->literal_pattern_candidate) {
                 AMVP_LOG_WARN("Literal pattern candidate was already previously set. Replacing...");
-                free(hkdf_cap->literal_pattern_candidate);
                 hkdf_cap->literal_pattern_candidate = NULL;
             }
             if (value == AMVP_KDA_PATTERN_LITERAL) {
@@ -7652,7 +7809,7 @@ AMVP_RESULT amvp_cap_kda_set_parm(AMVP_CTX *ctx, AMVP_CIPHER cipher, AMVP_KDA_PA
                     AMVP_LOG_ERR("Provided literal string empty");
                     return AMVP_INVALID_ARG;
                 }
-                hkdf_cap->literal_pattern_candidate = calloc(AMVP_KDA_PATTERN_LITERAL_STR_LEN_MAX + 1, sizeof(char));
+                hkdf_cap->literal_pattern_candidate = amvp_cap_alloc(ctx, AMVP_KDA_PATTERN_LITERAL_STR_LEN_MAX + 1);
                 if (!hkdf_cap->literal_pattern_candidate) {
                     AMVP_LOG_ERR("Unable to allocate memory for literal pattern candidate");
                     return AMVP_MALLOC_FAIL;
@@ -7665,7 +7822,7 @@ AMVP_RESULT amvp_cap_kda_set_parm(AMVP_CTX *ctx, AMVP_CIPHER cipher, AMVP_KDA_PA
                 return AMVP_INVALID_ARG;
             }
             if (value > AMVP_KDA_PATTERN_NONE && value < AMVP_KDA_PATTERN_MAX) {
-                result = amvp_append_param_list(&hkdf_cap->patterns, value);
+                result = amvp_append_param_list(amvp_cap_arena(ctx), &hkdf_cap->patterns, value);
             } else {
                 AMVP_LOG_ERR("Invalid pattern type specified when setting param for KDA-HKDF.");
                 return AMVP_INVALID_ARG;
@@ -7680,7 +7837,7 @@ AMVP_RESULT amvp_cap_kda_set_parm(AMVP_CTX *ctx, AMVP_CIPHER cipher, AMVP_KDA_PA
             break;
         case AMVP_KDA_ENCODING_TYPE:
             if (value > AMVP_KDA_ENCODING_NONE && value < AMVP_KDA_ENCODING_MAX) {
-                result = amvp_append_param_list(&hkdf_cap->encodings, value);
+                result = amvp_value_set_add(amvp_cap_arena(ctx), &hkdf_cap->encodings, value);
             } else {
                 AMVP_LOG_ERR("Invalid encoding type specified when setting param for KDA-HKDF.");
                 return AMVP_INVALID_ARG;
@@ -7699,10 +7856,10 @@ AMVP_RESULT amvp_cap_kda_set_parm(AMVP_CTX *ctx, AMVP_CIPHER cipher, AMVP_KDA_PA
             break;
         case AMVP_KDA_MAC_SALT:
             if (value == AMVP_KDA_MAC_SALT_METHOD_DEFAULT) {
-                result = amvp_append_name_list(&hkdf_cap->mac_salt_methods,
+                result = amvp_append_name_list(amvp_cap_arena(ctx), &hkdf_cap->mac_salt_methods,
                                                AMVP_KDA_MAC_SALT_METHOD_DEFAULT_STR);
             } else if (value == AMVP_KDA_MAC_SALT_METHOD_RANDOM) {
-                result = amvp_append_name_list(&hkdf_cap->mac_salt_methods,
+                result = amvp_append_name_list(amvp_cap_arena(ctx), &hkdf_cap->mac_salt_methods,
                                                AMVP_KDA_MAC_SALT_METHOD_RANDOM_STR);
             } else {
                 AMVP_LOG_ERR("Invalid value for ACVK_KDA_MAC_SALT");
@@ -7715,7 +7872,7 @@ AMVP_RESULT amvp_cap_kda_set_parm(AMVP_CTX *ctx, AMVP_CIPHER cipher, AMVP_KDA_PA
                 AMVP_LOG_ERR("Invalid value for hmac alg for KDA-HKDF");
                 return AMVP_INVALID_ARG;
             }
-            result = amvp_append_name_list(&hkdf_cap->hmac_algs, tmp);
+            result = amvp_append_name_list(amvp_cap_arena(ctx), &hkdf_cap->hmac_algs, tmp);
             break;
         case AMVP_KDA_USE_HYBRID_SECRET:
             /* revision is only set for non-default revisions */
@@ -7723,7 +7880,7 @@ AMVP_RESULT amvp_cap_kda_set_parm(AMVP_CTX *ctx, AMVP_CIPHER cipher, AMVP_KDA_PA
                 AMVP_LOG_ERR("Hybrid secrets for HKDF can only be set for revision SP800-56Cr2");
                 return AMVP_INVALID_ARG;
             }
-            result = amvp_append_sl_list(&cap_list->cap.kda_hkdf_cap->aux_secret_len.values, value);
+            result = amvp_value_set_add(amvp_cap_arena(ctx), &cap_list->cap.kda_hkdf_cap->aux_secret_len.values, value);
             if (result == AMVP_SUCCESS) {
                 cap_list->cap.kda_hkdf_cap->use_hybrid_shared_secret = 1;
             }
@@ -7778,7 +7935,7 @@ AMVP_RESULT amvp_cap_kda_twostep_set_parm(AMVP_CTX *ctx, AMVP_KDA_PARM param,
         return AMVP_NO_CTX;
     }
 
-    cap_list = amvp_locate_cap_entry(ctx, AMVP_KDA_TWOSTEP);
+    cap_list = amvp_cap_entry_for_update(ctx, AMVP_KDA_TWOSTEP);
     if (!cap_list) {
         AMVP_LOG_ERR("Cap entry not found. You must enable algorithm before setting parameters.");
         return AMVP_NO_CAP;
@@ -7846,7 +8003,6 @@ AMVP_RESULT amvp_cap_kda_twostep_set_parm(AMVP_CTX *ctx, AMVP_KDA_PARM param,
     case AMVP_KDA_PATTERN:
         if (value == AMVP_KDA_PATTERN_LITERAL && cap->literal_pattern_candidate) {
             AMVP_LOG_WARN("Literal pattern candidate was already previously set. Replacing...");
-            free(cap->literal_pattern_candidate);
             cap->literal_pattern_candidate = NULL;
         }
         if (value == AMVP_KDA_PATTERN_LITERAL) {
@@ -7858,7 +8014,7 @@ AMVP_RESULT amvp_cap_kda_twostep_set_parm(AMVP_CTX *ctx, AMVP_KDA_PARM param,
                 AMVP_LOG_ERR("Provided literal string empty");
                 return AMVP_INVALID_ARG;
             }
-            cap->literal_pattern_candidate = calloc(AMVP_KDA_PATTERN_LITERAL_STR_LEN_MAX + 1, sizeof(char));
+            cap->literal_pattern_candidate = amvp_cap_alloc(ctx, AMVP_KDA_PATTERN_LITERAL_STR_LEN_MAX + 1);
             if (!cap->literal_pattern_candidate) {
                 AMVP_LOG_ERR("Unable to allocate memory for literal pattern candidate");
                 return AMVP_MALLOC_FAIL;
@@ -7867,7 +8023,7 @@ AMVP_RESULT amvp_cap_kda_twostep_set_parm(AMVP_CTX *ctx, AMVP_KDA_PARM param,
                         AMVP_KDA_PATTERN_LITERAL_STR_LEN_MAX, string, len);
         }
         if (value > AMVP_KDA_PATTERN_NONE && value < AMVP_KDA_PATTERN_MAX) {
-            result = amvp_append_param_list(&cap->patterns, value);
+            result = amvp_append_param_list(amvp_cap_arena(ctx), &cap->patterns, value);
         } else {
             AMVP_LOG_ERR("Invalid pattern type specified when setting param for KDA twostep.");
             return AMVP_INVALID_ARG;
@@ -7882,7 +8038,7 @@ AMVP_RESULT amvp_cap_kda_twostep_set_parm(AMVP_CTX *ctx, AMVP_KDA_PARM param,
         break;
     case AMVP_KDA_ENCODING_TYPE:
         if (value > AMVP_KDA_ENCODING_NONE && value < AMVP_KDA_ENCODING_MAX) {
-            result = amvp_append_param_list(&cap->encodings, value);
+            result = amvp_value_set_add(amvp_cap_arena(ctx), &cap->encodings, value);
         } else {
             AMVP_LOG_ERR("Invalid encoding type specified when setting param for KDA twostep.");
             return AMVP_INVALID_ARG;
@@ -7901,10 +8057,10 @@ AMVP_RESULT amvp_cap_kda_twostep_set_parm(AMVP_CTX *ctx, AMVP_KDA_PARM param,
         break;
     case AMVP_KDA_MAC_SALT:
         if (value == AMVP_KDA_MAC_SALT_METHOD_DEFAULT) {
-            result = amvp_append_name_list(&cap->mac_salt_methods,
+            result = amvp_append_name_list(amvp_cap_arena(ctx), &cap->mac_salt_methods,
                                             AMVP_KDA_MAC_SALT_METHOD_DEFAULT_STR);
         } else if (value == AMVP_KDA_MAC_SALT_METHOD_RANDOM) {
-            result = amvp_append_name_list(&cap->mac_salt_methods,
+            result = amvp_append_name_list(amvp_cap_arena(ctx), &cap->mac_salt_methods,
                                             AMVP_KDA_MAC_SALT_METHOD_RANDOM_STR);
         } else {
             AMVP_LOG_ERR("Invalid value for ACVK_KDA_MAC_SALT");
@@ -7914,46 +8070,46 @@ AMVP_RESULT amvp_cap_kda_twostep_set_parm(AMVP_CTX *ctx, AMVP_KDA_PARM param,
     case AMVP_KDA_MAC_ALG:
         switch (value) {
             case AMVP_KDF108_MAC_MODE_CMAC_AES128:
-                result = amvp_append_name_list(&mode_obj->mac_mode, AMVP_ALG_CMAC_AES_128);
+                result = amvp_append_name_list(amvp_cap_arena(ctx), &mode_obj->mac_mode, AMVP_ALG_CMAC_AES_128);
                 break;
             case AMVP_KDF108_MAC_MODE_CMAC_AES192:
-                result = amvp_append_name_list(&mode_obj->mac_mode, AMVP_ALG_CMAC_AES_192);
+                result = amvp_append_name_list(amvp_cap_arena(ctx), &mode_obj->mac_mode, AMVP_ALG_CMAC_AES_192);
                 break;
             case AMVP_KDF108_MAC_MODE_CMAC_AES256:
-                result = amvp_append_name_list(&mode_obj->mac_mode, AMVP_ALG_CMAC_AES_256);
+                result = amvp_append_name_list(amvp_cap_arena(ctx), &mode_obj->mac_mode, AMVP_ALG_CMAC_AES_256);
                 break;
             case AMVP_KDF108_MAC_MODE_HMAC_SHA1:
-                result = amvp_append_name_list(&mode_obj->mac_mode, AMVP_ALG_HMAC_SHA1);
+                result = amvp_append_name_list(amvp_cap_arena(ctx), &mode_obj->mac_mode, AMVP_ALG_HMAC_SHA1);
                 break;
             case AMVP_KDF108_MAC_MODE_HMAC_SHA224:
-                result = amvp_append_name_list(&mode_obj->mac_mode, AMVP_ALG_HMAC_SHA2_224);
+                result = amvp_append_name_list(amvp_cap_arena(ctx), &mode_obj->mac_mode, AMVP_ALG_HMAC_SHA2_224);
                 break;
             case AMVP_KDF108_MAC_MODE_HMAC_SHA256:
-                result = amvp_append_name_list(&mode_obj->mac_mode, AMVP_ALG_HMAC_SHA2_256);
+                result = amvp_append_name_list(amvp_cap_arena(ctx), &mode_obj->mac_mode, AMVP_ALG_HMAC_SHA2_256);
                 break;
             case AMVP_KDF108_MAC_MODE_HMAC_SHA384:
-                result = amvp_append_name_list(&mode_obj->mac_mode, AMVP_ALG_HMAC_SHA2_384);
+                result = amvp_append_name_list(amvp_cap_arena(ctx), &mode_obj->mac_mode, AMVP_ALG_HMAC_SHA2_384);
                 break;
             case AMVP_KDF108_MAC_MODE_HMAC_SHA512:
-                result = amvp_append_name_list(&mode_obj->mac_mode, AMVP_ALG_HMAC_SHA2_512);
+                result = amvp_append_name_list(amvp_cap_arena(ctx), &mode_obj->mac_mode, AMVP_ALG_HMAC_SHA2_512);
                 break;
             case AMVP_KDF108_MAC_MODE_HMAC_SHA512_224:
-                result = amvp_append_name_list(&mode_obj->mac_mode, AMVP_ALG_HMAC_SHA2_512_224);
+                result = amvp_append_name_list(amvp_cap_arena(ctx), &mode_obj->mac_mode, AMVP_ALG_HMAC_SHA2_512_224);
                 break;
             case AMVP_KDF108_MAC_MODE_HMAC_SHA512_256:
-                result = amvp_append_name_list(&mode_obj->mac_mode, AMVP_ALG_HMAC_SHA2_512_256);
+                result = amvp_append_name_list(amvp_cap_arena(ctx), &mode_obj->mac_mode, AMVP_ALG_HMAC_SHA2_512_256);
                 break;
             case AMVP_KDF108_MAC_MODE_HMAC_SHA3_224:
-                result = amvp_append_name_list(&mode_obj->mac_mode, AMVP_ALG_HMAC_SHA3_224);
+                result = amvp_append_name_list(amvp_cap_arena(ctx), &mode_obj->mac_mode, AMVP_ALG_HMAC_SHA3_224);
                 break;
             case AMVP_KDF108_MAC_MODE_HMAC_SHA3_256:
-                result = amvp_append_name_list(&mode_obj->mac_mode, AMVP_ALG_HMAC_SHA3_256);
+                result = amvp_append_name_list(amvp_cap_arena(ctx), &mode_obj->mac_mode, AMVP_ALG_HMAC_SHA3_256);
                 break;
             case AMVP_KDF108_MAC_MODE_HMAC_SHA3_384:
-                result = amvp_append_name_list(&mode_obj->mac_mode, AMVP_ALG_HMAC_SHA3_384);
+                result = amvp_append_name_list(amvp_cap_arena(ctx), &mode_obj->mac_mode, AMVP_ALG_HMAC_SHA3_384);
                 break;
             case AMVP_KDF108_MAC_MODE_HMAC_SHA3_512:
-                result = amvp_append_name_list(&mode_obj->mac_mode, AMVP_ALG_HMAC_SHA3_512);
+                result = amvp_append_name_list(amvp_cap_arena(ctx), &mode_obj->mac_mode, AMVP_ALG_HMAC_SHA3_512);
                 break;
             case AMVP_KDF108_MAC_MODE_CMAC_TDES:
             default:
@@ -7966,7 +8122,7 @@ AMVP_RESULT amvp_cap_kda_twostep_set_parm(AMVP_CTX *ctx, AMVP_KDA_PARM param,
             AMVP_LOG_ERR("Hybrid secrets for twostep can only be set for revision SP800-56Cr2");
             return AMVP_INVALID_ARG;
         }
-        amvp_append_sl_list(&cap_list->cap.kda_twostep_cap->aux_secret_len.values, value);
+        amvp_value_set_add(amvp_cap_arena(ctx), &cap_list->cap.kda_twostep_cap->aux_secret_len.values, value);
         cap_list->cap.kda_twostep_cap->use_hybrid_shared_secret = 1;
         break;
     case AMVP_KDA_PERFORM_MULTIEXPANSION_TESTS:
@@ -7980,19 +8136,19 @@ AMVP_RESULT amvp_cap_kda_twostep_set_parm(AMVP_CTX *ctx, AMVP_KDA_PARM param,
     case AMVP_KDA_TWOSTEP_FIXED_DATA_ORDER:
         switch (value) {
         case AMVP_KDF108_FIXED_DATA_ORDER_AFTER:
-            result = amvp_append_name_list(&mode_obj->data_order, AMVP_FIXED_DATA_ORDER_AFTER_STR);
+            result = amvp_append_name_list(amvp_cap_arena(ctx), &mode_obj->data_order, AMVP_FIXED_DATA_ORDER_AFTER_STR);
             break;
         case AMVP_KDF108_FIXED_DATA_ORDER_BEFORE:
-            result = amvp_append_name_list(&mode_obj->data_order, AMVP_FIXED_DATA_ORDER_BEFORE_STR);
+            result = amvp_append_name_list(amvp_cap_arena(ctx), &mode_obj->data_order, AMVP_FIXED_DATA_ORDER_BEFORE_STR);
             break;
         case AMVP_KDF108_FIXED_DATA_ORDER_MIDDLE:
-            result = amvp_append_name_list(&mode_obj->data_order, AMVP_FIXED_DATA_ORDER_MIDDLE_STR);
+            result = amvp_append_name_list(amvp_cap_arena(ctx), &mode_obj->data_order, AMVP_FIXED_DATA_ORDER_MIDDLE_STR);
             break;
         case AMVP_KDF108_FIXED_DATA_ORDER_NONE:
-            result = amvp_append_name_list(&mode_obj->data_order, AMVP_FIXED_DATA_ORDER_NONE_STR);
+            result = amvp_append_name_list(amvp_cap_arena(ctx), &mode_obj->data_order, AMVP_FIXED_DATA_ORDER_NONE_STR);
             break;
         case AMVP_KDF108_FIXED_DATA_ORDER_BEFORE_ITERATOR:
-            result = amvp_append_name_list(&mode_obj->data_order, AMVP_FIXED_DATA_ORDER_BEFORE_ITERATOR_STR);
+            result = amvp_append_name_list(amvp_cap_arena(ctx), &mode_obj->data_order, AMVP_FIXED_DATA_ORDER_BEFORE_ITERATOR_STR);
             break;
         default:
             AMVP_LOG_ERR("Invalid fixed data order provided for KDA Twostep");
@@ -8004,7 +8160,7 @@ AMVP_RESULT amvp_cap_kda_twostep_set_parm(AMVP_CTX *ctx, AMVP_KDA_PARM param,
             printf("Invalid value provided for KDA twostep supported length");
             return AMVP_INVALID_ARG;
         }
-        amvp_append_sl_list(&mode_obj->counter_lens, value);
+        amvp_value_set_add(amvp_cap_arena(ctx), &mode_obj->counter_lens, value);
         break;
     case AMVP_KDA_TWOSTEP_SUPPORTS_EMPTY_IV:
         mode_obj->empty_iv_support = value;
@@ -8018,7 +8174,7 @@ AMVP_RESULT amvp_cap_kda_twostep_set_parm(AMVP_CTX *ctx, AMVP_KDA_PARM param,
         }
         break;
     case AMVP_KDA_TWOSTEP_SUPPORTED_LEN:
-        result = amvp_append_sl_list(&mode_obj->supported_lens.values, value);
+        result = amvp_value_set_add(amvp_cap_arena(ctx), &mode_obj->supported_lens.values, value);
         break;
     case AMVP_KDA_Z:
     case AMVP_KDA_ONESTEP_AUX_FUNCTION:
@@ -8042,7 +8198,7 @@ AMVP_RESULT amvp_cap_kda_twostep_set_domain(AMVP_CTX *ctx, AMVP_KDA_PARM param,
         return AMVP_NO_CTX;
     }
 
-    cap_list = amvp_locate_cap_entry(ctx, AMVP_KDA_TWOSTEP);
+    cap_list = amvp_cap_entry_for_update(ctx, AMVP_KDA_TWOSTEP);
     if (!cap_list) {
         AMVP_LOG_ERR("Cap entry not found. You must enable algorithm before setting parameters.");
         return AMVP_NO_CAP;
@@ -8144,7 +8300,7 @@ AMVP_RESULT amvp_cap_kda_set_domain(AMVP_CTX *ctx, AMVP_CIPHER cipher, AMVP_KDA_
     /*
      * Locate this cipher in the caps array
      */
-    cap_list = amvp_locate_cap_entry(ctx, cipher);
+    cap_list = amvp_cap_entry_for_update(ctx, cipher);
     if (!cap_list) {
         AMVP_LOG_ERR("Cap entry not found.");
         return AMVP_NO_CAP;
@@ -8274,6 +8430,7 @@ AMVP_RESULT amvp_cap_kts_ifc_enable(AMVP_CTX *ctx,
     if (!ctx) {
         return AMVP_NO_CTX;
     }
+    amvp_registration_invalidate(ctx);
     if (!crypto_handler) {
         AMVP_LOG_ERR("NULL parameter 'crypto_handler'");
         return AMVP_INVALID_ARG;
@@ -8305,7 +8462,7 @@ AMVP_RESULT amvp_cap_kts_ifc_set_parm(AMVP_CTX *ctx,
         return AMVP_NO_CTX;
     }
 
-      cap = amvp_locate_cap_entry(ctx, cipher);
+      cap = amvp_cap_entry_for_update(ctx, cipher);
     if (!cap) {
         return AMVP_NO_CAP;
     }
@@ -8318,13 +8475,13 @@ AMVP_RESULT amvp_cap_kts_ifc_set_parm(AMVP_CTX *ctx,
     switch (param)
     {
     case AMVP_KTS_IFC_KEYGEN_METHOD:
-        result = amvp_append_param_list(&kts_ifc_cap->keygen_method, value);
+        result = amvp_value_set_add(amvp_cap_arena(ctx), &kts_ifc_cap->keygen_method, value);
         break;
     case AMVP_KTS_IFC_FUNCTION:
-        result = amvp_append_param_list(&kts_ifc_cap->functions, value);
+        result = amvp_value_set_add(amvp_cap_arena(ctx), &kts_ifc_cap->functions, value);
         break;
     case AMVP_KTS_IFC_MODULO:
-        amvp_append_sl_list(&kts_ifc_cap->modulo, value);
+        amvp_value_set_add(amvp_cap_arena(ctx), &kts_ifc_cap->modulo, value);
         break;
     case AMVP_KTS_IFC_SCHEME:
         current_scheme = kts_ifc_cap->schemes;
@@ -8332,10 +8489,10 @@ AMVP_RESULT amvp_cap_kts_ifc_set_parm(AMVP_CTX *ctx,
             while (current_scheme->next) {
                 current_scheme = current_scheme->next;
             }
-            current_scheme->next = calloc(1, sizeof(AMVP_KTS_IFC_SCHEMES));
+            current_scheme->next = amvp_cap_alloc(ctx, sizeof(AMVP_KTS_IFC_SCHEMES));
             current_scheme->next->scheme = value;
         } else {
-            kts_ifc_cap->schemes = calloc(1, sizeof(AMVP_KTS_IFC_SCHEMES));
+            kts_ifc_cap->schemes = amvp_cap_alloc(ctx, sizeof(AMVP_KTS_IFC_SCHEMES));
             kts_ifc_cap->schemes->scheme = value;
         }
         break;
@@ -8365,7 +8522,7 @@ AMVP_RESULT amvp_cap_kts_ifc_set_scheme_parm(AMVP_CTX *ctx,
         return AMVP_NO_CTX;
     }
 
-    cap = amvp_locate_cap_entry(ctx, cipher);
+    cap = amvp_cap_entry_for_update(ctx, cipher);
     if (!cap) {
         return AMVP_NO_CAP;
     }
@@ -8399,10 +8556,10 @@ AMVP_RESULT amvp_cap_kts_ifc_set_scheme_parm(AMVP_CTX *ctx,
         current_scheme->l = value;
         break;
     case AMVP_KTS_IFC_ROLE:
-        result = amvp_append_param_list(&current_scheme->roles, value);
+        result = amvp_value_set_add(amvp_cap_arena(ctx), &current_scheme->roles, value);
         break;
     case AMVP_KTS_IFC_HASH:
-        result = amvp_append_param_list(&current_scheme->hash, value);
+        result = amvp_value_set_add(amvp_cap_arena(ctx), &current_scheme->hash, value);
         break;
     case AMVP_KTS_IFC_AD_PATTERN:
     case AMVP_KTS_IFC_ENCODING:
@@ -8427,7 +8584,7 @@ AMVP_RESULT amvp_cap_kts_ifc_set_param_string(AMVP_CTX *ctx,
         return AMVP_NO_CTX;
     }
 
-    cap = amvp_locate_cap_entry(ctx, cipher);
+    cap = amvp_cap_entry_for_update(ctx, cipher);
     if (!cap) {
         return AMVP_NO_CAP;
     }
@@ -8446,11 +8603,11 @@ AMVP_RESULT amvp_cap_kts_ifc_set_param_string(AMVP_CTX *ctx,
     switch (param)
     {
     case AMVP_KTS_IFC_FIXEDPUBEXP:
-        kts_ifc_cap->fixed_pub_exp = calloc(len + 1, sizeof(char));
+        kts_ifc_cap->fixed_pub_exp = amvp_cap_alloc(ctx, len + 1);
         strcpy_s(kts_ifc_cap->fixed_pub_exp, len + 1, value);
         break;
     case AMVP_KTS_IFC_IUT_ID:
-        kts_ifc_cap->iut_id = calloc(len + 1, sizeof(char));
+        kts_ifc_cap->iut_id = amvp_cap_alloc(ctx, len + 1);
         strcpy_s(kts_ifc_cap->iut_id, len + 1, value);
         break;
     case AMVP_KTS_IFC_KEYGEN_METHOD:
@@ -8482,7 +8639,7 @@ AMVP_RESULT amvp_cap_kts_ifc_set_scheme_string(AMVP_CTX *ctx,
         return AMVP_NO_CTX;
     }
 
-    cap = amvp_locate_cap_entry(ctx, cipher);
+    cap = amvp_cap_entry_for_update(ctx, cipher);
     if (!cap) {
         return AMVP_NO_CAP;
     }
@@ -8518,11 +8675,11 @@ AMVP_RESULT amvp_cap_kts_ifc_set_scheme_string(AMVP_CTX *ctx,
     switch (param)
     {
     case AMVP_KTS_IFC_AD_PATTERN:
-        current_scheme->assoc_data_pattern = calloc(len + 1, sizeof(char));
+        current_scheme->assoc_data_pattern = amvp_cap_alloc(ctx, len + 1);
         strcpy_s(current_scheme->assoc_data_pattern, len + 1, value);
         break;
     case AMVP_KTS_IFC_ENCODING:
-        current_scheme->encodings = calloc(len + 1, sizeof(char));
+        current_scheme->encodings = amvp_cap_alloc(ctx, len + 1);
         strcpy_s(current_scheme->encodings, len + 1, value);
         break;
     case AMVP_KTS_IFC_NULL_ASSOC_DATA:
@@ -8548,6 +8705,7 @@ AMVP_RESULT amvp_cap_safe_primes_enable(AMVP_CTX *ctx,
     if (!ctx) {
         return AMVP_NO_CTX;
     }
+    amvp_registration_invalidate(ctx);
     if (!crypto_handler) {
         AMVP_LOG_ERR("NULL parameter 'crypto_handler'");
         return AMVP_INVALID_ARG;
@@ -8584,7 +8742,7 @@ AMVP_RESULT amvp_cap_safe_primes_set_parm(AMVP_CTX *ctx,
         return AMVP_NO_CTX;
     }
 
-    cap = amvp_locate_cap_entry(ctx, cipher);
+    cap = amvp_cap_entry_for_update(ctx, cipher);
     if (!cap) {
         return AMVP_NO_CAP;
     }
@@ -8602,7 +8760,7 @@ AMVP_RESULT amvp_cap_safe_primes_set_parm(AMVP_CTX *ctx,
         return AMVP_NO_CAP;
     }
     if (!safe_primes_cap->mode) {
-        safe_primes_cap->mode = calloc(1, sizeof(AMVP_SAFE_PRIMES_CAP_MODE));
+        safe_primes_cap->mode = amvp_cap_alloc(ctx, sizeof(AMVP_SAFE_PRIMES_CAP_MODE));
     }
 
     safe_primes_cap_mode = safe_primes_cap->mode;
@@ -8619,7 +8777,7 @@ AMVP_RESULT amvp_cap_safe_primes_set_parm(AMVP_CTX *ctx,
     case AMVP_SUB_SAFE_PRIMES_KEYVER:
         switch (param) {
         case AMVP_SAFE_PRIMES_GENMETH:
-            result = amvp_append_param_list(&safe_primes_cap_mode->genmeth, mode);
+            result = amvp_value_set_add(amvp_cap_arena(ctx), &safe_primes_cap_mode->genmeth, mode);
             break;
         default:
             break;
@@ -8628,7 +8786,7 @@ AMVP_RESULT amvp_cap_safe_primes_set_parm(AMVP_CTX *ctx,
     case AMVP_SUB_SAFE_PRIMES_KEYGEN:
         switch (param) {
         case AMVP_SAFE_PRIMES_GENMETH:
-            result = amvp_append_param_list(&safe_primes_cap_mode->genmeth, mode);
+            result = amvp_value_set_add(amvp_cap_arena(ctx), &safe_primes_cap_mode->genmeth, mode);
             break;
         default:
             break;
@@ -0,0 +1,436 @@
+/** @file */
+/*
+ * Copyright (c) 2021, Cisco Systems, Inc.
+ *
+ * Licensed under the Apache License 2.0 (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://github.com/cisco/libamvp/LICENSE
+ */
+
+/*
+ * Resume checkpoints, enabled with amvp_set_resume_checkpoints().
+ *
+ * Next to the session file (<name>.json) an append-only journal
+ * (<name>.journal) records, one JSON object per line, each vector set as
+ * it is downloaded, processed and uploaded. The downloaded vector set and
+ * the finished responses are kept in <name>_vs<vsId>.json and
+ * <name>_rsp<vsId>.json until the server has the responses. A record is
+ * only appended once its file is complete, so after a crash the journal
+ * never points at a partial file; a torn last line is ignored.
+ *
+ * amvp_resume_test_session() uses this to finish vector sets from disk,
+ * without downloading them or running the crypto again.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "amvp.h"
+#include "amvp_lcl.h"
+#include "parson.h"
+#include "safe_lib.h"
+
+#define AMVP_CKPT_JOURNAL_EXT ".journal"
+#define AMVP_CKPT_LINE_MAX (AMVP_ATTR_URL_MAX + 128)
+
+typedef struct amvp_ckpt_entry_t {
+    char *vsid_url;
+    int vs_id;
+    AMVP_CKPT_STATE state;
+    struct amvp_ckpt_entry_t *next;
+} AMVP_CKPT_ENTRY;
+
+struct amvp_checkpoint_t {
+    char *journal;
+    char *prefix;               /* session file path without .json */
+    AMVP_CKPT_ENTRY *entries;
+};
+
+static const char *amvp_ckpt_state_names[] = { "none", "downloaded", "processed", "uploaded" };
+
+static AMVP_CKPT_ENTRY *amvp_ckpt_find(AMVP_CHECKPOINT *ckpt, const char *vsid_url) {
+    AMVP_CKPT_ENTRY *entry = NULL;
+    int diff = 1;
+
+    for (entry = ckpt->entries; entry; entry = entry->next) {
+        strcmp_s(entry->vsid_url, AMVP_ATTR_URL_MAX, vsid_url, &diff);
+        if (!diff) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Updates the in-memory state of vsid_url; the last record of a vector
+ * set in the journal wins.
+ */
+static AMVP_RESULT amvp_ckpt_set(AMVP_CHECKPOINT *ckpt, const char *vsid_url, int vs_id,
+                                 AMVP_CKPT_STATE state) {
+    AMVP_CKPT_ENTRY *entry = NULL;
+    size_t len = 0;
+
+    entry = amvp_ckpt_find(ckpt, vsid_url);
+    if (!entry) {
+        entry = calloc(1, sizeof(AMVP_CKPT_ENTRY));
+        if (!entry) {
+            return AMVP_MALLOC_FAIL;
+        }
+        len = strnlen_s(vsid_url, AMVP_ATTR_URL_MAX);
+        entry->vsid_url = calloc(len + 1, sizeof(char));
+        if (!entry->vsid_url) {
+            free(entry);
+            return AMVP_MALLOC_FAIL;
+        }
+        strncpy_s(entry->vsid_url, len + 1, vsid_url, len);
+        entry->next = ckpt->entries;
+        ckpt->entries = entry;
+    }
+    if (vs_id) {
+        entry->vs_id = vs_id;
+    }
+    entry->state = state;
+    return AMVP_SUCCESS;
+}
+
+static AMVP_RESULT amvp_ckpt_replay(AMVP_CTX *ctx, AMVP_CHECKPOINT *ckpt) {
+    char line[AMVP_CKPT_LINE_MAX + 1];
+    JSON_Value *val = NULL;
+    JSON_Object *obj = NULL;
+    const char *url = NULL, *state = NULL;
+    AMVP_RESULT rv = AMVP_SUCCESS;
+    FILE *fp = NULL;
+    size_t len = 0;
+    int i, diff = 1, records = 0, torn = 0;
+
+    fp = fopen(ckpt->journal, "r");
+    if (!fp) {
+        return AMVP_SUCCESS;
+    }
+    while (fgets(line, sizeof(line), fp)) {
+        len = strnlen_s(line, sizeof(line));
+        torn = !len || line[len - 1] != '\n';
+        val = json_parse_string(line);
+        obj = json_value_get_object(val);
+        url = json_object_get_string(obj, "url");
+        state = json_object_get_string(obj, "state");
+        for (i = AMVP_CKPT_DOWNLOADED; url && state && i <= AMVP_CKPT_UPLOADED; i++) {
+            strcmp_s(amvp_ckpt_state_names[i], AMVP_ATTR_URL_MAX, state, &diff);
+            if (!diff) {
+                rv = amvp_ckpt_set(ckpt, url, (int)json_object_get_number(obj, "vsId"),
+                                   (AMVP_CKPT_STATE)i);
+                records++;
+                break;
+            }
+        }
+        json_value_free(val);
+        if (rv != AMVP_SUCCESS) {
+            break;
+        }
+    }
+    fclose(fp);
+    if (torn) {
+        /* End the record a crash cut short, so the next one starts on its own line */
+        fp = fopen(ckpt->journal, "a");
+        if (fp) {
+            fputc('\n', fp);
+            fclose(fp);
+        }
+    }
+    if (records) {
+        AMVP_LOG_STATUS("Loaded %d checkpoint records from %s", records, ckpt->journal);
+    }
+    return rv;
+}
+
+static AMVP_RESULT amvp_ckpt_append(AMVP_CTX *ctx, const char *vsid_url, int vs_id, AMVP_CKPT_STATE state) {
+    AMVP_CHECKPOINT *ckpt = ctx->checkpoint;
+    FILE *fp = NULL;
+    int ok = 0;
+
+    fp = fopen(ckpt->journal, "a");
+    if (!fp) {
+        AMVP_LOG_ERR("Unable to open checkpoint journal %s", ckpt->journal);
+        return AMVP_TRANSPORT_FAIL;
+    }
+    /* vsid_url comes from the server as a path, it needs no escaping */
+    ok = fprintf(fp, "{\"url\":\"%s\",\"vsId\":%d,\"state\":\"%s\"}\n",
+                 vsid_url, vs_id, amvp_ckpt_state_names[state]) > 0;
+    ok = (fflush(fp) == 0) && ok;
+    fclose(fp);
+    if (!ok) {
+        AMVP_LOG_ERR("Unable to write checkpoint journal %s", ckpt->journal);
+        return AMVP_TRANSPORT_FAIL;
+    }
+    return amvp_ckpt_set(ckpt, vsid_url, vs_id, state);
+}
+
+static void amvp_ckpt_file_name(AMVP_CHECKPOINT *ckpt, const AMVP_CKPT_ENTRY *entry,
+                                AMVP_CKPT_STATE state, char *name, size_t name_len) {
+    snprintf(name, name_len, "%s_%s%d.json", ckpt->prefix,
+             state == AMVP_CKPT_PROCESSED ? "rsp" : "vs", entry->vs_id);
+}
+
+/*
+ * Writes data to name by way of a temporary file, so a crash leaves either
+ * the complete file or none at all.
+ */
+static AMVP_RESULT amvp_ckpt_write_file(AMVP_CTX *ctx, const char *name, const char *data, size_t data_len) {
+    char tmp[AMVP_JSON_FILENAME_MAX + 1];
+    FILE *fp = NULL;
+    int ok = 0;
+
+    snprintf(tmp, sizeof(tmp), "%s.tmp", name);
+    fp = fopen(tmp, "wb");
+    if (!fp) {
+        AMVP_LOG_ERR("Unable to open checkpoint file %s", tmp);
+        return AMVP_TRANSPORT_FAIL;
+    }
+    ok = fwrite(data, 1, data_len, fp) == data_len;
+    ok = (fflush(fp) == 0) && ok;
+    fclose(fp);
+    remove(name);
+    if (!ok || rename(tmp, name)) {
+        AMVP_LOG_ERR("Unable to write checkpoint file %s", name);
+        remove(tmp);
+        return AMVP_TRANSPORT_FAIL;
+    }
+    return AMVP_SUCCESS;
+}
+
+/*
+ * Starts journaling the progress of the session saved in session_file,
+ * picking up what a previous run already recorded there. Does nothing
+ * unless checkpoints are enabled or a journal already exists.
+ */
+AMVP_RESULT amvp_checkpoint_open(AMVP_CTX *ctx, const char *session_file) {
+    AMVP_CHECKPOINT *ckpt = NULL;
+    AMVP_RESULT rv = AMVP_SUCCESS;
+    size_t len = 0, ext_len = strnlen_s(".json", 8);
+    FILE *fp = NULL;
+    int diff = 1;
+
+    if (!ctx || !session_file) {
+        return AMVP_MISSING_ARG;
+    }
+    amvp_checkpoint_free(ctx);
+
+    len = strnlen_s(session_file, AMVP_JSON_FILENAME_MAX + 1);
+    if (len > AMVP_JSON_FILENAME_MAX - 32) {
+        AMVP_LOG_ERR("Session file name too long for checkpoints");
+        return AMVP_INVALID_ARG;
+    }
+    ckpt = calloc(1, sizeof(AMVP_CHECKPOINT));
+    if (!ckpt) {
+        return AMVP_MALLOC_FAIL;
+    }
+    ckpt->prefix = calloc(len + 1, sizeof(char));
+    ckpt->journal = calloc(len + sizeof(AMVP_CKPT_JOURNAL_EXT), sizeof(char));
+    if (!ckpt->prefix || !ckpt->journal) {
+        rv = AMVP_MALLOC_FAIL;
+        goto end;
+    }
+    strncpy_s(ckpt->prefix, len + 1, session_file, len);
+    if (len > ext_len) {
+        strcmp_s(ckpt->prefix + len - ext_len, ext_len, ".json", &diff);
+        if (!diff) {
+            ckpt->prefix[len - ext_len] = '\0';
+        }
+    }
+    snprintf(ckpt->journal, len + sizeof(AMVP_CKPT_JOURNAL_EXT), "%s" AMVP_CKPT_JOURNAL_EXT, ckpt->prefix);
+
+    if (!ctx->checkpoint_enable) {
+        fp = fopen(ckpt->journal, "r");
+        if (!fp) {
+            goto end;
+        }
+        fclose(fp);
+    }
+
+    ctx->checkpoint = ckpt;
+    rv = amvp_ckpt_replay(ctx, ckpt);
+    if (rv != AMVP_SUCCESS) {
+        amvp_checkpoint_free(ctx);
+    }
+    return rv;
+
+end:
+    if (ckpt->prefix) free(ckpt->prefix);
+    if (ckpt->journal) free(ckpt->journal);
+    free(ckpt);
+    return rv;
+}
+
+AMVP_CKPT_STATE amvp_checkpoint_state(AMVP_CTX *ctx, const char *vsid_url) {
+    AMVP_CKPT_ENTRY *entry = NULL;
+
+    if (!ctx->checkpoint || !vsid_url) {
+        return AMVP_CKPT_NONE;
+    }
+    entry = amvp_ckpt_find(ctx->checkpoint, vsid_url);
+    return entry && entry->vs_id ? entry->state : AMVP_CKPT_NONE;
+}
+
+/*
+ * Saves the body of a downloaded vector set, it is processed from this
+ * copy if the session has to be resumed.
+ */
+AMVP_RESULT amvp_checkpoint_downloaded(AMVP_CTX *ctx, const char *vsid_url, int vs_id,
+                                       const char *body, size_t body_len) {
+    AMVP_CKPT_ENTRY entry;
+    char name[AMVP_JSON_FILENAME_MAX + 1];
+    AMVP_RESULT rv = AMVP_SUCCESS;
+
+    if (!ctx->checkpoint) {
+        return AMVP_SUCCESS;
+    }
+    if (!vsid_url || !body) {
+        return AMVP_MISSING_ARG;
+    }
+    if (!vs_id) {
+        /* Nothing to name the files after, this one is redone if resumed */
+        AMVP_LOG_WARN("No vsId in vector set %s, not checkpointing it", vsid_url);
+        return AMVP_SUCCESS;
+    }
+    entry.vs_id = vs_id;
+    amvp_ckpt_file_name(ctx->checkpoint, &entry, AMVP_CKPT_DOWNLOADED, name, sizeof(name));
+    rv = amvp_ckpt_write_file(ctx, name, body, body_len);
+    if (rv != AMVP_SUCCESS) {
+        return rv;
+    }
+    return amvp_ckpt_append(ctx, vsid_url, vs_id, AMVP_CKPT_DOWNLOADED);
+}
+
+/*
+ * Saves the responses for a vector set, the body of the upload. The
+ * downloaded copy of the vector set is no longer needed after this.
+ */
+AMVP_RESULT amvp_checkpoint_processed(AMVP_CTX *ctx, const char *vsid_url,
+                                      const char *rsp, size_t rsp_len) {
+    AMVP_CKPT_ENTRY *entry = NULL;
+    char name[AMVP_JSON_FILENAME_MAX + 1];
+    AMVP_RESULT rv = AMVP_SUCCESS;
+
+    if (!ctx->checkpoint) {
+        return AMVP_SUCCESS;
+    }
+    entry = amvp_ckpt_find(ctx->checkpoint, vsid_url);
+    if (!entry || !entry->vs_id) {
+        return AMVP_SUCCESS;
+    }
+    if (!rsp) {
+        return AMVP_MISSING_ARG;
+    }
+    amvp_ckpt_file_name(ctx->checkpoint, entry, AMVP_CKPT_PROCESSED, name, sizeof(name));
+    rv = amvp_ckpt_write_file(ctx, name, rsp, rsp_len);
+    if (rv != AMVP_SUCCESS) {
+        return rv;
+    }
+    rv = amvp_ckpt_append(ctx, vsid_url, entry->vs_id, AMVP_CKPT_PROCESSED);
+    if (rv == AMVP_SUCCESS) {
+        amvp_ckpt_file_name(ctx->checkpoint, entry, AMVP_CKPT_DOWNLOADED, name, sizeof(name));
+        remove(name);
+    }
+    return rv;
+}
+
+/*
+ * Records that the server accepted the responses for a vector set, and
+ * drops the local copy of them.
+ */
+AMVP_RESULT amvp_checkpoint_uploaded(AMVP_CTX *ctx, const char *vsid_url) {
+    AMVP_CKPT_ENTRY *entry = NULL;
+    char name[AMVP_JSON_FILENAME_MAX + 1];
+    AMVP_RESULT rv = AMVP_SUCCESS;
+
+    if (!ctx->checkpoint) {
+        return AMVP_SUCCESS;
+    }
+    entry = amvp_ckpt_find(ctx->checkpoint, vsid_url);
+    if (!entry) {
+        return AMVP_SUCCESS;
+    }
+    rv = amvp_ckpt_append(ctx, vsid_url, entry->vs_id, AMVP_CKPT_UPLOADED);
+    if (rv == AMVP_SUCCESS) {
+        amvp_ckpt_file_name(ctx->checkpoint, entry, AMVP_CKPT_PROCESSED, name, sizeof(name));
+        remove(name);
+    }
+    return rv;
+}
+
+/*
+ * Reads back the file saved for a vector set in the given state: the
+ * vector set for AMVP_CKPT_DOWNLOADED, the responses for
+ * AMVP_CKPT_PROCESSED. The caller frees *data.
+ */
+AMVP_RESULT amvp_checkpoint_load(AMVP_CTX *ctx, const char *vsid_url, AMVP_CKPT_STATE state,
+                                 char **data, size_t *data_len) {
+    AMVP_CKPT_ENTRY *entry = NULL;
+    char name[AMVP_JSON_FILENAME_MAX + 1];
+    FILE *fp = NULL;
+    long len = 0;
+    char *buf = NULL;
+
+    if (!ctx->checkpoint || !data || !data_len) {
+        return AMVP_MISSING_ARG;
+    }
+    *data = NULL;
+    *data_len = 0;
+    entry = amvp_ckpt_find(ctx->checkpoint, vsid_url);
+    if (!entry) {
+        return AMVP_MISSING_ARG;
+    }
+    amvp_ckpt_file_name(ctx->checkpoint, entry, state, name, sizeof(name));
+    fp = fopen(name, "rb");
+    if (!fp) {
+        AMVP_LOG_WARN("Checkpoint file %s is missing", name);
+        return AMVP_TRANSPORT_FAIL;
+    }
+    if (fseek(fp, 0, SEEK_END) || (len = ftell(fp)) <= 0 || fseek(fp, 0, SEEK_SET)) {
+        fclose(fp);
+        AMVP_LOG_WARN("Unable to read checkpoint file %s", name);
+        return AMVP_TRANSPORT_FAIL;
+    }
+    buf = malloc((size_t)len + 1);
+    if (!buf) {
+        fclose(fp);
+        return AMVP_MALLOC_FAIL;
+    }
+    if (fread(buf, 1, (size_t)len, fp) != (size_t)len) {
+        fclose(fp);
+        free(buf);
+        AMVP_LOG_WARN("Unable to read checkpoint file %s", name);
+        return AMVP_TRANSPORT_FAIL;
+    }
+    fclose(fp);
+    buf[len] = '\0';
+    *data = buf;
+    *data_len = (size_t)len;
+    return AMVP_SUCCESS;
+}
+
+void amvp_checkpoint_free(AMVP_CTX *ctx) {
+    AMVP_CKPT_ENTRY *entry = NULL, *next = NULL;
+
+    if (!ctx || !ctx->checkpoint) {
+        return;
+    }
+    for (entry = ctx->checkpoint->entries; entry; entry = next) {
+        next = entry->next;
+        free(entry->vsid_url);
+        free(entry);
+    }
+    free(ctx->checkpoint->journal);
+    free(ctx->checkpoint->prefix);
+    free(ctx->checkpoint);
+    ctx->checkpoint = NULL;
+}
+
+AMVP_RESULT amvp_set_resume_checkpoints(AMVP_CTX *ctx, int enable) {
+    if (!ctx) {
+        return AMVP_NO_CTX;
+    }
+    ctx->checkpoint_enable = enable ? 1 : 0;
+    return AMVP_SUCCESS;
+}
@@ -0,0 +1,546 @@
+/** @file */
+/*
+ * Copyright (c) 2021, Cisco Systems, Inc.
+ *
+ * Licensed under the Apache License 2.0 (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://github.com/cisco/libamvp/LICENSE
+ */
+
+/*
+ * Cache of crypto_handler results, enabled with amvp_set_crypto_cache().
+ *
+ * Test cases are keyed by their capability type, cipher, test type and
+ * inputs. When a test case with the same key comes up again, in the same
+ * session or, with a cache file, in a later one against the same module
+ * build, its outputs are copied from the cache instead of calling the
+ * crypto_handler. Only test cases whose outputs are a function of their
+ * inputs are cached: hash AFT and VOT, HMAC, and CMAC generate. Everything
+ * else, including the randomized DRBG, keygen and siggen test cases, always
+ * goes to the crypto_handler.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+#include "amvp.h"
+#include "amvp_lcl.h"
+#include "parson.h"
+#include "safe_lib.h"
+
+#define AMVP_CRYPTO_CACHE_MIN 256  /* Power of 2 */
+#define AMVP_CRYPTO_CACHE_IN_MAX 4
+
+typedef struct amvp_crypto_cache_entry_t {
+    unsigned int hash;
+    unsigned char *key;
+    int key_len;
+    unsigned char *out;
+    int out_len;
+    struct amvp_crypto_cache_entry_t *next;
+} AMVP_CRYPTO_CACHE_ENTRY;
+
+struct amvp_crypto_cache_t {
+    char *file;                 /* NULL to keep the cache in memory only */
+    AMVP_CRYPTO_CACHE_ENTRY **buckets;
+    size_t size;
+    size_t count;
+    unsigned long hits;
+    unsigned long misses;
+    int dirty;
+#ifndef _WIN32
+    pthread_mutex_t lock;       /* The worker pool looks up test cases in parallel */
+#endif
+};
+
+/*
+ * Where a test case's inputs and outputs are. The scalars that select
+ * the operation (cipher, test type, output length) are part of the key
+ * along with the input buffers.
+ */
+typedef struct amvp_crypto_cache_io_t {
+    unsigned int scalars[3];
+    const unsigned char *in[AMVP_CRYPTO_CACHE_IN_MAX];
+    unsigned int in_len[AMVP_CRYPTO_CACHE_IN_MAX];
+    int in_cnt;
+    unsigned char *out;
+    unsigned int *out_len;
+    unsigned int out_max;
+} AMVP_CRYPTO_CACHE_IO;
+
+static void amvp_crypto_cache_in(AMVP_CRYPTO_CACHE_IO *io, const unsigned char *buf, unsigned int len) {
+    io->in[io->in_cnt] = buf;
+    io->in_len[io->in_cnt] = buf ? len : 0;
+    io->in_cnt++;
+}
+
+/*
+ * Fills in io for the test cases that can be cached. Returns 0 for the
+ * ones that can't.
+ */
+static int amvp_crypto_cache_io(AMVP_CAPS_LIST *cap, AMVP_TEST_CASE *tc, AMVP_CRYPTO_CACHE_IO *io) {
+    AMVP_HASH_TC *hash = NULL;
+    AMVP_HMAC_TC *hmac = NULL;
+    AMVP_CMAC_TC *cmac = NULL;
+
+    memzero_s(io, sizeof(AMVP_CRYPTO_CACHE_IO));
+    switch (cap->cap_type) {
+    case AMVP_HASH_TYPE:
+        hash = tc->tc.hash;
+        if (hash->test_type != AMVP_HASH_TEST_TYPE_AFT &&
+            hash->test_type != AMVP_HASH_TEST_TYPE_VOT) {
+            /* Each MCT iteration depends on the last, there's nothing to reuse */
+            return 0;
+        }
+        io->scalars[0] = hash->cipher;
+        io->scalars[1] = hash->test_type;
+        io->scalars[2] = hash->xof_len;
+        amvp_crypto_cache_in(io, hash->msg, hash->msg_len);
+        io->out = hash->md;
+        io->out_len = &hash->md_len;
+        io->out_max = hash->test_type == AMVP_HASH_TEST_TYPE_VOT ? AMVP_HASH_XOF_MD_BYTE_MAX : AMVP_HASH_MD_BYTE_MAX;
+        return 1;
+    case AMVP_HMAC_TYPE:
+        hmac = tc->tc.hmac;
+        io->scalars[0] = hmac->cipher;
+        io->scalars[2] = hmac->mac_len;
+        amvp_crypto_cache_in(io, hmac->key, hmac->key_len);
+        amvp_crypto_cache_in(io, hmac->msg, hmac->msg_len);
+        io->out = hmac->mac;
+        io->out_len = &hmac->mac_len;
+        io->out_max = AMVP_HMAC_MAC_BYTE_MAX;
+        return 1;
+    case AMVP_CMAC_TYPE:
+        cmac = tc->tc.cmac;
+        if (cmac->verify) {
+            /* The disposition isn't an output buffer */
+            return 0;
+        }
+        io->scalars[0] = cmac->cipher;
+        io->scalars[1] = cmac->test_type;
+        io->scalars[2] = cmac->mac_len;
+        amvp_crypto_cache_in(io, cmac->key, cmac->key_len);
+        amvp_crypto_cache_in(io, cmac->key2, cmac->key2 ? cmac->key_len : 0);
+        amvp_crypto_cache_in(io, cmac->key3, cmac->key3 ? cmac->key_len : 0);
+        amvp_crypto_cache_in(io, cmac->msg, cmac->msg_len);
+        io->out = cmac->mac;
+        io->out_len = &cmac->mac_len;
+        io->out_max = AMVP_CMAC_MACLEN_MAX;
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+static void amvp_crypto_cache_put32(unsigned char *p, unsigned int v) {
+    p[0] = (unsigned char)(v >> 24);
+    p[1] = (unsigned char)(v >> 16);
+    p[2] = (unsigned char)(v >> 8);
+    p[3] = (unsigned char)v;
+}
+
+/*
+ * Serializes the key of a test case: the capability type and scalars,
+ * then each input with its length. Returns NULL if it could not be
+ * allocated.
+ */
+static unsigned char *amvp_crypto_cache_key(AMVP_CAPS_LIST *cap, const AMVP_CRYPTO_CACHE_IO *io, int *key_len) {
+    unsigned char *key = NULL;
+    int len = 4 * 4, pos = 0, i;
+
+    for (i = 0; i < io->in_cnt; i++) {
+        len += 4 + (int)io->in_len[i];
+    }
+    key = malloc(len);
+    if (!key) {
+        return NULL;
+    }
+    amvp_crypto_cache_put32(key, cap->cap_type);
+    pos = 4;
+    for (i = 0; i < 3; i++) {
+        amvp_crypto_cache_put32(key + pos, io->scalars[i]);
+        pos += 4;
+    }
+    for (i = 0; i < io->in_cnt; i++) {
+        amvp_crypto_cache_put32(key + pos, io->in_len[i]);
+        pos += 4;
+        if (io->in_len[i]) {
+            memcpy_s(key + pos, len - pos, io->in[i], io->in_len[i]);
+            pos += io->in_len[i];
+        }
+    }
+    *key_len = len;
+    return key;
+}
+
+/* FNV-1a, as for the alg index */
+static unsigned int amvp_crypto_cache_hash(const unsigned char *key, int key_len) {
+    unsigned int h = 2166136261u;
+    int i;
+
+    for (i = 0; i < key_len; i++) {
+        h = (h ^ key[i]) * 16777619u;
+    }
+    return h;
+}
+
+static AMVP_CRYPTO_CACHE_ENTRY *amvp_crypto_cache_find(AMVP_CRYPTO_CACHE *cache, unsigned int hash,
+                                                       const unsigned char *key, int key_len) {
+    AMVP_CRYPTO_CACHE_ENTRY *entry = NULL;
+    int diff = 1;
+
+    if (!cache->size) {
+        return NULL;
+    }
+    for (entry = cache->buckets[hash & (cache->size - 1)]; entry; entry = entry->next) {
+        if (entry->hash != hash || entry->key_len != key_len) {
+            continue;
+        }
+        memcmp_s(entry->key, entry->key_len, key, key_len, &diff);
+        if (!diff) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+/* Takes ownership of key and out. Returns 0 if the table could not grow. */
+static int amvp_crypto_cache_insert(AMVP_CRYPTO_CACHE *cache, unsigned int hash, unsigned char *key,
+                                    int key_len, unsigned char *out, int out_len) {
+    AMVP_CRYPTO_CACHE_ENTRY **buckets = NULL, *entry = NULL, *next = NULL;
+    size_t size = 0, i = 0;
+
+    if (cache->count >= cache->size) {
+        size = cache->size ? cache->size * 2 : AMVP_CRYPTO_CACHE_MIN;
+        buckets = calloc(size, sizeof(AMVP_CRYPTO_CACHE_ENTRY *));
+        if (!buckets) {
+            return 0;
+        }
+        for (i = 0; i < cache->size; i++) {
+            for (entry = cache->buckets[i]; entry; entry = next) {
+                next = entry->next;
+                entry->next = buckets[entry->hash & (size - 1)];
+                buckets[entry->hash & (size - 1)] = entry;
+            }
+        }
+        if (cache->buckets) free(cache->buckets);
+        cache->buckets = buckets;
+        cache->size = size;
+    }
+
+    entry = calloc(1, sizeof(AMVP_CRYPTO_CACHE_ENTRY));
+    if (!entry) {
+        return 0;
+    }
+    entry->hash = hash;
+    entry->key = key;
+    entry->key_len = key_len;
+    entry->out = out;
+    entry->out_len = out_len;
+    entry->next = cache->buckets[hash & (cache->size - 1)];
+    cache->buckets[hash & (cache->size - 1)] = entry;
+    cache->count++;
+    return 1;
+}
+
+static void amvp_crypto_cache_lock(AMVP_CRYPTO_CACHE *cache) {
+#ifndef _WIN32
+    pthread_mutex_lock(&cache->lock);
+#endif
+}
+
+static void amvp_crypto_cache_unlock(AMVP_CRYPTO_CACHE *cache) {
+#ifndef _WIN32
+    pthread_mutex_unlock(&cache->lock);
+#endif
+}
+
+/*
+ * Fills in the outputs of tc from the cache. Returns 1 on a hit, 0 when
+ * the test case has to go to the crypto_handler.
+ */
+int amvp_crypto_cache_lookup(AMVP_CTX *ctx, AMVP_CAPS_LIST *cap, AMVP_TEST_CASE *tc) {
+    AMVP_CRYPTO_CACHE *cache = ctx ? ctx->crypto_cache : NULL;
+    AMVP_CRYPTO_CACHE_ENTRY *entry = NULL;
+    AMVP_CRYPTO_CACHE_IO io;
+    unsigned char *key = NULL;
+    unsigned int hash = 0;
+    int key_len = 0, hit = 0;
+
+    if (!cache || !amvp_crypto_cache_io(cap, tc, &io) || !io.out) {
+        return 0;
+    }
+    key = amvp_crypto_cache_key(cap, &io, &key_len);
+    if (!key) {
+        return 0;
+    }
+    hash = amvp_crypto_cache_hash(key, key_len);
+
+    amvp_crypto_cache_lock(cache);
+    entry = amvp_crypto_cache_find(cache, hash, key, key_len);
+    if (entry && entry->out_len <= (int)io.out_max) {
+        memcpy_s(io.out, io.out_max, entry->out, entry->out_len);
+        *io.out_len = entry->out_len;
+        cache->hits++;
+        hit = 1;
+    } else {
+        cache->misses++;
+    }
+    amvp_crypto_cache_unlock(cache);
+    free(key);
+    return hit;
+}
+
+/*
+ * Adds the outputs of tc, which the crypto_handler just computed
+ * successfully, to the cache.
+ */
+void amvp_crypto_cache_store(AMVP_CTX *ctx, AMVP_CAPS_LIST *cap, AMVP_TEST_CASE *tc) {
+    AMVP_CRYPTO_CACHE *cache = ctx ? ctx->crypto_cache : NULL;
+    AMVP_CRYPTO_CACHE_IO io;
+    unsigned char *key = NULL, *out = NULL;
+    unsigned int hash = 0;
+    int key_len = 0;
+
+    if (!cache || !amvp_crypto_cache_io(cap, tc, &io) || !io.out || *io.out_len > io.out_max) {
+        return;
+    }
+    key = amvp_crypto_cache_key(cap, &io, &key_len);
+    if (!key) {
+        return;
+    }
+    hash = amvp_crypto_cache_hash(key, key_len);
+
+    out = malloc(*io.out_len ? *io.out_len : 1);
+    if (!out) {
+        free(key);
+        return;
+    }
+    memcpy_s(out, *io.out_len ? *io.out_len : 1, io.out, *io.out_len);
+    amvp_crypto_cache_lock(cache);
+    /* Another worker may have computed the same test case meanwhile */
+    if (amvp_crypto_cache_find(cache, hash, key, key_len) ||
+        !amvp_crypto_cache_insert(cache, hash, key, key_len, out, *io.out_len)) {
+        free(key);
+        free(out);
+    } else {
+        cache->dirty = 1;
+    }
+    amvp_crypto_cache_unlock(cache);
+}
+
+/*
+ * Runs the crypto handler for one test case, or copies its outputs from
+ * the cache when the same inputs were seen before. Returns what the
+ * crypto handler would.
+ */
+int amvp_crypto_cache_call(AMVP_CTX *ctx, AMVP_CAPS_LIST *cap, AMVP_TEST_CASE *tc) {
+    int ret = 0;
+
+    if (amvp_crypto_cache_lookup(ctx, cap, tc)) {
+        return 0;
+    }
+    AMVP_TRACE2(tc__start, cap->cipher, tc);
+    ret = (cap->crypto_handler)(tc);
+    AMVP_TRACE2(tc__done, cap->cipher, ret);
+    if (!ret) {
+        amvp_crypto_cache_store(ctx, cap, tc);
+    }
+    return ret;
+}
+
+/*
+ * Reads the entries of the cache file, a JSON array of objects with the
+ * hex encoded "key" and "out" of each test case.
+ */
+static AMVP_RESULT amvp_crypto_cache_load(AMVP_CTX *ctx, AMVP_CRYPTO_CACHE *cache) {
+    JSON_Value *val = NULL;
+    JSON_Array *arr = NULL;
+    JSON_Object *obj = NULL;
+    const char *key_str = NULL, *out_str = NULL;
+    unsigned char *key = NULL, *out = NULL;
+    int key_len = 0, out_len = 0, max = 0;
+    AMVP_RESULT rv = AMVP_SUCCESS;
+    FILE *fp = NULL;
+    size_t i;
+
+    fp = fopen(cache->file, "r");
+    if (!fp) {
+        /* Nothing cached yet, the file is written when the session ends */
+        return AMVP_SUCCESS;
+    }
+    fclose(fp);
+
+    val = json_parse_file(cache->file);
+    arr = json_value_get_array(val);
+    if (!arr) {
+        AMVP_LOG_WARN("Ignoring malformed crypto cache %s", cache->file);
+        json_value_free(val);
+        return AMVP_SUCCESS;
+    }
+    for (i = 0; i < json_array_get_count(arr); i++) {
+        obj = json_array_get_object(arr, i);
+        key_str = json_object_get_string(obj, "key");
+        out_str = json_object_get_string(obj, "out");
+        if (!key_str || !out_str) {
+            continue;
+        }
+        max = (int)json_object_get_string_len(obj, "key") / 2 + 1;
+        key = calloc(max, sizeof(unsigned char));
+        if (!key) {
+            rv = AMVP_MALLOC_FAIL;
+            break;
+        }
+        /* Anything that doesn't convert whole is skipped */
+        if (amvp_hexstr_to_bin(key_str, key, max, &key_len) != AMVP_SUCCESS ||
+            (size_t)key_len * 2 != json_object_get_string_len(obj, "key")) {
+            free(key);
+            continue;
+        }
+        max = (int)json_object_get_string_len(obj, "out") / 2 + 1;
+        out = calloc(max, sizeof(unsigned char));
+        if (!out) {
+            free(key);
+            rv = AMVP_MALLOC_FAIL;
+            break;
+        }
+        out_len = 0;
+        if ((out_str[0] && amvp_hexstr_to_bin(out_str, out, max, &out_len) != AMVP_SUCCESS) ||
+            (size_t)out_len * 2 != json_object_get_string_len(obj, "out") ||
+            amvp_crypto_cache_find(cache, amvp_crypto_cache_hash(key, key_len), key, key_len) ||
+            !amvp_crypto_cache_insert(cache, amvp_crypto_cache_hash(key, key_len), key, key_len, out, out_len)) {
+            free(key);
+            free(out);
+        }
+    }
+    json_value_free(val);
+    if (rv == AMVP_SUCCESS) {
+        AMVP_LOG_INFO("Loaded %lu test case results from crypto cache %s", (unsigned long)cache->count, cache->file);
+    }
+    return rv;
+}
+
+static AMVP_RESULT amvp_crypto_cache_save(AMVP_CTX *ctx, AMVP_CRYPTO_CACHE *cache) {
+    JSON_Value *val = NULL, *entry_val = NULL;
+    JSON_Object *obj = NULL;
+    AMVP_CRYPTO_CACHE_ENTRY *entry = NULL;
+    AMVP_RESULT rv = AMVP_SUCCESS;
+    char *hex = NULL;
+    size_t i;
+
+    val = json_value_init_array();
+    if (!val) {
+        return AMVP_MALLOC_FAIL;
+    }
+    for (i = 0; i < cache->size && rv == AMVP_SUCCESS; i++) {
+        for (entry = cache->buckets[i]; entry; entry = entry->next) {
+            entry_val = json_value_init_object();
+            obj = json_value_get_object(entry_val);
+            hex = calloc(entry->key_len * 2 + 1, sizeof(char));
+            if (!hex) {
+                json_value_free(entry_val);
+                rv = AMVP_MALLOC_FAIL;
+                break;
+            }
+            amvp_bin_to_hexstr(entry->key, entry->key_len, hex, entry->key_len * 2);
+            json_object_set_string(obj, "key", hex);
+            free(hex);
+            hex = calloc(entry->out_len * 2 + 1, sizeof(char));
+            if (!hex) {
+                json_value_free(entry_val);
+                rv = AMVP_MALLOC_FAIL;
+                break;
+            }
+            amvp_bin_to_hexstr(entry->out, entry->out_len, hex, entry->out_len * 2);
+            json_object_set_string(obj, "out", hex);
+            free(hex);
+            json_array_append_value(json_value_get_array(val), entry_val);
+        }
+    }
+    if (rv == AMVP_SUCCESS && json_serialize_to_file(val, cache->file) != JSONSuccess) {
+        AMVP_LOG_ERR("Unable to write crypto cache %s", cache->file);
+        rv = AMVP_JSON_ERR;
+    } else if (rv == AMVP_SUCCESS) {
+        cache->dirty = 0;
+    }
+    json_value_free(val);
+    return rv;
+}
+
+void amvp_crypto_cache_free(AMVP_CTX *ctx) {
+    AMVP_CRYPTO_CACHE *cache = NULL;
+    AMVP_CRYPTO_CACHE_ENTRY *entry = NULL, *next = NULL;
+    size_t i;
+
+    if (!ctx || !ctx->crypto_cache) {
+        return;
+    }
+    cache = ctx->crypto_cache;
+    if (cache->hits) {
+        AMVP_LOG_INFO("Crypto cache: %lu test cases reused, %lu computed", cache->hits, cache->misses);
+    }
+    if (cache->file && cache->dirty) {
+        amvp_crypto_cache_save(ctx, cache);
+    }
+    for (i = 0; i < cache->size; i++) {
+        for (entry = cache->buckets[i]; entry; entry = next) {
+            next = entry->next;
+            free(entry->key);
+            free(entry->out);
+            free(entry);
+        }
+    }
+    if (cache->buckets) free(cache->buckets);
+    if (cache->file) free(cache->file);
+#ifndef _WIN32
+    pthread_mutex_destroy(&cache->lock);
+#endif
+    free(cache);
+    ctx->crypto_cache = NULL;
+}
+
+AMVP_RESULT amvp_set_crypto_cache(AMVP_CTX *ctx, int enable, const char *cache_file) {
+    AMVP_CRYPTO_CACHE *cache = NULL;
+    AMVP_RESULT rv = AMVP_SUCCESS;
+    int len = 0;
+
+    if (!ctx) {
+        return AMVP_NO_CTX;
+    }
+    amvp_crypto_cache_free(ctx);
+    if (!enable) {
+        return AMVP_SUCCESS;
+    }
+    if (cache_file && strnlen_s(cache_file, AMVP_JSON_FILENAME_MAX + 1) > AMVP_JSON_FILENAME_MAX) {
+        AMVP_LOG_ERR("Provided cache_file length > max(%d)", AMVP_JSON_FILENAME_MAX);
+        return AMVP_INVALID_ARG;
+    }
+
+    cache = calloc(1, sizeof(AMVP_CRYPTO_CACHE));
+    if (!cache) {
+        return AMVP_MALLOC_FAIL;
+    }
+#ifndef _WIN32
+    pthread_mutex_init(&cache->lock, NULL);
+#endif
+    ctx->crypto_cache = cache;
+    if (cache_file) {
+        len = strnlen_s(cache_file, AMVP_JSON_FILENAME_MAX);
+        cache->file = calloc(len + 1, sizeof(char));
+        if (!cache->file) {
+            amvp_crypto_cache_free(ctx);
+            return AMVP_MALLOC_FAIL;
+        }
+        strncpy_s(cache->file, len + 1, cache_file, len);
+        rv = amvp_crypto_cache_load(ctx, cache);
+        if (rv != AMVP_SUCCESS) {
+            cache->dirty = 0;
+            amvp_crypto_cache_free(ctx);
+        }
+    }
+    return rv;
+}
@@ -48,9 +48,16 @@ static AMVP_RESULT amvp_des_release_tc(AMVP_SYM_CIPHER_TC *stc);
 #define OLD_IV_LEN 8
 #define TEXT_COL_LEN 10001
 #define TEXT_ROW_LEN 8
-static unsigned char old_iv[OLD_IV_LEN];
-static unsigned char ptext[TEXT_COL_LEN][TEXT_ROW_LEN];
-static unsigned char ctext[TEXT_COL_LEN][TEXT_ROW_LEN];
+
+/*
+ * Intermediate values of one TDES Monte Carlo test. Allocated for each
+ * MCT test case so that several MCTs can run at the same time.
+ */
+typedef struct amvp_des_mct_state_t {
+    unsigned char old_iv[OLD_IV_LEN];
+    unsigned char ptext[TEXT_COL_LEN][TEXT_ROW_LEN];
+    unsigned char ctext[TEXT_COL_LEN][TEXT_ROW_LEN];
+} AMVP_DES_MCT_STATE;
 
 static void shiftin(unsigned char *dst, int dst_max, unsigned char *src, int nbits) {
     int n = 0, move_bytes = 0, copy_bytes = 0;
@@ -82,13 +89,14 @@ static void shiftin(unsigned char *dst, int dst_max, unsigned char *src, int nbi
  * performs the iteration depdedent upon the cipher type and direction.
  */
 static AMVP_RESULT amvp_des_mct_iterate_tc(AMVP_CTX *ctx,
-                                           AMVP_SYM_CIPHER_TC *stc) {
+                                           AMVP_SYM_CIPHER_TC *stc,
+                                           AMVP_DES_MCT_STATE *mct) {
     int j = stc->mct_index;
     int n;
     AMVP_SUB_TDES alg;
 
-    memcpy_s(ctext[j], TEXT_ROW_LEN,  stc->ct, stc->ct_len);
-    memcpy_s(ptext[j], TEXT_ROW_LEN, stc->pt, stc->pt_len);
+    memcpy_s(mct->ctext[j], TEXT_ROW_LEN,  stc->ct, stc->ct_len);
+    memcpy_s(mct->ptext[j], TEXT_ROW_LEN, stc->pt, stc->pt_len);
 
     alg = amvp_get_tdes_alg(stc->cipher);
     if (alg == 0) {
@@ -100,22 +108,22 @@ static AMVP_RESULT amvp_des_mct_iterate_tc(AMVP_CTX *ctx,
     case AMVP_SUB_TDES_CBC:
         if (stc->direction == AMVP_SYM_CIPH_DIR_ENCRYPT) {
             if (j == 0) {
-                memcpy_s(stc->pt, AMVP_SYM_PT_BYTE_MAX, old_iv, 8);
+                memcpy_s(stc->pt, AMVP_SYM_PT_BYTE_MAX, mct->old_iv, 8);
             } else {
                 for (n = 0; n < 8; ++n) {
-                    stc->pt[n] = ctext[j - 1][n];
+                    stc->pt[n] = mct->ctext[j - 1][n];
                 }
             }
             for (n = 0; n < 8; ++n) {
-                stc->iv[n] = ctext[j][n];
+                stc->iv[n] = mct->ctext[j][n];
             }
         } else {
             for (n = 0; n < 8; ++n) {
-                stc->ct[n] = ptext[j][n];
+                stc->ct[n] = mct->ptext[j][n];
             }
             if (j != 0) {
                 for (n = 0; n < 8; ++n) {
-                    stc->iv[n] = ptext[j - 1][n];
+                    stc->iv[n] = mct->ptext[j - 1][n];
                 }
             }
         }
@@ -123,14 +131,14 @@ static AMVP_RESULT amvp_des_mct_iterate_tc(AMVP_CTX *ctx,
     case AMVP_SUB_TDES_CFB64:
         if (stc->direction == AMVP_SYM_CIPH_DIR_ENCRYPT) {
             if (j == 0) {
-                memcpy_s(stc->pt, AMVP_SYM_PT_BYTE_MAX, old_iv, 8);
+                memcpy_s(stc->pt, AMVP_SYM_PT_BYTE_MAX, mct->old_iv, 8);
             } else {
                 for (n = 0; n < 8; ++n) {
-                    stc->pt[n] = ctext[j - 1][n];
+                    stc->pt[n] = mct->ctext[j - 1][n];
                 }
             }
             for (n = 0; n < 8; ++n) {
-                stc->iv[n] = ctext[j][n];
+                stc->iv[n] = mct->ctext[j][n];
             }
         } else {
             for (n = 0; n < 8; ++n) {
@@ -145,7 +153,7 @@ static AMVP_RESULT amvp_des_mct_iterate_tc(AMVP_CTX *ctx,
     case AMVP_SUB_TDES_OFB:
         if (stc->direction == AMVP_SYM_CIPH_DIR_ENCRYPT) {
             if (j == 0) {
-                memcpy_s(stc->pt, AMVP_SYM_PT_BYTE_MAX, old_iv, 8);
+                memcpy_s(stc->pt, AMVP_SYM_PT_BYTE_MAX, mct->old_iv, 8);
             } else {
                 for (n = 0; n < 8; ++n) {
                     stc->pt[n] = stc->iv_ret[n];
@@ -153,7 +161,7 @@ static AMVP_RESULT amvp_des_mct_iterate_tc(AMVP_CTX *ctx,
             }
         } else {
             if (j == 0) {
-                memcpy_s(stc->ct, AMVP_SYM_CT_BYTE_MAX, old_iv, 8);
+                memcpy_s(stc->ct, AMVP_SYM_CT_BYTE_MAX, mct->old_iv, 8);
             } else {
                 for (n = 0; n < 8; ++n) {
                     stc->ct[n] = stc->iv_ret[n];
@@ -165,7 +173,7 @@ static AMVP_RESULT amvp_des_mct_iterate_tc(AMVP_CTX *ctx,
     case AMVP_SUB_TDES_CFB8:
         if (stc->direction == AMVP_SYM_CIPH_DIR_ENCRYPT) {
             if (j == 0) {
-                memcpy_s(stc->pt, AMVP_SYM_PT_BYTE_MAX, old_iv, 8);
+                memcpy_s(stc->pt, AMVP_SYM_PT_BYTE_MAX, mct->old_iv, 8);
             } else {
                 for (n = 0; n < 8; ++n) {
                     stc->pt[n] = stc->iv_ret[n];
@@ -393,6 +401,7 @@ static AMVP_RESULT amvp_des_mct_tc(AMVP_CTX *ctx,
     JSON_Value *r_tval = NULL;  /* Response testval */
     JSON_Object *r_tobj = NULL; /* Response testobj */
     char *tmp = NULL;
+    AMVP_DES_MCT_STATE *mct = NULL;
 #define NK_LEN 32 /* Longest key + 8 */
     unsigned char nk[NK_LEN];
     AMVP_SUB_TDES alg;
@@ -402,12 +411,18 @@ static AMVP_RESULT amvp_des_mct_tc(AMVP_CTX *ctx,
         AMVP_LOG_ERR("Unable to malloc in amvp_des_mct_tc");
         return AMVP_MALLOC_FAIL;
     }
+    mct = calloc(1, sizeof(AMVP_DES_MCT_STATE));
+    if (!mct) {
+        AMVP_LOG_ERR("Unable to malloc in amvp_des_mct_tc");
+        rv = AMVP_MALLOC_FAIL;
+        goto end;
+    }
 
     alg = amvp_get_tdes_alg(stc->cipher);
     if (alg == 0) {
         AMVP_LOG_ERR("Invalid cipher value");
-        free(tmp);
-        return AMVP_INVALID_ARG;
+        rv = AMVP_INVALID_ARG;
+        goto end;
     }
     
     switch (alg) {
@@ -432,12 +447,22 @@ static AMVP_RESULT amvp_des_mct_tc(AMVP_CTX *ctx,
     case AMVP_SUB_TDES_KW:
     default:
         AMVP_LOG_ERR("unsupported algorithm (%d)", stc->cipher);
-        free(tmp);
-        return AMVP_UNSUPPORTED_OP;
+        rv = AMVP_UNSUPPORTED_OP;
+        goto end;
     }
 
+    if (cap->crypto_mct_handler) {
+        stc->mct_out = calloc(AMVP_DES_MCT_INNER, AMVP_SYM_MCT_OUT_STRIDE);
+        stc->mct_iv_ret = calloc(AMVP_DES_MCT_INNER, AMVP_SYM_MCT_OUT_STRIDE);
+        if (!stc->mct_out || !stc->mct_iv_ret) {
+            AMVP_LOG_ERR("Unable to malloc in amvp_des_mct_tc");
+            rv = AMVP_MALLOC_FAIL;
+            goto end;
+        }
+    }
 
     for (i = 0; i < AMVP_DES_MCT_OUTER; ++i) {
+        AMVP_TRACE2(mct__iter, stc->cipher, i);
         /*
          * Create a new test case in the response
          */
@@ -450,22 +475,45 @@ static AMVP_RESULT amvp_des_mct_tc(AMVP_CTX *ctx,
         rv = amvp_des_output_mct_tc(ctx, stc, r_tobj);
         if (rv != AMVP_SUCCESS) {
             AMVP_LOG_ERR("JSON output failure in DES module");
-            free(tmp);
             json_value_free(r_tval);
-            return rv;
+            goto end;
+        }
+
+        if (stc->mct_out) {
+            /* The module runs the inner loop at once */
+            stc->mct_index = 0;
+            if (amvp_sym_mct_call(ctx, cap, tc)) {
+                AMVP_LOG_ERR("crypto module failed the operation");
+                json_value_free(r_tval);
+                rv = AMVP_CRYPTO_MODULE_FAIL;
+                goto end;
+            }
         }
 
         for (j = 0; j < AMVP_DES_MCT_INNER; ++j) {
             if (j == 0) {
-                memcpy_s(old_iv, OLD_IV_LEN, stc->iv, stc->iv_len);
+                memcpy_s(mct->old_iv, OLD_IV_LEN, stc->iv, stc->iv_len);
             }
             stc->mct_index = j;    /* indicates init vs. update */
-            /* Process the current DES encrypt test vector... */
-            if ((cap->crypto_handler)(tc)) {
+            if (stc->mct_out) {
+                /* Replay the module's outputs through the chaining */
+                unsigned char *out = stc->mct_out + j * AMVP_SYM_MCT_OUT_STRIDE;
+
+                if (stc->direction == AMVP_SYM_CIPH_DIR_ENCRYPT) {
+                    memcpy_s(stc->ct, AMVP_SYM_CT_BYTE_MAX, out,
+                             stc->cipher == AMVP_TDES_CFB1 ? 1 : stc->ct_len);
+                } else {
+                    memcpy_s(stc->pt, AMVP_SYM_PT_BYTE_MAX, out,
+                             stc->cipher == AMVP_TDES_CFB1 ? 1 : stc->pt_len);
+                }
+                memcpy_s(stc->iv_ret, AMVP_SYM_IV_BYTE_MAX,
+                         stc->mct_iv_ret + j * AMVP_SYM_MCT_OUT_STRIDE, 8);
+            } else if (amvp_crypto_call(ctx, cap, tc)) {
+                /* Process the current DES encrypt test vector... */
                 AMVP_LOG_ERR("crypto module failed the operation");
-                free(tmp);
                 json_value_free(r_tval);
-                return AMVP_CRYPTO_MODULE_FAIL;
+                rv = AMVP_CRYPTO_MODULE_FAIL;
+                goto end;
             }
             /*
              * Adjust the parameters for next iteration if needed.
@@ -475,12 +523,11 @@ static AMVP_RESULT amvp_des_mct_tc(AMVP_CTX *ctx,
             } else {
                 shiftin(nk, NK_LEN, stc->pt, bit_len);
             }
-            rv = amvp_des_mct_iterate_tc(ctx, stc);
+            rv = amvp_des_mct_iterate_tc(ctx, stc, mct);
             if (rv != AMVP_SUCCESS) {
                 AMVP_LOG_ERR("Failed the MCT iteration changes");
-                free(tmp);
                 json_value_free(r_tval);
-                return rv;
+                goto end;
             }
         }
 
@@ -506,11 +553,11 @@ static AMVP_RESULT amvp_des_mct_tc(AMVP_CTX *ctx,
         if (stc->cipher == AMVP_TDES_OFB) {
             if (stc->direction == AMVP_SYM_CIPH_DIR_ENCRYPT) {
                 for (n = 0; n < 8; ++n) {
-                    stc->pt[n] = ptext[0][n] ^ stc->iv_ret[n];
+                    stc->pt[n] = mct->ptext[0][n] ^ stc->iv_ret[n];
                 }
             } else {
                 for (n = 0; n < 8; ++n) {
-                    stc->ct[n] = ctext[0][n] ^ stc->iv_ret[n];
+                    stc->ct[n] = mct->ctext[0][n] ^ stc->iv_ret[n];
                 }
             }
         }
@@ -522,17 +569,15 @@ static AMVP_RESULT amvp_des_mct_tc(AMVP_CTX *ctx,
                 rv = amvp_bin_to_hexstr(stc->ct, 1, tmp, AMVP_SYM_CT_MAX);
                 if (rv != AMVP_SUCCESS) {
                     AMVP_LOG_ERR("hex conversion failure (ct)");
-                    free(tmp);
                     json_value_free(r_tval);
-                    return rv;
+                    goto end;
                 }
             } else {
                 rv = amvp_bin_to_hexstr(stc->ct, stc->ct_len, tmp, AMVP_SYM_CT_MAX);
                 if (rv != AMVP_SUCCESS) {
                     AMVP_LOG_ERR("hex conversion failure (ct)");
-                    free(tmp);
                     json_value_free(r_tval);
-                    return rv;
+                    goto end;
                 }
             }
             json_object_set_string(r_tobj, "ct", tmp);
@@ -542,17 +587,15 @@ static AMVP_RESULT amvp_des_mct_tc(AMVP_CTX *ctx,
                 rv = amvp_bin_to_hexstr(stc->pt, 1, tmp, AMVP_SYM_CT_MAX);
                 if (rv != AMVP_SUCCESS) {
                     AMVP_LOG_ERR("hex conversion failure (pt)");
-                    free(tmp);
                     json_value_free(r_tval);
-                    return rv;
+                    goto end;
                 }
             } else {
                 rv = amvp_bin_to_hexstr(stc->pt, stc->pt_len, tmp, AMVP_SYM_CT_MAX);
                 if (rv != AMVP_SUCCESS) {
                     AMVP_LOG_ERR("hex conversion failure (pt)");
-                    free(tmp);
                     json_value_free(r_tval);
-                    return rv;
+                    goto end;
                 }
             }
             json_object_set_string(r_tobj, "pt", tmp);
@@ -561,10 +604,20 @@ static AMVP_RESULT amvp_des_mct_tc(AMVP_CTX *ctx,
         json_array_append_value(res_array, r_tval);
     }
 
+    rv = AMVP_SUCCESS;
 
-    free(tmp);
-
-    return AMVP_SUCCESS;
+end:
+    if (tmp) free(tmp);
+    if (mct) free(mct);
+    if (stc->mct_out) {
+        free(stc->mct_out);
+        stc->mct_out = NULL;
+    }
+    if (stc->mct_iv_ret) {
+        free(stc->mct_iv_ret);
+        stc->mct_iv_ret = NULL;
+    }
+    return rv;
 }
 
 /**
@@ -989,7 +1042,7 @@ AMVP_RESULT amvp_des_kat_handler(AMVP_CTX *ctx, JSON_Object *obj) {
                 }
             } else {
                 /* Process the current DES encrypt test vector... */
-                int t_rv = (cap->crypto_handler)(&tc);
+                int t_rv = amvp_crypto_call(ctx, cap, &tc);
                 if (t_rv) {
                     AMVP_LOG_ERR("ERROR: crypto module failed the operation");
                     json_value_free(r_tval);
@@ -1023,9 +1076,11 @@ AMVP_RESULT amvp_des_kat_handler(AMVP_CTX *ctx, JSON_Object *obj) {
     json_array_append_value(reg_arry, r_vs_val);
     rv = AMVP_SUCCESS;
 
-    json_result = json_serialize_to_string_pretty(ctx->kat_resp, NULL);
-    AMVP_LOG_VERBOSE("\n\n%s\n\n", json_result);
-    json_free_serialized_string(json_result);
+    if (AMVP_LOG_ENABLED(AMVP_LOG_LVL_VERBOSE)) {
+        json_result = json_serialize_to_string_pretty(ctx->kat_resp, NULL);
+        AMVP_LOG_VERBOSE("\n\n%s\n\n", json_result);
+        json_free_serialized_string(json_result);
+    }
 
 err:
     if (rv != AMVP_SUCCESS) {
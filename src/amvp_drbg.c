@@ -20,22 +20,22 @@
 /*
  * Forward prototypes for local functions
  */
-static AMVP_RESULT amvp_drbg_output_tc(AMVP_CTX *ctx, AMVP_DRBG_TC *stc, JSON_Object *tc_rsp);
+static AMVP_RESULT amvp_drbg_output_tc(AMVP_CTX *ctx, AMVP_DRBG_TC *stc, AMVP_JSON_WRITER *w);
 
 static AMVP_RESULT amvp_drbg_init_tc(AMVP_CTX *ctx,
                                      AMVP_DRBG_TC *stc,
                                      unsigned int tc_id,
-                                     const char *additional_input_0,
-                                     const char *entropy_input_pr_0,
-                                     const char *additional_input_1,
-                                     const char *entropy_input_pr_1,
-                                     const char *additional_input_2,
-                                     const char *entropy_input_pr_2,
+                                     AMVP_STR_VIEW additional_input_0,
+                                     AMVP_STR_VIEW entropy_input_pr_0,
+                                     AMVP_STR_VIEW additional_input_1,
+                                     AMVP_STR_VIEW entropy_input_pr_1,
+                                     AMVP_STR_VIEW additional_input_2,
+                                     AMVP_STR_VIEW entropy_input_pr_2,
                                      int pr1_len,
                                      int pr2_len,
-                                     const char *perso_string,
-                                     const char *entropy,
-                                     const char *nonce,
+                                     AMVP_STR_VIEW perso_string,
+                                     AMVP_STR_VIEW entropy,
+                                     AMVP_STR_VIEW nonce,
                                      int reseed,
                                      int der_func_enabled,
                                      int pred_resist_enabled,
@@ -52,10 +52,6 @@ static AMVP_RESULT amvp_drbg_release_tc(AMVP_DRBG_TC *stc);
 AMVP_RESULT amvp_drbg_kat_handler(AMVP_CTX *ctx, JSON_Object *obj) {
     char *json_result = NULL;
 
-    JSON_Value *reg_arry_val = NULL;
-    JSON_Object *reg_obj = NULL;
-    JSON_Array *reg_arry = NULL;
-
     JSON_Value *groupval;
     JSON_Object *groupobj = NULL;
     JSON_Value *testval;
@@ -65,11 +61,7 @@ AMVP_RESULT amvp_drbg_kat_handler(AMVP_CTX *ctx, JSON_Object *obj) {
     JSON_Array *pred_resist_input;
     int i, g_cnt;
     int j, t_cnt;
-    JSON_Value *r_vs_val = NULL;
-    JSON_Object *r_vs = NULL;
-    JSON_Array *r_tarr = NULL, *r_garr = NULL;  /* Response testarray, grouparray */
-    JSON_Value *r_tval = NULL, *r_gval = NULL;  /* Response testval, groupval */
-    JSON_Object *r_tobj = NULL, *r_gobj = NULL; /* Response testobj, groupobj */
+    AMVP_JSON_WRITER *w = NULL;  /* Response, streamed into ctx->kat_writer */
     AMVP_CAPS_LIST *cap;
     AMVP_DRBG_TC stc;
     AMVP_TEST_CASE tc;
@@ -113,22 +105,14 @@ AMVP_RESULT amvp_drbg_kat_handler(AMVP_CTX *ctx, JSON_Object *obj) {
         return AMVP_UNSUPPORTED_OP;
     }
 
-    /*
-     * Create AMVP array for response
-     */
-    rv = amvp_create_array(&reg_obj, &reg_arry_val, &reg_arry);
-    if (rv != AMVP_SUCCESS) {
-        AMVP_LOG_ERR("Failed to create JSON response struct. ");
-        return rv;
-    }
-
     /*
      * Start to build the JSON response
      */
-    rv = amvp_setup_json_rsp_group(&ctx, &reg_arry_val, &r_vs_val, &r_vs, alg_str, &r_garr);
+    w = &ctx->kat_writer;
+    rv = amvp_jw_begin_vs_rsp(ctx, alg_str, NULL);
     if (rv != AMVP_SUCCESS) {
         AMVP_LOG_ERR("Failed to setup json response");
-        return rv;
+        goto err;
     }
 
     groups = json_object_get_array(obj, "testGroups");
@@ -147,17 +131,15 @@ AMVP_RESULT amvp_drbg_kat_handler(AMVP_CTX *ctx, JSON_Object *obj) {
          * Create a new group in the response with the tgid
          * and an array of tests
          */
-        r_gval = json_value_init_object();
-        r_gobj = json_value_get_object(r_gval);
         tgId = json_object_get_number(groupobj, "tgId");
         if (!tgId) {
             AMVP_LOG_ERR("Missing tgid from server JSON groub obj");
             rv = AMVP_MALFORMED_JSON;
             goto err;
         }
-        json_object_set_number(r_gobj, "tgId", tgId);
-        json_object_set_value(r_gobj, "tests", json_value_init_array());
-        r_tarr = json_object_get_array(r_gobj, "tests");
+        amvp_jw_begin_object(w, NULL);
+        amvp_jw_number(w, "tgId", tgId);
+        amvp_jw_begin_array(w, "tests");
 
         /*
          * Get DRBG Mode index
@@ -267,57 +249,56 @@ AMVP_RESULT amvp_drbg_kat_handler(AMVP_CTX *ctx, JSON_Object *obj) {
             JSON_Value *pr_input_val = NULL;
             JSON_Object *pr_input_obj = NULL;
             unsigned int tc_id = 0, pr_input_count = 0;
-            const char *additional_input_0 = NULL, *entropy_input_pr_0 = NULL,
-                       *additional_input_1 = NULL, *entropy_input_pr_1 = NULL,
-                       *additional_input_2 = NULL, *entropy_input_pr_2 = NULL,
-                       *perso_string = NULL, *entropy = NULL, *nonce = NULL;
+            AMVP_STR_VIEW additional_input_0 = { 0 }, entropy_input_pr_0 = { 0 },
+                          additional_input_1 = { 0 }, entropy_input_pr_1 = { 0 },
+                          additional_input_2 = { 0 }, entropy_input_pr_2 = { 0 },
+                          perso_string = { 0 }, entropy = { 0 }, nonce = { 0 };
 
             AMVP_LOG_VERBOSE("Found new DRBG test vector...");
             testval = json_array_get_value(tests, j);
             testobj = json_value_get_object(testval);
 
-            json_result = json_serialize_to_string_pretty(testval, NULL);
-            AMVP_LOG_VERBOSE("json testval count: %d\n %s\n", i, json_result);
-            json_free_serialized_string(json_result);
+            if (AMVP_LOG_ENABLED(AMVP_LOG_LVL_VERBOSE)) {
+                json_result = json_serialize_to_string_pretty(testval, NULL);
+                AMVP_LOG_VERBOSE("json testval count: %d\n %s\n", i, json_result);
+                json_free_serialized_string(json_result);
+            }
 
             tc_id = json_object_get_number(testobj, "tcId");
 
-            perso_string = json_object_get_string(testobj, "persoString");
-            if (!perso_string) {
+            perso_string = amvp_json_view(testobj, "persoString");
+            if (!perso_string.str) {
                 AMVP_LOG_ERR("Server JSON missing 'persoString'");
                 rv = AMVP_MISSING_ARG;
                 goto err;
             }
-            if (strnlen_s(perso_string, AMVP_DRBG_PER_SO_STR_MAX + 1)
-                > AMVP_DRBG_PER_SO_STR_MAX) {
+            if (perso_string.len > AMVP_DRBG_PER_SO_STR_MAX) {
                 AMVP_LOG_ERR("persoString too long, max allowed=(%d)",
                              AMVP_DRBG_PER_SO_STR_MAX);
                 rv = AMVP_INVALID_ARG;
                 goto err;
             }
 
-            entropy = json_object_get_string(testobj, "entropyInput");
-            if (!entropy) {
+            entropy = amvp_json_view(testobj, "entropyInput");
+            if (!entropy.str) {
                 AMVP_LOG_ERR("Server JSON missing 'entropyInput'");
                 rv = AMVP_MISSING_ARG;
                 goto err;
             }
-            if (strnlen_s(entropy, AMVP_DRBG_ENTPY_IN_STR_MAX + 1)
-                > AMVP_DRBG_ENTPY_IN_STR_MAX) {
+            if (entropy.len > AMVP_DRBG_ENTPY_IN_STR_MAX) {
                 AMVP_LOG_ERR("entropyInput too long, max allowed=(%d)",
                              AMVP_DRBG_ENTPY_IN_STR_MAX);
                 rv = AMVP_INVALID_ARG;
                 goto err;
             }
 
-            nonce = json_object_get_string(testobj, "nonce");
-            if (!nonce) {
+            nonce = amvp_json_view(testobj, "nonce");
+            if (!nonce.str) {
                 AMVP_LOG_ERR("Server JSON missing 'nonce'");
                 rv = AMVP_MISSING_ARG;
                 goto err;
             }
-            if (strnlen_s(nonce, AMVP_DRBG_NONCE_STR_MAX + 1)
-                > AMVP_DRBG_NONCE_STR_MAX) {
+            if (nonce.len > AMVP_DRBG_NONCE_STR_MAX) {
                 AMVP_LOG_ERR("nonce too long, max allowed=(%d)",
                              AMVP_DRBG_NONCE_STR_MAX);
                 rv = AMVP_INVALID_ARG;
@@ -326,9 +307,9 @@ AMVP_RESULT amvp_drbg_kat_handler(AMVP_CTX *ctx, JSON_Object *obj) {
 
             AMVP_LOG_VERBOSE("        Test case: %d", j);
             AMVP_LOG_VERBOSE("             tcId: %d", tc_id);
-            AMVP_LOG_VERBOSE("             entropyInput: %s", entropy);
-            AMVP_LOG_VERBOSE("             perso_string: %s", perso_string);
-            AMVP_LOG_VERBOSE("             nonce: %s", nonce);
+            AMVP_LOG_VERBOSE("             entropyInput: %s", entropy.str);
+            AMVP_LOG_VERBOSE("             perso_string: %s", perso_string.str);
+            AMVP_LOG_VERBOSE("             nonce: %s", nonce.str);
 
             /*
              * Handle pred_resist_input array. Has at most 2 elements
@@ -374,28 +355,26 @@ AMVP_RESULT amvp_drbg_kat_handler(AMVP_CTX *ctx, JSON_Object *obj) {
                    goto err;
                 }
 
-                additional_input_0 = json_object_get_string(pr_input_obj, "additionalInput");
-                if (!additional_input_0) {
+                additional_input_0 = amvp_json_view(pr_input_obj, "additionalInput");
+                if (!additional_input_0.str) {
                    AMVP_LOG_ERR("Server JSON in otherInput[%d], missing 'additionalInput'", 0);
                    rv = AMVP_MISSING_ARG;
                    goto err;
                 }
-                if (strnlen_s(additional_input_0, AMVP_DRBG_ADDI_IN_STR_MAX + 1)
-                    > AMVP_DRBG_ADDI_IN_STR_MAX) {
+                if (additional_input_0.len > AMVP_DRBG_ADDI_IN_STR_MAX) {
                     AMVP_LOG_ERR("In otherInput[%d], additionalInput too long. Max allowed=(%d)",
                                  0, AMVP_DRBG_ADDI_IN_STR_MAX);
                     rv = AMVP_INVALID_ARG;
                     goto err;
                 }
 
-                entropy_input_pr_0 = json_object_get_string(pr_input_obj, "entropyInput");
-                if (!entropy_input_pr_0) {
+                entropy_input_pr_0 = amvp_json_view(pr_input_obj, "entropyInput");
+                if (!entropy_input_pr_0.str) {
                    AMVP_LOG_ERR("Server JSON in otherInput[%d], missing 'entropyInput'", 0);
                    rv = AMVP_MISSING_ARG;
                    goto err;
                 }
-                if (strnlen_s(entropy_input_pr_0, AMVP_DRBG_ENTPY_IN_STR_MAX + 1)
-                    > AMVP_DRBG_ENTPY_IN_STR_MAX) {
+                if (entropy_input_pr_0.len > AMVP_DRBG_ENTPY_IN_STR_MAX) {
                     AMVP_LOG_ERR("In otherInput[%d], entropyInput too long. Max allowed=(%d)",
                                  0, AMVP_DRBG_ENTPY_IN_STR_MAX);
                     rv = AMVP_INVALID_ARG;
@@ -427,34 +406,32 @@ AMVP_RESULT amvp_drbg_kat_handler(AMVP_CTX *ctx, JSON_Object *obj) {
                goto err;
             }
 
-            additional_input_1 = json_object_get_string(pr_input_obj, "additionalInput");
-            if (!additional_input_1) {
+            additional_input_1 = amvp_json_view(pr_input_obj, "additionalInput");
+            if (!additional_input_1.str) {
                AMVP_LOG_ERR("Server JSON in otherInput[%d], missing 'additionalInput'", 0);
                rv = AMVP_MISSING_ARG;
                goto err;
             }
-            if (strnlen_s(additional_input_1, AMVP_DRBG_ADDI_IN_STR_MAX + 1)
-                > AMVP_DRBG_ADDI_IN_STR_MAX) {
+            if (additional_input_1.len > AMVP_DRBG_ADDI_IN_STR_MAX) {
                 AMVP_LOG_ERR("In otherInput[%d], additionalInput too long. Max allowed=(%d)",
                              0, AMVP_DRBG_ADDI_IN_STR_MAX);
                 rv = AMVP_INVALID_ARG;
                 goto err;
             }
 
-            entropy_input_pr_1 = json_object_get_string(pr_input_obj, "entropyInput");
-            if (!entropy_input_pr_1) {
+            entropy_input_pr_1 = amvp_json_view(pr_input_obj, "entropyInput");
+            if (!entropy_input_pr_1.str) {
                 AMVP_LOG_ERR("Server JSON in otherInput[%d], missing 'entropyInput'", 0);
                 rv = AMVP_MISSING_ARG;
                 goto err;
             }
-            pr1_len = strnlen_s(entropy_input_pr_1, AMVP_DRBG_ENTPY_IN_STR_MAX + 1);
-            if (pr1_len > AMVP_DRBG_ENTPY_IN_STR_MAX) {
+            if (entropy_input_pr_1.len > AMVP_DRBG_ENTPY_IN_STR_MAX) {
                 AMVP_LOG_ERR("In otherInput[%d], entropyInput too long. Max allowed=(%d)",
                              0, AMVP_DRBG_ENTPY_IN_STR_MAX);
                 rv = AMVP_INVALID_ARG;
                 goto err;
             }
-            pr1_len = pr1_len/2; 
+            pr1_len = entropy_input_pr_1.len / 2;
             index++;
             /*
              * Get 2nd or 3rd element from the array
@@ -475,41 +452,32 @@ AMVP_RESULT amvp_drbg_kat_handler(AMVP_CTX *ctx, JSON_Object *obj) {
                 goto err;
             }
 
-            additional_input_2 = json_object_get_string(pr_input_obj, "additionalInput");
-            if (!additional_input_2) {
+            additional_input_2 = amvp_json_view(pr_input_obj, "additionalInput");
+            if (!additional_input_2.str) {
                AMVP_LOG_ERR("Server JSON in otherInput[%d], missing 'additionalInput'", 1);
                rv = AMVP_MISSING_ARG;
                goto err;
             }
-            if (strnlen_s(additional_input_2, AMVP_DRBG_ADDI_IN_STR_MAX + 1)
-                > AMVP_DRBG_ADDI_IN_STR_MAX) {
+            if (additional_input_2.len > AMVP_DRBG_ADDI_IN_STR_MAX) {
                 AMVP_LOG_ERR("In otherInput[%d], additionalInput too long. Max allowed=(%d)",
                              1, AMVP_DRBG_ADDI_IN_STR_MAX);
                 rv = AMVP_INVALID_ARG;
                 goto err;
             }
 
-            entropy_input_pr_2 = json_object_get_string(pr_input_obj, "entropyInput");
-            if (!entropy_input_pr_2) {
+            entropy_input_pr_2 = amvp_json_view(pr_input_obj, "entropyInput");
+            if (!entropy_input_pr_2.str) {
                 AMVP_LOG_ERR("Server JSON in otherInput[%d], missing 'entropyInput'", 1);
                 rv = AMVP_MISSING_ARG;
                 goto err;
             }
-            pr2_len = strnlen_s(entropy_input_pr_2, AMVP_DRBG_ENTPY_IN_STR_MAX + 1);
-            if (pr2_len > AMVP_DRBG_ENTPY_IN_STR_MAX) {
+            if (entropy_input_pr_2.len > AMVP_DRBG_ENTPY_IN_STR_MAX) {
                 AMVP_LOG_ERR("In otherInput[%d], entropyInput too long. Max allowed=(%d)",
                              1, AMVP_DRBG_ENTPY_IN_STR_MAX);
                 rv = AMVP_INVALID_ARG;
                 goto err;
             }
-            pr2_len = pr2_len/2; 
-            /*
-             * Create a new test case in the response
-             */
-            r_tval = json_value_init_object();
-            r_tobj = json_value_get_object(r_tval);
-
-            json_object_set_number(r_tobj, "tcId", tc_id);
+            pr2_len = entropy_input_pr_2.len / 2;
 
             /*
              * Setup the test case data that will be passed down to
@@ -528,27 +496,24 @@ AMVP_RESULT amvp_drbg_kat_handler(AMVP_CTX *ctx, JSON_Object *obj) {
 
             if (rv != AMVP_SUCCESS) {
                 amvp_drbg_release_tc(&stc);
-                json_value_free(r_tval);
                 goto err;
             }
 
             /* Process the current test vector... */
-            if ((cap->crypto_handler)(&tc)) {
+            if (amvp_crypto_call(ctx, cap, &tc)) {
                 AMVP_LOG_ERR("crypto module failed the operation");
                 rv = AMVP_CRYPTO_MODULE_FAIL;
                 amvp_drbg_release_tc(&stc);
-                json_value_free(r_tval);
                 goto err;
             }
 
             /*
              * Output the test case results using JSON
              */
-            rv = amvp_drbg_output_tc(ctx, &stc, r_tobj);
+            rv = amvp_drbg_output_tc(ctx, &stc, w);
             if (rv != AMVP_SUCCESS) {
                 AMVP_LOG_ERR("JSON output failure in DRBG module");
                 amvp_drbg_release_tc(&stc);
-                json_value_free(r_tval);
                 goto err;
             }
 
@@ -556,22 +521,28 @@ AMVP_RESULT amvp_drbg_kat_handler(AMVP_CTX *ctx, JSON_Object *obj) {
              * Release all the memory associated with the test case
              */
             amvp_drbg_release_tc(&stc);
-
-            /* Append the test response value to array */
-            json_array_append_value(r_tarr, r_tval);
         }
-        json_array_append_value(r_garr, r_gval);
+        amvp_jw_end_array(w);
+        rv = amvp_jw_end_object(w);
+        if (rv != AMVP_SUCCESS) {
+            AMVP_LOG_ERR("JSON output failure in DRBG module");
+            goto err;
+        }
     }
-    json_array_append_value(reg_arry, r_vs_val);
 
-    json_result = json_serialize_to_string_pretty(ctx->kat_resp, NULL);
-    AMVP_LOG_VERBOSE("\n\n%s\n\n", json_result);
-    json_free_serialized_string(json_result);
+    rv = amvp_jw_end_vs_rsp(ctx);
+    if (rv != AMVP_SUCCESS) {
+        AMVP_LOG_ERR("JSON output failure in DRBG module");
+        goto err;
+    }
+    /* Only log the response if it all stayed in memory, w->buf is just its tail otherwise */
+    if (AMVP_LOG_ENABLED(AMVP_LOG_LVL_VERBOSE) && !w->spilled) {
+        AMVP_LOG_VERBOSE("\n\n%s\n\n", w->buf);
+    }
 
-    rv = AMVP_SUCCESS;
 err:
     if (rv != AMVP_SUCCESS) {
-        amvp_release_json(r_vs_val, r_gval);
+        if (w) amvp_jw_reset(w);
     }
     return rv;
 }
@@ -582,43 +553,32 @@ err:
  * file that will be uploaded to the server.  This routine handles
  * the JSON processing for a single test case.
  */
-static AMVP_RESULT amvp_drbg_output_tc(AMVP_CTX *ctx, AMVP_DRBG_TC *stc, JSON_Object *tc_rsp) {
-    AMVP_RESULT rv = AMVP_SUCCESS;
-    char *tmp = NULL;
-
-    tmp = calloc(AMVP_DRB_STR_MAX + 1, sizeof(char));
-    if (!tmp) {
-        AMVP_LOG_ERR("Unable to malloc in amvp_drbg_output_tc");
-        return AMVP_MALLOC_FAIL;
-    }
-
-    rv = amvp_bin_to_hexstr(stc->drb, stc->drb_len, tmp, AMVP_DRB_STR_MAX);
-    if (rv != AMVP_SUCCESS) {
+static AMVP_RESULT amvp_drbg_output_tc(AMVP_CTX *ctx, AMVP_DRBG_TC *stc, AMVP_JSON_WRITER *w) {
+    if (stc->drb_len * 2 > AMVP_DRB_STR_MAX) {
         AMVP_LOG_ERR("hex conversion failure (returnedBits)");
-        goto end;
+        return AMVP_CONVERT_DATA_ERR;
     }
-    json_object_set_string(tc_rsp, "returnedBits", tmp);
-
-end:
-    if (tmp) free(tmp);
 
-    return rv;
+    amvp_jw_begin_object(w, NULL);
+    amvp_jw_number(w, "tcId", stc->tc_id);
+    amvp_jw_hex(w, "returnedBits", stc->drb, stc->drb_len);
+    return amvp_jw_end_object(w);
 }
 
 static AMVP_RESULT amvp_drbg_init_tc(AMVP_CTX *ctx,
                                      AMVP_DRBG_TC *stc,
                                      unsigned int tc_id,
-                                     const char *additional_input_0,
-                                     const char *entropy_input_pr_0,
-                                     const char *additional_input_1,
-                                     const char *entropy_input_pr_1,
-                                     const char *additional_input_2,
-                                     const char *entropy_input_pr_2,
+                                     AMVP_STR_VIEW additional_input_0,
+                                     AMVP_STR_VIEW entropy_input_pr_0,
+                                     AMVP_STR_VIEW additional_input_1,
+                                     AMVP_STR_VIEW entropy_input_pr_1,
+                                     AMVP_STR_VIEW additional_input_2,
+                                     AMVP_STR_VIEW entropy_input_pr_2,
                                      int pr1_len,
                                      int pr2_len,
-                                     const char *perso_string,
-                                     const char *entropy,
-                                     const char *nonce,
+                                     AMVP_STR_VIEW perso_string,
+                                     AMVP_STR_VIEW entropy,
+                                     AMVP_STR_VIEW nonce,
                                      int reseed,
                                      int der_func_enabled,
                                      int pred_resist_enabled,
@@ -633,106 +593,77 @@ static AMVP_RESULT amvp_drbg_init_tc(AMVP_CTX *ctx,
 
     memzero_s(stc, sizeof(AMVP_DRBG_TC));
 
-    stc->drb = calloc(AMVP_DRB_BYTE_MAX, sizeof(unsigned char));
+    /*
+     * Buffers come from the context's test case arena, which is recycled
+     * for every test case. Only drb is written by the crypto module; the
+     * inputs are decoded straight from the vector set strings, sized from
+     * the vector instead of the library maximums.
+     */
+    amvp_arena_reset(&ctx->tc_arena);
+    stc->drb = amvp_arena_alloc(&ctx->tc_arena, AMVP_DRB_BYTE_MAX);
     if (!stc->drb) { return AMVP_MALLOC_FAIL; }
-    stc->additional_input_0 = calloc(AMVP_DRBG_ADDI_IN_BYTE_MAX, sizeof(unsigned char));
-    if (!stc->additional_input_0) { return AMVP_MALLOC_FAIL; }
-    stc->additional_input_1 = calloc(AMVP_DRBG_ADDI_IN_BYTE_MAX, sizeof(unsigned char));
-    if (!stc->additional_input_1) { return AMVP_MALLOC_FAIL; }
-    stc->additional_input_2 = calloc(AMVP_DRBG_ADDI_IN_BYTE_MAX, sizeof(unsigned char));
-    if (!stc->additional_input_2) { return AMVP_MALLOC_FAIL; }
-    stc->entropy = calloc(AMVP_DRBG_ENTPY_IN_BYTE_MAX, sizeof(unsigned char));
-    if (!stc->entropy) { return AMVP_MALLOC_FAIL; }
-    stc->entropy_input_pr_0 = calloc(AMVP_DRBG_ENTPY_IN_BYTE_MAX, sizeof(unsigned char));
-    if (!stc->entropy_input_pr_0) { return AMVP_MALLOC_FAIL; }
-    stc->entropy_input_pr_1 = calloc(AMVP_DRBG_ENTPY_IN_BYTE_MAX, sizeof(unsigned char));
-    if (!stc->entropy_input_pr_1) { return AMVP_MALLOC_FAIL; }
-    stc->entropy_input_pr_2 = calloc(AMVP_DRBG_ENTPY_IN_BYTE_MAX, sizeof(unsigned char));
-    if (!stc->entropy_input_pr_2) { return AMVP_MALLOC_FAIL; }
-    stc->nonce = calloc(AMVP_DRBG_NONCE_BYTE_MAX, sizeof(unsigned char));
-    if (!stc->nonce) { return AMVP_MALLOC_FAIL; }
-    stc->perso_string = calloc(AMVP_DRBG_PER_SO_BYTE_MAX, sizeof(unsigned char));
-    if (!stc->perso_string) { return AMVP_MALLOC_FAIL; }
-
-    if (additional_input_0) {
-        rv = amvp_hexstr_to_bin(additional_input_0, stc->additional_input_0,
-                                AMVP_DRBG_ADDI_IN_BYTE_MAX, NULL);
-        if (rv != AMVP_SUCCESS) {
-            AMVP_LOG_ERR("Hex conversion failure (additional_input_0)");
-            return rv;
-        }
+    rv = amvp_arena_decode_hex(&ctx->tc_arena, additional_input_0,
+                               AMVP_BIT2BYTE(additional_input_len), AMVP_DRBG_ADDI_IN_BYTE_MAX,
+                               &stc->additional_input_0, NULL);
+    if (rv != AMVP_SUCCESS) {
+        AMVP_LOG_ERR("Hex conversion failure (additional_input_0)");
+        return rv;
     }
-
-    if (entropy_input_pr_0) {
-        rv = amvp_hexstr_to_bin(entropy_input_pr_0, stc->entropy_input_pr_0,
-                                AMVP_DRBG_ENTPY_IN_BYTE_MAX, NULL);
-        if (rv != AMVP_SUCCESS) {
-            AMVP_LOG_ERR("Hex conversion failure (entropy_input_pr_0)");
-            return rv;
-        }
+    rv = amvp_arena_decode_hex(&ctx->tc_arena, additional_input_1,
+                               AMVP_BIT2BYTE(additional_input_len), AMVP_DRBG_ADDI_IN_BYTE_MAX,
+                               &stc->additional_input_1, NULL);
+    if (rv != AMVP_SUCCESS) {
+        AMVP_LOG_ERR("Hex conversion failure (additional_input_1)");
+        return rv;
     }
-
-    if (additional_input_1) {
-        rv = amvp_hexstr_to_bin(additional_input_1, stc->additional_input_1,
-                                AMVP_DRBG_ADDI_IN_BYTE_MAX, NULL);
-        if (rv != AMVP_SUCCESS) {
-            AMVP_LOG_ERR("Hex conversion failure (additional_input_1)");
-            return rv;
-        }
+    rv = amvp_arena_decode_hex(&ctx->tc_arena, additional_input_2,
+                               AMVP_BIT2BYTE(additional_input_len), AMVP_DRBG_ADDI_IN_BYTE_MAX,
+                               &stc->additional_input_2, NULL);
+    if (rv != AMVP_SUCCESS) {
+        AMVP_LOG_ERR("Hex conversion failure (additional_input_2)");
+        return rv;
     }
-
-    if (entropy_input_pr_1) {
-        rv = amvp_hexstr_to_bin(entropy_input_pr_1, stc->entropy_input_pr_1,
-                                AMVP_DRBG_ENTPY_IN_BYTE_MAX, NULL);
-        if (rv != AMVP_SUCCESS) {
-            AMVP_LOG_ERR("Hex conversion failure (entropy_input_pr_1)");
-            return rv;
-        }
+    rv = amvp_arena_decode_hex(&ctx->tc_arena, entropy,
+                               AMVP_BIT2BYTE(entropy_len), AMVP_DRBG_ENTPY_IN_BYTE_MAX,
+                               &stc->entropy, NULL);
+    if (rv != AMVP_SUCCESS) {
+        AMVP_LOG_ERR("Hex conversion failure (entropy)");
+        return rv;
     }
-
-    if (additional_input_2) {
-        rv = amvp_hexstr_to_bin(additional_input_2, stc->additional_input_2,
-                                AMVP_DRBG_ADDI_IN_BYTE_MAX, NULL);
-        if (rv != AMVP_SUCCESS) {
-            AMVP_LOG_ERR("Hex conversion failure (2nd additional_input_2)");
-            return rv;
-        }
+    rv = amvp_arena_decode_hex(&ctx->tc_arena, entropy_input_pr_0,
+                               AMVP_BIT2BYTE(entropy_len), AMVP_DRBG_ENTPY_IN_BYTE_MAX,
+                               &stc->entropy_input_pr_0, NULL);
+    if (rv != AMVP_SUCCESS) {
+        AMVP_LOG_ERR("Hex conversion failure (entropy_input_pr_0)");
+        return rv;
     }
-
-    if (entropy_input_pr_2) {
-        rv = amvp_hexstr_to_bin(entropy_input_pr_2, stc->entropy_input_pr_2,
-                                AMVP_DRBG_ENTPY_IN_BYTE_MAX, NULL);
-        if (rv != AMVP_SUCCESS) {
-            AMVP_LOG_ERR("Hex conversion failure (2nd entropy_input_pr_2)");
-            return rv;
-        }
+    rv = amvp_arena_decode_hex(&ctx->tc_arena, entropy_input_pr_1,
+                               AMVP_BIT2BYTE(entropy_len), AMVP_DRBG_ENTPY_IN_BYTE_MAX,
+                               &stc->entropy_input_pr_1, NULL);
+    if (rv != AMVP_SUCCESS) {
+        AMVP_LOG_ERR("Hex conversion failure (entropy_input_pr_1)");
+        return rv;
     }
-
-    if (entropy) {
-        rv = amvp_hexstr_to_bin(entropy, stc->entropy,
-                                AMVP_DRBG_ENTPY_IN_BYTE_MAX, NULL);
-        if (rv != AMVP_SUCCESS) {
-            AMVP_LOG_ERR("Hex conversion failure (entropy)");
-            return rv;
-        }
+    rv = amvp_arena_decode_hex(&ctx->tc_arena, entropy_input_pr_2,
+                               AMVP_BIT2BYTE(entropy_len), AMVP_DRBG_ENTPY_IN_BYTE_MAX,
+                               &stc->entropy_input_pr_2, NULL);
+    if (rv != AMVP_SUCCESS) {
+        AMVP_LOG_ERR("Hex conversion failure (entropy_input_pr_2)");
+        return rv;
     }
-
-    if (perso_string) {
-        rv = amvp_hexstr_to_bin(perso_string, stc->perso_string,
-                                AMVP_DRBG_PER_SO_BYTE_MAX, NULL);
-        if (rv != AMVP_SUCCESS) {
-            AMVP_LOG_ERR("Hex conversion failure (perso_string)");
-            return rv;
-        }
+    rv = amvp_arena_decode_hex(&ctx->tc_arena, nonce,
+                               AMVP_BIT2BYTE(nonce_len), AMVP_DRBG_NONCE_BYTE_MAX,
+                               &stc->nonce, NULL);
+    if (rv != AMVP_SUCCESS) {
+        AMVP_LOG_ERR("Hex conversion failure (nonce)");
+        return rv;
     }
-
-    if (nonce) {
-        rv = amvp_hexstr_to_bin(nonce, stc->nonce,
-                                AMVP_DRBG_NONCE_BYTE_MAX, NULL);
-        if (rv != AMVP_SUCCESS) {
-            AMVP_LOG_ERR("Hex conversion failure (nonce)");
-            return rv;
-        }
+    rv = amvp_arena_decode_hex(&ctx->tc_arena, perso_string,
+                               AMVP_BIT2BYTE(perso_string_len), AMVP_DRBG_PER_SO_BYTE_MAX,
+                               &stc->perso_string, NULL);
+    if (rv != AMVP_SUCCESS) {
+        AMVP_LOG_ERR("Hex conversion failure (perso_string)");
+        return rv;
     }
 
     stc->der_func_enabled = der_func_enabled;
@@ -758,17 +689,7 @@ static AMVP_RESULT amvp_drbg_init_tc(AMVP_CTX *ctx,
  * a test case.
  */
 static AMVP_RESULT amvp_drbg_release_tc(AMVP_DRBG_TC *stc) {
-    if (stc->drb) free(stc->drb);
-    if (stc->additional_input_0) free(stc->additional_input_0);
-    if (stc->additional_input_1) free(stc->additional_input_1);
-    if (stc->additional_input_2) free(stc->additional_input_2);
-    if (stc->entropy) free(stc->entropy);
-    if (stc->entropy_input_pr_0) free(stc->entropy_input_pr_0);
-    if (stc->entropy_input_pr_1) free(stc->entropy_input_pr_1);
-    if (stc->entropy_input_pr_2) free(stc->entropy_input_pr_2);
-    if (stc->nonce) free(stc->nonce);
-    if (stc->perso_string) free(stc->perso_string);
-
+    /* The buffers belong to ctx->tc_arena, which the next init_tc resets */
     memzero_s(stc, sizeof(AMVP_DRBG_TC));
     return AMVP_SUCCESS;
 }
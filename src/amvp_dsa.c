@@ -487,9 +487,26 @@ static AMVP_RESULT amvp_dsa_release_tc(AMVP_DSA_TC *stc) {
     return AMVP_SUCCESS;
 }
 
+/*
+ * Release the test cases of a batched vector set, stcs[0..batch->count)
+ * having been set up by the group handler.
+ */
+static void amvp_dsa_release_batch(AMVP_DSA_TC *stcs, AMVP_TC_BATCH *batch) {
+    int i;
+
+    if (stcs) {
+        for (i = 0; i < batch->count; i++) {
+            amvp_dsa_release_tc(&stcs[i]);
+        }
+        free(stcs);
+    }
+    amvp_tc_batch_free(batch);
+}
+
 static AMVP_RESULT amvp_dsa_keygen_handler(AMVP_CTX *ctx,
                                     AMVP_TEST_CASE tc,
                                     AMVP_CAPS_LIST *cap,
+                                    AMVP_GROUP_STATE *group,
                                     JSON_Array *r_tarr,
                                     JSON_Object *groupobj,
                                     int tg_id,
@@ -559,7 +576,8 @@ static AMVP_RESULT amvp_dsa_keygen_handler(AMVP_CTX *ctx,
         }
 
         /* Process the current DSA test vector... */
-        if ((cap->crypto_handler)(&tc)) {
+        if (amvp_group_begin(ctx, cap, &tc, group, &stc->group_ctx) ||
+            amvp_crypto_call(ctx, cap, &tc)) {
             AMVP_LOG_ERR("crypto module failed the operation");
             rv = AMVP_CRYPTO_MODULE_FAIL;
             goto err;
@@ -659,10 +677,34 @@ static AMVP_DSA_GEN_PARM read_gen_pq(const char *str) {
     return 0;
 }
 
+/*
+ * Relative cost of one pqgGen test case. Generating p and q is a prime
+ * search, growing with about the fourth power of L; generating g for
+ * given p and q is a few modexps, cubic in L.
+ */
+double amvp_dsa_pqggen_cost(int l, AMVP_DSA_GEN_PARM gpq) {
+    double scale = l / 1024.0;
+
+    switch (gpq) {
+    case AMVP_DSA_PROBABLE:
+    case AMVP_DSA_PROVABLE:
+        return 500 * scale * scale * scale * scale;
+    case AMVP_DSA_CANONICAL:
+    case AMVP_DSA_UNVERIFIABLE:
+    default:
+        return 5 * scale * scale * scale;
+    }
+}
+
+/*
+ * Set up the test cases of one pqgGen group in stcs, appending them to
+ * batch. The crypto calls are made by the caller once every group has
+ * been read.
+ */
 static 
 AMVP_RESULT amvp_dsa_pqggen_handler(AMVP_CTX *ctx,
-                                    AMVP_TEST_CASE tc,
-                                    AMVP_CAPS_LIST *cap,
+                                    AMVP_DSA_TC *stcs,
+                                    AMVP_TC_BATCH *batch,
                                     JSON_Array *r_tarr,
                                     JSON_Object *groupobj) {
     const char *idx = NULL;
@@ -735,11 +777,8 @@ AMVP_RESULT amvp_dsa_pqggen_handler(AMVP_CTX *ctx,
         return AMVP_MISSING_ARG;
     }
 
-    stc = tc.tc.dsa;
-
     for (j = 0; j < t_cnt; j++) {
         AMVP_LOG_VERBOSE("Found new DSA PQGGen test vector...");
-        stc->mode = AMVP_DSA_MODE_PQGGEN;
 
         testval = json_array_get_value(tests, j);
         testobj = json_value_get_object(testval);
@@ -802,103 +841,37 @@ AMVP_RESULT amvp_dsa_pqggen_handler(AMVP_CTX *ctx,
             }
         }
 
+        /*
+         * Create a new test case in the response
+         */
+        r_tval = json_value_init_object();
+        r_tobj = json_value_get_object(r_tval);
+        json_object_set_number(r_tobj, "tcId", tc_id);
+        json_array_append_value(r_tarr, r_tval);
+
         /*
          * Setup the test case data that will be passed down to
          * the crypto module.
          */
-
-        switch (gpq) {
-        case AMVP_DSA_PROBABLE:
-        case AMVP_DSA_PROVABLE:
-            /*
-             * Create a new test case in the response
-             */
-            r_tval = json_value_init_object();
-            r_tobj = json_value_get_object(r_tval);
-            json_object_set_number(r_tobj, "tcId", tc_id);
-
-            rv = amvp_dsa_pqggen_init_tc(ctx, stc, gpq, idx, l, n, sha, p, q, seed);
-            if (rv != AMVP_SUCCESS) {
-                amvp_dsa_release_tc(stc);
-                json_value_free(r_tval);
-                return rv;
-            }
-
-            /* Process the current DSA test vector... */
-            if ((cap->crypto_handler)(&tc)) {
-                AMVP_LOG_ERR("crypto module failed the operation");
-                amvp_dsa_release_tc(stc);
-                json_value_free(r_tval);
-                return AMVP_CRYPTO_MODULE_FAIL;
-            }
-
-            /*
-             * Output the test case results using JSON
-             */
-            rv = amvp_dsa_output_tc(ctx, stc, r_tobj);
-            if (rv != AMVP_SUCCESS) {
-                AMVP_LOG_ERR("JSON output failure in DSA module");
-                json_value_free(r_tval);
-                amvp_dsa_release_tc(stc);
-                return rv;
-            }
-
-            stc->seedlen = 0;
-            stc->counter = 0;
-            if (stc->seed) free(stc->seed);
-            stc->seed = 0;
-            break;
-
-        case AMVP_DSA_CANONICAL:
-        case AMVP_DSA_UNVERIFIABLE:
-            /*
-             * Create a new test case in the response
-             */
-            r_tval = json_value_init_object();
-            r_tobj = json_value_get_object(r_tval);
-            json_object_set_number(r_tobj, "tcId", tc_id);
-
-            /* Process the current DSA test vector... */
-            rv = amvp_dsa_pqggen_init_tc(ctx, stc, gpq, idx, l, n, sha, p, q, seed);
-            if (rv != AMVP_SUCCESS) {
-                amvp_dsa_release_tc(stc);
-                json_value_free(r_tval);
-                return rv;
-            }
-
-            if ((cap->crypto_handler)(&tc)) {
-                AMVP_LOG_ERR("crypto module failed the operation");
-                amvp_dsa_release_tc(stc);
-                json_value_free(r_tval);
-                return AMVP_CRYPTO_MODULE_FAIL;
-            }
-
-            /*
-             * Output the test case results using JSON
-             */
-            rv = amvp_dsa_output_tc(ctx, stc, r_tobj);
-            if (rv != AMVP_SUCCESS) {
-                AMVP_LOG_ERR("JSON output failure in DSA module");
-                amvp_dsa_release_tc(stc);
-                json_value_free(r_tval);
-                return rv;
-            }
-            break;
-        default:
-            AMVP_LOG_ERR("Invalid DSA PQGGen mode");
-            json_value_free(r_tval);
-            rv = AMVP_INVALID_ARG;
-            break;
+        stc = &stcs[batch->count];
+        stc->cipher = AMVP_DSA_PQGGEN;
+        stc->mode = AMVP_DSA_MODE_PQGGEN;
+        rv = amvp_dsa_pqggen_init_tc(ctx, stc, gpq, idx, l, n, sha, p, q, seed);
+        batch->tcs[batch->count].tc.dsa = stc;
+        batch->r_tobjs[batch->count] = r_tobj;
+        batch->costs[batch->count] = amvp_dsa_pqggen_cost(l, gpq);
+        batch->count++;
+        if (rv != AMVP_SUCCESS) {
+            return rv;
         }
-        json_array_append_value(r_tarr, r_tval);
-        amvp_dsa_release_tc(stc);
     }
-    return rv;
+    return AMVP_SUCCESS;
 }
 
 static AMVP_RESULT amvp_dsa_siggen_handler(AMVP_CTX *ctx,
                                     AMVP_TEST_CASE tc,
                                     AMVP_CAPS_LIST *cap,
+                                    AMVP_GROUP_STATE *group,
                                     JSON_Array *r_tarr,
                                     JSON_Object *groupobj,
                                     int tg_id,
@@ -990,7 +963,8 @@ static AMVP_RESULT amvp_dsa_siggen_handler(AMVP_CTX *ctx,
         }
 
         /* Process the current DSA test vector... */
-        if ((cap->crypto_handler)(&tc)) {
+        if (amvp_group_begin(ctx, cap, &tc, group, &stc->group_ctx) ||
+            amvp_crypto_call(ctx, cap, &tc)) {
             AMVP_LOG_ERR("crypto module failed the operation");
             rv = AMVP_CRYPTO_MODULE_FAIL;
             goto err;
@@ -1070,6 +1044,7 @@ err:
 static AMVP_RESULT amvp_dsa_pqgver_handler(AMVP_CTX *ctx,
                                     AMVP_TEST_CASE tc,
                                     AMVP_CAPS_LIST *cap,
+                                    AMVP_GROUP_STATE *group,
                                     JSON_Array *r_tarr,
                                     JSON_Object *groupobj) {
     const char *idx = NULL;
@@ -1237,7 +1212,8 @@ static AMVP_RESULT amvp_dsa_pqgver_handler(AMVP_CTX *ctx,
         }
 
         /* Process the current DSA test vector... */
-        if ((cap->crypto_handler)(&tc)) {
+        if (amvp_group_begin(ctx, cap, &tc, group, &stc->group_ctx) ||
+            amvp_crypto_call(ctx, cap, &tc)) {
             AMVP_LOG_ERR("crypto module failed the operation");
             amvp_dsa_release_tc(stc);
             return AMVP_CRYPTO_MODULE_FAIL;
@@ -1268,6 +1244,7 @@ static AMVP_RESULT amvp_dsa_pqgver_handler(AMVP_CTX *ctx,
 static AMVP_RESULT amvp_dsa_sigver_handler(AMVP_CTX *ctx,
                                     AMVP_TEST_CASE tc,
                                     AMVP_CAPS_LIST *cap,
+                                    AMVP_GROUP_STATE *group,
                                     JSON_Array *r_tarr,
                                     JSON_Object *groupobj) {
     const char *msg = NULL, *r = NULL, *s = NULL, *y = NULL, *g = NULL;
@@ -1398,7 +1375,8 @@ static AMVP_RESULT amvp_dsa_sigver_handler(AMVP_CTX *ctx,
         }
 
         /* Process the current DSA test vector... */
-        if ((cap->crypto_handler)(&tc)) {
+        if (amvp_group_begin(ctx, cap, &tc, group, &stc->group_ctx) ||
+            amvp_crypto_call(ctx, cap, &tc)) {
             AMVP_LOG_ERR("crypto module failed the operation");
             amvp_dsa_release_tc(stc);
             return AMVP_CRYPTO_MODULE_FAIL;
@@ -1439,6 +1417,7 @@ static AMVP_RESULT amvp_dsa_pqgver_kat_handler(AMVP_CTX *ctx, JSON_Object *obj)
     AMVP_CAPS_LIST *cap;
     AMVP_DSA_TC stc;
     AMVP_TEST_CASE tc;
+    AMVP_GROUP_STATE group;
     AMVP_RESULT rv;
     const char *alg_str = json_object_get_string(obj, "algorithm");
     AMVP_CIPHER alg_id;
@@ -1455,6 +1434,7 @@ static AMVP_RESULT amvp_dsa_pqgver_kat_handler(AMVP_CTX *ctx, JSON_Object *obj)
      */
     tc.tc.dsa = &stc;
     memzero_s(&stc, sizeof(AMVP_DSA_TC));
+    memzero_s(&group, sizeof(AMVP_GROUP_STATE));
 
     /*
      * Get the crypto module handler for DSA mode
@@ -1519,7 +1499,8 @@ static AMVP_RESULT amvp_dsa_pqgver_kat_handler(AMVP_CTX *ctx, JSON_Object *obj)
 
         AMVP_LOG_VERBOSE("    Test group: %d", i);
 
-        rv = amvp_dsa_pqgver_handler(ctx, tc, cap, r_tarr, groupobj);
+        rv = amvp_dsa_pqgver_handler(ctx, tc, cap, &group, r_tarr, groupobj);
+        amvp_group_end(cap, &group);
         if (rv != AMVP_SUCCESS) {
             goto err;
         }
@@ -1528,16 +1509,18 @@ static AMVP_RESULT amvp_dsa_pqgver_kat_handler(AMVP_CTX *ctx, JSON_Object *obj)
     }
     memzero_s(&stc, sizeof(AMVP_DSA_TC));
     json_array_append_value(reg_arry, r_vs_val);
-    json_result = json_serialize_to_string_pretty(ctx->kat_resp, NULL);
-    if (!json_result) {
-        AMVP_LOG_ERR("JSON unable to be serialized");
-        rv = AMVP_JSON_ERR;
-        goto err;
-    }
+    if (AMVP_LOG_ENABLED(AMVP_LOG_LVL_VERBOSE)) {
+        json_result = json_serialize_to_string_pretty(ctx->kat_resp, NULL);
+        if (!json_result) {
+            AMVP_LOG_ERR("JSON unable to be serialized");
+            rv = AMVP_JSON_ERR;
+            goto err;
+        }
 
-    AMVP_LOG_VERBOSE("\n\n%s\n\n", json_result);
+        AMVP_LOG_VERBOSE("\n\n%s\n\n", json_result);
 
-    json_free_serialized_string(json_result);
+        json_free_serialized_string(json_result);
+    }
     rv = AMVP_SUCCESS;
 
 err:
@@ -1559,24 +1542,21 @@ static AMVP_RESULT amvp_dsa_pqggen_kat_handler(AMVP_CTX *ctx, JSON_Object *obj)
     JSON_Object *reg_obj = NULL, *r_gobj = NULL;
     JSON_Array *groups;
     AMVP_CAPS_LIST *cap;
-    AMVP_DSA_TC stc;
-    AMVP_TEST_CASE tc;
+    AMVP_DSA_TC *stcs = NULL;
+    AMVP_TC_BATCH batch;
     AMVP_RESULT rv;
     const char *alg_str = json_object_get_string(obj, "algorithm");
     AMVP_CIPHER alg_id;
     char *json_result;
     unsigned int g_cnt, i;
+    int j;
 
     if (!alg_str) {
         AMVP_LOG_ERR("unable to parse 'algorithm' from JSON");
         return AMVP_MALFORMED_JSON;
     }
 
-    /*
-     * Get a reference to the abstracted test case
-     */
-    tc.tc.dsa = &stc;
-    memzero_s(&stc, sizeof(AMVP_DSA_TC));
+    memzero_s(&batch, sizeof(AMVP_TC_BATCH));
 
     /*
      * Get the crypto module handler for DSA mode
@@ -1614,7 +1594,22 @@ static AMVP_RESULT amvp_dsa_pqggen_kat_handler(AMVP_CTX *ctx, JSON_Object *obj)
     }
     g_cnt = json_array_get_count(groups);
 
-    stc.cipher = alg_id;
+    /*
+     * Every group is read before any crypto calls are made, so the
+     * workers can start on the large probable and provable groups first
+     */
+    rv = amvp_tc_batch_init(&batch, groups);
+    if (rv != AMVP_SUCCESS) {
+        goto err;
+    }
+    if (batch.max > 0) {
+        stcs = calloc(batch.max, sizeof(AMVP_DSA_TC));
+        if (!stcs) {
+            rv = AMVP_MALLOC_FAIL;
+            goto err;
+        }
+    }
+
     for (i = 0; i < g_cnt; i++) {
         int tgId = 0;
         groupval = json_array_get_value(groups, i);
@@ -1635,29 +1630,47 @@ static AMVP_RESULT amvp_dsa_pqggen_kat_handler(AMVP_CTX *ctx, JSON_Object *obj)
         json_object_set_number(r_gobj, "tgId", tgId);
         json_object_set_value(r_gobj, "tests", json_value_init_array());
         r_tarr = json_object_get_array(r_gobj, "tests");
-
-        stc.mode = AMVP_DSA_MODE_PQGGEN;
+        json_array_append_value(r_garr, r_gval);
+        r_gval = NULL;
 
         AMVP_LOG_VERBOSE("    Test group: %d", i);
 
-        rv = amvp_dsa_pqggen_handler(ctx, tc, cap, r_tarr, groupobj);
+        rv = amvp_dsa_pqggen_handler(ctx, stcs, &batch, r_tarr, groupobj);
         if (rv != AMVP_SUCCESS) {
             goto err;
         }
-        json_array_append_value(r_garr, r_gval);
-        amvp_dsa_release_tc(&stc);
     }
 
-    memzero_s(&stc, sizeof(AMVP_DSA_TC));
+    /* Process the test vectors of every group, on the worker threads if configured */
+    rv = amvp_worker_run_tcs_cost(ctx, cap, batch.tcs, batch.costs, batch.count);
+    if (rv != AMVP_SUCCESS) {
+        goto err;
+    }
+
+    for (j = 0; j < batch.count; j++) {
+        /*
+         * Output the test case results using JSON
+         */
+        rv = amvp_dsa_output_tc(ctx, &stcs[j], batch.r_tobjs[j]);
+        if (rv != AMVP_SUCCESS) {
+            AMVP_LOG_ERR("JSON output failure in DSA module");
+            goto err;
+        }
+    }
+    amvp_dsa_release_batch(stcs, &batch);
+    stcs = NULL;
+
     json_array_append_value(reg_arry, r_vs_val);
-    json_result = json_serialize_to_string_pretty(ctx->kat_resp, NULL);
-    AMVP_LOG_VERBOSE("\n\n%s\n\n", json_result);
-    json_free_serialized_string(json_result);
+    if (AMVP_LOG_ENABLED(AMVP_LOG_LVL_VERBOSE)) {
+        json_result = json_serialize_to_string_pretty(ctx->kat_resp, NULL);
+        AMVP_LOG_VERBOSE("\n\n%s\n\n", json_result);
+        json_free_serialized_string(json_result);
+    }
     rv = AMVP_SUCCESS;
 
 err:
     if (rv != AMVP_SUCCESS) {
-        amvp_dsa_release_tc(&stc);
+        amvp_dsa_release_batch(stcs, &batch);
         amvp_release_json(r_vs_val, r_gval);
     }
     return rv;
@@ -1676,6 +1689,7 @@ static AMVP_RESULT amvp_dsa_siggen_kat_handler(AMVP_CTX *ctx, JSON_Object *obj)
     AMVP_CAPS_LIST *cap;
     AMVP_DSA_TC stc;
     AMVP_TEST_CASE tc;
+    AMVP_GROUP_STATE group;
     AMVP_RESULT rv;
     const char *alg_str = json_object_get_string(obj, "algorithm");
     AMVP_CIPHER alg_id;
@@ -1692,6 +1706,7 @@ static AMVP_RESULT amvp_dsa_siggen_kat_handler(AMVP_CTX *ctx, JSON_Object *obj)
      */
     tc.tc.dsa = &stc;
     memzero_s(&stc, sizeof(AMVP_DSA_TC));
+    memzero_s(&group, sizeof(AMVP_GROUP_STATE));
 
     /*
      * Get the crypto module handler for DSA mode
@@ -1755,7 +1770,8 @@ static AMVP_RESULT amvp_dsa_siggen_kat_handler(AMVP_CTX *ctx, JSON_Object *obj)
 
         AMVP_LOG_VERBOSE("    Test group: %d", i);
 
-        rv = amvp_dsa_siggen_handler(ctx, tc, cap, r_tarr, groupobj, tgId, r_gobj);
+        rv = amvp_dsa_siggen_handler(ctx, tc, cap, &group, r_tarr, groupobj, tgId, r_gobj);
+        amvp_group_end(cap, &group);
         if (rv != AMVP_SUCCESS) {
             goto err;
 
@@ -1766,10 +1782,12 @@ static AMVP_RESULT amvp_dsa_siggen_kat_handler(AMVP_CTX *ctx, JSON_Object *obj)
 
     memzero_s(&stc, sizeof(AMVP_DSA_TC));
     json_array_append_value(reg_arry, r_vs_val);
-    json_result = json_serialize_to_string_pretty(ctx->kat_resp, NULL);
+    if (AMVP_LOG_ENABLED(AMVP_LOG_LVL_VERBOSE)) {
+        json_result = json_serialize_to_string_pretty(ctx->kat_resp, NULL);
 
-    AMVP_LOG_VERBOSE("\n\n%s\n\n", json_result);
-    json_free_serialized_string(json_result);
+        AMVP_LOG_VERBOSE("\n\n%s\n\n", json_result);
+        json_free_serialized_string(json_result);
+    }
     rv = AMVP_SUCCESS;
 
 err:
@@ -1793,6 +1811,7 @@ static AMVP_RESULT amvp_dsa_keygen_kat_handler(AMVP_CTX *ctx, JSON_Object *obj)
     AMVP_CAPS_LIST *cap;
     AMVP_DSA_TC stc;
     AMVP_TEST_CASE tc;
+    AMVP_GROUP_STATE group;
     AMVP_RESULT rv;
     const char *alg_str = json_object_get_string(obj, "algorithm");
     AMVP_CIPHER alg_id;
@@ -1809,6 +1828,7 @@ static AMVP_RESULT amvp_dsa_keygen_kat_handler(AMVP_CTX *ctx, JSON_Object *obj)
      */
     tc.tc.dsa = &stc;
     memzero_s(&stc, sizeof(AMVP_DSA_TC));
+    memzero_s(&group, sizeof(AMVP_GROUP_STATE));
 
     /*
      * Get the crypto module handler for DSA mode
@@ -1872,7 +1892,8 @@ static AMVP_RESULT amvp_dsa_keygen_kat_handler(AMVP_CTX *ctx, JSON_Object *obj)
 
         AMVP_LOG_VERBOSE("    Test group: %d", i);
 
-        rv = amvp_dsa_keygen_handler(ctx, tc, cap, r_tarr, groupobj, tgId, r_gobj);
+        rv = amvp_dsa_keygen_handler(ctx, tc, cap, &group, r_tarr, groupobj, tgId, r_gobj);
+        amvp_group_end(cap, &group);
         if (rv != AMVP_SUCCESS) {
             goto err;
         }
@@ -1882,10 +1903,12 @@ static AMVP_RESULT amvp_dsa_keygen_kat_handler(AMVP_CTX *ctx, JSON_Object *obj)
 
     memzero_s(&stc, sizeof(AMVP_DSA_TC));
     json_array_append_value(reg_arry, r_vs_val);
-    json_result = json_serialize_to_string_pretty(ctx->kat_resp, NULL);
+    if (AMVP_LOG_ENABLED(AMVP_LOG_LVL_VERBOSE)) {
+        json_result = json_serialize_to_string_pretty(ctx->kat_resp, NULL);
 
-    AMVP_LOG_VERBOSE("\n\n%s\n\n", json_result);
-    json_free_serialized_string(json_result);
+        AMVP_LOG_VERBOSE("\n\n%s\n\n", json_result);
+        json_free_serialized_string(json_result);
+    }
     rv = AMVP_SUCCESS;
 
 err:
@@ -1909,6 +1932,7 @@ static AMVP_RESULT amvp_dsa_sigver_kat_handler(AMVP_CTX *ctx, JSON_Object *obj)
     AMVP_CAPS_LIST *cap;
     AMVP_DSA_TC stc;
     AMVP_TEST_CASE tc;
+    AMVP_GROUP_STATE group;
     AMVP_RESULT rv;
     const char *alg_str = json_object_get_string(obj, "algorithm");
     AMVP_CIPHER alg_id;
@@ -1925,6 +1949,7 @@ static AMVP_RESULT amvp_dsa_sigver_kat_handler(AMVP_CTX *ctx, JSON_Object *obj)
      */
     tc.tc.dsa = &stc;
     memzero_s(&stc, sizeof(AMVP_DSA_TC));
+    memzero_s(&group, sizeof(AMVP_GROUP_STATE));
 
     /*
      * Get the crypto module handler for DSA mode
@@ -1988,7 +2013,8 @@ static AMVP_RESULT amvp_dsa_sigver_kat_handler(AMVP_CTX *ctx, JSON_Object *obj)
 
         AMVP_LOG_VERBOSE("    Test group: %d", i);
 
-        rv = amvp_dsa_sigver_handler(ctx, tc, cap, r_tarr, groupobj);
+        rv = amvp_dsa_sigver_handler(ctx, tc, cap, &group, r_tarr, groupobj);
+        amvp_group_end(cap, &group);
         if (rv != AMVP_SUCCESS) {
             goto err;
         }
@@ -1998,15 +2024,17 @@ static AMVP_RESULT amvp_dsa_sigver_kat_handler(AMVP_CTX *ctx, JSON_Object *obj)
 
     memzero_s(&stc, sizeof(AMVP_DSA_TC));
     json_array_append_value(reg_arry, r_vs_val);
-    json_result = json_serialize_to_string_pretty(ctx->kat_resp, NULL);
-    if (!json_result) {
-        AMVP_LOG_ERR("JSON unable to be serialized");
-        rv = AMVP_JSON_ERR;
-        goto err;
-    }
+    if (AMVP_LOG_ENABLED(AMVP_LOG_LVL_VERBOSE)) {
+        json_result = json_serialize_to_string_pretty(ctx->kat_resp, NULL);
+        if (!json_result) {
+            AMVP_LOG_ERR("JSON unable to be serialized");
+            rv = AMVP_JSON_ERR;
+            goto err;
+        }
 
-    AMVP_LOG_VERBOSE("\n\n%s\n\n", json_result);
-    json_free_serialized_string(json_result);
+        AMVP_LOG_VERBOSE("\n\n%s\n\n", json_result);
+        json_free_serialized_string(json_result);
+    }
     rv = AMVP_SUCCESS;
 
 err:
@@ -248,6 +248,7 @@ static AMVP_RESULT amvp_ecdsa_kat_handler_internal(AMVP_CTX *ctx, JSON_Object *o
     AMVP_CAPS_LIST *cap;
     AMVP_ECDSA_TC stc;
     AMVP_TEST_CASE tc;
+    AMVP_GROUP_STATE group;
     AMVP_RESULT rv;
 
     AMVP_CIPHER alg_id;
@@ -266,6 +267,7 @@ static AMVP_RESULT amvp_ecdsa_kat_handler_internal(AMVP_CTX *ctx, JSON_Object *o
     }
 
     memzero_s(&stc, sizeof(AMVP_ECDSA_TC));
+    memzero_s(&group, sizeof(AMVP_GROUP_STATE));
     tc.tc.ecdsa = &stc;
     mode_str = json_object_get_string(obj, "mode");
     if (!mode_str) {
@@ -467,7 +469,8 @@ static AMVP_RESULT amvp_ecdsa_kat_handler_internal(AMVP_CTX *ctx, JSON_Object *o
 
             /* Process the current test vector... */
             if (rv == AMVP_SUCCESS) {
-                if ((cap->crypto_handler)(&tc)) {
+                if (amvp_group_begin(ctx, cap, &tc, &group, &stc.group_ctx) ||
+                    amvp_crypto_call(ctx, cap, &tc)) {
                     AMVP_LOG_ERR("ERROR: crypto module failed the operation");
                     rv = AMVP_CRYPTO_MODULE_FAIL;
                     json_value_free(r_tval);
@@ -520,18 +523,22 @@ static AMVP_RESULT amvp_ecdsa_kat_handler_internal(AMVP_CTX *ctx, JSON_Object *o
              */
             amvp_ecdsa_release_tc(&stc);
         }
+        amvp_group_end(cap, &group);
         json_array_append_value(r_garr, r_gval);
     }
 
     json_array_append_value(reg_arry, r_vs_val);
 
-    json_result = json_serialize_to_string_pretty(ctx->kat_resp, NULL);
-    AMVP_LOG_VERBOSE("\n\n%s\n\n", json_result);
-    json_free_serialized_string(json_result);
+    if (AMVP_LOG_ENABLED(AMVP_LOG_LVL_VERBOSE)) {
+        json_result = json_serialize_to_string_pretty(ctx->kat_resp, NULL);
+        AMVP_LOG_VERBOSE("\n\n%s\n\n", json_result);
+        json_free_serialized_string(json_result);
+    }
     rv = AMVP_SUCCESS;
 
 err:
     if (rv != AMVP_SUCCESS) {
+        amvp_group_end(cap, &group);
         amvp_ecdsa_release_tc(&stc);
         amvp_release_json(r_vs_val, r_gval);
     }
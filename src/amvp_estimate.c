@@ -0,0 +1,380 @@
+/** @file */
+/*
+ * Copyright (c) 2021, Cisco Systems, Inc.
+ *
+ * Licensed under the Apache License 2.0 (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://github.com/cisco/libamvp/LICENSE
+ */
+
+/*
+ * Estimating the work a session will be, from the registration, before it
+ * is started. See amvp_estimate_workload().
+ *
+ * Every registration entry becomes one vector set. The server makes test
+ * groups for each combination of the values listed in a handful of its
+ * properties (directions, key lengths, curves...), and for each entry of
+ * its "capabilities", if it has those; each such combination is a unit
+ * here. A cost model per algorithm then says how many test cases a unit
+ * holds, what they cost libamvp and the module, and how large they are on
+ * the wire. The built in models are rough: the test case counts follow
+ * what the server generates for a typical registration, the libamvp times
+ * and sizes come from katbench ("make bench") on an x86-64 host, and the
+ * crypto times from a software implementation. Calibrate them for the
+ * module with amvp_set_workload_model().
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "amvp.h"
+#include "amvp_lcl.h"
+#include "parson.h"
+#include "safe_lib.h"
+
+typedef struct amvp_workload_model_rec_t {
+    char algorithm[AMVP_WORKLOAD_ALG_MAX + 1];
+    AMVP_WORKLOAD_MODEL model;
+    struct amvp_workload_model_rec_t *next;
+} AMVP_WORKLOAD_MODEL_REC;
+
+struct amvp_workload_t {
+    AMVP_WORKLOAD_MODEL_REC *models;    /* Set by amvp_set_workload_model() */
+    AMVP_WORKLOAD_ESTIMATE *sets;       /* Of the last amvp_estimate_workload() */
+    int count;
+};
+
+typedef struct amvp_workload_default_t {
+    const char *prefix;                 /* Of "algorithm" or "algorithm/mode" */
+    AMVP_WORKLOAD_MODEL model;
+} AMVP_WORKLOAD_DEFAULT;
+
+/*
+ * The first entry whose prefix matches is used, so the more specific ones
+ * come first. The last one matches everything.
+ *
+ * tests, mct_tests, mct_outer, mct_inner, lib_us, crypto_us, req_bytes, rsp_bytes
+ */
+static const AMVP_WORKLOAD_DEFAULT amvp_workload_defaults[] = {
+    { "AMVP-AES-GCM",    { 60,   0,  0,    0,      8,   1,       300,   120 } },
+    { "AMVP-AES-GMAC",   { 60,   0,  0,    0,      8,   1,       300,   80 } },
+    { "AMVP-AES-XPN",    { 60,   0,  0,    0,      8,   1,       320,   120 } },
+    { "AMVP-AES-CCM",    { 40,   0,  0,    0,      8,   1,       300,   120 } },
+    { "AMVP-AES-XTS",    { 100,  0,  0,    0,      8,   1,       400,   150 } },
+    { "AMVP-AES-KW",     { 100,  0,  0,    0,      8,   1,       250,   120 } },
+    { "AMVP-AES-CTR",    { 50,   0,  0,    0,      8,   1,       300,   120 } },
+    { "AMVP-AES-CBC-CS", { 100,  0,  0,    0,      8,   1,       300,   120 } },
+    { "AMVP-AES-",       { 356,  1,  100,  1000,   13,  0.2,     160,   90 } },
+    { "AMVP-TDES-CTR",   { 50,   0,  0,    0,      8,   1,       250,   90 } },
+    { "AMVP-TDES-KW",    { 100,  0,  0,    0,      8,   1,       250,   90 } },
+    { "AMVP-TDES-",      { 150,  1,  400,  10000,  5,   0.5,     200,   90 } },
+    { "SHAKE-",          { 300,  1,  100,  1000,   5,   0.5,     300,   150 } },
+    { "SHA3-",           { 280,  1,  100,  1000,   5,   0.5,     300,   120 } },
+    { "SHA",             { 130,  1,  100,  1000,   4,   0.3,     4100,  90 } },
+    { "HMAC-",           { 150,  0,  0,    0,      6,   1,       300,   100 } },
+    { "CMAC-",           { 14,   0,  0,    0,      9,   1,       5800,  120 } },
+    { "KMAC-",           { 100,  0,  0,    0,      8,   2,       600,   150 } },
+    { "hashDRBG",        { 15,   0,  0,    0,      10,  20,      800,   500 } },
+    { "hmacDRBG",        { 15,   0,  0,    0,      10,  30,      800,   500 } },
+    { "ctrDRBG",         { 15,   0,  0,    0,      10,  20,      800,   500 } },
+    { "RSA/keyGen",      { 10,   0,  0,    0,      20,  200000,  300,   2500 } },
+    { "RSA/",            { 30,   0,  0,    0,      20,  2000,    800,   1200 } },
+    { "DSA/pqgGen",      { 5,    0,  0,    0,      20,  100000,  300,   1500 } },
+    { "DSA/keyGen",      { 10,   0,  0,    0,      20,  5000,    1200,  1500 } },
+    { "DSA/",            { 15,   0,  0,    0,      20,  2000,    1500,  1200 } },
+    { "ECDSA/keyGen",    { 10,   0,  0,    0,      15,  500,     100,   300 } },
+    { "ECDSA/",          { 15,   0,  0,    0,      15,  500,     400,   300 } },
+    { "safePrimes",      { 5,    0,  0,    0,      20,  1000,    300,   1500 } },
+    { "KAS-",            { 10,   0,  0,    0,      20,  1000,    1000,  400 } },
+    { "KTS-",            { 10,   0,  0,    0,      20,  2000,    1500,  800 } },
+    { "",                { 50,   0,  0,    0,      10,  10,      500,   200 } }
+};
+#define AMVP_WORKLOAD_DEFAULT_CNT (int)(sizeof(amvp_workload_defaults) / sizeof(AMVP_WORKLOAD_DEFAULT))
+
+/* Properties each listed value of which gets its own test groups */
+static const char *amvp_workload_group_keys[] = {
+    "direction", "keyLen", "tagLen", "digestSize", "curve", "hashAlg", "keyingOption", "modulo"
+};
+#define AMVP_WORKLOAD_GROUP_KEY_CNT (int)(sizeof(amvp_workload_group_keys) / sizeof(char *))
+
+static AMVP_WORKLOAD *amvp_workload_get(AMVP_CTX *ctx) {
+    if (!ctx->workload) {
+        ctx->workload = calloc(1, sizeof(AMVP_WORKLOAD));
+    }
+    return ctx->workload;
+}
+
+AMVP_RESULT amvp_set_workload_model(AMVP_CTX *ctx, const char *algorithm, const AMVP_WORKLOAD_MODEL *model) {
+    AMVP_WORKLOAD_MODEL_REC *rec = NULL;
+    AMVP_WORKLOAD *w = NULL;
+    int diff = 1;
+
+    if (!ctx) {
+        return AMVP_NO_CTX;
+    }
+    if (!algorithm || !model) {
+        return AMVP_MISSING_ARG;
+    }
+    if (strnlen_s(algorithm, AMVP_WORKLOAD_ALG_MAX + 1) > AMVP_WORKLOAD_ALG_MAX) {
+        AMVP_LOG_ERR("Algorithm name too long, max %d", AMVP_WORKLOAD_ALG_MAX);
+        return AMVP_INVALID_ARG;
+    }
+    if (model->tests < 0 || model->mct_tests < 0 || model->mct_outer < 0 || model->mct_inner < 0 ||
+        model->lib_us < 0 || model->crypto_us < 0 || model->req_bytes < 0 || model->rsp_bytes < 0) {
+        AMVP_LOG_ERR("Workload model values can't be negative");
+        return AMVP_INVALID_ARG;
+    }
+    w = amvp_workload_get(ctx);
+    if (!w) {
+        return AMVP_MALLOC_FAIL;
+    }
+
+    for (rec = w->models; rec; rec = rec->next) {
+        strcmp_s(rec->algorithm, AMVP_WORKLOAD_ALG_MAX + 1, algorithm, &diff);
+        if (!diff) {
+            rec->model = *model;
+            return AMVP_SUCCESS;
+        }
+    }
+    rec = calloc(1, sizeof(AMVP_WORKLOAD_MODEL_REC));
+    if (!rec) {
+        return AMVP_MALLOC_FAIL;
+    }
+    strcpy_s(rec->algorithm, AMVP_WORKLOAD_ALG_MAX + 1, algorithm);
+    rec->model = *model;
+    rec->next = w->models;
+    w->models = rec;
+    return AMVP_SUCCESS;
+}
+
+/* Whether name starts with prefix */
+static int amvp_workload_prefix(const char *name, const char *prefix) {
+    size_t len = strnlen_s(prefix, AMVP_WORKLOAD_ALG_MAX + 1);
+
+    return !strncmp(name, prefix, len);
+}
+
+/*
+ * The model for name, "algorithm" or "algorithm/mode". One set for the
+ * algorithm and mode wins over one set for the algorithm, which wins over
+ * the built in ones.
+ */
+static const AMVP_WORKLOAD_MODEL *amvp_workload_model(AMVP_CTX *ctx, const char *name, const char *alg) {
+    AMVP_WORKLOAD_MODEL_REC *rec = NULL;
+    const AMVP_WORKLOAD_MODEL *found = NULL;
+    int diff = 1, i;
+
+    for (rec = ctx->workload ? ctx->workload->models : NULL; rec; rec = rec->next) {
+        strcmp_s(rec->algorithm, AMVP_WORKLOAD_ALG_MAX + 1, name, &diff);
+        if (!diff) {
+            return &rec->model;
+        }
+        strcmp_s(rec->algorithm, AMVP_WORKLOAD_ALG_MAX + 1, alg, &diff);
+        if (!diff) {
+            found = &rec->model;
+        }
+    }
+    if (found) {
+        return found;
+    }
+    for (i = 0; i < AMVP_WORKLOAD_DEFAULT_CNT - 1; i++) {
+        if (amvp_workload_prefix(name, amvp_workload_defaults[i].prefix)) {
+            break;
+        }
+    }
+    return &amvp_workload_defaults[i].model;
+}
+
+/*
+ * Units of a registration entry, or of one of its capabilities: the
+ * product of how many values each group property lists, times the sum of
+ * the units of its capabilities.
+ */
+static unsigned long long amvp_workload_units(JSON_Object *obj, int depth) {
+    JSON_Array *arr = NULL, *caps = NULL;
+    JSON_Value_Type type;
+    unsigned long long units = 1, cap_units = 0;
+    size_t i, n, cnt;
+    int k;
+
+    for (k = 0; k < AMVP_WORKLOAD_GROUP_KEY_CNT; k++) {
+        arr = json_object_get_array(obj, amvp_workload_group_keys[k]);
+        if (!arr) {
+            continue;
+        }
+        /* Domains (min/max/increment) vary the test cases, not the groups */
+        cnt = json_array_get_count(arr);
+        for (i = 0, n = 0; i < cnt; i++) {
+            type = json_value_get_type(json_array_get_value(arr, i));
+            if (type == JSONString || type == JSONNumber) n++;
+        }
+        if (n) units *= n;
+    }
+
+    caps = json_object_get_array(obj, "capabilities");
+    if (caps && depth < 2) {
+        cnt = json_array_get_count(caps);
+        for (i = 0; i < cnt; i++) {
+            if (json_array_get_object(caps, i)) {
+                cap_units += amvp_workload_units(json_array_get_object(caps, i), depth + 1);
+            }
+        }
+        if (cap_units) units *= cap_units;
+    }
+    return units;
+}
+
+static void amvp_workload_add(AMVP_WORKLOAD_ESTIMATE *total, const AMVP_WORKLOAD_ESTIMATE *est) {
+    total->vector_sets += est->vector_sets;
+    total->test_cases += est->test_cases;
+    total->crypto_ops += est->crypto_ops;
+    total->request_bytes += est->request_bytes;
+    total->response_bytes += est->response_bytes;
+    total->cpu_secs += est->cpu_secs;
+}
+
+static void amvp_workload_entry(AMVP_CTX *ctx, JSON_Object *entry, AMVP_WORKLOAD_ESTIMATE *est) {
+    const AMVP_WORKLOAD_MODEL *m = NULL;
+    const char *alg = json_object_get_string(entry, "algorithm");
+    const char *mode = json_object_get_string(entry, "mode");
+    unsigned long long units, kat, mct, mct_ops;
+
+    memzero_s(est, sizeof(AMVP_WORKLOAD_ESTIMATE));
+    if (!alg) alg = "";
+    if (mode) {
+        snprintf(est->algorithm, sizeof(est->algorithm), "%s/%s", alg, mode);
+    } else {
+        snprintf(est->algorithm, sizeof(est->algorithm), "%s", alg);
+    }
+    m = amvp_workload_model(ctx, est->algorithm, alg);
+    units = amvp_workload_units(entry, 0);
+
+    kat = units * (unsigned long long)m->tests;
+    mct = units * (unsigned long long)m->mct_tests;
+    mct_ops = mct * (unsigned long long)m->mct_outer * (unsigned long long)m->mct_inner;
+    est->vector_sets = 1;
+    est->test_cases = kat + mct;
+    est->crypto_ops = kat + mct_ops;
+    est->request_bytes = est->test_cases * (unsigned long long)m->req_bytes;
+    est->response_bytes = (kat + mct * (unsigned long long)m->mct_outer) * (unsigned long long)m->rsp_bytes;
+    est->cpu_secs = ((double)est->test_cases * m->lib_us + (double)est->crypto_ops * m->crypto_us) / 1e6;
+}
+
+AMVP_RESULT amvp_estimate_workload(AMVP_CTX *ctx, AMVP_WORKLOAD_ESTIMATE *total) {
+    AMVP_WORKLOAD_ESTIMATE *sets = NULL;
+    AMVP_WORKLOAD *w = NULL;
+    JSON_Value *reg = NULL;
+    JSON_Array *entries = NULL;
+    AMVP_RESULT rv = AMVP_SUCCESS;
+    int count, i;
+
+    if (!ctx) {
+        return AMVP_NO_CTX;
+    }
+    if (!total) {
+        return AMVP_MISSING_ARG;
+    }
+    memzero_s(total, sizeof(AMVP_WORKLOAD_ESTIMATE));
+    if (!ctx->caps_list && !ctx->registration) {
+        AMVP_LOG_ERR("No capabilities registered, nothing to estimate");
+        return AMVP_NO_DATA;
+    }
+
+    rv = amvp_get_registration(ctx, &reg);
+    if (rv != AMVP_SUCCESS) {
+        AMVP_LOG_ERR("Unable to build the registration to estimate");
+        return rv;
+    }
+    entries = json_value_get_array(reg);
+    count = entries ? (int)json_array_get_count(entries) : 0;
+    if (!count) {
+        AMVP_LOG_ERR("No capabilities registered, nothing to estimate");
+        return AMVP_NO_DATA;
+    }
+
+    w = amvp_workload_get(ctx);
+    sets = calloc(count, sizeof(AMVP_WORKLOAD_ESTIMATE));
+    if (!w || !sets) {
+        if (sets) free(sets);
+        return AMVP_MALLOC_FAIL;
+    }
+    for (i = 0; i < count; i++) {
+        if (!json_array_get_object(entries, i)) {
+            continue;
+        }
+        amvp_workload_entry(ctx, json_array_get_object(entries, i), &sets[i]);
+        amvp_workload_add(total, &sets[i]);
+        AMVP_LOG_VERBOSE("Estimate for %s: %llu test cases, %llu request bytes, %llu response bytes, %.1fs",
+                         sets[i].algorithm, sets[i].test_cases, sets[i].request_bytes,
+                         sets[i].response_bytes, sets[i].cpu_secs);
+    }
+
+    if (w->sets) free(w->sets);
+    w->sets = sets;
+    w->count = count;
+    return AMVP_SUCCESS;
+}
+
+AMVP_RESULT amvp_get_workload_estimate(AMVP_CTX *ctx, int index, AMVP_WORKLOAD_ESTIMATE *estimate) {
+    if (!ctx) {
+        return AMVP_NO_CTX;
+    }
+    if (!estimate || index < 0) {
+        return AMVP_INVALID_ARG;
+    }
+    if (!ctx->workload || index >= ctx->workload->count) {
+        return AMVP_NO_DATA;
+    }
+    *estimate = ctx->workload->sets[index];
+    return AMVP_SUCCESS;
+}
+
+/*
+ * The server sends one vector set per registration entry, in the order of
+ * the registration, so when the counts agree the estimates line up with
+ * the vector set URLs.
+ */
+AMVP_RESULT amvp_workload_vs_costs(AMVP_CTX *ctx, int count, double *costs) {
+    AMVP_WORKLOAD_ESTIMATE total;
+    AMVP_RESULT rv = AMVP_SUCCESS;
+    int i;
+
+    if (!ctx) {
+        return AMVP_NO_CTX;
+    }
+    if (!costs || count < 1) {
+        return AMVP_MISSING_ARG;
+    }
+    if (!ctx->caps_list && !ctx->registration) {
+        return AMVP_NO_DATA;
+    }
+    rv = amvp_estimate_workload(ctx, &total);
+    if (rv != AMVP_SUCCESS) {
+        return rv;
+    }
+    if (ctx->workload->count != count) {
+        AMVP_LOG_WARN("Got %d vector sets for %d registration entries, unable to match their costs",
+                      count, ctx->workload->count);
+        return AMVP_NO_DATA;
+    }
+    for (i = 0; i < count; i++) {
+        costs[i] = ctx->workload->sets[i].cpu_secs;
+    }
+    return AMVP_SUCCESS;
+}
+
+void amvp_workload_free(AMVP_CTX *ctx) {
+    AMVP_WORKLOAD_MODEL_REC *rec = NULL, *next = NULL;
+
+    if (!ctx || !ctx->workload) {
+        return;
+    }
+    for (rec = ctx->workload->models; rec; rec = next) {
+        next = rec->next;
+        free(rec);
+    }
+    if (ctx->workload->sets) free(ctx->workload->sets);
+    free(ctx->workload);
+    ctx->workload = NULL;
+}
@@ -0,0 +1,402 @@
+/** @file */
+/*
+ * Copyright (c) 2021, Cisco Systems, Inc.
+ *
+ * Licensed under the Apache License 2.0 (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://github.com/cisco/libamvp/LICENSE
+ */
+
+/*
+ * Evidence for the automated TEs of an IE set, looked up by TE id when
+ * amvp_dispatch_ie_set() builds the response.
+ *
+ * The store is a hash table keyed by TE id, filled by
+ * amvp_set_evidence_store() from a mapping file and by amvp_add_evidence()
+ * and amvp_add_evidence_file(). An entry is either a string sent as is, or
+ * the path of an artifact (a PDF, a log) that is base64 encoded into
+ * ctx->kat_writer a chunk at a time as it is read. The writer spills to its
+ * temp file as it goes, and the upload is sent from there, so an artifact
+ * is never held in memory as a whole. See amvp_jw_base64_file().
+ *
+ * Without a store the built in example entries below are used.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "amvp.h"
+#include "amvp_lcl.h"
+#include "parson.h"
+#include "safe_lib.h"
+
+#define AMVP_EVIDENCE_INIT_SLOTS 64
+
+typedef struct amvp_evidence_entry_t {
+    char *te_id;                /* NULL for an empty slot */
+    char *evidence;             /* String to send, or path of the file to encode */
+    int is_file;
+} AMVP_EVIDENCE_ENTRY;
+
+/* Open addressed with linear probing, slot_cnt is a power of 2 */
+struct amvp_evidence_store_t {
+    AMVP_EVIDENCE_ENTRY *slots;
+    size_t slot_cnt;
+    size_t count;
+};
+
+static const struct {
+    const char *te_id;
+    const char *evidence;
+} amvp_evidence_builtin[] = {
+    {"TE02.20.01", "/acvp/v1/validations/41763"},
+    {"TE02.20.02", "none"},
+    {"TE11.16.01", "Version X.Y.Z of the module meets the assertion" },
+    {"TE04.11.01", "<BASE64(table of services.pdf) compliant with SP800-140Br>" },
+    {"TE04.11.02", "/wwwin.cisco.com/cryptomod/log_te041102_04172023.txt" },
+    {"TE10.10.01", "Degraded mode not supported, no algorithms can be used...goes directly into SP." },
+    {"TE10.10.02", "/wwwin.cisco.com/cryptomod/log_te041102_04172023.txt" },
+    {"TE11.08.01", "/wwwin.cisco.com/cryptomod/FSM.pdf" },
+    {"TE11.08.02", "See TE11.08.01"}
+};
+
+/* FNV-1a */
+static size_t amvp_evidence_hash(const char *te_id) {
+    unsigned int h = 2166136261u;
+
+    while (*te_id) {
+        h ^= (unsigned char)*te_id++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static char *amvp_evidence_strdup(const char *str, size_t len) {
+    char *copy = calloc(len + 1, sizeof(char));
+
+    if (copy) {
+        memcpy_s(copy, len + 1, str, len);
+    }
+    return copy;
+}
+
+static void amvp_evidence_store_free(AMVP_EVIDENCE_STORE *store) {
+    size_t i;
+
+    if (!store) {
+        return;
+    }
+    for (i = 0; i < store->slot_cnt; i++) {
+        if (store->slots[i].te_id) free(store->slots[i].te_id);
+        if (store->slots[i].evidence) free(store->slots[i].evidence);
+    }
+    if (store->slots) free(store->slots);
+    free(store);
+}
+
+/*
+ * Returns the slot for te_id: the entry if it is there, otherwise the empty
+ * slot it would go in. The table always has an empty slot.
+ */
+static AMVP_EVIDENCE_ENTRY *amvp_evidence_slot(AMVP_EVIDENCE_STORE *store, const char *te_id) {
+    size_t mask = store->slot_cnt - 1;
+    size_t i = amvp_evidence_hash(te_id) & mask;
+    int diff = 1;
+
+    while (store->slots[i].te_id) {
+        strcmp_s(store->slots[i].te_id, AMVP_EVIDENCE_TE_ID_MAX, te_id, &diff);
+        if (!diff) {
+            break;
+        }
+        i = (i + 1) & mask;
+    }
+    return &store->slots[i];
+}
+
+static AMVP_RESULT amvp_evidence_grow(AMVP_EVIDENCE_STORE *store) {
+    AMVP_EVIDENCE_ENTRY *old = store->slots, *slot = NULL;
+    size_t old_cnt = store->slot_cnt, i;
+    size_t slot_cnt = old_cnt ? old_cnt * 2 : AMVP_EVIDENCE_INIT_SLOTS;
+
+    store->slots = calloc(slot_cnt, sizeof(AMVP_EVIDENCE_ENTRY));
+    if (!store->slots) {
+        store->slots = old;
+        return AMVP_MALLOC_FAIL;
+    }
+    store->slot_cnt = slot_cnt;
+    for (i = 0; i < old_cnt; i++) {
+        if (old[i].te_id) {
+            slot = amvp_evidence_slot(store, old[i].te_id);
+            *slot = old[i];
+        }
+    }
+    if (old) free(old);
+    return AMVP_SUCCESS;
+}
+
+/*
+ * Adds evidence for te_id, replacing any it already has
+ */
+static AMVP_RESULT amvp_evidence_put(AMVP_CTX *ctx, AMVP_EVIDENCE_STORE *store, const char *te_id,
+                                     const char *evidence, size_t evidence_len, int is_file) {
+    AMVP_EVIDENCE_ENTRY *slot = NULL;
+    char *copy = NULL;
+    size_t id_len = strnlen_s(te_id, AMVP_EVIDENCE_TE_ID_MAX + 1);
+
+    if (!id_len || id_len > AMVP_EVIDENCE_TE_ID_MAX) {
+        AMVP_LOG_ERR("TE id must be 1 to %d characters", AMVP_EVIDENCE_TE_ID_MAX);
+        return AMVP_INVALID_ARG;
+    }
+    /* Keep the load under 3/4 */
+    if ((store->count + 1) * 4 > store->slot_cnt * 3 && amvp_evidence_grow(store) != AMVP_SUCCESS) {
+        return AMVP_MALLOC_FAIL;
+    }
+
+    copy = amvp_evidence_strdup(evidence, evidence_len);
+    if (!copy) {
+        return AMVP_MALLOC_FAIL;
+    }
+    slot = amvp_evidence_slot(store, te_id);
+    if (slot->te_id) {
+        free(slot->evidence);
+    } else {
+        slot->te_id = amvp_evidence_strdup(te_id, id_len);
+        if (!slot->te_id) {
+            free(copy);
+            return AMVP_MALLOC_FAIL;
+        }
+        store->count++;
+    }
+    slot->evidence = copy;
+    slot->is_file = is_file;
+    return AMVP_SUCCESS;
+}
+
+static AMVP_EVIDENCE_STORE *amvp_evidence_store_get(AMVP_CTX *ctx) {
+    if (!ctx->evidence) {
+        ctx->evidence = calloc(1, sizeof(AMVP_EVIDENCE_STORE));
+        if (ctx->evidence && amvp_evidence_grow(ctx->evidence) != AMVP_SUCCESS) {
+            free(ctx->evidence);
+            ctx->evidence = NULL;
+        }
+    }
+    return ctx->evidence;
+}
+
+/*
+ * Resolves a file named in the mapping file against the mapping file's
+ * directory, unless it is absolute
+ */
+static AMVP_RESULT amvp_evidence_path(const char *store_file, const char *file, char *path) {
+    size_t dir_len = 0, i;
+    int written = 0;
+
+    if (file[0] == '/' || file[0] == '\\' || (file[0] && file[1] == ':')) {
+        written = snprintf(path, AMVP_EVIDENCE_PATH_MAX + 1, "%s", file);
+    } else {
+        for (i = 0; store_file[i]; i++) {
+            if (store_file[i] == '/' || store_file[i] == '\\') {
+                dir_len = i + 1;
+            }
+        }
+        written = snprintf(path, AMVP_EVIDENCE_PATH_MAX + 1, "%.*s%s", (int)dir_len, store_file, file);
+    }
+    if (written < 0 || written > AMVP_EVIDENCE_PATH_MAX) {
+        return AMVP_INVALID_ARG;
+    }
+    return AMVP_SUCCESS;
+}
+
+static AMVP_RESULT amvp_evidence_load(AMVP_CTX *ctx, AMVP_EVIDENCE_STORE *store, const char *store_file) {
+    AMVP_RESULT rv = AMVP_SUCCESS;
+    JSON_Value *val = NULL, *ev_val = NULL;
+    JSON_Object *obj = NULL;
+    const char *te_id = NULL, *ev_str = NULL, *file = NULL;
+    char *path = NULL;
+    size_t i, cnt;
+
+    val = json_parse_file(store_file);
+    obj = json_value_get_object(val);
+    if (!obj) {
+        AMVP_LOG_ERR("Evidence store %s is missing or is not a JSON object", store_file);
+        rv = AMVP_JSON_ERR;
+        goto end;
+    }
+    path = calloc(AMVP_EVIDENCE_PATH_MAX + 1, sizeof(char));
+    if (!path) {
+        rv = AMVP_MALLOC_FAIL;
+        goto end;
+    }
+
+    cnt = json_object_get_count(obj);
+    for (i = 0; i < cnt; i++) {
+        te_id = json_object_get_name(obj, i);
+        ev_val = json_object_get_value_at(obj, i);
+        ev_str = json_value_get_string(ev_val);
+        if (ev_str) {
+            rv = amvp_evidence_put(ctx, store, te_id, ev_str,
+                                   strnlen_s(ev_str, AMVP_EVIDENCE_STR_MAX), 0);
+        } else {
+            file = json_object_get_string(json_value_get_object(ev_val), "file");
+            if (!file) {
+                AMVP_LOG_ERR("Evidence for %s in %s must be a string or {\"file\": path}", te_id, store_file);
+                rv = AMVP_JSON_ERR;
+                goto end;
+            }
+            rv = amvp_evidence_path(store_file, file, path);
+            if (rv != AMVP_SUCCESS) {
+                AMVP_LOG_ERR("Evidence file path for %s longer than max(%d)", te_id, AMVP_EVIDENCE_PATH_MAX);
+                goto end;
+            }
+            rv = amvp_evidence_put(ctx, store, te_id, path, strnlen_s(path, AMVP_EVIDENCE_PATH_MAX), 1);
+        }
+        if (rv != AMVP_SUCCESS) {
+            goto end;
+        }
+    }
+
+end:
+    if (path) free(path);
+    if (val) json_value_free(val);
+    return rv;
+}
+
+AMVP_RESULT amvp_set_evidence_store(AMVP_CTX *ctx, const char *store_file) {
+    AMVP_EVIDENCE_STORE *store = NULL;
+    AMVP_RESULT rv = AMVP_SUCCESS;
+
+    if (!ctx) {
+        return AMVP_NO_CTX;
+    }
+    if (!store_file) {
+        amvp_evidence_free(ctx);
+        return AMVP_SUCCESS;
+    }
+    if (strnlen_s(store_file, AMVP_EVIDENCE_PATH_MAX + 1) > AMVP_EVIDENCE_PATH_MAX) {
+        AMVP_LOG_ERR("Provided store_file length > max(%d)", AMVP_EVIDENCE_PATH_MAX);
+        return AMVP_INVALID_ARG;
+    }
+
+    /* Loaded on the side, so a bad file leaves the current store as it was */
+    store = calloc(1, sizeof(AMVP_EVIDENCE_STORE));
+    if (!store) {
+        return AMVP_MALLOC_FAIL;
+    }
+    rv = amvp_evidence_grow(store);
+    if (rv == AMVP_SUCCESS) {
+        rv = amvp_evidence_load(ctx, store, store_file);
+    }
+    if (rv != AMVP_SUCCESS) {
+        amvp_evidence_store_free(store);
+        return rv;
+    }
+    amvp_evidence_free(ctx);
+    ctx->evidence = store;
+    AMVP_LOG_INFO("Loaded evidence for %d TEs from %s", (int)store->count, store_file);
+    return AMVP_SUCCESS;
+}
+
+AMVP_RESULT amvp_add_evidence(AMVP_CTX *ctx, const char *te_id, const char *evidence) {
+    AMVP_EVIDENCE_STORE *store = NULL;
+    size_t len;
+
+    if (!ctx) {
+        return AMVP_NO_CTX;
+    }
+    if (!te_id || !evidence) {
+        return AMVP_MISSING_ARG;
+    }
+    len = strnlen_s(evidence, AMVP_EVIDENCE_STR_MAX + 1);
+    if (len > AMVP_EVIDENCE_STR_MAX) {
+        AMVP_LOG_ERR("Evidence for %s longer than max(%d), use amvp_add_evidence_file()",
+                     te_id, AMVP_EVIDENCE_STR_MAX);
+        return AMVP_INVALID_ARG;
+    }
+    store = amvp_evidence_store_get(ctx);
+    if (!store) {
+        return AMVP_MALLOC_FAIL;
+    }
+    return amvp_evidence_put(ctx, store, te_id, evidence, len, 0);
+}
+
+AMVP_RESULT amvp_add_evidence_file(AMVP_CTX *ctx, const char *te_id, const char *path) {
+    AMVP_EVIDENCE_STORE *store = NULL;
+    size_t len;
+
+    if (!ctx) {
+        return AMVP_NO_CTX;
+    }
+    if (!te_id || !path) {
+        return AMVP_MISSING_ARG;
+    }
+    len = strnlen_s(path, AMVP_EVIDENCE_PATH_MAX + 1);
+    if (!len || len > AMVP_EVIDENCE_PATH_MAX) {
+        AMVP_LOG_ERR("Evidence file path for %s must be 1 to %d characters", te_id, AMVP_EVIDENCE_PATH_MAX);
+        return AMVP_INVALID_ARG;
+    }
+    store = amvp_evidence_store_get(ctx);
+    if (!store) {
+        return AMVP_MALLOC_FAIL;
+    }
+    return amvp_evidence_put(ctx, store, te_id, path, len, 1);
+}
+
+/*
+ * Writes {te_id: evidence} to the IE set response in ctx->kat_writer, with
+ * a file's contents base64 encoded as they are read. Returns AMVP_NO_DATA,
+ * having written nothing, if there is no evidence for te_id, i.e. the TE
+ * isn't automated.
+ */
+AMVP_RESULT amvp_evidence_write(AMVP_CTX *ctx, const char *te_id) {
+    AMVP_JSON_WRITER *w = &ctx->kat_writer;
+    AMVP_EVIDENCE_ENTRY *entry = NULL;
+    AMVP_RESULT rv = AMVP_SUCCESS;
+    FILE *fp = NULL;
+    size_t i;
+    int diff = 1;
+
+    if (!ctx->evidence) {
+        for (i = 0; i < sizeof(amvp_evidence_builtin) / sizeof(amvp_evidence_builtin[0]); i++) {
+            strcmp_s(amvp_evidence_builtin[i].te_id, AMVP_EVIDENCE_TE_ID_MAX, te_id, &diff);
+            if (!diff) {
+                amvp_jw_begin_object(w, NULL);
+                amvp_jw_string(w, te_id, amvp_evidence_builtin[i].evidence);
+                return amvp_jw_end_object(w);
+            }
+        }
+        return AMVP_NO_DATA;
+    }
+
+    entry = amvp_evidence_slot(ctx->evidence, te_id);
+    if (!entry->te_id) {
+        return AMVP_NO_DATA;
+    }
+    if (!entry->is_file) {
+        amvp_jw_begin_object(w, NULL);
+        amvp_jw_string(w, te_id, entry->evidence);
+        return amvp_jw_end_object(w);
+    }
+
+    fp = fopen(entry->evidence, "rb");
+    if (!fp) {
+        AMVP_LOG_ERR("Unable to open evidence file %s for %s", entry->evidence, te_id);
+        return AMVP_INVALID_ARG;
+    }
+    amvp_jw_begin_object(w, NULL);
+    rv = amvp_jw_base64_file(w, te_id, fp);
+    fclose(fp);
+    if (rv != AMVP_SUCCESS) {
+        AMVP_LOG_ERR("Failed to encode evidence file %s for %s", entry->evidence, te_id);
+        return rv;
+    }
+    return amvp_jw_end_object(w);
+}
+
+void amvp_evidence_free(AMVP_CTX *ctx) {
+    if (!ctx || !ctx->evidence) {
+        return;
+    }
+    amvp_evidence_store_free(ctx->evidence);
+    ctx->evidence = NULL;
+}
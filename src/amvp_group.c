@@ -0,0 +1,349 @@
+/** @file */
+/*
+ * Copyright (c) 2021, Cisco Systems, Inc.
+ *
+ * Licensed under the Apache License 2.0 (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://github.com/cisco/libamvp/LICENSE
+ */
+
+/*
+ * Session groups let an application validating many modules at once share
+ * the per-process transport state between their contexts: curl is
+ * initialized once, the connection, DNS and TLS session caches live in one
+ * curl share object guarded by locks, and the HTTP user-agent is probed
+ * once. amvp_session_group_run() then runs amvp_run() for every attached
+ * context on the group's threads.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+#ifndef AMVP_OFFLINE
+#ifdef USE_MURL
+#include "../murl/murl.h"
+#else
+#include <curl/curl.h>
+#endif
+#endif
+
+#include "amvp.h"
+#include "amvp_lcl.h"
+#include "safe_lib.h"
+
+#define AMVP_GROUP_CTX_ALLOC 8
+
+struct amvp_session_group_t {
+    int threads;                /* Sessions run at once by amvp_session_group_run() */
+    AMVP_CTX **ctxs;            /* Attached contexts, in attach order */
+    int count;
+    int size;
+    char *http_user_agent;      /* Copied to each context that doesn't have one */
+    int curl_init;              /* curl_global_init() succeeded, so cleanup is owed */
+#if !defined AMVP_OFFLINE && !defined USE_MURL
+    CURLSH *share;
+#ifndef _WIN32
+    pthread_mutex_t share_locks[CURL_LOCK_DATA_LAST];
+#endif
+#endif
+
+#ifndef _WIN32
+    pthread_mutex_t lock;       /* Guards ctxs, count and next */
+#endif
+
+    /* State of the current amvp_session_group_run() */
+    int next;                   /* Index of the next context to run */
+    int fips_validation;
+    AMVP_RESULT *results;
+};
+
+#if !defined AMVP_OFFLINE && !defined USE_MURL && !defined _WIN32
+/* Contexts on different threads use the share at the same time */
+static void amvp_group_share_lock(CURL *hnd, curl_lock_data data, curl_lock_access access, void *userptr) {
+    AMVP_SESSION_GROUP *group = userptr;
+
+    (void)hnd;
+    (void)access;
+    pthread_mutex_lock(&group->share_locks[data]);
+}
+
+static void amvp_group_share_unlock(CURL *hnd, curl_lock_data data, void *userptr) {
+    AMVP_SESSION_GROUP *group = userptr;
+
+    (void)hnd;
+    pthread_mutex_unlock(&group->share_locks[data]);
+}
+#endif
+
+AMVP_RESULT amvp_session_group_create(AMVP_SESSION_GROUP **group, int threads) {
+    AMVP_SESSION_GROUP *g = NULL;
+#if !defined AMVP_OFFLINE && !defined USE_MURL && !defined _WIN32
+    int i;
+#endif
+
+    if (!group) {
+        return AMVP_INVALID_ARG;
+    }
+    if (*group) {
+        return AMVP_CTX_NOT_EMPTY;
+    }
+    if (threads < 1 || threads > AMVP_MAX_WORKER_THREADS) {
+        return AMVP_INVALID_ARG;
+    }
+
+    g = calloc(1, sizeof(AMVP_SESSION_GROUP));
+    if (!g) {
+        return AMVP_MALLOC_FAIL;
+    }
+    g->threads = threads;
+#ifndef _WIN32
+    pthread_mutex_init(&g->lock, NULL);
+#endif
+
+#ifndef AMVP_OFFLINE
+    /* Done up front, since it isn't safe once sessions run on several threads */
+    if (curl_global_init(CURL_GLOBAL_DEFAULT)) {
+        amvp_session_group_free(g);
+        return AMVP_TRANSPORT_FAIL;
+    }
+    g->curl_init = 1;
+#ifndef USE_MURL
+    g->share = curl_share_init();
+    if (!g->share) {
+        amvp_session_group_free(g);
+        return AMVP_TRANSPORT_FAIL;
+    }
+    curl_share_setopt(g->share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+    curl_share_setopt(g->share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+    curl_share_setopt(g->share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+#ifndef _WIN32
+    for (i = 0; i < CURL_LOCK_DATA_LAST; i++) {
+        pthread_mutex_init(&g->share_locks[i], NULL);
+    }
+    curl_share_setopt(g->share, CURLSHOPT_LOCKFUNC, amvp_group_share_lock);
+    curl_share_setopt(g->share, CURLSHOPT_UNLOCKFUNC, amvp_group_share_unlock);
+    curl_share_setopt(g->share, CURLSHOPT_USERDATA, g);
+#endif
+#endif
+#endif
+
+    *group = g;
+    return AMVP_SUCCESS;
+}
+
+AMVP_RESULT amvp_session_group_attach(AMVP_SESSION_GROUP *group, AMVP_CTX *ctx) {
+    AMVP_CTX **tmp = NULL;
+
+    if (!group) {
+        return AMVP_INVALID_ARG;
+    }
+    if (!ctx) {
+        return AMVP_NO_CTX;
+    }
+    if (ctx->session_group) {
+        AMVP_LOG_ERR("Context is already part of a session group");
+        return AMVP_UNSUPPORTED_OP;
+    }
+
+    /* The first context to need a user-agent string probes for it, the rest copy it */
+    if (!group->http_user_agent) {
+        if (!ctx->http_user_agent) {
+            amvp_http_user_agent_handler(ctx);
+        }
+        if (ctx->http_user_agent) {
+            group->http_user_agent = strdup(ctx->http_user_agent);
+        }
+    } else if (!ctx->http_user_agent) {
+        ctx->http_user_agent = strdup(group->http_user_agent);
+    }
+
+    /* Drop any caches the context built up on its own */
+    amvp_transport_cleanup(ctx);
+#if !defined AMVP_OFFLINE && !defined USE_MURL
+    ctx->curl_share = group->share;
+#endif
+
+#ifndef _WIN32
+    pthread_mutex_lock(&group->lock);
+#endif
+    if (group->count == group->size) {
+        tmp = realloc(group->ctxs, (group->size + AMVP_GROUP_CTX_ALLOC) * sizeof(AMVP_CTX *));
+        if (!tmp) {
+#ifndef _WIN32
+            pthread_mutex_unlock(&group->lock);
+#endif
+            return AMVP_MALLOC_FAIL;
+        }
+        group->ctxs = tmp;
+        group->size += AMVP_GROUP_CTX_ALLOC;
+    }
+    ctx->session_group = group;
+    group->ctxs[group->count++] = ctx;
+#ifndef _WIN32
+    pthread_mutex_unlock(&group->lock);
+#endif
+    return AMVP_SUCCESS;
+}
+
+/*
+ * Takes ctx out of its group. Its curl handle is released here, while the
+ * group's share object it was set up with is still around.
+ */
+void amvp_session_group_detach(AMVP_CTX *ctx) {
+    AMVP_SESSION_GROUP *group = NULL;
+    int i;
+
+    if (!ctx || !ctx->session_group) {
+        return;
+    }
+    group = ctx->session_group;
+
+#ifndef AMVP_OFFLINE
+    if (ctx->curl_hnd) curl_easy_cleanup(ctx->curl_hnd);
+#endif
+    ctx->curl_hnd = NULL;
+    ctx->curl_share = NULL;
+    ctx->session_group = NULL;
+
+#ifndef _WIN32
+    pthread_mutex_lock(&group->lock);
+#endif
+    for (i = 0; i < group->count; i++) {
+        if (group->ctxs[i] == ctx) {
+            memmove(&group->ctxs[i], &group->ctxs[i + 1], (group->count - i - 1) * sizeof(AMVP_CTX *));
+            group->count--;
+            break;
+        }
+    }
+#ifndef _WIN32
+    pthread_mutex_unlock(&group->lock);
+#endif
+}
+
+/*
+ * Runs the next context that hasn't been started until there are none left
+ */
+static void *amvp_group_worker(void *arg) {
+    AMVP_SESSION_GROUP *group = arg;
+    AMVP_CTX *ctx = NULL;
+    int idx = 0;
+
+    while (1) {
+#ifndef _WIN32
+        pthread_mutex_lock(&group->lock);
+#endif
+        idx = group->next++;
+        ctx = idx < group->count ? group->ctxs[idx] : NULL;
+#ifndef _WIN32
+        pthread_mutex_unlock(&group->lock);
+#endif
+        if (!ctx) {
+            break;
+        }
+        group->results[idx] = amvp_run(ctx, group->fips_validation);
+    }
+    return NULL;
+}
+
+AMVP_RESULT amvp_session_group_run(AMVP_SESSION_GROUP *group, int fips_validation, AMVP_RESULT *results) {
+    AMVP_RESULT rv = AMVP_SUCCESS;
+#ifndef _WIN32
+    pthread_t *tids = NULL;
+    int started = 0;
+#endif
+    int i;
+
+    if (!group) {
+        return AMVP_INVALID_ARG;
+    }
+    if (!group->count) {
+        return AMVP_MISSING_ARG;
+    }
+
+    group->results = calloc(group->count, sizeof(AMVP_RESULT));
+    if (!group->results) {
+        return AMVP_MALLOC_FAIL;
+    }
+    group->next = 0;
+    group->fips_validation = fips_validation;
+
+#ifndef _WIN32
+    /* The calling thread runs sessions too */
+    if (group->threads > 1 && group->count > 1) {
+        int extra = group->threads - 1 < group->count - 1 ? group->threads - 1 : group->count - 1;
+
+        tids = calloc(extra, sizeof(pthread_t));
+        if (!tids) {
+            rv = AMVP_MALLOC_FAIL;
+            goto end;
+        }
+        for (started = 0; started < extra; started++) {
+            if (pthread_create(&tids[started], NULL, amvp_group_worker, group)) {
+                break;
+            }
+        }
+    }
+#endif
+
+    amvp_group_worker(group);
+
+#ifndef _WIN32
+    for (i = 0; i < started; i++) {
+        pthread_join(tids[i], NULL);
+    }
+#endif
+
+    for (i = 0; i < group->count; i++) {
+        if (results) {
+            results[i] = group->results[i];
+        }
+        if (rv == AMVP_SUCCESS) {
+            rv = group->results[i];
+        }
+    }
+
+#ifndef _WIN32
+end:
+    if (tids) free(tids);
+#endif
+    free(group->results);
+    group->results = NULL;
+    return rv;
+}
+
+AMVP_RESULT amvp_session_group_free(AMVP_SESSION_GROUP *group) {
+#if !defined AMVP_OFFLINE && !defined USE_MURL && !defined _WIN32
+    int i;
+#endif
+
+    if (!group) {
+        return AMVP_SUCCESS;
+    }
+    while (group->count) {
+        amvp_session_group_detach(group->ctxs[0]);
+    }
+#ifndef AMVP_OFFLINE
+#ifndef USE_MURL
+    if (group->share) {
+        curl_share_cleanup(group->share);
+#ifndef _WIN32
+        for (i = 0; i < CURL_LOCK_DATA_LAST; i++) {
+            pthread_mutex_destroy(&group->share_locks[i]);
+        }
+#endif
+    }
+#endif
+    if (group->curl_init) curl_global_cleanup();
+#endif
+#ifndef _WIN32
+    pthread_mutex_destroy(&group->lock);
+#endif
+    if (group->http_user_agent) free(group->http_user_agent);
+    if (group->ctxs) free(group->ctxs);
+    free(group);
+    return AMVP_SUCCESS;
+}
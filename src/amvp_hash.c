@@ -23,14 +23,14 @@
 /*
  * Forward prototypes for local functions
  */
-static AMVP_RESULT amvp_hash_output_tc(AMVP_CTX *ctx, AMVP_HASH_TC *stc, JSON_Object *tc_rsp);
+static AMVP_RESULT amvp_hash_output_tc(AMVP_CTX *ctx, AMVP_HASH_TC *stc, AMVP_JSON_WRITER *w);
 
 static AMVP_RESULT amvp_hash_init_tc(AMVP_CTX *ctx,
                                      AMVP_HASH_TC *stc,
                                      unsigned int tc_id,
                                      AMVP_HASH_TESTTYPE test_type,
                                      unsigned int msg_len,
-                                     const char *msg,
+                                     AMVP_STR_VIEW msg,
                                      unsigned int xof_len,
                                      AMVP_CIPHER alg_id);
 
@@ -60,34 +60,21 @@ static AMVP_RESULT amvp_hash_mct_iterate_tc(AMVP_HASH_TC *stc) {
  * the JSON processing for a single test case for MCT.
  */
 static AMVP_RESULT amvp_hash_output_mct_tc(AMVP_CTX *ctx, AMVP_HASH_TC *stc, JSON_Object *r_tobj) {
+    unsigned int md_str_max = AMVP_HASH_MD_STR_MAX;
     AMVP_RESULT rv = AMVP_SUCCESS;
-    char *tmp = NULL;
 
     if (stc->cipher == AMVP_HASH_SHAKE_128 || stc->cipher == AMVP_HASH_SHAKE_256) {
-        tmp = calloc(AMVP_HASH_XOF_MD_STR_MAX + 1, sizeof(char));
-    } else {
-        tmp = calloc(AMVP_HASH_MD_STR_MAX + 1, sizeof(char));
+        md_str_max = AMVP_HASH_XOF_MD_STR_MAX;
     }
-    if (!tmp) {
-        AMVP_LOG_ERR("Unable to malloc in amvp_hash_output_tc");
-        return AMVP_MALLOC_FAIL;
+    if (stc->md_len * 2 > md_str_max) {
+        AMVP_LOG_ERR("hex conversion failure (md)");
+        return AMVP_CONVERT_DATA_ERR;
     }
 
-    if (stc->cipher == AMVP_HASH_SHAKE_128 || stc->cipher == AMVP_HASH_SHAKE_256) {
-        rv = amvp_bin_to_hexstr(stc->md, stc->md_len, tmp, AMVP_HASH_XOF_MD_STR_MAX);
-    } else {
-        rv = amvp_bin_to_hexstr(stc->md, stc->md_len, tmp, AMVP_HASH_MD_STR_MAX);
-    }
+    rv = amvp_json_set_hex(r_tobj, "md", stc->md, stc->md_len);
     if (rv != AMVP_SUCCESS) {
         AMVP_LOG_ERR("hex conversion failure (md)");
-        goto end;
     }
-
-    json_object_set_string(r_tobj, "md", tmp);
-
-end:
-    if (tmp) free(tmp);
-
     return rv;
 }
 
@@ -106,31 +93,33 @@ static AMVP_RESULT amvp_hash_mct_tc(AMVP_CTX *ctx,
     AMVP_RESULT rv;
     JSON_Value *r_tval = NULL;  /* Response testval */
     JSON_Object *r_tobj = NULL; /* Response testobj */
-    char *tmp = NULL;
-
-    tmp = calloc(AMVP_HASH_MSG_STR_MAX * 3, sizeof(char));
-    if (!tmp) {
-        AMVP_LOG_ERR("Unable to malloc");
-        return AMVP_MALLOC_FAIL;
-    }
 
     memcpy_s(stc->m1, AMVP_HASH_MD_BYTE_MAX, stc->msg, stc->msg_len);
     memcpy_s(stc->m2, AMVP_HASH_MD_BYTE_MAX, stc->msg, stc->msg_len);
     memcpy_s(stc->m3, AMVP_HASH_MD_BYTE_MAX, stc->msg, stc->msg_len);
 
     for (i = 0; i < AMVP_HASH_MCT_OUTER; ++i) {
+        AMVP_TRACE2(mct__iter, stc->cipher, i);
         /*
          * Create a new test case in the response
          */
         r_tval = json_value_init_object();
         r_tobj = json_value_get_object(r_tval);
 
-        for (j = 0; j < AMVP_HASH_MCT_INNER; ++j) {
+        if (cap->crypto_mct_handler) {
+            /* The module runs the inner loop, the chaining below restarts from its digest */
+            if (amvp_crypto_mct_call(ctx, cap, tc)) {
+                AMVP_LOG_ERR("crypto module failed the operation");
+                json_value_free(r_tval);
+                return AMVP_CRYPTO_MODULE_FAIL;
+            }
+            memcpy_s(stc->m3, AMVP_HASH_MD_BYTE_MAX, stc->md, stc->md_len);
+        }
+        for (j = 0; !cap->crypto_mct_handler && j < AMVP_HASH_MCT_INNER; ++j) {
             /* Process the current SHA test vector... */
-            rv = (cap->crypto_handler)(tc);
+            rv = amvp_crypto_call(ctx, cap, tc);
             if (rv != AMVP_SUCCESS) {
                 AMVP_LOG_ERR("crypto module failed the operation");
-                free(tmp);
                 json_value_free(r_tval);
                 return AMVP_CRYPTO_MODULE_FAIL;
             }
@@ -141,7 +130,6 @@ static AMVP_RESULT amvp_hash_mct_tc(AMVP_CTX *ctx,
             rv = amvp_hash_mct_iterate_tc(stc);
             if (rv != AMVP_SUCCESS) {
                 AMVP_LOG_ERR("Failed the MCT iteration changes");
-                free(tmp);
                 json_value_free(r_tval);
                 return rv;
             }
@@ -152,7 +140,6 @@ static AMVP_RESULT amvp_hash_mct_tc(AMVP_CTX *ctx,
         rv = amvp_hash_output_mct_tc(ctx, stc, r_tobj);
         if (rv != AMVP_SUCCESS) {
             AMVP_LOG_ERR("JSON output failure in HASH module");
-            free(tmp);
             json_value_free(r_tval);
             return rv;
         }
@@ -165,7 +152,6 @@ static AMVP_RESULT amvp_hash_mct_tc(AMVP_CTX *ctx,
 
     }
 
-    free(tmp);
     return AMVP_SUCCESS;
 }
 
@@ -190,17 +176,31 @@ static AMVP_RESULT amvp_hash_sha3_mct(AMVP_CTX *ctx,
      * ***********
      */
     for (j = 0; j < AMVP_HASH_MCT_OUTER; j++) {
+        AMVP_TRACE2(mct__iter, stc->cipher, j);
         /*
          * Create a new test case in the response
          */
         r_tval = json_value_init_object();
         r_tobj = json_value_get_object(r_tval);
 
+        if (cap->crypto_mct_handler) {
+            /* The module runs the inner loop, its last digest seeds the next one */
+            memzero_s(stc->md, AMVP_HASH_MD_BYTE_MAX);
+            if (amvp_crypto_mct_call(ctx, cap, tc)) {
+                AMVP_LOG_ERR("crypto module failed the operation");
+                rv = AMVP_CRYPTO_MODULE_FAIL;
+                goto end;
+            }
+            memzero_s(stc->msg, AMVP_HASH_MSG_BYTE_MAX);
+            memcpy_s(stc->msg, AMVP_HASH_MSG_BYTE_MAX, stc->md, stc->md_len);
+            stc->msg_len = stc->md_len;
+        }
+
         /* ***********
          * INNER LOOP
          * ***********
          */
-        for (i = 0; i <= AMVP_HASH_MCT_INNER; i++) {
+        for (i = 0; !cap->crypto_mct_handler && i <= AMVP_HASH_MCT_INNER; i++) {
             if (i != 0) {
                 /*
                  * Use the MD[i-1] as the new Msg
@@ -224,7 +224,7 @@ static AMVP_RESULT amvp_hash_sha3_mct(AMVP_CTX *ctx,
             memzero_s(stc->md, AMVP_HASH_MD_BYTE_MAX);
 
             /* Process the current SHA test vector... */
-            rv = (cap->crypto_handler)(tc);
+            rv = amvp_crypto_call(ctx, cap, tc);
             if (rv != AMVP_SUCCESS) {
                 AMVP_LOG_ERR("crypto module failed the operation");
                 rv = AMVP_CRYPTO_MODULE_FAIL;
@@ -280,23 +280,40 @@ static AMVP_RESULT amvp_hash_shake_mct(AMVP_CTX *ctx,
     xof_len = (max_xof_bits / 8) * 8;
     /* Convert from bits to bytes */
     stc->xof_len = (xof_len + 7) / 8;
+    stc->xof_min_len = min_xof_bytes;
+    stc->xof_max_len = max_xof_bytes;
 
     /* ***********
      * OUTER LOOP
      * ***********
      */
     for (j = 0; j < AMVP_HASH_MCT_OUTER; j++) {
+        AMVP_TRACE2(mct__iter, stc->cipher, j);
         /*
          * Create a new test case in the response
          */
         r_tval = json_value_init_object();
         r_tobj = json_value_get_object(r_tval);
 
+        if (cap->crypto_mct_handler) {
+            /* The module runs the inner loop and works out the output lengths */
+            stc->msg_len = leftmost_bytes;
+            memzero_s(stc->md, AMVP_HASH_XOF_MD_BYTE_MAX);
+            if (amvp_crypto_mct_call(ctx, cap, tc)) {
+                AMVP_LOG_ERR("crypto module failed the operation");
+                rv = AMVP_CRYPTO_MODULE_FAIL;
+                goto end;
+            }
+            memzero_s(stc->msg, AMVP_SHAKE_MSG_BYTE_MAX);
+            memcpy_s(stc->msg, AMVP_SHAKE_MSG_BYTE_MAX, stc->md,
+                     stc->md_len <= leftmost_bytes ? stc->md_len : leftmost_bytes);
+        }
+
         /* ***********
          * INNER LOOP
          * ***********
          */
-        for (i = 0; i <= AMVP_HASH_MCT_INNER; i++) {
+        for (i = 0; !cap->crypto_mct_handler && i <= AMVP_HASH_MCT_INNER; i++) {
             uint16_t rightmost_out_bits = 0;
 
             if (i != 0) {
@@ -327,7 +344,7 @@ static AMVP_RESULT amvp_hash_shake_mct(AMVP_CTX *ctx,
             memzero_s(stc->md, AMVP_HASH_XOF_MD_BYTE_MAX);
 
             /* Process the current SHA test vector... */
-            rv = (cap->crypto_handler)(tc);
+            rv = amvp_crypto_call(ctx, cap, tc);
             if (rv != AMVP_SUCCESS) {
                 AMVP_LOG_ERR("crypto module failed the operation");
                 rv = AMVP_CRYPTO_MODULE_FAIL;
@@ -364,6 +381,66 @@ end:
     return rv;
 }
 
+/*
+ * Large Data Test. The message is stc->msg repeated out to ldt_len bytes,
+ * which can be several GiB, so it is never built: the pattern is expanded
+ * into one chunk that is a whole number of patterns long, and that chunk is
+ * fed to the module's hash_update until ldt_len bytes have gone in.
+ */
+static AMVP_RESULT amvp_hash_ldt(AMVP_CTX *ctx, AMVP_CAPS_LIST *cap, AMVP_TEST_CASE *tc) {
+    AMVP_HASH_TC *stc = tc->tc.hash;
+    AMVP_VS_METRICS_REC *rec = amvp_metrics_cur(ctx);
+    unsigned long long left = stc->ldt_len;
+    unsigned char *chunk = NULL;
+    unsigned int chunk_len = 0, len = 0, off = 0;
+    void *stream_ctx = NULL;
+    double start = 0;
+    int failed = 0;
+
+    if (!stc->msg_len) {
+        AMVP_LOG_ERR("LDT content pattern is empty");
+        return AMVP_INVALID_ARG;
+    }
+    chunk_len = stc->msg_len;
+    if (chunk_len < AMVP_HASH_LDT_CHUNK_BYTES) {
+        chunk_len = (AMVP_HASH_LDT_CHUNK_BYTES / stc->msg_len) * stc->msg_len;
+    }
+    chunk = malloc(chunk_len);
+    if (!chunk) {
+        return AMVP_MALLOC_FAIL;
+    }
+    for (off = 0; off < chunk_len; off += stc->msg_len) {
+        memcpy_s(chunk + off, chunk_len - off, stc->msg, stc->msg_len);
+    }
+
+    if (rec) start = amvp_metrics_now();
+    if ((cap->hash_init)(tc, &stream_ctx)) {
+        AMVP_LOG_ERR("crypto module failed to start the LDT digest");
+        free(chunk);
+        return AMVP_CRYPTO_MODULE_FAIL;
+    }
+    while (left && !failed) {
+        len = left < chunk_len ? (unsigned int)left : chunk_len;
+        failed = (cap->hash_update)(stream_ctx, chunk, len);
+        left -= len;
+    }
+    /* hash_final releases stream_ctx, so it runs even after a failed update */
+    if ((cap->hash_final)(stream_ctx, tc)) {
+        failed = 1;
+    }
+    if (rec) {
+        rec->m.crypto_ms += amvp_metrics_now() - start;
+        rec->m.crypto_calls++;
+    }
+    free(chunk);
+
+    if (failed) {
+        AMVP_LOG_ERR("crypto module failed the LDT operation");
+        return AMVP_CRYPTO_MODULE_FAIL;
+    }
+    return AMVP_SUCCESS;
+}
+
 static AMVP_HASH_TESTTYPE read_test_type(const char *tt_str) {
     int diff = 0;
 
@@ -382,9 +459,32 @@ static AMVP_HASH_TESTTYPE read_test_type(const char *tt_str) {
         return AMVP_HASH_TEST_TYPE_VOT;
     }
 
+    strcmp_s("LDT", 3, tt_str, &diff);
+    if (!diff) {
+        return AMVP_HASH_TEST_TYPE_LDT;
+    }
+
     return 0;
 }
 
+/*
+ * Release the per test case state of a group. stcs[0..init_cnt) were passed
+ * to amvp_hash_init_tc().
+ */
+static void amvp_hash_release_group(AMVP_HASH_TC *stcs,
+                                    AMVP_TEST_CASE *tcs,
+                                    int init_cnt) {
+    int i;
+
+    if (stcs) {
+        for (i = 0; i < init_cnt; i++) {
+            amvp_hash_release_tc(&stcs[i]);
+        }
+        free(stcs);
+    }
+    if (tcs) { free(tcs); }
+}
+
 AMVP_RESULT amvp_hash_kat_handler(AMVP_CTX *ctx, JSON_Object *obj) {
     unsigned int tc_id, msglen;
     JSON_Value *groupval;
@@ -394,27 +494,22 @@ AMVP_RESULT amvp_hash_kat_handler(AMVP_CTX *ctx, JSON_Object *obj) {
     JSON_Array *groups;
     JSON_Array *tests;
 
-    JSON_Value *reg_arry_val = NULL;
-    JSON_Object *reg_obj = NULL;
-    JSON_Array *reg_arry = NULL;
-
     int i, g_cnt;
-    int j, t_cnt;
+    int j, t_cnt = 0;
 
-    JSON_Value *r_vs_val = NULL;
-    JSON_Object *r_vs = NULL;
-    JSON_Array *r_tarr = NULL, *r_garr = NULL;  /* Response testarray, grouparray */
-    JSON_Value *r_tval = NULL, *r_gval = NULL;  /* Response testval, groupval */
-    JSON_Object *r_tobj = NULL, *r_gobj = NULL; /* Response testobj, groupobj */
+    AMVP_JSON_WRITER *w = NULL;                 /* Response, streamed into ctx->kat_writer */
+    JSON_Value *r_tval = NULL;                  /* Response testval, MCT only */
+    JSON_Object *r_tobj = NULL;                 /* Response testobj, MCT only */
     AMVP_CAPS_LIST *cap;
-    AMVP_HASH_TC stc;
-    AMVP_TEST_CASE tc;
+    AMVP_HASH_TC *stcs = NULL;
+    AMVP_TEST_CASE *tcs = NULL;
+    int tc_init_cnt = 0;
     JSON_Array *res_tarr = NULL; /* Response resultsArray */
     AMVP_RESULT rv = AMVP_SUCCESS;
     AMVP_CIPHER alg_id = 0;
-    char *json_result = NULL;
     const char *alg_str = NULL;
-    const char *test_type_str, *msg = NULL;
+    const char *test_type_str = NULL;
+    AMVP_STR_VIEW msg = { 0 };
 
     if (!ctx) {
         AMVP_LOG_ERR("No ctx for handler operation");
@@ -427,11 +522,6 @@ AMVP_RESULT amvp_hash_kat_handler(AMVP_CTX *ctx, JSON_Object *obj) {
         return AMVP_MALFORMED_JSON;
     }
 
-    /*
-     * Get a reference to the abstracted test case
-     */
-    tc.tc.hash = &stc;
-
     /*
      * Get the crypto module handler for this hash algorithm
      */
@@ -446,22 +536,14 @@ AMVP_RESULT amvp_hash_kat_handler(AMVP_CTX *ctx, JSON_Object *obj) {
         return AMVP_UNSUPPORTED_OP;
     }
 
-    /*
-     * Create AMVP array for response
-     */
-    rv = amvp_create_array(&reg_obj, &reg_arry_val, &reg_arry);
-    if (rv != AMVP_SUCCESS) {
-        AMVP_LOG_ERR("Failed to create JSON response struct. ");
-        return rv;
-    }
-
     /*
      * Start to build the JSON response
      */
-    rv = amvp_setup_json_rsp_group(&ctx, &reg_arry_val, &r_vs_val, &r_vs, alg_str, &r_garr);
+    w = &ctx->kat_writer;
+    rv = amvp_jw_begin_vs_rsp(ctx, alg_str, NULL);
     if (rv != AMVP_SUCCESS) {
         AMVP_LOG_ERR("Failed to setup json response");
-        return rv;
+        goto err;
     }
 
     groups = json_object_get_array(obj, "testGroups");
@@ -478,17 +560,15 @@ AMVP_RESULT amvp_hash_kat_handler(AMVP_CTX *ctx, JSON_Object *obj) {
          * Create a new group in the response with the tgid
          * and an array of tests
          */
-        r_gval = json_value_init_object();
-        r_gobj = json_value_get_object(r_gval);
         tgId = json_object_get_number(groupobj, "tgId");
         if (!tgId) {
             AMVP_LOG_ERR("Missing tgid from server JSON groub obj");
             rv = AMVP_MALFORMED_JSON;
             goto err;
         }
-        json_object_set_number(r_gobj, "tgId", tgId);
-        json_object_set_value(r_gobj, "tests", json_value_init_array());
-        r_tarr = json_object_get_array(r_gobj, "tests");
+        amvp_jw_begin_object(w, NULL);
+        amvp_jw_number(w, "tgId", tgId);
+        amvp_jw_begin_array(w, "tests");
 
         AMVP_LOG_VERBOSE("    Test group: %d", i);
 
@@ -512,6 +592,19 @@ AMVP_RESULT amvp_hash_kat_handler(AMVP_CTX *ctx, JSON_Object *obj) {
             rv = AMVP_INVALID_ARG;
             goto err;
         }
+        if (test_type == AMVP_HASH_TEST_TYPE_LDT) {
+            if (alg_id == AMVP_HASH_SHAKE_128 || alg_id == AMVP_HASH_SHAKE_256) {
+                AMVP_LOG_ERR("Server JSON 'testType' == LDT, not valid for cipher '%s'",
+                             amvp_lookup_cipher_name(alg_id));
+                rv = AMVP_INVALID_ARG;
+                goto err;
+            }
+            if (!cap->hash_init) {
+                AMVP_LOG_ERR("LDT needs the hash stream handlers, see amvp_cap_set_hash_stream_handlers()");
+                rv = AMVP_UNSUPPORTED_OP;
+                goto err;
+            }
+        }
         if (test_type == AMVP_HASH_TEST_TYPE_MCT &&
             (alg_id == AMVP_HASH_SHAKE_128 || alg_id == AMVP_HASH_SHAKE_256)) {
             min_xof_len = json_object_get_number(groupobj, "minOutLen");
@@ -533,10 +626,24 @@ AMVP_RESULT amvp_hash_kat_handler(AMVP_CTX *ctx, JSON_Object *obj) {
         tests = json_object_get_array(groupobj, "tests");
         t_cnt = json_array_get_count(tests);
 
+        /*
+         * Each test case gets its own TC so that, outside of MCT, the
+         * crypto calls for the whole group can be made at once
+         */
+        if (t_cnt > 0) {
+            stcs = calloc(t_cnt, sizeof(AMVP_HASH_TC));
+            tcs = calloc(t_cnt, sizeof(AMVP_TEST_CASE));
+            if (!stcs || !tcs) {
+                rv = AMVP_MALLOC_FAIL;
+                goto err;
+            }
+        }
+
         for (j = 0; j < t_cnt; j++) {
-            unsigned int tmp_msg_len = 0;
             unsigned int xof_len = 0;
             unsigned int max_len = 0;
+            unsigned long long ldt_bits = 0;
+            JSON_Object *ldtobj = NULL;
 
             AMVP_LOG_VERBOSE("Found new hash test vector...");
             testval = json_array_get_value(tests, j);
@@ -544,8 +651,43 @@ AMVP_RESULT amvp_hash_kat_handler(AMVP_CTX *ctx, JSON_Object *obj) {
 
             tc_id = json_object_get_number(testobj, "tcId");
 
-            msg = json_object_get_string(testobj, "msg");
-            if (!msg) {
+            if (test_type == AMVP_HASH_TEST_TYPE_LDT) {
+                const char *technique = NULL;
+                int diff = 1;
+
+                /* The content pattern stands in for msg */
+                ldtobj = json_object_get_object(testobj, "largeMsg");
+                if (!ldtobj) {
+                    AMVP_LOG_ERR("Server JSON missing 'largeMsg'");
+                    rv = AMVP_MISSING_ARG;
+                    goto err;
+                }
+                technique = json_object_get_string(ldtobj, "expansionTechnique");
+                if (technique) {
+                    strcmp_s("repeating", sizeof("repeating") - 1, technique, &diff);
+                }
+                if (diff) {
+                    AMVP_LOG_ERR("Server JSON invalid 'expansionTechnique'");
+                    rv = AMVP_INVALID_ARG;
+                    goto err;
+                }
+                ldt_bits = (unsigned long long)json_object_get_number(ldtobj, "fullLength");
+                if (!ldt_bits || ldt_bits % 8 || ldt_bits > AMVP_HASH_LDT_BIT_MAX) {
+                    AMVP_LOG_ERR("Server JSON invalid 'fullLength'");
+                    rv = AMVP_INVALID_ARG;
+                    goto err;
+                }
+                msg = amvp_json_view(ldtobj, "content");
+                if (msg.str &&
+                    (unsigned int)json_object_get_number(ldtobj, "contentLength") != msg.len * 4) {
+                    AMVP_LOG_ERR("Server JSON 'contentLength' does not match 'content'");
+                    rv = AMVP_INVALID_ARG;
+                    goto err;
+                }
+            } else {
+                msg = amvp_json_view(testobj, "msg");
+            }
+            if (!msg.str) {
                 AMVP_LOG_ERR("Server JSON missing 'msg'");
                 rv = AMVP_MISSING_ARG;
                 goto err;
@@ -555,14 +697,13 @@ AMVP_RESULT amvp_hash_kat_handler(AMVP_CTX *ctx, JSON_Object *obj) {
             } else {
                 max_len = AMVP_SHAKE_MSG_STR_MAX;
             }
-            tmp_msg_len = strnlen_s(msg, max_len + 1);
-            if (tmp_msg_len > max_len) {
+            if (msg.len > max_len) {
                 AMVP_LOG_ERR("'msg' too long, max allowed=(%d)", max_len);
                 rv = AMVP_INVALID_ARG;
                 goto err;
             }
             // Convert to bits
-            msglen = tmp_msg_len * 4;
+            msglen = msg.len * 4;
 
             if (test_type == AMVP_HASH_TEST_TYPE_VOT) {
                 xof_len = json_object_get_number(testobj, "outLen");
@@ -577,95 +718,124 @@ AMVP_RESULT amvp_hash_kat_handler(AMVP_CTX *ctx, JSON_Object *obj) {
             AMVP_LOG_VERBOSE("        Test case: %d", j);
             AMVP_LOG_VERBOSE("             tcId: %d", tc_id);
             AMVP_LOG_VERBOSE("              len: %d", msglen);
-            AMVP_LOG_VERBOSE("              msg: %s", msg);
+            AMVP_LOG_VERBOSE("              msg: %s", msg.str);
             if (test_type == AMVP_HASH_TEST_TYPE_VOT) {
                 AMVP_LOG_VERBOSE("    outLen: %d", xof_len);
             }
+            if (test_type == AMVP_HASH_TEST_TYPE_LDT) {
+                AMVP_LOG_VERBOSE("       fullLength: %llu", ldt_bits);
+            }
             AMVP_LOG_VERBOSE("         testtype: %s", test_type_str);
 
-            /*
-             * Create a new test case in the response
-             */
-            r_tval = json_value_init_object();
-            r_tobj = json_value_get_object(r_tval);
-
-            json_object_set_number(r_tobj, "tcId", tc_id);
-
             /*
              * Setup the test case data that will be passed down to
              * the crypto module.
              */
-            rv = amvp_hash_init_tc(ctx, &stc, tc_id, test_type, msglen, msg, xof_len,alg_id);
+            rv = amvp_hash_init_tc(ctx, &stcs[j], tc_id, test_type, msglen, msg, xof_len,alg_id);
+            tc_init_cnt = j + 1;
             if (rv != AMVP_SUCCESS) {
                 AMVP_LOG_ERR("Init for stc (test case) failed");
-                amvp_hash_release_tc(&stc);
-                json_value_free(r_tval);
                 goto err;
             }
+            tcs[j].tc.hash = &stcs[j];
+            stcs[j].ldt_len = ldt_bits / 8;
 
             /* If Monte Carlo start that here */
-            if (stc.test_type == AMVP_HASH_TEST_TYPE_MCT) {
+            if (test_type == AMVP_HASH_TEST_TYPE_MCT) {
+                /*
+                 * The resultsArray is built as a tree and spliced into
+                 * the streamed response once the test case is done
+                 */
+                r_tval = json_value_init_object();
+                r_tobj = json_value_get_object(r_tval);
+                json_object_set_number(r_tobj, "tcId", tc_id);
                 json_object_set_value(r_tobj, "resultsArray", json_value_init_array());
                 res_tarr = json_object_get_array(r_tobj, "resultsArray");
 
                 if (alg_id == AMVP_HASH_SHA3_224 || alg_id == AMVP_HASH_SHA3_256 ||
                     alg_id == AMVP_HASH_SHA3_384 || alg_id == AMVP_HASH_SHA3_512) {
-                    rv = amvp_hash_sha3_mct(ctx, cap, &tc, &stc, res_tarr);
+                    rv = amvp_hash_sha3_mct(ctx, cap, &tcs[j], &stcs[j], res_tarr);
                 } else if (alg_id == AMVP_HASH_SHAKE_128 || alg_id == AMVP_HASH_SHAKE_256) {
-                    rv = amvp_hash_shake_mct(ctx, cap, &tc, &stc,
+                    rv = amvp_hash_shake_mct(ctx, cap, &tcs[j], &stcs[j],
                                              res_tarr, min_xof_len, max_xof_len);
                 } else {
-                    rv = amvp_hash_mct_tc(ctx, cap, &tc, &stc, res_tarr);
+                    rv = amvp_hash_mct_tc(ctx, cap, &tcs[j], &stcs[j], res_tarr);
                 }
 
                 if (rv != AMVP_SUCCESS) {
                     AMVP_LOG_ERR("crypto module failed the HASH MCT operation");
-                    amvp_hash_release_tc(&stc);
-                    json_value_free(r_tval);
                     goto err;
                 }
-            } else {
-                /* Process the current test vector... */
-                if ((cap->crypto_handler)(&tc)) {
-                    AMVP_LOG_ERR("crypto module failed the operation");
-                    amvp_hash_release_tc(&stc);
-                    json_value_free(r_tval);
-                    rv = AMVP_CRYPTO_MODULE_FAIL;
+
+                /*
+                 * Release all the memory associated with the test case
+                 */
+                amvp_hash_release_tc(&stcs[j]);
+
+                /* Append the test response value to array */
+                amvp_jw_value(w, NULL, r_tval);
+                json_value_free(r_tval);
+                r_tval = NULL;
+            }
+        }
+
+        if (test_type == AMVP_HASH_TEST_TYPE_LDT) {
+            /* Streamed one at a time, each one already takes the module a while */
+            for (j = 0; j < t_cnt; j++) {
+                rv = amvp_hash_ldt(ctx, cap, &tcs[j]);
+                if (rv != AMVP_SUCCESS) {
                     goto err;
                 }
+            }
+        } else if (test_type != AMVP_HASH_TEST_TYPE_MCT) {
+            /* Process the test vectors of this group... */
+            rv = amvp_worker_run_tcs(ctx, cap, tcs, t_cnt);
+            if (rv != AMVP_SUCCESS) {
+                goto err;
+            }
+        }
+
+        if (test_type != AMVP_HASH_TEST_TYPE_MCT) {
 
+            for (j = 0; j < t_cnt; j++) {
                 /*
                  * Output the test case results using JSON
                  */
-                rv = amvp_hash_output_tc(ctx, &stc, r_tobj);
+                rv = amvp_hash_output_tc(ctx, &stcs[j], w);
                 if (rv != AMVP_SUCCESS) {
                     AMVP_LOG_ERR("JSON output failure in hash module");
-                    amvp_hash_release_tc(&stc);
-                    json_value_free(r_tval);
                     goto err;
                 }
             }
-            /*
-             * Release all the memory associated with the test case
-             */
-            amvp_hash_release_tc(&stc);
+        }
+        amvp_hash_release_group(stcs, tcs, tc_init_cnt);
+        stcs = NULL;
+        tcs = NULL;
+        tc_init_cnt = 0;
 
-            /* Append the test response value to array */
-            json_array_append_value(r_tarr, r_tval);
+        amvp_jw_end_array(w);
+        rv = amvp_jw_end_object(w);
+        if (rv != AMVP_SUCCESS) {
+            AMVP_LOG_ERR("JSON output failure in hash module");
+            goto err;
         }
-        json_array_append_value(r_garr, r_gval);
     }
 
-    json_array_append_value(reg_arry, r_vs_val);
-
-    json_result = json_serialize_to_string_pretty(ctx->kat_resp, NULL);
-    AMVP_LOG_VERBOSE("\n\n%s\n\n", json_result);
-    json_free_serialized_string(json_result);
-    rv = AMVP_SUCCESS;
+    rv = amvp_jw_end_vs_rsp(ctx);
+    if (rv != AMVP_SUCCESS) {
+        AMVP_LOG_ERR("JSON output failure in hash module");
+        goto err;
+    }
+    /* Only log the response if it all stayed in memory, w->buf is just its tail otherwise */
+    if (AMVP_LOG_ENABLED(AMVP_LOG_LVL_VERBOSE) && !w->spilled) {
+        AMVP_LOG_VERBOSE("\n\n%s\n\n", w->buf);
+    }
 
 err:
     if (rv != AMVP_SUCCESS) {
-        amvp_release_json(r_vs_val, r_gval);
+        amvp_hash_release_group(stcs, tcs, tc_init_cnt);
+        if (r_tval) json_value_free(r_tval);
+        if (w) amvp_jw_reset(w);
     }
     return rv;
 }
@@ -676,35 +846,21 @@ err:
  * file that will be uploaded to the server.  This routine handles
  * the JSON processing for a single test case.
  */
-static AMVP_RESULT amvp_hash_output_tc(AMVP_CTX *ctx, AMVP_HASH_TC *stc, JSON_Object *tc_rsp) {
-    AMVP_RESULT rv = AMVP_SUCCESS;
-    char *tmp = NULL;
+static AMVP_RESULT amvp_hash_output_tc(AMVP_CTX *ctx, AMVP_HASH_TC *stc, AMVP_JSON_WRITER *w) {
+    unsigned int md_str_max = AMVP_HASH_MD_STR_MAX;
 
     if (stc->test_type == AMVP_HASH_TEST_TYPE_VOT) {
-        tmp = calloc(AMVP_HASH_XOF_MD_STR_MAX + 1, sizeof(char));
-    } else {
-        tmp = calloc(AMVP_HASH_MD_STR_MAX + 1, sizeof(char));
-    }
-    if (!tmp) {
-        AMVP_LOG_ERR("Unable to malloc in amvp_hash_output_tc");
-        return AMVP_MALLOC_FAIL;
+        md_str_max = AMVP_HASH_XOF_MD_STR_MAX;
     }
-
-    if (stc->test_type == AMVP_HASH_TEST_TYPE_VOT) {
-        rv = amvp_bin_to_hexstr(stc->md, stc->md_len, tmp, AMVP_HASH_XOF_MD_STR_MAX);
-    } else {
-        rv = amvp_bin_to_hexstr(stc->md, stc->md_len, tmp, AMVP_HASH_MD_STR_MAX);
-    }
-    if (rv != AMVP_SUCCESS) {
+    if (stc->md_len * 2 > md_str_max) {
         AMVP_LOG_ERR("hex conversion failure (msg)");
-        goto end;
+        return AMVP_CONVERT_DATA_ERR;
     }
-    json_object_set_string(tc_rsp, "md", tmp);
-
-end:
-    if (tmp) free(tmp);
 
-    return rv;
+    amvp_jw_begin_object(w, NULL);
+    amvp_jw_number(w, "tcId", stc->tc_id);
+    amvp_jw_hex(w, "md", stc->md, stc->md_len);
+    return amvp_jw_end_object(w);
 }
 
 static AMVP_RESULT amvp_hash_init_tc(AMVP_CTX *ctx,
@@ -712,7 +868,7 @@ static AMVP_RESULT amvp_hash_init_tc(AMVP_CTX *ctx,
                                      unsigned int tc_id,
                                      AMVP_HASH_TESTTYPE test_type,
                                      unsigned int msg_len,
-                                     const char *msg,
+                                     AMVP_STR_VIEW msg,
                                      unsigned int xof_len,
                                      AMVP_CIPHER alg_id) {
     AMVP_RESULT rv;
@@ -725,8 +881,8 @@ static AMVP_RESULT amvp_hash_init_tc(AMVP_CTX *ctx,
     }
     if (!stc->msg) { return AMVP_MALLOC_FAIL; }
 
-    if (test_type == AMVP_HASH_TEST_TYPE_AFT) {
-        /* AFT */
+    if (test_type == AMVP_HASH_TEST_TYPE_AFT || test_type == AMVP_HASH_TEST_TYPE_LDT) {
+        /* AFT, LDT */
         stc->md = calloc(1, AMVP_HASH_MD_BYTE_MAX);
         if (!stc->md) { return AMVP_MALLOC_FAIL; }
     } else if (test_type == AMVP_HASH_TEST_TYPE_VOT) {
@@ -761,9 +917,9 @@ static AMVP_RESULT amvp_hash_init_tc(AMVP_CTX *ctx,
         }
     }
     if (alg_id != AMVP_HASH_SHAKE_128 && alg_id != AMVP_HASH_SHAKE_256) {
-        rv = amvp_hexstr_to_bin(msg, stc->msg, AMVP_HASH_MSG_BYTE_MAX, NULL);
+        rv = amvp_view_to_bin(msg, stc->msg, AMVP_HASH_MSG_BYTE_MAX, NULL);
     } else {
-        rv = amvp_hexstr_to_bin(msg, stc->msg, AMVP_SHAKE_MSG_BYTE_MAX, NULL);
+        rv = amvp_view_to_bin(msg, stc->msg, AMVP_SHAKE_MSG_BYTE_MAX, NULL);
     }
     if (rv != AMVP_SUCCESS) {
         AMVP_LOG_ERR("Hex converstion failure (msg)");
@@ -0,0 +1,352 @@
+/** @file */
+/*
+ * Copyright (c) 2021, Cisco Systems, Inc.
+ *
+ * Licensed under the Apache License 2.0 (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://github.com/cisco/libamvp/LICENSE
+ */
+
+/*
+ * Reads the elements of a top level JSON array out of a file one at a
+ * time. The offline request and response files are one big array of
+ * vector sets; with this only the element being processed is parsed and
+ * held in memory, instead of a DOM for the whole file. The file is
+ * memory mapped where mmap is available and read into a buffer otherwise.
+ *
+ * Vector set files are mostly long hex strings, so finding the end of an
+ * element skips through strings 16 bytes at a time where SSE2 is there.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "amvp.h"
+#include "amvp_lcl.h"
+#include "parson.h"
+#include "safe_lib.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define AMVP_JSON_READER_SSE2
+#endif
+
+static int amvp_json_reader_is_ws(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static void amvp_json_reader_skip_ws(AMVP_JSON_FILE_READER *rdr) {
+    while (rdr->pos < rdr->size && amvp_json_reader_is_ws(rdr->data[rdr->pos])) {
+        rdr->pos++;
+    }
+}
+
+/*
+ * Returns the offset of the first quote or backslash in data at or after
+ * pos, or size if there is none
+ */
+static size_t amvp_json_reader_skip_str(const char *data, size_t size, size_t pos) {
+#ifdef AMVP_JSON_READER_SSE2
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    __m128i chunk;
+    int mask = 0;
+
+    while (pos + 16 <= size) {
+        chunk = _mm_loadu_si128((const __m128i *)(data + pos));
+        mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(chunk, quote),
+                                              _mm_cmpeq_epi8(chunk, backslash)));
+        if (mask) {
+            while (!(mask & 1)) {
+                mask >>= 1;
+                pos++;
+            }
+            return pos;
+        }
+        pos += 16;
+    }
+#endif
+    while (pos < size && data[pos] != '"' && data[pos] != '\\') {
+        pos++;
+    }
+    return pos;
+}
+
+#ifdef _WIN32
+static AMVP_RESULT amvp_json_reader_load(AMVP_JSON_FILE_READER *rdr, const char *filename) {
+    FILE *fp = NULL;
+    long len = 0;
+    char *buf = NULL;
+
+    fp = fopen(filename, "rb");
+    if (!fp) {
+        return AMVP_JSON_ERR;
+    }
+    if (fseek(fp, 0, SEEK_END) || (len = ftell(fp)) <= 0 || fseek(fp, 0, SEEK_SET)) {
+        fclose(fp);
+        return AMVP_JSON_ERR;
+    }
+    buf = malloc(len);
+    if (!buf) {
+        fclose(fp);
+        return AMVP_MALLOC_FAIL;
+    }
+    if (fread(buf, 1, len, fp) != (size_t)len) {
+        free(buf);
+        fclose(fp);
+        return AMVP_JSON_ERR;
+    }
+    fclose(fp);
+    rdr->data = buf;
+    rdr->size = (size_t)len;
+    return AMVP_SUCCESS;
+}
+#else
+static AMVP_RESULT amvp_json_reader_load(AMVP_JSON_FILE_READER *rdr, const char *filename) {
+    struct stat st;
+    void *map = NULL;
+    int fd = -1;
+
+    fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        return AMVP_JSON_ERR;
+    }
+    if (fstat(fd, &st) || st.st_size <= 0) {
+        close(fd);
+        return AMVP_JSON_ERR;
+    }
+    map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return AMVP_JSON_ERR;
+    }
+#ifdef MADV_SEQUENTIAL
+    madvise(map, (size_t)st.st_size, MADV_SEQUENTIAL);
+#endif
+    rdr->data = map;
+    rdr->size = (size_t)st.st_size;
+    return AMVP_SUCCESS;
+}
+#endif
+
+AMVP_RESULT amvp_json_reader_open(AMVP_JSON_FILE_READER *rdr, const char *filename) {
+    AMVP_RESULT rv = AMVP_SUCCESS;
+
+    if (!rdr || !filename) {
+        return AMVP_MISSING_ARG;
+    }
+    memzero_s(rdr, sizeof(AMVP_JSON_FILE_READER));
+
+    rv = amvp_json_reader_load(rdr, filename);
+    if (rv != AMVP_SUCCESS) {
+        return rv;
+    }
+
+    /* Skip a UTF-8 BOM, then expect the opening '[' */
+    if (rdr->size >= 3 && !memcmp(rdr->data, "\xEF\xBB\xBF", 3)) {
+        rdr->pos = 3;
+    }
+    amvp_json_reader_skip_ws(rdr);
+    if (rdr->pos >= rdr->size || rdr->data[rdr->pos] != '[') {
+        amvp_json_reader_close(rdr);
+        return AMVP_MALFORMED_JSON;
+    }
+    rdr->pos++;
+    return AMVP_SUCCESS;
+}
+
+/*
+ * Find the next element of the array, without copying or parsing it.
+ * *elem points into the file contents and is valid until the reader is
+ * closed. *elem is set to NULL once the closing ']' is reached.
+ */
+AMVP_RESULT amvp_json_reader_next_slice(AMVP_JSON_FILE_READER *rdr, const char **elem, size_t *elem_len) {
+    size_t start = 0;
+    int depth = 0, in_str = 0;
+
+    if (!rdr || !rdr->data || !elem || !elem_len) {
+        return AMVP_MISSING_ARG;
+    }
+    *elem = NULL;
+    *elem_len = 0;
+
+    amvp_json_reader_skip_ws(rdr);
+    if (rdr->pos >= rdr->size) {
+        return AMVP_MALFORMED_JSON;
+    }
+    if (rdr->data[rdr->pos] == ']') {
+        return AMVP_SUCCESS;
+    }
+    if (rdr->count) {
+        if (rdr->data[rdr->pos] != ',') {
+            return AMVP_MALFORMED_JSON;
+        }
+        rdr->pos++;
+        amvp_json_reader_skip_ws(rdr);
+    }
+
+    /* Find the end of the element, minding strings and nesting */
+    start = rdr->pos;
+    for (; rdr->pos < rdr->size; rdr->pos++) {
+        char c = rdr->data[rdr->pos];
+
+        if (in_str) {
+            rdr->pos = amvp_json_reader_skip_str(rdr->data, rdr->size, rdr->pos);
+            if (rdr->pos >= rdr->size) {
+                break;
+            }
+            c = rdr->data[rdr->pos];
+            if (c == '\\') {
+                rdr->pos++;
+            } else if (c == '"') {
+                in_str = 0;
+            }
+            continue;
+        }
+        if (c == '"') {
+            in_str = 1;
+        } else if (c == '{' || c == '[') {
+            depth++;
+        } else if (c == '}' || c == ']') {
+            if (!depth) {
+                break;
+            }
+            if (!--depth) {
+                rdr->pos++;
+                break;
+            }
+        } else if (c == ',' && !depth) {
+            break;
+        }
+    }
+    if (depth || in_str || rdr->pos > rdr->size || rdr->pos == start) {
+        return AMVP_MALFORMED_JSON;
+    }
+
+    *elem = rdr->data + start;
+    *elem_len = rdr->pos - start;
+    rdr->count++;
+    return AMVP_SUCCESS;
+}
+
+static AMVP_RESULT amvp_json_reader_parse(AMVP_JSON_FILE_READER *rdr, JSON_Value **val, int in_place) {
+    AMVP_RESULT rv = AMVP_SUCCESS;
+    const char *start = NULL;
+    size_t len = 0;
+
+    if (!rdr || !rdr->data || !val) {
+        return AMVP_MISSING_ARG;
+    }
+    *val = NULL;
+
+    rv = amvp_json_reader_next_slice(rdr, &start, &len);
+    if (rv != AMVP_SUCCESS || !start) {
+        return rv;
+    }
+
+    /* parson wants a terminated string, so copy the element out */
+    if (len + 1 > rdr->elem_size) {
+        char *tmp = realloc(rdr->elem, len + 1);
+
+        if (!tmp) {
+            return AMVP_MALLOC_FAIL;
+        }
+        rdr->elem = tmp;
+        rdr->elem_size = len + 1;
+    }
+    memcpy_s(rdr->elem, rdr->elem_size, start, len);
+    rdr->elem[len] = '\0';
+
+    AMVP_TRACE1(json__parse__start, rdr->elem);
+    *val = in_place ? json_parse_string_in_place(rdr->elem) : json_parse_string(rdr->elem);
+    AMVP_TRACE2(json__parse__done, rdr->elem, *val != NULL);
+    if (!*val) {
+        return AMVP_MALFORMED_JSON;
+    }
+    return AMVP_SUCCESS;
+}
+
+/*
+ * Parse the next element of the array into *val. *val is set to NULL
+ * once the closing ']' is reached.
+ */
+AMVP_RESULT amvp_json_reader_next(AMVP_JSON_FILE_READER *rdr, JSON_Value **val) {
+    return amvp_json_reader_parse(rdr, val, 0);
+}
+
+/*
+ * Like amvp_json_reader_next(), but the strings of *val are not copied;
+ * they point into the reader's copy of the element, so *val has to be
+ * freed before the next element is read.
+ */
+AMVP_RESULT amvp_json_reader_next_in_place(AMVP_JSON_FILE_READER *rdr, JSON_Value **val) {
+    return amvp_json_reader_parse(rdr, val, 1);
+}
+
+/*
+ * Look up an integer member of the object in elem by scanning it, for an
+ * element that is not going to be parsed. Only the object's own members
+ * are considered, not those of nested objects.
+ */
+AMVP_RESULT amvp_json_reader_slice_int(const char *elem, size_t elem_len, const char *key, int *out) {
+    size_t i = 0, key_start = 0, key_len = 0;
+    int depth = 0;
+
+    if (!elem || !key || !out) {
+        return AMVP_MISSING_ARG;
+    }
+    key_len = strnlen_s(key, AMVP_ATTR_URL_MAX);
+
+    for (i = 0; i < elem_len; i++) {
+        char c = elem[i];
+
+        if (c == '"') {
+            key_start = ++i;
+            for (; i < elem_len && elem[i] != '"'; i++) {
+                if (elem[i] == '\\') i++;
+            }
+            if (depth != 1 || i - key_start != key_len || memcmp(elem + key_start, key, key_len)) {
+                continue;
+            }
+            /* A match is only a member name if a ':' follows */
+            for (i++; i < elem_len && amvp_json_reader_is_ws(elem[i]); i++);
+            if (i >= elem_len || elem[i] != ':') {
+                continue;
+            }
+            for (i++; i < elem_len && amvp_json_reader_is_ws(elem[i]); i++);
+            if (i >= elem_len || (elem[i] != '-' && (elem[i] < '0' || elem[i] > '9'))) {
+                return AMVP_MALFORMED_JSON;
+            }
+            *out = atoi(elem + i);
+            return AMVP_SUCCESS;
+        } else if (c == '{' || c == '[') {
+            depth++;
+        } else if (c == '}' || c == ']') {
+            depth--;
+        }
+    }
+    return AMVP_NO_DATA;
+}
+
+void amvp_json_reader_close(AMVP_JSON_FILE_READER *rdr) {
+    if (!rdr) {
+        return;
+    }
+    if (rdr->data) {
+#ifdef _WIN32
+        free((void *)rdr->data);
+#else
+        munmap((void *)rdr->data, rdr->size);
+#endif
+    }
+    if (rdr->elem) free(rdr->elem);
+    memzero_s(rdr, sizeof(AMVP_JSON_FILE_READER));
+}
@@ -0,0 +1,867 @@
+/** @file */
+/*
+ * Copyright (c) 2021, Cisco Systems, Inc.
+ *
+ * Licensed under the Apache License 2.0 (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://github.com/cisco/libamvp/LICENSE
+ */
+
+/*
+ * A small append-only JSON writer used by the KAT handlers to emit the
+ * vector set response straight into a growable buffer, instead of building
+ * a parson tree under ctx->kat_resp and serializing it afterwards. The
+ * output is formatted the same way parson formats compact output, or its
+ * pretty printed output with pretty set. Errors are sticky: once a call fails every following call is a
+ * no-op that returns the same error, so callers can check once at the end.
+ *
+ * Since nothing already written is ever changed, the start of the output
+ * can be moved out of memory at any time. With spill_at set, whenever a
+ * closing bracket leaves more than that in buf, buf is appended to a temp
+ * file and emptied. amvp_jw_read_at() and amvp_jw_detach() read the output
+ * back across both.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <limits.h>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "amvp.h"
+#include "amvp_lcl.h"
+#include "parson.h"
+#include "safe_lib.h"
+
+#define AMVP_JSON_WRITER_INIT_SIZE 4096
+/* File bytes base64 encoded per step, a multiple of 3 so only the last step pads */
+#define AMVP_JSON_WRITER_B64_CHUNK 3072
+
+static const char amvp_jw_b64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static AMVP_RESULT amvp_jw_reserve(AMVP_JSON_WRITER *w, size_t extra) {
+    size_t want = 0, new_size = 0;
+    char *tmp = NULL;
+
+    if (w->status != AMVP_SUCCESS) {
+        return w->status;
+    }
+    /* Always leave room for the terminator */
+    want = w->len + extra + 1;
+    if (want <= w->size) {
+        return AMVP_SUCCESS;
+    }
+
+    new_size = w->size ? w->size : AMVP_JSON_WRITER_INIT_SIZE;
+    while (new_size < want) {
+        new_size *= 2;
+    }
+    tmp = realloc(w->buf, new_size);
+    if (!tmp) {
+        w->status = AMVP_MALLOC_FAIL;
+        return w->status;
+    }
+    w->buf = tmp;
+    w->size = new_size;
+    return AMVP_SUCCESS;
+}
+
+static AMVP_RESULT amvp_jw_raw(AMVP_JSON_WRITER *w, const char *str, size_t len) {
+    if (amvp_jw_reserve(w, len) != AMVP_SUCCESS) {
+        return w->status;
+    }
+    memcpy_s(w->buf + w->len, w->size - w->len, str, len);
+    w->len += len;
+    w->buf[w->len] = '\0';
+    return AMVP_SUCCESS;
+}
+
+static AMVP_RESULT amvp_jw_quoted(AMVP_JSON_WRITER *w, const char *str) {
+    char esc[8];
+    const char *run = str, *p = NULL;
+
+    if (amvp_jw_raw(w, "\"", 1) != AMVP_SUCCESS) {
+        return w->status;
+    }
+    for (p = str; *p; p++) {
+        unsigned char c = (unsigned char)*p;
+        const char *rep = NULL;
+
+        switch (c) {
+        case '\"': rep = "\\\""; break;
+        case '\\': rep = "\\\\"; break;
+        case '/':  rep = "\\/"; break;
+        case '\b': rep = "\\b"; break;
+        case '\f': rep = "\\f"; break;
+        case '\n': rep = "\\n"; break;
+        case '\r': rep = "\\r"; break;
+        case '\t': rep = "\\t"; break;
+        default:
+            if (c < 0x20) {
+                snprintf(esc, sizeof(esc), "\\u%04x", c);
+                rep = esc;
+            }
+            break;
+        }
+        if (rep) {
+            /* Flush the plain characters before this one, then the escape */
+            amvp_jw_raw(w, run, p - run);
+            amvp_jw_raw(w, rep, strlen(rep));
+            run = p + 1;
+        }
+    }
+    amvp_jw_raw(w, run, p - run);
+    return amvp_jw_raw(w, "\"", 1);
+}
+
+/*
+ * Start a new line indented to level, the way parson pretty prints
+ */
+static AMVP_RESULT amvp_jw_indent(AMVP_JSON_WRITER *w, int level) {
+    int i;
+
+    amvp_jw_raw(w, "\n", 1);
+    for (i = 0; i < level; i++) {
+        amvp_jw_raw(w, "    ", 4);
+    }
+    return w->status;
+}
+
+/*
+ * Write the separator for a new member at the current level, and the
+ * key if we are inside an object
+ */
+static AMVP_RESULT amvp_jw_member(AMVP_JSON_WRITER *w, const char *key) {
+    if (w->status != AMVP_SUCCESS) {
+        return w->status;
+    }
+    if (w->depth > 0) {
+        if (!w->first[w->depth - 1]) {
+            amvp_jw_raw(w, ",", 1);
+        }
+        w->first[w->depth - 1] = 0;
+        if (w->pretty) {
+            amvp_jw_indent(w, w->depth);
+        }
+    }
+    if (key) {
+        amvp_jw_quoted(w, key);
+        amvp_jw_raw(w, w->pretty ? ": " : ":", w->pretty ? 2 : 1);
+    }
+    return w->status;
+}
+
+static AMVP_RESULT amvp_jw_open(AMVP_JSON_WRITER *w, const char *key, const char *bracket) {
+    if (amvp_jw_member(w, key) != AMVP_SUCCESS) {
+        return w->status;
+    }
+    if (w->depth >= AMVP_JSON_WRITER_DEPTH_MAX) {
+        w->status = AMVP_JSON_ERR;
+        return w->status;
+    }
+    w->first[w->depth++] = 1;
+    return amvp_jw_raw(w, bracket, 1);
+}
+
+/*
+ * Move everything in buf to the end of the spill file
+ */
+static AMVP_RESULT amvp_jw_spill(AMVP_JSON_WRITER *w) {
+    if (!w->spill) {
+        w->spill = tmpfile();
+        if (!w->spill) {
+            w->status = AMVP_JSON_ERR;
+            return w->status;
+        }
+    }
+    if (fseek(w->spill, (long)w->spilled, SEEK_SET) ||
+        fwrite(w->buf, 1, w->len, w->spill) != w->len) {
+        w->status = AMVP_JSON_ERR;
+        return w->status;
+    }
+    w->spilled += w->len;
+    w->len = 0;
+    w->buf[0] = '\0';
+    return AMVP_SUCCESS;
+}
+
+static AMVP_RESULT amvp_jw_close(AMVP_JSON_WRITER *w, const char *bracket) {
+    if (w->status != AMVP_SUCCESS) {
+        return w->status;
+    }
+    if (w->depth <= 0) {
+        w->status = AMVP_JSON_ERR;
+        return w->status;
+    }
+    w->depth--;
+    if (w->pretty && !w->first[w->depth]) {
+        amvp_jw_indent(w, w->depth);
+    }
+    if (amvp_jw_raw(w, bracket, 1) != AMVP_SUCCESS) {
+        return w->status;
+    }
+    /* The outermost bracket stays in buf, the output's last byte is always there */
+    if (w->spill_at && w->depth > 0 && w->len >= w->spill_at) {
+        return amvp_jw_spill(w);
+    }
+    return AMVP_SUCCESS;
+}
+
+AMVP_RESULT amvp_jw_begin_object(AMVP_JSON_WRITER *w, const char *key) {
+    return amvp_jw_open(w, key, "{");
+}
+
+AMVP_RESULT amvp_jw_end_object(AMVP_JSON_WRITER *w) {
+    return amvp_jw_close(w, "}");
+}
+
+AMVP_RESULT amvp_jw_begin_array(AMVP_JSON_WRITER *w, const char *key) {
+    return amvp_jw_open(w, key, "[");
+}
+
+AMVP_RESULT amvp_jw_end_array(AMVP_JSON_WRITER *w) {
+    return amvp_jw_close(w, "]");
+}
+
+AMVP_RESULT amvp_jw_string(AMVP_JSON_WRITER *w, const char *key, const char *str) {
+    if (!str) {
+        w->status = AMVP_MISSING_ARG;
+        return w->status;
+    }
+    if (amvp_jw_member(w, key) != AMVP_SUCCESS) {
+        return w->status;
+    }
+    return amvp_jw_quoted(w, str);
+}
+
+AMVP_RESULT amvp_jw_number(AMVP_JSON_WRITER *w, const char *key, double num) {
+    char num_buf[64];
+    int written = 0;
+
+    if (amvp_jw_member(w, key) != AMVP_SUCCESS) {
+        return w->status;
+    }
+    /* Same format parson uses, so both writers produce the same output */
+    written = snprintf(num_buf, sizeof(num_buf), "%1.17g", num);
+    if (written < 0 || written >= (int)sizeof(num_buf)) {
+        w->status = AMVP_JSON_ERR;
+        return w->status;
+    }
+    return amvp_jw_raw(w, num_buf, written);
+}
+
+AMVP_RESULT amvp_jw_bool(AMVP_JSON_WRITER *w, const char *key, int val) {
+    if (amvp_jw_member(w, key) != AMVP_SUCCESS) {
+        return w->status;
+    }
+    return val ? amvp_jw_raw(w, "true", 4) : amvp_jw_raw(w, "false", 5);
+}
+
+/*
+ * Hex encode bin directly into the output, without a temporary string
+ */
+AMVP_RESULT amvp_jw_hex(AMVP_JSON_WRITER *w, const char *key, const unsigned char *bin, int bin_len) {
+    if (!bin || bin_len < 0) {
+        w->status = AMVP_MISSING_ARG;
+        return w->status;
+    }
+    if (amvp_jw_member(w, key) != AMVP_SUCCESS) {
+        return w->status;
+    }
+    if (amvp_jw_reserve(w, (size_t)bin_len * 2 + 2) != AMVP_SUCCESS) {
+        return w->status;
+    }
+    w->buf[w->len++] = '"';
+    if (amvp_bin_to_hexstr(bin, bin_len, w->buf + w->len, (int)(w->size - w->len - 1)) != AMVP_SUCCESS) {
+        w->status = AMVP_CONVERT_DATA_ERR;
+        return w->status;
+    }
+    w->len += (size_t)bin_len * 2;
+    return amvp_jw_raw(w, "\"", 1);
+}
+
+static void amvp_jw_b64_block(char *out, const unsigned char *in, size_t in_len) {
+    unsigned long n = (unsigned long)in[0] << 16;
+
+    if (in_len > 1) n |= (unsigned long)in[1] << 8;
+    if (in_len > 2) n |= in[2];
+    out[0] = amvp_jw_b64[(n >> 18) & 0x3f];
+    out[1] = amvp_jw_b64[(n >> 12) & 0x3f];
+    out[2] = in_len > 1 ? amvp_jw_b64[(n >> 6) & 0x3f] : '=';
+    out[3] = in_len > 2 ? amvp_jw_b64[n & 0x3f] : '=';
+}
+
+/*
+ * Base64 encode what is left of fp into the output as a string, a chunk at
+ * a time. Unlike the other values this one can be spilled part way through,
+ * so with spill_at set no more than about spill_at of it is ever in memory
+ * however big the file is.
+ */
+AMVP_RESULT amvp_jw_base64_file(AMVP_JSON_WRITER *w, const char *key, FILE *fp) {
+    unsigned char in[AMVP_JSON_WRITER_B64_CHUNK];
+    size_t have = 0, n = 0, i = 0;
+
+    if (!fp) {
+        w->status = AMVP_MISSING_ARG;
+        return w->status;
+    }
+    if (amvp_jw_member(w, key) != AMVP_SUCCESS) {
+        return w->status;
+    }
+    if (amvp_jw_raw(w, "\"", 1) != AMVP_SUCCESS) {
+        return w->status;
+    }
+    while ((n = fread(in + have, 1, sizeof(in) - have, fp)) > 0) {
+        have += n;
+        /* A short read can end mid block, carry the odd bytes into the next one */
+        n = have - have % 3;
+        if (amvp_jw_reserve(w, n / 3 * 4) != AMVP_SUCCESS) {
+            return w->status;
+        }
+        for (i = 0; i < n; i += 3) {
+            amvp_jw_b64_block(w->buf + w->len, in + i, 3);
+            w->len += 4;
+        }
+        w->buf[w->len] = '\0';
+        have -= n;
+        if (have) {
+            memmove(in, in + n, have);
+        }
+        if (w->spill_at && w->len >= w->spill_at && amvp_jw_spill(w) != AMVP_SUCCESS) {
+            return w->status;
+        }
+    }
+    if (ferror(fp)) {
+        w->status = AMVP_JSON_ERR;
+        return w->status;
+    }
+    if (have) {
+        char last[4];
+
+        amvp_jw_b64_block(last, in, have);
+        amvp_jw_raw(w, last, sizeof(last));
+    }
+    return amvp_jw_raw(w, "\"", 1);
+}
+
+/*
+ * Splice a parson value in, for responses that are still easier to build
+ * as a tree (e.g. an MCT resultsArray)
+ */
+AMVP_RESULT amvp_jw_value(AMVP_JSON_WRITER *w, const char *key, const JSON_Value *val) {
+    size_t needed = 0;
+
+    if (!val) {
+        w->status = AMVP_MISSING_ARG;
+        return w->status;
+    }
+    /* parson would serialize it compact, the producer indents trees itself */
+    if (w->pretty && (json_value_get_type(val) == JSONObject || json_value_get_type(val) == JSONArray)) {
+        w->status = AMVP_JSON_ERR;
+        return w->status;
+    }
+    if (amvp_jw_member(w, key) != AMVP_SUCCESS) {
+        return w->status;
+    }
+    needed = json_serialization_size(val);
+    if (!needed) {
+        w->status = AMVP_JSON_ERR;
+        return w->status;
+    }
+    /* needed counts the terminator, which reserve already leaves room for */
+    if (amvp_jw_reserve(w, needed - 1) != AMVP_SUCCESS) {
+        return w->status;
+    }
+    if (json_serialize_to_buffer(val, w->buf + w->len, w->size - w->len) != JSONSuccess) {
+        w->status = AMVP_JSON_ERR;
+        return w->status;
+    }
+    w->len += needed - 1;
+    return AMVP_SUCCESS;
+}
+
+/*
+ * Copy up to len bytes of the output, starting off bytes in, to buf. The
+ * spilled part comes first, then what is still in memory. Returns the
+ * number of bytes copied, 0 past the end, or (size_t)-1 on a read error.
+ */
+size_t amvp_jw_read_at(AMVP_JSON_WRITER *w, size_t off, char *buf, size_t len) {
+    size_t copied = 0, n = 0;
+
+    if (off < w->spilled) {
+        n = w->spilled - off;
+        if (n > len) n = len;
+        if (fseek(w->spill, (long)off, SEEK_SET) || fread(buf, 1, n, w->spill) != n) {
+            return (size_t)-1;
+        }
+        copied = n;
+        off += n;
+    }
+    off -= w->spilled;
+    if (copied < len && off < w->len) {
+        n = w->len - off;
+        if (n > len - copied) n = len - copied;
+        memcpy_s(buf + copied, len - copied, w->buf + off, n);
+        copied += n;
+    }
+    return copied;
+}
+
+/*
+ * Hand the finished output to the caller, who frees it with free().
+ * The writer is left empty and can be reused.
+ */
+char *amvp_jw_detach(AMVP_JSON_WRITER *w, int *len) {
+    char *out = NULL;
+    size_t total = w->spilled + w->len;
+
+    if (w->status != AMVP_SUCCESS || w->depth != 0 || !w->len) {
+        return NULL;
+    }
+    if (w->spilled) {
+        /* Whoever needs it in one piece gets all of it back in memory */
+        if (total >= INT_MAX) {
+            return NULL;
+        }
+        out = malloc(total + 1);
+        if (!out) {
+            return NULL;
+        }
+        if (amvp_jw_read_at(w, 0, out, total) != total) {
+            free(out);
+            return NULL;
+        }
+        out[total] = '\0';
+        if (len) *len = (int)total;
+        amvp_jw_reset(w);
+        return out;
+    }
+    out = w->buf;
+    if (len) *len = (int)w->len;
+    w->buf = NULL;
+    w->len = 0;
+    w->size = 0;
+    return out;
+}
+
+/*
+ * Empty the writer. The spill file is kept for reuse, anything past
+ * spilled in it is stale.
+ */
+void amvp_jw_reset(AMVP_JSON_WRITER *w) {
+    w->len = 0;
+    w->spilled = 0;
+    w->depth = 0;
+    w->status = AMVP_SUCCESS;
+    if (w->buf) w->buf[0] = '\0';
+}
+
+void amvp_jw_free(AMVP_JSON_WRITER *w) {
+    if (w->buf) free(w->buf);
+    if (w->spill) fclose(w->spill);
+    memzero_s(w, sizeof(AMVP_JSON_WRITER));
+}
+
+void amvp_jp_init(AMVP_JSON_PRODUCER *p, const JSON_Value *root) {
+    AMVP_JSON_WRITER w = p->w;
+
+    /* Keep the buffer from a previous pass over the tree */
+    memzero_s(p, sizeof(AMVP_JSON_PRODUCER));
+    p->w = w;
+    amvp_jw_reset(&p->w);
+    p->root = root;
+}
+
+/*
+ * Write the next value of the tree to p->w: a scalar, or the opening or
+ * closing bracket of an object or array. Returns 0 once the whole tree
+ * has been written.
+ */
+static int amvp_jp_step(AMVP_JSON_PRODUCER *p) {
+    AMVP_JSON_WRITER *w = &p->w;
+    const JSON_Value *top = NULL, *child = NULL;
+    const char *key = NULL;
+    JSON_Object *obj = NULL;
+    JSON_Array *arr = NULL;
+    int d = 0;
+
+    if (!p->started) {
+        p->started = 1;
+        child = p->root;
+    } else {
+        if (!w->depth) {
+            return 0;
+        }
+        d = w->depth - 1;
+        top = p->stack[d];
+        if (json_value_get_type(top) == JSONObject) {
+            obj = json_value_get_object(top);
+            if (p->idx[d] >= json_object_get_count(obj)) {
+                amvp_jw_end_object(w);
+                return 1;
+            }
+            key = json_object_get_name(obj, p->idx[d]);
+            child = json_object_get_value_at(obj, p->idx[d]);
+        } else {
+            arr = json_value_get_array(top);
+            if (p->idx[d] >= json_array_get_count(arr)) {
+                amvp_jw_end_array(w);
+                return 1;
+            }
+            child = json_array_get_value(arr, p->idx[d]);
+        }
+        p->idx[d]++;
+    }
+
+    switch (json_value_get_type(child)) {
+    case JSONObject:
+        if (amvp_jw_begin_object(w, key) == AMVP_SUCCESS) {
+            p->stack[w->depth - 1] = child;
+            p->idx[w->depth - 1] = 0;
+        }
+        break;
+    case JSONArray:
+        if (amvp_jw_begin_array(w, key) == AMVP_SUCCESS) {
+            p->stack[w->depth - 1] = child;
+            p->idx[w->depth - 1] = 0;
+        }
+        break;
+    default:
+        amvp_jw_value(w, key, child);
+        break;
+    }
+    return 1;
+}
+
+/*
+ * Fill up to len bytes of buf with the next part of the serialized tree.
+ * Returns the number of bytes written, 0 once the tree is complete, or
+ * (size_t)-1 if it could not be serialized.
+ */
+size_t amvp_jp_read(AMVP_JSON_PRODUCER *p, char *buf, size_t len) {
+    AMVP_JSON_WRITER *w = &p->w;
+    size_t copied = 0, n = 0;
+
+    while (copied < len) {
+        if (p->pos == w->len) {
+            /* Drained, write the next value over what was handed out */
+            w->len = 0;
+            p->pos = 0;
+            if (!amvp_jp_step(p)) {
+                break;
+            }
+            if (w->status != AMVP_SUCCESS) {
+                return (size_t)-1;
+            }
+            continue;
+        }
+        n = w->len - p->pos;
+        if (n > len - copied) n = len - copied;
+        memcpy_s(buf + copied, len - copied, w->buf + p->pos, n);
+        p->pos += n;
+        copied += n;
+    }
+    p->total += copied;
+    return copied;
+}
+
+void amvp_jp_free(AMVP_JSON_PRODUCER *p) {
+    amvp_jw_free(&p->w);
+    memzero_s(p, sizeof(AMVP_JSON_PRODUCER));
+}
+
+/*
+ * Start the response for the current vector set. Any parson response a
+ * previous handler left in ctx->kat_resp is dropped, since the two can't
+ * both be the current response. mode_str, if any, is written after the
+ * test groups by amvp_jw_end_vs_rsp(), where the handlers that build a
+ * tree put it.
+ */
+AMVP_RESULT amvp_jw_begin_vs_rsp(AMVP_CTX *ctx, const char *alg_str, const char *mode_str) {
+    AMVP_JSON_WRITER *w = &ctx->kat_writer;
+
+    /* Streamed a group at a time, the groups after the first go into the open response */
+    if (ctx->kat_rsp_cont == AMVP_RSP_CONT_MORE) {
+        return w->status;
+    }
+    if (ctx->kat_resp) {
+        json_value_free(ctx->kat_resp);
+        ctx->kat_resp = NULL;
+    }
+    amvp_jw_reset(w);
+    w->spill_at = ctx->rsp_mem_budget;
+    amvp_jw_begin_array(w, NULL);
+    amvp_jw_begin_object(w, NULL);
+    amvp_jw_number(w, "vsId", ctx->vs_id);
+    amvp_jw_string(w, "algorithm", alg_str);
+    ctx->kat_rsp_mode = mode_str;
+    return amvp_jw_begin_array(w, "testGroups");
+}
+
+/*
+ * Start the response for the current IE set, the same way as
+ * amvp_jw_begin_vs_rsp() and closed with amvp_jw_end_vs_rsp(). Evidence
+ * files are encoded into it as they are read, so the writer spills past
+ * AMVP_EVIDENCE_SPILL_AT even without a response memory budget.
+ */
+AMVP_RESULT amvp_jw_begin_ie_rsp(AMVP_CTX *ctx) {
+    AMVP_JSON_WRITER *w = &ctx->kat_writer;
+
+    if (ctx->kat_resp) {
+        json_value_free(ctx->kat_resp);
+        ctx->kat_resp = NULL;
+    }
+    amvp_jw_reset(w);
+    ctx->kat_rsp_mode = NULL;
+    w->spill_at = ctx->rsp_mem_budget ? ctx->rsp_mem_budget : AMVP_EVIDENCE_SPILL_AT;
+    amvp_jw_begin_array(w, NULL);
+    amvp_jw_begin_object(w, NULL);
+    amvp_jw_number(w, "ieId", ctx->vs_id);
+    return amvp_jw_begin_array(w, "teGroups");
+}
+
+AMVP_RESULT amvp_jw_end_vs_rsp(AMVP_CTX *ctx) {
+    AMVP_JSON_WRITER *w = &ctx->kat_writer;
+
+    /* Closed by amvp_vs_stream_end() after the last group */
+    if (ctx->kat_rsp_cont) {
+        return w->status;
+    }
+    amvp_jw_end_array(w);
+    if (ctx->kat_rsp_mode) {
+        amvp_jw_string(w, "mode", ctx->kat_rsp_mode);
+    }
+    amvp_jw_end_object(w);
+    return amvp_jw_end_array(w);
+}
+
+/*
+ * Serialize the response for the current vector set, whichever way the
+ * handler built it. The caller frees the result with free().
+ */
+AMVP_RESULT amvp_kat_resp_serialize(AMVP_CTX *ctx, char **out, int *out_len) {
+    AMVP_JSON_WRITER *w = &ctx->kat_writer;
+
+    if (!out) {
+        return AMVP_MISSING_ARG;
+    }
+    *out = NULL;
+    AMVP_TRACE1(json__serialize__start, ctx->vs_id);
+    if (ctx->kat_resp) {
+        amvp_jw_reset(w);
+        w->spill_at = 0;
+        amvp_jw_value(w, NULL, ctx->kat_resp);
+    }
+    if (w->status != AMVP_SUCCESS) {
+        AMVP_TRACE2(json__serialize__done, ctx->vs_id, -1);
+        return w->status;
+    }
+    *out = amvp_jw_detach(w, out_len);
+    AMVP_TRACE2(json__serialize__done, ctx->vs_id, *out && out_len ? *out_len : -1);
+    if (!*out) {
+        return AMVP_JSON_ERR;
+    }
+    return AMVP_SUCCESS;
+}
+
+/*
+ * Write the response object for the current vector set to fp, without the
+ * enclosing array, for the offline response file. A streamed response is
+ * copied out of the writer as is, spilled part included; a tree is
+ * serialized once, straight from ctx->kat_resp.
+ */
+AMVP_RESULT amvp_kat_resp_write_vs(AMVP_CTX *ctx, FILE *fp) {
+    AMVP_JSON_WRITER *w = &ctx->kat_writer;
+    AMVP_RESULT rv = AMVP_SUCCESS;
+    char chunk[AMVP_JSON_WRITER_INIT_SIZE];
+    size_t off = 1, end = 0, n = 0;
+
+    if (!fp) {
+        return AMVP_MISSING_ARG;
+    }
+
+    if (ctx->kat_resp) {
+        JSON_Array *arr = json_value_get_array(ctx->kat_resp);
+        size_t cnt = json_array_get_count(arr);
+        char *str = NULL;
+
+        /* The vector set response is the last entry */
+        if (!cnt) {
+            return AMVP_JSON_ERR;
+        }
+        str = amvp_json_serialize(ctx, json_array_get_value(arr, cnt - 1), NULL);
+        if (!str) {
+            return AMVP_JSON_ERR;
+        }
+        if (fputs(str, fp) == EOF) {
+            rv = AMVP_JSON_ERR;
+        }
+        json_free_serialized_string(str);
+        return rv;
+    }
+
+    /* amvp_jw_begin_vs_rsp() wraps the response object in [ ] */
+    if (w->status != AMVP_SUCCESS || w->depth != 0 || !w->len ||
+        w->spilled + w->len < 2 || w->buf[w->len - 1] != ']' ||
+        amvp_jw_read_at(w, 0, chunk, 1) != 1 || chunk[0] != '[') {
+        return AMVP_JSON_ERR;
+    }
+    end = w->spilled + w->len - 1;
+    while (off < end) {
+        n = end - off < sizeof(chunk) ? end - off : sizeof(chunk);
+        if (amvp_jw_read_at(w, off, chunk, n) != n || fwrite(chunk, 1, n, fp) != n) {
+            rv = AMVP_JSON_ERR;
+            break;
+        }
+        off += n;
+    }
+    amvp_jw_reset(w);
+    return rv;
+}
+
+/*
+ * Flush fp all the way to disk
+ */
+static int amvp_req_file_sync(FILE *fp) {
+    if (fflush(fp) == EOF) {
+        return -1;
+    }
+#ifdef _WIN32
+    return _commit(_fileno(fp));
+#else
+    return fsync(fileno(fp));
+#endif
+}
+
+/*
+ * Write sep and then val to the request file, a value of the tree at a
+ * time through rf->prod, so the serialized set is never held in memory
+ * as a whole
+ */
+static AMVP_RESULT amvp_req_file_put(AMVP_CTX *ctx, const char *sep, const JSON_Value *val) {
+    AMVP_REQ_FILE *rf = &ctx->req_file;
+    AMVP_JSON_WRITER *w = &rf->prod.w;
+    size_t sep_len = strnlen_s(sep, 4);
+
+    if (fwrite(sep, 1, sep_len, rf->fp) != sep_len) {
+        return AMVP_JSON_ERR;
+    }
+    w->pretty = !ctx->json_compact;
+    amvp_jp_init(&rf->prod, val);
+    while (amvp_jp_step(&rf->prod)) {
+        if (w->status != AMVP_SUCCESS) {
+            return w->status;
+        }
+        if (w->len >= AMVP_JSON_WRITER_INIT_SIZE) {
+            if (fwrite(w->buf, 1, w->len, rf->fp) != w->len) {
+                return AMVP_JSON_ERR;
+            }
+            w->len = 0;
+        }
+    }
+    if (w->len && fwrite(w->buf, 1, w->len, rf->fp) != w->len) {
+        return AMVP_JSON_ERR;
+    }
+    w->len = 0;
+    if (rf->fsync == AMVP_FSYNC_EACH_SET && amvp_req_file_sync(rf->fp)) {
+        return AMVP_JSON_ERR;
+    }
+    return AMVP_SUCCESS;
+}
+
+/*
+ * Open ctx->vector_req_file and start its array with ids, the session
+ * identifiers. The file stays open, buffered, until amvp_req_file_end().
+ */
+AMVP_RESULT amvp_req_file_begin(AMVP_CTX *ctx, const JSON_Value *ids) {
+    AMVP_REQ_FILE *rf = &ctx->req_file;
+    size_t buf_size = rf->buf_size ? rf->buf_size : AMVP_REQ_FILE_BUF_DEFAULT;
+
+    if (!ids) {
+        return AMVP_MISSING_ARG;
+    }
+    if (!ctx->vector_req_file) {
+        return AMVP_INVALID_ARG;
+    }
+    /* Left open by a run that failed part way */
+    amvp_req_file_free(rf);
+
+    rf->fp = fopen(ctx->vector_req_file, "w");
+    if (!rf->fp) {
+        return AMVP_JSON_ERR;
+    }
+    rf->buf = malloc(buf_size);
+    if (rf->buf && setvbuf(rf->fp, rf->buf, _IOFBF, buf_size)) {
+        /* stdio keeps its own buffer then */
+        free(rf->buf);
+        rf->buf = NULL;
+    }
+    return amvp_req_file_put(ctx, "[ ", ids);
+}
+
+/*
+ * Append a vector set, or TE set, to the open request file
+ */
+AMVP_RESULT amvp_req_file_add(AMVP_CTX *ctx, const JSON_Value *val) {
+    if (!val) {
+        return AMVP_MISSING_ARG;
+    }
+    if (!ctx->req_file.fp) {
+        return AMVP_JSON_ERR;
+    }
+    return amvp_req_file_put(ctx, ", ", val);
+}
+
+/*
+ * Close the array and the file. Nothing to do if no set was saved.
+ */
+AMVP_RESULT amvp_req_file_end(AMVP_CTX *ctx) {
+    AMVP_REQ_FILE *rf = &ctx->req_file;
+    AMVP_RESULT rv = AMVP_SUCCESS;
+
+    if (!rf->fp) {
+        return AMVP_SUCCESS;
+    }
+    if (fputs(" ]", rf->fp) == EOF) {
+        rv = AMVP_JSON_ERR;
+    }
+    if (rv == AMVP_SUCCESS && rf->fsync != AMVP_FSYNC_NONE && amvp_req_file_sync(rf->fp)) {
+        rv = AMVP_JSON_ERR;
+    }
+    if (fclose(rf->fp) == EOF) {
+        rv = AMVP_JSON_ERR;
+    }
+    rf->fp = NULL;
+    amvp_req_file_free(rf);
+
+    /* The sets were only serialized on the way out, so read the file back once */
+    if (rv == AMVP_SUCCESS && ctx->vs_cache) {
+        JSON_Value *val = json_parse_file(ctx->vector_req_file);
+
+        if (!val || amvp_vs_cache_write(ctx, ctx->vector_req_file, val) != AMVP_SUCCESS) {
+            AMVP_LOG_WARN("Unable to write the vector set cache of %s, continuing", ctx->vector_req_file);
+        }
+        json_value_free(val);
+    }
+    return rv;
+}
+
+/*
+ * Close the file if still open and free the buffers, keeping the settings
+ */
+void amvp_req_file_free(AMVP_REQ_FILE *rf) {
+    if (rf->fp) {
+        fclose(rf->fp);
+        rf->fp = NULL;
+    }
+    if (rf->buf) {
+        free(rf->buf);
+        rf->buf = NULL;
+    }
+    amvp_jp_free(&rf->prod);
+}
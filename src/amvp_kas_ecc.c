@@ -306,7 +306,9 @@ static AMVP_RESULT amvp_kas_ecc_cdh(AMVP_CTX *ctx,
     unsigned int i, g_cnt;
     int j, t_cnt, tc_id;
     AMVP_RESULT rv;
+    AMVP_GROUP_STATE group;
 
+    memzero_s(&group, sizeof(AMVP_GROUP_STATE));
     groups = json_object_get_array(obj, "testGroups");
     g_cnt = json_array_get_count(groups);
 
@@ -429,7 +431,8 @@ static AMVP_RESULT amvp_kas_ecc_cdh(AMVP_CTX *ctx,
             }
 
             /* Process the current KAT test vector... */
-            if ((cap->crypto_handler)(tc)) {
+            if (amvp_group_begin(ctx, cap, tc, &group, &stc->group_ctx) ||
+                amvp_crypto_call(ctx, cap, tc)) {
                 amvp_kas_ecc_release_tc(stc);
                 AMVP_LOG_ERR("crypto module failed the operation");
                 rv = AMVP_CRYPTO_MODULE_FAIL;
@@ -456,12 +459,14 @@ static AMVP_RESULT amvp_kas_ecc_cdh(AMVP_CTX *ctx,
             /* Append the test response value to array */
             json_array_append_value(r_tarr, r_tval);
         }
+        amvp_group_end(cap, &group);
         json_array_append_value(r_garr, r_gval);
     }
     rv = AMVP_SUCCESS;
 
 err:
     if (rv != AMVP_SUCCESS) {
+        amvp_group_end(cap, &group);
         json_value_free(r_gval);
     }
     return rv;
@@ -484,7 +489,9 @@ static AMVP_RESULT amvp_kas_ecc_comp(AMVP_CTX *ctx,
     unsigned int i, g_cnt;
     int j, t_cnt, tc_id;
     AMVP_RESULT rv;
+    AMVP_GROUP_STATE group;
 
+    memzero_s(&group, sizeof(AMVP_GROUP_STATE));
     groups = json_object_get_array(obj, "testGroups");
     g_cnt = json_array_get_count(groups);
 
@@ -694,7 +701,8 @@ static AMVP_RESULT amvp_kas_ecc_comp(AMVP_CTX *ctx,
             }
 
             /* Process the current KAT test vector... */
-            if ((cap->crypto_handler)(tc)) {
+            if (amvp_group_begin(ctx, cap, tc, &group, &stc->group_ctx) ||
+                amvp_crypto_call(ctx, cap, tc)) {
                 amvp_kas_ecc_release_tc(stc);
                 AMVP_LOG_ERR("crypto module failed the operation");
                 rv = AMVP_CRYPTO_MODULE_FAIL;
@@ -721,12 +729,14 @@ static AMVP_RESULT amvp_kas_ecc_comp(AMVP_CTX *ctx,
             /* Append the test response value to array */
             json_array_append_value(r_tarr, r_tval);
         }
+        amvp_group_end(cap, &group);
         json_array_append_value(r_garr, r_gval);
     }
     rv = AMVP_SUCCESS;
 
 err:
     if (rv != AMVP_SUCCESS) {
+        amvp_group_end(cap, &group);
         json_value_free(r_gval);
     }
     return rv;
@@ -852,9 +862,11 @@ AMVP_RESULT amvp_kas_ecc_kat_handler(AMVP_CTX *ctx, JSON_Object *obj) {
     }
     json_array_append_value(reg_arry, r_vs_val);
 
-    json_result = json_serialize_to_string_pretty(ctx->kat_resp, NULL);
-    AMVP_LOG_VERBOSE("\n\n%s\n\n", json_result);
-    json_free_serialized_string(json_result);
+    if (AMVP_LOG_ENABLED(AMVP_LOG_LVL_VERBOSE)) {
+        json_result = json_serialize_to_string_pretty(ctx->kat_resp, NULL);
+        AMVP_LOG_VERBOSE("\n\n%s\n\n", json_result);
+        json_free_serialized_string(json_result);
+    }
     rv = AMVP_SUCCESS;
 
 err:
@@ -961,7 +973,9 @@ static AMVP_RESULT amvp_kas_ecc_ssc(AMVP_CTX *ctx,
     unsigned int i, g_cnt;
     int j, t_cnt, tc_id;
     AMVP_RESULT rv;
+    AMVP_GROUP_STATE group;
 
+    memzero_s(&group, sizeof(AMVP_GROUP_STATE));
     groups = json_object_get_array(obj, "testGroups");
     g_cnt = json_array_get_count(groups);
 
@@ -1207,7 +1221,8 @@ static AMVP_RESULT amvp_kas_ecc_ssc(AMVP_CTX *ctx,
             }
 
             /* Process the current KAT test vector... */
-            if ((cap->crypto_handler)(tc)) {
+            if (amvp_group_begin(ctx, cap, tc, &group, &stc->group_ctx) ||
+                amvp_crypto_call(ctx, cap, tc)) {
                 amvp_kas_ecc_release_tc(stc);
                 AMVP_LOG_ERR("crypto module failed the operation");
                 rv = AMVP_CRYPTO_MODULE_FAIL;
@@ -1234,12 +1249,14 @@ static AMVP_RESULT amvp_kas_ecc_ssc(AMVP_CTX *ctx,
             /* Append the test response value to array */
             json_array_append_value(r_tarr, r_tval);
         }
+        amvp_group_end(cap, &group);
         json_array_append_value(r_garr, r_gval);
     }
     rv = AMVP_SUCCESS;
 
 err:
     if (rv != AMVP_SUCCESS) {
+        amvp_group_end(cap, &group);
         json_value_free(r_gval);
     }
     return rv;
@@ -1306,9 +1323,11 @@ AMVP_RESULT amvp_kas_ecc_ssc_kat_handler(AMVP_CTX *ctx, JSON_Object *obj) {
     }
     json_array_append_value(reg_arry, r_vs_val);
 
-    json_result = json_serialize_to_string_pretty(ctx->kat_resp, NULL);
-    AMVP_LOG_VERBOSE("\n\n%s\n\n", json_result);
-    json_free_serialized_string(json_result);
+    if (AMVP_LOG_ENABLED(AMVP_LOG_LVL_VERBOSE)) {
+        json_result = json_serialize_to_string_pretty(ctx->kat_resp, NULL);
+        AMVP_LOG_VERBOSE("\n\n%s\n\n", json_result);
+        json_free_serialized_string(json_result);
+    }
     rv = AMVP_SUCCESS;
 
 err:
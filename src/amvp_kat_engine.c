@@ -0,0 +1,331 @@
+/** @file */
+/*
+ * Copyright (c) 2021, Cisco Systems, Inc.
+ *
+ * Licensed under the Apache License 2.0 (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://github.com/cisco/libamvp/LICENSE
+ */
+
+/*
+ * The KAT handler for algorithms whose test cases are a flat list of
+ * numbers, strings and hex values, described by an AMVP_KAT_SCHEMA.
+ *
+ * Everything the hand written handlers each do their own way is done here
+ * once: members are read through views, so nothing is measured or copied
+ * twice, hex is decoded straight into buffers from ctx->tc_arena, which
+ * is reset for each group, the test cases of a group go to the worker pool
+ * together (and through the crypto result cache and batch handler), and
+ * the response is streamed into ctx->kat_writer, which also lets the set
+ * be handled a group at a time as it downloads.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "amvp.h"
+#include "amvp_lcl.h"
+#include "parson.h"
+#include "safe_lib.h"
+
+#define AMVP_KAT_MEMBER(stc, off, type) ((type *)((unsigned char *)(stc) + (off)))
+
+/* The result for a required member that is missing */
+static AMVP_RESULT amvp_kat_missing(AMVP_CTX *ctx, const AMVP_KAT_FIELD *f) {
+    AMVP_LOG_ERR("Server JSON missing '%s'", f->name);
+    return (f->flags & AMVP_KAT_MISSING_INVALID) ? AMVP_INVALID_ARG : AMVP_MISSING_ARG;
+}
+
+/*
+ * Read the members in fields from src into stc. Hex values are decoded
+ * into buffers from the arena.
+ */
+static AMVP_RESULT amvp_kat_read_fields(AMVP_CTX *ctx, const AMVP_KAT_FIELD *fields,
+                                        const JSON_Object *src, void *stc) {
+    const AMVP_KAT_FIELD *f;
+    AMVP_STR_VIEW view;
+    AMVP_HASH_ALG hash_alg;
+    unsigned char *buf = NULL;
+    int num = 0, len = 0;
+    AMVP_RESULT rv;
+
+    for (f = fields; f && f->name; f++) {
+        switch (f->type) {
+        case AMVP_KAT_NUM:
+        case AMVP_KAT_BITS:
+            num = (int)json_object_get_number(src, f->name);
+            if (!num && (f->flags & AMVP_KAT_REQUIRED)) {
+                return amvp_kat_missing(ctx, f);
+            }
+            AMVP_LOG_VERBOSE("%17s: %d", f->name, num);
+            *AMVP_KAT_MEMBER(stc, f->off, int) = f->type == AMVP_KAT_BITS ? num / 8 : num;
+            break;
+        case AMVP_KAT_HEX:
+        case AMVP_KAT_STR:
+            view = amvp_json_view(src, f->name);
+            if (!view.str) {
+                if (!(f->flags & AMVP_KAT_REQUIRED)) {
+                    break;
+                }
+                return amvp_kat_missing(ctx, f);
+            }
+            AMVP_LOG_VERBOSE("%17s: %s", f->name, view.str);
+            len = f->type == AMVP_KAT_HEX ? (int)((view.len + 1) / 2) : (int)view.len;
+            if ((f->flags & AMVP_KAT_CHECK_LEN) &&
+                    (len != *AMVP_KAT_MEMBER(stc, f->len_off, int) ||
+                     (f->type == AMVP_KAT_HEX && (view.len & 1)))) {
+                AMVP_LOG_ERR("Server JSON '%s' is not the length given for it (%d bytes)",
+                             f->name, *AMVP_KAT_MEMBER(stc, f->len_off, int));
+                return AMVP_INVALID_ARG;
+            }
+            if (f->type == AMVP_KAT_STR) {
+                *AMVP_KAT_MEMBER(stc, f->off, const char *) = view.str;
+            } else {
+                /*
+                 * Only as large as the value, as the buffers of a whole group
+                 * are held until the next one. A value without a length of its
+                 * own is read by one given elsewhere, so it stays max bytes.
+                 */
+                rv = amvp_arena_decode_hex(&ctx->tc_arena, view,
+                                           f->len_off == AMVP_KAT_NO_LEN ? f->max : 0,
+                                           f->max, &buf, &len);
+                if (rv != AMVP_SUCCESS) {
+                    AMVP_LOG_ERR("Hex conversion failure (%s)", f->name);
+                    return rv;
+                }
+                *AMVP_KAT_MEMBER(stc, f->off, unsigned char *) = buf;
+            }
+            if (f->len_off != AMVP_KAT_NO_LEN && !(f->flags & AMVP_KAT_CHECK_LEN)) {
+                *AMVP_KAT_MEMBER(stc, f->len_off, int) = len;
+            }
+            break;
+        case AMVP_KAT_HASH:
+            view = amvp_json_view(src, f->name);
+            hash_alg = view.str ? amvp_lookup_hash_alg(view.str) : 0;
+            if (!hash_alg && (view.str || (f->flags & AMVP_KAT_REQUIRED))) {
+                AMVP_LOG_ERR("Server JSON invalid '%s'", f->name);
+                return view.str ? AMVP_INVALID_ARG : AMVP_MISSING_ARG;
+            }
+            AMVP_LOG_VERBOSE("%17s: %s", f->name, view.str ? view.str : "");
+            *AMVP_KAT_MEMBER(stc, f->off, AMVP_HASH_ALG) = hash_alg;
+            break;
+        default:
+            return AMVP_INVALID_ARG;
+        }
+    }
+    return AMVP_SUCCESS;
+}
+
+/* The buffers of the out fields, for the module to fill in */
+static AMVP_RESULT amvp_kat_alloc_out(AMVP_CTX *ctx, const AMVP_KAT_FIELD *fields, void *stc) {
+    const AMVP_KAT_FIELD *f;
+    unsigned char *buf = NULL;
+
+    for (f = fields; f && f->name; f++) {
+        buf = amvp_arena_alloc(&ctx->tc_arena, f->max);
+        if (!buf) {
+            return AMVP_MALLOC_FAIL;
+        }
+        *AMVP_KAT_MEMBER(stc, f->off, unsigned char *) = buf;
+    }
+    return AMVP_SUCCESS;
+}
+
+static AMVP_RESULT amvp_kat_output_tc(AMVP_CTX *ctx, const AMVP_KAT_SCHEMA *schema,
+                                      void *stc, AMVP_JSON_WRITER *w) {
+    const AMVP_KAT_FIELD *f;
+    int len = 0;
+
+    amvp_jw_begin_object(w, NULL);
+    amvp_jw_number(w, "tcId", *AMVP_KAT_MEMBER(stc, schema->tc_id_off, unsigned int));
+    for (f = schema->out; f && f->name; f++) {
+        len = *AMVP_KAT_MEMBER(stc, f->len_off, int);
+        if (len < 0 || len > f->max) {
+            AMVP_LOG_ERR("hex conversion failure (%s)", f->name);
+            return AMVP_CONVERT_DATA_ERR;
+        }
+        amvp_jw_hex(w, f->name, *AMVP_KAT_MEMBER(stc, f->off, unsigned char *), len);
+    }
+    return amvp_jw_end_object(w);
+}
+
+/*
+ * Read the test cases of one group, run them and write out its response
+ */
+static AMVP_RESULT amvp_kat_run_group(AMVP_CTX *ctx, AMVP_CAPS_LIST *cap, AMVP_CIPHER alg_id,
+                                      const AMVP_KAT_SCHEMA *schema, JSON_Object *groupobj,
+                                      AMVP_JSON_WRITER *w) {
+    JSON_Array *tests = NULL;
+    JSON_Object *testobj = NULL;
+    AMVP_TEST_CASE *tcs = NULL;
+    unsigned char *stcs = NULL;
+    void *tmpl = NULL, *stc = NULL;
+    unsigned int tc_id = 0;
+    int tgId = 0, j, t_cnt = 0;
+    AMVP_RESULT rv;
+
+    /* Everything of the last group has been written out */
+    amvp_arena_reset(&ctx->tc_arena);
+
+    tgId = json_object_get_number(groupobj, "tgId");
+    if (!tgId) {
+        AMVP_LOG_ERR("Missing tgid from server JSON groub obj");
+        return AMVP_MALFORMED_JSON;
+    }
+    AMVP_LOG_VERBOSE("    Test group: %d", tgId);
+
+    tmpl = amvp_arena_alloc(&ctx->tc_arena, schema->tc_size);
+    if (!tmpl) {
+        return AMVP_MALLOC_FAIL;
+    }
+    *AMVP_KAT_MEMBER(tmpl, schema->cipher_off, AMVP_CIPHER) = alg_id;
+    rv = amvp_kat_read_fields(ctx, schema->group, groupobj, tmpl);
+    if (rv != AMVP_SUCCESS) {
+        return rv;
+    }
+
+    tests = json_object_get_array(groupobj, "tests");
+    t_cnt = json_array_get_count(tests);
+    if (!t_cnt) {
+        AMVP_LOG_ERR("Failed to include tests in array. ");
+        return AMVP_MISSING_ARG;
+    }
+    stcs = amvp_arena_alloc(&ctx->tc_arena, schema->tc_size * t_cnt);
+    tcs = amvp_arena_alloc(&ctx->tc_arena, sizeof(AMVP_TEST_CASE) * t_cnt);
+    if (!stcs || !tcs) {
+        return AMVP_MALLOC_FAIL;
+    }
+
+    for (j = 0; j < t_cnt; j++) {
+        stc = stcs + schema->tc_size * j;
+        testobj = json_array_get_object(tests, j);
+
+        tc_id = json_object_get_number(testobj, "tcId");
+        if (!tc_id) {
+            AMVP_LOG_ERR("Failed to include tc_id. ");
+            return AMVP_MISSING_ARG;
+        }
+        AMVP_LOG_VERBOSE("        Test case: %d", j);
+        AMVP_LOG_VERBOSE("             tcId: %u", tc_id);
+
+        memcpy_s(stc, schema->tc_size, tmpl, schema->tc_size);
+        *AMVP_KAT_MEMBER(stc, schema->tc_id_off, unsigned int) = tc_id;
+        rv = amvp_kat_read_fields(ctx, schema->test, testobj, stc);
+        if (rv == AMVP_SUCCESS) {
+            rv = amvp_kat_alloc_out(ctx, schema->out, stc);
+        }
+        if (rv == AMVP_SUCCESS && schema->check) {
+            rv = schema->check(ctx, stc);
+        }
+        if (rv != AMVP_SUCCESS) {
+            return rv;
+        }
+        schema->bind(&tcs[j], stc);
+    }
+
+    /* Process the test vectors of this group... */
+    rv = amvp_worker_run_tcs(ctx, cap, tcs, t_cnt);
+    if (rv != AMVP_SUCCESS) {
+        AMVP_LOG_ERR("crypto module failed the operation");
+        return rv;
+    }
+
+    amvp_jw_begin_object(w, NULL);
+    amvp_jw_number(w, "tgId", tgId);
+    amvp_jw_begin_array(w, "tests");
+    for (j = 0; j < t_cnt; j++) {
+        rv = amvp_kat_output_tc(ctx, schema, stcs + schema->tc_size * j, w);
+        if (rv != AMVP_SUCCESS) {
+            return rv;
+        }
+    }
+    amvp_jw_end_array(w);
+    return amvp_jw_end_object(w);
+}
+
+AMVP_RESULT amvp_kat_engine_run(AMVP_CTX *ctx, JSON_Object *obj, const AMVP_KAT_SCHEMA *schema) {
+    JSON_Array *groups = NULL;
+    AMVP_JSON_WRITER *w = NULL;
+    AMVP_CAPS_LIST *cap = NULL;
+    AMVP_CIPHER alg_id = 0;
+    const char *alg_str = NULL, *mode_str = NULL;
+    int i, g_cnt = 0;
+    AMVP_RESULT rv;
+
+    if (!ctx) {
+        return AMVP_NO_CTX;
+    }
+    if (!obj || !schema) {
+        AMVP_LOG_ERR("No obj for handler operation");
+        return AMVP_MALFORMED_JSON;
+    }
+
+    alg_str = json_object_get_string(obj, "algorithm");
+    if (!alg_str) {
+        AMVP_LOG_ERR("Server JSON missing 'algorithm'");
+        return AMVP_MISSING_ARG;
+    }
+    mode_str = json_object_get_string(obj, "mode");
+    if (mode_str) {
+        alg_id = amvp_lookup_cipher_w_mode_index(alg_str, mode_str);
+    } else {
+        alg_id = amvp_lookup_cipher_index(alg_str);
+    }
+    if (!alg_id) {
+        AMVP_LOG_ERR("unsupported algorithm (%s)", alg_str);
+        return AMVP_UNSUPPORTED_OP;
+    }
+    cap = amvp_locate_cap_entry(ctx, alg_id);
+    if (!cap) {
+        AMVP_LOG_ERR("AMVP server requesting unsupported capability %s : %d.", alg_str, alg_id);
+        return AMVP_UNSUPPORTED_OP;
+    }
+    if (cap->cap_type != schema->cap_type) {
+        AMVP_LOG_ERR("Server JSON invalid 'algorithm' or 'mode'");
+        return AMVP_INVALID_ARG;
+    }
+
+    groups = json_object_get_array(obj, "testGroups");
+    if (!groups) {
+        AMVP_LOG_ERR("Failed to include testGroups. ");
+        return AMVP_MISSING_ARG;
+    }
+
+    /*
+     * Start to build the JSON response
+     */
+    w = &ctx->kat_writer;
+    rv = amvp_jw_begin_vs_rsp(ctx, alg_str, schema->rsp_mode);
+    if (rv != AMVP_SUCCESS) {
+        AMVP_LOG_ERR("Failed to setup json response");
+        goto err;
+    }
+
+    g_cnt = json_array_get_count(groups);
+    for (i = 0; i < g_cnt; i++) {
+        rv = amvp_kat_run_group(ctx, cap, alg_id, schema, json_array_get_object(groups, i), w);
+        if (rv != AMVP_SUCCESS) {
+            goto err;
+        }
+    }
+
+    rv = amvp_jw_end_vs_rsp(ctx);
+    if (rv != AMVP_SUCCESS) {
+        AMVP_LOG_ERR("JSON output failure in %s", alg_str);
+        goto err;
+    }
+    /* Only log the response if it all stayed in memory, w->buf is just its tail otherwise */
+    if (AMVP_LOG_ENABLED(AMVP_LOG_LVL_VERBOSE) && !w->spilled) {
+        AMVP_LOG_VERBOSE("\n\n%s\n\n", w->buf);
+    }
+
+err:
+    /* The buffers are only needed until the response is written */
+    amvp_arena_reset(&ctx->tc_arena);
+    if (rv != AMVP_SUCCESS && w) {
+        amvp_jw_reset(w);
+    }
+    return rv;
+}
@@ -17,6 +17,16 @@
 #include "parson.h"
 #include "safe_lib.h"
 
+/*
+ * A group's fixedInfoPattern compiled from its kdfConfiguration. It is parsed
+ * once per test group and shared read-only by every test case in that group.
+ */
+typedef struct amvp_kda_info_pattern_t {
+    AMVP_KDA_PATTERN_CANDIDATE cand[AMVP_KDA_PATTERN_MAX];
+    unsigned char literal[AMVP_KDA_PATTERN_LITERAL_BYTE_MAX];
+    int literal_len;
+} AMVP_KDA_INFO_PATTERN;
+
 /*
  * After the test case has been processed by the DUT, the results
  * need to be JSON formated to be included in the vector set results
@@ -122,7 +132,7 @@ static AMVP_RESULT amvp_kda_onestep_init_tc(AMVP_CTX *ctx,
                                              const int saltLen,
                                              AMVP_KDA_MAC_SALT_METHOD saltMethod,
                                              AMVP_KDA_ENCODING encoding,
-                                             AMVP_KDA_PATTERN_CANDIDATE *fixedArr,
+                                             const AMVP_KDA_INFO_PATTERN *pattern,
                                              AMVP_KDA_TEST_TYPE test_type) {
     AMVP_RESULT rv;
 
@@ -133,11 +143,16 @@ static AMVP_RESULT amvp_kda_onestep_init_tc(AMVP_CTX *ctx,
     stc->encoding = encoding;
     stc->saltMethod = saltMethod;
 
-    if (memcpy_s(stc->fixedInfoPattern, AMVP_KDA_PATTERN_MAX * sizeof(int), fixedArr, AMVP_KDA_PATTERN_MAX * sizeof(int))) {
+    if (memcpy_s(stc->fixedInfoPattern, sizeof(stc->fixedInfoPattern), pattern->cand, sizeof(pattern->cand))) {
         AMVP_LOG_ERR("Error copying array of fixedInfoPattern candidates into test case structure");
         rv = AMVP_MALLOC_FAIL;
         return rv;
     } 
+    if (pattern->literal_len) {
+        /* Points into the group's pattern; not owned by the test case */
+        stc->literalCandidate = (unsigned char *)pattern->literal;
+        stc->literalLen = pattern->literal_len;
+    }
     if (salt) {
         stc->salt = calloc(1, AMVP_KDA_SALT_BYTE_MAX);
         if (!stc->salt) { return AMVP_MALLOC_FAIL; }
@@ -315,7 +330,7 @@ static AMVP_RESULT amvp_kda_twostep_init_tc(AMVP_CTX *ctx,
                                              AMVP_KDF108_MODE kdfMode,
                                              AMVP_KDF108_FIXED_DATA_ORDER_VAL counterLocation,
                                              AMVP_KDA_ENCODING encoding,
-                                             AMVP_KDA_PATTERN_CANDIDATE *fixedArr,
+                                             const AMVP_KDA_INFO_PATTERN *pattern,
                                              AMVP_KDA_TEST_TYPE test_type) {
     AMVP_RESULT rv;
 
@@ -330,11 +345,16 @@ static AMVP_RESULT amvp_kda_twostep_init_tc(AMVP_CTX *ctx,
     stc->counterLen = counterLen;
     stc->uses_hybrid_secret = hybrid_secret;
 
-    if (memcpy_s(stc->fixedInfoPattern, AMVP_KDA_PATTERN_MAX * sizeof(int), fixedArr, AMVP_KDA_PATTERN_MAX * sizeof(int))) {
+    if (memcpy_s(stc->fixedInfoPattern, sizeof(stc->fixedInfoPattern), pattern->cand, sizeof(pattern->cand))) {
         AMVP_LOG_ERR("Error copying array of fixedInfoPattern candidates into test case structure");
         rv = AMVP_MALLOC_FAIL;
         return rv;
     } 
+    if (pattern->literal_len) {
+        /* Points into the group's pattern; not owned by the test case */
+        stc->literalCandidate = (unsigned char *)pattern->literal;
+        stc->literalLen = pattern->literal_len;
+    }
 
     stc->salt = calloc(1, AMVP_KDA_SALT_BYTE_MAX);
     if (!stc->salt) { return AMVP_MALLOC_FAIL; }
@@ -476,7 +496,7 @@ static AMVP_RESULT amvp_kda_hkdf_init_tc(AMVP_CTX *ctx,
                                              const int saltLen,
                                              AMVP_KDA_MAC_SALT_METHOD saltMethod,
                                              AMVP_KDA_ENCODING encoding,
-                                             AMVP_KDA_PATTERN_CANDIDATE *fixedArr,
+                                             const AMVP_KDA_INFO_PATTERN *pattern,
                                              AMVP_KDA_TEST_TYPE test_type) {
     AMVP_RESULT rv;
 
@@ -488,11 +508,16 @@ static AMVP_RESULT amvp_kda_hkdf_init_tc(AMVP_CTX *ctx,
     stc->saltMethod = saltMethod;
     stc->uses_hybrid_secret = hybrid_secret;
 
-    if (memcpy_s(stc->fixedInfoPattern, AMVP_KDA_PATTERN_MAX * sizeof(int), fixedArr, AMVP_KDA_PATTERN_MAX * sizeof(int))) {
+    if (memcpy_s(stc->fixedInfoPattern, sizeof(stc->fixedInfoPattern), pattern->cand, sizeof(pattern->cand))) {
         AMVP_LOG_ERR("Error copying array of fixedInfoPattern candidates into test case structure");
         rv = AMVP_MALLOC_FAIL;
         return rv;
     } 
+    if (pattern->literal_len) {
+        /* Points into the group's pattern; not owned by the test case */
+        stc->literalCandidate = (unsigned char *)pattern->literal;
+        stc->literalLen = pattern->literal_len;
+    }
 
     stc->salt = calloc(1, AMVP_KDA_SALT_BYTE_MAX);
     if (!stc->salt) { return AMVP_MALLOC_FAIL; }
@@ -613,7 +638,6 @@ static AMVP_RESULT amvp_kda_release_tc(AMVP_CIPHER cipher, AMVP_TEST_CASE *tc) {
         if (stc->salt) free(stc->salt);
         if (stc->z) free(stc->z);
         if (stc->t) free(stc->t);
-        if (stc->literalCandidate) free(stc->literalCandidate);
         if (stc->algorithmId) free(stc->algorithmId);
         if (stc->label) free(stc->label);
         if (stc->context) free(stc->context);
@@ -629,7 +653,6 @@ static AMVP_RESULT amvp_kda_release_tc(AMVP_CIPHER cipher, AMVP_TEST_CASE *tc) {
         if (stc->salt) free(stc->salt);
         if (stc->z) free(stc->z);
         if (stc->t) free(stc->t);
-        if (stc->literalCandidate) free(stc->literalCandidate);
         if (stc->algorithmId) free(stc->algorithmId);
         if (stc->label) free(stc->label);
         if (stc->context) free(stc->context);
@@ -646,7 +669,6 @@ static AMVP_RESULT amvp_kda_release_tc(AMVP_CIPHER cipher, AMVP_TEST_CASE *tc) {
         if (stc->iv) free (stc->iv);
         if (stc->z) free(stc->z);
         if (stc->t) free(stc->t);
-        if (stc->literalCandidate) free(stc->literalCandidate);
         if (stc->algorithmId) free(stc->algorithmId);
         if (stc->label) free(stc->label);
         if (stc->context) free(stc->context);
@@ -675,7 +697,7 @@ static AMVP_KDA_TEST_TYPE read_test_type(const char *str) {
     return 0;
 }
 
-AMVP_KDA_PATTERN_CANDIDATE cmp_pattern_str(AMVP_CTX *ctx, AMVP_CIPHER cipher, const char *str, AMVP_TEST_CASE *tc) {
+static AMVP_KDA_PATTERN_CANDIDATE cmp_pattern_str(AMVP_CTX *ctx, const char *str, AMVP_KDA_INFO_PATTERN *pattern) {
     //size of (preprocessor string) includes null terminator
     AMVP_RESULT rv =  AMVP_SUCCESS;
     char *tmp = NULL, *lit = NULL, *token = NULL;
@@ -740,21 +762,7 @@ AMVP_KDA_PATTERN_CANDIDATE cmp_pattern_str(AMVP_CTX *ctx, AMVP_CIPHER cipher, co
                 AMVP_LOG_ERR("Patttern literal too long");
                 goto err;
             }
-            if (cipher == AMVP_KDA_HKDF) {
-                tc->tc.kda_hkdf->literalCandidate = calloc(AMVP_KDA_PATTERN_LITERAL_BYTE_MAX, 1);
-                if (!tc->tc.kda_hkdf->literalCandidate) {
-                    AMVP_LOG_ERR("Failed to allocate memory when setting literal pattern");
-                    goto err;
-                }
-                rv = amvp_hexstr_to_bin(token, tc->tc.kda_hkdf->literalCandidate, AMVP_KDA_PATTERN_LITERAL_BYTE_MAX, &(tc->tc.kda_hkdf->literalLen));
-            } else {
-                tc->tc.kda_onestep->literalCandidate = calloc(AMVP_KDA_PATTERN_LITERAL_BYTE_MAX, 1);
-                if (!tc->tc.kda_onestep->literalCandidate) {
-                    AMVP_LOG_ERR("Failed to allocate memory when setting literal pattern");
-                    goto err;
-                }
-                rv = amvp_hexstr_to_bin(token, tc->tc.kda_onestep->literalCandidate, AMVP_KDA_PATTERN_LITERAL_BYTE_MAX, &(tc->tc.kda_onestep->literalLen));
-            }
+            rv = amvp_hexstr_to_bin(token, pattern->literal, AMVP_KDA_PATTERN_LITERAL_BYTE_MAX, &(pattern->literal_len));
             if (rv != AMVP_SUCCESS) {
                 AMVP_LOG_ERR("Hex conversion failure (literal candidate)");
                 goto err;
@@ -770,75 +778,62 @@ err:
     return 0;
 }
 
-static AMVP_KDA_PATTERN_CANDIDATE* read_info_pattern(AMVP_CTX *ctx, AMVP_CIPHER cipher, const char *str, AMVP_TEST_CASE *tc) {
+/*
+ * Compile a fixedInfoPattern string ("uPartyInfo||vPartyInfo||...") into
+ * the group's pattern descriptor.
+ */
+static AMVP_RESULT read_info_pattern(AMVP_CTX *ctx, const char *str, AMVP_KDA_INFO_PATTERN *pattern) {
     AMVP_KDA_PATTERN_CANDIDATE currentCand;
-    char *cpy = NULL;
-    AMVP_KDA_PATTERN_CANDIDATE *rv = NULL;
+    char cpy[AMVP_KDA_PATTERN_REG_STR_MAX + 1];
     int hasUParty = 0, hasVParty = 0; //Currently, these are required
+    const char *token = NULL;
+    char *tmp = NULL;
+    int count = 0;
+
     if (!str) {
-        return NULL;
+        return AMVP_MALFORMED_JSON;
     }
     rsize_t len = strnlen_s(str, AMVP_KDA_PATTERN_REG_STR_MAX + 1);
     if (len > AMVP_KDA_PATTERN_REG_STR_MAX || len < 1) {
-        return NULL;
-    }
-    cpy = calloc(AMVP_KDA_PATTERN_REG_STR_MAX + 1, sizeof(char));
-    if (!cpy) {
-        AMVP_LOG_ERR("Failed to allocate memory in temp string while reading info pattern");
-        return NULL;
+        return AMVP_MALFORMED_JSON;
     }
-    if (strncpy_s(cpy, AMVP_KDA_PATTERN_REG_STR_MAX + 1, str, AMVP_KDA_PATTERN_REG_STR_MAX)) {
+    memzero_s(pattern, sizeof(AMVP_KDA_INFO_PATTERN));
+    if (strncpy_s(cpy, sizeof(cpy), str, AMVP_KDA_PATTERN_REG_STR_MAX)) {
         AMVP_LOG_ERR("Failed to copy string into temp holder for tokenization");
-
-    }
-    //we return this to be used in the test case struct, so we want it to survive the scope of this function
-    AMVP_KDA_PATTERN_CANDIDATE *arr = calloc(AMVP_KDA_PATTERN_MAX, sizeof(int));
-    if (!arr) {
-        AMVP_LOG_ERR("Failed to allocate memory for reading fixedInfoPattern");
-        goto err;
+        return AMVP_MALFORMED_JSON;
     }
-    const char *token = NULL;
-    char *tmp = NULL;
+
     token = strtok_s(cpy, &len, "||", &tmp);
-    int count = 0;
     if (!token) {
         AMVP_LOG_ERR("Server JSON invalid 'fixedInfoPattern'");
-        free(arr);
-        goto err;
+        return AMVP_MALFORMED_JSON;
     } 
 
     do {
         if (count >= AMVP_KDA_PATTERN_MAX) {
             AMVP_LOG_ERR("Pattern string has too many elements");
-            free(arr);
-            goto err;
+            return AMVP_MALFORMED_JSON;
         }
-        currentCand = cmp_pattern_str(ctx, cipher, token, tc);
+        currentCand = cmp_pattern_str(ctx, token, pattern);
         if (currentCand >= AMVP_KDA_PATTERN_MAX || currentCand <= AMVP_KDA_PATTERN_NONE) {
             AMVP_LOG_ERR("Invalid pattern candidate supplied by server JSON");
-            free(arr);
-            goto err;
-        } else {
-            if (currentCand == AMVP_KDA_PATTERN_UPARTYINFO) {
-                hasUParty = 1;
-            }
-            if (currentCand == AMVP_KDA_PATTERN_VPARTYINFO) {
-                hasVParty = 1;
-            }
-            arr[count] = currentCand;
+            return AMVP_MALFORMED_JSON;
+        }
+        if (currentCand == AMVP_KDA_PATTERN_UPARTYINFO) {
+            hasUParty = 1;
         }
+        if (currentCand == AMVP_KDA_PATTERN_VPARTYINFO) {
+            hasVParty = 1;
+        }
+        pattern->cand[count] = currentCand;
         count++;
         token = strtok_s(NULL, &len, "||", &tmp);
     } while(token);
 
     if (!hasUParty || !hasVParty) {
-        free(arr);
-        goto err;
+        return AMVP_MALFORMED_JSON;
     }
-    rv = arr;
-err:
-    if (cpy) free(cpy);
-    return rv;
+    return AMVP_SUCCESS;
 }
 
 static AMVP_KDA_ENCODING read_encoding_type(const char* str) {
@@ -904,7 +899,7 @@ static AMVP_RESULT amvp_kda_process(AMVP_CTX *ctx,
     AMVP_RESULT rv;
     const char *test_type_str = NULL;
     AMVP_KDA_TEST_TYPE test_type;
-    AMVP_KDA_PATTERN_CANDIDATE *arr = NULL;
+    AMVP_KDA_INFO_PATTERN pattern;
     AMVP_KDA_ENCODING encoding;
     AMVP_KDA_MAC_SALT_METHOD salt_method;
     AMVP_CAPS_LIST *kdfcap = NULL;
@@ -1027,6 +1022,11 @@ static AMVP_RESULT amvp_kda_process(AMVP_CTX *ctx,
             rv = AMVP_MALFORMED_JSON;
             goto err;
         }
+        if (read_info_pattern(ctx, pattern_str, &pattern) != AMVP_SUCCESS) {
+            AMVP_LOG_ERR("Invalid fixedInfoPattern provided by server");
+            rv = AMVP_MALFORMED_JSON;
+            goto err;
+        }
 
         encoding_str = json_object_get_string(configobj, "fixedInfoEncoding");
         encoding = read_encoding_type(encoding_str);
@@ -1181,13 +1181,6 @@ static AMVP_RESULT amvp_kda_process(AMVP_CTX *ctx,
             paramobj = json_object_get_object(testobj, "kdfParameter");
             tc_id = json_object_get_number(testobj, "tcId");
             salt = json_object_get_string(paramobj, "salt");
-          
-            arr = read_info_pattern(ctx, cipher, pattern_str, tc);
-            if (!arr || arr[0] <= AMVP_KDA_PATTERN_NONE || arr[0] > AMVP_KDA_PATTERN_MAX) {
-                AMVP_LOG_ERR("Invalid fixedInfoPattern provided by server");
-                rv = AMVP_MALFORMED_JSON;
-                goto err;
-            }
 
             //for onestep, salt only exists for HMAC aux functions
             if (cipher != AMVP_KDA_ONESTEP) {
@@ -1227,10 +1220,10 @@ static AMVP_RESULT amvp_kda_process(AMVP_CTX *ctx,
 
             //Read the array of pattern candidates, read specific JSON objects based on whats there
             for (k = 0; k < AMVP_KDA_PATTERN_MAX; k++) {
-                if (arr[k] >= AMVP_KDA_PATTERN_MAX || arr[k] <= AMVP_KDA_PATTERN_NONE) {
+                if (pattern.cand[k] >= AMVP_KDA_PATTERN_MAX || pattern.cand[k] <= AMVP_KDA_PATTERN_NONE) {
                     break;
                 }
-                switch (arr[k]) {                    
+                switch (pattern.cand[k]) {                    
                 case AMVP_KDA_PATTERN_UPARTYINFO:
                     upartyobj = json_object_get_object(testobj, "fixedInfoPartyU");
                     if (!upartyobj) {
@@ -1370,20 +1363,17 @@ static AMVP_RESULT amvp_kda_process(AMVP_CTX *ctx,
             if (cipher == AMVP_KDA_HKDF) {
                 rv = amvp_kda_hkdf_init_tc(ctx, tc->tc.kda_hkdf, tc_id, hmac_alg, hybrid_secret, salt, z, t, uparty, uephemeral,
                                             vparty, vephemeral, algid, context, label, dkm, l, saltLen,
-                                            salt_method, encoding, arr, test_type);
+                                            salt_method, encoding, &pattern, test_type);
             } else if (cipher == AMVP_KDA_ONESTEP) {
                 rv = amvp_kda_onestep_init_tc(ctx, tc->tc.kda_onestep, tc_id, aux_function, salt, z, t, uparty, uephemeral,
                                                 vparty, vephemeral, algid, context, label, dkm, l, saltLen,
-                                                salt_method, encoding, arr, test_type);
+                                                salt_method, encoding, &pattern, test_type);
             } else {
                 rv = amvp_kda_twostep_init_tc(ctx, tc->tc.kda_twostep, tc_id, mac_mode, hybrid_secret, salt, z, iv_str, t, uparty,
                                                 uephemeral, vparty, vephemeral, algid, context, label, dkm, l, saltLen, iv_len,
-                                                ctr_len, salt_method, kdf_mode, ctr_loc, encoding, arr, test_type);
+                                                ctr_len, salt_method, kdf_mode, ctr_loc, encoding, &pattern, test_type);
             }
 
-            if (arr) free(arr);
-            arr = NULL;
-
             if (rv != AMVP_SUCCESS) {
                 if (cipher == AMVP_KDA_HKDF) {
                     amvp_kda_release_tc(AMVP_KDA_HKDF, tc);
@@ -1396,7 +1386,7 @@ static AMVP_RESULT amvp_kda_process(AMVP_CTX *ctx,
                 goto err;
             }
             /* Process the current KAT test vector... */
-            if ((cap->crypto_handler)(tc)) {
+            if (amvp_crypto_call(ctx, cap, tc)) {
                 if (cipher == AMVP_KDA_HKDF) {
                     amvp_kda_release_tc(AMVP_KDA_HKDF, tc);
                 } else if (cipher == AMVP_KDA_ONESTEP) {
@@ -1454,13 +1444,11 @@ static AMVP_RESULT amvp_kda_process(AMVP_CTX *ctx,
             json_array_append_value(r_tarr, r_tval);
         }
         json_array_append_value(r_garr, r_gval);
-        if (arr) { free(arr); arr = NULL; }
     }
     rv = AMVP_SUCCESS;
 
 err:
     if (rv != AMVP_SUCCESS) {
-        if (arr) free(arr);
         json_value_free(r_gval);
     }
     return rv;
@@ -1549,9 +1537,11 @@ AMVP_RESULT amvp_kda_hkdf_kat_handler(AMVP_CTX *ctx, JSON_Object *obj) {
 
     json_array_append_value(reg_arry, r_vs_val);
 
-    json_result = json_serialize_to_string_pretty(ctx->kat_resp, NULL);
-    AMVP_LOG_VERBOSE("\n\n%s\n\n", json_result);
-    json_free_serialized_string(json_result);
+    if (AMVP_LOG_ENABLED(AMVP_LOG_LVL_VERBOSE)) {
+        json_result = json_serialize_to_string_pretty(ctx->kat_resp, NULL);
+        AMVP_LOG_VERBOSE("\n\n%s\n\n", json_result);
+        json_free_serialized_string(json_result);
+    }
     rv = AMVP_SUCCESS;
 
 err:
@@ -1645,9 +1635,11 @@ AMVP_RESULT amvp_kda_onestep_kat_handler(AMVP_CTX *ctx, JSON_Object *obj) {
 
     json_array_append_value(reg_arry, r_vs_val);
 
-    json_result = json_serialize_to_string_pretty(ctx->kat_resp, NULL);
-    AMVP_LOG_VERBOSE("\n\n%s\n\n", json_result);
-    json_free_serialized_string(json_result);
+    if (AMVP_LOG_ENABLED(AMVP_LOG_LVL_VERBOSE)) {
+        json_result = json_serialize_to_string_pretty(ctx->kat_resp, NULL);
+        AMVP_LOG_VERBOSE("\n\n%s\n\n", json_result);
+        json_free_serialized_string(json_result);
+    }
     rv = AMVP_SUCCESS;
 
 err:
@@ -1741,9 +1733,11 @@ AMVP_RESULT amvp_kda_twostep_kat_handler(AMVP_CTX *ctx, JSON_Object *obj) {
 
     json_array_append_value(reg_arry, r_vs_val);
 
-    json_result = json_serialize_to_string_pretty(ctx->kat_resp, NULL);
-    AMVP_LOG_VERBOSE("\n\n%s\n\n", json_result);
-    json_free_serialized_string(json_result);
+    if (AMVP_LOG_ENABLED(AMVP_LOG_LVL_VERBOSE)) {
+        json_result = json_serialize_to_string_pretty(ctx->kat_resp, NULL);
+        AMVP_LOG_VERBOSE("\n\n%s\n\n", json_result);
+        json_free_serialized_string(json_result);
+    }
     rv = AMVP_SUCCESS;
 
 err:
@@ -511,7 +511,7 @@ AMVP_RESULT amvp_kdf135_ikev1_kat_handler(AMVP_CTX *ctx, JSON_Object *obj) {
             }
 
             /* Process the current test vector... */
-            if ((cap->crypto_handler)(&tc)) {
+            if (amvp_crypto_call(ctx, cap, &tc)) {
                 AMVP_LOG_ERR("crypto module failed the KDF IKEv1 operation");
                 amvp_kdf135_ikev1_release_tc(&stc);
                 rv = AMVP_CRYPTO_MODULE_FAIL;
@@ -542,9 +542,11 @@ AMVP_RESULT amvp_kdf135_ikev1_kat_handler(AMVP_CTX *ctx, JSON_Object *obj) {
 
     json_array_append_value(reg_arry, r_vs_val);
 
-    json_result = json_serialize_to_string_pretty(ctx->kat_resp, NULL);
-    AMVP_LOG_VERBOSE("\n\n%s\n\n", json_result);
-    json_free_serialized_string(json_result);
+    if (AMVP_LOG_ENABLED(AMVP_LOG_LVL_VERBOSE)) {
+        json_result = json_serialize_to_string_pretty(ctx->kat_resp, NULL);
+        AMVP_LOG_VERBOSE("\n\n%s\n\n", json_result);
+        json_free_serialized_string(json_result);
+    }
     rv = AMVP_SUCCESS;
 
 err:
@@ -0,0 +1,324 @@
+/** @file */
+/*
+ * Copyright (c) 2021, Cisco Systems, Inc.
+ *
+ * Licensed under the Apache License 2.0 (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://github.com/cisco/libamvp/LICENSE
+ */
+
+/*
+ * Asynchronous log sink enabled by amvp_set_async_logging(). Messages are
+ * formatted by the thread that logs them straight into a slot of a bounded
+ * ring, and a drain thread hands them to the progress callback (or writes
+ * them as AMVP_LOG_RECORDs to a file) in batches, flushing once per batch.
+ *
+ * The ring is a bounded multi-producer queue: a producer claims a position
+ * by advancing head with a CAS and publishes the slot by storing its
+ * sequence number, so logging threads never take a lock. Only the drain
+ * thread consumes. When the ring is full a producer yields until the drain
+ * thread frees a slot, so messages are never dropped or reordered.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include "amvp.h"
+#include "amvp_lcl.h"
+#include "safe_lib.h"
+
+#if !defined _WIN32 && defined __GNUC__
+#define AMVP_HAVE_ASYNC_LOG
+#include <pthread.h>
+#include <sched.h>
+#include <sys/time.h>
+#endif
+
+#define AMVP_LOG_DRAIN_MS 20    /* How long the drain thread sleeps when the ring is empty */
+
+#ifdef AMVP_HAVE_ASYNC_LOG
+typedef struct amvp_log_slot_t {
+    unsigned long seq;          /* == position + 1 once published, position + nslots once free */
+    AMVP_LOG_LVL level;
+    unsigned long long timestamp_us;
+    unsigned int len;
+    char msg[AMVP_LOG_MAX_MSG_LEN + 1];
+} AMVP_LOG_SLOT;
+
+struct amvp_log_sink_t {
+    AMVP_CTX *ctx;
+    AMVP_LOG_SLOT *slots;
+    unsigned long mask;
+    unsigned long head;         /* Next position to claim, shared by producers */
+    unsigned long tail;         /* Next position to drain, drain thread only */
+    FILE *record_fp;            /* Write AMVP_LOG_RECORDs here instead of calling the callback */
+    pthread_t tid;
+    pthread_mutex_t lock;       /* Only for the drain thread's sleep */
+    pthread_cond_t cv;
+    int shutdown;
+};
+
+static unsigned long long amvp_log_now_us(void) {
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return (unsigned long long)tv.tv_sec * 1000000ULL + (unsigned long long)tv.tv_usec;
+}
+
+/*
+ * Hand every published slot to the callback or record file, then flush
+ * once. Returns the number of messages written.
+ */
+static int amvp_log_sink_drain(AMVP_LOG_SINK *sink) {
+    AMVP_CTX *ctx = sink->ctx;
+    AMVP_LOG_SLOT *slot = NULL;
+    AMVP_LOG_RECORD rec;
+    int cnt = 0;
+
+    while (1) {
+        slot = &sink->slots[sink->tail & sink->mask];
+        if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != sink->tail + 1) {
+            break;
+        }
+        if (sink->record_fp) {
+            rec.timestamp_us = slot->timestamp_us;
+            rec.level = slot->level;
+            rec.length = slot->len;
+            fwrite(&rec, sizeof(rec), 1, sink->record_fp);
+            fwrite(slot->msg, 1, slot->len, sink->record_fp);
+        } else if (ctx->test_progress_cb) {
+            ctx->test_progress_cb(slot->msg, slot->level);
+        }
+        __atomic_store_n(&slot->seq, sink->tail + sink->mask + 1, __ATOMIC_RELEASE);
+        sink->tail++;
+        cnt++;
+    }
+    if (cnt) {
+        if (sink->record_fp) {
+            fflush(sink->record_fp);
+        } else {
+            fflush(stdout);
+        }
+    }
+    return cnt;
+}
+
+static void *amvp_log_sink_main(void *arg) {
+    AMVP_LOG_SINK *sink = arg;
+    struct timespec ts;
+    struct timeval now;
+    int shutdown = 0;
+
+    while (1) {
+        if (amvp_log_sink_drain(sink)) {
+            continue;
+        }
+        if (shutdown) {
+            break;
+        }
+        gettimeofday(&now, NULL);
+        ts.tv_sec = now.tv_sec;
+        ts.tv_nsec = now.tv_usec * 1000 + AMVP_LOG_DRAIN_MS * 1000000L;
+        if (ts.tv_nsec >= 1000000000L) {
+            ts.tv_sec++;
+            ts.tv_nsec -= 1000000000L;
+        }
+        pthread_mutex_lock(&sink->lock);
+        if (!sink->shutdown) {
+            pthread_cond_timedwait(&sink->cv, &sink->lock, &ts);
+        }
+        /* One more pass after shutdown picks up anything logged before it */
+        shutdown = sink->shutdown;
+        pthread_mutex_unlock(&sink->lock);
+    }
+    return NULL;
+}
+
+/*
+ * Claims the next slot for a message, waiting for the drain thread if the
+ * ring is full. The message is written to slot->msg and published with
+ * amvp_log_sink_commit().
+ */
+static AMVP_LOG_SLOT *amvp_log_sink_claim(AMVP_LOG_SINK *sink, unsigned long *pos_out) {
+    AMVP_LOG_SLOT *slot = NULL;
+    unsigned long pos = __atomic_load_n(&sink->head, __ATOMIC_RELAXED);
+    long dif = 0;
+
+    while (1) {
+        slot = &sink->slots[pos & sink->mask];
+        dif = (long)(__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) - pos);
+        if (dif == 0) {
+            if (__atomic_compare_exchange_n(&sink->head, &pos, pos + 1, 0,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                break;
+            }
+        } else if (dif < 0) {
+            /* Full, let the drain thread catch up */
+            pthread_cond_signal(&sink->cv);
+            sched_yield();
+            pos = __atomic_load_n(&sink->head, __ATOMIC_RELAXED);
+        } else {
+            pos = __atomic_load_n(&sink->head, __ATOMIC_RELAXED);
+        }
+    }
+    *pos_out = pos;
+    return slot;
+}
+
+static void amvp_log_sink_commit(AMVP_LOG_SLOT *slot, unsigned long pos) {
+    __atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+}
+
+static void amvp_log_sink_destroy(AMVP_LOG_SINK *sink) {
+    pthread_mutex_lock(&sink->lock);
+    sink->shutdown = 1;
+    pthread_cond_signal(&sink->cv);
+    pthread_mutex_unlock(&sink->lock);
+    pthread_join(sink->tid, NULL);
+
+    pthread_cond_destroy(&sink->cv);
+    pthread_mutex_destroy(&sink->lock);
+    if (sink->record_fp) fclose(sink->record_fp);
+    free(sink->slots);
+    free(sink);
+}
+#endif
+
+/*
+ * Formats a message into the sink's next slot. Returns 0 if ctx has no
+ * sink, in which case the caller logs the message synchronously.
+ */
+int amvp_log_sink_put(AMVP_CTX *ctx, AMVP_LOG_LVL level, const char *func, int line, const char *fmt, va_list args) {
+#ifdef AMVP_HAVE_ASYNC_LOG
+    AMVP_LOG_SINK *sink = ctx->log_sink;
+    AMVP_LOG_SLOT *slot = NULL;
+    unsigned long pos = 0;
+    int len = 0, ret = 0;
+
+    if (!sink) {
+        return 0;
+    }
+    slot = amvp_log_sink_claim(sink, &pos);
+    if (ctx->debug) {
+        len = snprintf(slot->msg, AMVP_LOG_MAX_MSG_LEN, "[%s:%d]: ", func, line);
+    }
+    if (fmt) {
+        ret = vsnprintf(slot->msg + len, AMVP_LOG_MAX_MSG_LEN + 1 - len, fmt, args);
+    }
+    if (ret < 0 || ret >= AMVP_LOG_MAX_MSG_LEN + 1 - len) {
+        memcpy_s(slot->msg + AMVP_LOG_MAX_MSG_LEN - AMVP_LOG_TRUNCATED_STR_LEN,
+                 AMVP_LOG_TRUNCATED_STR_LEN,
+                 AMVP_LOG_TRUNCATED_STR, AMVP_LOG_TRUNCATED_STR_LEN);
+        len = AMVP_LOG_MAX_MSG_LEN;
+    } else {
+        len += ret;
+    }
+    slot->msg[len] = '\0';
+    slot->len = len;
+    slot->level = level;
+    slot->timestamp_us = amvp_log_now_us();
+    amvp_log_sink_commit(slot, pos);
+    return 1;
+#else
+    (void)ctx;
+    (void)level;
+    (void)func;
+    (void)line;
+    (void)fmt;
+    (void)args;
+    return 0;
+#endif
+}
+
+/*
+ * Stops the drain thread of ctx's sink once everything queued so far has
+ * been written, and goes back to synchronous logging.
+ */
+void amvp_log_sink_free(AMVP_CTX *ctx) {
+    if (!ctx || !ctx->log_sink) {
+        return;
+    }
+#ifdef AMVP_HAVE_ASYNC_LOG
+    amvp_log_sink_destroy(ctx->log_sink);
+#endif
+    ctx->log_sink = NULL;
+}
+
+AMVP_RESULT amvp_set_async_logging(AMVP_CTX *ctx, int slots, const char *record_file) {
+#ifdef AMVP_HAVE_ASYNC_LOG
+    AMVP_LOG_SINK *sink = NULL;
+    unsigned long n = 1, i;
+#endif
+
+    if (!ctx) {
+        return AMVP_NO_CTX;
+    }
+    if (slots < 0 || slots > AMVP_MAX_LOG_SLOTS) {
+        return AMVP_INVALID_ARG;
+    }
+    if (ctx->async || ctx->session_group) {
+        /* Can't swap sinks under threads that may be logging */
+        return AMVP_UNSUPPORTED_OP;
+    }
+
+    amvp_log_sink_free(ctx);
+    if (!slots) {
+        return AMVP_SUCCESS;
+    }
+
+#ifndef AMVP_HAVE_ASYNC_LOG
+    (void)record_file;
+    AMVP_LOG_ERR("Asynchronous logging is not supported on this platform");
+    return AMVP_UNSUPPORTED_OP;
+#else
+    if (!record_file && !ctx->test_progress_cb) {
+        AMVP_LOG_ERR("Asynchronous logging needs a progress callback or a record file");
+        return AMVP_MISSING_ARG;
+    }
+
+    /* Round up to a power of 2 so positions map to slots with a mask */
+    while (n < (unsigned long)slots) {
+        n <<= 1;
+    }
+    sink = calloc(1, sizeof(AMVP_LOG_SINK));
+    if (!sink) {
+        return AMVP_MALLOC_FAIL;
+    }
+    sink->slots = calloc(n, sizeof(AMVP_LOG_SLOT));
+    if (!sink->slots) {
+        free(sink);
+        return AMVP_MALLOC_FAIL;
+    }
+    for (i = 0; i < n; i++) {
+        sink->slots[i].seq = i;
+    }
+    sink->mask = n - 1;
+    sink->ctx = ctx;
+
+    if (record_file) {
+        sink->record_fp = fopen(record_file, "wb");
+        if (!sink->record_fp) {
+            AMVP_LOG_ERR("Failed to open log record file %s", record_file);
+            free(sink->slots);
+            free(sink);
+            return AMVP_INVALID_ARG;
+        }
+    }
+
+    pthread_mutex_init(&sink->lock, NULL);
+    pthread_cond_init(&sink->cv, NULL);
+    if (pthread_create(&sink->tid, NULL, amvp_log_sink_main, sink)) {
+        AMVP_LOG_ERR("Failed to start log drain thread");
+        pthread_cond_destroy(&sink->cv);
+        pthread_mutex_destroy(&sink->lock);
+        if (sink->record_fp) fclose(sink->record_fp);
+        free(sink->slots);
+        free(sink);
+        return AMVP_INTERNAL_ERR;
+    }
+    ctx->log_sink = sink;
+    return AMVP_SUCCESS;
+#endif
+}
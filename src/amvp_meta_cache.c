@@ -0,0 +1,318 @@
+/** @file */
+/*
+ * Copyright (c) 2021, Cisco Systems, Inc.
+ *
+ * Licensed under the Apache License 2.0 (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://github.com/cisco/libamvp/LICENSE
+ */
+
+/*
+ * On-disk cache for the metadata lookups made by
+ * amvp_verify_fips_validation_metadata(), enabled with
+ * amvp_set_metadata_cache().
+ *
+ * Each entry is keyed by a query (the listing endpoint and its filters)
+ * and holds the page of the listing the resource was matched on, with the
+ * page's ETag and body. The next validation asks the server for that page
+ * with If-None-Match, and on a 304 matches against the cached body rather
+ * than paging through the listing again. See query_pages() in
+ * amvp_operating_env.c.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "amvp.h"
+#include "amvp_lcl.h"
+#include "parson.h"
+#include "safe_lib.h"
+
+struct amvp_meta_cache_t {
+    char *file;
+    AMVP_META_CACHE_ENTRY *entries;
+    int dirty;
+};
+
+static void amvp_meta_cache_entry_free(AMVP_META_CACHE_ENTRY *entry) {
+    if (entry->key) free(entry->key);
+    if (entry->page) free(entry->page);
+    if (entry->etag) free(entry->etag);
+    if (entry->body) free(entry->body);
+    free(entry);
+}
+
+static char *amvp_meta_cache_strdup(const char *str) {
+    char *copy = NULL;
+    size_t len;
+
+    if (!str) {
+        return NULL;
+    }
+    len = strnlen_s(str, AMVP_CURL_BUF_MAX);
+    copy = calloc(len + 1, sizeof(char));
+    if (copy) {
+        memcpy_s(copy, len + 1, str, len);
+    }
+    return copy;
+}
+
+static AMVP_RESULT amvp_meta_cache_load(AMVP_CTX *ctx, AMVP_META_CACHE *cache) {
+    JSON_Value *val = NULL;
+    JSON_Array *arr = NULL;
+    JSON_Object *obj = NULL;
+    AMVP_META_CACHE_ENTRY *entry = NULL;
+    const char *key = NULL, *etag = NULL, *body = NULL;
+    FILE *fp = NULL;
+    size_t i;
+
+    fp = fopen(cache->file, "r");
+    if (!fp) {
+        /* Nothing cached yet, the file is written when the session ends */
+        return AMVP_SUCCESS;
+    }
+    fclose(fp);
+
+    val = json_parse_file(cache->file);
+    arr = json_value_get_array(val);
+    if (!arr) {
+        AMVP_LOG_WARN("Ignoring malformed metadata cache %s", cache->file);
+        json_value_free(val);
+        return AMVP_SUCCESS;
+    }
+    for (i = 0; i < json_array_get_count(arr); i++) {
+        obj = json_array_get_object(arr, i);
+        key = json_object_get_string(obj, "key");
+        etag = json_object_get_string(obj, "etag");
+        body = json_object_get_string(obj, "body");
+        if (!key || !etag || !body) {
+            continue;
+        }
+        entry = calloc(1, sizeof(AMVP_META_CACHE_ENTRY));
+        if (!entry) {
+            json_value_free(val);
+            return AMVP_MALLOC_FAIL;
+        }
+        entry->key = amvp_meta_cache_strdup(key);
+        entry->page = amvp_meta_cache_strdup(json_object_get_string(obj, "page"));
+        entry->etag = amvp_meta_cache_strdup(etag);
+        entry->body = amvp_meta_cache_strdup(body);
+        entry->body_len = (int)strnlen_s(body, AMVP_CURL_BUF_MAX);
+        entry->next = cache->entries;
+        cache->entries = entry;
+        if (!entry->key || !entry->etag || !entry->body) {
+            json_value_free(val);
+            return AMVP_MALLOC_FAIL;
+        }
+    }
+    json_value_free(val);
+    AMVP_LOG_INFO("Loaded metadata cache %s", cache->file);
+    return AMVP_SUCCESS;
+}
+
+static AMVP_RESULT amvp_meta_cache_save(AMVP_CTX *ctx, AMVP_META_CACHE *cache) {
+    JSON_Value *val = NULL, *entry_val = NULL;
+    JSON_Object *obj = NULL;
+    AMVP_META_CACHE_ENTRY *entry = NULL;
+    AMVP_RESULT rv = AMVP_SUCCESS;
+
+    val = json_value_init_array();
+    if (!val) {
+        return AMVP_MALLOC_FAIL;
+    }
+    for (entry = cache->entries; entry; entry = entry->next) {
+        entry_val = json_value_init_object();
+        obj = json_value_get_object(entry_val);
+        json_object_set_string(obj, "key", entry->key);
+        if (entry->page) {
+            json_object_set_string(obj, "page", entry->page);
+        }
+        json_object_set_string(obj, "etag", entry->etag);
+        json_object_set_string(obj, "body", entry->body);
+        json_array_append_value(json_value_get_array(val), entry_val);
+    }
+    if (json_serialize_to_file(val, cache->file) != JSONSuccess) {
+        AMVP_LOG_ERR("Unable to write metadata cache %s", cache->file);
+        rv = AMVP_JSON_ERR;
+    } else {
+        cache->dirty = 0;
+    }
+    json_value_free(val);
+    return rv;
+}
+
+/*
+ * Builds the cache key for a query: the endpoint followed by the
+ * unescaped filters. Returns NULL if the memory could not be allocated.
+ */
+char *amvp_meta_cache_key(const char *endpoint, const AMVP_KV_LIST *parameters) {
+    const AMVP_KV_LIST *param = NULL;
+    char *key = NULL;
+    size_t len = 0, pos = 0, n = 0;
+
+    len = strnlen_s(endpoint, AMVP_ATTR_URL_MAX) + 1;
+    for (param = parameters; param; param = param->next) {
+        len += strnlen_s(param->key, AMVP_ATTR_URL_MAX) + strnlen_s(param->value, AMVP_ATTR_URL_MAX) + 1;
+    }
+    key = calloc(len, sizeof(char));
+    if (!key) {
+        return NULL;
+    }
+    n = strnlen_s(endpoint, AMVP_ATTR_URL_MAX);
+    memcpy_s(key, len, endpoint, n);
+    pos = n;
+    for (param = parameters; param; param = param->next) {
+        if (param != parameters) {
+            key[pos++] = '&';
+        }
+        n = strnlen_s(param->key, AMVP_ATTR_URL_MAX);
+        memcpy_s(key + pos, len - pos, param->key, n);
+        pos += n;
+        n = strnlen_s(param->value, AMVP_ATTR_URL_MAX);
+        memcpy_s(key + pos, len - pos, param->value, n);
+        pos += n;
+    }
+    key[pos] = '\0';
+    return key;
+}
+
+AMVP_META_CACHE_ENTRY *amvp_meta_cache_find(AMVP_CTX *ctx, const char *key) {
+    AMVP_META_CACHE_ENTRY *entry = NULL;
+    int diff = 1;
+
+    if (!ctx->meta_cache || !key) {
+        return NULL;
+    }
+    for (entry = ctx->meta_cache->entries; entry; entry = entry->next) {
+        strcmp_s(entry->key, AMVP_CURL_BUF_MAX, key, &diff);
+        if (!diff) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Remembers that the query key was matched on page (NULL for the query's
+ * first page), which the server tagged etag. Takes ownership of body.
+ */
+AMVP_RESULT amvp_meta_cache_store(AMVP_CTX *ctx, const char *key, const char *page,
+                                  const char *etag, char *body, int body_len) {
+    AMVP_META_CACHE_ENTRY *entry = NULL;
+    char *page_copy = NULL, *etag_copy = NULL;
+
+    if (!ctx->meta_cache || !key || !etag || !body) {
+        if (body) free(body);
+        return AMVP_SUCCESS;
+    }
+
+    entry = amvp_meta_cache_find(ctx, key);
+    if (!entry) {
+        entry = calloc(1, sizeof(AMVP_META_CACHE_ENTRY));
+        if (!entry) {
+            free(body);
+            return AMVP_MALLOC_FAIL;
+        }
+        entry->key = amvp_meta_cache_strdup(key);
+        entry->next = ctx->meta_cache->entries;
+        ctx->meta_cache->entries = entry;
+    }
+    /* Copy first, page and etag may be the entry's own */
+    page_copy = amvp_meta_cache_strdup(page);
+    etag_copy = amvp_meta_cache_strdup(etag);
+    if (entry->page) free(entry->page);
+    if (entry->etag) free(entry->etag);
+    if (entry->body) free(entry->body);
+    entry->page = page_copy;
+    entry->etag = etag_copy;
+    entry->body = body;
+    entry->body_len = body_len;
+    ctx->meta_cache->dirty = 1;
+    if (!entry->key || !entry->etag || (page && !entry->page)) {
+        return AMVP_MALLOC_FAIL;
+    }
+    return AMVP_SUCCESS;
+}
+
+/*
+ * Puts the cached body of entry in ctx->curl_buf, as if the server had
+ * sent it, after the server answered 304 Not Modified.
+ */
+AMVP_RESULT amvp_meta_cache_load_body(AMVP_CTX *ctx, const AMVP_META_CACHE_ENTRY *entry) {
+    char *tmp = NULL;
+
+    if (ctx->curl_buf_size < entry->body_len + 1) {
+        tmp = realloc(ctx->curl_buf, entry->body_len + 1);
+        if (!tmp) {
+            return AMVP_MALLOC_FAIL;
+        }
+        ctx->curl_buf = tmp;
+        ctx->curl_buf_size = entry->body_len + 1;
+    }
+    memcpy_s(ctx->curl_buf, ctx->curl_buf_size, entry->body, entry->body_len);
+    ctx->curl_buf[entry->body_len] = '\0';
+    ctx->curl_read_ctr = entry->body_len;
+    return AMVP_SUCCESS;
+}
+
+/*
+ * Writes out the cache if anything changed since it was loaded or last
+ * written.
+ */
+AMVP_RESULT amvp_meta_cache_flush(AMVP_CTX *ctx) {
+    if (!ctx->meta_cache || !ctx->meta_cache->dirty) {
+        return AMVP_SUCCESS;
+    }
+    return amvp_meta_cache_save(ctx, ctx->meta_cache);
+}
+
+void amvp_meta_cache_free(AMVP_CTX *ctx) {
+    AMVP_META_CACHE_ENTRY *entry = NULL, *next = NULL;
+
+    if (!ctx || !ctx->meta_cache) {
+        return;
+    }
+    amvp_meta_cache_flush(ctx);
+    for (entry = ctx->meta_cache->entries; entry; entry = next) {
+        next = entry->next;
+        amvp_meta_cache_entry_free(entry);
+    }
+    free(ctx->meta_cache->file);
+    free(ctx->meta_cache);
+    ctx->meta_cache = NULL;
+}
+
+AMVP_RESULT amvp_set_metadata_cache(AMVP_CTX *ctx, const char *cache_file) {
+    AMVP_META_CACHE *cache = NULL;
+    AMVP_RESULT rv = AMVP_SUCCESS;
+
+    if (!ctx) {
+        return AMVP_NO_CTX;
+    }
+    amvp_meta_cache_free(ctx);
+    if (!cache_file) {
+        return AMVP_SUCCESS;
+    }
+    if (strnlen_s(cache_file, AMVP_JSON_FILENAME_MAX + 1) > AMVP_JSON_FILENAME_MAX) {
+        AMVP_LOG_ERR("Provided cache_file length > max(%d)", AMVP_JSON_FILENAME_MAX);
+        return AMVP_INVALID_ARG;
+    }
+
+    cache = calloc(1, sizeof(AMVP_META_CACHE));
+    if (!cache) {
+        return AMVP_MALLOC_FAIL;
+    }
+    cache->file = amvp_meta_cache_strdup(cache_file);
+    if (!cache->file) {
+        free(cache);
+        return AMVP_MALLOC_FAIL;
+    }
+    ctx->meta_cache = cache;
+    rv = amvp_meta_cache_load(ctx, cache);
+    if (rv != AMVP_SUCCESS) {
+        cache->dirty = 0;
+        amvp_meta_cache_free(ctx);
+    }
+    return rv;
+}
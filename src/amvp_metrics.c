@@ -0,0 +1,1054 @@
+/** @file */
+/*
+ * Copyright (c) 2021, Cisco Systems, Inc.
+ *
+ * Licensed under the Apache License 2.0 (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://github.com/cisco/libamvp/LICENSE
+ */
+
+/*
+ * Per vector set timing and counters, enabled with amvp_set_metrics().
+ *
+ * Each vector set gets a record, created the first time it is downloaded
+ * and kept in request order. The transport adds download and upload times
+ * and byte counts to it, and the thread processing the set adds parse,
+ * handler and crypto times through ctx->metrics->cur. Those phases never
+ * overlap for one set, and the hand-offs between threads already go through
+ * the pipeline's lock, so only the record list itself needs locking.
+ *
+ * Memory is counted by the amvp_mem_*() wrappers, which the arenas use for
+ * their blocks, and by a hook put in front of parson's allocator while any
+ * context has metrics on. The counters are kept per thread, so sets being
+ * processed on other threads, by this context or another one, don't show
+ * up in each other's numbers. A set gets the difference between
+ * amvp_metrics_begin() and amvp_metrics_end(), and the phases in between
+ * are marked by the callers with amvp_mem_mark() and
+ * amvp_metrics_mem_phase().
+ *
+ * The transport also hands over libcurl's timing breakdown of each request
+ * it makes, kept in finishing order for amvp_get_net_timing() and the HAR
+ * trace, and summed up into the set the request was for.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <pthread.h>
+#endif
+
+/*
+ * Live heap is counted with the size the allocator actually reserved for
+ * each block, so a free() doesn't need to know how big the block was asked
+ * to be. Where that can't be looked up only the allocations are counted.
+ */
+#if defined _WIN32
+#include <malloc.h>
+#define AMVP_MEM_SIZE(ptr) _msize(ptr)
+#elif defined __APPLE__
+#include <malloc/malloc.h>
+#define AMVP_MEM_SIZE(ptr) malloc_size(ptr)
+#elif defined __GLIBC__
+#include <malloc.h>
+#define AMVP_MEM_SIZE(ptr) malloc_usable_size(ptr)
+#else
+#define AMVP_MEM_SIZE(ptr) ((void)(ptr), 0)
+#endif
+
+#include "amvp.h"
+#include "amvp_lcl.h"
+#include "parson.h"
+#include "safe_lib.h"
+
+#if defined _MSC_VER
+#define AMVP_MEM_THREAD_LOCAL __declspec(thread)
+#else
+#define AMVP_MEM_THREAD_LOCAL __thread
+#endif
+
+#if defined __GNUC__
+#define AMVP_MEM_USERS() __atomic_load_n(&amvp_mem_users, __ATOMIC_RELAXED)
+#else
+#define AMVP_MEM_USERS() (amvp_mem_users)
+#endif
+
+/* Contexts with metrics on, changed under amvp_mem_lock */
+static int amvp_mem_users;
+
+/* parson's allocator before the first context turned metrics on */
+static JSON_Malloc_Function amvp_mem_json_malloc_prev;
+static JSON_Free_Function amvp_mem_json_free_prev;
+
+#ifndef _WIN32
+static pthread_mutex_t amvp_mem_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+/* Allocation counters of the calling thread */
+static AMVP_MEM_THREAD_LOCAL struct {
+    long long cur;              /* Live bytes, relative to the last amvp_metrics_begin() */
+    long long peak;             /* Highest cur since the last amvp_metrics_begin() */
+    unsigned long long allocs;
+    unsigned long long alloc_bytes;
+} amvp_mem;
+
+struct amvp_metrics_t {
+    AMVP_VS_METRICS_REC *head;
+    AMVP_VS_METRICS_REC *tail;
+    int count;
+    char *json_file;            /* Written at the end of amvp_run(), if set */
+    AMVP_VS_METRICS_REC *cur;   /* Set being parsed and run by the crypto handlers */
+    AMVP_VS_METRICS_REC *net;   /* Set the serial GET_VS/POST_VS_RESP requests are for */
+    AMVP_NET_TIMING *reqs;      /* Every request made, see amvp_metrics_request() */
+    int req_count;
+    int req_alloc;
+    char *har_file;             /* Set by amvp_set_net_trace() */
+#ifndef _WIN32
+    pthread_mutex_t lock;
+#endif
+};
+
+/*
+ * Milliseconds on a monotonic clock
+ */
+double amvp_metrics_now(void) {
+#ifdef _WIN32
+    LARGE_INTEGER freq, cnt;
+
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&cnt);
+    return (double)cnt.QuadPart * 1000.0 / (double)freq.QuadPart;
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1000.0 + (double)ts.tv_nsec / 1000000.0;
+#endif
+}
+
+/*
+ * Seconds since the epoch, to the millisecond
+ */
+static double amvp_metrics_wall_now(void) {
+#ifdef _WIN32
+    FILETIME ft;
+    ULARGE_INTEGER t;
+
+    GetSystemTimeAsFileTime(&ft);
+    t.LowPart = ft.dwLowDateTime;
+    t.HighPart = ft.dwHighDateTime;
+    /* 100ns ticks since 1601 */
+    return (double)(t.QuadPart - 116444736000000000ULL) / 10000000.0;
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1000000000.0;
+#endif
+}
+
+/*
+ * live is the size of the block as the allocator reserved it, or 0 when
+ * that isn't known
+ */
+static void amvp_mem_count(size_t size, long long live) {
+    amvp_mem.allocs++;
+    amvp_mem.alloc_bytes += size;
+    amvp_mem.cur += live;
+    if (amvp_mem.cur > amvp_mem.peak) {
+        amvp_mem.peak = amvp_mem.cur;
+    }
+}
+
+void *amvp_mem_malloc(size_t size) {
+    void *ptr = malloc(size);
+
+    if (ptr && AMVP_MEM_USERS()) {
+        amvp_mem_count(size, (long long)AMVP_MEM_SIZE(ptr));
+    }
+    return ptr;
+}
+
+void *amvp_mem_calloc(size_t num, size_t size) {
+    void *ptr = calloc(num, size);
+
+    if (ptr && AMVP_MEM_USERS()) {
+        amvp_mem_count(num * size, (long long)AMVP_MEM_SIZE(ptr));
+    }
+    return ptr;
+}
+
+void *amvp_mem_realloc(void *ptr, size_t size) {
+    long long old = 0;
+    void *out = NULL;
+
+    if (ptr && AMVP_MEM_USERS()) {
+        old = (long long)AMVP_MEM_SIZE(ptr);
+    }
+    out = realloc(ptr, size);
+    if (out && AMVP_MEM_USERS()) {
+        amvp_mem.cur -= old;
+        amvp_mem_count(size, (long long)AMVP_MEM_SIZE(out));
+    }
+    return out;
+}
+
+char *amvp_mem_strdup(const char *str) {
+    char *out = strdup(str);
+
+    if (out && AMVP_MEM_USERS()) {
+        amvp_mem_count(strlen(out) + 1, (long long)AMVP_MEM_SIZE(out));
+    }
+    return out;
+}
+
+void amvp_mem_free(void *ptr) {
+    if (ptr && AMVP_MEM_USERS()) {
+        amvp_mem.cur -= (long long)AMVP_MEM_SIZE(ptr);
+    }
+    free(ptr);
+}
+
+/*
+ * Put in front of whatever allocator parson had. Block sizes can only be
+ * looked up when that is the C library's.
+ */
+static void *amvp_mem_json_malloc(size_t size) {
+    void *ptr = amvp_mem_json_malloc_prev(size);
+
+    if (ptr) {
+        amvp_mem_count(size, amvp_mem_json_malloc_prev == malloc ? (long long)AMVP_MEM_SIZE(ptr) : 0);
+    }
+    return ptr;
+}
+
+static void amvp_mem_json_free(void *ptr) {
+    if (ptr && amvp_mem_json_free_prev == free) {
+        amvp_mem.cur -= (long long)AMVP_MEM_SIZE(ptr);
+    }
+    amvp_mem_json_free_prev(ptr);
+}
+
+/*
+ * The first context to turn metrics on puts the hook in front of parson's
+ * allocator, and the last one to turn them off puts the old one back,
+ * unless the application has installed another since.
+ */
+static void amvp_mem_users_add(int n) {
+    JSON_Malloc_Function malloc_fun = NULL;
+    JSON_Free_Function free_fun = NULL;
+
+#ifndef _WIN32
+    pthread_mutex_lock(&amvp_mem_lock);
+#endif
+    if (n > 0 && amvp_mem_users == 0) {
+        json_get_allocation_functions(&amvp_mem_json_malloc_prev, &amvp_mem_json_free_prev);
+        json_set_allocation_functions(amvp_mem_json_malloc, amvp_mem_json_free);
+    }
+    amvp_mem_users += n;
+    if (n < 0 && amvp_mem_users == 0) {
+        json_get_allocation_functions(&malloc_fun, &free_fun);
+        if (malloc_fun == amvp_mem_json_malloc && free_fun == amvp_mem_json_free) {
+            json_set_allocation_functions(amvp_mem_json_malloc_prev, amvp_mem_json_free_prev);
+        }
+    }
+#ifndef _WIN32
+    pthread_mutex_unlock(&amvp_mem_lock);
+#endif
+}
+
+void amvp_mem_mark(AMVP_MEM_MARK *mark) {
+    mark->allocs = amvp_mem.allocs;
+    mark->alloc_bytes = amvp_mem.alloc_bytes;
+}
+
+/*
+ * Charges what was allocated since mark to a phase of the set
+ */
+void amvp_metrics_mem_phase(AMVP_VS_METRICS_REC *rec, AMVP_METRICS_PHASE phase, const AMVP_MEM_MARK *mark) {
+    AMVP_MEM_MARK now;
+    unsigned long long bytes = 0;
+    int allocs = 0;
+
+    if (!rec) {
+        return;
+    }
+    amvp_mem_mark(&now);
+    allocs = (int)(now.allocs - mark->allocs);
+    bytes = now.alloc_bytes - mark->alloc_bytes;
+    switch (phase) {
+    case AMVP_METRICS_PARSE:
+        rec->m.parse_allocs += allocs;
+        rec->m.parse_alloc_bytes += bytes;
+        break;
+    case AMVP_METRICS_HANDLER:
+        rec->m.handler_allocs += allocs;
+        rec->m.handler_alloc_bytes += bytes;
+        break;
+    case AMVP_METRICS_UPLOAD:
+    default:
+        rec->m.upload_allocs += allocs;
+        rec->m.upload_alloc_bytes += bytes;
+        break;
+    }
+}
+
+/*
+ * Returns the record for vsid_url, creating it if this is the first time
+ * the set is seen. Returns NULL when metrics are off.
+ */
+AMVP_VS_METRICS_REC *amvp_metrics_vs(AMVP_CTX *ctx, const char *vsid_url) {
+    AMVP_METRICS *metrics = ctx->metrics;
+    AMVP_VS_METRICS_REC *rec = NULL;
+    int diff = 1;
+
+    if (!metrics || !vsid_url) {
+        return NULL;
+    }
+#ifndef _WIN32
+    pthread_mutex_lock(&metrics->lock);
+#endif
+    for (rec = metrics->head; rec; rec = rec->next) {
+        strcmp_s(rec->vsid_url, AMVP_ATTR_URL_MAX, vsid_url, &diff);
+        if (!diff) {
+            break;
+        }
+    }
+    if (!rec) {
+        rec = calloc(1, sizeof(AMVP_VS_METRICS_REC));
+        if (rec) {
+            rec->vsid_url = strdup(vsid_url);
+            if (!rec->vsid_url) {
+                free(rec);
+                rec = NULL;
+            }
+        }
+        if (rec) {
+            if (metrics->tail) {
+                metrics->tail->next = rec;
+            } else {
+                metrics->head = rec;
+            }
+            metrics->tail = rec;
+            metrics->count++;
+        }
+    }
+#ifndef _WIN32
+    pthread_mutex_unlock(&metrics->lock);
+#endif
+    return rec;
+}
+
+AMVP_VS_METRICS_REC *amvp_metrics_begin(AMVP_CTX *ctx, const char *vsid_url) {
+    AMVP_VS_METRICS_REC *rec = amvp_metrics_vs(ctx, vsid_url);
+
+    if (rec) {
+        ctx->metrics->cur = rec;
+        amvp_mem_mark(&rec->mem);
+        amvp_mem.cur = 0;
+        amvp_mem.peak = 0;
+    }
+    return rec;
+}
+
+void amvp_metrics_end(AMVP_CTX *ctx) {
+    AMVP_VS_METRICS_REC *rec = amvp_metrics_cur(ctx);
+    AMVP_MEM_MARK now;
+    long long cur = 0, peak = 0;
+
+    if (!rec) {
+        return;
+    }
+    amvp_mem_mark(&now);
+    rec->m.allocs += (int)(now.allocs - rec->mem.allocs);
+    rec->m.alloc_bytes += now.alloc_bytes - rec->mem.alloc_bytes;
+    /* Freeing blocks from before the set can take cur below 0 */
+    cur = amvp_mem.cur;
+    peak = amvp_mem.peak;
+    rec->m.mem_bytes = cur > 0 ? (unsigned long long)cur : 0;
+    if (peak > 0 && (unsigned long long)peak > rec->m.mem_peak_bytes) {
+        rec->m.mem_peak_bytes = (unsigned long long)peak;
+    }
+    ctx->metrics->cur = NULL;
+}
+
+AMVP_VS_METRICS_REC *amvp_metrics_cur(AMVP_CTX *ctx) {
+    return ctx->metrics ? ctx->metrics->cur : NULL;
+}
+
+void amvp_metrics_set_net(AMVP_CTX *ctx, AMVP_VS_METRICS_REC *rec) {
+    if (ctx->metrics) {
+        ctx->metrics->net = rec;
+    }
+}
+
+AMVP_VS_METRICS_REC *amvp_metrics_get_net(AMVP_CTX *ctx) {
+    return ctx->metrics ? ctx->metrics->net : NULL;
+}
+
+/*
+ * Keeps the timings of a finished request. The time up to the first byte
+ * of the answer is split into connection setup and waiting on the server
+ * at the point the request went out, pretransfer_ms.
+ */
+void amvp_metrics_request(AMVP_CTX *ctx, AMVP_VS_METRICS_REC *rec, AMVP_NET_TIMING *timing) {
+    AMVP_METRICS *metrics = ctx->metrics;
+    AMVP_NET_TIMING *reqs = NULL;
+    double setup = 0;
+
+    if (!metrics) {
+        return;
+    }
+    timing->started = amvp_metrics_wall_now() - timing->total_ms / 1000.0;
+#ifndef _WIN32
+    pthread_mutex_lock(&metrics->lock);
+#endif
+    if (metrics->req_count == metrics->req_alloc) {
+        metrics->req_alloc = metrics->req_alloc ? metrics->req_alloc * 2 : 64;
+        reqs = realloc(metrics->reqs, metrics->req_alloc * sizeof(AMVP_NET_TIMING));
+        if (!reqs) {
+            metrics->req_alloc = metrics->req_count;
+        } else {
+            metrics->reqs = reqs;
+        }
+    }
+    if (metrics->req_count < metrics->req_alloc) {
+        metrics->reqs[metrics->req_count++] = *timing;
+    }
+    if (rec) {
+        setup = timing->tls_ms > timing->connect_ms ? timing->tls_ms : timing->connect_ms;
+        rec->m.net_setup_ms += setup;
+        if (timing->first_byte_ms > timing->pretransfer_ms) {
+            rec->m.server_wait_ms += timing->first_byte_ms - timing->pretransfer_ms;
+        }
+        if (timing->total_ms > timing->first_byte_ms && timing->first_byte_ms > 0) {
+            rec->m.transfer_ms += timing->total_ms - timing->first_byte_ms;
+        }
+    }
+#ifndef _WIN32
+    pthread_mutex_unlock(&metrics->lock);
+#endif
+}
+
+/*
+ * The server asked us to come back later for this set
+ */
+void amvp_metrics_retry(AMVP_VS_METRICS_REC *rec) {
+    if (!rec) {
+        return;
+    }
+    rec->m.retries++;
+    rec->wait_since = amvp_metrics_now();
+}
+
+/*
+ * A download of the set is starting; ends any retry wait
+ */
+void amvp_metrics_download_start(AMVP_VS_METRICS_REC *rec) {
+    if (!rec || !rec->wait_since) {
+        return;
+    }
+    rec->m.retry_wait_ms += amvp_metrics_now() - rec->wait_since;
+    rec->wait_since = 0;
+}
+
+/*
+ * Accounts a finished network request of the vector set in ctx->metrics->net
+ */
+void amvp_metrics_net(AMVP_CTX *ctx, int upload, double start, size_t bytes_out, size_t bytes_in) {
+    AMVP_VS_METRICS_REC *rec = ctx->metrics ? ctx->metrics->net : NULL;
+
+    amvp_metrics_xfer(rec, upload, start, bytes_out, bytes_in);
+}
+
+void amvp_metrics_xfer(AMVP_VS_METRICS_REC *rec, int upload, double start, size_t bytes_out, size_t bytes_in) {
+    if (!rec) {
+        return;
+    }
+    if (upload) {
+        rec->m.upload_ms += amvp_metrics_now() - start;
+    } else {
+        rec->m.download_ms += amvp_metrics_now() - start;
+    }
+    rec->m.bytes_out += bytes_out;
+    rec->m.bytes_in += bytes_in;
+}
+
+/*
+ * Runs the crypto handler for one test case, timing it when the set being
+ * processed is recorded. The KAT handlers call this instead of calling
+ * cap->crypto_handler directly.
+ */
+int amvp_crypto_call(AMVP_CTX *ctx, AMVP_CAPS_LIST *cap, AMVP_TEST_CASE *tc) {
+    AMVP_VS_METRICS_REC *rec = amvp_metrics_cur(ctx);
+    double start = 0;
+    int ret = 0;
+
+    if (!rec) {
+        return amvp_crypto_cache_call(ctx, cap, tc);
+    }
+    start = amvp_metrics_now();
+    ret = amvp_crypto_cache_call(ctx, cap, tc);
+    rec->m.crypto_ms += amvp_metrics_now() - start;
+    rec->m.crypto_calls++;
+    return ret;
+}
+
+/*
+ * Same as amvp_crypto_call(), for the crypto_mct_handler that runs one
+ * MCT outer iteration.
+ */
+int amvp_crypto_mct_call(AMVP_CTX *ctx, AMVP_CAPS_LIST *cap, AMVP_TEST_CASE *tc) {
+    AMVP_VS_METRICS_REC *rec = amvp_metrics_cur(ctx);
+    double start = 0;
+    int ret = 0;
+
+    AMVP_TRACE2(tc__start, cap->cipher, tc);
+    if (!rec) {
+        ret = (cap->crypto_mct_handler)(tc);
+        AMVP_TRACE2(tc__done, cap->cipher, ret);
+        return ret;
+    }
+    start = amvp_metrics_now();
+    ret = (cap->crypto_mct_handler)(tc);
+    AMVP_TRACE2(tc__done, cap->cipher, ret);
+    rec->m.crypto_ms += amvp_metrics_now() - start;
+    rec->m.crypto_calls++;
+    return ret;
+}
+
+/*
+ * amvp_crypto_mct_call() for AES and TDES. The outer iteration's key, iv,
+ * pt and ct are put back afterwards: the KAT handler replays the chaining
+ * from mct_out, starting from the same inputs the module started from.
+ */
+int amvp_sym_mct_call(AMVP_CTX *ctx, AMVP_CAPS_LIST *cap, AMVP_TEST_CASE *tc) {
+    AMVP_SYM_CIPHER_TC *stc = tc->tc.symmetric;
+    unsigned char key[AMVP_SYM_KEY_MAX_BYTES], iv[AMVP_SYM_MCT_OUT_STRIDE];
+    unsigned char pt[AMVP_SYM_MCT_OUT_STRIDE], ct[AMVP_SYM_MCT_OUT_STRIDE];
+    int ret = 0;
+
+    /* MCT blocks are never longer than one AES block */
+    memcpy_s(key, sizeof(key), stc->key, sizeof(key));
+    memcpy_s(iv, sizeof(iv), stc->iv, sizeof(iv));
+    memcpy_s(pt, sizeof(pt), stc->pt, sizeof(pt));
+    memcpy_s(ct, sizeof(ct), stc->ct, sizeof(ct));
+    ret = amvp_crypto_mct_call(ctx, cap, tc);
+    memcpy_s(stc->key, AMVP_SYM_KEY_MAX_BYTES, key, sizeof(key));
+    memcpy_s(stc->iv, AMVP_SYM_IV_BYTE_MAX, iv, sizeof(iv));
+    memcpy_s(stc->pt, AMVP_SYM_PT_BYTE_MAX, pt, sizeof(pt));
+    memcpy_s(stc->ct, AMVP_SYM_CT_BYTE_MAX, ct, sizeof(ct));
+    return ret;
+}
+
+/*
+ * group_init is module time too, so it is charged to the set like a
+ * crypto call
+ */
+int amvp_group_begin(AMVP_CTX *ctx, AMVP_CAPS_LIST *cap, AMVP_TEST_CASE *tc,
+                     AMVP_GROUP_STATE *group, void **tc_group_ctx) {
+    AMVP_VS_METRICS_REC *rec = NULL;
+    double start = 0;
+    int ret = 0;
+
+    if (!cap->group_init) {
+        return 0;
+    }
+    if (!group->active) {
+        rec = amvp_metrics_cur(ctx);
+        if (rec) start = amvp_metrics_now();
+        group->group_ctx = NULL;
+        ret = (cap->group_init)(tc, &group->group_ctx);
+        if (rec) rec->m.crypto_ms += amvp_metrics_now() - start;
+        if (ret) {
+            AMVP_LOG_ERR("crypto module failed to set up the test group");
+            return ret;
+        }
+        group->active = 1;
+    }
+    *tc_group_ctx = group->group_ctx;
+    return 0;
+}
+
+void amvp_group_end(AMVP_CAPS_LIST *cap, AMVP_GROUP_STATE *group) {
+    if (!group->active) {
+        return;
+    }
+    if (cap->group_fini) {
+        (cap->group_fini)(group->group_ctx);
+    }
+    group->group_ctx = NULL;
+    group->active = 0;
+}
+
+/*
+ * Collects the per-algorithm totals. Returns the number of algorithms,
+ * with the totals in *out for the caller to free, or -1 on failure.
+ */
+static int amvp_metrics_algs(AMVP_METRICS *metrics, AMVP_ALG_METRICS **out) {
+    AMVP_ALG_METRICS *algs = NULL, *a = NULL;
+    AMVP_VS_METRICS_REC *rec = NULL;
+    int cnt = 0, i, diff = 1;
+
+    *out = NULL;
+    if (!metrics->count) {
+        return 0;
+    }
+    algs = calloc(metrics->count, sizeof(AMVP_ALG_METRICS));
+    if (!algs) {
+        return -1;
+    }
+    for (rec = metrics->head; rec; rec = rec->next) {
+        if (!rec->m.algorithm[0]) {
+            /* Never got past the download */
+            continue;
+        }
+        a = NULL;
+        for (i = 0; i < cnt; i++) {
+            strcmp_s(algs[i].totals.algorithm, AMVP_METRICS_ALG_MAX, rec->m.algorithm, &diff);
+            if (!diff) {
+                a = &algs[i];
+                break;
+            }
+        }
+        if (!a) {
+            a = &algs[cnt++];
+            strcpy_s(a->totals.algorithm, AMVP_METRICS_ALG_MAX + 1, rec->m.algorithm);
+        }
+        a->vector_sets++;
+        a->totals.download_ms += rec->m.download_ms;
+        a->totals.retry_wait_ms += rec->m.retry_wait_ms;
+        a->totals.parse_ms += rec->m.parse_ms;
+        a->totals.handler_ms += rec->m.handler_ms;
+        a->totals.crypto_ms += rec->m.crypto_ms;
+        a->totals.upload_ms += rec->m.upload_ms;
+        a->totals.net_setup_ms += rec->m.net_setup_ms;
+        a->totals.server_wait_ms += rec->m.server_wait_ms;
+        a->totals.transfer_ms += rec->m.transfer_ms;
+        a->totals.retries += rec->m.retries;
+        a->totals.test_cases += rec->m.test_cases;
+        a->totals.crypto_calls += rec->m.crypto_calls;
+        a->totals.bytes_in += rec->m.bytes_in;
+        a->totals.bytes_out += rec->m.bytes_out;
+        if (rec->m.mem_peak_bytes > a->totals.mem_peak_bytes) {
+            a->totals.mem_peak_bytes = rec->m.mem_peak_bytes;
+        }
+        if (rec->m.mem_bytes > a->totals.mem_bytes) {
+            a->totals.mem_bytes = rec->m.mem_bytes;
+        }
+        a->totals.alloc_bytes += rec->m.alloc_bytes;
+        a->totals.parse_alloc_bytes += rec->m.parse_alloc_bytes;
+        a->totals.handler_alloc_bytes += rec->m.handler_alloc_bytes;
+        a->totals.upload_alloc_bytes += rec->m.upload_alloc_bytes;
+        a->totals.allocs += rec->m.allocs;
+        a->totals.parse_allocs += rec->m.parse_allocs;
+        a->totals.handler_allocs += rec->m.handler_allocs;
+        a->totals.upload_allocs += rec->m.upload_allocs;
+    }
+    *out = algs;
+    return cnt;
+}
+
+static void amvp_metrics_to_json(JSON_Object *obj, const AMVP_VS_METRICS *m) {
+    json_object_set_number(obj, "downloadMs", m->download_ms);
+    json_object_set_number(obj, "retryWaitMs", m->retry_wait_ms);
+    json_object_set_number(obj, "parseMs", m->parse_ms);
+    json_object_set_number(obj, "handlerMs", m->handler_ms);
+    json_object_set_number(obj, "cryptoMs", m->crypto_ms);
+    json_object_set_number(obj, "uploadMs", m->upload_ms);
+    json_object_set_number(obj, "netSetupMs", m->net_setup_ms);
+    json_object_set_number(obj, "serverWaitMs", m->server_wait_ms);
+    json_object_set_number(obj, "transferMs", m->transfer_ms);
+    json_object_set_number(obj, "retries", m->retries);
+    json_object_set_number(obj, "testCases", m->test_cases);
+    json_object_set_number(obj, "cryptoCalls", m->crypto_calls);
+    json_object_set_number(obj, "bytesIn", (double)m->bytes_in);
+    json_object_set_number(obj, "bytesOut", (double)m->bytes_out);
+    json_object_set_number(obj, "memPeakBytes", (double)m->mem_peak_bytes);
+    json_object_set_number(obj, "memBytes", (double)m->mem_bytes);
+    json_object_set_number(obj, "allocBytes", (double)m->alloc_bytes);
+    json_object_set_number(obj, "allocs", m->allocs);
+    json_object_set_number(obj, "parseAllocBytes", (double)m->parse_alloc_bytes);
+    json_object_set_number(obj, "parseAllocs", m->parse_allocs);
+    json_object_set_number(obj, "handlerAllocBytes", (double)m->handler_alloc_bytes);
+    json_object_set_number(obj, "handlerAllocs", m->handler_allocs);
+    json_object_set_number(obj, "uploadAllocBytes", (double)m->upload_alloc_bytes);
+    json_object_set_number(obj, "uploadAllocs", m->upload_allocs);
+}
+
+static void amvp_net_timing_to_json(JSON_Object *obj, const AMVP_NET_TIMING *t) {
+    json_object_set_string(obj, "method", t->method);
+    json_object_set_string(obj, "url", t->url);
+    json_object_set_number(obj, "status", t->http_code);
+    json_object_set_number(obj, "started", t->started);
+    json_object_set_number(obj, "dnsMs", t->dns_ms);
+    json_object_set_number(obj, "connectMs", t->connect_ms);
+    json_object_set_number(obj, "tlsMs", t->tls_ms);
+    json_object_set_number(obj, "pretransferMs", t->pretransfer_ms);
+    json_object_set_number(obj, "firstByteMs", t->first_byte_ms);
+    json_object_set_number(obj, "totalMs", t->total_ms);
+    json_object_set_number(obj, "bytesUp", (double)t->bytes_up);
+    json_object_set_number(obj, "bytesDown", (double)t->bytes_down);
+    json_object_set_number(obj, "uploadSpeed", t->upload_speed);
+    json_object_set_number(obj, "downloadSpeed", t->download_speed);
+}
+
+char *amvp_get_metrics_json(AMVP_CTX *ctx, int *len) {
+    AMVP_METRICS *metrics = NULL;
+    AMVP_VS_METRICS_REC *rec = NULL;
+    AMVP_ALG_METRICS *algs = NULL;
+    JSON_Value *root_val = NULL, *val = NULL;
+    JSON_Object *root = NULL, *obj = NULL;
+    JSON_Array *arr = NULL;
+    char *json = NULL;
+    int alg_cnt = 0, i;
+
+    if (!ctx || !ctx->metrics) {
+        return NULL;
+    }
+    metrics = ctx->metrics;
+
+    root_val = json_value_init_object();
+    root = json_value_get_object(root_val);
+    json_object_set_value(root, "vectorSets", json_value_init_array());
+    arr = json_object_get_array(root, "vectorSets");
+#ifndef _WIN32
+    pthread_mutex_lock(&metrics->lock);
+#endif
+    for (rec = metrics->head; rec; rec = rec->next) {
+        val = json_value_init_object();
+        obj = json_value_get_object(val);
+        json_object_set_string(obj, "url", rec->vsid_url);
+        json_object_set_number(obj, "vsId", rec->m.vs_id);
+        json_object_set_string(obj, "algorithm", rec->m.algorithm);
+        amvp_metrics_to_json(obj, &rec->m);
+        json_array_append_value(arr, val);
+    }
+    json_object_set_value(root, "requests", json_value_init_array());
+    arr = json_object_get_array(root, "requests");
+    for (i = 0; i < metrics->req_count; i++) {
+        val = json_value_init_object();
+        amvp_net_timing_to_json(json_value_get_object(val), &metrics->reqs[i]);
+        json_array_append_value(arr, val);
+    }
+    alg_cnt = amvp_metrics_algs(metrics, &algs);
+#ifndef _WIN32
+    pthread_mutex_unlock(&metrics->lock);
+#endif
+
+    json_object_set_value(root, "algorithms", json_value_init_array());
+    arr = json_object_get_array(root, "algorithms");
+    for (i = 0; i < alg_cnt; i++) {
+        val = json_value_init_object();
+        obj = json_value_get_object(val);
+        json_object_set_string(obj, "algorithm", algs[i].totals.algorithm);
+        json_object_set_number(obj, "vectorSets", algs[i].vector_sets);
+        amvp_metrics_to_json(obj, &algs[i].totals);
+        json_array_append_value(arr, val);
+    }
+
+    json = amvp_json_serialize(ctx, root_val, len);
+    json_value_free(root_val);
+    if (algs) free(algs);
+    return json;
+}
+
+/*
+ * One HAR entry. libcurl's times are cumulative, HAR's are the length of
+ * each step, with -1 for a step that didn't happen; connect includes ssl.
+ */
+static JSON_Value *amvp_net_timing_to_har(const AMVP_NET_TIMING *t) {
+    JSON_Value *val = json_value_init_object();
+    JSON_Object *obj = json_value_get_object(val), *part = NULL, *content = NULL;
+    double setup = t->tls_ms > t->connect_ms ? t->tls_ms : t->connect_ms;
+    time_t secs = (time_t)t->started;
+    struct tm tm;
+    char date[40];
+
+#ifdef _WIN32
+    gmtime_s(&tm, &secs);
+#else
+    gmtime_r(&secs, &tm);
+#endif
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", &tm);
+    snprintf(date + 19, sizeof(date) - 19, ".%03dZ", (int)((t->started - (double)secs) * 1000.0));
+
+    json_object_set_string(obj, "startedDateTime", date);
+    json_object_set_number(obj, "time", t->total_ms);
+
+    json_object_set_value(obj, "request", json_value_init_object());
+    part = json_object_get_object(obj, "request");
+    json_object_set_string(part, "method", t->method);
+    json_object_set_string(part, "url", t->url);
+    json_object_set_string(part, "httpVersion", "");
+    json_object_set_value(part, "cookies", json_value_init_array());
+    json_object_set_value(part, "headers", json_value_init_array());
+    json_object_set_value(part, "queryString", json_value_init_array());
+    json_object_set_number(part, "headersSize", -1);
+    json_object_set_number(part, "bodySize", (double)t->bytes_up);
+
+    json_object_set_value(obj, "response", json_value_init_object());
+    part = json_object_get_object(obj, "response");
+    json_object_set_number(part, "status", t->http_code);
+    json_object_set_string(part, "statusText", "");
+    json_object_set_string(part, "httpVersion", "");
+    json_object_set_value(part, "cookies", json_value_init_array());
+    json_object_set_value(part, "headers", json_value_init_array());
+    json_object_set_value(part, "content", json_value_init_object());
+    content = json_object_get_object(part, "content");
+    json_object_set_number(content, "size", (double)t->bytes_down);
+    json_object_set_string(content, "mimeType", "application/json");
+    json_object_set_string(part, "redirectURL", "");
+    json_object_set_number(part, "headersSize", -1);
+    json_object_set_number(part, "bodySize", (double)t->bytes_down);
+
+    json_object_set_value(obj, "cache", json_value_init_object());
+    json_object_set_value(obj, "timings", json_value_init_object());
+    part = json_object_get_object(obj, "timings");
+    json_object_set_number(part, "blocked", t->pretransfer_ms > setup ? t->pretransfer_ms - setup : 0);
+    json_object_set_number(part, "dns", t->dns_ms);
+    json_object_set_number(part, "connect", setup > t->dns_ms ? setup - t->dns_ms : 0);
+    json_object_set_number(part, "ssl", t->tls_ms > t->connect_ms ? t->tls_ms - t->connect_ms : -1);
+    json_object_set_number(part, "send", 0);
+    json_object_set_number(part, "wait", t->first_byte_ms > t->pretransfer_ms ?
+                                         t->first_byte_ms - t->pretransfer_ms : 0);
+    json_object_set_number(part, "receive", t->total_ms > t->first_byte_ms && t->first_byte_ms > 0 ?
+                                            t->total_ms - t->first_byte_ms : 0);
+    json_object_set_number(obj, "_uploadSpeed", t->upload_speed);
+    json_object_set_number(obj, "_downloadSpeed", t->download_speed);
+    return val;
+}
+
+/*
+ * Writes the requests to the file given to amvp_set_net_trace()
+ */
+static void amvp_net_trace_emit(AMVP_CTX *ctx) {
+    AMVP_METRICS *metrics = ctx->metrics;
+    JSON_Value *root_val = NULL;
+    JSON_Object *log = NULL, *creator = NULL;
+    JSON_Array *arr = NULL;
+    int i;
+
+    root_val = json_value_init_object();
+    json_object_set_value(json_value_get_object(root_val), "log", json_value_init_object());
+    log = json_object_get_object(json_value_get_object(root_val), "log");
+    json_object_set_string(log, "version", "1.2");
+    json_object_set_value(log, "creator", json_value_init_object());
+    creator = json_object_get_object(log, "creator");
+    json_object_set_string(creator, "name", "libamvp");
+    json_object_set_string(creator, "version", amvp_version());
+    json_object_set_value(log, "entries", json_value_init_array());
+    arr = json_object_get_array(log, "entries");
+#ifndef _WIN32
+    pthread_mutex_lock(&metrics->lock);
+#endif
+    for (i = 0; i < metrics->req_count; i++) {
+        json_array_append_value(arr, amvp_net_timing_to_har(&metrics->reqs[i]));
+    }
+#ifndef _WIN32
+    pthread_mutex_unlock(&metrics->lock);
+#endif
+    if (json_serialize_to_file(root_val, metrics->har_file) != JSONSuccess) {
+        AMVP_LOG_ERR("Failed to write the network trace to %s", metrics->har_file);
+    }
+    json_value_free(root_val);
+}
+
+/*
+ * Writes the metrics to the file given to amvp_set_metrics(), and the
+ * requests to the one given to amvp_set_net_trace(), if any
+ */
+void amvp_metrics_emit(AMVP_CTX *ctx) {
+    char *json = NULL;
+    FILE *fp = NULL;
+    int len = 0;
+
+    if (!ctx->metrics) {
+        return;
+    }
+    if (ctx->metrics->har_file) {
+        amvp_net_trace_emit(ctx);
+    }
+    if (!ctx->metrics->json_file) {
+        return;
+    }
+    json = amvp_get_metrics_json(ctx, &len);
+    if (!json) {
+        AMVP_LOG_ERR("Failed to serialize metrics");
+        return;
+    }
+    fp = fopen(ctx->metrics->json_file, "w");
+    if (!fp || fwrite(json, 1, len, fp) != (size_t)len) {
+        AMVP_LOG_ERR("Failed to write metrics to %s", ctx->metrics->json_file);
+    }
+    if (fp) fclose(fp);
+    json_free_serialized_string(json);
+}
+
+void amvp_metrics_free(AMVP_CTX *ctx) {
+    AMVP_VS_METRICS_REC *rec = NULL, *next = NULL;
+
+    if (!ctx || !ctx->metrics) {
+        return;
+    }
+    for (rec = ctx->metrics->head; rec; rec = next) {
+        next = rec->next;
+        free(rec->vsid_url);
+        free(rec);
+    }
+#ifndef _WIN32
+    pthread_mutex_destroy(&ctx->metrics->lock);
+#endif
+    if (ctx->metrics->json_file) free(ctx->metrics->json_file);
+    if (ctx->metrics->har_file) free(ctx->metrics->har_file);
+    if (ctx->metrics->reqs) free(ctx->metrics->reqs);
+    free(ctx->metrics);
+    ctx->metrics = NULL;
+    amvp_mem_users_add(-1);
+}
+
+AMVP_RESULT amvp_set_metrics(AMVP_CTX *ctx, int enable, const char *json_file) {
+    if (!ctx) {
+        return AMVP_NO_CTX;
+    }
+    if (ctx->async || ctx->session_group) {
+        return AMVP_UNSUPPORTED_OP;
+    }
+
+    amvp_metrics_free(ctx);
+    if (!enable) {
+        return AMVP_SUCCESS;
+    }
+    ctx->metrics = calloc(1, sizeof(AMVP_METRICS));
+    if (!ctx->metrics) {
+        return AMVP_MALLOC_FAIL;
+    }
+    if (json_file) {
+        ctx->metrics->json_file = strdup(json_file);
+        if (!ctx->metrics->json_file) {
+            free(ctx->metrics);
+            ctx->metrics = NULL;
+            return AMVP_MALLOC_FAIL;
+        }
+    }
+#ifndef _WIN32
+    pthread_mutex_init(&ctx->metrics->lock, NULL);
+#endif
+    /*
+     * The hook frees with parson's previous free function, so it can be
+     * switched in and out while values parson allocated are still around
+     */
+    amvp_mem_users_add(1);
+    return AMVP_SUCCESS;
+}
+
+AMVP_RESULT amvp_get_vs_metrics(AMVP_CTX *ctx, int index, AMVP_VS_METRICS *metrics) {
+    AMVP_VS_METRICS_REC *rec = NULL;
+    AMVP_RESULT rv = AMVP_NO_DATA;
+    int i = 0;
+
+    if (!ctx) {
+        return AMVP_NO_CTX;
+    }
+    if (!metrics || index < 0) {
+        return AMVP_INVALID_ARG;
+    }
+    if (!ctx->metrics) {
+        return AMVP_NO_DATA;
+    }
+#ifndef _WIN32
+    pthread_mutex_lock(&ctx->metrics->lock);
+#endif
+    for (rec = ctx->metrics->head; rec; rec = rec->next, i++) {
+        if (i == index) {
+            *metrics = rec->m;
+            rv = AMVP_SUCCESS;
+            break;
+        }
+    }
+#ifndef _WIN32
+    pthread_mutex_unlock(&ctx->metrics->lock);
+#endif
+    return rv;
+}
+
+AMVP_RESULT amvp_get_alg_metrics(AMVP_CTX *ctx, int index, AMVP_ALG_METRICS *metrics) {
+    AMVP_ALG_METRICS *algs = NULL;
+    AMVP_RESULT rv = AMVP_NO_DATA;
+    int cnt = 0;
+
+    if (!ctx) {
+        return AMVP_NO_CTX;
+    }
+    if (!metrics || index < 0) {
+        return AMVP_INVALID_ARG;
+    }
+    if (!ctx->metrics) {
+        return AMVP_NO_DATA;
+    }
+#ifndef _WIN32
+    pthread_mutex_lock(&ctx->metrics->lock);
+#endif
+    cnt = amvp_metrics_algs(ctx->metrics, &algs);
+#ifndef _WIN32
+    pthread_mutex_unlock(&ctx->metrics->lock);
+#endif
+    if (cnt < 0) {
+        return AMVP_MALLOC_FAIL;
+    }
+    if (index < cnt) {
+        *metrics = algs[index];
+        rv = AMVP_SUCCESS;
+    }
+    if (algs) free(algs);
+    return rv;
+}
+
+AMVP_RESULT amvp_get_net_timing(AMVP_CTX *ctx, int index, AMVP_NET_TIMING *timing) {
+    AMVP_RESULT rv = AMVP_NO_DATA;
+
+    if (!ctx) {
+        return AMVP_NO_CTX;
+    }
+    if (!timing || index < 0) {
+        return AMVP_INVALID_ARG;
+    }
+    if (!ctx->metrics) {
+        return AMVP_NO_DATA;
+    }
+#ifndef _WIN32
+    pthread_mutex_lock(&ctx->metrics->lock);
+#endif
+    if (index < ctx->metrics->req_count) {
+        *timing = ctx->metrics->reqs[index];
+        rv = AMVP_SUCCESS;
+    }
+#ifndef _WIN32
+    pthread_mutex_unlock(&ctx->metrics->lock);
+#endif
+    return rv;
+}
+
+AMVP_RESULT amvp_set_net_trace(AMVP_CTX *ctx, const char *har_file) {
+    char *file = NULL;
+
+    if (!ctx) {
+        return AMVP_NO_CTX;
+    }
+    if (!ctx->metrics) {
+        return AMVP_UNSUPPORTED_OP;
+    }
+    if (har_file) {
+        file = strdup(har_file);
+        if (!file) {
+            return AMVP_MALLOC_FAIL;
+        }
+    }
+    if (ctx->metrics->har_file) free(ctx->metrics->har_file);
+    ctx->metrics->har_file = file;
+    return AMVP_SUCCESS;
+}
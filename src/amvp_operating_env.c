@@ -672,6 +672,276 @@ static int compare_dependencies(const AMVP_DEPENDENCY *a, const AMVP_DEPENDENCY
     return 1;
 }
 
+/*
+ * Compares one page of a server listing against a resource, see the
+ * match_*_page() functions below.
+ */
+typedef AMVP_RESULT (*AMVP_PAGE_MATCH_FN)(AMVP_CTX *ctx, void *resource, int *match, char **next_endpoint);
+
+/*
+ * Copies the body of the last response, for the metadata cache. The
+ * matchers can make requests of their own, which overwrite curl_buf.
+ */
+static char *copy_page_body(AMVP_CTX *ctx, int *len) {
+    char *body = NULL;
+
+    body = malloc(ctx->curl_read_ctr + 1);
+    if (body) {
+        memcpy_s(body, ctx->curl_read_ctr + 1, ctx->curl_buf, ctx->curl_read_ctr);
+        body[ctx->curl_read_ctr] = '\0';
+        *len = ctx->curl_read_ctr;
+    }
+    return body;
+}
+
+/*
+ * State of one query_pages() call.
+ */
+typedef struct amvp_page_query_t {
+    const char *key;            /* Metadata cache key, NULL when not caching */
+    AMVP_PAGE_MATCH_FN match_fn;
+    void *resource;
+    int match;
+    char *next_endpoint;
+} AMVP_PAGE_QUERY;
+
+/*
+ * Matches the page in ctx->curl_buf and, if it matches, caches it as \p page
+ * (NULL for the first page of the query).
+ */
+static AMVP_RESULT match_page(AMVP_CTX *ctx, AMVP_PAGE_QUERY *query, const char *page) {
+    AMVP_RESULT rv = AMVP_SUCCESS;
+    char etag[AMVP_HTTP_ETAG_MAX + 1] = "";
+    char *body = NULL;
+    int body_len = 0;
+
+    if (query->key && ctx->http_validators.etag[0]) {
+        strcpy_s(etag, sizeof(etag), ctx->http_validators.etag);
+        body = copy_page_body(ctx, &body_len);
+    }
+
+    rv = query->match_fn(ctx, query->resource, &query->match, &query->next_endpoint);
+    if (rv == AMVP_SUCCESS && query->match && body) {
+        rv = amvp_meta_cache_store(ctx, query->key, page, etag, body, body_len);
+        body = NULL;
+    }
+    if (body) free(body);
+    return rv;
+}
+
+static AMVP_RESULT match_page_cb(AMVP_CTX *ctx, const char *url, void *arg, int *done) {
+    AMVP_PAGE_QUERY *query = (AMVP_PAGE_QUERY *)arg;
+    AMVP_RESULT rv = AMVP_SUCCESS;
+
+    rv = match_page(ctx, query, url);
+    *done = query->match;
+    return rv;
+}
+
+static void free_page_urls(char **urls, int count) {
+    int i = 0;
+
+    if (!urls) return;
+    for (i = 0; i < count; i++) {
+        if (urls[i]) free(urls[i]);
+    }
+    free(urls);
+}
+
+/*
+ * Works out the URLs of the remaining pages of a listing from its first page
+ * in ctx->curl_buf: the "totalCount" of records, and the offset and limit of
+ * the link to the next page. Leaves *count at 0 when the listing doesn't say,
+ * and the pages have to be followed one at a time.
+ */
+static AMVP_RESULT listing_page_urls(AMVP_CTX *ctx, char ***urls, int *count) {
+    AMVP_RESULT rv = AMVP_SUCCESS;
+    JSON_Value *val = NULL;
+    JSON_Object *obj = NULL, *links_obj = NULL;
+    const char *next = NULL;
+    char *offset_str = NULL, *limit_str = NULL, *suffix = NULL;
+    char **list = NULL;
+    double total = 0;
+    int offset = 0, limit = 0, pages = 0, i = 0;
+    size_t len = 0;
+
+    *urls = NULL;
+    *count = 0;
+
+    val = json_parse_string(ctx->curl_buf);
+    if (!val) goto end;
+    obj = amvp_get_obj_from_rsp(ctx, val);
+    total = json_object_get_number(obj, "totalCount");
+    links_obj = json_object_get_object(obj, "links");
+    next = json_object_get_string(links_obj, "next");
+    if (!next) next = json_object_get_string(links_obj, "nextPage");
+    if (!next || total <= 0) goto end;
+
+    len = strnlen_s(next, AMVP_ATTR_URL_MAX + 1);
+    if (len > AMVP_ATTR_URL_MAX) goto end;
+    strstr_s((char *)next, len, "offset=", 7, &offset_str);
+    strstr_s((char *)next, len, "limit=", 6, &limit_str);
+    if (!offset_str || !limit_str) goto end;
+    offset = atoi(offset_str + 7);
+    limit = atoi(limit_str + 6);
+    if (offset <= 0 || limit <= 0 || offset >= total) goto end;
+
+    pages = (int)((total - offset + limit - 1) / limit);
+    list = calloc(pages, sizeof(char *));
+    if (!list) {
+        rv = AMVP_MALLOC_FAIL;
+        goto end;
+    }
+    suffix = offset_str + 7;
+    while (*suffix >= '0' && *suffix <= '9') suffix++;
+    for (i = 0; i < pages; i++) {
+        list[i] = calloc(AMVP_ATTR_URL_MAX + 1, sizeof(char));
+        if (!list[i]) {
+            free_page_urls(list, pages);
+            rv = AMVP_MALLOC_FAIL;
+            goto end;
+        }
+        snprintf(list[i], AMVP_ATTR_URL_MAX + 1, "%.*s%d%s", (int)(offset_str + 7 - next), next,
+                 offset + i * limit, suffix);
+    }
+    *urls = list;
+    *count = pages;
+
+end:
+    if (rv == AMVP_MALLOC_FAIL) AMVP_LOG_ERR("Failed to malloc");
+    if (val) json_value_free(val);
+    return rv;
+}
+
+/*
+ * Pages through the server listing at \p endpoint (filtered by \p parameters)
+ * until \p match_fn matches \p resource, or the listing runs out.
+ *
+ * With more than one concurrent transfer allowed, and a listing that gives its
+ * total count, the pages after the first are downloaded in parallel and
+ * matched in order as they arrive.
+ *
+ * With the metadata cache enabled, the page of the last match is tried first:
+ * it is fetched with its ETag, and if the server says it is not modified the
+ * cached copy is matched instead. Only when that fails is the listing scanned
+ * from the start. Successful matches are cached, misses are not.
+ */
+static AMVP_RESULT query_pages(AMVP_CTX *ctx,
+                               const char *what,
+                               const char *endpoint,
+                               const AMVP_KV_LIST *parameters,
+                               AMVP_PAGE_MATCH_FN match_fn,
+                               void *resource) {
+    AMVP_RESULT rv = AMVP_SUCCESS;
+    AMVP_META_CACHE_ENTRY *entry = NULL;
+    AMVP_PAGE_QUERY query;
+    char *key = NULL, *page = NULL;
+    char **urls = NULL;
+    char etag[AMVP_HTTP_ETAG_MAX + 1] = "";
+    int url_count = 0;
+
+    memzero_s(&query, sizeof(query));
+    query.match_fn = match_fn;
+    query.resource = resource;
+
+    if (ctx->meta_cache) {
+        key = amvp_meta_cache_key(endpoint, parameters);
+        if (!key) {
+            AMVP_LOG_ERR("Failed to malloc");
+            return AMVP_MALLOC_FAIL;
+        }
+        query.key = key;
+        entry = amvp_meta_cache_find(ctx, key);
+    }
+
+    if (entry) {
+        /* Revalidate the page the last match was found on */
+        strcpy_s(etag, sizeof(etag), entry->etag);
+        ctx->http_if_none_match = etag;
+        if (entry->page) {
+            rv = amvp_transport_get(ctx, entry->page, NULL);
+        } else {
+            rv = amvp_transport_get(ctx, endpoint, parameters);
+        }
+        ctx->http_if_none_match = NULL;
+        if (rv == AMVP_SUCCESS && ctx->http_not_modified) {
+            AMVP_LOG_VERBOSE("Cached %s page is current", what);
+            rv = amvp_meta_cache_load_body(ctx, entry);
+            if (rv == AMVP_SUCCESS) {
+                rv = match_fn(ctx, resource, &query.match, &query.next_endpoint);
+            }
+        } else if (rv == AMVP_SUCCESS) {
+            rv = match_page(ctx, &query, entry->page);
+        }
+        if (rv == AMVP_MALLOC_FAIL || (rv == AMVP_SUCCESS && query.match)) {
+            goto end;
+        }
+        if (query.next_endpoint) free(query.next_endpoint);
+        query.next_endpoint = NULL;
+        query.match = 0;
+        AMVP_LOG_INFO("Cached %s page no longer matches, searching the full listing...", what);
+    }
+
+    AMVP_LOG_INFO("Querying the server for a matching %s entry...", what);
+    rv = amvp_transport_get(ctx, endpoint, parameters);
+    if (rv != AMVP_SUCCESS) {
+        AMVP_LOG_ERR("Unable to query %s", what);
+        goto end;
+    }
+    if (ctx->max_transfers > 1) {
+        rv = listing_page_urls(ctx, &urls, &url_count);
+        if (rv != AMVP_SUCCESS) goto end;
+    }
+
+    /* Try to match against the page returned by server. */
+    rv = match_page(ctx, &query, NULL);
+    if (rv != AMVP_SUCCESS || query.match) {
+        goto end;
+    }
+
+    if (url_count) {
+        AMVP_LOG_INFO("No matching %s on the first page, fetching the other %d pages...", what, url_count);
+        rv = amvp_transport_get_pages(ctx, urls, url_count, match_page_cb, &query);
+        if (rv != AMVP_SUCCESS) {
+            AMVP_LOG_ERR("Unable to query %s", what);
+        }
+        goto end;
+    }
+
+    /* Only query the next page if there is one */
+    while (query.next_endpoint) {
+        AMVP_LOG_INFO("No matching %s on this page, moving to next page...", what);
+        /* Keep our own copy, next_endpoint is replaced by the next match */
+        if (!page) {
+            page = calloc(AMVP_ATTR_URL_MAX + 1, sizeof(char));
+            if (!page) {
+                AMVP_LOG_ERR("Failed to malloc");
+                rv = AMVP_MALLOC_FAIL;
+                goto end;
+            }
+        }
+        strcpy_s(page, AMVP_ATTR_URL_MAX + 1, query.next_endpoint);
+
+        rv = amvp_transport_get(ctx, page, NULL);
+        if (rv != AMVP_SUCCESS) {
+            AMVP_LOG_ERR("Unable to query %s", what);
+            goto end;
+        }
+        rv = match_page(ctx, &query, page);
+        if (rv != AMVP_SUCCESS || query.match) {
+            break;
+        }
+    }
+
+end:
+    if (key) free(key);
+    if (page) free(page);
+    if (query.next_endpoint) free(query.next_endpoint);
+    free_page_urls(urls, url_count);
+
+    return rv;
+}
+
 /**
  * @brief Compare the page of Dependencies returned by server DB to the
  *        specified Dependency data.
@@ -746,13 +1016,13 @@ static AMVP_RESULT match_dependencies_page(AMVP_CTX *ctx,
         version = json_object_get_string(dep_obj, "version");
         manufacturer = json_object_get_string(dep_obj, "manufacturer");
 
-        if (type) tmp_dep.type = strdup(type);
-        if (name) tmp_dep.name = strdup(name);
-        if (description) tmp_dep.description = strdup(description);
-        if (series) tmp_dep.series = strdup(series);
-        if (family) tmp_dep.family = strdup(family);
-        if (version) tmp_dep.version = strdup(version);
-        if (manufacturer) tmp_dep.manufacturer = strdup(manufacturer);
+        tmp_dep.type = (char *)type;
+        tmp_dep.name = (char *)name;
+        tmp_dep.description = (char *)description;
+        tmp_dep.series = (char *)series;
+        tmp_dep.family = (char *)family;
+        tmp_dep.version = (char *)version;
+        tmp_dep.manufacturer = (char *)manufacturer;
 
         this_match = compare_dependencies(dep, &tmp_dep);
         if (this_match) {
@@ -778,12 +1048,6 @@ static AMVP_RESULT match_dependencies_page(AMVP_CTX *ctx,
             *match = 1; 
             goto end;
         }
-        free(tmp_dep.type);
-        free(tmp_dep.name);
-        free(tmp_dep.description);
-        tmp_dep.type = NULL;
-        tmp_dep.name = NULL;
-        tmp_dep.description = NULL;
     }
 
     links_obj = json_object_get_object(obj, "links");
@@ -810,14 +1074,15 @@ static AMVP_RESULT match_dependencies_page(AMVP_CTX *ctx,
     }
 
 end:
-    free(tmp_dep.type);
-    free(tmp_dep.name);
-    free(tmp_dep.description);
     if (val) json_value_free(val);
 
     return rv;
 }
 
+static AMVP_RESULT match_dependencies_cb(AMVP_CTX *ctx, void *resource, int *match, char **next_endpoint) {
+    return match_dependencies_page(ctx, (AMVP_DEPENDENCY *)resource, match, next_endpoint);
+}
+
 /**
  * @brief Query the server DB for the specified Dependency data.
  *
@@ -835,8 +1100,7 @@ static AMVP_RESULT query_dependency(AMVP_CTX *ctx,
                                     const char *endpoint) {
     AMVP_RESULT rv = 0;
     AMVP_KV_LIST *parameters = NULL;
-    char *first_endpoint = NULL, *next_endpoint = NULL;
-    int match = 0;
+    char *first_endpoint = NULL;
 
     if (!ctx) return AMVP_NO_CTX;
     if (dep == NULL) {
@@ -890,38 +1154,10 @@ static AMVP_RESULT query_dependency(AMVP_CTX *ctx,
         }
     }
 
-    AMVP_LOG_INFO("Querying the server for a matching dependency entry...");
-    do {
-        /* Query the server DB. */
-        if (parameters) {
-            /* Use parameters and free them, as we get the next pages'
-             * URLs from the server */
-            rv = amvp_transport_get(ctx, endpoint, parameters);
-            amvp_kv_list_free(parameters);
-            parameters = NULL;
-        } else {
-            rv = amvp_transport_get(ctx, endpoint, NULL);
-        }
-        if (rv != AMVP_SUCCESS) {
-            AMVP_LOG_ERR("Unable to query Dependency");
-            goto end;
-        }
-
-        /* Try to match the dependency against the page returned by server. */
-        rv = match_dependencies_page(ctx, dep, &match, &next_endpoint);
-
-        /* Only query the next page if we are within the limit */
-        if (rv != AMVP_SUCCESS || match) {
-            break;
-        }
-
-        endpoint = next_endpoint;
-        AMVP_LOG_INFO("No matching dependency on this page, moving to next page...");
-    } while (endpoint);
+    rv = query_pages(ctx, "dependency", endpoint, parameters, match_dependencies_cb, dep);
 
 end:
     if (first_endpoint) free(first_endpoint);
-    if (next_endpoint) free(next_endpoint);
     if (parameters) amvp_kv_list_free(parameters);
 
     return rv;
@@ -1125,6 +1361,10 @@ end:
     return rv;
 }
 
+static AMVP_RESULT match_oes_cb(AMVP_CTX *ctx, void *resource, int *match, char **next_endpoint) {
+    return match_oes_page(ctx, (AMVP_OE *)resource, match, next_endpoint);
+}
+
 /**
  * @brief Query the server DB for the specified Operating Environment data.
  *
@@ -1142,8 +1382,7 @@ static AMVP_RESULT query_oe(AMVP_CTX *ctx,
                             const char *endpoint) {
     AMVP_RESULT rv = 0;
     AMVP_KV_LIST *parameters = NULL;
-    char *first_endpoint = NULL, *next_endpoint = NULL;
-    int match = 0;
+    char *first_endpoint = NULL;
 
     if (!ctx) return AMVP_NO_CTX;
     if (oe == NULL) {
@@ -1181,38 +1420,10 @@ static AMVP_RESULT query_oe(AMVP_CTX *ctx,
         }
     }
 
-    AMVP_LOG_INFO("Querying the server for a matching OE entry...");
-    do {
-        /* Query the server DB. */
-        if (parameters) {
-            /* Use parameters and free them, as we get the next pages'
-             * URLs from the server */
-            rv = amvp_transport_get(ctx, endpoint, parameters);
-            amvp_kv_list_free(parameters);
-            parameters = NULL;
-        } else {
-            rv = amvp_transport_get(ctx, endpoint, NULL);
-        }
-        if (rv != AMVP_SUCCESS) {
-            AMVP_LOG_ERR("Unable to query Operating Environment");
-            goto end;
-        }
-
-        /* Try to match against the page returned by server. */
-        rv = match_oes_page(ctx, oe, &match, &next_endpoint);
-
-        /* Only query the next page if we are within the limit */
-        if (rv != AMVP_SUCCESS || match) {
-            break;
-        }
-        
-        endpoint = next_endpoint;
-        AMVP_LOG_INFO("No matching OE on this page, moving to next page...");
-    } while (endpoint);
+    rv = query_pages(ctx, "OE", endpoint, parameters, match_oes_cb, oe);
 
 end:
     if (first_endpoint) free(first_endpoint);
-    if (next_endpoint) free(next_endpoint);
     if (parameters) amvp_kv_list_free(parameters);
 
     return rv;
@@ -1896,6 +2107,10 @@ end:
     return rv;
 }
 
+static AMVP_RESULT match_vendors_cb(AMVP_CTX *ctx, void *resource, int *match, char **next_endpoint) {
+    return match_vendors_page(ctx, (AMVP_VENDOR *)resource, match, next_endpoint);
+}
+
 /**
  * @brief Query the server DB for the specified Vendor data.
  *
@@ -1913,8 +2128,7 @@ static AMVP_RESULT query_vendor(AMVP_CTX *ctx,
                                 const char *endpoint) {
     AMVP_RESULT rv = 0;
     AMVP_KV_LIST *parameters = NULL;
-    char *first_endpoint = NULL, *next_endpoint = NULL;
-    int match = 0;
+    char *first_endpoint = NULL;
 
     if (!ctx) return AMVP_NO_CTX;
     if (vendor == NULL) {
@@ -1969,37 +2183,10 @@ static AMVP_RESULT query_vendor(AMVP_CTX *ctx,
         }
     }
 
-    AMVP_LOG_INFO("Querying the server for a matching vendor entry...");
-    do {
-        /* Query the server DB. */
-        if (parameters) {
-            /* Use parameters and free them, as we get the next pages'
-             * URLs from the server */
-            rv = amvp_transport_get(ctx, endpoint, parameters);
-            amvp_kv_list_free(parameters);
-            parameters = NULL;
-        } else {
-            rv = amvp_transport_get(ctx, endpoint, NULL);
-        }
-        if (rv != AMVP_SUCCESS) {
-            AMVP_LOG_ERR("Unable to query Operating Environment");
-            goto end;
-        }
-
-        /* Try to match against the page returned by server. */
-        rv = match_vendors_page(ctx, vendor, &match, &next_endpoint);
-
-        /* Only query the next page if there is one */
-        if (rv != AMVP_SUCCESS || match) {
-            break;
-        }
-        endpoint = next_endpoint;
-        AMVP_LOG_INFO("No matching vendor on this page, moving to next page...");
-    } while (endpoint);
+    rv = query_pages(ctx, "vendor", endpoint, parameters, match_vendors_cb, vendor);
 
 end:
     if (first_endpoint) free(first_endpoint);
-    if (next_endpoint) free(next_endpoint);
     if (parameters) amvp_kv_list_free(parameters);
 
     return rv;
@@ -2144,16 +2331,16 @@ static AMVP_RESULT match_modules_page(AMVP_CTX *ctx,
         version = json_object_get_string(module_obj, "version");
         description = json_object_get_string(module_obj, "description");
 
-        if (type) tmp_module->type = strdup(type);
-        if (name) tmp_module->name = strdup(name);
-        if (version) tmp_module->version = strdup(version);
-        if (description) tmp_module->description = strdup(description);
+        tmp_module->type = (char *)type;
+        tmp_module->name = (char *)name;
+        tmp_module->version = (char *)version;
+        tmp_module->description = (char *)description;
 
         tmp_module->vendor = tmp_vendor;
         vurl = json_object_get_string(module_obj, "vendorUrl");
         aurl = json_object_get_string(module_obj, "addressUrl");
-        if (vurl) tmp_vendor->url = strdup(vurl);
-        if (aurl) tmp_vendor->address.url = strdup(aurl);
+        tmp_vendor->url = (char *)vurl;
+        tmp_vendor->address.url = (char *)aurl;
 
         /*
          * Construct the tmp_vendor->persons
@@ -2179,28 +2366,11 @@ static AMVP_RESULT match_modules_page(AMVP_CTX *ctx,
              */
             c_urls = json_array_get_string(contact_urls, i);
             if (c_urls && (tmp_module->vendor != NULL)) {
-                tmp_module->vendor->persons.person[k].url = strdup(c_urls);
+                tmp_module->vendor->persons.person[k].url = (char *)c_urls;
             }
         }
 
         this_match = compare_modules(module, tmp_module);
-        for (k = 0; k < num_contacts; k++) {
-            if (tmp_module->vendor->persons.person[k].url) {
-                free(tmp_module->vendor->persons.person[k].url);
-            }
-        }
-        free(tmp_module->type);
-        free(tmp_module->name);
-        free(tmp_module->version);
-        free(tmp_module->description);
-        free(tmp_vendor->url);
-        free(tmp_vendor->address.url);
-        tmp_module->type = NULL;
-        tmp_module->name = NULL;
-        tmp_module->version = NULL;
-        tmp_module->description = NULL;
-        tmp_vendor->url = NULL;
-        tmp_vendor->address.url = NULL;
         if (this_match) {
             /*
              * Found a match.
@@ -2251,24 +2421,19 @@ static AMVP_RESULT match_modules_page(AMVP_CTX *ctx,
     }
 
 end:
-    if (tmp_module) {
-        if (tmp_module->type) free(tmp_module->type);
-        if (tmp_module->name) free(tmp_module->name);
-        if (tmp_module->version) free(tmp_module->version);
-        if (tmp_module->description) free(tmp_module->description);
-        free(tmp_module);
-    }
-    if (tmp_vendor) {
-        if (tmp_vendor->url) free(tmp_vendor->url);
-        if (tmp_vendor->address.url) free(tmp_vendor->address.url);
-        free(tmp_vendor);
-    }
+    /* The fields point into val, only the structs themselves are ours */
+    if (tmp_module) free(tmp_module);
+    if (tmp_vendor) free(tmp_vendor);
 
     if (val) json_value_free(val);
 
     return rv;
 }
 
+static AMVP_RESULT match_modules_cb(AMVP_CTX *ctx, void *resource, int *match, char **next_endpoint) {
+    return match_modules_page(ctx, (AMVP_MODULE *)resource, match, next_endpoint);
+}
+
 /**
  * @brief Query the server DB for the specified Module data.
  *
@@ -2286,8 +2451,7 @@ static AMVP_RESULT query_module(AMVP_CTX *ctx,
                                 const char *endpoint) {
     AMVP_RESULT rv = 0;
     AMVP_KV_LIST *parameters = NULL;
-    char *first_endpoint = NULL, *next_endpoint = NULL;
-    int match = 0;
+    char *first_endpoint = NULL;
 
     if (!ctx) return AMVP_NO_CTX;
     if (module == NULL) {
@@ -2369,38 +2533,10 @@ static AMVP_RESULT query_module(AMVP_CTX *ctx,
         }
     }
 
-    AMVP_LOG_INFO("Querying the server for a matching module entry...");
-    do {
-        /* Query the server DB. */
-        if (parameters) {
-            /* Use parameters and free them, as we get the next pages'
-             * URLs from the server */
-            rv = amvp_transport_get(ctx, endpoint, parameters);
-            amvp_kv_list_free(parameters);
-            parameters = NULL;
-        } else {
-            rv = amvp_transport_get(ctx, endpoint, NULL);
-        }
-        if (rv != AMVP_SUCCESS) {
-            AMVP_LOG_ERR("Unable to query Operating Environment");
-            goto end;
-        }
-
-        /* Try to match against the page returned by server, iterate endpoint */
-        rv = match_modules_page(ctx, module, &match, &next_endpoint);
-
-        /* Only query the next page if we are within the limit */
-        if (rv != AMVP_SUCCESS || match) {
-           break;
-        }
-        
-        endpoint = next_endpoint;
-        AMVP_LOG_INFO("No matching module on this page, moving to next page...");
-    } while (endpoint);
+    rv = query_pages(ctx, "module", endpoint, parameters, match_modules_cb, module);
     
 end:
     if (first_endpoint) free(first_endpoint);
-    if (next_endpoint) free(next_endpoint);
     if (parameters) amvp_kv_list_free(parameters);
 
     return rv;
@@ -2516,6 +2652,8 @@ AMVP_RESULT amvp_verify_fips_validation_metadata(AMVP_CTX *ctx) {
         AMVP_LOG_ERR("Unable to verify Module");
         return rv;
     }
+    /* Keep what was learned even if the session is not freed cleanly */
+    amvp_meta_cache_flush(ctx);
     if (!ctx->fips.oe->url) {
         AMVP_LOG_STATUS("OE was not found on server; a new one will be created when the validation request is "
                         "submitted. If you believe this to be in error, please cancel the session or request and "
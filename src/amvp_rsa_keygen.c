@@ -182,6 +182,49 @@ static AMVP_RESULT amvp_rsa_keygen_release_tc(AMVP_RSA_KEYGEN_TC *stc) {
     return AMVP_SUCCESS;
 }
 
+/*
+ * Release the per test case state of a vector set. stcs[0..batch->count)
+ * were passed to amvp_rsa_keygen_init_tc(); their response objects are
+ * already in the response and are freed with it.
+ */
+static void amvp_rsa_keygen_release_batch(AMVP_RSA_KEYGEN_TC *stcs, AMVP_TC_BATCH *batch) {
+    int i;
+
+    if (stcs) {
+        for (i = 0; i < batch->count; i++) {
+            amvp_rsa_keygen_release_tc(&stcs[i]);
+        }
+        free(stcs);
+    }
+    amvp_tc_batch_free(batch);
+}
+
+/*
+ * Relative cost of one keyGen test case. Finding a prime grows with about
+ * the fourth power of its size (a cubic modexp per Miller-Rabin round and
+ * a linear number of candidates), provable primes cost more than probable
+ * ones, and B.3.6 starts the search from the server's xP and xQ. KAT
+ * groups only check the given primes.
+ */
+double amvp_rsa_keygen_cost(int modulo, AMVP_RSA_KEYGEN_MODE rand_pq, AMVP_RSA_TESTTYPE test_type) {
+    double scale = modulo / 2048.0;
+
+    if (test_type == AMVP_RSA_TESTTYPE_KAT) {
+        return 20 * scale * scale * scale;
+    }
+    switch (rand_pq) {
+    case AMVP_RSA_KEYGEN_B32:
+    case AMVP_RSA_KEYGEN_B34:
+        return 3000 * scale * scale * scale * scale;
+    case AMVP_RSA_KEYGEN_B33:
+    case AMVP_RSA_KEYGEN_B35:
+        return 2000 * scale * scale * scale * scale;
+    case AMVP_RSA_KEYGEN_B36:
+    default:
+        return 500 * scale * scale * scale * scale;
+    }
+}
+
 static AMVP_RESULT amvp_rsa_keygen_init_tc(AMVP_CTX *ctx,
                                            AMVP_RSA_KEYGEN_TC *stc,
                                            unsigned int tc_id,
@@ -385,7 +428,7 @@ AMVP_RESULT amvp_rsa_keygen_kat_handler(AMVP_CTX *ctx, JSON_Object *obj) {
     JSON_Array *reg_arry = NULL;
 
     int i, g_cnt;
-    int j, t_cnt;
+    int j, t_cnt = 0;
 
     JSON_Value *r_vs_val = NULL;
     JSON_Object *r_vs = NULL;
@@ -393,8 +436,9 @@ AMVP_RESULT amvp_rsa_keygen_kat_handler(AMVP_CTX *ctx, JSON_Object *obj) {
     JSON_Value *r_tval = NULL, *r_gval = NULL;  /* Response testval, groupval */
     JSON_Object *r_tobj = NULL, *r_gobj = NULL; /* Response testobj, groupobj */
     AMVP_CAPS_LIST *cap;
-    AMVP_RSA_KEYGEN_TC stc;
-    AMVP_TEST_CASE tc;
+    AMVP_RSA_KEYGEN_TC *stcs = NULL;
+    AMVP_TC_BATCH batch;
+    double cost = 0;
     AMVP_RESULT rv;
 
     AMVP_CIPHER alg_id;
@@ -436,9 +480,6 @@ AMVP_RESULT amvp_rsa_keygen_kat_handler(AMVP_CTX *ctx, JSON_Object *obj) {
         return AMVP_INVALID_ARG;
     }
 
-    tc.tc.rsa_keygen = &stc;
-    memzero_s(&stc, sizeof(AMVP_RSA_KEYGEN_TC));
-
     cap = amvp_locate_cap_entry(ctx, alg_id);
     if (!cap) {
         AMVP_LOG_ERR("Server requesting unsupported capability");
@@ -467,6 +508,22 @@ AMVP_RESULT amvp_rsa_keygen_kat_handler(AMVP_CTX *ctx, JSON_Object *obj) {
     groups = json_object_get_array(obj, "testGroups");
     g_cnt = json_array_get_count(groups);
 
+    /*
+     * Each test case of the vector set gets its own TC so the crypto calls
+     * for every group can be run together before any responses are written
+     */
+    rv = amvp_tc_batch_init(&batch, groups);
+    if (rv != AMVP_SUCCESS) {
+        goto err;
+    }
+    if (batch.max > 0) {
+        stcs = calloc(batch.max, sizeof(AMVP_RSA_KEYGEN_TC));
+        if (!stcs) {
+            rv = AMVP_MALLOC_FAIL;
+            goto err;
+        }
+    }
+
     for (i = 0; i < g_cnt; i++) {
         int tgId = 0;
         groupval = json_array_get_value(groups, i);
@@ -487,6 +544,8 @@ AMVP_RESULT amvp_rsa_keygen_kat_handler(AMVP_CTX *ctx, JSON_Object *obj) {
         json_object_set_number(r_gobj, "tgId", tgId);
         json_object_set_value(r_gobj, "tests", json_value_init_array());
         r_tarr = json_object_get_array(r_gobj, "tests");
+        json_array_append_value(r_garr, r_gval);
+        r_gval = NULL;
 
         test_type_str = json_object_get_string(groupobj, "testType");
         if (!test_type_str) {
@@ -606,6 +665,7 @@ AMVP_RESULT amvp_rsa_keygen_kat_handler(AMVP_CTX *ctx, JSON_Object *obj) {
 
         tests = json_object_get_array(groupobj, "tests");
         t_cnt = json_array_get_count(tests);
+        cost = amvp_rsa_keygen_cost(mod, rand_pq, test_type);
 
         for (j = 0; j < t_cnt; j++) {
             AMVP_LOG_VERBOSE("Found new RSA test vector...");
@@ -621,6 +681,8 @@ AMVP_RESULT amvp_rsa_keygen_kat_handler(AMVP_CTX *ctx, JSON_Object *obj) {
              */
             r_tval = json_value_init_object();
             r_tobj = json_value_get_object(r_tval);
+            json_array_append_value(r_tarr, r_tval);
+            batch.r_tobjs[batch.count] = r_tobj;
 
             json_object_set_number(r_tobj, "tcId", tc_id);
 
@@ -629,7 +691,6 @@ AMVP_RESULT amvp_rsa_keygen_kat_handler(AMVP_CTX *ctx, JSON_Object *obj) {
                 if (!e_str) {
                     AMVP_LOG_ERR("Server JSON missing 'e'");
                     rv = AMVP_MISSING_ARG;
-                    json_value_free(r_tval);
                     goto err;
                 }
                 if (strnlen_s(e_str, AMVP_RSA_EXP_LEN_MAX + 1)
@@ -637,7 +698,6 @@ AMVP_RESULT amvp_rsa_keygen_kat_handler(AMVP_CTX *ctx, JSON_Object *obj) {
                     AMVP_LOG_ERR("'e' too long, max allowed=(%d)",
                                     AMVP_RSA_EXP_LEN_MAX);
                     rv = AMVP_INVALID_ARG;
-                    json_value_free(r_tval);
                     goto err;
                 }
             }
@@ -653,7 +713,6 @@ AMVP_RESULT amvp_rsa_keygen_kat_handler(AMVP_CTX *ctx, JSON_Object *obj) {
                     AMVP_LOG_ERR("Server JSON 'bitlens' list count is (%u). Expected (%u)",
                                  count, 4);
                     rv = AMVP_INVALID_ARG;
-                    json_value_free(r_tval);
                     goto err;
                 }
 
@@ -669,7 +728,6 @@ AMVP_RESULT amvp_rsa_keygen_kat_handler(AMVP_CTX *ctx, JSON_Object *obj) {
                     if (!seed) {
                         AMVP_LOG_ERR("Server JSON missing 'seed'");
                         rv = AMVP_MISSING_ARG;
-                        json_value_free(r_tval);
                         goto err;
                     }
                     seed_len = strnlen_s(seed, AMVP_RSA_SEEDLEN_MAX + 1);
@@ -677,7 +735,6 @@ AMVP_RESULT amvp_rsa_keygen_kat_handler(AMVP_CTX *ctx, JSON_Object *obj) {
                         AMVP_LOG_ERR("'seed' too long, max allowed=(%d)",
                                     AMVP_RSA_SEEDLEN_MAX);
                         rv = AMVP_INVALID_ARG;
-                        json_value_free(r_tval);
                         goto err;
                     }
                 }
@@ -689,92 +746,89 @@ AMVP_RESULT amvp_rsa_keygen_kat_handler(AMVP_CTX *ctx, JSON_Object *obj) {
                 if (!xp_str) {
                     AMVP_LOG_ERR("Server JSON missing 'xP'");
                     rv = AMVP_MISSING_ARG;
-                    json_value_free(r_tval);
                     goto err;
                 }
                 xp1_str = json_object_get_string(testobj, "xP1");
                 if (!xp1_str) {
                     AMVP_LOG_ERR("Server JSON missing 'xP1'");
                     rv = AMVP_MISSING_ARG;
-                    json_value_free(r_tval);
                     goto err;
                 }
                 xp2_str = json_object_get_string(testobj, "xP2");
                 if (!xp2_str) {
                     AMVP_LOG_ERR("Server JSON missing 'xP2'");
                     rv = AMVP_MISSING_ARG;
-                    json_value_free(r_tval);
                     goto err;
                 }
                 xq_str = json_object_get_string(testobj, "xQ");
                 if (!xq_str) {
                     AMVP_LOG_ERR("Server JSON missing 'xQ'");
                     rv = AMVP_MISSING_ARG;
-                    json_value_free(r_tval);
                     goto err;
                 }
                 xq1_str = json_object_get_string(testobj, "xQ1");
                 if (!xq1_str) {
                     AMVP_LOG_ERR("Server JSON missing 'xQ1'");
                     rv = AMVP_MISSING_ARG;
-                    json_value_free(r_tval);
                     goto err;
                 }
                 xq2_str = json_object_get_string(testobj, "xQ2");
                 if (!xq2_str) {
                     AMVP_LOG_ERR("Server JSON missing 'xQ2'");
                     rv = AMVP_MISSING_ARG;
-                    json_value_free(r_tval);
                     goto err;
                 }
             }
 
-            rv = amvp_rsa_keygen_init_tc(ctx, &stc, tc_id, test_type, info_gen_by_server, hash_alg, 
+            rv = amvp_rsa_keygen_init_tc(ctx, &stcs[batch.count], tc_id, test_type, info_gen_by_server, hash_alg, 
                                          key_format, pub_exp_mode, mod, prime_test, rand_pq, e_str,
                                          p_str, q_str, xp_str, xp1_str, xp2_str, xq_str, xq1_str, 
                                          xq2_str, seed, seed_len, bitlen1, bitlen2, bitlen3, bitlen4);
-
-            /* Process the current test vector... */
-            if (rv == AMVP_SUCCESS) {
-                if ((cap->crypto_handler)(&tc)) {
-                    AMVP_LOG_ERR("ERROR: crypto module failed the operation");
-                    rv = AMVP_CRYPTO_MODULE_FAIL;
-                    json_value_free(r_tval);
-                    goto err;
-                }
-            }
-
-            /*
-             * Output the test case results using JSON
-             */
-            rv = amvp_rsa_output_tc(ctx, &stc, r_tobj);
+            batch.tcs[batch.count].tc.rsa_keygen = &stcs[batch.count];
+            batch.costs[batch.count] = cost;
+            batch.count++;
             if (rv != AMVP_SUCCESS) {
-                AMVP_LOG_ERR("ERROR: JSON output failure in hash module");
-                json_value_free(r_tval);
+                AMVP_LOG_ERR("Failed to initialize RSA keyGen test case");
                 goto err;
             }
+        }
+    }
 
-            /*
-             * Release all the memory associated with the test case
-             */
-            amvp_rsa_keygen_release_tc(&stc);
+    /*
+     * Process the test vectors of every group, on the worker threads if
+     * configured. The cost estimates let the 4096 bit and provable prime
+     * groups start first instead of holding up the end of the run.
+     */
+    rv = amvp_worker_run_tcs_cost(ctx, cap, batch.tcs, batch.costs, batch.count);
+    if (rv != AMVP_SUCCESS) {
+        goto err;
+    }
 
-            /* Append the test response value to array */
-            json_array_append_value(r_tarr, r_tval);
+    for (j = 0; j < batch.count; j++) {
+        /*
+         * Output the test case results using JSON
+         */
+        rv = amvp_rsa_output_tc(ctx, &stcs[j], batch.r_tobjs[j]);
+        if (rv != AMVP_SUCCESS) {
+            AMVP_LOG_ERR("ERROR: JSON output failure in hash module");
+            goto err;
         }
-        json_array_append_value(r_garr, r_gval);
     }
+    amvp_rsa_keygen_release_batch(stcs, &batch);
+    stcs = NULL;
 
     json_array_append_value(reg_arry, r_vs_val);
 
-    json_result = json_serialize_to_string_pretty(ctx->kat_resp, NULL);
-    AMVP_LOG_VERBOSE("\n\n%s\n\n", json_result);
-    json_free_serialized_string(json_result);
+    if (AMVP_LOG_ENABLED(AMVP_LOG_LVL_VERBOSE)) {
+        json_result = json_serialize_to_string_pretty(ctx->kat_resp, NULL);
+        AMVP_LOG_VERBOSE("\n\n%s\n\n", json_result);
+        json_free_serialized_string(json_result);
+    }
     rv = AMVP_SUCCESS;
 
 err:
     if (rv != AMVP_SUCCESS) {
-        amvp_rsa_keygen_release_tc(&stc);
+        amvp_rsa_keygen_release_batch(stcs, &batch);
         amvp_release_json(r_vs_val, r_gval);
     }
     return rv;
@@ -473,7 +473,7 @@ AMVP_RESULT amvp_rsa_decprim_kat_handler(AMVP_CTX *ctx, JSON_Object *obj) {
                    fail = stc.fail;
                    pass = stc.pass;
                    do { 
-                       if ((cap->crypto_handler)(&tc)) {
+                       if (amvp_crypto_call(ctx, cap, &tc)) {
                            AMVP_LOG_ERR("ERROR: crypto module failed the operation");
                            rv = AMVP_CRYPTO_MODULE_FAIL;
                            json_value_free(r_tval);
@@ -511,9 +511,11 @@ AMVP_RESULT amvp_rsa_decprim_kat_handler(AMVP_CTX *ctx, JSON_Object *obj) {
     }
     json_array_append_value(reg_arry, r_vs_val);
 
-    json_result = json_serialize_to_string_pretty(ctx->kat_resp, NULL);
-    AMVP_LOG_VERBOSE("\n\n%s\n\n", json_result);
-    json_free_serialized_string(json_result);
+    if (AMVP_LOG_ENABLED(AMVP_LOG_LVL_VERBOSE)) {
+        json_result = json_serialize_to_string_pretty(ctx->kat_resp, NULL);
+        AMVP_LOG_VERBOSE("\n\n%s\n\n", json_result);
+        json_free_serialized_string(json_result);
+    }
     rv = AMVP_SUCCESS;
 
 err:
@@ -764,7 +766,7 @@ AMVP_RESULT amvp_rsa_sigprim_kat_handler(AMVP_CTX *ctx, JSON_Object *obj) {
 
             /* Process the current test vector... */
             if (rv == AMVP_SUCCESS) {
-                if ((cap->crypto_handler)(&tc)) {
+                if (amvp_crypto_call(ctx, cap, &tc)) {
                     AMVP_LOG_ERR("ERROR: crypto module failed the operation");
                     rv = AMVP_CRYPTO_MODULE_FAIL;
                     json_value_free(r_tval);
@@ -795,9 +797,11 @@ AMVP_RESULT amvp_rsa_sigprim_kat_handler(AMVP_CTX *ctx, JSON_Object *obj) {
 
     json_array_append_value(reg_arry, r_vs_val);
 
-    json_result = json_serialize_to_string_pretty(ctx->kat_resp, NULL);
-    AMVP_LOG_VERBOSE("\n\n%s\n\n", json_result);
-    json_free_serialized_string(json_result);
+    if (AMVP_LOG_ENABLED(AMVP_LOG_LVL_VERBOSE)) {
+        json_result = json_serialize_to_string_pretty(ctx->kat_resp, NULL);
+        AMVP_LOG_VERBOSE("\n\n%s\n\n", json_result);
+        json_free_serialized_string(json_result);
+    }
     rv = AMVP_SUCCESS;
 
 err:
@@ -154,7 +154,52 @@ static AMVP_RESULT amvp_safe_primes_init_tc(AMVP_CTX *ctx,
     return AMVP_SUCCESS;
 }
 
+/*
+ * Relative cost of one test case. Both keyGen and keyVer come down to
+ * a modexp in the group, cubic in its size.
+ */
+double amvp_safe_primes_cost(AMVP_CIPHER alg_id, AMVP_SAFE_PRIMES_MODE dgm) {
+    double scale = 1;
+
+    switch (dgm) {
+    case AMVP_SAFE_PRIMES_MODP3072:
+    case AMVP_SAFE_PRIMES_FFDHE3072:
+        scale = 1.5;
+        break;
+    case AMVP_SAFE_PRIMES_MODP4096:
+    case AMVP_SAFE_PRIMES_FFDHE4096:
+        scale = 2;
+        break;
+    case AMVP_SAFE_PRIMES_MODP6144:
+    case AMVP_SAFE_PRIMES_FFDHE6144:
+        scale = 3;
+        break;
+    case AMVP_SAFE_PRIMES_MODP8192:
+    case AMVP_SAFE_PRIMES_FFDHE8192:
+        scale = 4;
+        break;
+    default:
+        break;
+    }
+    /* keyGen also has to pick x and check the result */
+    return (alg_id == AMVP_SAFE_PRIMES_KEYGEN ? 20 : 10) * scale * scale * scale;
+}
+
+/*
+ * Release the test cases of a vector set, stcs[0..batch->count) having
+ * been passed to amvp_safe_primes_init_tc().
+ */
+static void amvp_safe_primes_release_batch(AMVP_SAFE_PRIMES_TC *stcs, AMVP_TC_BATCH *batch) {
+    int i;
 
+    if (stcs) {
+        for (i = 0; i < batch->count; i++) {
+            amvp_safe_primes_release_tc(&stcs[i]);
+        }
+        free(stcs);
+    }
+    amvp_tc_batch_free(batch);
+}
 
 AMVP_RESULT amvp_safe_primes_kat_handler(AMVP_CTX *ctx, JSON_Object *obj) {
     JSON_Value *r_vs_val = NULL;
@@ -172,8 +217,9 @@ AMVP_RESULT amvp_safe_primes_kat_handler(AMVP_CTX *ctx, JSON_Object *obj) {
     JSON_Value *r_tval = NULL, *r_gval = NULL;  /* Response testval, groupval */
     JSON_Object *r_tobj = NULL, *r_gobj = NULL; /* Response testobj, groupobj */
     AMVP_CAPS_LIST *cap;
-    AMVP_TEST_CASE tc;
-    AMVP_SAFE_PRIMES_TC stc;
+    AMVP_SAFE_PRIMES_TC *stcs = NULL;
+    AMVP_TC_BATCH batch;
+    double cost = 0;
     AMVP_RESULT rv = AMVP_SUCCESS;
     const char *alg_str = NULL, *dgm_str = NULL, *test_type_str = NULL;
     char *json_result = NULL;
@@ -209,12 +255,6 @@ AMVP_RESULT amvp_safe_primes_kat_handler(AMVP_CTX *ctx, JSON_Object *obj) {
         return AMVP_INVALID_ARG;
     }
 
-    /*
-     * Get a reference to the abstracted test case
-     */
-    tc.tc.safe_primes = &stc;
-    memzero_s(&stc, sizeof(AMVP_SAFE_PRIMES_TC));
-
     cap = amvp_locate_cap_entry(ctx, alg_id);
     if (!cap) {
         AMVP_LOG_ERR("AMVP server requesting unsupported capability");
@@ -243,6 +283,23 @@ AMVP_RESULT amvp_safe_primes_kat_handler(AMVP_CTX *ctx, JSON_Object *obj) {
     groups = json_object_get_array(obj, "testGroups");
     g_cnt = json_array_get_count(groups);
 
+    /*
+     * Every group is read before any crypto calls are made, so the
+     * workers can start on the 6144 and 8192 bit groups first
+     */
+    rv = amvp_tc_batch_init(&batch, groups);
+    if (rv != AMVP_SUCCESS) {
+        json_value_free(r_vs_val);
+        return rv;
+    }
+    if (batch.max > 0) {
+        stcs = calloc(batch.max, sizeof(AMVP_SAFE_PRIMES_TC));
+        if (!stcs) {
+            rv = AMVP_MALLOC_FAIL;
+            goto err;
+        }
+    }
+
     for (i = 0; i < g_cnt; i++) {
         groupval = json_array_get_value(groups, i);
         groupobj = json_value_get_object(groupval);
@@ -262,6 +319,8 @@ AMVP_RESULT amvp_safe_primes_kat_handler(AMVP_CTX *ctx, JSON_Object *obj) {
         json_object_set_number(r_gobj, "tg_id", tg_id);
         json_object_set_value(r_gobj, "tests", json_value_init_array());
         r_tarr = json_object_get_array(r_gobj, "tests");
+        json_array_append_value(r_garr, r_gval);
+        r_gval = NULL;
 
         dgm_str = json_object_get_string(groupobj, "safePrimeGroup");
         if (!dgm_str) {
@@ -287,6 +346,7 @@ AMVP_RESULT amvp_safe_primes_kat_handler(AMVP_CTX *ctx, JSON_Object *obj) {
             rv = AMVP_INVALID_ARG;
             goto err;
         }
+        cost = amvp_safe_primes_cost(alg_id, dgm);
     
         switch (alg) {
         case AMVP_SUB_SAFE_PRIMES_KEYGEN:
@@ -326,45 +386,21 @@ AMVP_RESULT amvp_safe_primes_kat_handler(AMVP_CTX *ctx, JSON_Object *obj) {
                 r_tobj = json_value_get_object(r_tval);
 
                 json_object_set_number(r_tobj, "tcId", tc_id);
+                json_array_append_value(r_tarr, r_tval);
+                batch.r_tobjs[batch.count] = r_tobj;
+
                 /*
                  * Setup the test case data that will be passed down to
                  * the crypto module.
                  */
                 rv = amvp_safe_primes_init_tc(ctx, tg_id, tc_id, alg_id, 
-                                              &stc, dgm, x, y, test_type);
+                                              &stcs[batch.count], dgm, x, y, test_type);
+                batch.tcs[batch.count].tc.safe_primes = &stcs[batch.count];
+                batch.costs[batch.count] = cost;
+                batch.count++;
                 if (rv != AMVP_SUCCESS) {
-                    amvp_safe_primes_release_tc(&stc);
-                    json_value_free(r_tval);
-                    goto err;
-                }
-
-                /* Process the current KAT test vector... */
-                if ((cap->crypto_handler)(&tc)) {
-                    amvp_safe_primes_release_tc(&stc);
-                    AMVP_LOG_ERR("crypto module failed the operation");
-                    rv = AMVP_CRYPTO_MODULE_FAIL;
-                    json_value_free(r_tval);
-                    goto err;
-                }
-
-                /*
-                 * Output the test case results using JSON
-                 */
-                rv = amvp_safe_primes_output_tc(ctx, &stc, r_tobj);
-                if (rv != AMVP_SUCCESS) {
-                    AMVP_LOG_ERR("JSON output failure in KAS-FFC module");
-                    amvp_safe_primes_release_tc(&stc);
-                    json_value_free(r_tval);
                     goto err;
                 }
-
-                /*
-                 * Release all the memory associated with the test case
-                 */
-                amvp_safe_primes_release_tc(&stc);
-
-                /* Append the test response value to array */
-                json_array_append_value(r_tarr, r_tval);
             }
             break;
         
@@ -423,45 +459,21 @@ AMVP_RESULT amvp_safe_primes_kat_handler(AMVP_CTX *ctx, JSON_Object *obj) {
                     goto err;
                 }
 
+                json_array_append_value(r_tarr, r_tval);
+                batch.r_tobjs[batch.count] = r_tobj;
+
                 /*
                  * Setup the test case data that will be passed down to
                  * the crypto module.
                  */
-                 rv = amvp_safe_primes_init_tc(ctx, tg_id, tc_id, alg_id, 
-                                               &stc, dgm, x, y, test_type);
-                if (rv != AMVP_SUCCESS) {
-                    amvp_safe_primes_release_tc(&stc);
-                    json_value_free(r_tval);
-                    goto err;
-                }
-
-                /* Process the current KAT test vector... */
-                if ((cap->crypto_handler)(&tc)) {
-                    amvp_safe_primes_release_tc(&stc);
-                    AMVP_LOG_ERR("crypto module failed the operation");
-                    rv = AMVP_CRYPTO_MODULE_FAIL;
-                    json_value_free(r_tval);
-                    goto err;
-                }
-
-                /*
-                 * Output the test case results using JSON
-                 */
-                rv = amvp_safe_primes_output_tc(ctx, &stc, r_tobj);
+                rv = amvp_safe_primes_init_tc(ctx, tg_id, tc_id, alg_id, 
+                                              &stcs[batch.count], dgm, x, y, test_type);
+                batch.tcs[batch.count].tc.safe_primes = &stcs[batch.count];
+                batch.costs[batch.count] = cost;
+                batch.count++;
                 if (rv != AMVP_SUCCESS) {
-                    AMVP_LOG_ERR("JSON output failure in KAS-FFC module");
-                    amvp_safe_primes_release_tc(&stc);
-                    json_value_free(r_tval);
                     goto err;
                 }
-
-                /*
-                 * Release all the memory associated with the test case
-                 */
-                amvp_safe_primes_release_tc(&stc);
-
-                /* Append the test response value to array */
-                json_array_append_value(r_tarr, r_tval);
             }
             break;
         case AMVP_SUB_KAS_ECC_CDH:
@@ -479,19 +491,40 @@ AMVP_RESULT amvp_safe_primes_kat_handler(AMVP_CTX *ctx, JSON_Object *obj) {
         default:
             break;
         }
-        json_array_append_value(r_garr, r_gval);
     }
+
+    /* Process the test vectors of every group, on the worker threads if configured */
+    rv = amvp_worker_run_tcs_cost(ctx, cap, batch.tcs, batch.costs, batch.count);
+    if (rv != AMVP_SUCCESS) {
+        goto err;
+    }
+
+    for (j = 0; j < batch.count; j++) {
+        /*
+         * Output the test case results using JSON
+         */
+        rv = amvp_safe_primes_output_tc(ctx, &stcs[j], batch.r_tobjs[j]);
+        if (rv != AMVP_SUCCESS) {
+            AMVP_LOG_ERR("JSON output failure in KAS-FFC module");
+            goto err;
+        }
+    }
+    amvp_safe_primes_release_batch(stcs, &batch);
+    stcs = NULL;
+
     json_array_append_value(reg_arry, r_vs_val);
 
-    json_result = json_serialize_to_string_pretty(ctx->kat_resp, NULL);
-    AMVP_LOG_VERBOSE("\n\n%s\n\n", json_result);
-    json_free_serialized_string(json_result);
+    if (AMVP_LOG_ENABLED(AMVP_LOG_LVL_VERBOSE)) {
+        json_result = json_serialize_to_string_pretty(ctx->kat_resp, NULL);
+        AMVP_LOG_VERBOSE("\n\n%s\n\n", json_result);
+        json_free_serialized_string(json_result);
+    }
     rv = AMVP_SUCCESS;
 
 err:
     if (rv != AMVP_SUCCESS) {
         json_value_free(r_gval);
-        amvp_safe_primes_release_tc(&stc);
+        amvp_safe_primes_release_batch(stcs, &batch);
         json_value_free(r_vs_val);
     }
     return rv;
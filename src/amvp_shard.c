@@ -0,0 +1,367 @@
+/** @file */
+/*
+ * Copyright (c) 2021, Cisco Systems, Inc.
+ *
+ * Licensed under the Apache License 2.0 (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://github.com/cisco/libamvp/LICENSE
+ */
+
+/*
+ * Splitting an offline request file into shards that can be processed by
+ * amvp_run_vectors_from_file() on separate processes or hosts, and merging
+ * the shards' response files back into one for
+ * amvp_upload_vectors_from_file().
+ *
+ * Every shard keeps the identifiers of the original file (session URL, JWT,
+ * isSample), with the vector set URL list cut down to the shard's own
+ * vector sets, in the order they appear in it. The vector sets themselves
+ * are copied byte for byte, they are never parsed.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "amvp.h"
+#include "amvp_lcl.h"
+#include "parson.h"
+#include "safe_lib.h"
+
+/* One vector set of the file being sharded */
+typedef struct amvp_shard_vs_t {
+    const char *elem;           /* Points into the mapped request file */
+    size_t elem_len;
+    const char *url;
+    int shard;
+} AMVP_SHARD_VS;
+
+/*
+ * Returns the vector set URL list of an offline file's identifiers. Request
+ * files written by different paths name it differently.
+ */
+static const char *amvp_shard_url_key(JSON_Object *obj) {
+    if (json_object_get_array(obj, "vectorSetUrls")) {
+        return "vectorSetUrls";
+    }
+    if (json_object_get_array(obj, "ieSetsId")) {
+        return "ieSetsId";
+    }
+    return NULL;
+}
+
+/*
+ * Writes the identifiers hdr, with its URL list replaced by the URLs of
+ * the vector sets of shard, then those vector sets, to filename.
+ */
+static AMVP_RESULT amvp_shard_write(AMVP_CTX *ctx, const char *filename, JSON_Value *hdr, const char *url_key,
+                                    AMVP_SHARD_VS *sets, int count, int shard) {
+    JSON_Value *copy = NULL;
+    JSON_Array *urls = NULL;
+    AMVP_RESULT rv = AMVP_SUCCESS;
+    char *hdr_str = NULL;
+    FILE *fp = NULL;
+    int i;
+
+    copy = json_value_deep_copy(hdr);
+    if (!copy) {
+        return AMVP_MALLOC_FAIL;
+    }
+    json_object_set_value(json_value_get_object(copy), url_key, json_value_init_array());
+    urls = json_object_get_array(json_value_get_object(copy), url_key);
+    for (i = 0; i < count; i++) {
+        if (sets[i].shard == shard) {
+            json_array_append_string(urls, sets[i].url);
+        }
+    }
+    hdr_str = json_serialize_to_string(copy, NULL);
+    if (!hdr_str) {
+        rv = AMVP_JSON_ERR;
+        goto end;
+    }
+
+    fp = fopen(filename, "w");
+    if (!fp || fputs("[ ", fp) == EOF || fputs(hdr_str, fp) == EOF) {
+        rv = AMVP_JSON_ERR;
+        goto end;
+    }
+    for (i = 0; i < count; i++) {
+        if (sets[i].shard != shard) {
+            continue;
+        }
+        if (fputs(", ", fp) == EOF || fwrite(sets[i].elem, 1, sets[i].elem_len, fp) != sets[i].elem_len) {
+            rv = AMVP_JSON_ERR;
+            goto end;
+        }
+    }
+    if (fputs(" ]", fp) == EOF) {
+        rv = AMVP_JSON_ERR;
+    }
+
+end:
+    if (fp && fclose(fp) == EOF) {
+        rv = AMVP_JSON_ERR;
+    }
+    if (rv != AMVP_SUCCESS) {
+        AMVP_LOG_ERR("Unable to write shard %s", filename);
+    }
+    if (hdr_str) json_free_serialized_string(hdr_str);
+    json_value_free(copy);
+    return rv;
+}
+
+AMVP_RESULT amvp_shard_request_file(AMVP_CTX *ctx, const char *req_filename,
+                                    const char **shard_filenames, int shard_count) {
+    AMVP_JSON_FILE_READER rdr;
+    AMVP_RESULT rv = AMVP_SUCCESS;
+    AMVP_SHARD_VS *sets = NULL;
+    JSON_Value *hdr = NULL;
+    JSON_Array *urls = NULL;
+    const char *url_key = NULL;
+    size_t *load = NULL;
+    int count = 0, i, j, k, pick;
+
+    if (!ctx) {
+        return AMVP_NO_CTX;
+    }
+    if (!req_filename || !shard_filenames) {
+        AMVP_LOG_ERR("Must provide value for JSON filename");
+        return AMVP_MISSING_ARG;
+    }
+    if (shard_count < 1) {
+        AMVP_LOG_ERR("shard_count must be at least 1");
+        return AMVP_INVALID_ARG;
+    }
+    if (strnlen_s(req_filename, AMVP_JSON_FILENAME_MAX + 1) > AMVP_JSON_FILENAME_MAX) {
+        AMVP_LOG_ERR("Provided req_filename length > max(%d)", AMVP_JSON_FILENAME_MAX);
+        return AMVP_INVALID_ARG;
+    }
+    for (i = 0; i < shard_count; i++) {
+        if (!shard_filenames[i]) {
+            AMVP_LOG_ERR("Must provide value for JSON filename");
+            return AMVP_MISSING_ARG;
+        }
+    }
+
+    memzero_s(&rdr, sizeof(rdr));
+    rv = amvp_json_reader_open(&rdr, req_filename);
+    if (rv != AMVP_SUCCESS) {
+        AMVP_LOG_ERR("Unable to open %s", req_filename);
+        return rv;
+    }
+    rv = amvp_json_reader_next(&rdr, &hdr);
+    url_key = amvp_shard_url_key(json_value_get_object(hdr));
+    if (rv != AMVP_SUCCESS || !url_key) {
+        AMVP_LOG_ERR("Missing vector set URLs in %s", req_filename);
+        rv = AMVP_MALFORMED_JSON;
+        goto end;
+    }
+    urls = json_object_get_array(json_value_get_object(hdr), url_key);
+    count = (int)json_array_get_count(urls);
+    if (!count) {
+        AMVP_LOG_ERR("No vector sets in %s", req_filename);
+        rv = AMVP_NO_DATA;
+        goto end;
+    }
+
+    sets = calloc(count, sizeof(AMVP_SHARD_VS));
+    load = calloc(shard_count, sizeof(size_t));
+    if (!sets || !load) {
+        rv = AMVP_MALLOC_FAIL;
+        goto end;
+    }
+    for (i = 0; i < count; i++) {
+        sets[i].url = json_array_get_string(urls, i);
+        rv = amvp_json_reader_next_slice(&rdr, &sets[i].elem, &sets[i].elem_len);
+        if (rv != AMVP_SUCCESS || !sets[i].elem || !sets[i].url) {
+            AMVP_LOG_ERR("%s has fewer vector sets than URLs", req_filename);
+            rv = AMVP_MALFORMED_JSON;
+            goto end;
+        }
+        sets[i].shard = -1;
+    }
+
+    /*
+     * Balance the shards by size, which tracks the work well enough: the
+     * largest remaining vector set goes to the least loaded shard.
+     */
+    for (i = 0; i < count; i++) {
+        pick = -1;
+        for (j = 0; j < count; j++) {
+            if (sets[j].shard < 0 && (pick < 0 || sets[j].elem_len > sets[pick].elem_len)) {
+                pick = j;
+            }
+        }
+        k = 0;
+        for (j = 1; j < shard_count; j++) {
+            if (load[j] < load[k]) {
+                k = j;
+            }
+        }
+        sets[pick].shard = k;
+        load[k] += sets[pick].elem_len;
+    }
+
+    for (k = 0; k < shard_count; k++) {
+        rv = amvp_shard_write(ctx, shard_filenames[k], hdr, url_key, sets, count, k);
+        if (rv != AMVP_SUCCESS) {
+            goto end;
+        }
+    }
+    AMVP_LOG_STATUS("Split %d vector sets of %s into %d shards", count, req_filename, shard_count);
+
+end:
+    if (sets) free(sets);
+    if (load) free(load);
+    json_value_free(hdr);
+    amvp_json_reader_close(&rdr);
+    return rv;
+}
+
+/*
+ * Checks that the identifiers of a shard belong to the same session as
+ * those of the first one.
+ */
+static int amvp_shard_same_session(JSON_Object *first, JSON_Object *obj) {
+    const char *a = json_object_get_string(first, "url");
+    const char *b = json_object_get_string(obj, "url");
+    int diff = 1;
+
+    if (!a || !b) {
+        return 0;
+    }
+    strcmp_s(a, AMVP_ATTR_URL_MAX, b, &diff);
+    return !diff;
+}
+
+AMVP_RESULT amvp_merge_response_files(AMVP_CTX *ctx, const char **rsp_filenames, int rsp_count,
+                                      const char *rsp_filename) {
+    AMVP_JSON_FILE_READER rdr;
+    AMVP_RESULT rv = AMVP_SUCCESS;
+    JSON_Value *merged = NULL, *hdr = NULL;
+    JSON_Array *urls = NULL, *shard_urls = NULL;
+    const char *url_key = NULL, *elem = NULL;
+    size_t elem_len = 0;
+    char *hdr_str = NULL;
+    FILE *fp = NULL;
+    int i, j, cnt;
+
+    if (!ctx) {
+        return AMVP_NO_CTX;
+    }
+    if (!rsp_filenames || !rsp_filename) {
+        AMVP_LOG_ERR("Must provide value for JSON filename");
+        return AMVP_MISSING_ARG;
+    }
+    if (rsp_count < 1) {
+        AMVP_LOG_ERR("rsp_count must be at least 1");
+        return AMVP_INVALID_ARG;
+    }
+    if (strnlen_s(rsp_filename, AMVP_JSON_FILENAME_MAX + 1) > AMVP_JSON_FILENAME_MAX) {
+        AMVP_LOG_ERR("Provided rsp_filename length > max(%d)", AMVP_JSON_FILENAME_MAX);
+        return AMVP_INVALID_ARG;
+    }
+    memzero_s(&rdr, sizeof(rdr));
+
+    /* First the identifiers, with the URL lists of the shards joined in order */
+    for (i = 0; i < rsp_count; i++) {
+        if (!rsp_filenames[i]) {
+            AMVP_LOG_ERR("Must provide value for JSON filename");
+            rv = AMVP_MISSING_ARG;
+            goto end;
+        }
+        rv = amvp_json_reader_open(&rdr, rsp_filenames[i]);
+        if (rv != AMVP_SUCCESS) {
+            AMVP_LOG_ERR("Unable to open %s", rsp_filenames[i]);
+            goto end;
+        }
+        rv = amvp_json_reader_next(&rdr, &hdr);
+        amvp_json_reader_close(&rdr);
+        if (rv != AMVP_SUCCESS || !amvp_shard_url_key(json_value_get_object(hdr))) {
+            AMVP_LOG_ERR("Missing vector set URLs in %s", rsp_filenames[i]);
+            rv = AMVP_MALFORMED_JSON;
+            goto end;
+        }
+        shard_urls = json_object_get_array(json_value_get_object(hdr), amvp_shard_url_key(json_value_get_object(hdr)));
+        if (!merged) {
+            merged = hdr;
+            hdr = NULL;
+            url_key = amvp_shard_url_key(json_value_get_object(merged));
+            urls = shard_urls;
+            continue;
+        }
+        if (!amvp_shard_same_session(json_value_get_object(merged), json_value_get_object(hdr))) {
+            AMVP_LOG_ERR("%s is from a different test session than %s", rsp_filenames[i], rsp_filenames[0]);
+            rv = AMVP_INVALID_ARG;
+            goto end;
+        }
+        cnt = (int)json_array_get_count(shard_urls);
+        for (j = 0; j < cnt; j++) {
+            json_array_append_string(urls, json_array_get_string(shard_urls, j));
+        }
+        json_value_free(hdr);
+        hdr = NULL;
+    }
+
+    hdr_str = json_serialize_to_string(merged, NULL);
+    fp = fopen(rsp_filename, "w");
+    if (!hdr_str || !fp || fputs("[ ", fp) == EOF || fputs(hdr_str, fp) == EOF) {
+        AMVP_LOG_ERR("File write error");
+        rv = AMVP_JSON_ERR;
+        goto end;
+    }
+
+    /* Then the responses of each shard, copied as they are */
+    for (i = 0; i < rsp_count; i++) {
+        rv = amvp_json_reader_open(&rdr, rsp_filenames[i]);
+        if (rv != AMVP_SUCCESS) {
+            AMVP_LOG_ERR("Unable to open %s", rsp_filenames[i]);
+            goto end;
+        }
+        rv = amvp_json_reader_next(&rdr, &hdr);
+        if (rv != AMVP_SUCCESS) {
+            goto end;
+        }
+        cnt = (int)json_array_get_count(json_object_get_array(json_value_get_object(hdr), url_key));
+        json_value_free(hdr);
+        hdr = NULL;
+        for (j = 0; ; j++) {
+            rv = amvp_json_reader_next_slice(&rdr, &elem, &elem_len);
+            if (rv != AMVP_SUCCESS) {
+                AMVP_LOG_ERR("JSON parse error at element %d of %s", rdr.count, rsp_filenames[i]);
+                goto end;
+            }
+            if (!elem) {
+                break;
+            }
+            if (fputs(", ", fp) == EOF || fwrite(elem, 1, elem_len, fp) != elem_len) {
+                AMVP_LOG_ERR("File write error");
+                rv = AMVP_JSON_ERR;
+                goto end;
+            }
+        }
+        amvp_json_reader_close(&rdr);
+        if (j != cnt) {
+            AMVP_LOG_ERR("%s has %d responses for %d vector sets", rsp_filenames[i], j, cnt);
+            rv = AMVP_MALFORMED_JSON;
+            goto end;
+        }
+    }
+    if (fputs(" ]", fp) == EOF) {
+        AMVP_LOG_ERR("File write error");
+        rv = AMVP_JSON_ERR;
+        goto end;
+    }
+    AMVP_LOG_STATUS("Merged %d response files into %s", rsp_count, rsp_filename);
+
+end:
+    if (fp && fclose(fp) == EOF && rv == AMVP_SUCCESS) {
+        AMVP_LOG_ERR("File write error");
+        rv = AMVP_JSON_ERR;
+    }
+    if (hdr_str) json_free_serialized_string(hdr_str);
+    json_value_free(hdr);
+    json_value_free(merged);
+    amvp_json_reader_close(&rdr);
+    return rv;
+}
@@ -13,10 +13,20 @@
 #elif !defined AMVP_OFFLINE
 #include <curl/curl.h>
 #endif
+#if defined AMVP_HAVE_ZLIB && !defined USE_MURL
+#include <zlib.h>
+#endif
 
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <limits.h>
+#include <ctype.h>
+#include <time.h>
+#ifndef _WIN32
+#include <pthread.h>
+#include <unistd.h>
+#endif
 #include "amvp.h"
 #include "amvp_lcl.h"
 #include "amvp_error.h"
@@ -46,8 +56,17 @@
  * Macros
  */
 #define HTTP_OK    200
+#define HTTP_NOT_MODIFIED 304
 #define HTTP_UNAUTH    401
 #define HTTP_BAD_REQ 400
+#define HTTP_RESUME_INCOMPLETE 308
+
+/* Request bodies smaller than this are sent as is even with compression enabled */
+#define AMVP_COMPRESS_MIN_BODY 1024
+
+/* Chunked uploads, see amvp_set_chunked_upload() */
+#define AMVP_HTTP_RANGE_MAX 64
+#define AMVP_CHUNK_RETRIES 5
 
 //Used for knowing which environment variable is being looked for in case of HTTP user-agent.
 typedef enum amvp_user_agent_env_type {
@@ -82,6 +101,7 @@ typedef enum amvp_net_action {
  */
 static AMVP_RESULT amvp_network_action(AMVP_CTX *ctx, AMVP_NET_ACTION action,
                                        const char *url, const char *data, int data_len);
+static AMVP_RESULT inspect_http_code(AMVP_CTX *ctx, int code);
 
 static struct curl_slist *amvp_add_auth_hdr(AMVP_CTX *ctx, struct curl_slist *slist) {
     char *bearer = NULL;
@@ -135,6 +155,110 @@ end:
     return slist;
 }
 
+#if defined AMVP_HAVE_ZLIB && !defined USE_MURL
+/*
+ * With amvp_set_upload_compression() enabled, gzip a request body so it
+ * can be sent with "Content-Encoding: gzip". Returns NULL when the body
+ * should go out as is: compression is off, the body is small, or it did
+ * not get any smaller. The caller frees the result.
+ */
+static char *amvp_compress_body(AMVP_CTX *ctx, const char *data, int data_len, int *out_len) {
+    z_stream strm;
+    char *out = NULL;
+    uLong bound = 0;
+    int zrv = 0;
+
+    if (!ctx->upload_compress || !data || data_len < AMVP_COMPRESS_MIN_BODY) {
+        return NULL;
+    }
+
+    memzero_s(&strm, sizeof(strm));
+    /* 15 + 16: a gzip wrapper rather than raw zlib */
+    if (deflateInit2(&strm, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        AMVP_LOG_WARN("Unable to initialize compression, sending request uncompressed");
+        return NULL;
+    }
+    bound = deflateBound(&strm, (uLong)data_len);
+    out = malloc(bound);
+    if (!out) {
+        deflateEnd(&strm);
+        return NULL;
+    }
+    strm.next_in = (Bytef *)data;
+    strm.avail_in = (uInt)data_len;
+    strm.next_out = (Bytef *)out;
+    strm.avail_out = (uInt)bound;
+    zrv = deflate(&strm, Z_FINISH);
+    deflateEnd(&strm);
+    if (zrv != Z_STREAM_END || strm.total_out >= (uLong)data_len) {
+        free(out);
+        return NULL;
+    }
+    AMVP_LOG_VERBOSE("Compressed request body from %d to %lu bytes", data_len, strm.total_out);
+    *out_len = (int)strm.total_out;
+    return out;
+}
+#else
+static char *amvp_compress_body(AMVP_CTX *ctx, const char *data, int data_len, int *out_len) {
+    (void)ctx; (void)data; (void)data_len; (void)out_len;
+    return NULL;
+}
+#endif
+
+/*
+ * Appends a chunk of an HTTP body to a growable buffer.
+ *
+ * The buffer is grown on demand. On the first chunk of a response
+ * the Content-Length (if the server sent one) is used to size it
+ * in one step; otherwise it doubles as data arrives. The buffer is
+ * kept between requests and is always NUL terminated. Its memory is
+ * counted in the metrics, so it is freed with amvp_mem_free().
+ *
+ * Returns the number of bytes consumed, 0 on failure (which makes
+ * curl abort the transfer).
+ */
+static size_t amvp_curl_buf_append(char **buf, int *len, int *buf_size, CURL *hnd,
+                                   const void *ptr, size_t nmemb) {
+    size_t needed = 0, new_size = 0;
+    char *tmp = NULL;
+#ifndef USE_MURL
+    curl_off_t content_len = -1;
+#endif
+
+    /* Room for the new data plus the terminator */
+    needed = (size_t)*len + nmemb + 1;
+    if (needed > (size_t)*buf_size) {
+        new_size = *buf_size ? (size_t)*buf_size : AMVP_CURL_BUF_INIT_SIZE;
+#ifndef USE_MURL
+        if (*len == 0 && hnd &&
+                curl_easy_getinfo(hnd, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &content_len) == CURLE_OK &&
+                content_len > 0 && (size_t)content_len + 1 > new_size) {
+            new_size = (size_t)content_len + 1;
+        }
+#endif
+        while (new_size < needed) {
+            new_size *= 2;
+        }
+        if (new_size > INT_MAX) {
+            fprintf(stderr, "\nServer response is too large\n");
+            return 0;
+        }
+        tmp = amvp_mem_realloc(*buf, new_size);
+        if (!tmp) {
+            fprintf(stderr, "\nmalloc failed in curl write reg func\n");
+            return 0;
+        }
+        *buf = tmp;
+        *buf_size = (int)new_size;
+    }
+
+    memcpy_s(&(*buf)[*len], (*buf_size - *len), ptr, nmemb);
+    (*buf)[*len + nmemb] = 0;
+    *len += nmemb;
+
+    return nmemb;
+}
+
 /*
  * This is a callback used by curl to send the HTTP body
  * to the application (us).  We will store the HTTP body
@@ -142,107 +266,338 @@ end:
  */
 static size_t amvp_curl_write_callback(void *ptr, size_t size, size_t nmemb, void *userdata) {
     AMVP_CTX *ctx = (AMVP_CTX *)userdata;
+    int first = ctx->curl_read_ctr == 0;
+    size_t n = 0;
 
     if (size != 1) {
         fprintf(stderr, "\ncurl size not 1\n");
         return 0;
     }
 
-    if (!ctx->curl_buf) {
-        ctx->curl_buf = calloc(AMVP_CURL_BUF_MAX, sizeof(char));
-        if (!ctx->curl_buf) {
-            fprintf(stderr, "\nmalloc failed in curl write reg func\n");
-            return 0;
-        }
+    n = amvp_curl_buf_append(&ctx->curl_buf, &ctx->curl_read_ctr, &ctx->curl_buf_size,
+                             ctx->curl_hnd, ptr, nmemb);
+    /* Hand test groups on as they arrive, see amvp_vs_stream.c */
+    if (n && ctx->vs_stream && amvp_vs_stream_feed(ctx, first) != AMVP_SUCCESS) {
+        return 0;
     }
+    return n;
+}
 
-    if ((ctx->curl_read_ctr + nmemb) > AMVP_CURL_BUF_MAX) {
-        fprintf(stderr, "\nServer response is too large\n");
-        return 0;
+#ifndef USE_MURL
+/*
+ * Copies the value of header line ptr into buf if the header is called
+ * name (lower case, with the colon). Values longer than max are dropped.
+ */
+static void amvp_http_header_value(const char *ptr, size_t len, const char *name,
+                                   char *buf, size_t max) {
+    size_t name_len = strnlen_s(name, AMVP_HTTP_DATE_MAX), i = 0, n = 0;
+
+    if (len <= name_len) {
+        return;
+    }
+    for (i = 0; i < name_len; i++) {
+        if (tolower((unsigned char)ptr[i]) != name[i]) {
+            return;
+        }
+    }
+    /* Skip the whitespace after the colon and drop the trailing CRLF */
+    while (i < len && (ptr[i] == ' ' || ptr[i] == '\t')) i++;
+    n = len - i;
+    while (n > 0 && (ptr[i + n - 1] == '\r' || ptr[i + n - 1] == '\n' || ptr[i + n - 1] == ' ')) n--;
+    if (n == 0 || n > max) {
+        return;
     }
+    memcpy_s(buf, max + 1, ptr + i, n);
+    buf[n] = '\0';
+}
 
-    memcpy_s(&ctx->curl_buf[ctx->curl_read_ctr], (AMVP_CURL_BUF_MAX - ctx->curl_read_ctr), ptr, nmemb);
-    ctx->curl_buf[ctx->curl_read_ctr + nmemb] = 0;
-    ctx->curl_read_ctr += nmemb;
+/*
+ * This is a callback used by curl to hand us the response headers one
+ * at a time. We keep the ETag and Last-Modified date, so the resource
+ * can be revalidated the next time it is needed. userdata is an
+ * AMVP_HTTP_VALIDATORS.
+ */
+static size_t amvp_curl_header_callback(char *ptr, size_t size, size_t nitems, void *userdata) {
+    AMVP_HTTP_VALIDATORS *validators = (AMVP_HTTP_VALIDATORS *)userdata;
+    size_t len = size * nitems;
 
-    return nmemb;
+    amvp_http_header_value(ptr, len, "etag:", validators->etag, AMVP_HTTP_ETAG_MAX);
+    amvp_http_header_value(ptr, len, "last-modified:", validators->last_modified, AMVP_HTTP_DATE_MAX);
+    return len;
 }
+#endif
 
 /*
- * This function uses libcurl to send a simple HTTP GET
- * request with no Content-Type header.
- * TLS peer verification is enabled, but not HTTP authentication.
- * The parameters are:
- *
- * ctx: Ptr to AMVP_CTX, which contains the server name
- * url: URL to use for the GET request
- *
- * Return value is the HTTP status value from the server
- * (e.g. 200 for HTTP OK)
+ * Applies the options that are common to every request we make
+ * (URL, user agent, TLS settings, headers and the write callback)
+ * to the given handle. With share set the handle is attached to the
+ * context's share object so it can pick up cached connections and TLS
+ * sessions; only the thread making the context's requests may do that,
+ * since a context's own share has no locking.
  */
-static long amvp_curl_http_get(AMVP_CTX *ctx, const char *url) {
-    long http_code = 0;
-    CURL *hnd = NULL;
-    struct curl_slist *slist = NULL;
+static AMVP_RESULT amvp_curl_setup_handle_opts(AMVP_CTX *ctx,
+                                               CURL *hnd,
+                                               const char *url,
+                                               struct curl_slist *slist,
+                                               size_t (*write_cb)(void *, size_t, size_t, void *),
+                                               void *write_data,
+                                               int share) {
     CURLcode crv = CURLE_OK;
 
-    /*
-     * Create the Authorzation header if needed
-     */
-    slist = amvp_add_auth_hdr(ctx, slist);
-
-    ctx->curl_read_ctr = 0;
+#ifndef USE_MURL
+    /* Contexts in a session group are given the group's share when attached */
+    if (share && !ctx->curl_share) {
+        CURLSH *sh = curl_share_init();
+        if (!sh) {
+            AMVP_LOG_ERR("Error initializing Curl share structure, stopping");
+            return AMVP_TRANSPORT_FAIL;
+        }
+        curl_share_setopt(sh, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+        curl_share_setopt(sh, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+        curl_share_setopt(sh, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+        ctx->curl_share = sh;
+    }
+    if (share) {
+        crv = curl_easy_setopt(hnd, CURLOPT_SHARE, ctx->curl_share);
+        if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_SHARE, stopping"); return AMVP_TRANSPORT_FAIL; }
+    }
+#endif
 
-    //Setup Curl
-    hnd = curl_easy_init();
-    if (!hnd) { AMVP_LOG_ERR("Error initializing Curl structure, stopping"); goto end; }
     crv = curl_easy_setopt(hnd, CURLOPT_URL, url);
-    if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_URL, stopping"); goto end; }
+    if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_URL, stopping"); return AMVP_TRANSPORT_FAIL; }
     crv = curl_easy_setopt(hnd, CURLOPT_NOPROGRESS, 1L);
-    if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_NOPROGRESS, stopping"); goto end; }
+    if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_NOPROGRESS, stopping"); return AMVP_TRANSPORT_FAIL; }
     crv = curl_easy_setopt(hnd, CURLOPT_USERAGENT, ctx->http_user_agent);
-    if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_USERAGENT, stopping"); goto end; }
-    crv = curl_easy_setopt(hnd, CURLOPT_TCP_KEEPALIVE, 1L);
-    if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_TCP_KEEPALIVE, stopping"); goto end; }
-    crv = curl_easy_setopt(hnd, CURLOPT_SSLVERSION, CURL_SSLVERSION_TLSv1_2);
-    if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_SSLVERSION, stopping"); goto end; }
+    if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_USERAGENT, stopping"); return AMVP_TRANSPORT_FAIL; }
+#ifndef USE_MURL
+    /* Offer every encoding curl was built with, responses are decoded transparently */
+    crv = curl_easy_setopt(hnd, CURLOPT_ACCEPT_ENCODING, "");
+    if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_ACCEPT_ENCODING, stopping"); return AMVP_TRANSPORT_FAIL; }
+#endif
     if (slist) {
         crv = curl_easy_setopt(hnd, CURLOPT_HTTPHEADER, slist);
-        if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_HTTPHEADER, stopping"); goto end; }
+        if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_HTTPHEADER, stopping"); return AMVP_TRANSPORT_FAIL; }
+    }
+    crv = curl_easy_setopt(hnd, CURLOPT_TCP_KEEPALIVE, 1L);
+    if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_TCP_KEEPALIVE, stopping"); return AMVP_TRANSPORT_FAIL; }
+#if !defined USE_MURL && LIBCURL_VERSION_NUM >= 0x073600
+    if (ctx->http2) {
+        /*
+         * Offer h2 through ALPN, and have a request wait for a connection that is
+         * still being set up rather than open another, so that it can be multiplexed
+         */
+        crv = curl_easy_setopt(hnd, CURLOPT_HTTP_VERSION, (long)CURL_HTTP_VERSION_2TLS);
+        if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_HTTP_VERSION, stopping"); return AMVP_TRANSPORT_FAIL; }
+        crv = curl_easy_setopt(hnd, CURLOPT_PIPEWAIT, 1L);
+        if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_PIPEWAIT, stopping"); return AMVP_TRANSPORT_FAIL; }
+        crv = curl_easy_setopt(hnd, CURLOPT_SSLVERSION, CURL_SSLVERSION_TLSv1_2 | CURL_SSLVERSION_MAX_TLSv1_3);
+        if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_SSLVERSION, stopping"); return AMVP_TRANSPORT_FAIL; }
+        /* Sessions, and TLS 1.3 tickets, are kept in the share object for resumption */
+        crv = curl_easy_setopt(hnd, CURLOPT_SSL_SESSIONID_CACHE, 1L);
+        if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_SSL_SESSIONID_CACHE, stopping"); return AMVP_TRANSPORT_FAIL; }
+    } else
+#endif
+    {
+        crv = curl_easy_setopt(hnd, CURLOPT_SSLVERSION, CURL_SSLVERSION_TLSv1_2);
+        if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_SSLVERSION, stopping"); return AMVP_TRANSPORT_FAIL; }
     }
     //Always verify the server
     crv = curl_easy_setopt(hnd, CURLOPT_SSL_VERIFYPEER, 1L);
-    if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_SSL_VERIFYPEER, stopping"); goto end; }
+    if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_SSL_VERIFYPEER, stopping"); return AMVP_TRANSPORT_FAIL; }
     if (ctx->cacerts_file) {
         crv = curl_easy_setopt(hnd, CURLOPT_CAINFO, ctx->cacerts_file);
-        if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_CAINFO, stopping"); goto end; }
+        if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_CAINFO, stopping"); return AMVP_TRANSPORT_FAIL; }
         crv = curl_easy_setopt(hnd, CURLOPT_CERTINFO, 1L);
-        if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_CERTINFO, stopping"); goto end; }
+        if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_CERTINFO, stopping"); return AMVP_TRANSPORT_FAIL; }
     }
     //Mutual-auth
     if (ctx->tls_cert && ctx->tls_key) {
         crv = curl_easy_setopt(hnd, CURLOPT_SSLCERTTYPE, "PEM");
-        if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_SSLCERTTYPE, stopping"); goto end; }
+        if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_SSLCERTTYPE, stopping"); return AMVP_TRANSPORT_FAIL; }
         crv = curl_easy_setopt(hnd, CURLOPT_SSLCERT, ctx->tls_cert);
-        if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_SSLCERT, stopping"); goto end; }
+        if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_SSLCERT, stopping"); return AMVP_TRANSPORT_FAIL; }
         crv = curl_easy_setopt(hnd, CURLOPT_SSLKEYTYPE, "PEM");
-        if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_SSLKEYTYPE, stopping"); goto end; }
+        if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_SSLKEYTYPE, stopping"); return AMVP_TRANSPORT_FAIL; }
         crv = curl_easy_setopt(hnd, CURLOPT_SSLKEY, ctx->tls_key);
-        if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_SSLKEY, stopping"); goto end; }
+        if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_SSLKEY, stopping"); return AMVP_TRANSPORT_FAIL; }
     }
 
     //To record the HTTP data recieved from the server, set the callback function.
-    crv = curl_easy_setopt(hnd, CURLOPT_WRITEDATA, ctx);
-    if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_WRITEDATA, stopping"); goto end; }
-    crv = curl_easy_setopt(hnd, CURLOPT_WRITEFUNCTION, amvp_curl_write_callback);
-    if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_WRITEFUNCTION, stopping"); goto end; }
+    crv = curl_easy_setopt(hnd, CURLOPT_WRITEDATA, write_data);
+    if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_WRITEDATA, stopping"); return AMVP_TRANSPORT_FAIL; }
+    crv = curl_easy_setopt(hnd, CURLOPT_WRITEFUNCTION, write_cb);
+    if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_WRITEFUNCTION, stopping"); return AMVP_TRANSPORT_FAIL; }
+
+    //crv = curl_easy_setopt(hnd, CURLOPT_VERBOSE, 1L);
+    return AMVP_SUCCESS;
+}
+
+static AMVP_RESULT amvp_curl_setup_handle(AMVP_CTX *ctx,
+                                          CURL *hnd,
+                                          const char *url,
+                                          struct curl_slist *slist,
+                                          size_t (*write_cb)(void *, size_t, size_t, void *),
+                                          void *write_data) {
+    return amvp_curl_setup_handle_opts(ctx, hnd, url, slist, write_cb, write_data, 1);
+}
+
+/*
+ * Returns the curl handle owned by this context, configured with the
+ * options that are common to every request we make (URL, user agent,
+ * TLS settings, headers and the write callback).
+ *
+ * The handle, and the share object holding the connection, DNS and
+ * TLS session caches, are created on first use and kept on the AMVP_CTX
+ * so that consecutive requests reuse a warm connection to the server
+ * instead of paying for a new TCP connect and TLS handshake each time.
+ * Between requests the handle is reset with curl_easy_reset(), which
+ * clears the options but keeps the caches.
+ *
+ * Returns NULL if the handle could not be set up; the error is logged.
+ */
+static CURL *amvp_curl_get_handle(AMVP_CTX *ctx, const char *url, struct curl_slist *slist) {
+    CURL *hnd = NULL;
+
+#ifndef USE_MURL
+    if (ctx->curl_hnd) {
+        hnd = ctx->curl_hnd;
+        curl_easy_reset(hnd);
+    }
+#endif
+    if (!hnd) {
+        hnd = curl_easy_init();
+        if (!hnd) { AMVP_LOG_ERR("Error initializing Curl structure, stopping"); return NULL; }
+        ctx->curl_hnd = hnd;
+    }
+
+    if (amvp_curl_setup_handle(ctx, hnd, url, slist, amvp_curl_write_callback, ctx) != AMVP_SUCCESS) {
+        return NULL;
+    }
 
     if (ctx->curl_buf) {
-        /* Clear the HTTP buffer for next server response */
-        memzero_s(ctx->curl_buf, AMVP_CURL_BUF_MAX);
+        /* Drop the previous response; curl_read_ctr marks the end of valid data */
+        ctx->curl_buf[0] = 0;
     }
 
-    //crv = curl_easy_setopt(hnd, CURLOPT_VERBOSE, 1L);
+    return hnd;
+}
+
+/*
+ * Called once a request has completed. The handle normally stays
+ * with the context for the next request; murl has no connection
+ * reuse, so there it is cleaned up right away.
+ */
+static void amvp_curl_release_handle(AMVP_CTX *ctx) {
+#ifdef USE_MURL
+    if (ctx->curl_hnd) curl_easy_cleanup(ctx->curl_hnd);
+    ctx->curl_hnd = NULL;
+#else
+    (void)ctx;
+#endif
+}
+
+#ifndef USE_MURL
+#if LIBCURL_VERSION_NUM >= 0x073d00
+#define AMVP_CURL_INFO_MS(hnd, info, out) do { curl_off_t us_ = 0; \
+        if (curl_easy_getinfo(hnd, info##_T, &us_) == CURLE_OK) (out) = (double)us_ / 1000.0; } while (0)
+#else
+#define AMVP_CURL_INFO_MS(hnd, info, out) do { double s_ = 0; \
+        if (curl_easy_getinfo(hnd, info, &s_) == CURLE_OK) (out) = s_ * 1000.0; } while (0)
+#endif
+#endif
+
+/*
+ * Hands libcurl's timing breakdown of the request just made on hnd to the
+ * metrics, charged to rec if the request was for a vector set. method is
+ * what was asked for, libcurl's effective method wins where it has one.
+ */
+static void amvp_curl_trace(AMVP_CTX *ctx, AMVP_VS_METRICS_REC *rec, CURL *hnd,
+                            const char *method, const char *url) {
+    AMVP_NET_TIMING t;
+#ifndef USE_MURL
+    curl_off_t n = 0;
+#if LIBCURL_VERSION_NUM >= 0x074800
+    char *eff = NULL;
+#endif
+#endif
+    long http_code = 0;
+
+    if (!ctx->metrics || !hnd) {
+        return;
+    }
+    memzero_s(&t, sizeof(t));
+    strcpy_s(t.method, sizeof(t.method), method);
+    strncpy_s(t.url, sizeof(t.url), url, AMVP_NET_TIMING_URL_MAX);
+    curl_easy_getinfo(hnd, CURLINFO_RESPONSE_CODE, &http_code);
+    t.http_code = http_code;
+#ifndef USE_MURL
+#if LIBCURL_VERSION_NUM >= 0x074800
+    if (curl_easy_getinfo(hnd, CURLINFO_EFFECTIVE_METHOD, &eff) == CURLE_OK && eff &&
+        strnlen_s(eff, sizeof(t.method)) < sizeof(t.method)) {
+        strcpy_s(t.method, sizeof(t.method), eff);
+    }
+#endif
+    AMVP_CURL_INFO_MS(hnd, CURLINFO_NAMELOOKUP_TIME, t.dns_ms);
+    AMVP_CURL_INFO_MS(hnd, CURLINFO_CONNECT_TIME, t.connect_ms);
+    AMVP_CURL_INFO_MS(hnd, CURLINFO_APPCONNECT_TIME, t.tls_ms);
+    AMVP_CURL_INFO_MS(hnd, CURLINFO_PRETRANSFER_TIME, t.pretransfer_ms);
+    AMVP_CURL_INFO_MS(hnd, CURLINFO_STARTTRANSFER_TIME, t.first_byte_ms);
+    AMVP_CURL_INFO_MS(hnd, CURLINFO_TOTAL_TIME, t.total_ms);
+    if (curl_easy_getinfo(hnd, CURLINFO_SIZE_UPLOAD_T, &n) == CURLE_OK) t.bytes_up = (unsigned long long)n;
+    if (curl_easy_getinfo(hnd, CURLINFO_SIZE_DOWNLOAD_T, &n) == CURLE_OK) t.bytes_down = (unsigned long long)n;
+    if (curl_easy_getinfo(hnd, CURLINFO_SPEED_UPLOAD_T, &n) == CURLE_OK) t.upload_speed = (double)n;
+    if (curl_easy_getinfo(hnd, CURLINFO_SPEED_DOWNLOAD_T, &n) == CURLE_OK) t.download_speed = (double)n;
+#endif
+    amvp_metrics_request(ctx, rec, &t);
+}
+
+/*
+ * This function uses libcurl to send a simple HTTP GET
+ * request with no Content-Type header.
+ * TLS peer verification is enabled, but not HTTP authentication.
+ * The parameters are:
+ *
+ * ctx: Ptr to AMVP_CTX, which contains the server name
+ * url: URL to use for the GET request
+ *
+ * Return value is the HTTP status value from the server
+ * (e.g. 200 for HTTP OK)
+ */
+static long amvp_curl_http_get(AMVP_CTX *ctx, const char *url) {
+    long http_code = 0;
+    CURL *hnd = NULL;
+    struct curl_slist *slist = NULL;
+    char hdr[AMVP_HTTP_ETAG_MAX + 16];
+
+    ctx->http_validators.etag[0] = '\0';
+    ctx->http_validators.last_modified[0] = '\0';
+    ctx->http_not_modified = 0;
+
+    /*
+     * Create the Authorzation header if needed
+     */
+    slist = amvp_add_auth_hdr(ctx, slist);
+
+    if (ctx->http_if_none_match) {
+        snprintf(hdr, sizeof(hdr), "If-None-Match: %s", ctx->http_if_none_match);
+        slist = curl_slist_append(slist, hdr);
+    }
+    if (ctx->http_if_modified_since) {
+        snprintf(hdr, sizeof(hdr), "If-Modified-Since: %s", ctx->http_if_modified_since);
+        slist = curl_slist_append(slist, hdr);
+    }
+
+    ctx->curl_read_ctr = 0;
+
+    //Setup Curl
+    hnd = amvp_curl_get_handle(ctx, url, slist);
+    if (!hnd) goto end;
+
+#ifndef USE_MURL
+    curl_easy_setopt(hnd, CURLOPT_HEADERFUNCTION, amvp_curl_header_callback);
+    curl_easy_setopt(hnd, CURLOPT_HEADERDATA, &ctx->http_validators);
+#endif
+
     /*
      * Send the HTTP GET request
      */
@@ -255,10 +610,10 @@ static long amvp_curl_http_get(AMVP_CTX *ctx, const char *url) {
      * Get the HTTP reponse status code from the server
      */
     curl_easy_getinfo(hnd, CURLINFO_RESPONSE_CODE, &http_code);
+    ctx->http_not_modified = (http_code == HTTP_NOT_MODIFIED);
 
 end:
-    if (hnd) curl_easy_cleanup(hnd);
-    hnd = NULL;
+    amvp_curl_release_handle(ctx);
     if (slist) curl_slist_free_all(slist);
     slist = NULL;
 
@@ -285,11 +640,19 @@ static long amvp_curl_http_post(AMVP_CTX *ctx, const char *url, const char *data
     CURL *hnd = NULL;
     CURLcode crv = CURLE_OK;
     struct curl_slist *slist = NULL;
+    char *zdata = NULL;
+    int zdata_len = 0;
 
     /*
      * Set the Content-Type header in the HTTP request
      */
     slist = curl_slist_append(slist, "Content-Type:application/json");
+    zdata = amvp_compress_body(ctx, data, data_len, &zdata_len);
+    if (zdata) {
+        slist = curl_slist_append(slist, "Content-Encoding: gzip");
+        data = zdata;
+        data_len = zdata_len;
+    }
 
     /*
      * Create the Authorzation header if needed
@@ -298,17 +661,9 @@ static long amvp_curl_http_post(AMVP_CTX *ctx, const char *url, const char *data
 
     ctx->curl_read_ctr = 0;
 
-   //Setup Curl
-    hnd = curl_easy_init();
-    if (!hnd) { AMVP_LOG_ERR("Error initializing Curl structure, stopping"); goto end; }
-    crv = curl_easy_setopt(hnd, CURLOPT_URL, url);
-    if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_URL, stopping"); goto end; }
-    crv = curl_easy_setopt(hnd, CURLOPT_NOPROGRESS, 1L);
-    if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_NOPROGRESS, stopping"); goto end; }
-    crv = curl_easy_setopt(hnd, CURLOPT_USERAGENT, ctx->http_user_agent);
-    if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_USERAGENT, stopping"); goto end; }
-    crv = curl_easy_setopt(hnd, CURLOPT_HTTPHEADER, slist);
-    if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_HTTPHEADER, stopping"); goto end; }
+    //Setup Curl
+    hnd = amvp_curl_get_handle(ctx, url, slist);
+    if (!hnd) goto end;
     crv = curl_easy_setopt(hnd, CURLOPT_CUSTOMREQUEST, "POST");
     if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_CUSTOMREQUEST, stopping"); goto end; }
     crv = curl_easy_setopt(hnd, CURLOPT_POST, 1L);
@@ -317,42 +672,7 @@ static long amvp_curl_http_post(AMVP_CTX *ctx, const char *url, const char *data
     if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_POSTFIELDS, stopping"); goto end; }
     crv = curl_easy_setopt(hnd, CURLOPT_POSTFIELDSIZE_LARGE, (curl_off_t)data_len);
     if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_POSTFIELDSIZE_LARGE, stopping"); goto end; }
-    crv = curl_easy_setopt(hnd, CURLOPT_TCP_KEEPALIVE, 1L);
-    if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_TCP_KEEPALIVE, stopping"); goto end; }
-    crv = curl_easy_setopt(hnd, CURLOPT_SSLVERSION, CURL_SSLVERSION_TLSv1_2);
-    if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_SSL_VERSION, stopping"); goto end; }
-    //Always verify the server
-    crv = curl_easy_setopt(hnd, CURLOPT_SSL_VERIFYPEER, 1L);
-    if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_SSL_VERIFYPEER, stopping"); goto end; }
-    if (ctx->cacerts_file) {
-        crv = curl_easy_setopt(hnd, CURLOPT_CAINFO, ctx->cacerts_file);
-        if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_CAINFO, stopping"); goto end; }
-        crv = curl_easy_setopt(hnd, CURLOPT_CERTINFO, 1L);
-        if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_CERTINFO, stopping"); goto end; }
-    }
-    //Mutual-auth
-    if (ctx->tls_cert && ctx->tls_key) {
-        crv = curl_easy_setopt(hnd, CURLOPT_SSLCERTTYPE, "PEM");
-        if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_SSLCERTTYPE, stopping"); goto end; }
-        crv = curl_easy_setopt(hnd, CURLOPT_SSLCERT, ctx->tls_cert);
-        if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_SSLCERT, stopping"); goto end; }
-        crv = curl_easy_setopt(hnd, CURLOPT_SSLKEYTYPE, "PEM");
-        if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_SSLKEYTYPE stopping"); goto end; }
-        crv = curl_easy_setopt(hnd, CURLOPT_SSLKEY, ctx->tls_key);
-        if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_SSLKEY, stopping"); goto end; }
-    }
-    // To record the HTTP data recieved from the server, set the callback function.
-    crv = curl_easy_setopt(hnd, CURLOPT_WRITEDATA, ctx);
-    if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_WRITEDATA, stopping"); goto end; }
-    crv = curl_easy_setopt(hnd, CURLOPT_WRITEFUNCTION, amvp_curl_write_callback);
-    if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_WRITEFUNCTION, stopping"); goto end; }
 
-    if (ctx->curl_buf) {
-        /* Clear the HTTP buffer for next server response */
-        memzero_s(ctx->curl_buf, AMVP_CURL_BUF_MAX);
-    }
-    //crv = curl_easy_setopt(hnd, CURLOPT_VERBOSE, 1L);
-    
     /*
      * Send the HTTP POST request
      */
@@ -370,10 +690,10 @@ static long amvp_curl_http_post(AMVP_CTX *ctx, const char *url, const char *data
     curl_easy_getinfo(hnd, CURLINFO_RESPONSE_CODE, &http_code);
 
 end:
-    if (hnd) curl_easy_cleanup(hnd);
-    hnd = NULL;
+    amvp_curl_release_handle(ctx);
     if (slist) curl_slist_free_all(slist);
     slist = NULL;
+    if (zdata) free(zdata);
 
     return http_code;
 }
@@ -396,13 +716,24 @@ static long amvp_curl_http_put(AMVP_CTX *ctx, const char *url, const char *data,
     CURL *hnd = NULL;
     CURLcode crv = CURLE_OK;
     struct curl_slist *slist = NULL;
+    char *zdata = NULL;
+    int zdata_len = 0;
 
+    if (ctx->log_lvl == AMVP_LOG_LVL_VERBOSE) {
+        printf("\nHTTP PUT:\n\n%s\n", data);
+    }
 
     ctx->curl_read_ctr = 0;
     /*
      * Set the Content-Type header in the HTTP request
      */
     slist = curl_slist_append(slist, "Content-Type:application/json");
+    zdata = amvp_compress_body(ctx, data, data_len, &zdata_len);
+    if (zdata) {
+        slist = curl_slist_append(slist, "Content-Encoding: gzip");
+        data = zdata;
+        data_len = zdata_len;
+    }
 
     /*
      * Create the Authorzation header if needed
@@ -410,62 +741,15 @@ static long amvp_curl_http_put(AMVP_CTX *ctx, const char *url, const char *data,
     slist = amvp_add_auth_hdr(ctx, slist);
 
     //Setup Curl
-    hnd = curl_easy_init();
-    if (!hnd) { AMVP_LOG_ERR("Error initializing Curl structure, stopping"); goto end; }
-    crv = curl_easy_setopt(hnd, CURLOPT_URL, url);
-    if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_URL, stopping"); goto end; }
-    crv = curl_easy_setopt(hnd, CURLOPT_NOPROGRESS, 1L);
-    if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_NOPROGRESS, stopping"); goto end; }
-    crv = curl_easy_setopt(hnd, CURLOPT_USERAGENT, ctx->http_user_agent);
-    if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_USERAGENT, stopping"); goto end; }
-    crv = curl_easy_setopt(hnd, CURLOPT_HTTPHEADER, slist);
-    if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_HTTPHEADER, stopping"); goto end; }
+    hnd = amvp_curl_get_handle(ctx, url, slist);
+    if (!hnd) goto end;
     crv = curl_easy_setopt(hnd, CURLOPT_CUSTOMREQUEST, "PUT");
     if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_CUSTOMREQUEST, stopping"); goto end; }
     crv = curl_easy_setopt(hnd, CURLOPT_POSTFIELDS, data);
     if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_POSTFIELDS, stopping"); goto end; }
     crv = curl_easy_setopt(hnd, CURLOPT_POSTFIELDSIZE_LARGE, (curl_off_t)data_len);
     if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_POSTFIELDSIZE_LARGE, stopping"); goto end; }
-    crv = curl_easy_setopt(hnd, CURLOPT_TCP_KEEPALIVE, 1L);
-    if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_TCP_KEEPALIVE, stopping"); goto end; }
-    crv = curl_easy_setopt(hnd, CURLOPT_SSLVERSION, CURL_SSLVERSION_TLSv1_2);
-    if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_SSLVERSION, stopping"); goto end; }
-    //Always verify the server
-    crv = curl_easy_setopt(hnd, CURLOPT_SSL_VERIFYPEER, 1L);
-    if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_SSL_VERIFYPEER, stopping"); goto end; }
-    if (ctx->cacerts_file) {
-        crv = curl_easy_setopt(hnd, CURLOPT_CAINFO, ctx->cacerts_file);
-        if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_CAINFO, stopping"); goto end; }
-        crv = curl_easy_setopt(hnd, CURLOPT_CERTINFO, 1L);
-        if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_CERTINFO, stopping"); goto end; }
-    }
-    //Mutual-auth
-    if (ctx->tls_cert && ctx->tls_key) {
-        crv = curl_easy_setopt(hnd, CURLOPT_SSLCERTTYPE, "PEM");
-        if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_SSLCERTTYPE, stopping"); goto end; }
-        crv = curl_easy_setopt(hnd, CURLOPT_SSLCERT, ctx->tls_cert);
-        if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_SSLCERT, stopping"); goto end; }
-        crv = curl_easy_setopt(hnd, CURLOPT_SSLKEYTYPE, "PEM");
-        if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_SSLKEYTYPE, stopping"); goto end; }
-        crv = curl_easy_setopt(hnd, CURLOPT_SSLKEY, ctx->tls_key);
-        if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_SSLKEY, stopping"); goto end; }
-    }
-    //To record the HTTP data recieved from the server, set the callback function.
-    crv = curl_easy_setopt(hnd, CURLOPT_WRITEDATA, ctx);
-    if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_WRITEDATA, stopping"); goto end; }
-    crv = curl_easy_setopt(hnd, CURLOPT_WRITEFUNCTION, amvp_curl_write_callback);
-    if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_WRITEFUNCTION, stopping"); goto end; }
-
-    if (ctx->curl_buf) {
-        /* Clear the HTTP buffer for next server response */
-        memzero_s(ctx->curl_buf, AMVP_CURL_BUF_MAX);
-    }
 
-    if (ctx->log_lvl == AMVP_LOG_LVL_VERBOSE) {
-        printf("\nHTTP PUT:\n\n%s\n", data);
-    }
-    //crv = curl_easy_setopt(hnd, CURLOPT_VERBOSE, 1L);
-    
     /*
      * Send the HTTP PUT request
      */
@@ -484,99 +768,582 @@ static long amvp_curl_http_put(AMVP_CTX *ctx, const char *url, const char *data,
     curl_easy_getinfo(hnd, CURLINFO_RESPONSE_CODE, &http_code);
 
 end:
-    if (hnd) curl_easy_cleanup(hnd);
-    hnd = NULL;
+    amvp_curl_release_handle(ctx);
     if (slist) curl_slist_free_all(slist);
     slist = NULL;
+    if (zdata) free(zdata);
 
     return http_code;
 }
 
-/**
- * @brief Uses libcurl to send a simple HTTP PUT.
- *
- * TLS peer verification is enabled, but not mutual authentication.
- *
- * @param ctx Ptr to AMVP_CTX, which contains the server name
- * @param url URL to use for the PUT operation
- * @param data: data to PUT to the server
- * @param data_len: Length of \p data (in bytes)
- *
- * @return HTTP status value from the server
- * (e.g. 200 for HTTP OK)
+#ifndef USE_MURL
+/*
+ * Where the body of a streamed upload comes from. read() fills up to len
+ * bytes of buf and returns how many it wrote, 0 once the body is complete,
+ * or (size_t)-1 on error. rewind() starts the body over, for when curl has
+ * to send it again. len is the length of the body, or -1 when it isn't
+ * known up front and the body goes out chunked.
  */
-static long amvp_curl_http_delete(AMVP_CTX *ctx, const char *url) {
-    long http_code = 0;
-    CURL *hnd = NULL;
-    CURLcode crv = CURLE_OK;
-    struct curl_slist *slist = NULL;
+typedef struct amvp_body_source_t {
+    size_t (*read)(void *arg, char *buf, size_t len);
+    void (*rewind)(void *arg);
+    void *arg;
+    curl_off_t len;
+} AMVP_BODY_SOURCE;
 
+/*
+ * A vector set response still in the mapped response file, wrapped in
+ * [ ] the way the server expects it.
+ */
+typedef struct amvp_slice_body_t {
+    const char *part[3];
+    size_t part_len[3];
+    int idx;
+    size_t off;
+} AMVP_SLICE_BODY;
+
+static size_t amvp_slice_body_read(void *arg, char *buf, size_t len) {
+    AMVP_SLICE_BODY *body = (AMVP_SLICE_BODY *)arg;
+    size_t n = 0, copied = 0;
+
+    while (copied < len && body->idx < 3) {
+        n = body->part_len[body->idx] - body->off;
+        if (n > len - copied) n = len - copied;
+        memcpy_s(buf + copied, len - copied, body->part[body->idx] + body->off, n);
+        copied += n;
+        body->off += n;
+        if (body->off == body->part_len[body->idx]) {
+            body->idx++;
+            body->off = 0;
+        }
+    }
+    return copied;
+}
 
-    ctx->curl_read_ctr = 0;
-    /*
-     * Set the Content-Type header in the HTTP request
-     */
-    slist = curl_slist_append(slist, "Content-Type:application/json");
+static void amvp_slice_body_rewind(void *arg) {
+    AMVP_SLICE_BODY *body = (AMVP_SLICE_BODY *)arg;
 
-    /*
-     * Create the Authorzation header if needed
-     */
+    body->idx = 0;
+    body->off = 0;
+}
+
+/*
+ * A vector set response streamed into ctx->kat_writer, the start of which
+ * was spilled to its temp file, see amvp_set_response_memory_budget().
+ */
+typedef struct amvp_spill_body_t {
+    AMVP_JSON_WRITER *w;
+    size_t off;
+} AMVP_SPILL_BODY;
+
+static size_t amvp_spill_body_read(void *arg, char *buf, size_t len) {
+    AMVP_SPILL_BODY *body = (AMVP_SPILL_BODY *)arg;
+    size_t n = amvp_jw_read_at(body->w, body->off, buf, len);
+
+    if (n != (size_t)-1) body->off += n;
+    return n;
+}
+
+static void amvp_spill_body_rewind(void *arg) {
+    ((AMVP_SPILL_BODY *)arg)->off = 0;
+}
+
+static size_t amvp_tree_body_read(void *arg, char *buf, size_t len) {
+    return amvp_jp_read((AMVP_JSON_PRODUCER *)arg, buf, len);
+}
+
+static void amvp_tree_body_rewind(void *arg) {
+    AMVP_JSON_PRODUCER *p = (AMVP_JSON_PRODUCER *)arg;
+
+    amvp_jp_init(p, p->root);
+}
+
+/* Random access versions of the readers above, for chunked uploads */
+static size_t amvp_slice_body_read_at(void *arg, size_t off, char *buf, size_t len) {
+    AMVP_SLICE_BODY *body = (AMVP_SLICE_BODY *)arg;
+
+    body->idx = 0;
+    while (body->idx < 3 && off >= body->part_len[body->idx]) {
+        off -= body->part_len[body->idx];
+        body->idx++;
+    }
+    body->off = off;
+    return amvp_slice_body_read(arg, buf, len);
+}
+
+static size_t amvp_spill_body_read_at(void *arg, size_t off, char *buf, size_t len) {
+    return amvp_jw_read_at(((AMVP_SPILL_BODY *)arg)->w, off, buf, len);
+}
+
+typedef struct amvp_buf_body_t {
+    const char *data;
+    size_t len;
+} AMVP_BUF_BODY;
+
+static size_t amvp_buf_body_read_at(void *arg, size_t off, char *buf, size_t len) {
+    AMVP_BUF_BODY *body = (AMVP_BUF_BODY *)arg;
+
+    if (off >= body->len) {
+        return 0;
+    }
+    if (len > body->len - off) len = body->len - off;
+    memcpy_s(buf, len, body->data + off, len);
+    return len;
+}
+
+/* One chunk, [start, start + len), of a body read with read_at() */
+typedef struct amvp_chunk_body_t {
+    size_t (*read_at)(void *arg, size_t off, char *buf, size_t len);
+    void *arg;
+    size_t start;
+    size_t len;
+    size_t off;
+} AMVP_CHUNK_BODY;
+
+static size_t amvp_chunk_body_read(void *arg, char *buf, size_t len) {
+    AMVP_CHUNK_BODY *chunk = (AMVP_CHUNK_BODY *)arg;
+    size_t n = chunk->len - chunk->off;
+
+    if (n > len) n = len;
+    if (!n) {
+        return 0;
+    }
+    n = chunk->read_at(chunk->arg, chunk->start + chunk->off, buf, n);
+    if (n != (size_t)-1) chunk->off += n;
+    return n;
+}
+
+static void amvp_chunk_body_rewind(void *arg) {
+    ((AMVP_CHUNK_BODY *)arg)->off = 0;
+}
+
+/* Keeps the value of the Range header of a response, userdata is a buffer of AMVP_HTTP_RANGE_MAX + 1 */
+static size_t amvp_curl_range_callback(char *ptr, size_t size, size_t nitems, void *userdata) {
+    size_t len = size * nitems;
+
+    amvp_http_header_value(ptr, len, "range:", (char *)userdata, AMVP_HTTP_RANGE_MAX);
+    return len;
+}
+
+static size_t amvp_curl_source_read_callback(char *buffer, size_t size, size_t nitems, void *userdata) {
+    AMVP_BODY_SOURCE *src = (AMVP_BODY_SOURCE *)userdata;
+    size_t n = src->read(src->arg, buffer, size * nitems);
+
+    return n == (size_t)-1 ? CURL_READFUNC_ABORT : n;
+}
+
+/* curl rewinds the body when it has to send it again, e.g. after a redirect */
+static int amvp_curl_source_seek_callback(void *userdata, curl_off_t offset, int origin) {
+    AMVP_BODY_SOURCE *src = (AMVP_BODY_SOURCE *)userdata;
+
+    if (origin != SEEK_SET || offset != 0) {
+        return CURL_SEEKFUNC_CANTSEEK;
+    }
+    src->rewind(src->arg);
+    return CURL_SEEKFUNC_OK;
+}
+
+/*
+ * Sends a request with \p method ("POST" or "PUT") whose body is pulled from
+ * \p src as curl needs it, rather than handed over as one buffer. The body
+ * is not compressed, that would need all of it in memory.
+ *
+ * Returns the HTTP status value from the server
+ */
+static long amvp_curl_http_send_stream(AMVP_CTX *ctx, const char *url, const char *method,
+                                       AMVP_BODY_SOURCE *src, const char *content_range,
+                                       char *range) {
+    long http_code = 0;
+    CURL *hnd = NULL;
+    CURLcode crv = CURLE_OK;
+    struct curl_slist *slist = NULL;
+
+    src->rewind(src->arg);
+    ctx->curl_read_ctr = 0;
+    slist = curl_slist_append(slist, "Content-Type:application/json");
+    if (src->len < 0) {
+        /* curl leaves this out itself over HTTP/2 */
+        slist = curl_slist_append(slist, "Transfer-Encoding: chunked");
+    }
+    if (content_range) {
+        slist = curl_slist_append(slist, content_range);
+    }
     slist = amvp_add_auth_hdr(ctx, slist);
 
     //Setup Curl
-    hnd = curl_easy_init();
-    if (!hnd) { AMVP_LOG_ERR("Error initializing Curl structure, stopping"); goto end; }
-    crv = curl_easy_setopt(hnd, CURLOPT_URL, url);
-    if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_URL, stopping"); goto end; }
-    crv = curl_easy_setopt(hnd, CURLOPT_NOPROGRESS, 1L);
-    if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_NOPROGRESS, stopping"); goto end; }
-    crv = curl_easy_setopt(hnd, CURLOPT_USERAGENT, ctx->http_user_agent);
-    if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_USERAGENT, stopping"); goto end; }
-    crv = curl_easy_setopt(hnd, CURLOPT_HTTPHEADER, slist);
-    if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_HTTPHEADER, stopping"); goto end; }
-    crv = curl_easy_setopt(hnd, CURLOPT_CUSTOMREQUEST, "DELETE");
+    hnd = amvp_curl_get_handle(ctx, url, slist);
+    if (!hnd) goto end;
+    crv = curl_easy_setopt(hnd, CURLOPT_CUSTOMREQUEST, method);
     if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_CUSTOMREQUEST, stopping"); goto end; }
-    crv = curl_easy_setopt(hnd, CURLOPT_TCP_KEEPALIVE, 1L);
-    if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_TCP_KEEPALIVE, stopping"); goto end; }
-    crv = curl_easy_setopt(hnd, CURLOPT_SSLVERSION, CURL_SSLVERSION_TLSv1_2);
-    if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_SSLVERSION, stopping"); goto end; }
-    //Always verify the server
-    crv = curl_easy_setopt(hnd, CURLOPT_SSL_VERIFYPEER, 1L);
-    if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_SSL_VERIFYPEER, stopping"); goto end; }
-    if (ctx->cacerts_file) {
-        crv = curl_easy_setopt(hnd, CURLOPT_CAINFO, ctx->cacerts_file);
-        if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_CAINFO, stopping"); goto end; }
-        crv = curl_easy_setopt(hnd, CURLOPT_CERTINFO, 1L);
-        if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_CERTINFO, stopping"); goto end; }
+    crv = curl_easy_setopt(hnd, CURLOPT_POST, 1L);
+    if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_POST, stopping"); goto end; }
+    crv = curl_easy_setopt(hnd, CURLOPT_READFUNCTION, amvp_curl_source_read_callback);
+    if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_READFUNCTION, stopping"); goto end; }
+    crv = curl_easy_setopt(hnd, CURLOPT_READDATA, src);
+    if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_READDATA, stopping"); goto end; }
+    crv = curl_easy_setopt(hnd, CURLOPT_SEEKFUNCTION, amvp_curl_source_seek_callback);
+    if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_SEEKFUNCTION, stopping"); goto end; }
+    crv = curl_easy_setopt(hnd, CURLOPT_SEEKDATA, src);
+    if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_SEEKDATA, stopping"); goto end; }
+    crv = curl_easy_setopt(hnd, CURLOPT_POSTFIELDSIZE_LARGE, src->len);
+    if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_POSTFIELDSIZE_LARGE, stopping"); goto end; }
+    if (range) {
+        range[0] = '\0';
+        crv = curl_easy_setopt(hnd, CURLOPT_HEADERFUNCTION, amvp_curl_range_callback);
+        if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_HEADERFUNCTION, stopping"); goto end; }
+        crv = curl_easy_setopt(hnd, CURLOPT_HEADERDATA, range);
+        if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_HEADERDATA, stopping"); goto end; }
     }
-    //Mutual-auth
-    if (ctx->tls_cert && ctx->tls_key) {
-        crv = curl_easy_setopt(hnd, CURLOPT_SSLCERTTYPE, "PEM");
-        if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_SSLCERTTYPE, stopping"); goto end; }
-        crv = curl_easy_setopt(hnd, CURLOPT_SSLCERT, ctx->tls_cert);
-        if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_SSLCERT, stopping"); goto end; }
-        crv = curl_easy_setopt(hnd, CURLOPT_SSLKEYTYPE, "PEM");
-        if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_SSLKEYTYPE, stopping"); goto end; }
-        crv = curl_easy_setopt(hnd, CURLOPT_SSLKEY, ctx->tls_key);
-        if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_SSLKEY, stopping"); goto end; }
+
+    crv = curl_easy_perform(hnd);
+    if (crv != CURLE_OK) {
+        AMVP_LOG_ERR("Curl failed with code %d (%s)", crv, curl_easy_strerror(crv));
+    }
+    if (ctx->log_lvl == AMVP_LOG_LVL_VERBOSE) {
+        printf("\nHTTP %s RSP:\n\n%s\n", method, ctx->curl_buf);
     }
-    //To record the HTTP data recieved from the server, set the callback function.
-    crv = curl_easy_setopt(hnd, CURLOPT_WRITEDATA, ctx);
-    if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_WRITEDATA, stopping"); goto end; }
-    crv = curl_easy_setopt(hnd, CURLOPT_WRITEFUNCTION, amvp_curl_write_callback);
-    if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_WRITEFUNCTION, stopping"); goto end; }
 
-    if (ctx->curl_buf) {
-        /* Clear the HTTP buffer for next server response */
-        memzero_s(ctx->curl_buf, AMVP_CURL_BUF_MAX);
+    curl_easy_getinfo(hnd, CURLINFO_RESPONSE_CODE, &http_code);
+
+end:
+    amvp_curl_release_handle(ctx);
+    if (slist) curl_slist_free_all(slist);
+    return http_code;
+}
+
+/*
+ * How much of a chunked upload the server holds, from the Range header of
+ * its 308 ("bytes=0-<last>"). No header means it holds none of it.
+ */
+static size_t amvp_chunk_acked(const char *range, size_t total) {
+    const char *dash = NULL;
+    unsigned long long last = 0;
+
+    if (strncmp(range, "bytes=0-", 8)) {
+        return 0;
+    }
+    dash = range + 7;
+    if (sscanf(dash + 1, "%llu", &last) != 1 || last >= total) {
+        return 0;
+    }
+    return (size_t)last + 1;
+}
+
+/*
+ * The Content-Range header of the chunk [start, start + len) of a chunked
+ * upload. An empty chunk asks the server how much of the upload it holds.
+ */
+static void amvp_chunk_content_range(char *buf, size_t size, size_t start, size_t len, size_t total) {
+    if (len) {
+        snprintf(buf, size, "Content-Range: bytes %llu-%llu/%llu",
+                 (unsigned long long)start, (unsigned long long)(start + len - 1),
+                 (unsigned long long)total);
+    } else {
+        snprintf(buf, size, "Content-Range: bytes */%llu", (unsigned long long)total);
+    }
+}
+
+/*
+ * Sends the \p total bytes of a body read with \p read_at in chunks of
+ * ctx->upload_chunk bytes, see amvp_set_chunked_upload(). Each chunk is its
+ * own request to \p url carrying "Content-Range: bytes <first>-<last>/<total>".
+ * The server answers 308 with "Range: bytes=0-<last>" while the upload is
+ * incomplete, and answers the request completing it as it would the whole
+ * body. When a chunk doesn't make it, or the server holds all of the body
+ * without having answered for it, an empty request with "*" in place of
+ * the byte range asks the server how far it got, and the upload resumes
+ * from there rather than from the start. A 308 that doesn't move the upload
+ * forward counts as a failed chunk.
+ *
+ * Every request but the one whose status is returned is traced here, the
+ * caller traces that one as it would an upload sent whole. *sent is
+ * increased by the body bytes sent, chunks sent again included.
+ *
+ * Returns the HTTP status value from the server
+ */
+static long amvp_curl_http_send_chunked(AMVP_CTX *ctx, const char *url, const char *method,
+                                        size_t (*read_at)(void *arg, size_t off, char *buf, size_t len),
+                                        void *arg, size_t total, size_t *sent) {
+    AMVP_BODY_SOURCE src;
+    AMVP_CHUNK_BODY chunk;
+    char content_range[AMVP_HTTP_RANGE_MAX + 1];
+    char range[AMVP_HTTP_RANGE_MAX + 1];
+    size_t acked = 0, held = 0;
+    int failures = 0, query = 0;
+    long rc = 0;
+
+    memzero_s(&chunk, sizeof(chunk));
+    chunk.read_at = read_at;
+    chunk.arg = arg;
+    memzero_s(&src, sizeof(src));
+    src.read = amvp_chunk_body_read;
+    src.rewind = amvp_chunk_body_rewind;
+    src.arg = &chunk;
+
+    while (1) {
+        chunk.start = acked;
+        if (query || acked == total) {
+            chunk.len = 0;
+        } else {
+            chunk.len = total - acked < ctx->upload_chunk ? total - acked : ctx->upload_chunk;
+        }
+        src.len = (curl_off_t)chunk.len;
+        amvp_chunk_content_range(content_range, sizeof(content_range), chunk.start, chunk.len, total);
+        rc = amvp_curl_http_send_stream(ctx, url, method, &src, content_range, range);
+        *sent += chunk.len;
+        if (rc == HTTP_RESUME_INCOMPLETE) {
+            held = amvp_chunk_acked(range, total);
+            AMVP_LOG_VERBOSE("Server holds %llu of %llu bytes of the upload",
+                             (unsigned long long)held, (unsigned long long)total);
+            if (held > acked || query) {
+                if (held > acked) failures = 0;
+                acked = held;
+                query = 0;
+                amvp_curl_trace(ctx, amvp_metrics_get_net(ctx), ctx->curl_hnd, method, url);
+                continue;
+            }
+            /* Sent again from where the server is, after a back off */
+            acked = held;
+        } else if (rc != 0 && rc != 408 && rc < 500) {
+            /* Done, or refused; either way the caller handles it */
+            return rc;
+        }
+
+        if (++failures > AMVP_CHUNK_RETRIES) {
+            AMVP_LOG_ERR("Chunked upload failed at byte %llu of %llu",
+                         (unsigned long long)acked, (unsigned long long)total);
+            return rc;
+        }
+        amvp_curl_trace(ctx, amvp_metrics_get_net(ctx), ctx->curl_hnd, method, url);
+        AMVP_LOG_WARN("Chunk at byte %llu of the upload failed (%ld), resuming",
+                      (unsigned long long)chunk.start, rc);
+#ifdef _WIN32
+        Sleep(failures * 1000);
+#else
+        sleep(failures);
+#endif
+        query = rc != HTTP_RESUME_INCOMPLETE;
+    }
+}
+#endif
+
+/*
+ * Whether the vector set response in ctx->kat_resp can be serialized as it
+ * is sent. Compressing it, checking it against the server's size
+ * constraint, or sending it in chunks, needs all of it up front.
+ */
+static int amvp_vs_rsp_streams_tree(AMVP_CTX *ctx) {
+#ifndef USE_MURL
+    if (!ctx->kat_resp || ctx->upload_compress || ctx->upload_chunk) {
+        return 0;
+    }
+#ifdef AMVP_DEPRECATED
+    if (ctx->post_size_constraint) {
+        return 0;
+    }
+#endif
+    return 1;
+#else
+    (void)ctx;
+    return 0;
+#endif
+}
+
+/*
+ * Whether the vector set response in ctx->kat_writer was partly spilled to
+ * disk and can be sent from there. The same limits as for a tree apply,
+ * except that a chunked upload can read its chunks from the spill file.
+ */
+static int amvp_vs_rsp_streams_spill(AMVP_CTX *ctx) {
+#ifndef USE_MURL
+    if (ctx->kat_resp || !ctx->kat_writer.spilled || ctx->upload_compress) {
+        return 0;
+    }
+#ifdef AMVP_DEPRECATED
+    if (ctx->post_size_constraint) {
+        return 0;
+    }
+#endif
+    return 1;
+#else
+    (void)ctx;
+    return 0;
+#endif
+}
+
+/*
+ * POSTs the current vector set response to \p url, or PUTs it if the server
+ * already has responses for the set (400). The response is sent from where
+ * it is: a slice of a saved response file (ctx->rsp_slice), or
+ * ctx->kat_resp, serialized as it goes out, or ctx->kat_writer's spill
+ * file and buffer, or the serialized \p resp. A body larger than the chunk
+ * size of amvp_set_chunked_upload() goes out in chunks.
+ * *sent_len is set to the body bytes sent, chunks sent again included.
+ *
+ * Returns the HTTP status value from the server
+ */
+static long amvp_curl_http_send_vs_rsp(AMVP_CTX *ctx, const char *url, const char *resp,
+                                       int resp_len, int *sent_len) {
+    long rc = 0;
+#ifndef USE_MURL
+    AMVP_BODY_SOURCE src;
+    AMVP_SLICE_BODY slice;
+    AMVP_JSON_PRODUCER prod;
+    AMVP_SPILL_BODY spill;
+
+    memzero_s(&src, sizeof(src));
+    if (ctx->rsp_slice) {
+        memzero_s(&slice, sizeof(slice));
+        slice.part[0] = "[";
+        slice.part_len[0] = 1;
+        slice.part[1] = ctx->rsp_slice;
+        slice.part_len[1] = ctx->rsp_slice_len;
+        slice.part[2] = "]";
+        slice.part_len[2] = 1;
+        src.read = amvp_slice_body_read;
+        src.rewind = amvp_slice_body_rewind;
+        src.arg = &slice;
+        src.len = (curl_off_t)ctx->rsp_slice_len + 2;
+    } else if (!resp && amvp_vs_rsp_streams_tree(ctx)) {
+        memzero_s(&prod, sizeof(prod));
+        amvp_jp_init(&prod, ctx->kat_resp);
+        src.read = amvp_tree_body_read;
+        src.rewind = amvp_tree_body_rewind;
+        src.arg = &prod;
+        src.len = -1;
+    } else if (!resp && amvp_vs_rsp_streams_spill(ctx)) {
+        spill.w = &ctx->kat_writer;
+        spill.off = 0;
+        src.read = amvp_spill_body_read;
+        src.rewind = amvp_spill_body_rewind;
+        src.arg = &spill;
+        src.len = (curl_off_t)(ctx->kat_writer.spilled + ctx->kat_writer.len);
+    }
+    if (ctx->upload_chunk && !ctx->upload_compress && src.read != amvp_tree_body_read) {
+        size_t (*read_at)(void *arg, size_t off, char *buf, size_t len) = NULL;
+        AMVP_BUF_BODY buf;
+        size_t total = 0;
+
+        if (src.read == amvp_slice_body_read) {
+            read_at = amvp_slice_body_read_at;
+            total = (size_t)src.len;
+        } else if (src.read == amvp_spill_body_read) {
+            read_at = amvp_spill_body_read_at;
+            total = (size_t)src.len;
+        } else if (resp && resp_len > 0) {
+            buf.data = resp;
+            buf.len = (size_t)resp_len;
+            read_at = amvp_buf_body_read_at;
+            src.arg = &buf;
+            total = buf.len;
+        }
+        if (read_at && total > ctx->upload_chunk) {
+            size_t sent = 0;
+
+            rc = amvp_curl_http_send_chunked(ctx, url, "POST", read_at, src.arg, total, &sent);
+            //Check for code 400, which means we are reuploading a resp and must use PUT instead
+            if (inspect_http_code(ctx, rc) == AMVP_UNSUPPORTED_OP) {
+                amvp_curl_trace(ctx, amvp_metrics_get_net(ctx), ctx->curl_hnd, "POST", url);
+                rc = amvp_curl_http_send_chunked(ctx, url, "PUT", read_at, src.arg, total, &sent);
+            }
+            *sent_len = sent > INT_MAX ? INT_MAX : (int)sent;
+            return rc;
+        }
+    }
+    if (src.read) {
+        rc = amvp_curl_http_send_stream(ctx, url, "POST", &src, NULL, NULL);
+        //Check for code 400, which means we are reuploading a resp and must use PUT instead
+        if (inspect_http_code(ctx, rc) == AMVP_UNSUPPORTED_OP) {
+            rc = amvp_curl_http_send_stream(ctx, url, "PUT", &src, NULL, NULL);
+        }
+        if (src.arg == &prod) {
+            *sent_len = (int)prod.total;
+            amvp_jp_free(&prod);
+        } else {
+            *sent_len = (int)src.len;
+        }
+        return rc;
+    }
+#else
+    /* murl can't read the body from a callback, send a copy of the slice */
+    char *copy = NULL;
+
+    if (ctx->rsp_slice) {
+        if (ctx->rsp_slice_len + 2 > INT_MAX) {
+            AMVP_LOG_ERR("Vector set response is too large");
+            return 0;
+        }
+        copy = malloc(ctx->rsp_slice_len + 3);
+        if (!copy) {
+            AMVP_LOG_ERR("Failed to malloc");
+            return 0;
+        }
+        copy[0] = '[';
+        memcpy_s(copy + 1, ctx->rsp_slice_len + 2, ctx->rsp_slice, ctx->rsp_slice_len);
+        copy[ctx->rsp_slice_len + 1] = ']';
+        copy[ctx->rsp_slice_len + 2] = '\0';
+        resp = copy;
+        resp_len = (int)ctx->rsp_slice_len + 2;
     }
+#endif
+
+    *sent_len = resp_len;
+    if (!resp) {
+        AMVP_LOG_ERR("Failed to post vector set responses");
+        return 0;
+    }
+    rc = amvp_curl_http_post(ctx, url, resp, resp_len);
+    //Check for code 400, which means we are reuploading a resp and must use PUT instead
+    if (inspect_http_code(ctx, rc) == AMVP_UNSUPPORTED_OP) {
+        rc = amvp_curl_http_put(ctx, url, resp, resp_len);
+    }
+#ifdef USE_MURL
+    if (copy) free(copy);
+#endif
+    return rc;
+}
+
+/**
+ * @brief Uses libcurl to send a simple HTTP DELETE.
+ *
+ * TLS peer verification is enabled, but not mutual authentication.
+ *
+ * @param ctx Ptr to AMVP_CTX, which contains the server name
+ * @param url URL to use for the DELETE operation
+ *
+ * @return HTTP status value from the server
+ * (e.g. 200 for HTTP OK)
+ */
+static long amvp_curl_http_delete(AMVP_CTX *ctx, const char *url) {
+    long http_code = 0;
+    CURL *hnd = NULL;
+    CURLcode crv = CURLE_OK;
+    struct curl_slist *slist = NULL;
+
+
+    ctx->curl_read_ctr = 0;
+    /*
+     * Set the Content-Type header in the HTTP request
+     */
+    slist = curl_slist_append(slist, "Content-Type:application/json");
+
+    /*
+     * Create the Authorzation header if needed
+     */
+    slist = amvp_add_auth_hdr(ctx, slist);
+
+    //Setup Curl
+    hnd = amvp_curl_get_handle(ctx, url, slist);
+    if (!hnd) goto end;
+    crv = curl_easy_setopt(hnd, CURLOPT_CUSTOMREQUEST, "DELETE");
+    if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_CUSTOMREQUEST, stopping"); goto end; }
 
     if (ctx->log_lvl == AMVP_LOG_LVL_VERBOSE) {
         printf("\nHTTP DELETE: %s\n", url);
     }
 
     /*
-     * Send the HTTP PUT request
+     * Send the HTTP DELETE request
      */
     crv = curl_easy_perform(hnd);
     if (crv != CURLE_OK) {
@@ -589,8 +1356,7 @@ static long amvp_curl_http_delete(AMVP_CTX *ctx, const char *url) {
     curl_easy_getinfo(hnd, CURLINFO_RESPONSE_CODE, &http_code);
 
 end:
-    if (hnd) curl_easy_cleanup(hnd);
-    hnd = NULL;
+    amvp_curl_release_handle(ctx);
     if (slist) curl_slist_free_all(slist);
     slist = NULL;
 
@@ -676,222 +1442,1616 @@ AMVP_RESULT amvp_send_login(AMVP_CTX *ctx,
 }
 
 /*
- * This function is used to submit a vector set response
- * to the ACV server.
+ * Proactive JWT renewal.
+ *
+ * The server's access tokens expire, and a request made with an expired
+ * one fails with 401 and has to wait for a fresh login before it can be
+ * sent again. To keep that off the request path amvp_jwt_track() reads
+ * the expiry of each new token, and a renewal thread logs in with it a
+ * margin ahead of time, on a connection of its own. The renewed token is
+ * left for the thread making ctx's requests, which swaps it in before its
+ * next request (amvp_jwt_renew_check()), so ctx->jwt_token is still only
+ * touched by that one thread and nothing in flight waits on the renewal.
+ *
+ * Should the renewed token not be back by the time the current one is
+ * about to run out, or where there is no renewal thread, the token is
+ * renewed in line before the next request. The refresh on 401 in
+ * execute_network_action() stays as the last resort.
  */
-AMVP_RESULT amvp_submit_vector_responses(AMVP_CTX *ctx, char *vsid_url) {
-#ifdef AMVP_OFFLINE 
-    AMVP_LOG_ERR("Curl not linked, exiting function"); 
-    return AMVP_TRANSPORT_FAIL;
-#else
-    AMVP_RESULT rv = 0;
+#if !defined AMVP_OFFLINE && !defined _WIN32 && !defined USE_MURL
+#define AMVP_JWT_RENEW_THREAD
+
+struct amvp_jwt_renew_t {
+    pthread_t tid;
+    pthread_mutex_t lock;
+    pthread_cond_t cv;          /* Signalled when the token changes or on shutdown */
+    char token[AMVP_JWT_TOKEN_MAX + 1]; /* Token to renew */
+    time_t renew_at;            /* 0 when there is nothing to renew */
+    unsigned int gen;           /* Bumped whenever ctx gets a new token */
+    char *renewed;              /* Renewed token waiting to be swapped in */
+    int shutdown;
+};
+
+typedef struct amvp_jwt_renew_rsp_t {
+    CURL *hnd;
+    char *buf;
+    int len;
+    int size;
+} AMVP_JWT_RENEW_RSP;
+
+static size_t amvp_jwt_renew_write_callback(void *ptr, size_t size, size_t nmemb, void *userdata) {
+    AMVP_JWT_RENEW_RSP *rsp = (AMVP_JWT_RENEW_RSP *)userdata;
+
+    if (size != 1) {
+        return 0;
+    }
+    return amvp_curl_buf_append(&rsp->buf, &rsp->len, &rsp->size, rsp->hnd, ptr, nmemb);
+}
+
+/*
+ * Logs in to renew jwt, on the renewal thread. Only ctx's settings are
+ * read, and the connection is not shared with ctx's. Returns the new
+ * token, or NULL if the server didn't give one.
+ */
+static char *amvp_jwt_renew_login(AMVP_CTX *ctx, const char *jwt) {
+    AMVP_JWT_RENEW_RSP rsp;
+    struct curl_slist *slist = NULL;
+    JSON_Value *val = NULL;
+    const char *access_token = NULL;
     char url[AMVP_ATTR_URL_MAX] = {0};
+    char *login = NULL, *renewed = NULL;
+    int login_len = 0;
+    long http_code = 0;
+    CURLcode crv = CURLE_OK;
 
-    rv = sanity_check_ctx(ctx);
-    if (AMVP_SUCCESS != rv) return rv;
+    memzero_s(&rsp, sizeof(rsp));
+    if (amvp_build_login(ctx, &login, &login_len, jwt) != AMVP_SUCCESS || !login) {
+        AMVP_LOG_WARN("Unable to build the JWT renewal message");
+        goto end;
+    }
+    snprintf(url, AMVP_ATTR_URL_MAX - 1, "https://%s:%d%s%s", ctx->server_name,
+             ctx->server_port, ctx->path_segment, AMVP_LOGIN_URI);
+    slist = curl_slist_append(slist, "Content-Type:application/json");
 
-    if (!vsid_url) {
-        AMVP_LOG_ERR("Missing vsid_url");
-        return AMVP_MISSING_ARG;
+    rsp.hnd = curl_easy_init();
+    if (!rsp.hnd) goto end;
+    if (amvp_curl_setup_handle_opts(ctx, rsp.hnd, url, slist, amvp_jwt_renew_write_callback,
+                                    &rsp, 0) != AMVP_SUCCESS) {
+        goto end;
+    }
+    crv = curl_easy_setopt(rsp.hnd, CURLOPT_POST, 1L);
+    if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_POST, stopping"); goto end; }
+    crv = curl_easy_setopt(rsp.hnd, CURLOPT_POSTFIELDS, login);
+    if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_POSTFIELDS, stopping"); goto end; }
+    crv = curl_easy_setopt(rsp.hnd, CURLOPT_POSTFIELDSIZE_LARGE, (curl_off_t)login_len);
+    if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_POSTFIELDSIZE_LARGE, stopping"); goto end; }
+
+    crv = curl_easy_perform(rsp.hnd);
+    curl_easy_getinfo(rsp.hnd, CURLINFO_RESPONSE_CODE, &http_code);
+    if (crv != CURLE_OK || http_code != HTTP_OK || !rsp.buf) {
+        AMVP_LOG_WARN("JWT renewal failed, curl rc=%d, HTTP %ld", crv, http_code);
+        goto end;
+    }
+
+    val = json_parse_string(rsp.buf);
+    access_token = json_object_get_string(amvp_get_obj_from_rsp(ctx, val), "accessToken");
+    if (!access_token || strnlen_s(access_token, AMVP_JWT_TOKEN_MAX + 1) > AMVP_JWT_TOKEN_MAX) {
+        AMVP_LOG_WARN("JWT renewal response has no usable accessToken");
+        goto end;
+    }
+    renewed = calloc(AMVP_JWT_TOKEN_MAX + 1, sizeof(char));
+    if (renewed) {
+        strcpy_s(renewed, AMVP_JWT_TOKEN_MAX + 1, access_token);
+    }
+
+end:
+    if (val) json_value_free(val);
+    if (rsp.hnd) curl_easy_cleanup(rsp.hnd);
+    if (rsp.buf) amvp_mem_free(rsp.buf);
+    if (slist) curl_slist_free_all(slist);
+    if (login) free(login);
+    return renewed;
+}
+
+static void *amvp_jwt_renew_main(void *arg) {
+    AMVP_CTX *ctx = (AMVP_CTX *)arg;
+    AMVP_JWT_RENEW *r = ctx->jwt_renew;
+    char *jwt = NULL, *renewed = NULL;
+    struct timespec until;
+    unsigned int gen = 0;
+
+    jwt = calloc(AMVP_JWT_TOKEN_MAX + 1, sizeof(char));
+    if (!jwt) return NULL;
+
+    pthread_mutex_lock(&r->lock);
+    while (!r->shutdown) {
+        if (!r->renew_at || r->renewed) {
+            pthread_cond_wait(&r->cv, &r->lock);
+            continue;
+        }
+        if (time(NULL) < r->renew_at) {
+            until.tv_sec = r->renew_at;
+            until.tv_nsec = 0;
+            pthread_cond_timedwait(&r->cv, &r->lock, &until);
+            continue;
+        }
+
+        gen = r->gen;
+        strcpy_s(jwt, AMVP_JWT_TOKEN_MAX + 1, r->token);
+        r->renew_at = 0;
+        pthread_mutex_unlock(&r->lock);
+        renewed = amvp_jwt_renew_login(ctx, jwt);
+        pthread_mutex_lock(&r->lock);
+
+        if (gen != r->gen) {
+            /* ctx got a new token meanwhile, this one is for the old one */
+            if (renewed) free(renewed);
+        } else if (renewed) {
+            r->renewed = renewed;
+        } else {
+            r->renew_at = time(NULL) + AMVP_JWT_RENEW_RETRY;
+        }
+        renewed = NULL;
+    }
+    pthread_mutex_unlock(&r->lock);
+
+    memzero_s(jwt, AMVP_JWT_TOKEN_MAX + 1);
+    free(jwt);
+    return NULL;
+}
+
+static AMVP_RESULT amvp_jwt_renew_start(AMVP_CTX *ctx) {
+    AMVP_JWT_RENEW *r = calloc(1, sizeof(AMVP_JWT_RENEW));
+
+    if (!r) {
+        return AMVP_MALLOC_FAIL;
+    }
+    pthread_mutex_init(&r->lock, NULL);
+    pthread_cond_init(&r->cv, NULL);
+    ctx->jwt_renew = r;
+    if (pthread_create(&r->tid, NULL, amvp_jwt_renew_main, ctx)) {
+        pthread_cond_destroy(&r->cv);
+        pthread_mutex_destroy(&r->lock);
+        free(r);
+        ctx->jwt_renew = NULL;
+        return AMVP_INTERNAL_ERR;
+    }
+    return AMVP_SUCCESS;
+}
+
+/*
+ * Hands the token ctx just got to the renewal thread, starting the thread
+ * for the first one. Whatever it was doing for the previous token is
+ * dropped.
+ */
+static void amvp_jwt_renew_schedule(AMVP_CTX *ctx) {
+    AMVP_JWT_RENEW *r = NULL;
+
+    if (!ctx->jwt_renew && ctx->jwt_renew_at && amvp_jwt_renew_start(ctx) != AMVP_SUCCESS) {
+        AMVP_LOG_WARN("Failed to start the JWT renewal thread, tokens will be renewed in line");
+        return;
+    }
+    r = ctx->jwt_renew;
+    if (!r) {
+        return;
+    }
+    pthread_mutex_lock(&r->lock);
+    r->gen++;
+    if (r->renewed) {
+        free(r->renewed);
+        r->renewed = NULL;
+    }
+    r->renew_at = ctx->jwt_renew_at;
+    if (r->renew_at) {
+        strcpy_s(r->token, AMVP_JWT_TOKEN_MAX + 1, ctx->jwt_token);
+    }
+    pthread_cond_signal(&r->cv);
+    pthread_mutex_unlock(&r->lock);
+}
+#endif
+
+#ifndef AMVP_OFFLINE
+/*
+ * Called before each request is set up. Swaps in a token the renewal
+ * thread got, or renews the token in line if it is due and the thread
+ * hasn't come through.
+ */
+static void amvp_jwt_renew_check(AMVP_CTX *ctx) {
+    char *saved = NULL;
+    time_t now = 0;
+
+    if (!ctx->jwt_token || !ctx->jwt_renew_at) {
+        return;
+    }
+#ifdef AMVP_JWT_RENEW_THREAD
+    if (ctx->jwt_renew) {
+        AMVP_JWT_RENEW *r = ctx->jwt_renew;
+        char *renewed = NULL;
+
+        pthread_mutex_lock(&r->lock);
+        renewed = r->renewed;
+        r->renewed = NULL;
+        pthread_mutex_unlock(&r->lock);
+        if (renewed) {
+            memzero_s(ctx->jwt_token, AMVP_JWT_TOKEN_MAX + 1);
+            strcpy_s(ctx->jwt_token, AMVP_JWT_TOKEN_MAX + 1, renewed);
+            free(renewed);
+            AMVP_LOG_STATUS("Access token renewed ahead of expiry");
+            amvp_jwt_track(ctx);
+            return;
+        }
+        /* Leave it to the thread until the token is about to run out */
+        if (time(NULL) < ctx->jwt_expiry - AMVP_JWT_RENEW_MIN) {
+            return;
+        }
+    }
+#endif
+    now = time(NULL);
+    if (now < ctx->jwt_renew_at) {
+        return;
+    }
+
+    AMVP_LOG_STATUS("Access token expires soon, renewing...");
+    /* A failed login drops the token, keep it for the requests it is still good for */
+    saved = calloc(AMVP_JWT_TOKEN_MAX + 1, sizeof(char));
+    if (saved) {
+        strcpy_s(saved, AMVP_JWT_TOKEN_MAX + 1, ctx->jwt_token);
+    }
+    if (amvp_refresh(ctx) == AMVP_SUCCESS) {
+        AMVP_LOG_STATUS("Access token renewed ahead of expiry");
+    } else {
+        AMVP_LOG_WARN("Failed to renew the access token ahead of expiry");
+        if (!ctx->jwt_token && saved) {
+            ctx->jwt_token = saved;
+            saved = NULL;
+        }
+        ctx->jwt_renew_at = now + AMVP_JWT_RENEW_RETRY;
+    }
+    if (saved) free(saved);
+}
+#endif
+
+/*
+ * This function is used to submit a vector set response
+ * to the ACV server.
+ */
+AMVP_RESULT amvp_submit_vector_responses(AMVP_CTX *ctx, char *vsid_url) {
+#ifdef AMVP_OFFLINE 
+    AMVP_LOG_ERR("Curl not linked, exiting function"); 
+    return AMVP_TRANSPORT_FAIL;
+#else
+    AMVP_RESULT rv = 0;
+    char url[AMVP_ATTR_URL_MAX] = {0};
+
+    rv = sanity_check_ctx(ctx);
+    if (AMVP_SUCCESS != rv) return rv;
+
+    if (!vsid_url) {
+        AMVP_LOG_ERR("Missing vsid_url");
+        return AMVP_MISSING_ARG;
+    }
+
+    snprintf(url, AMVP_ATTR_URL_MAX - 1,
+            "https://%s:%d%s/results",
+            ctx->server_name, ctx->server_port, vsid_url);
+
+    return amvp_network_action(ctx, AMVP_NET_POST_VS_RESP, url, NULL, 0);
+#endif
+}
+
+AMVP_RESULT amvp_transport_post(AMVP_CTX *ctx,
+                                const char *uri,
+                                char *data,
+                                int data_len) {
+#ifdef AMVP_OFFLINE 
+    AMVP_LOG_ERR("Curl not linked, exiting function"); 
+    return AMVP_TRANSPORT_FAIL;
+#else
+    AMVP_RESULT rv = 0;
+    char url[AMVP_ATTR_URL_MAX] = {0};
+
+    rv = sanity_check_ctx(ctx);
+    if (AMVP_SUCCESS != rv) return rv;
+
+    if (!uri) {
+        AMVP_LOG_ERR("Missing endpoint");
+        return AMVP_MISSING_ARG;
+    }
+
+    snprintf(url, AMVP_ATTR_URL_MAX - 1,
+            "https://%s:%d%s",
+            ctx->server_name, ctx->server_port, uri);
+
+    return amvp_network_action(ctx, AMVP_NET_POST, url, data, data_len);
+#endif
+}
+
+
+/*
+ * This is the top level function used within libamvp to retrieve
+ * a KAT vector set from the AMVP server.
+ */
+AMVP_RESULT amvp_retrieve_vector_set(AMVP_CTX *ctx, char *vsid_url) {
+#ifdef AMVP_OFFLINE 
+    AMVP_LOG_ERR("Curl not linked, exiting function"); 
+    return AMVP_TRANSPORT_FAIL;
+#else
+    AMVP_RESULT rv = 0;
+    char url[AMVP_ATTR_URL_MAX] = {0};
+
+    rv = sanity_check_ctx(ctx);
+    if (AMVP_SUCCESS != rv) return rv;
+
+    if (!vsid_url) {
+        AMVP_LOG_ERR("Missing vsid_url");
+        return AMVP_MISSING_ARG;
+    }
+
+    snprintf(url, AMVP_ATTR_URL_MAX - 1,
+            "https://%s:%d%s",
+            ctx->server_name, ctx->server_port, vsid_url);
+
+   AMVP_LOG_STATUS("GET %s", vsid_url);
+
+    return amvp_network_action(ctx, AMVP_NET_GET_VS, url, NULL, 0);
+#endif
+}
+
+/*
+ * This is the top level function used within libamvp to retrieve
+ * documentation package 
+ */
+AMVP_RESULT amvp_retrieve_docs(AMVP_CTX *ctx, char *vsid_url) {
+#ifdef AMVP_OFFLINE 
+    AMVP_LOG_ERR("Curl not linked, exiting function"); 
+    return AMVP_TRANSPORT_FAIL;
+#else
+    AMVP_RESULT rv = 0;
+    char url[AMVP_ATTR_URL_MAX] = {0};
+
+    rv = sanity_check_ctx(ctx);
+    if (AMVP_SUCCESS != rv) return rv;
+
+    if (!vsid_url) {
+        AMVP_LOG_ERR("Missing vsid_url");
+        return AMVP_MISSING_ARG;
+    }
+
+    snprintf(url, AMVP_ATTR_URL_MAX - 1,
+            "https://%s:%d%s/docs",
+            ctx->server_name, ctx->server_port, vsid_url);
+
+
+    return amvp_network_action(ctx, AMVP_NET_GET_DOCS, url, NULL, 0);
+#endif
+}
+
+/*
+ * This is the top level function used within libamvp to retrieve
+ * It can be used to get the results for an entire session, or
+ * more specifically for a vectorSet
+ */
+AMVP_RESULT amvp_retrieve_vector_set_result(AMVP_CTX *ctx, const char *api_url) {
+#ifdef AMVP_OFFLINE 
+    AMVP_LOG_ERR("Curl not linked, exiting function"); 
+    return AMVP_TRANSPORT_FAIL;
+#else
+    AMVP_RESULT rv = 0;
+    char url[AMVP_ATTR_URL_MAX] = {0};
+
+    rv = sanity_check_ctx(ctx);
+    if (AMVP_SUCCESS != rv) return rv;
+
+    if (!api_url) {
+        AMVP_LOG_ERR("Missing api_url");
+        return AMVP_MISSING_ARG;
+    }
+
+    snprintf(url, AMVP_ATTR_URL_MAX - 1,
+            "https://%s:%d%s/results",
+            ctx->server_name, ctx->server_port, api_url);
+
+    return amvp_network_action(ctx, AMVP_NET_GET_VS_RESULT, url, NULL, 0);
+#endif
+}
+
+AMVP_RESULT amvp_retrieve_expected_result(AMVP_CTX *ctx, const char *api_url) {
+#ifdef AMVP_OFFLINE 
+    AMVP_LOG_ERR("Curl not linked, exiting function"); 
+    return AMVP_TRANSPORT_FAIL;
+#else
+    AMVP_RESULT rv = 0;
+    char url[AMVP_ATTR_URL_MAX + 1] = {0};
+
+    rv = sanity_check_ctx(ctx);
+    if (AMVP_SUCCESS != rv) return rv;
+
+    if (!api_url) {
+        AMVP_LOG_ERR("Missing api_url");
+        return AMVP_MISSING_ARG;
+    }
+
+    snprintf(url, AMVP_ATTR_URL_MAX,
+            "https://%s:%d%s/expected",
+            ctx->server_name, ctx->server_port, api_url);
+
+    return amvp_network_action(ctx, AMVP_NET_GET_VS_SAMPLE, url, NULL, 0);
+#endif
+}
+
+AMVP_RESULT amvp_transport_put(AMVP_CTX *ctx,
+                               const char *endpoint,
+                               const char *data,
+                               int data_len) {
+#ifdef AMVP_OFFLINE 
+    AMVP_LOG_ERR("Curl not linked, exiting function"); 
+    return AMVP_TRANSPORT_FAIL;
+#else
+    AMVP_RESULT rv = 0;
+    char url[AMVP_ATTR_URL_MAX] = {0};
+
+    rv = sanity_check_ctx(ctx);
+    if (AMVP_SUCCESS != rv) return rv;
+
+    if (!endpoint) {
+        AMVP_LOG_ERR("Missing endpoint");
+        return AMVP_MISSING_ARG;
+    }
+
+    snprintf(url, AMVP_ATTR_URL_MAX - 1,
+            "https://%s:%d%s",
+            ctx->server_name, ctx->server_port, endpoint);
+
+    return amvp_network_action(ctx, AMVP_NET_PUT_VALIDATION, url, data, data_len);
+#endif
+}
+
+AMVP_RESULT amvp_transport_delete(AMVP_CTX *ctx,
+                               const char *endpoint) {
+#ifdef AMVP_OFFLINE
+    AMVP_LOG_ERR("Curl not linked, exiting function");
+    return AMVP_TRANSPORT_FAIL;
+#else
+    AMVP_RESULT rv = 0;
+    char url[AMVP_ATTR_URL_MAX] = {0};
+
+    rv = sanity_check_ctx(ctx);
+    if (AMVP_SUCCESS != rv) return rv;
+
+    if (!endpoint) {
+        AMVP_LOG_ERR("Missing endpoint");
+        return AMVP_MISSING_ARG;
+    }
+
+    snprintf(url, AMVP_ATTR_URL_MAX - 1,
+            "https://%s:%d%s",
+            ctx->server_name, ctx->server_port, endpoint);
+
+    return amvp_network_action(ctx, AMVP_NET_DELETE, url, NULL, 0);
+#endif
+}
+
+/*
+ * Releases the curl handle and share object cached on the context.
+ * Invoked when the context is freed.
+ */
+void amvp_transport_cleanup(AMVP_CTX *ctx) {
+    if (!ctx) return;
+#ifndef AMVP_OFFLINE
+    if (ctx->curl_hnd) curl_easy_cleanup(ctx->curl_hnd);
+#ifndef USE_MURL
+    /* A session group's share belongs to the group */
+    if (ctx->curl_share && !ctx->session_group) curl_share_cleanup(ctx->curl_share);
+#endif
+#endif
+    ctx->curl_hnd = NULL;
+    ctx->curl_share = NULL;
+}
+
+/*
+ * Called whenever ctx->jwt_token is set. Reads the new token's expiry and
+ * works out when to renew it: ctx->jwt_renew_margin seconds before it
+ * expires, or a quarter of its lifetime if that is 0, but never later
+ * than AMVP_JWT_RENEW_MIN seconds before.
+ */
+void amvp_jwt_track(AMVP_CTX *ctx) {
+    time_t issued = 0, margin = 0;
+
+    ctx->jwt_expiry = amvp_jwt_expiry(ctx->jwt_token, &issued);
+    ctx->jwt_renew_at = 0;
+    if (ctx->jwt_expiry && ctx->jwt_renew_margin >= 0) {
+        margin = ctx->jwt_renew_margin;
+        if (!margin) {
+            if (!issued || issued > ctx->jwt_expiry) issued = time(NULL);
+            margin = (ctx->jwt_expiry - issued) / 4;
+        }
+        if (margin < AMVP_JWT_RENEW_MIN) margin = AMVP_JWT_RENEW_MIN;
+        ctx->jwt_renew_at = ctx->jwt_expiry - margin;
+    }
+#ifdef AMVP_JWT_RENEW_THREAD
+    amvp_jwt_renew_schedule(ctx);
+#endif
+}
+
+void amvp_jwt_renew_free(AMVP_CTX *ctx) {
+#ifdef AMVP_JWT_RENEW_THREAD
+    AMVP_JWT_RENEW *r = NULL;
+
+    if (!ctx || !ctx->jwt_renew) {
+        return;
+    }
+    r = ctx->jwt_renew;
+    pthread_mutex_lock(&r->lock);
+    r->shutdown = 1;
+    pthread_cond_signal(&r->cv);
+    pthread_mutex_unlock(&r->lock);
+    pthread_join(r->tid, NULL);
+    pthread_cond_destroy(&r->cv);
+    pthread_mutex_destroy(&r->lock);
+    if (r->renewed) free(r->renewed);
+    memzero_s(r->token, sizeof(r->token));
+    free(r);
+    ctx->jwt_renew = NULL;
+#else
+    (void)ctx;
+#endif
+}
+
+#if !defined AMVP_OFFLINE && !defined USE_MURL
+#define AMVP_VS_PIPELINE_POLL_MS 100
+
+/*
+ * State of a single vector set in the concurrent transfer loop.
+ */
+typedef enum amvp_vs_xfer_state {
+    AMVP_VS_XFER_PENDING = 0, /**< Not started yet */
+    AMVP_VS_XFER_GET,         /**< Downloading the vector set */
+    AMVP_VS_XFER_WAIT,        /**< Server asked us to come back later */
+    AMVP_VS_XFER_READY,       /**< Downloaded, queued for the crypto thread */
+    AMVP_VS_XFER_PROCESSING,  /**< Being run through process_cb on the crypto thread */
+    AMVP_VS_XFER_POST,        /**< Uploading the vector set responses */
+    AMVP_VS_XFER_PUT,         /**< Re-uploading responses the server already has */
+    AMVP_VS_XFER_DONE,        /**< Responses accepted by the server */
+    AMVP_VS_XFER_FAILED       /**< Transport error, left for the serial path */
+} AMVP_VS_XFER_STATE;
+
+typedef struct amvp_vs_xfer_t {
+    const char *vsid_url;
+    AMVP_VS_XFER_STATE state;
+    const char *method;       /**< HTTP method of the current request */
+    CURL *hnd;
+    struct curl_slist *slist;
+    char url[AMVP_ATTR_URL_MAX + 1];
+    char *buf;                /**< Response body for the current request */
+    int buf_len;
+    int buf_size;
+    char *rsp;                /**< Serialized vector set responses to upload */
+    int rsp_len;
+    int rsp_gzip;             /**< rsp holds the gzip compressed responses */
+    size_t acked;             /**< Bytes of rsp the server holds, for chunked uploads */
+    size_t chunk_len;         /**< Bytes of rsp the current request sends */
+    int chunk_failures;       /**< Failed chunks since the upload last moved forward */
+    char range[AMVP_HTTP_RANGE_MAX + 1]; /**< Range header of the server's 308 */
+    time_t wake_time;         /**< When to retry the download (AMVP_VS_XFER_WAIT) */
+    unsigned int waited;      /**< Total seconds spent waiting on the server */
+    int retry_period;         /**< Set by process_cb when the server wants us to wait */
+    AMVP_VS_METRICS_REC *metrics; /**< NULL unless amvp_set_metrics() is on */
+    double started;           /**< When the current request was started, for metrics */
+} AMVP_VS_XFER;
+
+/*
+ * State of the concurrent transfer loop, kept between calls so it can be
+ * stepped from an event loop as well as run to completion.
+ *
+ * When pipelined, process_cb runs on a separate crypto thread so the
+ * calling thread can keep downloading the next vector sets and uploading
+ * finished responses meanwhile. One set is processed at a time, and at
+ * most depth more are downloaded ahead of it.
+ */
+struct amvp_vs_multi_t {
+    AMVP_CTX *ctx;
+    CURLM *multi;
+    AMVP_VS_PROCESS_CB process_cb;
+    AMVP_VS_XFER *xfers;
+    int count;
+    int remaining;
+    int active;
+    AMVP_STRING_LIST *failed; /**< Vector sets left for the serial path, in list order */
+
+    int depth;                /**< Pipeline depth, 0 when process_cb runs inline */
+#ifndef _WIN32
+    pthread_t tid;
+    pthread_mutex_t lock;
+    pthread_cond_t job_cv;    /**< Signalled when a job is posted or on shutdown */
+    AMVP_VS_XFER *job;        /**< Set being processed, NULL when the thread is idle */
+    AMVP_RESULT job_rv;
+    int job_done;
+    int shutdown;
+#endif
+};
+
+static size_t amvp_vs_xfer_write_callback(void *ptr, size_t size, size_t nmemb, void *userdata) {
+    AMVP_VS_XFER *xfer = (AMVP_VS_XFER *)userdata;
+
+    if (size != 1) {
+        fprintf(stderr, "\ncurl size not 1\n");
+        return 0;
+    }
+
+    return amvp_curl_buf_append(&xfer->buf, &xfer->buf_len, &xfer->buf_size,
+                                xfer->hnd, ptr, nmemb);
+}
+
+/* Whether the responses of a transfer go out in chunks, see amvp_set_chunked_upload() */
+static int amvp_vs_xfer_chunked(AMVP_CTX *ctx, AMVP_VS_XFER *xfer) {
+    return ctx->upload_chunk && !xfer->rsp_gzip && (size_t)xfer->rsp_len > ctx->upload_chunk;
+}
+
+/*
+ * Sets up the easy handle for the next request of a transfer (GET of
+ * the vector set, or POST/PUT of its responses) and hands it to the
+ * multi handle. A chunked upload sends the chunk starting at xfer->acked,
+ * or asks how far the server got once it holds all of the responses.
+ */
+static AMVP_RESULT amvp_vs_xfer_start(AMVP_CTX *ctx,
+                                      CURLM *multi,
+                                      AMVP_VS_XFER *xfer,
+                                      AMVP_VS_XFER_STATE state) {
+    CURLcode crv = CURLE_OK;
+    const char *method = NULL;
+    char content_range[AMVP_HTTP_RANGE_MAX + 1];
+    int chunked = 0;
+
+    xfer->state = state;
+    xfer->buf_len = 0;
+    if (xfer->buf) xfer->buf[0] = 0;
+    if (xfer->metrics) {
+        if (state == AMVP_VS_XFER_GET) amvp_metrics_download_start(xfer->metrics);
+        xfer->started = amvp_metrics_now();
+    }
+
+    if (state == AMVP_VS_XFER_GET) {
+        snprintf(xfer->url, AMVP_ATTR_URL_MAX, "https://%s:%d%s",
+                 ctx->server_name, ctx->server_port, xfer->vsid_url);
+    } else {
+        snprintf(xfer->url, AMVP_ATTR_URL_MAX, "https://%s:%d%s/results",
+                 ctx->server_name, ctx->server_port, xfer->vsid_url);
+        xfer->slist = curl_slist_append(xfer->slist, "Content-Type:application/json");
+        if (xfer->rsp_gzip) {
+            xfer->slist = curl_slist_append(xfer->slist, "Content-Encoding: gzip");
+        }
+        xfer->chunk_len = (size_t)xfer->rsp_len;
+        chunked = amvp_vs_xfer_chunked(ctx, xfer);
+        if (chunked) {
+            xfer->chunk_len = xfer->rsp_len - xfer->acked < ctx->upload_chunk ?
+                              xfer->rsp_len - xfer->acked : ctx->upload_chunk;
+            amvp_chunk_content_range(content_range, sizeof(content_range), xfer->acked,
+                                     xfer->chunk_len, (size_t)xfer->rsp_len);
+            xfer->slist = curl_slist_append(xfer->slist, content_range);
+        }
+        method = (state == AMVP_VS_XFER_POST) ? "POST" : "PUT";
+    }
+    xfer->method = method ? method : "GET";
+    xfer->slist = amvp_add_auth_hdr(ctx, xfer->slist);
+
+    if (xfer->hnd) {
+        curl_easy_reset(xfer->hnd);
+    } else {
+        xfer->hnd = curl_easy_init();
+        if (!xfer->hnd) { AMVP_LOG_ERR("Error initializing Curl structure, stopping"); return AMVP_TRANSPORT_FAIL; }
+    }
+    if (amvp_curl_setup_handle(ctx, xfer->hnd, xfer->url, xfer->slist,
+                               amvp_vs_xfer_write_callback, xfer) != AMVP_SUCCESS) {
+        return AMVP_TRANSPORT_FAIL;
+    }
+    crv = curl_easy_setopt(xfer->hnd, CURLOPT_PRIVATE, xfer);
+    if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_PRIVATE, stopping"); return AMVP_TRANSPORT_FAIL; }
+
+    if (method) {
+        crv = curl_easy_setopt(xfer->hnd, CURLOPT_CUSTOMREQUEST, method);
+        if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_CUSTOMREQUEST, stopping"); return AMVP_TRANSPORT_FAIL; }
+        if (state == AMVP_VS_XFER_POST) {
+            crv = curl_easy_setopt(xfer->hnd, CURLOPT_POST, 1L);
+            if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_POST, stopping"); return AMVP_TRANSPORT_FAIL; }
+        }
+        crv = curl_easy_setopt(xfer->hnd, CURLOPT_POSTFIELDS, xfer->rsp + (chunked ? xfer->acked : 0));
+        if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_POSTFIELDS, stopping"); return AMVP_TRANSPORT_FAIL; }
+        crv = curl_easy_setopt(xfer->hnd, CURLOPT_POSTFIELDSIZE_LARGE, (curl_off_t)xfer->chunk_len);
+        if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_POSTFIELDSIZE_LARGE, stopping"); return AMVP_TRANSPORT_FAIL; }
+    }
+    if (chunked) {
+        xfer->range[0] = '\0';
+        crv = curl_easy_setopt(xfer->hnd, CURLOPT_HEADERFUNCTION, amvp_curl_range_callback);
+        if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_HEADERFUNCTION, stopping"); return AMVP_TRANSPORT_FAIL; }
+        crv = curl_easy_setopt(xfer->hnd, CURLOPT_HEADERDATA, xfer->range);
+        if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_HEADERDATA, stopping"); return AMVP_TRANSPORT_FAIL; }
+    }
+
+    if (curl_multi_add_handle(multi, xfer->hnd) != CURLM_OK) {
+        AMVP_LOG_ERR("Error adding transfer to Curl multi handle, stopping");
+        return AMVP_TRANSPORT_FAIL;
+    }
+    return AMVP_SUCCESS;
+}
+
+/*
+ * The server asked us to wait before downloading the vector set.
+ * Apply the same limits as amvp_retry_handler(), but instead of
+ * sleeping just note when the download should be attempted again.
+ *
+ * Returns 0 once AMVP_MAX_WAIT_TIME has been used up.
+ */
+static int amvp_vs_xfer_schedule_retry(AMVP_CTX *ctx, AMVP_VS_XFER *xfer, int retry_period) {
+    if (xfer->waited >= AMVP_MAX_WAIT_TIME) {
+        return 0;
+    }
+    if (xfer->waited + retry_period > AMVP_MAX_WAIT_TIME) {
+        retry_period = AMVP_MAX_WAIT_TIME - xfer->waited;
+    }
+    if (retry_period <= AMVP_RETRY_TIME_MIN || retry_period > AMVP_RETRY_TIME_MAX) {
+        retry_period = AMVP_RETRY_TIME_MAX;
+        AMVP_LOG_WARN("retry_period not found, using max retry period!");
+    }
+    AMVP_LOG_STATUS("200 OK KAT values not ready for %s, server requests we wait %u seconds and try again...",
+                    xfer->vsid_url, retry_period);
+
+    xfer->waited += retry_period;
+    xfer->wake_time = time(NULL) + retry_period;
+    xfer->state = AMVP_VS_XFER_WAIT;
+    amvp_metrics_retry(xfer->metrics);
+    return 1;
+}
+
+/*
+ * Moves a downloaded vector set on once process_cb has returned \p rv
+ * for it: either schedules another download or queues the responses
+ * for upload.
+ */
+static AMVP_RESULT amvp_vs_xfer_processed(AMVP_CTX *ctx,
+                                          CURLM *multi,
+                                          AMVP_VS_XFER *xfer,
+                                          AMVP_RESULT rv) {
+    char *zdata = NULL;
+    int zdata_len = 0;
+
+    if (rv == AMVP_KAT_DOWNLOAD_RETRY) {
+        if (!amvp_vs_xfer_schedule_retry(ctx, xfer, xfer->retry_period)) {
+            AMVP_LOG_STATUS("Maximum wait time with server reached! (Max: %d seconds)", AMVP_MAX_WAIT_TIME);
+            return AMVP_TRANSPORT_FAIL;
+        }
+        return AMVP_SUCCESS;
+    }
+    if (rv != AMVP_SUCCESS) {
+        return rv;
+    }
+    zdata = amvp_compress_body(ctx, xfer->rsp, xfer->rsp_len, &zdata_len);
+    if (zdata) {
+        free(xfer->rsp);
+        xfer->rsp = zdata;
+        xfer->rsp_len = zdata_len;
+        xfer->rsp_gzip = 1;
+    }
+
+    AMVP_LOG_STATUS("Posting vector set responses for %s...", xfer->vsid_url);
+    xfer->acked = 0;
+    xfer->chunk_failures = 0;
+    return amvp_vs_xfer_start(ctx, multi, xfer, AMVP_VS_XFER_POST);
+}
+
+#ifndef _WIN32
+/*
+ * Body of the crypto thread of a pipelined loop: runs process_cb for
+ * each job posted by amvp_vs_multi_step() and wakes the loop when done.
+ */
+static void *amvp_vs_crypto_main(void *arg) {
+    AMVP_VS_MULTI *m = arg;
+    AMVP_VS_XFER *xfer = NULL;
+    AMVP_RESULT rv = AMVP_SUCCESS;
+
+    pthread_mutex_lock(&m->lock);
+    while (1) {
+        while (!m->shutdown && (!m->job || m->job_done)) {
+            pthread_cond_wait(&m->job_cv, &m->lock);
+        }
+        if (m->shutdown) {
+            break;
+        }
+        xfer = m->job;
+        pthread_mutex_unlock(&m->lock);
+
+        rv = m->process_cb(m->ctx, xfer->vsid_url, xfer->buf, &xfer->retry_period,
+                           &xfer->rsp, &xfer->rsp_len);
+
+        pthread_mutex_lock(&m->lock);
+        m->job_rv = rv;
+        m->job_done = 1;
+#if LIBCURL_VERSION_NUM >= 0x074400
+        curl_multi_wakeup(m->multi);
+#endif
+    }
+    pthread_mutex_unlock(&m->lock);
+    return NULL;
+}
+
+/*
+ * Collects the result of a finished job and hands the crypto thread
+ * the next downloaded set, in list order.
+ */
+static AMVP_RESULT amvp_vs_multi_pump(AMVP_CTX *ctx, AMVP_VS_MULTI *m) {
+    AMVP_RESULT rv = AMVP_SUCCESS;
+    AMVP_VS_XFER *xfer = NULL;
+    int i = 0;
+
+    pthread_mutex_lock(&m->lock);
+    if (m->job && m->job_done) {
+        xfer = m->job;
+        rv = m->job_rv;
+        m->job = NULL;
+        m->job_done = 0;
+    }
+    pthread_mutex_unlock(&m->lock);
+
+    if (xfer) {
+        rv = amvp_vs_xfer_processed(ctx, m->multi, xfer, rv);
+        if (rv != AMVP_SUCCESS) return rv;
+        if (xfer->state == AMVP_VS_XFER_POST) {
+            m->active++;
+        }
+    }
+
+    pthread_mutex_lock(&m->lock);
+    if (!m->job) {
+        for (i = 0; i < m->count; i++) {
+            if (m->xfers[i].state == AMVP_VS_XFER_READY) {
+                m->xfers[i].state = AMVP_VS_XFER_PROCESSING;
+                m->job = &m->xfers[i];
+                pthread_cond_signal(&m->job_cv);
+                break;
+            }
+        }
+    }
+    pthread_mutex_unlock(&m->lock);
+    return AMVP_SUCCESS;
+}
+#endif
+
+/*
+ * Handles a finished request of a transfer and moves it on to its
+ * next state. A downloaded vector set is handed to process_cb, and
+ * the responses it produces are queued for upload.
+ *
+ * Transport level failures only mark the transfer as failed so the
+ * caller can run it through the serial path, which knows how to
+ * refresh the JWT and report protocol errors. Anything returned
+ * from here other than AMVP_SUCCESS aborts the whole loop.
+ */
+static AMVP_RESULT amvp_vs_xfer_finish(AMVP_CTX *ctx,
+                                       AMVP_VS_MULTI *m,
+                                       AMVP_VS_XFER *xfer,
+                                       CURLcode result) {
+    CURLM *multi = m->multi;
+    AMVP_RESULT rv = AMVP_SUCCESS;
+    long http_code = 0;
+
+    curl_multi_remove_handle(multi, xfer->hnd);
+    if (xfer->slist) curl_slist_free_all(xfer->slist);
+    xfer->slist = NULL;
+
+    if (result != CURLE_OK) {
+        AMVP_LOG_ERR("Curl failed with code %d (%s)", result, curl_easy_strerror(result));
+    }
+    curl_easy_getinfo(xfer->hnd, CURLINFO_RESPONSE_CODE, &http_code);
+    amvp_metrics_xfer(xfer->metrics, xfer->state != AMVP_VS_XFER_GET, xfer->started,
+                      xfer->state == AMVP_VS_XFER_GET ? 0 : xfer->chunk_len, xfer->buf_len);
+    amvp_curl_trace(ctx, xfer->metrics, xfer->hnd, xfer->method, xfer->url);
+
+    switch (xfer->state) {
+    case AMVP_VS_XFER_GET:
+        AMVP_LOG_STATUS("GET Vector Set...\n\tStatus: %ld\n\tUrl: %s", http_code, xfer->url);
+        if (http_code != HTTP_OK) {
+            xfer->state = AMVP_VS_XFER_FAILED;
+            return AMVP_SUCCESS;
+        }
+
+        if (m->depth) {
+            /* Picked up by amvp_vs_multi_step() once the crypto thread is free */
+            xfer->state = AMVP_VS_XFER_READY;
+            return AMVP_SUCCESS;
+        }
+        rv = m->process_cb(ctx, xfer->vsid_url, xfer->buf, &xfer->retry_period, &xfer->rsp, &xfer->rsp_len);
+        return amvp_vs_xfer_processed(ctx, multi, xfer, rv);
+
+    case AMVP_VS_XFER_POST:
+    case AMVP_VS_XFER_PUT:
+        AMVP_LOG_STATUS("%s Response Submission...\n\tStatus: %ld\n\tUrl: %s",
+                        xfer->method, http_code, xfer->url);
+        if (http_code == HTTP_OK) {
+            xfer->state = AMVP_VS_XFER_DONE;
+            free(xfer->rsp);
+            xfer->rsp = NULL;
+            return AMVP_SUCCESS;
+        }
+        /*
+         * The server holds part of a chunked upload, send it the rest. A 308
+         * that doesn't move the upload forward counts as a failed chunk;
+         * other failures leave the set to the serial path, which resumes.
+         */
+        if (http_code == HTTP_RESUME_INCOMPLETE && amvp_vs_xfer_chunked(ctx, xfer)) {
+            size_t held = amvp_chunk_acked(xfer->range, (size_t)xfer->rsp_len);
+
+            if (held > xfer->acked) {
+                xfer->chunk_failures = 0;
+            } else if (++xfer->chunk_failures > AMVP_CHUNK_RETRIES) {
+                AMVP_LOG_ERR("Chunked upload failed at byte %llu of %d",
+                             (unsigned long long)held, xfer->rsp_len);
+                xfer->state = AMVP_VS_XFER_FAILED;
+                return AMVP_SUCCESS;
+            }
+            xfer->acked = held;
+            return amvp_vs_xfer_start(ctx, multi, xfer, xfer->state);
+        }
+        //Check for code 400, which means we are reuploading a resp and must use PUT instead
+        if (xfer->state == AMVP_VS_XFER_POST && http_code == HTTP_BAD_REQ &&
+                !amvp_is_protocol_error_message(xfer->buf)) {
+            xfer->acked = 0;
+            xfer->chunk_failures = 0;
+            return amvp_vs_xfer_start(ctx, multi, xfer, AMVP_VS_XFER_PUT);
+        }
+        xfer->state = AMVP_VS_XFER_FAILED;
+        return AMVP_SUCCESS;
+
+    case AMVP_VS_XFER_PENDING:
+    case AMVP_VS_XFER_WAIT:
+    case AMVP_VS_XFER_READY:
+    case AMVP_VS_XFER_PROCESSING:
+    case AMVP_VS_XFER_DONE:
+    case AMVP_VS_XFER_FAILED:
+    default:
+        AMVP_LOG_ERR("We should never be here!");
+        return AMVP_TRANSPORT_FAIL;
+    }
+}
+#endif
+
+#if !defined AMVP_OFFLINE && !defined USE_MURL
+typedef struct amvp_vs_order_t {
+    double cost;
+    int index;
+} AMVP_VS_ORDER;
+
+/* Highest cost first, ties in the order received */
+static int amvp_vs_order_cmp(const void *a, const void *b) {
+    const AMVP_VS_ORDER *x = a, *y = b;
+
+    if (x->cost != y->cost) {
+        return x->cost < y->cost ? 1 : -1;
+    }
+    return x->index - y->index;
+}
+
+/*
+ * Reorders the transfers for AMVP_VS_SCHEDULE_COSTLIEST_FIRST. They are
+ * started, and handed to the crypto thread, in array order, so the sets
+ * expected to run longest go first and the cheap ones fill in behind.
+ * Leaves the order alone when the sets can't be matched to estimates.
+ */
+static void amvp_vs_multi_schedule(AMVP_CTX *ctx, AMVP_VS_MULTI *m) {
+    AMVP_VS_ORDER *order = NULL;
+    AMVP_VS_XFER *xfers = NULL;
+    double *costs = NULL;
+    int i;
+
+    costs = calloc(m->count, sizeof(double));
+    order = calloc(m->count, sizeof(AMVP_VS_ORDER));
+    xfers = calloc(m->count, sizeof(AMVP_VS_XFER));
+    if (!costs || !order || !xfers) {
+        goto end;
+    }
+    if (amvp_workload_vs_costs(ctx, m->count, costs) != AMVP_SUCCESS) {
+        AMVP_LOG_WARN("No cost estimates, vector sets will be started in the order received");
+        goto end;
+    }
+    for (i = 0; i < m->count; i++) {
+        order[i].cost = costs[i];
+        order[i].index = i;
+    }
+    qsort(order, m->count, sizeof(AMVP_VS_ORDER), amvp_vs_order_cmp);
+    for (i = 0; i < m->count; i++) {
+        xfers[i] = m->xfers[order[i].index];
+        AMVP_LOG_INFO("Vector set %d, estimated %.1fs: %s", i + 1, order[i].cost, xfers[i].vsid_url);
+    }
+    free(m->xfers);
+    m->xfers = xfers;
+    xfers = NULL;
+end:
+    if (costs) free(costs);
+    if (order) free(order);
+    if (xfers) free(xfers);
+}
+#endif
+
+/*
+ * Sets up the transfers for every vector set in ctx->vsid_url_list.
+ * Nothing is sent until the first amvp_vs_multi_step().
+ */
+AMVP_RESULT amvp_vs_multi_init(AMVP_CTX *ctx, AMVP_VS_PROCESS_CB process_cb, AMVP_VS_MULTI **out) {
+#ifdef AMVP_OFFLINE
+    AMVP_LOG_ERR("Curl not linked, exiting function");
+    return AMVP_TRANSPORT_FAIL;
+#elif defined USE_MURL
+    /* murl has no multi interface, let the caller fall back to serial processing */
+    return AMVP_UNSUPPORTED_OP;
+#else
+    AMVP_RESULT rv = AMVP_SUCCESS;
+    AMVP_STRING_LIST *vs_entry = NULL;
+    AMVP_VS_MULTI *m = NULL;
+    int count = 0, i = 0;
+
+    rv = sanity_check_ctx(ctx);
+    if (AMVP_SUCCESS != rv) return rv;
+
+    if (!process_cb || !out) {
+        AMVP_LOG_ERR("Missing arguments");
+        return AMVP_MISSING_ARG;
+    }
+    *out = NULL;
+
+    vs_entry = ctx->vsid_url_list;
+    while (vs_entry) {
+        count++;
+        vs_entry = vs_entry->next;
+    }
+    if (!count) {
+        return AMVP_MISSING_ARG;
+    }
+
+    m = calloc(1, sizeof(AMVP_VS_MULTI));
+    if (!m) {
+        AMVP_LOG_ERR("Failed to malloc");
+        return AMVP_MALLOC_FAIL;
+    }
+    m->xfers = calloc(count, sizeof(AMVP_VS_XFER));
+    if (!m->xfers) {
+        AMVP_LOG_ERR("Failed to malloc");
+        free(m);
+        return AMVP_MALLOC_FAIL;
+    }
+    vs_entry = ctx->vsid_url_list;
+    for (i = 0; i < count; i++) {
+        m->xfers[i].vsid_url = vs_entry->string;
+        m->xfers[i].metrics = amvp_metrics_vs(ctx, vs_entry->string);
+        vs_entry = vs_entry->next;
+    }
+    m->ctx = ctx;
+    m->count = count;
+    m->remaining = count;
+    m->process_cb = process_cb;
+    if (ctx->vs_schedule == AMVP_VS_SCHEDULE_COSTLIEST_FIRST) {
+        amvp_vs_multi_schedule(ctx, m);
+    }
+
+    m->multi = curl_multi_init();
+    if (!m->multi) {
+        AMVP_LOG_ERR("Error initializing Curl multi handle, stopping");
+        amvp_vs_multi_free(m, NULL);
+        return AMVP_TRANSPORT_FAIL;
+    }
+    curl_multi_setopt(m->multi, CURLMOPT_MAX_TOTAL_CONNECTIONS, (long)ctx->max_transfers);
+#if !defined USE_MURL && LIBCURL_VERSION_NUM >= 0x073600
+    if (ctx->http2) {
+        curl_multi_setopt(m->multi, CURLMOPT_PIPELINING, (long)CURLPIPE_MULTIPLEX);
+    }
+#endif
+
+    if (ctx->pipeline_depth) {
+#ifdef _WIN32
+        AMVP_LOG_WARN("Pipelined processing is not supported on this platform, vector sets will be processed inline");
+#else
+        pthread_mutex_init(&m->lock, NULL);
+        pthread_cond_init(&m->job_cv, NULL);
+        if (pthread_create(&m->tid, NULL, amvp_vs_crypto_main, m)) {
+            AMVP_LOG_ERR("Failed to start crypto thread");
+            pthread_cond_destroy(&m->job_cv);
+            pthread_mutex_destroy(&m->lock);
+            amvp_vs_multi_free(m, NULL);
+            return AMVP_INTERNAL_ERR;
+        }
+        m->depth = ctx->pipeline_depth;
+#endif
+    }
+
+    AMVP_LOG_STATUS("Processing %d vector sets with up to %d concurrent transfers...", count, ctx->max_transfers);
+    if (m->depth) {
+        AMVP_LOG_STATUS("Downloading up to %d vector sets ahead of the one being processed", m->depth);
+    }
+    *out = m;
+    return AMVP_SUCCESS;
+#endif
+}
+
+/*
+ * Does whatever work is ready without waiting: starts new or rescheduled
+ * downloads, lets curl move data on its sockets, and handles finished
+ * requests (which runs process_cb for downloaded vector sets). Sets
+ * *remaining to the number of vector sets not yet done or failed.
+ */
+AMVP_RESULT amvp_vs_multi_step(AMVP_CTX *ctx, AMVP_VS_MULTI *m, int *remaining) {
+#if defined AMVP_OFFLINE || defined USE_MURL
+    return AMVP_UNSUPPORTED_OP;
+#else
+    AMVP_RESULT rv = AMVP_SUCCESS;
+    AMVP_VS_XFER *xfer = NULL;
+    CURLMsg *msg = NULL;
+    CURLcode result = CURLE_OK;
+    CURL *done_hnd = NULL;
+    char *priv = NULL;
+    int running = 0, msgs_left = 0, i = 0, held = 0;
+    time_t now = 0;
+
+    if (!ctx || !m || !remaining) {
+        return AMVP_MISSING_ARG;
+    }
+
+#ifndef _WIN32
+    if (m->depth) {
+        rv = amvp_vs_multi_pump(ctx, m);
+        if (rv != AMVP_SUCCESS) return rv;
+        /* Downloaded sets held in memory: the one being processed plus those queued or in flight */
+        for (i = 0; i < m->count; i++) {
+            switch (m->xfers[i].state) {
+            case AMVP_VS_XFER_GET:
+            case AMVP_VS_XFER_READY:
+            case AMVP_VS_XFER_PROCESSING:
+                held++;
+                break;
+            default:
+                break;
+            }
+        }
     }
+#endif
 
-    snprintf(url, AMVP_ATTR_URL_MAX - 1,
-            "https://%s:%d%s/results",
-            ctx->server_name, ctx->server_port, vsid_url);
+    /* Transfers started below pick up a renewed token */
+    amvp_jwt_renew_check(ctx);
 
-    return amvp_network_action(ctx, AMVP_NET_POST_VS_RESP, url, NULL, 0);
-#endif
-}
+    /* Top up the in-flight downloads with new or rescheduled vector sets */
+    now = time(NULL);
+    for (i = 0; i < m->count && m->active < ctx->max_transfers; i++) {
+        if (m->depth && held > m->depth) {
+            break;
+        }
+        xfer = &m->xfers[i];
+        if (xfer->state == AMVP_VS_XFER_PENDING ||
+                (xfer->state == AMVP_VS_XFER_WAIT && xfer->wake_time <= now)) {
+            rv = amvp_vs_xfer_start(ctx, m->multi, xfer, AMVP_VS_XFER_GET);
+            if (rv != AMVP_SUCCESS) return rv;
+            m->active++;
+            held++;
+        }
+    }
 
-AMVP_RESULT amvp_transport_post(AMVP_CTX *ctx,
-                                const char *uri,
-                                char *data,
-                                int data_len) {
-#ifdef AMVP_OFFLINE 
-    AMVP_LOG_ERR("Curl not linked, exiting function"); 
-    return AMVP_TRANSPORT_FAIL;
-#else
-    AMVP_RESULT rv = 0;
-    char url[AMVP_ATTR_URL_MAX] = {0};
+    if (curl_multi_perform(m->multi, &running) != CURLM_OK) {
+        AMVP_LOG_ERR("Curl multi transfer failed, stopping");
+        return AMVP_TRANSPORT_FAIL;
+    }
 
-    rv = sanity_check_ctx(ctx);
-    if (AMVP_SUCCESS != rv) return rv;
+    while ((msg = curl_multi_info_read(m->multi, &msgs_left))) {
+        if (msg->msg != CURLMSG_DONE) continue;
+        /* msg is invalidated once the handle is removed, so copy what we need */
+        done_hnd = msg->easy_handle;
+        result = msg->data.result;
+        curl_easy_getinfo(done_hnd, CURLINFO_PRIVATE, &priv);
+        xfer = (AMVP_VS_XFER *)priv;
+        m->active--;
 
-    if (!uri) {
-        AMVP_LOG_ERR("Missing endpoint");
-        return AMVP_MISSING_ARG;
+        rv = amvp_vs_xfer_finish(ctx, m, xfer, result);
+        if (rv != AMVP_SUCCESS) return rv;
+
+        switch (xfer->state) {
+        case AMVP_VS_XFER_POST:
+        case AMVP_VS_XFER_PUT:
+            m->active++;
+            break;
+        case AMVP_VS_XFER_FAILED:
+            AMVP_LOG_WARN("Transfer for %s failed, it will be retried on its own", xfer->vsid_url);
+            rv = amvp_append_str_list(&m->failed, xfer->vsid_url);
+            if (rv != AMVP_SUCCESS) return rv;
+            m->remaining--;
+            break;
+        case AMVP_VS_XFER_DONE:
+            m->remaining--;
+            break;
+        case AMVP_VS_XFER_PENDING:
+        case AMVP_VS_XFER_GET:
+        case AMVP_VS_XFER_WAIT:
+        case AMVP_VS_XFER_READY:
+        case AMVP_VS_XFER_PROCESSING:
+        default:
+            break;
+        }
     }
 
-    snprintf(url, AMVP_ATTR_URL_MAX - 1,
-            "https://%s:%d%s",
-            ctx->server_name, ctx->server_port, uri);
+#ifndef _WIN32
+    /* Hand a set that just finished downloading straight to an idle crypto thread */
+    if (m->depth) {
+        rv = amvp_vs_multi_pump(ctx, m);
+        if (rv != AMVP_SUCCESS) return rv;
+    }
+#endif
 
-    return amvp_network_action(ctx, AMVP_NET_POST, url, data, data_len);
+    *remaining = m->remaining;
+    return AMVP_SUCCESS;
 #endif
 }
 
-
 /*
- * This is the top level function used within libamvp to retrieve
- * a KAT vector set from the AMVP server.
+ * Adds the sockets curl is waiting on to the given sets, as
+ * curl_multi_fdset() does. *max_fd is only ever raised.
  */
-AMVP_RESULT amvp_retrieve_vector_set(AMVP_CTX *ctx, char *vsid_url) {
-#ifdef AMVP_OFFLINE 
-    AMVP_LOG_ERR("Curl not linked, exiting function"); 
-    return AMVP_TRANSPORT_FAIL;
+AMVP_RESULT amvp_vs_multi_fdset(AMVP_VS_MULTI *m, fd_set *read_fds, fd_set *write_fds,
+                                fd_set *exc_fds, int *max_fd) {
+#if defined AMVP_OFFLINE || defined USE_MURL
+    return AMVP_UNSUPPORTED_OP;
 #else
-    AMVP_RESULT rv = 0;
-    char url[AMVP_ATTR_URL_MAX] = {0};
+    int fd = -1;
 
-    rv = sanity_check_ctx(ctx);
-    if (AMVP_SUCCESS != rv) return rv;
-
-    if (!vsid_url) {
-        AMVP_LOG_ERR("Missing vsid_url");
+    if (!m || !read_fds || !write_fds || !exc_fds || !max_fd) {
         return AMVP_MISSING_ARG;
     }
-
-    snprintf(url, AMVP_ATTR_URL_MAX - 1,
-            "https://%s:%d%s",
-            ctx->server_name, ctx->server_port, vsid_url);
-
-   AMVP_LOG_STATUS("GET %s", vsid_url);
-
-    return amvp_network_action(ctx, AMVP_NET_GET_VS, url, NULL, 0);
+    if (curl_multi_fdset(m->multi, read_fds, write_fds, exc_fds, &fd) != CURLM_OK) {
+        return AMVP_TRANSPORT_FAIL;
+    }
+    if (fd > *max_fd) {
+        *max_fd = fd;
+    }
+    return AMVP_SUCCESS;
 #endif
 }
 
 /*
- * This is the top level function used within libamvp to retrieve
- * documentation package 
+ * Milliseconds until amvp_vs_multi_step() should be called again even
+ * if none of the sockets become ready: the sooner of curl's own timeout
+ * and the next vector set due for a retry, capped at one second. While
+ * the crypto thread has work the loop checks back every 100ms.
  */
-AMVP_RESULT amvp_retrieve_docs(AMVP_CTX *ctx, char *vsid_url) {
-#ifdef AMVP_OFFLINE 
-    AMVP_LOG_ERR("Curl not linked, exiting function"); 
-    return AMVP_TRANSPORT_FAIL;
+long amvp_vs_multi_timeout(AMVP_VS_MULTI *m) {
+#if defined AMVP_OFFLINE || defined USE_MURL
+    return 0;
 #else
-    AMVP_RESULT rv = 0;
-    char url[AMVP_ATTR_URL_MAX] = {0};
+    long timeout_ms = 1000, curl_ms = -1, wake_ms = 0;
+    time_t now = time(NULL);
+    int i = 0, held = 0, can_start = 0;
 
-    rv = sanity_check_ctx(ctx);
-    if (AMVP_SUCCESS != rv) return rv;
-
-    if (!vsid_url) {
-        AMVP_LOG_ERR("Missing vsid_url");
-        return AMVP_MISSING_ARG;
+    if (!m) {
+        return 0;
     }
+    if (curl_multi_timeout(m->multi, &curl_ms) == CURLM_OK && curl_ms >= 0 && curl_ms < timeout_ms) {
+        timeout_ms = curl_ms;
+    }
+    for (i = 0; i < m->count; i++) {
+        switch (m->xfers[i].state) {
+        case AMVP_VS_XFER_READY:
+        case AMVP_VS_XFER_PROCESSING:
+            if (timeout_ms > AMVP_VS_PIPELINE_POLL_MS) {
+                timeout_ms = AMVP_VS_PIPELINE_POLL_MS;
+            }
+            held++;
+            break;
+        case AMVP_VS_XFER_GET:
+            held++;
+            break;
+        default:
+            break;
+        }
+    }
+    /* Sets that can't be started yet will be once a transfer finishes */
+    can_start = m->active < m->ctx->max_transfers && (!m->depth || held <= m->depth);
+    for (i = 0; i < m->count; i++) {
+        if (m->xfers[i].state == AMVP_VS_XFER_PENDING && can_start) {
+            return 0;
+        }
+        if (m->xfers[i].state == AMVP_VS_XFER_WAIT) {
+            if (m->xfers[i].wake_time <= now) {
+                if (can_start) return 0;
+                continue;
+            }
+            wake_ms = (long)(m->xfers[i].wake_time - now) * 1000;
+            if (wake_ms < timeout_ms) {
+                timeout_ms = wake_ms;
+            }
+        }
+    }
+    return timeout_ms;
+#endif
+}
 
-    snprintf(url, AMVP_ATTR_URL_MAX - 1,
-            "https://%s:%d%s/docs",
-            ctx->server_name, ctx->server_port, vsid_url);
-
+/*
+ * Frees the transfer loop. If failed is given, it takes over the list of
+ * vector sets whose transfers failed at the HTTP level.
+ */
+void amvp_vs_multi_free(AMVP_VS_MULTI *m, AMVP_STRING_LIST **failed) {
+#if !defined AMVP_OFFLINE && !defined USE_MURL
+    AMVP_VS_XFER *xfer = NULL;
+    int i = 0;
 
-    return amvp_network_action(ctx, AMVP_NET_GET_DOCS, url, NULL, 0);
+    if (!m) {
+        return;
+    }
+#ifndef _WIN32
+    if (m->depth) {
+        /* Lets a set still being processed finish first */
+        pthread_mutex_lock(&m->lock);
+        m->shutdown = 1;
+        pthread_cond_signal(&m->job_cv);
+        pthread_mutex_unlock(&m->lock);
+        pthread_join(m->tid, NULL);
+        pthread_cond_destroy(&m->job_cv);
+        pthread_mutex_destroy(&m->lock);
+    }
+#endif
+    for (i = 0; i < m->count; i++) {
+        xfer = &m->xfers[i];
+        if (xfer->hnd) {
+            if (m->multi) curl_multi_remove_handle(m->multi, xfer->hnd);
+            curl_easy_cleanup(xfer->hnd);
+        }
+        if (xfer->slist) curl_slist_free_all(xfer->slist);
+        if (xfer->buf) amvp_mem_free(xfer->buf);
+        if (xfer->rsp) free(xfer->rsp);
+    }
+    if (m->multi) curl_multi_cleanup(m->multi);
+    if (failed) {
+        *failed = m->failed;
+    } else if (m->failed) {
+        amvp_free_str_list(&m->failed);
+    }
+    free(m->xfers);
+    free(m);
+#else
+    (void)m;
+    (void)failed;
 #endif
 }
 
 /*
- * This is the top level function used within libamvp to retrieve
- * It can be used to get the results for an entire session, or
- * more specifically for a vectorSet
+ * Downloads, processes and uploads the responses for every vector set
+ * in ctx->vsid_url_list with up to ctx->max_transfers requests in flight
+ * at once, using the curl multi interface. Vector sets are still
+ * processed one at a time via process_cb; on the calling thread, or
+ * with ctx->pipeline_depth set, on a crypto thread that runs alongside
+ * the transfers.
+ *
+ * Vector sets whose transfers fail at the HTTP level are returned in
+ * \p failed (in list order) so the caller can retry them serially.
  */
-AMVP_RESULT amvp_retrieve_vector_set_result(AMVP_CTX *ctx, const char *api_url) {
-#ifdef AMVP_OFFLINE 
-    AMVP_LOG_ERR("Curl not linked, exiting function"); 
+AMVP_RESULT amvp_transport_process_vector_sets(AMVP_CTX *ctx,
+                                               AMVP_VS_PROCESS_CB process_cb,
+                                               AMVP_STRING_LIST **failed) {
+#ifdef AMVP_OFFLINE
+    AMVP_LOG_ERR("Curl not linked, exiting function");
     return AMVP_TRANSPORT_FAIL;
+#elif defined USE_MURL
+    /* murl has no multi interface, let the caller fall back to serial processing */
+    return AMVP_UNSUPPORTED_OP;
 #else
-    AMVP_RESULT rv = 0;
-    char url[AMVP_ATTR_URL_MAX] = {0};
-
-    rv = sanity_check_ctx(ctx);
-    if (AMVP_SUCCESS != rv) return rv;
+    AMVP_RESULT rv = AMVP_SUCCESS;
+    AMVP_VS_MULTI *m = NULL;
+    int remaining = 0;
 
-    if (!api_url) {
-        AMVP_LOG_ERR("Missing api_url");
+    if (!failed) {
+        AMVP_LOG_ERR("Missing arguments");
         return AMVP_MISSING_ARG;
     }
 
-    snprintf(url, AMVP_ATTR_URL_MAX - 1,
-            "https://%s:%d%s/results",
-            ctx->server_name, ctx->server_port, api_url);
+    rv = amvp_vs_multi_init(ctx, process_cb, &m);
+    if (rv != AMVP_SUCCESS) return rv;
 
-    return amvp_network_action(ctx, AMVP_NET_GET_VS_RESULT, url, NULL, 0);
+    while (1) {
+        rv = amvp_vs_multi_step(ctx, m, &remaining);
+        if (rv != AMVP_SUCCESS || !remaining) break;
+        /* Wake up at least once a second to check on vector sets waiting for a retry */
+#if LIBCURL_VERSION_NUM >= 0x074400
+        /* The crypto thread interrupts this with curl_multi_wakeup() */
+        curl_multi_poll(m->multi, NULL, 0, (int)amvp_vs_multi_timeout(m), NULL);
+#else
+        curl_multi_wait(m->multi, NULL, 0, (int)amvp_vs_multi_timeout(m), NULL);
 #endif
-}
+    }
 
-AMVP_RESULT amvp_retrieve_expected_result(AMVP_CTX *ctx, const char *api_url) {
-#ifdef AMVP_OFFLINE 
-    AMVP_LOG_ERR("Curl not linked, exiting function"); 
-    return AMVP_TRANSPORT_FAIL;
-#else
-    AMVP_RESULT rv = 0;
-    char url[AMVP_ATTR_URL_MAX + 1] = {0};
+    amvp_vs_multi_free(m, failed);
+    return rv;
+#endif
+}
 
-    rv = sanity_check_ctx(ctx);
-    if (AMVP_SUCCESS != rv) return rv;
+#if !defined AMVP_OFFLINE && !defined USE_MURL
+/*
+ * One page of a listing being downloaded by amvp_transport_get_pages().
+ */
+typedef struct amvp_page_xfer_t {
+    CURL *hnd;
+    struct curl_slist *slist;
+    char url[AMVP_ATTR_URL_MAX + 1];
+    AMVP_HTTP_VALIDATORS validators;
+    char *buf;
+    int buf_len;
+    int buf_size;
+    int in_flight;
+    int complete;
+    CURLcode result;
+} AMVP_PAGE_XFER;
+
+static size_t amvp_page_xfer_write_callback(void *ptr, size_t size, size_t nmemb, void *userdata) {
+    AMVP_PAGE_XFER *xfer = (AMVP_PAGE_XFER *)userdata;
 
-    if (!api_url) {
-        AMVP_LOG_ERR("Missing api_url");
-        return AMVP_MISSING_ARG;
+    if (size != 1) {
+        fprintf(stderr, "\ncurl size not 1\n");
+        return 0;
     }
 
-    snprintf(url, AMVP_ATTR_URL_MAX,
-            "https://%s:%d%s/expected",
-            ctx->server_name, ctx->server_port, api_url);
-
-    return amvp_network_action(ctx, AMVP_NET_GET_VS_SAMPLE, url, NULL, 0);
-#endif
+    return amvp_curl_buf_append(&xfer->buf, &xfer->buf_len, &xfer->buf_size,
+                                xfer->hnd, ptr, nmemb);
 }
 
-AMVP_RESULT amvp_transport_put(AMVP_CTX *ctx,
-                               const char *endpoint,
-                               const char *data,
-                               int data_len) {
-#ifdef AMVP_OFFLINE 
-    AMVP_LOG_ERR("Curl not linked, exiting function"); 
-    return AMVP_TRANSPORT_FAIL;
-#else
-    AMVP_RESULT rv = 0;
-    char url[AMVP_ATTR_URL_MAX] = {0};
+static AMVP_RESULT amvp_page_xfer_start(AMVP_CTX *ctx, CURLM *multi, AMVP_PAGE_XFER *xfer, const char *path) {
+    CURLcode crv = CURLE_OK;
 
-    rv = sanity_check_ctx(ctx);
-    if (AMVP_SUCCESS != rv) return rv;
+    snprintf(xfer->url, AMVP_ATTR_URL_MAX, "https://%s:%d%s",
+             ctx->server_name, ctx->server_port, path);
+    xfer->slist = amvp_add_auth_hdr(ctx, xfer->slist);
 
-    if (!endpoint) {
-        AMVP_LOG_ERR("Missing endpoint");
-        return AMVP_MISSING_ARG;
+    xfer->hnd = curl_easy_init();
+    if (!xfer->hnd) { AMVP_LOG_ERR("Error initializing Curl structure, stopping"); return AMVP_TRANSPORT_FAIL; }
+    if (amvp_curl_setup_handle(ctx, xfer->hnd, xfer->url, xfer->slist,
+                               amvp_page_xfer_write_callback, xfer) != AMVP_SUCCESS) {
+        return AMVP_TRANSPORT_FAIL;
     }
+    if (ctx->meta_cache) {
+        curl_easy_setopt(xfer->hnd, CURLOPT_HEADERFUNCTION, amvp_curl_header_callback);
+        curl_easy_setopt(xfer->hnd, CURLOPT_HEADERDATA, &xfer->validators);
+    }
+    crv = curl_easy_setopt(xfer->hnd, CURLOPT_PRIVATE, xfer);
+    if (crv) { AMVP_LOG_ERR("Error setting curl option CURLOPT_PRIVATE, stopping"); return AMVP_TRANSPORT_FAIL; }
 
-    snprintf(url, AMVP_ATTR_URL_MAX - 1,
-            "https://%s:%d%s",
-            ctx->server_name, ctx->server_port, endpoint);
-
-    return amvp_network_action(ctx, AMVP_NET_PUT_VALIDATION, url, data, data_len);
-#endif
+    if (curl_multi_add_handle(multi, xfer->hnd) != CURLM_OK) {
+        AMVP_LOG_ERR("Error adding transfer to Curl multi handle, stopping");
+        return AMVP_TRANSPORT_FAIL;
+    }
+    xfer->in_flight = 1;
+    AMVP_LOG_VERBOSE("GET %s", xfer->url);
+    return AMVP_SUCCESS;
 }
+#endif
 
-AMVP_RESULT amvp_transport_delete(AMVP_CTX *ctx,
-                               const char *endpoint) {
+/*
+ * Downloads the pages of a listing at \p urls (paths on the server) with
+ * up to ctx->max_transfers requests in flight, over the context's shared
+ * connections. Each page is handed to \p page_cb in ctx->curl_buf, in
+ * order, as soon as it and the pages before it have arrived; once
+ * page_cb sets *done, the pages still outstanding are abandoned.
+ */
+AMVP_RESULT amvp_transport_get_pages(AMVP_CTX *ctx,
+                                     char **urls,
+                                     int count,
+                                     AMVP_PAGE_CB page_cb,
+                                     void *arg) {
 #ifdef AMVP_OFFLINE
     AMVP_LOG_ERR("Curl not linked, exiting function");
     return AMVP_TRANSPORT_FAIL;
+#elif defined USE_MURL
+    /* murl has no multi interface, fetch them one at a time */
+    AMVP_RESULT rv = AMVP_SUCCESS;
+    int i = 0, done = 0;
+
+    for (i = 0; i < count && !done; i++) {
+        rv = amvp_transport_get(ctx, urls[i], NULL);
+        if (rv != AMVP_SUCCESS) return rv;
+        rv = page_cb(ctx, urls[i], arg, &done);
+        if (rv != AMVP_SUCCESS) return rv;
+    }
+    return AMVP_SUCCESS;
 #else
-    AMVP_RESULT rv = 0;
-    char url[AMVP_ATTR_URL_MAX] = {0};
+    AMVP_RESULT rv = AMVP_SUCCESS;
+    AMVP_PAGE_XFER *xfers = NULL, *xfer = NULL;
+    CURLM *multi = NULL;
+    CURLMsg *msg = NULL;
+    long http_code = 0;
+    char *tmp = NULL;
+    void *priv = NULL;
+    int started = 0, processed = 0, running = 0, msgs_left = 0, done = 0, tmp_size = 0, i = 0;
 
     rv = sanity_check_ctx(ctx);
     if (AMVP_SUCCESS != rv) return rv;
-
-    if (!endpoint) {
-        AMVP_LOG_ERR("Missing endpoint");
+    if (!urls || count <= 0 || !page_cb) {
+        AMVP_LOG_ERR("Missing arguments");
         return AMVP_MISSING_ARG;
     }
 
-    snprintf(url, AMVP_ATTR_URL_MAX - 1,
-            "https://%s:%d%s",
-            ctx->server_name, ctx->server_port, endpoint);
+    xfers = calloc(count, sizeof(AMVP_PAGE_XFER));
+    if (!xfers) {
+        AMVP_LOG_ERR("Failed to malloc");
+        return AMVP_MALLOC_FAIL;
+    }
+    multi = curl_multi_init();
+    if (!multi) {
+        AMVP_LOG_ERR("Error initializing Curl multi handle, stopping");
+        rv = AMVP_TRANSPORT_FAIL;
+        goto end;
+    }
+    curl_multi_setopt(multi, CURLMOPT_MAX_TOTAL_CONNECTIONS, (long)ctx->max_transfers);
 
-    return amvp_network_action(ctx, AMVP_NET_DELETE, url, NULL, 0);
+    while (processed < count) {
+        amvp_jwt_renew_check(ctx);
+        /* Stay at most max_transfers pages ahead of the matching */
+        while (started < count && started - processed < ctx->max_transfers) {
+            rv = amvp_page_xfer_start(ctx, multi, &xfers[started], urls[started]);
+            if (rv != AMVP_SUCCESS) goto end;
+            started++;
+        }
+
+        if (curl_multi_perform(multi, &running) != CURLM_OK) {
+            AMVP_LOG_ERR("Curl multi transfer failed, stopping");
+            rv = AMVP_TRANSPORT_FAIL;
+            goto end;
+        }
+        while ((msg = curl_multi_info_read(multi, &msgs_left))) {
+            if (msg->msg != CURLMSG_DONE) continue;
+            curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, &priv);
+            xfer = (AMVP_PAGE_XFER *)priv;
+            xfer->result = msg->data.result;
+            xfer->complete = 1;
+        }
+
+        /* Hand over the pages that have arrived, in order */
+        while (processed < count && xfers[processed].complete) {
+            xfer = &xfers[processed];
+            http_code = 0;
+            curl_easy_getinfo(xfer->hnd, CURLINFO_RESPONSE_CODE, &http_code);
+            curl_multi_remove_handle(multi, xfer->hnd);
+            xfer->in_flight = 0;
+            if (xfer->result != CURLE_OK || http_code != HTTP_OK) {
+                AMVP_LOG_ERR("Unable to download %s (%ld: %s)", urls[processed], http_code,
+                             curl_easy_strerror(xfer->result));
+                rv = AMVP_TRANSPORT_FAIL;
+                goto end;
+            }
+
+            /* Swap the page into curl_buf, as if it was fetched with amvp_transport_get() */
+            tmp = ctx->curl_buf;
+            tmp_size = ctx->curl_buf_size;
+            ctx->curl_buf = xfer->buf;
+            ctx->curl_buf_size = xfer->buf_size;
+            ctx->curl_read_ctr = xfer->buf_len;
+            xfer->buf = tmp;
+            xfer->buf_size = tmp_size;
+            ctx->http_validators = xfer->validators;
+
+            processed++;
+            rv = page_cb(ctx, urls[processed - 1], arg, &done);
+            if (rv != AMVP_SUCCESS || done) goto end;
+        }
+
+        if (processed < count) {
+#if LIBCURL_VERSION_NUM >= 0x074400
+            curl_multi_poll(multi, NULL, 0, 1000, NULL);
+#else
+            curl_multi_wait(multi, NULL, 0, 1000, NULL);
+#endif
+        }
+    }
+
+end:
+    for (i = 0; i < started; i++) {
+        xfer = &xfers[i];
+        if (xfer->hnd) {
+            if (xfer->in_flight) curl_multi_remove_handle(multi, xfer->hnd);
+            curl_easy_cleanup(xfer->hnd);
+        }
+        if (xfer->slist) curl_slist_free_all(xfer->slist);
+        if (xfer->buf) amvp_mem_free(xfer->buf);
+    }
+    if (multi) curl_multi_cleanup(multi);
+    free(xfers);
+    return rv;
 #endif
 }
 
@@ -1003,6 +3163,9 @@ static AMVP_RESULT inspect_http_code(AMVP_CTX *ctx, int code) {
     if (code == HTTP_OK) {
         /* 200 */
         return AMVP_SUCCESS;
+    } else if (code == HTTP_NOT_MODIFIED && (ctx->http_if_none_match || ctx->http_if_modified_since)) {
+        /* 304, the caller has the resource cached */
+        return AMVP_SUCCESS;
     } else if (amvp_is_protocol_error_message(ctx->curl_buf)) {
         return AMVP_PROTOCOL_RSP_ERR; /* Let the caller parse the error */
     }
@@ -1064,6 +3227,23 @@ end:
     return result;
 }
 
+static const char *amvp_net_method(AMVP_NET_ACTION action) {
+    switch (action) {
+    case AMVP_NET_PUT:
+    case AMVP_NET_PUT_VALIDATION:
+        return "PUT";
+    case AMVP_NET_DELETE:
+        return "DELETE";
+    case AMVP_NET_POST:
+    case AMVP_NET_POST_LOGIN:
+    case AMVP_NET_POST_REG:
+    case AMVP_NET_POST_VS_RESP:
+        return "POST";
+    default:
+        return "GET";
+    }
+}
+
 static AMVP_RESULT execute_network_action(AMVP_CTX *ctx,
                                           AMVP_NET_ACTION action,
                                           const char *url,
@@ -1076,8 +3256,15 @@ static AMVP_RESULT execute_network_action(AMVP_CTX *ctx,
     char large_url[AMVP_ATTR_URL_MAX + 1] = {0};
     int large_submission = 0;
 #endif
-    int resp_len = 0;
+    int resp_len = 0, sent_len = 0;
     int rc = 0;
+    double start = 0;
+
+    if (action != AMVP_NET_POST_LOGIN) {
+        amvp_jwt_renew_check(ctx);
+    }
+    start = ctx->metrics ? amvp_metrics_now() : 0;
+    AMVP_TRACE2(http__start, action, url);
 
     switch(action) {
     case AMVP_NET_GET:
@@ -1100,14 +3287,18 @@ static AMVP_RESULT execute_network_action(AMVP_CTX *ctx,
         break;
 
     case AMVP_NET_POST_VS_RESP:
-        resp = json_serialize_to_string(ctx->kat_resp, &resp_len);
-        if (!resp) {
-            AMVP_LOG_ERR("Failed to post vector set responses");
-            return AMVP_JSON_ERR;
+        if (!ctx->rsp_slice && !amvp_vs_rsp_streams_tree(ctx) &&
+            !amvp_vs_rsp_streams_spill(ctx)) {
+            amvp_kat_resp_serialize(ctx, &resp, &resp_len);
+            if (!resp) {
+                AMVP_LOG_ERR("Failed to post vector set responses");
+                AMVP_TRACE3(http__done, action, 0, AMVP_JSON_ERR);
+                return AMVP_JSON_ERR;
+            }
         }
 
 #ifdef AMVP_DEPRECATED
-        if (ctx->post_size_constraint && resp_len > ctx->post_size_constraint) {
+        if (resp && ctx->post_size_constraint && resp_len > ctx->post_size_constraint) {
             /* Determine if this POST body goes over the "constraint" */
             large_submission = 1;
         }
@@ -1121,14 +3312,10 @@ static AMVP_RESULT execute_network_action(AMVP_CTX *ctx,
             if (result != AMVP_SUCCESS) goto end;
 
             rc = amvp_curl_http_post(ctx, large_url, resp, resp_len);
+            sent_len = resp_len;
         } else {
 #endif
-            rc = amvp_curl_http_post(ctx, url, resp, resp_len);
-            //Check for code 400, which means we are reuploading a resp and must use PUT instead
-            result = inspect_http_code(ctx, rc);
-            if (result == AMVP_UNSUPPORTED_OP) {
-                rc = amvp_curl_http_put(ctx, url, resp, resp_len);
-            }
+            rc = amvp_curl_http_send_vs_rsp(ctx, url, resp, resp_len, &sent_len);
 #ifdef AMVP_DEPRECATED
         }
 #endif
@@ -1138,6 +3325,7 @@ static AMVP_RESULT execute_network_action(AMVP_CTX *ctx,
         break;
     default:
         AMVP_LOG_ERR("Unknown AMVP_NET_ACTION");
+        AMVP_TRACE3(http__done, action, 0, AMVP_INVALID_ARG);
         return AMVP_INVALID_ARG;
     }
 
@@ -1192,12 +3380,7 @@ static AMVP_RESULT execute_network_action(AMVP_CTX *ctx,
                     rc = amvp_curl_http_post(ctx, large_url, resp, resp_len);
                 } else {
 #endif
-                    rc = amvp_curl_http_post(ctx, url, resp, resp_len);
-                    //Check for code 400, which means we are reuploading a resp and must use PUT instead
-                    result = inspect_http_code(ctx, rc);
-                    if (result == AMVP_UNSUPPORTED_OP) {
-                        rc = amvp_curl_http_put(ctx, url, resp, resp_len);
-                    }
+                    rc = amvp_curl_http_send_vs_rsp(ctx, url, resp, resp_len, &sent_len);
 #ifdef AMVP_DEPRECATED
                 }
 #endif
@@ -1231,7 +3414,19 @@ static AMVP_RESULT execute_network_action(AMVP_CTX *ctx,
     result = AMVP_SUCCESS;
 
 end:
-    if (resp) json_free_serialized_string(resp);
+    AMVP_TRACE3(http__done, action, rc, result);
+    /* Only vector set requests are made while ctx->metrics->net is set */
+    if (action == AMVP_NET_GET) {
+        amvp_metrics_net(ctx, 0, start, 0, ctx->curl_read_ctr);
+    } else if (action == AMVP_NET_POST_VS_RESP) {
+        amvp_metrics_net(ctx, 1, start, sent_len, ctx->curl_read_ctr);
+    }
+    if (ctx->metrics) {
+        amvp_curl_trace(ctx, action == AMVP_NET_GET || action == AMVP_NET_POST_VS_RESP ?
+                             amvp_metrics_get_net(ctx) : NULL, ctx->curl_hnd,
+                        amvp_net_method(action), url);
+    }
+    if (resp) free(resp);
 
     *curl_code = rc;
 
@@ -1308,6 +3503,8 @@ static void log_network_status(AMVP_CTX *ctx,
 
     if (curl_code == 0) {
         AMVP_LOG_ERR("Received no response from server.");
+    } else if (curl_code == HTTP_NOT_MODIFIED && (ctx->http_if_none_match || ctx->http_if_modified_since)) {
+        AMVP_LOG_VERBOSE("Cached copy of %s is current", url);
     } else if (curl_code < 200 || curl_code >= 300) {
         AMVP_LOG_ERR("%d error received from server. Message:", curl_code);
         AMVP_LOG_ERR("%s", ctx->curl_buf);
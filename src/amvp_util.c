@@ -13,10 +13,22 @@
 #include <string.h>
 #include <stdarg.h>
 #include <ctype.h>
+#include <limits.h>
 #include "amvp.h"
 #include "amvp_lcl.h"
 #include "amvp_error.h"
 #include "safe_lib.h"
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+/* SSE2 and NEON are baseline on x86_64 and aarch64, see amvp_hex_encode() */
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define AMVP_HEX_SSE2 1
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define AMVP_HEX_NEON 1
+#endif
 
 #ifdef USE_MURL
 #include "murl.h"
@@ -38,31 +50,38 @@ void amvp_log_msg(AMVP_CTX *ctx, AMVP_LOG_LVL level, const char *func, int line,
     char tmp[AMVP_LOG_MAX_MSG_LEN + 1];
     tmp[AMVP_LOG_MAX_MSG_LEN] = '\0';
 
-    if (!ctx) {
+    if (!ctx || (!ctx->test_progress_cb && !ctx->log_sink) || ctx->log_lvl < level) {
         return;
     }
 
+    if (ctx->log_sink) {
+        va_start(arguments, fmt);
+        ret = amvp_log_sink_put(ctx, level, func, line, fmt, arguments);
+        va_end(arguments);
+        if (ret) {
+            return;
+        }
+    }
+
     if (ctx->debug) {
         iter = snprintf(tmp, AMVP_LOG_MAX_MSG_LEN, "[%s:%d]: ", func, line);
     }
 
-    if (ctx->test_progress_cb && (ctx->log_lvl >= level)) {
-        /*  Pull the arguments from the stack and invoke the logger function */
-        va_start(arguments, fmt);
-        ret = vsnprintf(tmp + iter, AMVP_LOG_MAX_MSG_LEN + 1 - iter, fmt, arguments);
-        if (ret < 0 || ret >= AMVP_LOG_MAX_MSG_LEN + 1 - iter) {
-            memcpy_s(tmp + AMVP_LOG_MAX_MSG_LEN - AMVP_LOG_TRUNCATED_STR_LEN,
-                     AMVP_LOG_TRUNCATED_STR_LEN,
-                     AMVP_LOG_TRUNCATED_STR, AMVP_LOG_TRUNCATED_STR_LEN);
-            tmp[AMVP_LOG_MAX_MSG_LEN] = '\0';
-        } else {
-            iter += ret;
-            tmp[iter] = '\0';
-        }
-        ctx->test_progress_cb(tmp, level);
-        va_end(arguments);
-        fflush(stdout);
+    /*  Pull the arguments from the stack and invoke the logger function */
+    va_start(arguments, fmt);
+    ret = vsnprintf(tmp + iter, AMVP_LOG_MAX_MSG_LEN + 1 - iter, fmt, arguments);
+    if (ret < 0 || ret >= AMVP_LOG_MAX_MSG_LEN + 1 - iter) {
+        memcpy_s(tmp + AMVP_LOG_MAX_MSG_LEN - AMVP_LOG_TRUNCATED_STR_LEN,
+                 AMVP_LOG_TRUNCATED_STR_LEN,
+                 AMVP_LOG_TRUNCATED_STR, AMVP_LOG_TRUNCATED_STR_LEN);
+        tmp[AMVP_LOG_MAX_MSG_LEN] = '\0';
+    } else {
+        iter += ret;
+        tmp[iter] = '\0';
     }
+    ctx->test_progress_cb(tmp, level);
+    va_end(arguments);
+    fflush(stdout);
 }
 
 /*
@@ -71,6 +90,11 @@ void amvp_log_msg(AMVP_CTX *ctx, AMVP_LOG_LVL level, const char *func, int line,
  */
 void amvp_log_newline(AMVP_CTX *ctx) {
      char tmp[] = "\n";
+
+     if (ctx->log_sink) {
+         amvp_log_msg(ctx, AMVP_LOG_LVL_STATUS, __func__, __LINE__, "%s", tmp);
+         return;
+     }
      ctx->test_progress_cb(tmp, AMVP_LOG_LVL_STATUS);
  }
 
@@ -109,23 +133,97 @@ AMVP_RESULT amvp_cleanup(AMVP_CTX *ctx) {
 
 /*
  * This function is used to locate the callback function that's needed
- * when a particular crypto operation is needed by libamvp.
+ * when a particular crypto operation is needed by libamvp. Caps are
+ * looked up directly in ctx->caps_tbl, which amvp_cap_list_append()
+ * keeps in step with ctx->caps_list.
  */
 AMVP_CAPS_LIST *amvp_locate_cap_entry(AMVP_CTX *ctx, AMVP_CIPHER cipher) {
-    AMVP_CAPS_LIST *cap;
-
-    if (!ctx || !ctx->caps_list) {
+    if (!ctx || cipher <= AMVP_CIPHER_START || cipher >= AMVP_CIPHER_END) {
         return NULL;
     }
 
-    cap = ctx->caps_list;
-    while (cap) {
-        if (cap->cipher == cipher) {
-            return cap;
+    return ctx->caps_tbl[cipher];
+}
+
+#if defined __GNUC__
+#define AMVP_CAP_REFS(store) __atomic_load_n(&(store)->refs, __ATOMIC_ACQUIRE)
+#define AMVP_CAP_REFS_ADD(store, n) __atomic_add_fetch(&(store)->refs, (n), __ATOMIC_ACQ_REL)
+#else
+#define AMVP_CAP_REFS(store) ((store)->refs)
+#define AMVP_CAP_REFS_ADD(store, n) ((store)->refs += (n))
+#endif
+
+/*
+ * Returns 1 if ctx's capabilities are shared with a clone, see
+ * amvp_ctx_clone(). They can't be changed until only one context is left.
+ */
+int amvp_cap_store_shared(AMVP_CTX *ctx) {
+    return ctx && ctx->cap_store && AMVP_CAP_REFS(ctx->cap_store) > 1;
+}
+
+/*
+ * The arena capability memory of ctx comes from, created on first use.
+ * NULL if it can't be created or the capabilities are shared.
+ */
+AMVP_ARENA *amvp_cap_arena(AMVP_CTX *ctx) {
+    if (!ctx) {
+        return NULL;
+    }
+    if (amvp_cap_store_shared(ctx)) {
+        AMVP_LOG_ERR("Capabilities are shared with a cloned context and can't be changed");
+        return NULL;
+    }
+    if (!ctx->cap_store) {
+        ctx->cap_store = calloc(1, sizeof(AMVP_CAP_STORE));
+        if (!ctx->cap_store) {
+            return NULL;
         }
-        cap = cap->next;
+        ctx->cap_store->refs = 1;
     }
-    return NULL;
+    return &ctx->cap_store->arena;
+}
+
+/*
+ * Zeroed capability memory, released with the rest of the
+ * capabilities by amvp_cap_store_release()
+ */
+void *amvp_cap_alloc(AMVP_CTX *ctx, size_t size) {
+    return amvp_arena_alloc(amvp_cap_arena(ctx), size);
+}
+
+/*
+ * Gives dst the capabilities of src, which must not have any yet
+ */
+void amvp_cap_store_share(AMVP_CTX *src, AMVP_CTX *dst) {
+    if (!src || !dst || !src->cap_store) {
+        return;
+    }
+    AMVP_CAP_REFS_ADD(src->cap_store, 1);
+    dst->cap_store = src->cap_store;
+    dst->caps_list = src->caps_list;
+    memcpy_s(dst->caps_tbl, sizeof(dst->caps_tbl), src->caps_tbl, sizeof(src->caps_tbl));
+    dst->vs_count = src->vs_count;
+}
+
+/*
+ * Drops ctx's capabilities. The memory behind them is freed in one go
+ * once no other context shares it.
+ */
+void amvp_cap_store_release(AMVP_CTX *ctx) {
+    AMVP_CAP_STORE *store = NULL;
+
+    if (!ctx) {
+        return;
+    }
+    store = ctx->cap_store;
+    if (store && AMVP_CAP_REFS_ADD(store, -1) == 0) {
+        amvp_arena_free(&store->arena);
+        free(store);
+    }
+    ctx->cap_store = NULL;
+    ctx->caps_list = NULL;
+    memzero_s(ctx->caps_tbl, sizeof(ctx->caps_tbl));
+    ctx->vs_count = 0;
 }
 
 /*
@@ -197,10 +295,147 @@ const char *amvp_lookup_alt_revision_string(AMVP_REVISION rev) {
     return NULL;
 }
 
+/*
+ * Hash index over alg_tbl keyed on (algorithm, mode). It is built once,
+ * the first time a context is created, so that dispatching a vector set
+ * and looking up its cipher doesn't have to strcmp its way through the
+ * whole table. Each alg_tbl entry is stored under its (name, mode) key
+ * when it has a mode, and the first entry for every name is also stored
+ * under (name, NULL) to match the old linear scans, which took the first
+ * name match when no mode was given.
+ */
+#define AMVP_ALG_INDEX_SIZE 512 /* Power of 2, keep well above 2 * AMVP_ALG_MAX */
+
+typedef struct amvp_alg_index_slot_t {
+    short idx;      /* alg_tbl index + 1, 0 is an empty slot */
+    short moded;    /* 1 if keyed on (name, mode), 0 if on (name, NULL) */
+} AMVP_ALG_INDEX_SLOT;
+
+static AMVP_ALG_INDEX_SLOT alg_index[AMVP_ALG_INDEX_SIZE];
+#ifndef _WIN32
+static pthread_once_t alg_index_once = PTHREAD_ONCE_INIT;
+#else
+static int alg_index_built = 0;
+#endif
+
+/* FNV-1a over the name, a separator, and the mode if there is one */
+static unsigned int amvp_alg_index_hash(const char *name, const char *mode) {
+    unsigned int h = 2166136261u;
+    int i;
+
+    for (i = 0; i < AMVP_ALG_NAME_MAX && name[i]; i++) {
+        h = (h ^ (unsigned char)name[i]) * 16777619u;
+    }
+    h = (h ^ 0xff) * 16777619u;
+    if (mode) {
+        for (i = 0; i < AMVP_ALG_MODE_MAX && mode[i]; i++) {
+            h = (h ^ (unsigned char)mode[i]) * 16777619u;
+        }
+    }
+    return h;
+}
+
+static int amvp_alg_index_match(const AMVP_ALG_HANDLER *entry, const char *name, const char *mode) {
+    int diff = 1;
+
+    if (!entry->name) {
+        return 0;
+    }
+    strcmp_s(entry->name, AMVP_ALG_NAME_MAX, name, &diff);
+    if (diff) {
+        return 0;
+    }
+    if (!mode) {
+        return 1;
+    }
+    if (!entry->mode) {
+        return 0;
+    }
+    strcmp_s(entry->mode, AMVP_ALG_MODE_MAX, mode, &diff);
+    return !diff;
+}
+
+/* Find the slot holding the key, or the empty slot where it would go */
+static int amvp_alg_index_slot(const char *name, const char *mode) {
+    unsigned int pos = amvp_alg_index_hash(name, mode) & (AMVP_ALG_INDEX_SIZE - 1);
+    int probes;
+
+    for (probes = 0; probes < AMVP_ALG_INDEX_SIZE; probes++) {
+        AMVP_ALG_INDEX_SLOT *slot = &alg_index[pos];
+
+        if (!slot->idx) {
+            return (int)pos;
+        }
+        if (slot->moded == (mode != NULL) &&
+            amvp_alg_index_match(&alg_tbl[slot->idx - 1], name, mode)) {
+            return (int)pos;
+        }
+        pos = (pos + 1) & (AMVP_ALG_INDEX_SIZE - 1);
+    }
+    return -1;
+}
+
+static void amvp_alg_index_build(void) {
+    int i, slot;
+
+    for (i = 0; i < AMVP_ALG_MAX; i++) {
+        if (!alg_tbl[i].name) {
+            continue;
+        }
+        slot = amvp_alg_index_slot(alg_tbl[i].name, NULL);
+        if (slot >= 0 && !alg_index[slot].idx) {
+            alg_index[slot].idx = (short)(i + 1);
+            alg_index[slot].moded = 0;
+        }
+        if (alg_tbl[i].mode) {
+            slot = amvp_alg_index_slot(alg_tbl[i].name, alg_tbl[i].mode);
+            if (slot >= 0 && !alg_index[slot].idx) {
+                alg_index[slot].idx = (short)(i + 1);
+                alg_index[slot].moded = 1;
+            }
+        }
+    }
+}
+
+void amvp_alg_index_init(void) {
+#ifndef _WIN32
+    pthread_once(&alg_index_once, amvp_alg_index_build);
+#else
+    if (!alg_index_built) {
+        amvp_alg_index_build();
+        alg_index_built = 1;
+    }
+#endif
+}
+
 /**
- * @brief Loop through all entries in alg_tbl, trying to match
- *        \p algorithm to each name field. If successful, will
- *        return the AMVP_CIPHER id field.
+ * @brief Find the alg_tbl entry for \p algorithm and \p mode.
+ *
+ * If \p mode is NULL, the first entry with a matching name is
+ * returned, whether or not it has a mode.
+ *
+ * @return index into alg_tbl
+ * @return -1 if no-match
+ */
+int amvp_lookup_alg_tbl_index(const char *algorithm, const char *mode) {
+    int slot;
+
+    if (!algorithm) {
+        return -1;
+    }
+    amvp_alg_index_init();
+
+    slot = amvp_alg_index_slot(algorithm, mode);
+    if (slot < 0 || !alg_index[slot].idx) {
+        return -1;
+    }
+    return alg_index[slot].idx - 1;
+}
+
+/**
+ * @brief Find the alg_tbl entry whose name field matches
+ *        \p algorithm. If successful, will return the
+ *        AMVP_CIPHER id field.
  *
  * IMPORTANT: This only works accurately for algorithms that have
  * a 1:1 name to id entry. I.e. does not work for algorithms that
@@ -211,31 +446,18 @@ const char *amvp_lookup_alt_revision_string(AMVP_REVISION rev) {
  * @return 0 if no-match
  */
 AMVP_CIPHER amvp_lookup_cipher_index(const char *algorithm) {
-    int i = 0;
+    int i = amvp_lookup_alg_tbl_index(algorithm, NULL);
 
-    if (!algorithm) {
+    if (i < 0) {
         return 0;
     }
-
-    for (i = 0; i < AMVP_ALG_MAX; i++) {
-        int diff = 1;
-
-        strcmp_s(alg_tbl[i].name,
-                 AMVP_ALG_NAME_MAX,
-                 algorithm, &diff);
-
-        if (!diff) {
-            return alg_tbl[i].cipher;
-        }
-    }
-
-    return 0;
+    return alg_tbl[i].cipher;
 }
 
 /**
- * @brief Loop through all entries in alg_tbl, trying to match
- *        both \p algorithm and \p mode to their respective fields.
- *        If successful, will return the AMVP_CIPHER id field.
+ * @brief Find the alg_tbl entry matching both \p algorithm and
+ *        \p mode to their respective fields. If successful, will
+ *        return the AMVP_CIPHER id field.
  *
  * Useful for algorithms that have multiple modes (i.e. asymmetric).
  *
@@ -250,27 +472,11 @@ AMVP_CIPHER amvp_lookup_cipher_w_mode_index(const char *algorithm,
         return 0;
     }
 
-    for (i = 0; i < AMVP_ALG_MAX; i++) {
-        int diff = 0;
-
-        if (alg_tbl[i].mode == NULL) continue;
-
-        /* Compare the algorithm string */
-        strcmp_s(alg_tbl[i].name,
-                 AMVP_ALG_NAME_MAX,
-                 algorithm, &diff);
-
-        if (!diff) {
-            /* Compare the mode string */
-            strcmp_s(alg_tbl[i].mode,
-                     AMVP_ALG_MODE_MAX,
-                     mode, &diff);
-
-            if (!diff) return alg_tbl[i].cipher;
-        }
+    i = amvp_lookup_alg_tbl_index(algorithm, mode);
+    if (i < 0) {
+        return 0;
     }
-
-    return 0;
+    return alg_tbl[i].cipher;
 }
 
 /**
@@ -632,82 +838,232 @@ AMVP_CIPHER amvp_lookup_aux_function_alg_tbl(const char *str) {
     return 0;
 }
 
+/*
+ * Hex codec helpers. The vector paths only use SSE2 or NEON, which are
+ * part of the baseline instruction set on x86_64 and aarch64, so they are
+ * picked at compile time. Anything they don't cover (other targets, and
+ * the tail of each buffer) goes through the byte-at-a-time loops.
+ */
+static const char hex_chars[] = "0123456789ABCDEF";
+
+#if defined(AMVP_HEX_SSE2)
+/* Map 16 nibble values to their uppercase hex characters */
+static __m128i amvp_hex_nibb_to_char(__m128i nibb) {
+    __m128i gt9 = _mm_cmpgt_epi8(nibb, _mm_set1_epi8(9));
+
+    nibb = _mm_add_epi8(nibb, _mm_set1_epi8('0'));
+    return _mm_add_epi8(nibb, _mm_and_si128(gt9, _mm_set1_epi8('A' - '9' - 1)));
+}
+
+/* Map 16 hex characters to nibble values, anything else becomes 0 */
+static __m128i amvp_hex_char_to_nibb(__m128i ch) {
+    __m128i dig = _mm_sub_epi8(ch, _mm_set1_epi8('0'));
+    __m128i alpha = _mm_sub_epi8(_mm_or_si128(ch, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+    __m128i is_dig = _mm_cmpeq_epi8(_mm_min_epu8(dig, _mm_set1_epi8(9)), dig);
+    __m128i is_alpha = _mm_cmpeq_epi8(_mm_min_epu8(alpha, _mm_set1_epi8(5)), alpha);
+
+    alpha = _mm_add_epi8(alpha, _mm_set1_epi8(10));
+    return _mm_or_si128(_mm_and_si128(is_dig, dig), _mm_and_si128(is_alpha, alpha));
+}
+
+/* Fold 8 (high, low) nibble pairs into 8 byte values held in 16-bit lanes */
+static __m128i amvp_hex_pack_nibbs(__m128i nibbs) {
+    __m128i hi = _mm_and_si128(nibbs, _mm_set1_epi16(0x00ff));
+    __m128i lo = _mm_srli_epi16(nibbs, 8);
+
+    return _mm_or_si128(_mm_slli_epi16(hi, 4), lo);
+}
+#endif
+
+/*
+ * Write the 2 * len hex characters for src into dest. No terminator.
+ */
+static void amvp_hex_encode(const unsigned char *src, int len, char *dest) {
+    int i = 0;
+
+#if defined(AMVP_HEX_SSE2)
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+        __m128i hi = _mm_and_si128(_mm_srli_epi16(v, 4), _mm_set1_epi8(0x0f));
+        __m128i lo = _mm_and_si128(v, _mm_set1_epi8(0x0f));
+
+        _mm_storeu_si128((__m128i *)(dest + 2 * i),
+                         amvp_hex_nibb_to_char(_mm_unpacklo_epi8(hi, lo)));
+        _mm_storeu_si128((__m128i *)(dest + 2 * i + 16),
+                         amvp_hex_nibb_to_char(_mm_unpackhi_epi8(hi, lo)));
+    }
+#elif defined(AMVP_HEX_NEON)
+    {
+        const uint8x16_t tbl = vld1q_u8((const uint8_t *)hex_chars);
+
+        for (; i + 16 <= len; i += 16) {
+            uint8x16_t v = vld1q_u8(src + i);
+            uint8x16x2_t out;
+
+            out.val[0] = vqtbl1q_u8(tbl, vshrq_n_u8(v, 4));
+            out.val[1] = vqtbl1q_u8(tbl, vandq_u8(v, vdupq_n_u8(0x0f)));
+            vst2q_u8((uint8_t *)(dest + 2 * i), out);
+        }
+    }
+#endif
+    for (; i < len; i++) {
+        dest[2 * i] = hex_chars[src[i] >> 4];
+        dest[2 * i + 1] = hex_chars[src[i] & 0x0f];
+    }
+}
+
+/*
+ * Read 2 * len hex characters from src into len bytes of dest.
+ */
+static void amvp_hex_decode(const char *src, int len, unsigned char *dest) {
+    int i = 0;
+
+#if defined(AMVP_HEX_SSE2)
+    for (; i + 16 <= len; i += 16) {
+        __m128i a = amvp_hex_char_to_nibb(_mm_loadu_si128((const __m128i *)(src + 2 * i)));
+        __m128i b = amvp_hex_char_to_nibb(_mm_loadu_si128((const __m128i *)(src + 2 * i + 16)));
+
+        _mm_storeu_si128((__m128i *)(dest + i),
+                         _mm_packus_epi16(amvp_hex_pack_nibbs(a), amvp_hex_pack_nibbs(b)));
+    }
+#elif defined(AMVP_HEX_NEON)
+    for (; i + 16 <= len; i += 16) {
+        uint8x16x2_t ch = vld2q_u8((const uint8_t *)(src + 2 * i));
+        uint8x16_t nibb[2];
+        int k;
+
+        for (k = 0; k < 2; k++) {
+            uint8x16_t dig = vsubq_u8(ch.val[k], vdupq_n_u8('0'));
+            uint8x16_t alpha = vsubq_u8(vorrq_u8(ch.val[k], vdupq_n_u8(0x20)), vdupq_n_u8('a'));
+
+            nibb[k] = vorrq_u8(vandq_u8(vcleq_u8(dig, vdupq_n_u8(9)), dig),
+                               vandq_u8(vcleq_u8(alpha, vdupq_n_u8(5)),
+                                        vaddq_u8(alpha, vdupq_n_u8(10))));
+        }
+        vst1q_u8(dest + i, vorrq_u8(vshlq_n_u8(nibb[0], 4), nibb[1]));
+    }
+#endif
+    for (; i < len; i++) {
+        dest[i] = (unsigned char)((amvp_char_to_int(src[2 * i]) << 4) |
+                                  amvp_char_to_int(src[2 * i + 1]));
+    }
+}
+
 /*
  * Convert a byte array from source to a hexadecimal string which is
  * stored in the destination.
  */
 AMVP_RESULT amvp_bin_to_hexstr(const unsigned char *src, int src_len, char *dest, int dest_max) {
-    int i, j;
-    unsigned char nibb_a, nibb_b;
-    unsigned char hex_chars[] = "0123456789ABCDEF";
-
     if (!src || !dest) {
         return AMVP_CONVERT_DATA_ERR;
     }
 
-    if ((src_len * 2) > dest_max) {
+    if (src_len < 0 || (src_len * 2) > dest_max) {
         return AMVP_CONVERT_DATA_ERR;
     }
 
-    for (i = 0, j = 0; i < src_len; i++, j += 2) {
-        nibb_a = *src >> 4;   /* Get first half of byte */
-        nibb_b = *src & 0x0f; /* Get second half of byte */
-
-        *dest = hex_chars[nibb_a];
-        *(dest + 1) = hex_chars[nibb_b];
-
-        dest += 2;
-        src++;
-    }
-    *dest = '\0';
+    amvp_hex_encode(src, src_len, dest);
+    dest[src_len * 2] = '\0';
 
     return AMVP_SUCCESS;
 }
 
 /*
  * Convert a source hexadecimal string to a byte array which is stored
- * in the destination.
- * TODO: Enable the function to handle odd number of hex characters
+ * in the destination. An odd number of hex characters is read as if
+ * it had a leading '0', i.e. "abc" converts to { 0x0a, 0xbc }.
  */
 AMVP_RESULT amvp_hexstr_to_bin(const char *src, unsigned char *dest, int dest_max, int *converted_len) {
-    int src_len;
-    int byte_a, byte_b;
-    int is_odd = 0;
-    int length_converted = 0;
+    AMVP_STR_VIEW view = { src, 0, NULL };
 
     if (!src || !dest) {
         return AMVP_INVALID_ARG;
     }
+    view.len = strnlen_s(src, AMVP_HEXSTR_MAX);
+
+    return amvp_view_to_bin(view, dest, dest_max, converted_len);
+}
+
+/*
+ * Views of the string members of a vector set. The strings stay owned by
+ * the parsed vector set, which outlives the test cases, and the length is
+ * the one parson recorded while parsing.
+ */
+static AMVP_STR_VIEW amvp_view_of(const JSON_Value *val) {
+    AMVP_STR_VIEW view = { NULL, 0, NULL };
+
+    view.str = json_value_get_string(val);
+    if (view.str) {
+        view.len = json_value_get_string_len(val);
+        view.bin = json_value_get_string_bin(val);
+    }
+    return view;
+}
+
+AMVP_STR_VIEW amvp_json_view(const JSON_Object *obj, const char *name) {
+    return amvp_view_of(json_object_get_value(obj, name));
+}
 
-    src_len = strnlen_s(src, AMVP_HEXSTR_MAX);
+AMVP_STR_VIEW amvp_json_view_key(const JSON_Object *obj, const JSON_Key *key) {
+    return amvp_view_of(json_object_get_value_key(obj, key));
+}
+
+/*
+ * amvp_hexstr_to_bin() for a view, without measuring the string again.
+ * Make sure the hex value isn't too large before decoding.
+ */
+AMVP_RESULT amvp_view_to_bin(AMVP_STR_VIEW src, unsigned char *dest, int dest_max, int *converted_len) {
+    const char *hex = src.str;
+    int length_converted = 0;
 
-    /*
-     * Make sure the hex value isn't too large
-     */
-    if (src_len > (2 * dest_max)) {
+    if (!hex || !dest) {
+        return AMVP_INVALID_ARG;
+    }
+    if (src.len > AMVP_HEXSTR_MAX || (int)((src.len + 1) / 2) > dest_max) {
         return AMVP_DATA_TOO_LARGE;
     }
 
-    if (src_len & 1) {
-        is_odd = 1;
+    /* Decoded when the vector set cache was written, see amvp_vs_cache.c */
+    if (src.bin) {
+        memcpy_s(dest, dest_max, src.bin, (src.len + 1) / 2);
+        if (converted_len) *converted_len = (int)((src.len + 1) / 2);
+        return AMVP_SUCCESS;
     }
 
-    if (!is_odd) {
-        while (*src && src[1]) {
-            byte_a = amvp_char_to_int((char)*src) << 4; /* Shift to left half of byte */
-            byte_b = amvp_char_to_int(*(src + 1));
+    if (src.len & 1) {
+        *dest = (unsigned char)amvp_char_to_int(*hex);
+        dest++;
+        hex++;
+        length_converted++;
+    }
+    amvp_hex_decode(hex, src.len / 2, dest);
+    length_converted += src.len / 2;
 
-            *dest = byte_a + byte_b; /* Combine left half with right half */
+    if (converted_len) *converted_len = length_converted;
+    return AMVP_SUCCESS;
+}
 
-            dest++;
-            src += 2;
-            length_converted++;
-        }
-    } else {
-        return AMVP_UNSUPPORTED_OP;
+/*
+ * Encode bin as the string member name of obj. The hex is written straight
+ * into the string parson keeps, rather than into a buffer that is copied.
+ */
+AMVP_RESULT amvp_json_set_hex(JSON_Object *obj, const char *name, const unsigned char *bin, int bin_len) {
+    JSON_Value *val = NULL;
+    char *chars = NULL;
+
+    if (!obj || !name || (!bin && bin_len) || bin_len < 0) {
+        return AMVP_INVALID_ARG;
     }
 
-    if (converted_len) *converted_len = length_converted;
+    val = json_value_init_string_buffer((size_t)bin_len * 2, &chars);
+    if (!val) {
+        return AMVP_MALLOC_FAIL;
+    }
+    amvp_hex_encode(bin, bin_len, chars);
+    if (json_object_set_value(obj, name, val) != JSONSuccess) {
+        json_value_free(val);
+        return AMVP_JSON_ERR;
+    }
     return AMVP_SUCCESS;
 }
 
@@ -750,14 +1106,14 @@ AMVP_DRBG_MODE_LIST *amvp_locate_drbg_mode_entry(AMVP_CAPS_LIST *cap, AMVP_DRBG_
     return NULL;
 }
 
-AMVP_DRBG_MODE_LIST *amvp_create_drbg_mode_entry(AMVP_CAPS_LIST *cap, AMVP_DRBG_MODE mode) {
+AMVP_DRBG_MODE_LIST *amvp_create_drbg_mode_entry(AMVP_ARENA *arena, AMVP_CAPS_LIST *cap, AMVP_DRBG_MODE mode) {
     AMVP_DRBG_MODE_LIST *entry = NULL, *list = NULL;
 
     if (amvp_locate_drbg_mode_entry(cap, mode) != NULL) {
         return NULL;
     }
 
-    entry = calloc(1, sizeof(AMVP_DRBG_MODE_LIST));
+    entry = amvp_arena_alloc(arena, sizeof(AMVP_DRBG_MODE_LIST));
     if (!entry) {
         return NULL;
     }
@@ -792,7 +1148,7 @@ AMVP_DRBG_CAP_GROUP *amvp_locate_drbg_group_entry(AMVP_DRBG_MODE_LIST *mode, int
 }
 
 
-AMVP_DRBG_CAP_GROUP *amvp_create_drbg_group(AMVP_DRBG_MODE_LIST *mode, int group) {
+AMVP_DRBG_CAP_GROUP *amvp_create_drbg_group(AMVP_ARENA *arena, AMVP_DRBG_MODE_LIST *mode, int group) {
     AMVP_DRBG_GROUP_LIST *entry = NULL, *list = NULL;
     AMVP_DRBG_CAP_GROUP *grp = NULL;
 
@@ -800,13 +1156,12 @@ AMVP_DRBG_CAP_GROUP *amvp_create_drbg_group(AMVP_DRBG_MODE_LIST *mode, int group
         return NULL;
     }
 
-    entry = calloc(1, sizeof(AMVP_DRBG_GROUP_LIST));
+    entry = amvp_arena_alloc(arena, sizeof(AMVP_DRBG_GROUP_LIST));
     if (!entry) {
         return NULL;
     }
-    grp = calloc(1, sizeof(AMVP_DRBG_CAP_GROUP));
+    grp = amvp_arena_alloc(arena, sizeof(AMVP_DRBG_CAP_GROUP));
     if (!grp) {
-        free(entry);
         return NULL;
     }
 
@@ -984,36 +1339,6 @@ AMVP_RESULT amvp_setup_json_rsp_group(AMVP_CTX **ctx,
 }
 
 
-AMVP_RESULT amvp_setup_json_ev_group(AMVP_CTX **ctx,
-                                      JSON_Value **outer_arr_val,
-                                      JSON_Value **r_vs_val,
-                                      JSON_Object **r_vs,
-                                      JSON_Array **groups_arr) {
-    if ((*ctx)->kat_resp) {
-        json_value_free((*ctx)->kat_resp);
-    }
-    (*ctx)->kat_resp = *outer_arr_val;
-
-    *r_vs_val = json_value_init_object();
-    *r_vs = json_value_get_object(*r_vs_val);
-    if (!*r_vs) {
-        return AMVP_JSON_ERR;
-    } 
-
-    if (json_object_set_number(*r_vs, "ieId", (*ctx)->vs_id) != JSONSuccess) {
-        return AMVP_JSON_ERR;
-    }
-
-    /* create an array of response test groups */
-    json_object_set_value(*r_vs, "teGroups", json_value_init_array());
-    (*groups_arr) = json_object_get_array(*r_vs, "teGroups");
-    if (!*groups_arr) {
-        return AMVP_JSON_ERR;
-    }
-
-    return AMVP_SUCCESS;
-}
-
 JSON_Object *amvp_get_obj_from_rsp(AMVP_CTX *ctx, JSON_Value *arry_val) {
     JSON_Object *obj = NULL;
     JSON_Array *reg_array;
@@ -1075,53 +1400,165 @@ void amvp_free_str_list(AMVP_STRING_LIST **list) {
     *list = NULL;
 }
 
+#define AMVP_VALUE_SET_RANGES_MIN 4
+
+/* Index of the first range with max >= value, range_cnt if there is none */
+static int amvp_value_set_range(const AMVP_VALUE_SET *set, int value) {
+    int lo = 0, hi = set->range_cnt, mid = 0;
+
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if (set->ranges[mid].max < value) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+static AMVP_RESULT amvp_value_set_add_range(AMVP_ARENA *arena, AMVP_VALUE_SET *set, int value) {
+    AMVP_VALUE_RANGE *ranges = NULL;
+    int i = amvp_value_set_range(set, value), max = 0;
+
+    if (i < set->range_cnt && set->ranges[i].min <= value) {
+        return AMVP_SUCCESS;
+    }
+    if (i > 0 && set->ranges[i - 1].max == value - 1) {
+        /* Extends the range below, and maybe joins it to the one above */
+        set->ranges[i - 1].max = value;
+        if (i < set->range_cnt && set->ranges[i].min == value + 1) {
+            set->ranges[i - 1].max = set->ranges[i].max;
+            memmove(&set->ranges[i], &set->ranges[i + 1],
+                    (set->range_cnt - i - 1) * sizeof(AMVP_VALUE_RANGE));
+            set->range_cnt--;
+        }
+        set->count++;
+        return AMVP_SUCCESS;
+    }
+    if (i < set->range_cnt && set->ranges[i].min == value + 1) {
+        set->ranges[i].min = value;
+        set->count++;
+        return AMVP_SUCCESS;
+    }
+
+    if (set->range_cnt == set->range_max) {
+        /* The old array stays in the arena, at most as much again as the new one */
+        max = set->range_max ? set->range_max * 2 : AMVP_VALUE_SET_RANGES_MIN;
+        ranges = amvp_arena_alloc(arena, max * sizeof(AMVP_VALUE_RANGE));
+        if (!ranges) {
+            return AMVP_MALLOC_FAIL;
+        }
+        if (set->range_cnt) {
+            memcpy_s(ranges, max * sizeof(AMVP_VALUE_RANGE), set->ranges,
+                     set->range_cnt * sizeof(AMVP_VALUE_RANGE));
+        }
+        set->ranges = ranges;
+        set->range_max = max;
+    }
+    memmove(&set->ranges[i + 1], &set->ranges[i], (set->range_cnt - i) * sizeof(AMVP_VALUE_RANGE));
+    set->ranges[i].min = value;
+    set->ranges[i].max = value;
+    set->range_cnt++;
+    set->count++;
+    return AMVP_SUCCESS;
+}
+
 /**
- * Simple utility function to add an entry to a SL list. if the list is NULL, it is created
- * with the given entry being the first one.
+ * Adds value to set; adding a value that is already there does nothing.
+ * Only values over AMVP_VALUE_SET_BITS allocate memory, from arena.
  */
-AMVP_RESULT amvp_append_sl_list(AMVP_SL_LIST **list, int length) {
-    AMVP_SL_LIST *current = NULL;
-    if (!list) {
+AMVP_RESULT amvp_value_set_add(AMVP_ARENA *arena, AMVP_VALUE_SET *set, int value) {
+    unsigned long long bit = 0;
+
+    if (!arena || !set) {
         return AMVP_NO_DATA;
     }
-    
-    if (*list == NULL) {
-        *list = calloc(1, sizeof(AMVP_SL_LIST));
-        if (!*list) {
-            return AMVP_MALLOC_FAIL;
-        }
-        (*list)->length = length;
-        return AMVP_SUCCESS;
+    if (value < 0) {
+        return AMVP_INVALID_ARG;
     }
-    current = *list;
-    while (current) {
-        if (!current->next) {
-            current->next = calloc(1, sizeof(AMVP_SL_LIST));
-            if (!current->next) {
-                return AMVP_MALLOC_FAIL;
+    if (value >= AMVP_VALUE_SET_BITS) {
+        return amvp_value_set_add_range(arena, set, value);
+    }
+    bit = 1ULL << (value % AMVP_VALUE_SET_WORD_BITS);
+    if (!(set->bits[value / AMVP_VALUE_SET_WORD_BITS] & bit)) {
+        set->bits[value / AMVP_VALUE_SET_WORD_BITS] |= bit;
+        set->count++;
+    }
+    return AMVP_SUCCESS;
+}
+
+/**
+ * Returns 1 if value is in set, 0 otherwise
+ */
+int amvp_value_set_has(const AMVP_VALUE_SET *set, int value) {
+    int i = 0;
+
+    if (!set || value < 0) {
+        return 0;
+    }
+    if (value < AMVP_VALUE_SET_BITS) {
+        return (set->bits[value / AMVP_VALUE_SET_WORD_BITS] >> (value % AMVP_VALUE_SET_WORD_BITS)) & 1;
+    }
+    i = amvp_value_set_range(set, value);
+    return i < set->range_cnt && set->ranges[i].min <= value;
+}
+
+/**
+ * Moves *value to the next larger value in set. Start with *value at -1
+ * to get the smallest:
+ *
+ *     int v = -1;
+ *     while (amvp_value_set_next(set, &v)) { ... }
+ *
+ * Returns 0, leaving *value alone, once there are no more.
+ */
+int amvp_value_set_next(const AMVP_VALUE_SET *set, int *value) {
+    unsigned long long word = 0;
+    int v = 0, w = 0, i = 0;
+
+    if (!set || !value || !set->count || *value == INT_MAX) {
+        return 0;
+    }
+    v = *value < 0 ? 0 : *value + 1;
+    if (v < AMVP_VALUE_SET_BITS) {
+        w = v / AMVP_VALUE_SET_WORD_BITS;
+        /* Drop the bits below v in its word */
+        word = set->bits[w] & (~0ULL << (v % AMVP_VALUE_SET_WORD_BITS));
+        while (1) {
+            if (word) {
+                for (i = 0; !((word >> i) & 1); i++) {
+                }
+                *value = w * AMVP_VALUE_SET_WORD_BITS + i;
+                return 1;
             }
-            current->next->length = length;
-            return AMVP_SUCCESS;
+            if (++w == AMVP_VALUE_SET_BITS / AMVP_VALUE_SET_WORD_BITS) {
+                break;
+            }
+            word = set->bits[w];
         }
-        current = current->next;
+        v = AMVP_VALUE_SET_BITS;
     }
-
-    /* Code should never reach here */
-    return AMVP_UNSUPPORTED_OP;
+    i = amvp_value_set_range(set, v);
+    if (i == set->range_cnt) {
+        return 0;
+    }
+    *value = set->ranges[i].min > v ? set->ranges[i].min : v;
+    return 1;
 }
 
 /**
  * Simple utility function to add an entry to a param list. if the list is NULL, it is created
- * with the given entry being the first one.
+ * with the given entry being the first one. Nodes come from arena.
  */
-AMVP_RESULT amvp_append_param_list(AMVP_PARAM_LIST **list, int param) {
+AMVP_RESULT amvp_append_param_list(AMVP_ARENA *arena, AMVP_PARAM_LIST **list, int param) {
     AMVP_PARAM_LIST *current = NULL;
-    if (!list) {
+    if (!arena || !list) {
         return AMVP_NO_DATA;
     }
     
     if (*list == NULL) {
-        *list = calloc(1, sizeof(AMVP_PARAM_LIST));
+        *list = amvp_arena_alloc(arena, sizeof(AMVP_PARAM_LIST));
         if (!*list) {
             return AMVP_MALLOC_FAIL;
         }
@@ -1131,7 +1568,7 @@ AMVP_RESULT amvp_append_param_list(AMVP_PARAM_LIST **list, int param) {
     current = *list;
     while (current) {
         if (!current->next) {
-            current->next = calloc(1, sizeof(AMVP_PARAM_LIST));
+            current->next = amvp_arena_alloc(arena, sizeof(AMVP_PARAM_LIST));
             if (!current->next) {
                 return AMVP_MALLOC_FAIL;
             }
@@ -1150,16 +1587,16 @@ AMVP_RESULT amvp_append_param_list(AMVP_PARAM_LIST **list, int param) {
  * with the given entry being the first one. Note the string is REFERENCED, not copied.
  * This function should be able to accomdate the removal of names from the list if needed in the
  * future; if a name is removed from the list but its node remains (with a NULL value) then
- * the given string will be added to the "dummy" node
+ * the given string will be added to the "dummy" node. Nodes come from arena.
  */
-AMVP_RESULT amvp_append_name_list(AMVP_NAME_LIST **list, const char *string) {
+AMVP_RESULT amvp_append_name_list(AMVP_ARENA *arena, AMVP_NAME_LIST **list, const char *string) {
     AMVP_NAME_LIST *current = NULL;
-    if (!list) {
+    if (!arena || !list) {
         return AMVP_NO_DATA;
     }
 
     if (!*list) {
-        *list = calloc(1, sizeof(AMVP_NAME_LIST));
+        *list = amvp_arena_alloc(arena, sizeof(AMVP_NAME_LIST));
         if (!*list) {
             return AMVP_MALLOC_FAIL;
         }
@@ -1171,7 +1608,7 @@ AMVP_RESULT amvp_append_name_list(AMVP_NAME_LIST **list, const char *string) {
             return AMVP_SUCCESS;
         }
         if (!current->next) {
-            current->next = calloc(1, sizeof(AMVP_NAME_LIST));
+            current->next = amvp_arena_alloc(arena, sizeof(AMVP_NAME_LIST));
             if (!current->next) {
                 return AMVP_MALLOC_FAIL;
             }
@@ -1272,22 +1709,104 @@ int amvp_lookup_str_list(AMVP_STRING_LIST **list, const char *string) {
     return 0;
 }
 
+#define AMVP_STR_SET_MIN 16
+
+/* FNV-1a, as for the alg index */
+static size_t amvp_str_set_hash(const char *string) {
+    unsigned int h = 2166136261u;
+    int i;
+
+    for (i = 0; i < AMVP_STRING_LIST_MAX_LEN && string[i]; i++) {
+        h = (h ^ (unsigned char)string[i]) * 16777619u;
+    }
+    return h;
+}
+
+/* Find the slot holding string, or the empty slot where it would go */
+static size_t amvp_str_set_slot(char **slots, size_t size, const char *string) {
+    size_t pos = amvp_str_set_hash(string) & (size - 1);
+    int diff = 1;
+
+    while (slots[pos]) {
+        strcmp_s(slots[pos], AMVP_STRING_LIST_MAX_LEN, string, &diff);
+        if (!diff) {
+            break;
+        }
+        pos = (pos + 1) & (size - 1);
+    }
+    return pos;
+}
+
 /**
- * Simple utility for searching if a value already exists in a
- * param list.
+ * Adds a copy of string to set, unless it is already there.
+ * Returns 1 if it was added, 0 if it was already in the set, and
+ * -1 if memory could not be allocated.
  */
-int amvp_lookup_param_list(AMVP_PARAM_LIST *list, int value) {
-    if (!list) {
+int amvp_str_set_add(AMVP_STR_SET *set, const char *string) {
+    char **slots = NULL;
+    char *word = NULL;
+    size_t size = 0, i = 0, pos = 0;
+    int len = 0;
+
+    if (!set || !string) {
+        return -1;
+    }
+    if (set->size && set->slots[amvp_str_set_slot(set->slots, set->size, string)]) {
         return 0;
     }
-    while(list) {
-        if (value == list->param) {
-            return 1;
-        } else {
-            list = list->next;
+
+    /* Keep the load under one half */
+    if ((set->count + 1) * 2 > set->size) {
+        size = set->size ? set->size * 2 : AMVP_STR_SET_MIN;
+        slots = calloc(size, sizeof(char *));
+        if (!slots) {
+            return -1;
         }
+        for (i = 0; i < set->size; i++) {
+            if (set->slots[i]) {
+                slots[amvp_str_set_slot(slots, size, set->slots[i])] = set->slots[i];
+            }
+        }
+        if (set->slots) free(set->slots);
+        set->slots = slots;
+        set->size = size;
     }
-    return 0;
+
+    len = strnlen_s(string, AMVP_STRING_LIST_MAX_LEN);
+    word = calloc(len + 1, sizeof(char));
+    if (!word) {
+        return -1;
+    }
+    strncpy_s(word, len + 1, string, len);
+    pos = amvp_str_set_slot(set->slots, set->size, word);
+    set->slots[pos] = word;
+    set->count++;
+    return 1;
+}
+
+/**
+ * Returns 1 if string is in set, 0 otherwise.
+ */
+int amvp_str_set_has(const AMVP_STR_SET *set, const char *string) {
+    if (!set || !set->size || !string) {
+        return 0;
+    }
+    return set->slots[amvp_str_set_slot(set->slots, set->size, string)] != NULL;
+}
+
+void amvp_str_set_free(AMVP_STR_SET *set) {
+    size_t i;
+
+    if (!set || !set->slots) {
+        return;
+    }
+    for (i = 0; i < set->size; i++) {
+        if (set->slots[i]) free(set->slots[i]);
+    }
+    free(set->slots);
+    set->slots = NULL;
+    set->size = 0;
+    set->count = 0;
 }
 
 /**
@@ -1300,39 +1819,45 @@ int amvp_is_domain_already_set(AMVP_JSON_DOMAIN_OBJ *domain) {
     return domain->min + domain->max + domain->increment;
 }
 
-AMVP_RESULT amvp_json_serialize_to_file_pretty_a(const JSON_Value *value, const char *filename) {
+/*
+ * Write value to filename as an element of the JSON array the vector
+ * request and response files are made of. The first element opens the
+ * array ("w"), later ones are appended (append) and a NULL value appends
+ * the closing ']'.
+ */
+static AMVP_RESULT amvp_json_write_file(const JSON_Value *value, const char *filename,
+                                        int append, int pretty) {
     AMVP_RESULT return_code = AMVP_SUCCESS;
     FILE *fp = NULL;
-    char *serialized_string = NULL; 
+    char *serialized_string = NULL;
 
+    if (!value && !append) {
+        return AMVP_JSON_ERR;
+    }
     if (!filename) {
         return AMVP_INVALID_ARG;
     }
 
-    fp = fopen(filename, "a");
+    if (value) {
+        serialized_string = pretty ? json_serialize_to_string_pretty(value, NULL) :
+                                     json_serialize_to_string(value, NULL);
+        if (serialized_string == NULL) {
+            return AMVP_JSON_ERR;
+        }
+    }
+    fp = fopen(filename, append ? "a" : "w");
     if (fp == NULL) {
+        json_free_serialized_string(serialized_string);
         return AMVP_JSON_ERR;
     }
     if (!value) {
         if (fputs(" ]", fp) == EOF) {
             return_code = AMVP_JSON_ERR;
         }
-    } else {
-
-        serialized_string = json_serialize_to_string_pretty(value, NULL);
-        if (serialized_string == NULL) {
-            fclose(fp);
-            return AMVP_JSON_ERR;
-        }
-        if (fputs(", ", fp) == EOF) {
-            return_code = AMVP_JSON_ERR;
-            goto end;
-        }
-        if (fputs(serialized_string, fp) == EOF) {
-            return_code = AMVP_JSON_ERR;
-        }
+    } else if (fputs(append ? ", " : "[ ", fp) == EOF ||
+               fputs(serialized_string, fp) == EOF) {
+        return_code = AMVP_JSON_ERR;
     }
-end:
     if (fclose(fp) == EOF) {
         return_code = AMVP_JSON_ERR;
     }
@@ -1340,39 +1865,311 @@ end:
     return return_code;
 }
 
+AMVP_RESULT amvp_json_serialize_to_file_pretty_a(const JSON_Value *value, const char *filename) {
+    return amvp_json_write_file(value, filename, 1, 1);
+}
+
 AMVP_RESULT amvp_json_serialize_to_file_pretty_w(const JSON_Value *value, const char *filename) {
-    AMVP_RESULT return_code = AMVP_SUCCESS;
-    FILE *fp = NULL;
-    char *serialized_string = NULL;
+    return amvp_json_write_file(value, filename, 0, 1);
+}
 
-    if (!value) {
-        return AMVP_JSON_ERR;
+/*
+ * Like the _pretty_ versions, but compact when ctx was set up with
+ * amvp_set_json_compact().
+ */
+AMVP_RESULT amvp_json_serialize_to_file_a(AMVP_CTX *ctx, const JSON_Value *value, const char *filename) {
+    return amvp_json_write_file(value, filename, 1, !(ctx && ctx->json_compact));
+}
+
+AMVP_RESULT amvp_json_serialize_to_file_w(AMVP_CTX *ctx, const JSON_Value *value, const char *filename) {
+    return amvp_json_write_file(value, filename, 0, !(ctx && ctx->json_compact));
+}
+
+/*
+ * Serialize JSON sent to the server or saved to a file, compact or
+ * pretty printed as configured with amvp_set_json_compact(). Free the
+ * result with json_free_serialized_string().
+ */
+char *amvp_json_serialize(AMVP_CTX *ctx, const JSON_Value *value, int *len) {
+    if (ctx && ctx->json_compact) {
+        return json_serialize_to_string(value, len);
     }
-    if (!filename) {
+    return json_serialize_to_string_pretty(value, len);
+}
+
+static int amvp_b64url_val(char c) {
+    if (c >= 'A' && c <= 'Z') return c - 'A';
+    if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+    if (c >= '0' && c <= '9') return c - '0' + 52;
+    if (c == '-' || c == '+') return 62;
+    if (c == '_' || c == '/') return 63;
+    return -1;
+}
+
+/*
+ * Returns the expiry ("exp") of a JWT, or 0 if it has none or can't be
+ * read. *issued, if given, gets "iat" the same way. Only the payload is
+ * decoded, the signature is the server's business.
+ */
+time_t amvp_jwt_expiry(const char *jwt, time_t *issued) {
+    const char *start = NULL, *end = NULL;
+    char *payload = NULL;
+    JSON_Value *val = NULL;
+    JSON_Object *obj = NULL;
+    time_t exp = 0;
+    unsigned long bits = 0;
+    int nbits = 0, v = 0;
+    size_t len = 0;
+
+    if (issued) *issued = 0;
+    if (!jwt) return 0;
+
+    /* header.payload.signature, each base64url without padding */
+    start = strchr(jwt, '.');
+    if (!start) return 0;
+    start++;
+    end = strchr(start, '.');
+    if (!end || end - start > AMVP_JWT_TOKEN_MAX) return 0;
+
+    payload = calloc((end - start) / 4 * 3 + 4, sizeof(char));
+    if (!payload) return 0;
+    for (; start < end && *start != '='; start++) {
+        v = amvp_b64url_val(*start);
+        if (v < 0) goto end;
+        bits = (bits << 6) | (unsigned long)v;
+        nbits += 6;
+        if (nbits >= 8) {
+            nbits -= 8;
+            payload[len++] = (char)((bits >> nbits) & 0xff);
+        }
+    }
+
+    val = json_parse_string(payload);
+    obj = json_value_get_object(val);
+    if (!obj) goto end;
+    exp = (time_t)json_object_get_number(obj, "exp");
+    if (issued) *issued = (time_t)json_object_get_number(obj, "iat");
+
+end:
+    if (val) json_value_free(val);
+    free(payload);
+    return exp;
+}
+
+/*
+ * Block headers are padded so the memory handed out keeps the same
+ * alignment malloc would give it.
+ */
+#define AMVP_ARENA_ALIGN 16
+#define AMVP_ARENA_ROUND(x) (((x) + AMVP_ARENA_ALIGN - 1) & ~((size_t)AMVP_ARENA_ALIGN - 1))
+#define AMVP_ARENA_HDR_SIZE AMVP_ARENA_ROUND(sizeof(AMVP_ARENA_BLOCK))
+
+static AMVP_ARENA_BLOCK *amvp_arena_new_block(size_t size) {
+    AMVP_ARENA_BLOCK *blk = NULL;
+
+    blk = amvp_mem_malloc(AMVP_ARENA_HDR_SIZE + size);
+    if (!blk) {
+        return NULL;
+    }
+    blk->next = NULL;
+    blk->size = size;
+    blk->used = 0;
+    return blk;
+}
+
+void *amvp_arena_alloc(AMVP_ARENA *arena, size_t size) {
+    AMVP_ARENA_BLOCK *blk = NULL;
+    unsigned char *ptr = NULL;
+
+    if (!arena || !size) {
+        return NULL;
+    }
+    size = AMVP_ARENA_ROUND(size);
+
+    blk = arena->blocks;
+    if (!blk || blk->size - blk->used < size) {
+        blk = amvp_arena_new_block(size > AMVP_ARENA_BLOCK_SIZE ? size : AMVP_ARENA_BLOCK_SIZE);
+        if (!blk) {
+            return NULL;
+        }
+        blk->next = arena->blocks;
+        arena->blocks = blk;
+    }
+
+    ptr = (unsigned char *)blk + AMVP_ARENA_HDR_SIZE + blk->used;
+    blk->used += size;
+    memzero_s(ptr, size);
+    return ptr;
+}
+
+/*
+ * Allocate a buffer big enough for the binary form of hex, or for min_len
+ * bytes if that is larger, but never more than max_len bytes. Decoding hex
+ * into it with amvp_hexstr_to_bin(hex, buf, max_len, ...) is safe; input
+ * that does not fit in max_len is rejected there as before.
+ */
+unsigned char *amvp_arena_alloc_hex(AMVP_ARENA *arena, const char *hex, int min_len, int max_len) {
+    int len = min_len;
+    int hex_len = 0;
+
+    if (hex) {
+        hex_len = (strnlen_s(hex, 2 * max_len + 1) + 1) / 2;
+        if (hex_len > len) len = hex_len;
+    }
+    if (len > max_len) len = max_len;
+    if (len < 1) len = 1;
+
+    return amvp_arena_alloc(arena, len);
+}
+
+/*
+ * Allocate from the arena and decode the hex in view into it. The buffer
+ * is the size of the decoded value, or min_len bytes if that is larger;
+ * values longer than max_len bytes are rejected.
+ */
+AMVP_RESULT amvp_arena_decode_hex(AMVP_ARENA *arena, AMVP_STR_VIEW hex, int min_len, int max_len,
+                                  unsigned char **out, int *converted_len) {
+    int len = min_len;
+    int hex_len = (int)((hex.len + 1) / 2);
+
+    if (!out) {
         return AMVP_INVALID_ARG;
     }
+    *out = NULL;
+    if (hex.str && (hex.len > AMVP_HEXSTR_MAX || hex_len > max_len)) {
+        return AMVP_DATA_TOO_LARGE;
+    }
+    if (hex.str && hex_len > len) len = hex_len;
+    if (len > max_len) len = max_len;
+    if (len < 1) len = 1;
 
-    serialized_string = json_serialize_to_string_pretty(value, NULL);
-    if (serialized_string == NULL) {
-        return AMVP_JSON_ERR;
+    *out = amvp_arena_alloc(arena, len);
+    if (!*out) {
+        return AMVP_MALLOC_FAIL;
     }
-    fp = fopen(filename, "w");
-    if (fp == NULL) {
-        json_free_serialized_string(serialized_string);
-        return AMVP_JSON_ERR;
+    if (converted_len) *converted_len = 0;
+    if (!hex.str) {
+        return AMVP_SUCCESS;
     }
-    if (fputs("[ ", fp) == EOF) {
-        return_code = AMVP_JSON_ERR;
-        goto end;
+    return amvp_view_to_bin(hex, *out, len, converted_len);
+}
+
+/*
+ * Make all memory in the arena available again. If the last round needed
+ * more than one block, they are merged into a single block so the next
+ * round fits without growing.
+ */
+void amvp_arena_reset(AMVP_ARENA *arena) {
+    AMVP_ARENA_BLOCK *blk = NULL, *next = NULL;
+    size_t total = 0;
+
+    if (!arena || !arena->blocks) {
+        return;
     }
-    if (fputs(serialized_string, fp) == EOF) {
-        json_free_serialized_string(serialized_string);
-        return_code = AMVP_JSON_ERR;
+    if (!arena->blocks->next) {
+        arena->blocks->used = 0;
+        return;
     }
-end:
-    if (fclose(fp) == EOF) {
-        return_code = AMVP_JSON_ERR;
+
+    for (blk = arena->blocks; blk; blk = next) {
+        next = blk->next;
+        total += blk->size;
+        amvp_mem_free(blk);
     }
-    json_free_serialized_string(serialized_string);
-    return return_code;
+    /* On failure the arena simply starts empty */
+    arena->blocks = amvp_arena_new_block(total);
+}
+
+void amvp_arena_free(AMVP_ARENA *arena) {
+    AMVP_ARENA_BLOCK *blk = NULL, *next = NULL;
+
+    if (!arena) {
+        return;
+    }
+    for (blk = arena->blocks; blk; blk = next) {
+        next = blk->next;
+        amvp_mem_free(blk);
+    }
+    arena->blocks = NULL;
+}
+
+static int amvp_arena_owns(AMVP_ARENA *arena, const void *ptr) {
+    AMVP_ARENA_BLOCK *blk = NULL;
+    const unsigned char *p = ptr;
+
+    for (blk = arena->blocks; blk; blk = blk->next) {
+        const unsigned char *base = (unsigned char *)blk + AMVP_ARENA_HDR_SIZE;
+
+        if (p >= base && p < base + blk->size) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void *amvp_json_arena_malloc(void *opaque, size_t size) {
+    AMVP_CTX *ctx = opaque;
+
+    return amvp_arena_alloc(&ctx->json_arena, size ? size : 1);
+}
+
+/*
+ * Arena memory goes away with the arena. Anything else was allocated
+ * before the arena was installed, so it goes back to the allocator that
+ * was in use then.
+ */
+static void amvp_json_arena_release(void *opaque, void *ptr) {
+    AMVP_CTX *ctx = opaque;
+    const JSON_Allocator *prev = ctx->json_prev_alloc;
+    JSON_Free_Function free_fun = NULL;
+
+    if (!ptr || amvp_arena_owns(&ctx->json_arena, ptr)) {
+        return;
+    }
+    if (prev) {
+        prev->free_fun(prev->opaque, ptr);
+        return;
+    }
+    json_get_allocation_functions(NULL, &free_fun);
+    free_fun(ptr);
+}
+
+/*
+ * Have parson allocate from ctx->json_arena on this thread, if enabled
+ * with amvp_set_json_arena(). Everything parsed or built until the
+ * matching amvp_json_arena_end(), including ctx->kat_resp, is dropped
+ * there in one step instead of freeing each value.
+ * Trees created before may still be read and have members removed in
+ * between, but must not be given new values.
+ */
+void amvp_json_arena_begin(AMVP_CTX *ctx) {
+    if (!ctx || !ctx->json_arena_enabled || ctx->json_arena_active) {
+        return;
+    }
+    ctx->json_alloc.malloc_fun = amvp_json_arena_malloc;
+    ctx->json_alloc.free_fun = amvp_json_arena_release;
+    ctx->json_alloc.opaque = ctx;
+    ctx->json_prev_alloc = json_set_thread_allocator(&ctx->json_alloc);
+    ctx->json_arena_active = 1;
+}
+
+/*
+ * Release *val, which was parsed after amvp_json_arena_begin(). Without
+ * an active arena this is just json_value_free().
+ */
+void amvp_json_arena_end(AMVP_CTX *ctx, JSON_Value **val) {
+    if (!ctx || !val) {
+        return;
+    }
+    if (!ctx->json_arena_active) {
+        if (*val) json_value_free(*val);
+        *val = NULL;
+        return;
+    }
+    *val = NULL;
+    ctx->kat_resp = NULL;
+    json_set_thread_allocator(ctx->json_prev_alloc);
+    ctx->json_prev_alloc = NULL;
+    ctx->json_arena_active = 0;
+    amvp_arena_reset(&ctx->json_arena);
 }
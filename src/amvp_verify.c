@@ -0,0 +1,567 @@
+/** @file */
+/*
+ * Copyright (c) 2021, Cisco Systems, Inc.
+ *
+ * Licensed under the Apache License 2.0 (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://github.com/cisco/libamvp/LICENSE
+ */
+
+/*
+ * Checks a response file against the expected results of a sample session,
+ * see amvp_verify_expected_results(), without going through the server.
+ *
+ * The expected test cases are put in a hash table keyed by vsId, tgId and
+ * tcId. The test cases of the response file are then split into ranges,
+ * one per thread, and each is looked up and compared. Every member of an
+ * expected test case has to be in the response with the same value;
+ * strings are compared ignoring case, since hex may come either way.
+ * Results are reported per algorithm once all threads are done, so the
+ * log reads the same whatever the number of threads.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+#include "amvp.h"
+#include "amvp_lcl.h"
+#include "parson.h"
+#include "safe_lib.h"
+
+/* Below this many test cases per thread, more threads don't pay off */
+#define AMVP_VERIFY_MIN_PER_THREAD 512
+
+typedef struct amvp_verify_exp_t {
+    int vs_id;
+    int tg_id;
+    int tc_id;
+    JSON_Object *tc;            /* NULL for an empty slot */
+    int seen;                   /* Set once a response matched up with it */
+} AMVP_VERIFY_EXP;
+
+/* Open addressed with linear probing, slot_cnt is a power of 2 */
+typedef struct amvp_verify_index_t {
+    AMVP_VERIFY_EXP *slots;
+    size_t slot_cnt;
+} AMVP_VERIFY_INDEX;
+
+/* One test case of the response file */
+typedef struct amvp_verify_tc_t {
+    int vs;                     /* Index of its vector set in the response file */
+    int tg_id;
+    int tc_id;
+    JSON_Object *tc;
+    AMVP_VERIFY_EXP *exp;       /* Set by the thread that checked it */
+    const char *diff;           /* Name of the first member that differs, set the same way */
+} AMVP_VERIFY_TC;
+
+typedef struct amvp_verify_vs_t {
+    int vs_id;
+    const char *alg;
+    const char *mode;
+} AMVP_VERIFY_VS;
+
+typedef struct amvp_verify_alg_t {
+    const char *alg;
+    const char *mode;
+    int tcs;
+    int failed;
+    int logged;
+} AMVP_VERIFY_ALG;
+
+typedef struct amvp_verify_job_t {
+    const AMVP_VERIFY_INDEX *index;
+    const AMVP_VERIFY_VS *sets;
+    AMVP_VERIFY_TC *tcs;
+    size_t start;
+    size_t end;
+} AMVP_VERIFY_JOB;
+
+/* FNV-1a over the three ids */
+static size_t amvp_verify_hash(int vs_id, int tg_id, int tc_id) {
+    unsigned int ids[3], h = 2166136261u;
+    const unsigned char *p = (const unsigned char *)ids;
+    size_t i;
+
+    ids[0] = (unsigned int)vs_id;
+    ids[1] = (unsigned int)tg_id;
+    ids[2] = (unsigned int)tc_id;
+    for (i = 0; i < sizeof(ids); i++) {
+        h ^= p[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+/*
+ * Returns the slot for the ids: the entry if it is there, otherwise the
+ * empty slot it would go in. The table always has an empty slot.
+ */
+static AMVP_VERIFY_EXP *amvp_verify_slot(const AMVP_VERIFY_INDEX *index, int vs_id, int tg_id, int tc_id) {
+    size_t mask = index->slot_cnt - 1;
+    size_t i = amvp_verify_hash(vs_id, tg_id, tc_id) & mask;
+    AMVP_VERIFY_EXP *slot = NULL;
+
+    while (1) {
+        slot = &index->slots[i];
+        if (!slot->tc ||
+                (slot->vs_id == vs_id && slot->tg_id == tg_id && slot->tc_id == tc_id)) {
+            return slot;
+        }
+        i = (i + 1) & mask;
+    }
+}
+
+/*
+ * The vector set object of an element of either file. The expected results
+ * file has each set as the [ version, set ] array the server sent; the
+ * response file has the set itself. Anything without a vsId, like the
+ * session identifiers, gives NULL.
+ */
+static JSON_Object *amvp_verify_set_obj(JSON_Value *val) {
+    JSON_Array *arr = json_value_get_array(val);
+    JSON_Object *obj = NULL;
+    size_t cnt = 0;
+
+    if (arr) {
+        cnt = json_array_get_count(arr);
+        obj = cnt ? json_array_get_object(arr, cnt - 1) : NULL;
+    } else {
+        obj = json_value_get_object(val);
+    }
+    if (!obj || !json_object_has_value_of_type(obj, "vsId", JSONNumber)) {
+        return NULL;
+    }
+    return obj;
+}
+
+static AMVP_RESULT amvp_verify_index_build(AMVP_CTX *ctx, AMVP_VERIFY_INDEX *index, JSON_Array *sets) {
+    JSON_Object *set = NULL, *group = NULL, *tc = NULL;
+    JSON_Array *groups = NULL, *tests = NULL;
+    AMVP_VERIFY_EXP *slot = NULL;
+    size_t i, j, k, count = 0;
+    int vs_id, tg_id, tc_id;
+
+    /* Sized for a load of at most half */
+    for (i = 0; i < json_array_get_count(sets); i++) {
+        groups = json_object_get_array(amvp_verify_set_obj(json_array_get_value(sets, i)), "testGroups");
+        for (j = 0; j < json_array_get_count(groups); j++) {
+            count += json_array_get_count(json_object_get_array(json_array_get_object(groups, j), "tests"));
+        }
+    }
+    index->slot_cnt = 16;
+    while (index->slot_cnt < count * 2) {
+        index->slot_cnt *= 2;
+    }
+    index->slots = calloc(index->slot_cnt, sizeof(AMVP_VERIFY_EXP));
+    if (!index->slots) {
+        return AMVP_MALLOC_FAIL;
+    }
+
+    for (i = 0; i < json_array_get_count(sets); i++) {
+        set = amvp_verify_set_obj(json_array_get_value(sets, i));
+        if (!set) {
+            continue;
+        }
+        vs_id = (int)json_object_get_number(set, "vsId");
+        groups = json_object_get_array(set, "testGroups");
+        for (j = 0; j < json_array_get_count(groups); j++) {
+            group = json_array_get_object(groups, j);
+            tg_id = (int)json_object_get_number(group, "tgId");
+            tests = json_object_get_array(group, "tests");
+            for (k = 0; k < json_array_get_count(tests); k++) {
+                tc = json_array_get_object(tests, k);
+                if (!tc) {
+                    continue;
+                }
+                tc_id = (int)json_object_get_number(tc, "tcId");
+                slot = amvp_verify_slot(index, vs_id, tg_id, tc_id);
+                if (slot->tc) {
+                    AMVP_LOG_WARN("Test case vsId %d tgId %d tcId %d is in the expected results twice",
+                                  vs_id, tg_id, tc_id);
+                    continue;
+                }
+                slot->vs_id = vs_id;
+                slot->tg_id = tg_id;
+                slot->tc_id = tc_id;
+                slot->tc = tc;
+            }
+        }
+    }
+    return AMVP_SUCCESS;
+}
+
+/*
+ * Whether got has everything expected has: same type, equal numbers and
+ * booleans, strings equal ignoring case, arrays element by element, and
+ * every member of an expected object
+ */
+static int amvp_verify_value_match(const JSON_Value *expected, const JSON_Value *got) {
+    const JSON_Object *eo = NULL, *go = NULL;
+    const JSON_Array *ea = NULL, *ga = NULL;
+    const char *es = NULL, *gs = NULL, *name = NULL;
+    size_t i, cnt, len;
+
+    if (!got || json_value_get_type(expected) != json_value_get_type(got)) {
+        return 0;
+    }
+    switch (json_value_get_type(expected)) {
+    case JSONString:
+        es = json_value_get_string(expected);
+        gs = json_value_get_string(got);
+        len = json_value_get_string_len(expected);
+        if (len != json_value_get_string_len(got)) {
+            return 0;
+        }
+        for (i = 0; i < len; i++) {
+            if (es[i] != gs[i] && tolower((unsigned char)es[i]) != tolower((unsigned char)gs[i])) {
+                return 0;
+            }
+        }
+        return 1;
+    case JSONNumber:
+        return json_value_get_number(expected) == json_value_get_number(got);
+    case JSONBoolean:
+        return json_value_get_boolean(expected) == json_value_get_boolean(got);
+    case JSONArray:
+        ea = json_value_get_array(expected);
+        ga = json_value_get_array(got);
+        cnt = json_array_get_count(ea);
+        if (cnt != json_array_get_count(ga)) {
+            return 0;
+        }
+        for (i = 0; i < cnt; i++) {
+            if (!amvp_verify_value_match(json_array_get_value(ea, i), json_array_get_value(ga, i))) {
+                return 0;
+            }
+        }
+        return 1;
+    case JSONObject:
+        eo = json_value_get_object(expected);
+        go = json_value_get_object(got);
+        cnt = json_object_get_count(eo);
+        for (i = 0; i < cnt; i++) {
+            name = json_object_get_name(eo, i);
+            if (!amvp_verify_value_match(json_object_get_value_at(eo, i), json_object_get_value(go, name))) {
+                return 0;
+            }
+        }
+        return 1;
+    default:
+        return 1;
+    }
+}
+
+/* The first member of the expected test case the response gets wrong, or NULL */
+static const char *amvp_verify_tc_diff(JSON_Object *expected, JSON_Object *got) {
+    const char *name = NULL;
+    size_t i, cnt = json_object_get_count(expected);
+    int diff = 1;
+
+    for (i = 0; i < cnt; i++) {
+        name = json_object_get_name(expected, i);
+        strcmp_s(name, sizeof("tcId"), "tcId", &diff);
+        if (!diff) {
+            continue;
+        }
+        if (!amvp_verify_value_match(json_object_get_value_at(expected, i), json_object_get_value(got, name))) {
+            return name;
+        }
+    }
+    return NULL;
+}
+
+/* Only reads the index, and only writes the test cases of its own range */
+static void amvp_verify_range(AMVP_VERIFY_JOB *job) {
+    AMVP_VERIFY_TC *tc = NULL;
+    AMVP_VERIFY_EXP *exp = NULL;
+    size_t i;
+
+    for (i = job->start; i < job->end; i++) {
+        tc = &job->tcs[i];
+        exp = amvp_verify_slot(job->index, job->sets[tc->vs].vs_id, tc->tg_id, tc->tc_id);
+        if (!exp->tc) {
+            continue;
+        }
+        tc->exp = exp;
+        tc->diff = amvp_verify_tc_diff(exp->tc, tc->tc);
+    }
+}
+
+#ifndef _WIN32
+static void *amvp_verify_main(void *arg) {
+    amvp_verify_range(arg);
+    return NULL;
+}
+#endif
+
+/*
+ * Checks all test cases, split over up to thread_cnt threads. On
+ * platforms without pthreads, or when a thread can't be started, the
+ * calling thread does the rest.
+ */
+static void amvp_verify_run(AMVP_CTX *ctx, AMVP_VERIFY_JOB *base, size_t count, int thread_cnt) {
+    AMVP_VERIFY_JOB *jobs = NULL;
+#ifndef _WIN32
+    pthread_t *tids = NULL;
+    int *started = NULL;
+#endif
+    size_t per = 0;
+    int i, n = 1;
+
+    if (thread_cnt > 1 && count >= 2 * AMVP_VERIFY_MIN_PER_THREAD) {
+        n = (int)(count / AMVP_VERIFY_MIN_PER_THREAD);
+        if (n > thread_cnt) n = thread_cnt;
+    }
+    jobs = calloc(n, sizeof(AMVP_VERIFY_JOB));
+#ifndef _WIN32
+    tids = calloc(n, sizeof(pthread_t));
+    started = calloc(n, sizeof(int));
+    if (!jobs || !tids || !started) {
+        n = 1;
+    }
+#else
+    n = 1;
+#endif
+    if (n == 1 || !jobs) {
+        base->start = 0;
+        base->end = count;
+        amvp_verify_range(base);
+        goto end;
+    }
+
+    per = (count + n - 1) / n;
+    for (i = 0; i < n; i++) {
+        jobs[i] = *base;
+        jobs[i].start = per * i;
+        jobs[i].end = per * (i + 1) < count ? per * (i + 1) : count;
+    }
+#ifndef _WIN32
+    /* The last range is the calling thread's */
+    for (i = 0; i < n - 1; i++) {
+        if (pthread_create(&tids[i], NULL, amvp_verify_main, &jobs[i])) {
+            AMVP_LOG_WARN("Unable to start a verification thread, continuing with fewer");
+            break;
+        }
+        started[i] = 1;
+    }
+    amvp_verify_range(&jobs[n - 1]);
+    for (i = 0; i < n - 1; i++) {
+        if (started[i]) {
+            pthread_join(tids[i], NULL);
+        } else {
+            amvp_verify_range(&jobs[i]);
+        }
+    }
+#endif
+    AMVP_LOG_INFO("Verified %lu test cases on %d threads", (unsigned long)count, n);
+
+end:
+    if (jobs) free(jobs);
+#ifndef _WIN32
+    if (tids) free(tids);
+    if (started) free(started);
+#endif
+}
+
+/* The entry for alg and mode, added if it isn't there yet */
+static AMVP_VERIFY_ALG *amvp_verify_alg(AMVP_VERIFY_ALG *algs, int *alg_cnt, const char *alg, const char *mode) {
+    int i, diff = 1;
+
+    for (i = 0; i < *alg_cnt; i++) {
+        if ((!algs[i].mode) != (!mode)) {
+            continue;
+        }
+        strcmp_s(algs[i].alg, AMVP_ALG_NAME_MAX, alg, &diff);
+        if (!diff && mode) {
+            strcmp_s(algs[i].mode, AMVP_ALG_MODE_MAX, mode, &diff);
+        }
+        if (!diff) {
+            return &algs[i];
+        }
+    }
+    algs[*alg_cnt].alg = alg;
+    algs[*alg_cnt].mode = mode;
+    return &algs[(*alg_cnt)++];
+}
+
+static void amvp_verify_log_fail(AMVP_CTX *ctx, AMVP_VERIFY_ALG *alg, int vs_id, int tg_id, int tc_id,
+                                 const char *what, const char *name) {
+    alg->failed++;
+    if (alg->logged++ >= AMVP_VERIFY_LOG_MAX) {
+        return;
+    }
+    if (name) {
+        AMVP_LOG_ERR("%s%s%s vsId %d tgId %d tcId %d: %s differs from the expected results", alg->alg,
+                     alg->mode ? " " : "", alg->mode ? alg->mode : "", vs_id, tg_id, tc_id, name);
+    } else {
+        AMVP_LOG_ERR("%s%s%s vsId %d tgId %d tcId %d: %s", alg->alg, alg->mode ? " " : "",
+                     alg->mode ? alg->mode : "", vs_id, tg_id, tc_id, what);
+    }
+}
+
+AMVP_RESULT amvp_verify_expected_results(AMVP_CTX *ctx, const char *rsp_filename,
+                                         const char *expected_filename, int *mismatches) {
+    JSON_Value *rsp_val = NULL, *exp_val = NULL;
+    JSON_Array *rsp_sets = NULL, *exp_sets = NULL, *groups = NULL, *tests = NULL;
+    JSON_Object *set = NULL, *group = NULL;
+    AMVP_VERIFY_INDEX index;
+    AMVP_VERIFY_VS *sets = NULL;
+    AMVP_VERIFY_TC *tcs = NULL;
+    AMVP_VERIFY_ALG *algs = NULL, *alg = NULL;
+    AMVP_VERIFY_JOB job;
+    AMVP_RESULT rv = AMVP_SUCCESS;
+    size_t i, j, k, set_cnt = 0, tc_cnt = 0, n = 0, v = 0;
+    int alg_cnt = 0, failed = 0, threads = 0, vs_id;
+
+    if (!ctx) {
+        return AMVP_NO_CTX;
+    }
+    if (mismatches) {
+        *mismatches = 0;
+    }
+    if (!rsp_filename || !expected_filename) {
+        AMVP_LOG_ERR("Must provide a response file and an expected results file");
+        return AMVP_MISSING_ARG;
+    }
+    if (strnlen_s(rsp_filename, AMVP_JSON_FILENAME_MAX + 1) > AMVP_JSON_FILENAME_MAX ||
+            strnlen_s(expected_filename, AMVP_JSON_FILENAME_MAX + 1) > AMVP_JSON_FILENAME_MAX) {
+        AMVP_LOG_ERR("Provided filename length > max(%d)", AMVP_JSON_FILENAME_MAX);
+        return AMVP_INVALID_ARG;
+    }
+    memzero_s(&index, sizeof(index));
+
+    rsp_val = json_parse_file(rsp_filename);
+    rsp_sets = json_value_get_array(rsp_val);
+    if (!rsp_sets) {
+        AMVP_LOG_ERR("Unable to parse response file %s", rsp_filename);
+        rv = AMVP_MALFORMED_JSON;
+        goto end;
+    }
+    exp_val = json_parse_file(expected_filename);
+    exp_sets = json_value_get_array(exp_val);
+    if (!exp_sets) {
+        AMVP_LOG_ERR("Unable to parse expected results file %s", expected_filename);
+        rv = AMVP_MALFORMED_JSON;
+        goto end;
+    }
+
+    rv = amvp_verify_index_build(ctx, &index, exp_sets);
+    if (rv != AMVP_SUCCESS) goto end;
+
+    /* Flatten the response test cases, so they can be split evenly */
+    set_cnt = json_array_get_count(rsp_sets);
+    for (i = 0; i < set_cnt; i++) {
+        groups = json_object_get_array(amvp_verify_set_obj(json_array_get_value(rsp_sets, i)), "testGroups");
+        for (j = 0; j < json_array_get_count(groups); j++) {
+            tc_cnt += json_array_get_count(json_object_get_array(json_array_get_object(groups, j), "tests"));
+        }
+    }
+    sets = calloc(set_cnt ? set_cnt : 1, sizeof(AMVP_VERIFY_VS));
+    tcs = calloc(tc_cnt ? tc_cnt : 1, sizeof(AMVP_VERIFY_TC));
+    algs = calloc(set_cnt + 1, sizeof(AMVP_VERIFY_ALG));
+    if (!sets || !tcs || !algs) {
+        rv = AMVP_MALLOC_FAIL;
+        goto end;
+    }
+    for (i = 0; i < set_cnt; i++) {
+        set = amvp_verify_set_obj(json_array_get_value(rsp_sets, i));
+        if (!set) {
+            continue;
+        }
+        sets[v].vs_id = (int)json_object_get_number(set, "vsId");
+        sets[v].alg = json_object_get_string(set, "algorithm");
+        sets[v].mode = json_object_get_string(set, "mode");
+        groups = json_object_get_array(set, "testGroups");
+        for (j = 0; j < json_array_get_count(groups); j++) {
+            group = json_array_get_object(groups, j);
+            tests = json_object_get_array(group, "tests");
+            for (k = 0; k < json_array_get_count(tests); k++) {
+                if (!json_array_get_object(tests, k)) {
+                    continue;
+                }
+                tcs[n].vs = (int)v;
+                tcs[n].tg_id = (int)json_object_get_number(group, "tgId");
+                tcs[n].tc = json_array_get_object(tests, k);
+                tcs[n].tc_id = (int)json_object_get_number(tcs[n].tc, "tcId");
+                n++;
+            }
+        }
+        v++;
+    }
+
+    memzero_s(&job, sizeof(job));
+    job.index = &index;
+    job.sets = sets;
+    job.tcs = tcs;
+    threads = ctx->worker_threads > 1 ? ctx->worker_threads : AMVP_VERIFY_THREADS;
+    amvp_verify_run(ctx, &job, n, threads);
+
+    /* Tally in file order, on this thread only */
+    for (i = 0; i < n; i++) {
+        alg = amvp_verify_alg(algs, &alg_cnt, sets[tcs[i].vs].alg ? sets[tcs[i].vs].alg : "unknown",
+                              sets[tcs[i].vs].mode);
+        alg->tcs++;
+        if (!tcs[i].exp) {
+            amvp_verify_log_fail(ctx, alg, sets[tcs[i].vs].vs_id, tcs[i].tg_id, tcs[i].tc_id,
+                                 "not in the expected results", NULL);
+            continue;
+        }
+        if (tcs[i].exp->seen++) {
+            amvp_verify_log_fail(ctx, alg, sets[tcs[i].vs].vs_id, tcs[i].tg_id, tcs[i].tc_id,
+                                 "responded to more than once", NULL);
+        } else if (tcs[i].diff) {
+            amvp_verify_log_fail(ctx, alg, sets[tcs[i].vs].vs_id, tcs[i].tg_id, tcs[i].tc_id,
+                                 NULL, tcs[i].diff);
+        }
+    }
+    /* Expected test cases of the response's vector sets that weren't answered */
+    for (i = 0; i < index.slot_cnt; i++) {
+        if (!index.slots[i].tc || index.slots[i].seen) {
+            continue;
+        }
+        vs_id = index.slots[i].vs_id;
+        for (j = 0; j < v && sets[j].vs_id != vs_id; j++);
+        if (j == v) {
+            continue;
+        }
+        alg = amvp_verify_alg(algs, &alg_cnt, sets[j].alg ? sets[j].alg : "unknown", sets[j].mode);
+        alg->tcs++;
+        amvp_verify_log_fail(ctx, alg, vs_id, index.slots[i].tg_id, index.slots[i].tc_id,
+                             "missing from the responses", NULL);
+    }
+
+    for (i = 0; i < (size_t)alg_cnt; i++) {
+        if (algs[i].failed) {
+            AMVP_LOG_STATUS("%s%s%s: %d of %d test cases did not match", algs[i].alg,
+                            algs[i].mode ? " " : "", algs[i].mode ? algs[i].mode : "",
+                            algs[i].failed, algs[i].tcs);
+        } else {
+            AMVP_LOG_STATUS("%s%s%s: all %d test cases match", algs[i].alg,
+                            algs[i].mode ? " " : "", algs[i].mode ? algs[i].mode : "", algs[i].tcs);
+        }
+        failed += algs[i].failed;
+    }
+    if (failed) {
+        AMVP_LOG_STATUS("Verification failed, %d test cases did not match the expected results", failed);
+    } else {
+        AMVP_LOG_STATUS("Verification passed, all test cases match the expected results");
+    }
+    if (mismatches) {
+        *mismatches = failed;
+    }
+
+end:
+    if (index.slots) free(index.slots);
+    if (sets) free(sets);
+    if (tcs) free(tcs);
+    if (algs) free(algs);
+    if (rsp_val) json_value_free(rsp_val);
+    if (exp_val) json_value_free(exp_val);
+    return rv;
+}
@@ -0,0 +1,806 @@
+/** @file */
+/*
+ * Copyright (c) 2021, Cisco Systems, Inc.
+ *
+ * Licensed under the Apache License 2.0 (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://github.com/cisco/libamvp/LICENSE
+ */
+
+/*
+ * A binary cache of a saved vector set request file, see
+ * amvp_set_vs_cache(). It is written next to the request file, with
+ * AMVP_VS_CACHE_EXT appended to its name, when the vector sets are saved
+ * and the first time the file is run offline. Later runs map the cache
+ * instead of parsing the JSON, as long as the request file still has the
+ * size and modification time recorded in the header. The time is kept to
+ * the nanosecond, where the file system has it, so a file rewritten with
+ * the same size within the same second isn't taken for the one cached.
+ *
+ * The file is laid out for the host that wrote it (byte order, sizes) and
+ * holds, after the header:
+ *
+ *   - the nodes, one fixed size record per JSON value. The members of an
+ *     object or array are consecutive nodes, so a test group's parameters
+ *     are a run of records next to each other.
+ *   - the index, one record per test case sorted by vsId then tcId, giving
+ *     the tgId and the node of the test case.
+ *   - the pool of member names and string values. Names are stored once.
+ *     A string made only of hex digits is followed, after its terminator,
+ *     by the bytes it decodes to, and amvp_view_to_bin() copies those
+ *     rather than decoding the string again.
+ *
+ * Loading turns the nodes back into a parson tree whose strings point into
+ * the mapping, so the handlers run unchanged. Nothing is tokenized,
+ * unescaped, copied or hex decoded.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "amvp.h"
+#include "amvp_lcl.h"
+#include "parson.h"
+#include "safe_lib.h"
+
+#define AMVP_VS_CACHE_MAGIC "AMVPVSC"
+#define AMVP_VS_CACHE_VERSION 2
+#define AMVP_VS_CACHE_NO_NAME 0xFFFFFFFFu
+#define AMVP_VS_CACHE_HEX 0x01          /* node flag, decoded bytes follow the string */
+#define AMVP_VS_CACHE_NAMES_MIN 256     /* name table slots to start with */
+#define AMVP_VS_CACHE_NAME_MAX 128      /* as parson limits member names */
+
+typedef struct amvp_vs_cache_hdr_t {
+    char magic[8];
+    uint32_t version;
+    uint32_t node_size;     /* catches a file written for another ABI */
+    uint64_t src_size;      /* of the request file the cache was made from */
+    int64_t src_mtime;
+    int64_t src_mtime_nsec;
+    uint64_t file_size;     /* catches a truncated cache */
+    uint32_t node_count;
+    uint32_t index_count;
+    uint64_t nodes_off;
+    uint64_t index_off;
+    uint64_t pool_off;
+    uint64_t pool_size;
+} AMVP_VS_CACHE_HDR;
+
+typedef struct amvp_vs_cache_node_t {
+    uint8_t type;           /* JSON_Value_Type */
+    uint8_t flags;
+    uint16_t reserved;
+    uint32_t name;          /* pool offset of the member name, AMVP_VS_CACHE_NO_NAME in arrays */
+    union {
+        struct {
+            uint32_t first; /* node of the first member, members are consecutive */
+            uint32_t count;
+        } kids;
+        struct {
+            uint32_t off;   /* pool offset of the terminated string */
+            uint32_t len;
+        } str;
+        double number;
+        int32_t boolean;
+    } u;
+} AMVP_VS_CACHE_NODE;
+
+typedef struct amvp_vs_cache_idx_t {
+    int32_t vs_id;
+    int32_t tc_id;
+    int32_t tg_id;
+    uint32_t node;
+} AMVP_VS_CACHE_IDX;
+
+/* The cache being built in memory before it is written out */
+typedef struct amvp_vs_cache_img_t {
+    AMVP_VS_CACHE_NODE *nodes;
+    size_t node_count;
+    size_t node_cap;
+    char *pool;
+    size_t pool_len;
+    size_t pool_cap;
+    uint32_t *names;        /* open addressing table of name offsets plus one */
+    size_t names_cap;
+    size_t names_used;
+    AMVP_VS_CACHE_IDX *index;
+    size_t index_count;
+    size_t index_cap;
+} AMVP_VS_CACHE_IMG;
+
+static void amvp_vs_cache_path(const char *req_filename, char *path, size_t path_max) {
+    strcpy_s(path, path_max, req_filename);
+    strcat_s(path, path_max, AMVP_VS_CACHE_EXT);
+}
+
+/* Fill in the src_ members of hdr from the request file */
+static int amvp_vs_cache_src_stat(const char *filename, AMVP_VS_CACHE_HDR *hdr) {
+    struct stat st;
+
+    if (stat(filename, &st)) {
+        return -1;
+    }
+    hdr->src_size = (uint64_t)st.st_size;
+    hdr->src_mtime = (int64_t)st.st_mtime;
+#if defined(__APPLE__)
+    hdr->src_mtime_nsec = (int64_t)st.st_mtimespec.tv_nsec;
+#elif defined(_WIN32)
+    hdr->src_mtime_nsec = 0;
+#else
+    hdr->src_mtime_nsec = (int64_t)st.st_mtim.tv_nsec;
+#endif
+    return 0;
+}
+
+/*
+ * Returns the first free node of a run of count, growing the array as
+ * needed. Callers hold indexes, not pointers, across this.
+ */
+static size_t amvp_vs_cache_alloc_nodes(AMVP_VS_CACHE_IMG *img, size_t count) {
+    size_t first = img->node_count;
+
+    if (img->node_count + count > img->node_cap) {
+        size_t cap = img->node_cap ? img->node_cap : 1024;
+        AMVP_VS_CACHE_NODE *nodes = NULL;
+
+        while (cap < img->node_count + count) cap *= 2;
+        nodes = realloc(img->nodes, cap * sizeof(AMVP_VS_CACHE_NODE));
+        if (!nodes) {
+            return (size_t)-1;
+        }
+        img->nodes = nodes;
+        img->node_cap = cap;
+    }
+    memzero_s(img->nodes + first, count * sizeof(AMVP_VS_CACHE_NODE));
+    img->node_count += count;
+    return first;
+}
+
+/* Reserve len bytes of pool, returning their offset */
+static size_t amvp_vs_cache_alloc_pool(AMVP_VS_CACHE_IMG *img, size_t len) {
+    size_t off = img->pool_len;
+
+    if (img->pool_len + len > UINT32_MAX) {
+        return (size_t)-1;
+    }
+    if (img->pool_len + len > img->pool_cap) {
+        size_t cap = img->pool_cap ? img->pool_cap : 64 * 1024;
+        char *pool = NULL;
+
+        while (cap < img->pool_len + len) cap *= 2;
+        pool = realloc(img->pool, cap);
+        if (!pool) {
+            return (size_t)-1;
+        }
+        img->pool = pool;
+        img->pool_cap = cap;
+    }
+    img->pool_len += len;
+    return off;
+}
+
+static unsigned long amvp_vs_cache_hash(const char *name, size_t len) {
+    unsigned long hash = 5381;
+    size_t i;
+
+    for (i = 0; i < len; i++) {
+        hash = ((hash << 5) + hash) + (unsigned char)name[i];
+    }
+    return hash;
+}
+
+static int amvp_vs_cache_grow_names(AMVP_VS_CACHE_IMG *img) {
+    size_t cap = img->names_cap ? img->names_cap * 2 : AMVP_VS_CACHE_NAMES_MIN;
+    uint32_t *names = calloc(cap, sizeof(uint32_t));
+    size_t i, slot;
+
+    if (!names) {
+        return -1;
+    }
+    for (i = 0; i < img->names_cap; i++) {
+        const char *name = NULL;
+
+        if (!img->names[i]) continue;
+        name = img->pool + img->names[i] - 1;
+        slot = amvp_vs_cache_hash(name, strnlen_s(name, AMVP_VS_CACHE_NAME_MAX)) & (cap - 1);
+        while (names[slot]) slot = (slot + 1) & (cap - 1);
+        names[slot] = img->names[i];
+    }
+    free(img->names);
+    img->names = names;
+    img->names_cap = cap;
+    return 0;
+}
+
+/* The pool offset of name, added the first time it is seen */
+static size_t amvp_vs_cache_add_name(AMVP_VS_CACHE_IMG *img, const char *name) {
+    size_t len = strnlen_s(name, AMVP_VS_CACHE_NAME_MAX);
+    size_t slot, off;
+
+    if ((img->names_used + 1) * 2 > img->names_cap && amvp_vs_cache_grow_names(img)) {
+        return (size_t)-1;
+    }
+    slot = amvp_vs_cache_hash(name, len) & (img->names_cap - 1);
+    while (img->names[slot]) {
+        off = img->names[slot] - 1;
+        if (!strncmp(img->pool + off, name, len + 1)) {
+            return off;
+        }
+        slot = (slot + 1) & (img->names_cap - 1);
+    }
+    off = amvp_vs_cache_alloc_pool(img, len + 1);
+    if (off == (size_t)-1 || off + 1 > UINT32_MAX) {
+        return (size_t)-1;
+    }
+    memcpy_s(img->pool + off, len + 1, name, len);
+    img->pool[off + len] = '\0';
+    img->names[slot] = (uint32_t)(off + 1);
+    img->names_used++;
+    return off;
+}
+
+static int amvp_vs_cache_is_hex(const char *str, size_t len) {
+    size_t i;
+
+    if (!len || len > AMVP_HEXSTR_MAX) {
+        return 0;
+    }
+    for (i = 0; i < len; i++) {
+        char c = str[i];
+
+        if (!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F'))) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* Store a string value, followed by its decoded bytes when it is hex */
+static int amvp_vs_cache_add_string(AMVP_VS_CACHE_IMG *img, size_t n, const JSON_Value *val) {
+    AMVP_STR_VIEW view = { NULL, 0, NULL };
+    size_t off = 0, bin_len = 0;
+    int hex = 0;
+
+    view.str = json_value_get_string(val);
+    view.len = json_value_get_string_len(val);
+    if (view.len > UINT32_MAX) {
+        return -1;
+    }
+    hex = amvp_vs_cache_is_hex(view.str, view.len);
+    if (hex) {
+        bin_len = (view.len + 1) / 2;
+    }
+    off = amvp_vs_cache_alloc_pool(img, view.len + 1 + bin_len);
+    if (off == (size_t)-1) {
+        return -1;
+    }
+    memcpy_s(img->pool + off, view.len + 1, view.str, view.len);
+    img->pool[off + view.len] = '\0';
+    if (hex && amvp_view_to_bin(view, (unsigned char *)img->pool + off + view.len + 1,
+                                (int)bin_len, NULL) != AMVP_SUCCESS) {
+        return -1;
+    }
+    img->nodes[n].flags = hex ? AMVP_VS_CACHE_HEX : 0;
+    img->nodes[n].u.str.off = (uint32_t)off;
+    img->nodes[n].u.str.len = (uint32_t)view.len;
+    return 0;
+}
+
+/* Fill node n, already allocated, from val and its members */
+static int amvp_vs_cache_add_value(AMVP_VS_CACHE_IMG *img, size_t n, const JSON_Value *val) {
+    JSON_Object *obj = NULL;
+    JSON_Array *arr = NULL;
+    size_t count = 0, first = 0, i, name;
+
+    img->nodes[n].type = (uint8_t)json_value_get_type(val);
+    switch (json_value_get_type(val)) {
+    case JSONString:
+        return amvp_vs_cache_add_string(img, n, val);
+    case JSONNumber:
+        img->nodes[n].u.number = json_value_get_number(val);
+        return 0;
+    case JSONBoolean:
+        img->nodes[n].u.boolean = json_value_get_boolean(val);
+        return 0;
+    case JSONObject:
+        obj = json_value_get_object(val);
+        count = json_object_get_count(obj);
+        break;
+    case JSONArray:
+        arr = json_value_get_array(val);
+        count = json_array_get_count(arr);
+        break;
+    case JSONNull:
+        return 0;
+    case JSONError:
+    default:
+        return -1;
+    }
+
+    first = amvp_vs_cache_alloc_nodes(img, count);
+    if (first == (size_t)-1 || first + count > UINT32_MAX) {
+        return -1;
+    }
+    img->nodes[n].u.kids.first = (uint32_t)first;
+    img->nodes[n].u.kids.count = (uint32_t)count;
+    for (i = 0; i < count; i++) {
+        if (obj) {
+            name = amvp_vs_cache_add_name(img, json_object_get_name(obj, i));
+            if (name == (size_t)-1) {
+                return -1;
+            }
+            img->nodes[first + i].name = (uint32_t)name;
+            if (amvp_vs_cache_add_value(img, first + i, json_object_get_value_at(obj, i))) {
+                return -1;
+            }
+        } else {
+            img->nodes[first + i].name = AMVP_VS_CACHE_NO_NAME;
+            if (amvp_vs_cache_add_value(img, first + i, json_array_get_value(arr, i))) {
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+/*
+ * The member name of object node n, or -1. pool is known to be terminated
+ * at the names of checked nodes.
+ */
+static long amvp_vs_cache_member(const AMVP_VS_CACHE_NODE *nodes, const char *pool,
+                                 size_t n, const char *name) {
+    uint32_t i;
+
+    if (nodes[n].type != JSONObject) {
+        return -1;
+    }
+    for (i = 0; i < nodes[n].u.kids.count; i++) {
+        const AMVP_VS_CACHE_NODE *kid = &nodes[nodes[n].u.kids.first + i];
+
+        if (!strncmp(pool + kid->name, name, AMVP_VS_CACHE_NAME_MAX)) {
+            return (long)(nodes[n].u.kids.first + i);
+        }
+    }
+    return -1;
+}
+
+static int amvp_vs_cache_member_int(const AMVP_VS_CACHE_IMG *img, size_t n, const char *name,
+                                    int32_t *out) {
+    long m = amvp_vs_cache_member(img->nodes, img->pool, n, name);
+
+    if (m < 0 || img->nodes[m].type != JSONNumber) {
+        return -1;
+    }
+    *out = (int32_t)img->nodes[m].u.number;
+    return 0;
+}
+
+static int amvp_vs_cache_idx_cmp(const void *a, const void *b) {
+    const AMVP_VS_CACHE_IDX *x = a, *y = b;
+
+    if (x->vs_id != y->vs_id) return x->vs_id < y->vs_id ? -1 : 1;
+    if (x->tc_id != y->tc_id) return x->tc_id < y->tc_id ? -1 : 1;
+    return 0;
+}
+
+/*
+ * Index the test cases of the vector sets, elements of the root array
+ * other than the session identifiers.
+ */
+static int amvp_vs_cache_add_index(AMVP_VS_CACHE_IMG *img) {
+    const AMVP_VS_CACHE_NODE *root = &img->nodes[0];
+    AMVP_VS_CACHE_IDX rec;
+    uint32_t v, g, t;
+    long groups, tests;
+
+    if (root->type != JSONArray) {
+        return -1;
+    }
+    for (v = 0; v < root->u.kids.count; v++) {
+        size_t vs = root->u.kids.first + v;
+
+        if (amvp_vs_cache_member_int(img, vs, "vsId", &rec.vs_id)) continue;
+        groups = amvp_vs_cache_member(img->nodes, img->pool, vs, "testGroups");
+        if (groups < 0 || img->nodes[groups].type != JSONArray) continue;
+
+        for (g = 0; g < img->nodes[groups].u.kids.count; g++) {
+            size_t tg = img->nodes[groups].u.kids.first + g;
+
+            if (amvp_vs_cache_member_int(img, tg, "tgId", &rec.tg_id)) continue;
+            tests = amvp_vs_cache_member(img->nodes, img->pool, tg, "tests");
+            if (tests < 0 || img->nodes[tests].type != JSONArray) continue;
+
+            for (t = 0; t < img->nodes[tests].u.kids.count; t++) {
+                rec.node = img->nodes[tests].u.kids.first + t;
+                if (amvp_vs_cache_member_int(img, rec.node, "tcId", &rec.tc_id)) continue;
+
+                if (img->index_count == img->index_cap) {
+                    size_t cap = img->index_cap ? img->index_cap * 2 : 256;
+                    AMVP_VS_CACHE_IDX *index = realloc(img->index, cap * sizeof(AMVP_VS_CACHE_IDX));
+
+                    if (!index) {
+                        return -1;
+                    }
+                    img->index = index;
+                    img->index_cap = cap;
+                }
+                img->index[img->index_count++] = rec;
+            }
+        }
+    }
+    if (img->index_count) {
+        qsort(img->index, img->index_count, sizeof(AMVP_VS_CACHE_IDX), amvp_vs_cache_idx_cmp);
+    }
+    return 0;
+}
+
+static void amvp_vs_cache_img_free(AMVP_VS_CACHE_IMG *img) {
+    free(img->nodes);
+    free(img->pool);
+    free(img->names);
+    free(img->index);
+    memzero_s(img, sizeof(AMVP_VS_CACHE_IMG));
+}
+
+/* Offset of the next section, keeping the nodes and index aligned */
+static uint64_t amvp_vs_cache_align(uint64_t off) {
+    return (off + 7) & ~(uint64_t)7;
+}
+
+static int amvp_vs_cache_put(FILE *fp, const void *data, size_t len, uint64_t at) {
+    static const char zeros[8] = { 0 };
+    long pos = ftell(fp);
+
+    if (pos < 0 || (uint64_t)pos > at || at - (uint64_t)pos > sizeof(zeros)) {
+        return -1;
+    }
+    if (at > (uint64_t)pos && fwrite(zeros, 1, (size_t)(at - (uint64_t)pos), fp) != at - (uint64_t)pos) {
+        return -1;
+    }
+    if (len && fwrite(data, 1, len, fp) != len) {
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Write the cache of req_filename, whose parsed contents are val
+ */
+AMVP_RESULT amvp_vs_cache_write(AMVP_CTX *ctx, const char *req_filename, const JSON_Value *val) {
+    char path[AMVP_JSON_FILENAME_MAX + sizeof(AMVP_VS_CACHE_EXT)];
+    AMVP_VS_CACHE_IMG img;
+    AMVP_VS_CACHE_HDR hdr;
+    AMVP_RESULT rv = AMVP_SUCCESS;
+    FILE *fp = NULL;
+
+    if (!ctx) {
+        return AMVP_NO_CTX;
+    }
+    if (!req_filename || !val) {
+        return AMVP_MISSING_ARG;
+    }
+    if (strnlen_s(req_filename, AMVP_JSON_FILENAME_MAX + 1) > AMVP_JSON_FILENAME_MAX) {
+        return AMVP_INVALID_ARG;
+    }
+    amvp_vs_cache_path(req_filename, path, sizeof(path));
+    memzero_s(&img, sizeof(img));
+    memzero_s(&hdr, sizeof(hdr));
+
+    if (amvp_vs_cache_src_stat(req_filename, &hdr)) {
+        AMVP_LOG_ERR("Unable to stat %s", req_filename);
+        return AMVP_INVALID_ARG;
+    }
+    if (amvp_vs_cache_alloc_nodes(&img, 1) == (size_t)-1 ||
+        amvp_vs_cache_add_value(&img, 0, val) ||
+        amvp_vs_cache_add_index(&img)) {
+        AMVP_LOG_ERR("Unable to build the vector set cache of %s", req_filename);
+        rv = AMVP_MALLOC_FAIL;
+        goto end;
+    }
+
+    strcpy_s(hdr.magic, sizeof(hdr.magic), AMVP_VS_CACHE_MAGIC);
+    hdr.version = AMVP_VS_CACHE_VERSION;
+    hdr.node_size = sizeof(AMVP_VS_CACHE_NODE);
+    hdr.node_count = (uint32_t)img.node_count;
+    hdr.index_count = (uint32_t)img.index_count;
+    hdr.nodes_off = amvp_vs_cache_align(sizeof(hdr));
+    hdr.index_off = amvp_vs_cache_align(hdr.nodes_off + img.node_count * sizeof(AMVP_VS_CACHE_NODE));
+    hdr.pool_off = hdr.index_off + img.index_count * sizeof(AMVP_VS_CACHE_IDX);
+    hdr.pool_size = img.pool_len;
+    hdr.file_size = hdr.pool_off + hdr.pool_size;
+
+    fp = fopen(path, "wb");
+    if (!fp) {
+        AMVP_LOG_ERR("Unable to open %s for writing", path);
+        rv = AMVP_JSON_ERR;
+        goto end;
+    }
+    if (amvp_vs_cache_put(fp, &hdr, sizeof(hdr), 0) ||
+        amvp_vs_cache_put(fp, img.nodes, img.node_count * sizeof(AMVP_VS_CACHE_NODE), hdr.nodes_off) ||
+        amvp_vs_cache_put(fp, img.index, img.index_count * sizeof(AMVP_VS_CACHE_IDX), hdr.index_off) ||
+        amvp_vs_cache_put(fp, img.pool, img.pool_len, hdr.pool_off)) {
+        rv = AMVP_JSON_ERR;
+    }
+    if (fclose(fp) == EOF) {
+        rv = AMVP_JSON_ERR;
+    }
+    if (rv != AMVP_SUCCESS) {
+        AMVP_LOG_ERR("File write error on %s", path);
+        remove(path);
+        goto end;
+    }
+    AMVP_LOG_INFO("Wrote vector set cache %s (%u test cases indexed)", path, hdr.index_count);
+end:
+    amvp_vs_cache_img_free(&img);
+    return rv;
+}
+
+#ifdef _WIN32
+static AMVP_RESULT amvp_vs_cache_map_file(AMVP_VS_CACHE_MAP *map, const char *filename) {
+    FILE *fp = NULL;
+    long len = 0;
+    char *buf = NULL;
+
+    fp = fopen(filename, "rb");
+    if (!fp) {
+        return AMVP_JSON_ERR;
+    }
+    if (fseek(fp, 0, SEEK_END) || (len = ftell(fp)) <= 0 || fseek(fp, 0, SEEK_SET)) {
+        fclose(fp);
+        return AMVP_JSON_ERR;
+    }
+    buf = malloc(len);
+    if (!buf) {
+        fclose(fp);
+        return AMVP_MALLOC_FAIL;
+    }
+    if (fread(buf, 1, len, fp) != (size_t)len) {
+        free(buf);
+        fclose(fp);
+        return AMVP_JSON_ERR;
+    }
+    fclose(fp);
+    map->data = buf;
+    map->size = (size_t)len;
+    return AMVP_SUCCESS;
+}
+#else
+static AMVP_RESULT amvp_vs_cache_map_file(AMVP_VS_CACHE_MAP *map, const char *filename) {
+    struct stat st;
+    void *data = NULL;
+    int fd = -1;
+
+    fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        return AMVP_JSON_ERR;
+    }
+    if (fstat(fd, &st) || st.st_size <= 0) {
+        close(fd);
+        return AMVP_JSON_ERR;
+    }
+    data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return AMVP_JSON_ERR;
+    }
+    map->data = data;
+    map->size = (size_t)st.st_size;
+    return AMVP_SUCCESS;
+}
+#endif
+
+void amvp_vs_cache_unmap(AMVP_VS_CACHE_MAP *map) {
+    if (!map || !map->data) {
+        return;
+    }
+#ifdef _WIN32
+    free((void *)map->data);
+#else
+    munmap((void *)map->data, map->size);
+#endif
+    memzero_s(map, sizeof(AMVP_VS_CACHE_MAP));
+}
+
+static const AMVP_VS_CACHE_HDR *amvp_vs_cache_hdr(const AMVP_VS_CACHE_MAP *map) {
+    return (const AMVP_VS_CACHE_HDR *)map->data;
+}
+
+static const AMVP_VS_CACHE_NODE *amvp_vs_cache_nodes(const AMVP_VS_CACHE_MAP *map) {
+    return (const AMVP_VS_CACHE_NODE *)(map->data + amvp_vs_cache_hdr(map)->nodes_off);
+}
+
+static const char *amvp_vs_cache_pool(const AMVP_VS_CACHE_MAP *map) {
+    return map->data + amvp_vs_cache_hdr(map)->pool_off;
+}
+
+/*
+ * Check the header and sections of a mapped cache, and that it was made
+ * from the request file as it is now
+ */
+static int amvp_vs_cache_check(const AMVP_VS_CACHE_MAP *map, const AMVP_VS_CACHE_HDR *src) {
+    const AMVP_VS_CACHE_HDR *hdr = amvp_vs_cache_hdr(map);
+
+    if (map->size < sizeof(AMVP_VS_CACHE_HDR) ||
+        memcmp(hdr->magic, AMVP_VS_CACHE_MAGIC, sizeof(AMVP_VS_CACHE_MAGIC)) ||
+        hdr->version != AMVP_VS_CACHE_VERSION ||
+        hdr->node_size != sizeof(AMVP_VS_CACHE_NODE) ||
+        hdr->file_size != map->size) {
+        return -1;
+    }
+    if (hdr->src_size != src->src_size || hdr->src_mtime != src->src_mtime ||
+        hdr->src_mtime_nsec != src->src_mtime_nsec) {
+        return -1;
+    }
+    if (!hdr->node_count || hdr->nodes_off & 7 || hdr->index_off & 7 ||
+        hdr->nodes_off + (uint64_t)hdr->node_count * sizeof(AMVP_VS_CACHE_NODE) > hdr->index_off ||
+        hdr->index_off + (uint64_t)hdr->index_count * sizeof(AMVP_VS_CACHE_IDX) > hdr->pool_off ||
+        hdr->pool_off + hdr->pool_size != hdr->file_size || !hdr->pool_size) {
+        return -1;
+    }
+    return 0;
+}
+
+/* Turn node n and its members back into a JSON value, or NULL */
+static JSON_Value *amvp_vs_cache_value(const AMVP_VS_CACHE_MAP *map, uint32_t n) {
+    const AMVP_VS_CACHE_HDR *hdr = amvp_vs_cache_hdr(map);
+    const AMVP_VS_CACHE_NODE *node = &amvp_vs_cache_nodes(map)[n];
+    const char *pool = amvp_vs_cache_pool(map);
+    JSON_Value *val = NULL, *kid = NULL;
+    uint32_t i;
+
+    switch (node->type) {
+    case JSONString:
+        if ((uint64_t)node->u.str.off + node->u.str.len + 1 > hdr->pool_size ||
+            pool[node->u.str.off + node->u.str.len] != '\0') {
+            return NULL;
+        }
+        if (node->flags & AMVP_VS_CACHE_HEX &&
+            (uint64_t)node->u.str.off + node->u.str.len + 1 + (node->u.str.len + 1) / 2 > hdr->pool_size) {
+            return NULL;
+        }
+        return json_value_init_string_ref(pool + node->u.str.off, node->u.str.len,
+                                          node->flags & AMVP_VS_CACHE_HEX);
+    case JSONNumber:
+        return json_value_init_number(node->u.number);
+    case JSONBoolean:
+        return json_value_init_boolean(node->u.boolean);
+    case JSONNull:
+        return json_value_init_null();
+    case JSONObject:
+    case JSONArray:
+        break;
+    default:
+        return NULL;
+    }
+
+    /* Members always come after their parent, so this can't loop */
+    if (node->u.kids.first <= n ||
+        (uint64_t)node->u.kids.first + node->u.kids.count > hdr->node_count) {
+        return NULL;
+    }
+    val = node->type == JSONObject ? json_value_init_object() : json_value_init_array();
+    if (!val) {
+        return NULL;
+    }
+    for (i = 0; i < node->u.kids.count; i++) {
+        uint32_t k = node->u.kids.first + i;
+        uint32_t name = amvp_vs_cache_nodes(map)[k].name;
+
+        kid = amvp_vs_cache_value(map, k);
+        if (!kid) {
+            goto err;
+        }
+        if (node->type == JSONObject) {
+            if (name >= hdr->pool_size || !memchr(pool + name, '\0', (size_t)(hdr->pool_size - name)) ||
+                json_object_set_value(json_value_get_object(val), pool + name, kid) != JSONSuccess) {
+                goto err;
+            }
+        } else if (json_array_append_value(json_value_get_array(val), kid) != JSONSuccess) {
+            goto err;
+        }
+    }
+    return val;
+err:
+    json_value_free(kid);
+    json_value_free(val);
+    return NULL;
+}
+
+/*
+ * Map the cache of req_filename and rebuild the request file's contents
+ * from it. The strings of *val point into map, so it has to stay mapped
+ * until *val is freed. Returns AMVP_NO_DATA when there is no usable cache.
+ */
+AMVP_RESULT amvp_vs_cache_load(AMVP_CTX *ctx, const char *req_filename, AMVP_VS_CACHE_MAP *map,
+                               JSON_Value **val) {
+    char path[AMVP_JSON_FILENAME_MAX + sizeof(AMVP_VS_CACHE_EXT)];
+    AMVP_VS_CACHE_HDR src;
+
+    if (!ctx) {
+        return AMVP_NO_CTX;
+    }
+    if (!req_filename || !map || !val) {
+        return AMVP_MISSING_ARG;
+    }
+    if (strnlen_s(req_filename, AMVP_JSON_FILENAME_MAX + 1) > AMVP_JSON_FILENAME_MAX) {
+        return AMVP_INVALID_ARG;
+    }
+    memzero_s(map, sizeof(AMVP_VS_CACHE_MAP));
+    memzero_s(&src, sizeof(src));
+    *val = NULL;
+    amvp_vs_cache_path(req_filename, path, sizeof(path));
+
+    if (amvp_vs_cache_src_stat(req_filename, &src) ||
+        amvp_vs_cache_map_file(map, path) != AMVP_SUCCESS) {
+        return AMVP_NO_DATA;
+    }
+    if (amvp_vs_cache_check(map, &src)) {
+        AMVP_LOG_INFO("Vector set cache %s is out of date, ignoring it", path);
+        amvp_vs_cache_unmap(map);
+        return AMVP_NO_DATA;
+    }
+    *val = amvp_vs_cache_value(map, 0);
+    if (!*val) {
+        AMVP_LOG_WARN("Vector set cache %s is corrupt, ignoring it", path);
+        amvp_vs_cache_unmap(map);
+        return AMVP_NO_DATA;
+    }
+    return AMVP_SUCCESS;
+}
+
+/*
+ * Parse req_filename through its cache: load the cache when it is current,
+ * otherwise parse the JSON and write the cache for the next run.
+ */
+JSON_Value *amvp_vs_cache_open(AMVP_CTX *ctx, const char *req_filename, AMVP_VS_CACHE_MAP *map) {
+    JSON_Value *val = NULL;
+
+    if (amvp_vs_cache_load(ctx, req_filename, map, &val) == AMVP_SUCCESS) {
+        AMVP_LOG_STATUS("Loaded vector sets from the cache of %s", req_filename);
+        return val;
+    }
+    val = json_parse_file(req_filename);
+    if (val && amvp_vs_cache_write(ctx, req_filename, val) != AMVP_SUCCESS) {
+        AMVP_LOG_WARN("Unable to write the vector set cache of %s, continuing", req_filename);
+    }
+    return val;
+}
+
+/*
+ * Look up one test case through the index of a loaded cache. *tc is a
+ * copy of the test case, for the caller to free, whose strings point
+ * into map.
+ */
+AMVP_RESULT amvp_vs_cache_find(const AMVP_VS_CACHE_MAP *map, int vs_id, int tc_id, int *tg_id,
+                               JSON_Value **tc) {
+    const AMVP_VS_CACHE_HDR *hdr = NULL;
+    const AMVP_VS_CACHE_IDX *hit = NULL;
+    AMVP_VS_CACHE_IDX key;
+
+    if (!map || !map->data || !tc) {
+        return AMVP_MISSING_ARG;
+    }
+    hdr = amvp_vs_cache_hdr(map);
+    key.vs_id = vs_id;
+    key.tc_id = tc_id;
+    hit = bsearch(&key, map->data + hdr->index_off, hdr->index_count, sizeof(AMVP_VS_CACHE_IDX),
+                  amvp_vs_cache_idx_cmp);
+    if (!hit || hit->node >= hdr->node_count) {
+        return AMVP_NO_DATA;
+    }
+    *tc = amvp_vs_cache_value(map, hit->node);
+    if (!*tc) {
+        return AMVP_MALFORMED_JSON;
+    }
+    if (tg_id) *tg_id = hit->tg_id;
+    return AMVP_SUCCESS;
+}
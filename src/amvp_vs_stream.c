@@ -0,0 +1,513 @@
+/** @file */
+/*
+ * Copyright (c) 2021, Cisco Systems, Inc.
+ *
+ * Licensed under the Apache License 2.0 (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://github.com/cisco/libamvp/LICENSE
+ */
+
+/*
+ * Processes the test groups of a vector set while it is still being
+ * downloaded, enabled with amvp_set_incremental_parse().
+ *
+ * Each chunk curl hands amvp_curl_write_callback() is scanned as it
+ * arrives, keeping track of strings and nesting. Once the testGroups array
+ * of the vector set starts, everything of the set before it is copied out
+ * as the header, and then each group is copied out as soon as its closing
+ * brace arrives. A worker thread parses these and runs the handler on the
+ * header with one group in it, so parsing and crypto overlap with the rest
+ * of the download. On Windows there is no worker and this is done in the
+ * write callback itself.
+ *
+ * The handler is called once per group, and builds one response over all
+ * of them. ctx->kat_rsp_cont tells amvp_jw_begin_vs_rsp() and
+ * amvp_jw_end_vs_rsp() to keep a streamed response open between calls.
+ * Responses built with parson are moved into the response of the first
+ * group instead.
+ *
+ * Anything unexpected, like a member after testGroups, another response
+ * starting after groups were handed out, or a body that doesn't end where
+ * it should, drops the groups handled so far. The caller then parses and
+ * processes the whole body the usual way, so what comes out is the same
+ * either way.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+#include "amvp.h"
+#include "amvp_lcl.h"
+#include "parson.h"
+#include "safe_lib.h"
+
+#define AMVP_VS_STREAM_KEY "testGroups"
+
+/* A copy of the header, or of one test group, for the worker */
+typedef struct amvp_vs_stream_job_t {
+    struct amvp_vs_stream_job_t *next;
+    char data[1];               /* Terminated, parsed in place */
+} AMVP_VS_STREAM_JOB;
+
+struct amvp_vs_stream_t {
+    AMVP_VS_DISPATCH_CB dispatch;
+
+    /* Scanner, only used by the thread receiving the body */
+    size_t pos;                 /* Bytes of ctx->curl_buf scanned */
+    int depth;
+    int in_str;
+    size_t str_start;           /* Offset of the first character of the current string */
+    int key;                    /* The last string at depth 2 was testGroups, waiting for its value */
+    int in_groups;              /* Inside the testGroups array */
+    int after_groups;           /* The testGroups array has been closed */
+    size_t elem_start;          /* Offset of the '{' of the vector set */
+    size_t group_start;         /* Offset of the '{' of the current group */
+    int groups;                 /* Groups handed to the worker */
+    int queued;                 /* Anything, the header included, handed to the worker */
+    int stop;                   /* Stopped scanning, the stream is abandoned */
+
+    /* Shared with the worker */
+#ifndef _WIN32
+    pthread_t tid;
+    pthread_mutex_t lock;
+    pthread_cond_t cv;
+    int started;
+#endif
+    AMVP_VS_STREAM_JOB *head;
+    AMVP_VS_STREAM_JOB *tail;
+    int done;                   /* The body is complete, no more jobs */
+    int abandon;                /* Leave the body to be processed as a whole */
+    AMVP_RESULT rv;             /* Error from a handler */
+
+    /* Worker */
+    AMVP_VS_STREAM_JOB *hdr;    /* Keeps the header's strings */
+    JSON_Value *hdr_val;
+    JSON_Array *hdr_groups;     /* Empty between groups */
+    JSON_Value *master;         /* Parson built response the later groups are moved into */
+    int dispatched;
+};
+
+static void amvp_vs_stream_lock(AMVP_VS_STREAM *s) {
+#ifndef _WIN32
+    pthread_mutex_lock(&s->lock);
+#else
+    (void)s;
+#endif
+}
+
+static void amvp_vs_stream_unlock(AMVP_VS_STREAM *s) {
+#ifndef _WIN32
+    pthread_mutex_unlock(&s->lock);
+#else
+    (void)s;
+#endif
+}
+
+/*
+ * Moves the groups of the response the handler just built into the
+ * response of the first group, for handlers that build ctx->kat_resp
+ */
+static AMVP_RESULT amvp_vs_stream_merge(AMVP_CTX *ctx, AMVP_VS_STREAM *s) {
+    JSON_Array *to = NULL, *from = NULL;
+
+    if (!ctx->kat_resp) {
+        return AMVP_SUCCESS;
+    }
+    if (!s->master) {
+        s->master = ctx->kat_resp;
+        ctx->kat_resp = NULL;
+        return AMVP_SUCCESS;
+    }
+    to = json_object_get_array(json_array_get_object(json_value_get_array(s->master), 0), "testGroups");
+    from = json_object_get_array(json_array_get_object(json_value_get_array(ctx->kat_resp), 0), "testGroups");
+    if (!to || !from || json_array_move_values(to, from) != JSONSuccess) {
+        AMVP_LOG_ERR("Failed to merge the responses of a streamed vector set");
+        return AMVP_JSON_ERR;
+    }
+    json_value_free(ctx->kat_resp);
+    ctx->kat_resp = NULL;
+    return AMVP_SUCCESS;
+}
+
+/*
+ * Parses a job and, for a group, runs the handler on it. Returns
+ * AMVP_MALFORMED_JSON for a job that can't be streamed, which makes the
+ * caller fall back to the whole body.
+ */
+static AMVP_RESULT amvp_vs_stream_run(AMVP_CTX *ctx, AMVP_VS_STREAM *s, AMVP_VS_STREAM_JOB *job) {
+    AMVP_VS_METRICS_REC *rec = amvp_metrics_cur(ctx);
+    JSON_Object *hdr = NULL;
+    JSON_Value *group = NULL;
+    AMVP_RESULT rv = AMVP_SUCCESS;
+    double start = 0;
+
+    if (rec) start = amvp_metrics_now();
+    if (!s->hdr) {
+        /* The header is the first job, its testGroups closed off empty */
+        s->hdr = job;
+        AMVP_TRACE1(json__parse__start, (const char *)job->data);
+        s->hdr_val = json_parse_string_in_place(job->data);
+        AMVP_TRACE2(json__parse__done, (const char *)job->data, s->hdr_val != NULL);
+        hdr = json_value_get_object(s->hdr_val);
+        s->hdr_groups = json_object_get_array(hdr, AMVP_VS_STREAM_KEY);
+        if (rec) rec->m.parse_ms += amvp_metrics_now() - start;
+        /* What the handler needs from the set has to come before the groups */
+        if (!s->hdr_groups || !json_object_has_value(hdr, "vsId") ||
+                !json_object_has_value(hdr, "algorithm")) {
+            return AMVP_MALFORMED_JSON;
+        }
+        return AMVP_SUCCESS;
+    }
+
+    AMVP_TRACE1(json__parse__start, (const char *)job->data);
+    group = json_parse_string_in_place(job->data);
+    AMVP_TRACE2(json__parse__done, (const char *)job->data, group != NULL);
+    if (rec) rec->m.parse_ms += amvp_metrics_now() - start;
+    if (!json_value_get_object(group) || json_array_append_value(s->hdr_groups, group) != JSONSuccess) {
+        if (group) json_value_free(group);
+        free(job);
+        return AMVP_MALFORMED_JSON;
+    }
+    ctx->kat_rsp_cont = s->dispatched ? AMVP_RSP_CONT_MORE : AMVP_RSP_CONT_FIRST;
+    rv = s->dispatch(ctx, json_value_get_object(s->hdr_val));
+    json_array_clear(s->hdr_groups);
+    free(job);
+    s->dispatched++;
+    if (rv == AMVP_SUCCESS) {
+        rv = amvp_vs_stream_merge(ctx, s);
+    }
+    return rv;
+}
+
+/*
+ * Takes the next job off the queue and runs it, unless the stream has
+ * failed or is being abandoned, in which case it is just dropped
+ */
+static void amvp_vs_stream_run_next(AMVP_CTX *ctx, AMVP_VS_STREAM *s) {
+    AMVP_VS_STREAM_JOB *job = s->head;
+    AMVP_RESULT rv = AMVP_SUCCESS;
+    int skip = 0;
+
+    s->head = job->next;
+    if (!s->head) {
+        s->tail = NULL;
+    }
+    skip = s->abandon || s->rv != AMVP_SUCCESS;
+    amvp_vs_stream_unlock(s);
+
+    if (skip) {
+        free(job);
+    } else {
+        rv = amvp_vs_stream_run(ctx, s, job);
+    }
+
+    amvp_vs_stream_lock(s);
+    if (rv == AMVP_MALFORMED_JSON) {
+        s->abandon = 1;
+    } else if (rv != AMVP_SUCCESS && s->rv == AMVP_SUCCESS) {
+        s->rv = rv;
+    }
+}
+
+#ifndef _WIN32
+static void *amvp_vs_stream_main(void *arg) {
+    AMVP_CTX *ctx = arg;
+    AMVP_VS_STREAM *s = ctx->vs_stream;
+
+    pthread_mutex_lock(&s->lock);
+    while (1) {
+        while (!s->head && !s->done) {
+            pthread_cond_wait(&s->cv, &s->lock);
+        }
+        if (!s->head) {
+            break;
+        }
+        amvp_vs_stream_run_next(ctx, s);
+    }
+    pthread_mutex_unlock(&s->lock);
+    return NULL;
+}
+#endif
+
+/*
+ * Queues a copy of len bytes of the body at off, with suffix appended.
+ * On Windows the job is run right away.
+ */
+static AMVP_RESULT amvp_vs_stream_queue(AMVP_CTX *ctx, AMVP_VS_STREAM *s, size_t off, size_t len,
+                                        const char *suffix) {
+    AMVP_VS_STREAM_JOB *job = NULL;
+    size_t suffix_len = suffix ? strnlen_s(suffix, 8) : 0;
+
+    job = malloc(sizeof(AMVP_VS_STREAM_JOB) + len + suffix_len);
+    if (!job) {
+        return AMVP_MALLOC_FAIL;
+    }
+    job->next = NULL;
+    memcpy_s(job->data, len + suffix_len + 1, ctx->curl_buf + off, len);
+    if (suffix_len) {
+        memcpy_s(job->data + len, suffix_len + 1, suffix, suffix_len);
+    }
+    job->data[len + suffix_len] = '\0';
+
+    amvp_vs_stream_lock(s);
+    if (s->tail) {
+        s->tail->next = job;
+    } else {
+        s->head = job;
+    }
+    s->tail = job;
+    s->queued = 1;
+#ifndef _WIN32
+    pthread_cond_signal(&s->cv);
+#else
+    amvp_vs_stream_run_next(ctx, s);
+#endif
+    amvp_vs_stream_unlock(s);
+    return AMVP_SUCCESS;
+}
+
+static void amvp_vs_stream_set_abandon(AMVP_VS_STREAM *s) {
+    amvp_vs_stream_lock(s);
+    s->abandon = 1;
+    amvp_vs_stream_unlock(s);
+    s->stop = 1;
+}
+
+/*
+ * Scans the bytes of the body received since the last call. Called by
+ * amvp_curl_write_callback() after appending a chunk to ctx->curl_buf;
+ * first is set for the first chunk of a response. Returns the handler's
+ * error once one has failed, which aborts the download.
+ */
+AMVP_RESULT amvp_vs_stream_feed(AMVP_CTX *ctx, int first) {
+    AMVP_VS_STREAM *s = ctx->vs_stream;
+    const char *buf = ctx->curl_buf;
+    size_t len = (size_t)ctx->curl_read_ctr;
+    AMVP_RESULT rv = AMVP_SUCCESS;
+    char c = 0;
+
+    if (!s) {
+        return AMVP_SUCCESS;
+    }
+    amvp_vs_stream_lock(s);
+    rv = s->rv;
+    if (s->abandon) {
+        s->stop = 1;
+    }
+    amvp_vs_stream_unlock(s);
+    if (rv != AMVP_SUCCESS) {
+        return rv;
+    }
+
+    if (first && s->pos) {
+        /* A new response, e.g. after a login; start over unless the last one was handed out */
+        if (s->queued) {
+            amvp_vs_stream_set_abandon(s);
+        }
+        s->pos = 0;
+        s->depth = 0;
+        s->in_str = 0;
+        s->key = 0;
+        s->in_groups = 0;
+        s->after_groups = 0;
+        s->elem_start = 0;
+    }
+
+    while (s->pos < len && !s->stop) {
+        if (s->in_str) {
+            /* Hex strings are most of a vector set, skip through them in one go */
+            s->pos += strcspn(buf + s->pos, "\"\\");
+            if (s->pos >= len) {
+                break;
+            }
+            if (buf[s->pos] == '\0') {
+                /* Not JSON, leave it to the parser to say so */
+                amvp_vs_stream_set_abandon(s);
+                break;
+            }
+            if (buf[s->pos] == '\\') {
+                if (s->pos + 1 >= len) {
+                    /* Look at the escaped character once it is here */
+                    break;
+                }
+                s->pos += 2;
+                continue;
+            }
+            s->in_str = 0;
+            s->key = s->depth == 2 && !s->in_groups && !s->after_groups &&
+                     s->pos - s->str_start == sizeof(AMVP_VS_STREAM_KEY) - 1 &&
+                     !memcmp(buf + s->str_start, AMVP_VS_STREAM_KEY, sizeof(AMVP_VS_STREAM_KEY) - 1);
+            s->pos++;
+            continue;
+        }
+
+        c = buf[s->pos];
+        switch (c) {
+        case '"':
+            s->in_str = 1;
+            s->str_start = s->pos + 1;
+            break;
+        case '{':
+        case '[':
+            s->depth++;
+            if (s->depth == 2 && c == '{') {
+                if (s->elem_start && s->after_groups) {
+                    /* Another object alongside the vector set */
+                    amvp_vs_stream_set_abandon(s);
+                }
+                s->elem_start = s->pos;
+            } else if (s->depth == 3 && s->key && c == '[') {
+                rv = amvp_vs_stream_queue(ctx, s, s->elem_start, s->pos - s->elem_start + 1, "]}");
+                s->in_groups = 1;
+            } else if (s->depth == 4 && s->in_groups && c == '{') {
+                s->group_start = s->pos;
+            }
+            s->key = 0;
+            break;
+        case '}':
+        case ']':
+            if (s->depth == 4 && s->in_groups && c == '}') {
+                rv = amvp_vs_stream_queue(ctx, s, s->group_start, s->pos - s->group_start + 1, NULL);
+                s->groups++;
+            } else if (s->depth == 3 && s->in_groups) {
+                s->in_groups = 0;
+                s->after_groups = 1;
+            }
+            s->depth--;
+            s->key = 0;
+            break;
+        case ',':
+            if (s->depth == 2 && s->after_groups) {
+                /* A member after testGroups, which the header doesn't have */
+                amvp_vs_stream_set_abandon(s);
+            }
+            s->key = 0;
+            break;
+        case ':':
+        case ' ':
+        case '\t':
+        case '\r':
+        case '\n':
+            break;
+        default:
+            s->key = 0;
+            break;
+        }
+        if (rv != AMVP_SUCCESS) {
+            return rv;
+        }
+        s->pos++;
+    }
+    return AMVP_SUCCESS;
+}
+
+/*
+ * Starts streaming the next download into dispatch, if enabled with
+ * amvp_set_incremental_parse(). Ended with amvp_vs_stream_end().
+ */
+AMVP_RESULT amvp_vs_stream_begin(AMVP_CTX *ctx, AMVP_VS_DISPATCH_CB dispatch) {
+    AMVP_VS_STREAM *s = NULL;
+
+    if (!ctx->incremental_parse || ctx->vs_stream) {
+        return AMVP_SUCCESS;
+    }
+    s = calloc(1, sizeof(AMVP_VS_STREAM));
+    if (!s) {
+        return AMVP_MALLOC_FAIL;
+    }
+    s->dispatch = dispatch;
+    s->rv = AMVP_SUCCESS;
+    ctx->vs_stream = s;
+#ifndef _WIN32
+    pthread_mutex_init(&s->lock, NULL);
+    pthread_cond_init(&s->cv, NULL);
+    if (pthread_create(&s->tid, NULL, amvp_vs_stream_main, ctx)) {
+        AMVP_LOG_WARN("Unable to start the vector set parse thread, parsing after the download");
+        ctx->vs_stream = NULL;
+        pthread_cond_destroy(&s->cv);
+        pthread_mutex_destroy(&s->lock);
+        free(s);
+        return AMVP_SUCCESS;
+    }
+    s->started = 1;
+#endif
+    return AMVP_SUCCESS;
+}
+
+/*
+ * Waits for the groups still being processed once the download is over.
+ * *streamed is set if the whole vector set was processed, leaving its
+ * response in ctx->kat_resp or ctx->kat_writer. Otherwise whatever was
+ * done is dropped and the body in ctx->curl_buf is left to be processed
+ * as usual. Returns the error of a handler that failed.
+ */
+AMVP_RESULT amvp_vs_stream_end(AMVP_CTX *ctx, int *streamed) {
+    AMVP_VS_STREAM *s = ctx->vs_stream;
+    AMVP_VS_STREAM_JOB *job = NULL;
+    AMVP_RESULT rv = AMVP_SUCCESS;
+    int complete = 0;
+
+    *streamed = 0;
+    if (!s) {
+        return AMVP_SUCCESS;
+    }
+
+    /* Everything received was scanned, and it was one whole vector set */
+    complete = s->groups && s->after_groups && !s->depth && !s->in_str && !s->stop &&
+               s->pos == (size_t)ctx->curl_read_ctr;
+    amvp_vs_stream_lock(s);
+    if (!complete) {
+        s->abandon = 1;
+    }
+    s->done = 1;
+#ifndef _WIN32
+    pthread_cond_signal(&s->cv);
+#endif
+    amvp_vs_stream_unlock(s);
+#ifndef _WIN32
+    if (s->started) {
+        pthread_join(s->tid, NULL);
+    }
+    pthread_cond_destroy(&s->cv);
+    pthread_mutex_destroy(&s->lock);
+#endif
+    ctx->vs_stream = NULL;
+
+    /* Left over when a handler failed or on Windows */
+    while ((job = s->head)) {
+        s->head = job->next;
+        free(job);
+    }
+
+    rv = s->rv;
+    ctx->kat_rsp_cont = 0;
+    if (rv == AMVP_SUCCESS && !s->abandon && s->dispatched == s->groups) {
+        *streamed = 1;
+        if (s->master) {
+            ctx->kat_resp = s->master;
+            s->master = NULL;
+        } else {
+            rv = amvp_jw_end_vs_rsp(ctx);
+        }
+        AMVP_LOG_STATUS("Processed %d test groups as they were downloaded", s->groups);
+    } else if (s->dispatched) {
+        if (rv == AMVP_SUCCESS) {
+            AMVP_LOG_INFO("Vector set could not be processed as it was downloaded, processing it whole");
+        }
+        amvp_jw_reset(&ctx->kat_writer);
+        if (ctx->kat_resp) {
+            json_value_free(ctx->kat_resp);
+            ctx->kat_resp = NULL;
+        }
+    }
+
+    if (s->master) json_value_free(s->master);
+    if (s->hdr_val) json_value_free(s->hdr_val);
+    if (s->hdr) free(s->hdr);
+    free(s);
+    return rv;
+}
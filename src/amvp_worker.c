@@ -0,0 +1,589 @@
+/** @file */
+/*
+ * Copyright (c) 2021, Cisco Systems, Inc.
+ *
+ * Licensed under the Apache License 2.0 (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://github.com/cisco/libamvp/LICENSE
+ */
+
+/*
+ * A small pool of worker threads used by the KAT handlers to run the
+ * crypto_handler for the test cases of a group in parallel. The handler
+ * still parses the group and writes the response JSON on the calling
+ * thread; only the crypto calls are handed out to the workers. Handlers
+ * whose cost varies a lot between groups (RSA keyGen, DSA pqgGen, safe
+ * primes) hand over the whole vector set at once, with a cost estimate
+ * per test case, so the expensive groups are spread over the workers. On
+ * platforms without pthreads everything runs on the calling thread.
+ * Modules that registered a crypto_batch_handler get the whole group in
+ * one call instead. With amvp_set_worker_processes() the test cases go to
+ * the worker processes of amvp_worker_proc.c instead of threads.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+
+#include "amvp.h"
+#include "amvp_lcl.h"
+#include "safe_lib.h"
+
+/*
+ * A batch is the test cases of one call to amvp_worker_run_tcs_cost(),
+ * usually a whole vector set. Each participant (the worker threads and
+ * the calling thread) owns a deque of test case indices. The batch is
+ * dealt out longest processing time first: sorted by estimated cost,
+ * largest first, each test case goes to the deque with the least cost
+ * so far. Owners pop from the front of their own deque, so they work
+ * largest first; once it is empty they steal from the back of whichever
+ * deque has the most cost left. When the workers are placed on NUMA nodes
+ * (amvp_set_worker_affinity()) that is whichever deque on the same node
+ * has the most left, and only once the whole node has run dry one on
+ * another node, so test cases mostly stay with the cores near the memory
+ * their worker touched.
+ */
+typedef struct amvp_worker_item_t {
+    double cost;
+    int idx;
+    int owner;                  /* Deque the test case is dealt to */
+} AMVP_WORKER_ITEM;
+
+#ifndef _WIN32
+typedef struct amvp_worker_deque_t {
+    pthread_mutex_t lock;
+    unsigned int generation;    /* Batch the pending slots belong to */
+    int *slots;                 /* Test case indices, a slice of pool->slots */
+    int head;                   /* slots[head..tail) is pending */
+    int tail;
+    double cost;                /* Estimated cost of the pending slots */
+    int node;                   /* NUMA node index of the owner, -1 if not placed */
+} AMVP_WORKER_DEQUE;
+
+typedef struct amvp_worker_thr_t {
+    AMVP_WORKER_POOL *pool;
+    int self;                   /* Index of the deque this thread owns */
+} AMVP_WORKER_THR;
+
+struct amvp_worker_pool_t {
+    int thread_cnt;             /* Number of threads in tids, not counting the caller */
+    pthread_t *tids;
+    AMVP_WORKER_THR *thr;
+    AMVP_WORKER_DEQUE *deques;  /* One per participant, the last one is the caller's */
+    int deque_cnt;
+    AMVP_AFFINITY *aff;         /* Where the threads are pinned, NULL if they aren't */
+    pthread_mutex_t lock;
+    pthread_cond_t start_cv;    /* Signalled when a new batch is posted or on shutdown */
+    pthread_cond_t done_cv;     /* Signalled when the last test case of a batch finishes */
+    unsigned int generation;    /* Bumped for every posted batch */
+    int shutdown;
+
+    /* Current batch, only valid while finished < count */
+    AMVP_CTX *ctx;
+    AMVP_CAPS_LIST *cap;
+    AMVP_TEST_CASE *tcs;
+    const double *costs;        /* NULL when every test case costs the same */
+    int count;
+    int finished;               /* Number of test cases completed or skipped */
+    int failed_idx;             /* Lowest index whose crypto_handler failed, -1 if none */
+    int steals;                 /* Test cases taken from another participant's deque */
+
+    int *slots;                 /* Backing store for the deques */
+    AMVP_WORKER_ITEM *items;    /* Scratch space for sorting a batch */
+    int slot_cap;
+};
+
+/*
+ * The deque of batch gen with the most estimated cost left, other than
+ * self's, on node if that isn't -1. Returns -1 if they are all empty.
+ */
+static int amvp_worker_victim(AMVP_WORKER_POOL *pool, int self, unsigned int gen, int node) {
+    AMVP_WORKER_DEQUE *d = NULL;
+    int victim = -1, i;
+    double best = 0;
+
+    for (i = 0; i < pool->deque_cnt; i++) {
+        if (i == self) continue;
+        d = &pool->deques[i];
+        pthread_mutex_lock(&d->lock);
+        if (d->generation == gen && d->head < d->tail && (node < 0 || d->node == node) &&
+            (victim < 0 || d->cost > best)) {
+            victim = i;
+            best = d->cost;
+        }
+        pthread_mutex_unlock(&d->lock);
+    }
+    return victim;
+}
+
+/*
+ * Take the next test case of batch gen for participant self, from its own
+ * deque if it has any left or else from the deque with the most estimated
+ * cost left, looking on self's node first. Returns -1 once every deque of
+ * the batch is empty.
+ */
+static int amvp_worker_take(AMVP_WORKER_POOL *pool, int self, unsigned int gen, const double *costs) {
+    AMVP_WORKER_DEQUE *d = &pool->deques[self];
+    int node = amvp_affinity_node_cnt(pool->aff) > 1 ? d->node : -1;
+    int idx = -1, victim;
+
+    pthread_mutex_lock(&d->lock);
+    if (d->generation == gen && d->head < d->tail) {
+        idx = d->slots[d->head++];
+        d->cost -= costs ? costs[idx] : 1.0;
+    }
+    pthread_mutex_unlock(&d->lock);
+    if (idx >= 0) {
+        return idx;
+    }
+
+    while (1) {
+        victim = node >= 0 ? amvp_worker_victim(pool, self, gen, node) : -1;
+        if (victim < 0) {
+            victim = amvp_worker_victim(pool, self, gen, -1);
+        }
+        if (victim < 0) {
+            return -1;
+        }
+        /* The victim may have been drained since the scan, if so look again */
+        d = &pool->deques[victim];
+        pthread_mutex_lock(&d->lock);
+        if (d->generation == gen && d->head < d->tail) {
+            idx = d->slots[--d->tail];
+            d->cost -= costs ? costs[idx] : 1.0;
+        }
+        pthread_mutex_unlock(&d->lock);
+        if (idx >= 0) {
+            pthread_mutex_lock(&pool->lock);
+            pool->steals++;
+            pthread_mutex_unlock(&pool->lock);
+            return idx;
+        }
+    }
+}
+
+/*
+ * Run test cases of the current batch until every deque is empty. Called
+ * with pool->lock held and returns with it held.
+ */
+static void amvp_worker_drain(AMVP_WORKER_POOL *pool, int self) {
+    unsigned int gen = pool->generation;
+    AMVP_CTX *ctx = pool->ctx;
+    AMVP_CAPS_LIST *cap = pool->cap;
+    AMVP_TEST_CASE *tcs = pool->tcs;
+    const double *costs = pool->costs;
+    int idx, failed = 0, skip = 0;
+
+    while (1) {
+        skip = pool->failed_idx >= 0;
+        pthread_mutex_unlock(&pool->lock);
+        idx = amvp_worker_take(pool, self, gen, costs);
+        if (idx < 0) {
+            pthread_mutex_lock(&pool->lock);
+            return;
+        }
+        /* Once a test case has failed, the rest of the batch is only counted off */
+        failed = skip ? 0 : amvp_crypto_cache_call(ctx, cap, &tcs[idx]);
+        pthread_mutex_lock(&pool->lock);
+
+        pool->finished++;
+        if (failed && (pool->failed_idx < 0 || idx < pool->failed_idx)) {
+            pool->failed_idx = idx;
+        }
+        if (pool->finished == pool->count) {
+            pthread_cond_signal(&pool->done_cv);
+        }
+    }
+}
+
+static void *amvp_worker_main(void *arg) {
+    AMVP_WORKER_THR *thr = arg;
+    AMVP_WORKER_POOL *pool = thr->pool;
+    unsigned int seen = 0;
+
+    /* Before this thread touches any memory, so its stack and arena are on its node */
+    amvp_affinity_bind(pool->aff, thr->self);
+    pthread_mutex_lock(&pool->lock);
+    while (1) {
+        while (!pool->shutdown && pool->generation == seen) {
+            pthread_cond_wait(&pool->start_cv, &pool->lock);
+        }
+        if (pool->shutdown) {
+            break;
+        }
+        seen = pool->generation;
+        amvp_worker_drain(pool, thr->self);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+static void amvp_worker_pool_destroy(AMVP_WORKER_POOL *pool) {
+    int i;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->shutdown = 1;
+    pthread_cond_broadcast(&pool->start_cv);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (i = 0; i < pool->thread_cnt; i++) {
+        pthread_join(pool->tids[i], NULL);
+    }
+    for (i = 0; i < pool->deque_cnt; i++) {
+        pthread_mutex_destroy(&pool->deques[i].lock);
+    }
+    pthread_cond_destroy(&pool->done_cv);
+    pthread_cond_destroy(&pool->start_cv);
+    pthread_mutex_destroy(&pool->lock);
+    amvp_affinity_free(pool->aff);
+    free(pool->items);
+    free(pool->slots);
+    free(pool->deques);
+    free(pool->thr);
+    free(pool->tids);
+    free(pool);
+}
+#endif
+
+/* Largest cost first, ties in test case order */
+static int amvp_worker_item_cmp(const void *a, const void *b) {
+    const AMVP_WORKER_ITEM *x = a, *y = b;
+
+    if (x->cost != y->cost) {
+        return x->cost > y->cost ? -1 : 1;
+    }
+    return x->idx - y->idx;
+}
+
+#ifndef _WIN32
+/*
+ * Deal a batch out to the deques and wake the workers. Called with
+ * pool->lock held. Returns 0 if the scratch space can't be grown, in
+ * which case nothing was posted.
+ */
+static int amvp_worker_post(AMVP_WORKER_POOL *pool, AMVP_CTX *ctx, AMVP_CAPS_LIST *cap,
+                            AMVP_TEST_CASE *tcs, const double *costs, int count) {
+    double load[AMVP_MAX_WORKER_THREADS];
+    int cnt[AMVP_MAX_WORKER_THREADS], off[AMVP_MAX_WORKER_THREADS];
+    unsigned int gen = pool->generation + 1;
+    AMVP_WORKER_DEQUE *d = NULL;
+    int i, k, min;
+
+    if (count > pool->slot_cap) {
+        int *slots = realloc(pool->slots, count * sizeof(int));
+        AMVP_WORKER_ITEM *items = NULL;
+
+        if (!slots) {
+            return 0;
+        }
+        pool->slots = slots;
+        items = realloc(pool->items, count * sizeof(AMVP_WORKER_ITEM));
+        if (!items) {
+            return 0;
+        }
+        pool->items = items;
+        pool->slot_cap = count;
+    }
+
+    for (i = 0; i < count; i++) {
+        pool->items[i].cost = costs ? costs[i] : 1.0;
+        pool->items[i].idx = i;
+    }
+    if (costs) {
+        qsort(pool->items, count, sizeof(AMVP_WORKER_ITEM), amvp_worker_item_cmp);
+    }
+    for (k = 0; k < pool->deque_cnt; k++) {
+        load[k] = 0;
+        cnt[k] = 0;
+    }
+    for (i = 0; i < count; i++) {
+        min = 0;
+        for (k = 1; k < pool->deque_cnt; k++) {
+            if (load[k] < load[min]) min = k;
+        }
+        pool->items[i].owner = min;
+        load[min] += pool->items[i].cost;
+        cnt[min]++;
+    }
+    for (k = 0, i = 0; k < pool->deque_cnt; k++) {
+        off[k] = i;
+        i += cnt[k];
+    }
+    /* Each slice stays in sorted order, largest first */
+    for (i = 0; i < count; i++) {
+        k = pool->items[i].owner;
+        pool->slots[off[k]++] = pool->items[i].idx;
+    }
+
+    for (k = 0; k < pool->deque_cnt; k++) {
+        d = &pool->deques[k];
+        pthread_mutex_lock(&d->lock);
+        if (k == pool->deque_cnt - 1) {
+            /* The caller isn't pinned, so it is on whichever node it is running on now */
+            d->node = amvp_affinity_cur_node(pool->aff);
+        }
+        d->generation = gen;
+        d->slots = &pool->slots[off[k] - cnt[k]];
+        d->head = 0;
+        d->tail = cnt[k];
+        d->cost = load[k];
+        pthread_mutex_unlock(&d->lock);
+    }
+
+    pool->ctx = ctx;
+    pool->cap = cap;
+    pool->tcs = tcs;
+    pool->costs = costs;
+    pool->count = count;
+    pool->finished = 0;
+    pool->failed_idx = -1;
+    pool->generation = gen;
+    pthread_cond_broadcast(&pool->start_cv);
+    return 1;
+}
+#endif
+
+void amvp_worker_order(const double *costs, int count, int *order) {
+    AMVP_WORKER_ITEM *items = NULL;
+    int i;
+
+    if (!order || count <= 0) {
+        return;
+    }
+    items = costs ? calloc(count, sizeof(AMVP_WORKER_ITEM)) : NULL;
+    if (!items) {
+        for (i = 0; i < count; i++) order[i] = i;
+        return;
+    }
+    for (i = 0; i < count; i++) {
+        items[i].cost = costs[i];
+        items[i].idx = i;
+    }
+    qsort(items, count, sizeof(AMVP_WORKER_ITEM), amvp_worker_item_cmp);
+    for (i = 0; i < count; i++) order[i] = items[i].idx;
+    free(items);
+}
+
+AMVP_RESULT amvp_worker_pool_init(AMVP_CTX *ctx, int threads) {
+#ifndef _WIN32
+    AMVP_WORKER_POOL *pool = NULL;
+    int i;
+#endif
+
+    amvp_worker_pool_free(ctx);
+    if (threads < 2) {
+        return AMVP_SUCCESS;
+    }
+
+#ifdef _WIN32
+    AMVP_LOG_WARN("Worker threads are not supported on this platform, test cases will run serially");
+    return AMVP_SUCCESS;
+#else
+    pool = calloc(1, sizeof(AMVP_WORKER_POOL));
+    if (!pool) {
+        return AMVP_MALLOC_FAIL;
+    }
+    /* The calling thread works on each batch too */
+    pool->tids = calloc(threads - 1, sizeof(pthread_t));
+    pool->thr = calloc(threads - 1, sizeof(AMVP_WORKER_THR));
+    pool->deques = calloc(threads, sizeof(AMVP_WORKER_DEQUE));
+    if (!pool->tids || !pool->thr || !pool->deques) {
+        free(pool->deques);
+        free(pool->thr);
+        free(pool->tids);
+        free(pool);
+        return AMVP_MALLOC_FAIL;
+    }
+    pool->failed_idx = -1;
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->start_cv, NULL);
+    pthread_cond_init(&pool->done_cv, NULL);
+    for (i = 0; i < threads; i++) {
+        pthread_mutex_init(&pool->deques[i].lock, NULL);
+        pool->deques[i].node = -1;
+    }
+    pool->deque_cnt = threads;
+    pool->aff = amvp_affinity_new(ctx);
+    for (i = 0; i < threads - 1; i++) {
+        pool->deques[i].node = amvp_affinity_worker_node(pool->aff, i);
+    }
+
+    for (i = 0; i < threads - 1; i++) {
+        pool->thr[i].pool = pool;
+        pool->thr[i].self = i;
+        if (pthread_create(&pool->tids[i], NULL, amvp_worker_main, &pool->thr[i])) {
+            AMVP_LOG_ERR("Failed to start worker thread %d", i);
+            pool->thread_cnt = i;
+            amvp_worker_pool_destroy(pool);
+            return AMVP_INTERNAL_ERR;
+        }
+    }
+    pool->thread_cnt = threads - 1;
+    ctx->worker_pool = pool;
+    return AMVP_SUCCESS;
+#endif
+}
+
+void amvp_worker_pool_free(AMVP_CTX *ctx) {
+    if (!ctx || !ctx->worker_pool) {
+        return;
+    }
+#ifndef _WIN32
+    amvp_worker_pool_destroy(ctx->worker_pool);
+#endif
+    ctx->worker_pool = NULL;
+}
+
+AMVP_RESULT amvp_tc_batch_init(AMVP_TC_BATCH *batch, JSON_Array *groups) {
+    JSON_Object *groupobj = NULL;
+    size_t g_cnt, i;
+    int max = 0;
+
+    if (!batch) {
+        return AMVP_MISSING_ARG;
+    }
+    memzero_s(batch, sizeof(AMVP_TC_BATCH));
+    g_cnt = json_array_get_count(groups);
+    for (i = 0; i < g_cnt; i++) {
+        groupobj = json_array_get_object(groups, i);
+        max += (int)json_array_get_count(json_object_get_array(groupobj, "tests"));
+    }
+    if (!max) {
+        return AMVP_SUCCESS;
+    }
+    batch->tcs = calloc(max, sizeof(AMVP_TEST_CASE));
+    batch->r_tobjs = calloc(max, sizeof(JSON_Object *));
+    batch->costs = calloc(max, sizeof(double));
+    if (!batch->tcs || !batch->r_tobjs || !batch->costs) {
+        amvp_tc_batch_free(batch);
+        return AMVP_MALLOC_FAIL;
+    }
+    batch->max = max;
+    return AMVP_SUCCESS;
+}
+
+void amvp_tc_batch_free(AMVP_TC_BATCH *batch) {
+    if (!batch) {
+        return;
+    }
+    if (batch->tcs) free(batch->tcs);
+    if (batch->r_tobjs) free(batch->r_tobjs);
+    if (batch->costs) free(batch->costs);
+    memzero_s(batch, sizeof(AMVP_TC_BATCH));
+}
+
+static AMVP_RESULT amvp_worker_run(AMVP_CTX *ctx, AMVP_CAPS_LIST *cap, AMVP_TEST_CASE *tcs,
+                                   const double *costs, int count) {
+    AMVP_RESULT rv = AMVP_SUCCESS;
+    int *order = NULL;
+    int i;
+#ifndef _WIN32
+    AMVP_WORKER_POOL *pool = NULL;
+    int failed_idx = -1;
+#endif
+
+    if (!ctx || !cap || !cap->crypto_handler) {
+        return AMVP_MISSING_ARG;
+    }
+    if (count <= 0) {
+        return AMVP_SUCCESS;
+    }
+    if (!tcs) {
+        return AMVP_MISSING_ARG;
+    }
+
+    if (cap->crypto_batch_handler) {
+        if ((cap->crypto_batch_handler)(tcs, count)) {
+            AMVP_LOG_ERR("ERROR: crypto module failed the batch operation");
+            return AMVP_CRYPTO_MODULE_FAIL;
+        }
+        return AMVP_SUCCESS;
+    }
+
+    if (amvp_proc_pool_can_run(ctx, cap)) {
+        /* The worker processes pull from one queue, so feed it largest first */
+        if (costs) {
+            order = calloc(count, sizeof(int));
+            if (order) amvp_worker_order(costs, count, order);
+        }
+        rv = amvp_proc_pool_run(ctx, cap, tcs, order, count);
+        if (order) free(order);
+        return rv;
+    }
+
+#ifndef _WIN32
+    pool = ctx->worker_pool;
+    if (pool && count > 1) {
+        pthread_mutex_lock(&pool->lock);
+        if (amvp_worker_post(pool, ctx, cap, tcs, costs, count)) {
+            amvp_worker_drain(pool, pool->deque_cnt - 1);
+            while (pool->finished < pool->count) {
+                pthread_cond_wait(&pool->done_cv, &pool->lock);
+            }
+            failed_idx = pool->failed_idx;
+            pool->tcs = NULL;
+            pool->costs = NULL;
+            pool->count = 0;
+            pthread_mutex_unlock(&pool->lock);
+
+            if (failed_idx >= 0) {
+                AMVP_LOG_ERR("ERROR: crypto module failed the operation (test case %d of %d)",
+                             failed_idx + 1, count);
+                return AMVP_CRYPTO_MODULE_FAIL;
+            }
+            return AMVP_SUCCESS;
+        }
+        pthread_mutex_unlock(&pool->lock);
+        AMVP_LOG_WARN("Unable to post %d test cases to the worker threads, running them serially", count);
+    }
+#endif
+
+    for (i = 0; i < count; i++) {
+        if (amvp_crypto_cache_call(ctx, cap, &tcs[i])) {
+            AMVP_LOG_ERR("ERROR: crypto module failed the operation");
+            return AMVP_CRYPTO_MODULE_FAIL;
+        }
+    }
+    return AMVP_SUCCESS;
+}
+
+/*
+ * With metrics on, the wall time of the whole batch is charged as crypto
+ * time, since the workers run the test cases in parallel
+ */
+AMVP_RESULT amvp_worker_run_tcs_cost(AMVP_CTX *ctx, AMVP_CAPS_LIST *cap, AMVP_TEST_CASE *tcs,
+                                     const double *costs, int count) {
+    AMVP_VS_METRICS_REC *rec = ctx ? amvp_metrics_cur(ctx) : NULL;
+    AMVP_RESULT rv = AMVP_SUCCESS;
+    double start = 0;
+
+    if (!rec) {
+        return amvp_worker_run(ctx, cap, tcs, costs, count);
+    }
+    start = amvp_metrics_now();
+    rv = amvp_worker_run(ctx, cap, tcs, costs, count);
+    rec->m.crypto_ms += amvp_metrics_now() - start;
+    if (count > 0) rec->m.crypto_calls += count;
+    return rv;
+}
+
+AMVP_RESULT amvp_worker_run_tcs(AMVP_CTX *ctx, AMVP_CAPS_LIST *cap, AMVP_TEST_CASE *tcs, int count) {
+    return amvp_worker_run_tcs_cost(ctx, cap, tcs, NULL, count);
+}
+
+int amvp_worker_steals(AMVP_CTX *ctx) {
+    int steals = 0;
+
+#ifndef _WIN32
+    if (ctx && ctx->worker_pool) {
+        pthread_mutex_lock(&ctx->worker_pool->lock);
+        steals = ctx->worker_pool->steals;
+        pthread_mutex_unlock(&ctx->worker_pool->lock);
+    }
+#endif
+    return steals;
+}
@@ -0,0 +1,555 @@
+/** @file */
+/*
+ * Copyright (c) 2021, Cisco Systems, Inc.
+ *
+ * Licensed under the Apache License 2.0 (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://github.com/cisco/libamvp/LICENSE
+ */
+
+/*
+ * Worker processes for crypto modules that are not thread-safe, enabled
+ * with amvp_set_worker_processes(). The workers are forked when the mode
+ * is enabled and each gets a socket pair to the parent. Each module keeps
+ * its own globals in a separate address space, so groups still run in
+ * parallel.
+ *
+ * Test cases hold pointers into the parent's heap, so they can't be sent
+ * as they are. For each algorithm a layout lists the buffers its test case
+ * struct points to and how big they are. The parent sends the struct
+ * followed by the contents of those buffers. The worker rebuilds the test
+ * case in its own heap, calls the crypto_handler and sends the struct and
+ * the buffers back. The parent copies them into the original test case,
+ * keeping its own pointers. Algorithms without a layout run in the parent,
+ * on the calling thread. With amvp_set_worker_affinity() each worker pins
+ * itself as it starts, so the buffers it rebuilds are on its own node.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#ifndef _WIN32
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#endif
+
+#include "amvp.h"
+#include "amvp_lcl.h"
+#include "safe_lib.h"
+
+#ifndef _WIN32
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+#define AMVP_PROC_BUF_MAX 20
+
+/* One buffer a test case struct points to */
+typedef struct amvp_proc_buf_t {
+    unsigned char **slot;       /* The pointer in the struct */
+    unsigned int size;          /* Bytes allocated, 0 for pointers that aren't passed on */
+} AMVP_PROC_BUF;
+
+/* Where a test case struct is and what it points to */
+typedef struct amvp_proc_layout_t {
+    void *stc;
+    size_t stc_size;
+    AMVP_PROC_BUF bufs[AMVP_PROC_BUF_MAX];
+    int buf_cnt;
+} AMVP_PROC_LAYOUT;
+
+typedef struct amvp_proc_worker_t {
+    pid_t pid;
+    int fd;                     /* Parent's end of the socket pair, -1 once the worker is gone */
+    int idx;                    /* Test case of the batch it is running, -1 when idle */
+} AMVP_PROC_WORKER;
+
+struct amvp_proc_pool_t {
+    int count;
+    AMVP_PROC_WORKER *workers;
+};
+
+/* What precedes the struct and buffers in each message */
+typedef struct amvp_proc_hdr_t {
+    AMVP_CAP_TYPE cap_type;
+    int (*crypto_handler)(AMVP_TEST_CASE *test_case);   /* Same image on both sides of fork() */
+    int failed;                 /* In replies, what crypto_handler returned */
+} AMVP_PROC_HDR;
+
+static void amvp_proc_buf(AMVP_PROC_LAYOUT *lay, unsigned char **slot, unsigned int size) {
+    lay->bufs[lay->buf_cnt].slot = slot;
+    lay->bufs[lay->buf_cnt].size = size;
+    lay->buf_cnt++;
+}
+
+/*
+ * Fills in the layout of the test cases that can run on a worker process,
+ * matching what the KAT handlers allocate. Returns 0 for the others.
+ */
+static int amvp_proc_layout(AMVP_CAP_TYPE cap_type, AMVP_TEST_CASE *tc, AMVP_PROC_LAYOUT *lay) {
+    AMVP_HASH_TC *hash = NULL;
+    AMVP_RSA_KEYGEN_TC *rsa = NULL;
+
+    memzero_s(lay, sizeof(AMVP_PROC_LAYOUT));
+    switch (cap_type) {
+    case AMVP_HASH_TYPE:
+        hash = tc->tc.hash;
+        lay->stc = hash;
+        lay->stc_size = sizeof(AMVP_HASH_TC);
+        amvp_proc_buf(lay, &hash->msg, hash->cipher == AMVP_HASH_SHAKE_128 || hash->cipher == AMVP_HASH_SHAKE_256 ?
+                                       AMVP_SHAKE_MSG_BYTE_MAX : AMVP_HASH_MSG_BYTE_MAX);
+        amvp_proc_buf(lay, &hash->md, hash->test_type == AMVP_HASH_TEST_TYPE_VOT ?
+                                      AMVP_HASH_XOF_MD_BYTE_MAX : AMVP_HASH_MD_BYTE_MAX);
+        amvp_proc_buf(lay, &hash->m1, AMVP_HASH_MD_BYTE_MAX);
+        amvp_proc_buf(lay, &hash->m2, AMVP_HASH_MD_BYTE_MAX);
+        amvp_proc_buf(lay, &hash->m3, AMVP_HASH_MD_BYTE_MAX);
+        return 1;
+    case AMVP_RSA_KEYGEN_TYPE:
+        rsa = tc->tc.rsa_keygen;
+        lay->stc = rsa;
+        lay->stc_size = sizeof(AMVP_RSA_KEYGEN_TC);
+        amvp_proc_buf(lay, &rsa->e, AMVP_RSA_EXP_BYTE_MAX);
+        amvp_proc_buf(lay, &rsa->p, AMVP_RSA_EXP_BYTE_MAX);
+        amvp_proc_buf(lay, &rsa->q, AMVP_RSA_EXP_BYTE_MAX);
+        amvp_proc_buf(lay, &rsa->n, AMVP_RSA_EXP_BYTE_MAX);
+        amvp_proc_buf(lay, &rsa->d, AMVP_RSA_EXP_BYTE_MAX);
+        amvp_proc_buf(lay, &rsa->xp, AMVP_RSA_EXP_BYTE_MAX);
+        amvp_proc_buf(lay, &rsa->xp1, AMVP_RSA_EXP_BYTE_MAX);
+        amvp_proc_buf(lay, &rsa->xp2, AMVP_RSA_EXP_BYTE_MAX);
+        amvp_proc_buf(lay, &rsa->xq, AMVP_RSA_EXP_BYTE_MAX);
+        amvp_proc_buf(lay, &rsa->xq1, AMVP_RSA_EXP_BYTE_MAX);
+        amvp_proc_buf(lay, &rsa->xq2, AMVP_RSA_EXP_BYTE_MAX);
+        amvp_proc_buf(lay, &rsa->seed, AMVP_RSA_SEEDLEN_MAX);
+        /* Not allocated by the KAT handler, freed in the worker if the crypto handler sets them */
+        amvp_proc_buf(lay, &rsa->p_rand, 0);
+        amvp_proc_buf(lay, &rsa->q_rand, 0);
+        amvp_proc_buf(lay, &rsa->dmp1, 0);
+        amvp_proc_buf(lay, &rsa->dmq1, 0);
+        amvp_proc_buf(lay, &rsa->iqmp, 0);
+        amvp_proc_buf(lay, (unsigned char **)&rsa->prime_result, 0);
+        amvp_proc_buf(lay, (unsigned char **)&rsa->pub_exp, 0);
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+static int amvp_proc_send(int fd, const void *buf, size_t len) {
+    const unsigned char *p = buf;
+    ssize_t n = 0;
+
+    while (len) {
+        n = send(fd, p, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return 0;
+        }
+        p += n;
+        len -= n;
+    }
+    return 1;
+}
+
+static int amvp_proc_recv(int fd, void *buf, size_t len) {
+    unsigned char *p = buf;
+    ssize_t n = 0;
+
+    while (len) {
+        n = recv(fd, p, len, 0);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return 0;
+        }
+        p += n;
+        len -= n;
+    }
+    return 1;
+}
+
+/*
+ * Sends a test case: the header, the struct, then for each buffer of the
+ * layout whether it is set and its contents.
+ */
+static int amvp_proc_send_tc(int fd, AMVP_PROC_HDR *hdr, AMVP_PROC_LAYOUT *lay) {
+    unsigned char set = 0;
+    int i;
+
+    if (!amvp_proc_send(fd, hdr, sizeof(AMVP_PROC_HDR)) ||
+        !amvp_proc_send(fd, lay->stc, lay->stc_size)) {
+        return 0;
+    }
+    for (i = 0; i < lay->buf_cnt; i++) {
+        if (!lay->bufs[i].size) {
+            continue;
+        }
+        set = *lay->bufs[i].slot != NULL;
+        if (!amvp_proc_send(fd, &set, 1) ||
+            (set && !amvp_proc_send(fd, *lay->bufs[i].slot, lay->bufs[i].size))) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* Reads and drops len bytes */
+static int amvp_proc_skip(int fd, size_t len) {
+    unsigned char tmp[256];
+    size_t n = 0;
+
+    while (len) {
+        n = len < sizeof(tmp) ? len : sizeof(tmp);
+        if (!amvp_proc_recv(fd, tmp, n)) {
+            return 0;
+        }
+        len -= n;
+    }
+    return 1;
+}
+
+/*
+ * Reads a reply into the original test case. Its pointers are kept, the
+ * rest of the struct and the buffer contents come from the worker. A
+ * buffer the handler set that the parent doesn't have is dropped.
+ */
+static int amvp_proc_recv_tc(int fd, AMVP_PROC_HDR *hdr, AMVP_PROC_LAYOUT *lay) {
+    unsigned char *saved[AMVP_PROC_BUF_MAX];
+    unsigned char set = 0;
+    int i, ok = 1;
+
+    for (i = 0; i < lay->buf_cnt; i++) {
+        saved[i] = *lay->bufs[i].slot;
+    }
+    if (!amvp_proc_recv(fd, hdr, sizeof(AMVP_PROC_HDR)) ||
+        !amvp_proc_recv(fd, lay->stc, lay->stc_size)) {
+        ok = 0;
+    }
+    for (i = 0; i < lay->buf_cnt; i++) {
+        *lay->bufs[i].slot = saved[i];
+    }
+    for (i = 0; ok && i < lay->buf_cnt; i++) {
+        if (!lay->bufs[i].size) {
+            continue;
+        }
+        if (!amvp_proc_recv(fd, &set, 1)) {
+            ok = 0;
+        } else if (set && saved[i]) {
+            ok = amvp_proc_recv(fd, saved[i], lay->bufs[i].size);
+        } else if (set) {
+            ok = amvp_proc_skip(fd, lay->bufs[i].size);
+        }
+    }
+    return ok;
+}
+
+/*
+ * The worker side: rebuilds each test case in its own heap, runs it and
+ * sends it back, until the parent closes the socket.
+ */
+static void amvp_proc_worker_main(int fd) {
+    AMVP_RSA_KEYGEN_TC rsa;
+    AMVP_HASH_TC hash;
+    AMVP_TEST_CASE tc;
+    AMVP_PROC_LAYOUT lay;
+    AMVP_PROC_HDR hdr;
+    unsigned char set = 0;
+    int i, ok = 1;
+
+    while (amvp_proc_recv(fd, &hdr, sizeof(AMVP_PROC_HDR))) {
+        memzero_s(&hash, sizeof(hash));
+        memzero_s(&rsa, sizeof(rsa));
+        tc.tc.hash = &hash;
+        if (hdr.cap_type == AMVP_RSA_KEYGEN_TYPE) {
+            tc.tc.rsa_keygen = &rsa;
+        }
+        if (!amvp_proc_layout(hdr.cap_type, &tc, &lay) ||
+            !amvp_proc_recv(fd, lay.stc, lay.stc_size)) {
+            break;
+        }
+        /* Sizes depend on the struct's own fields, so redo the layout now they're in */
+        amvp_proc_layout(hdr.cap_type, &tc, &lay);
+        for (i = 0; i < lay.buf_cnt; i++) {
+            *lay.bufs[i].slot = NULL;
+        }
+        for (i = 0; ok && i < lay.buf_cnt; i++) {
+            if (!lay.bufs[i].size) {
+                continue;
+            }
+            if (!amvp_proc_recv(fd, &set, 1)) {
+                ok = 0;
+            } else if (set) {
+                *lay.bufs[i].slot = calloc(lay.bufs[i].size, 1);
+                ok = *lay.bufs[i].slot && amvp_proc_recv(fd, *lay.bufs[i].slot, lay.bufs[i].size);
+            }
+        }
+
+        if (ok) {
+            hdr.failed = (hdr.crypto_handler)(&tc);
+            ok = amvp_proc_send_tc(fd, &hdr, &lay);
+        }
+        /*
+         * Every slot started out NULL, so the ones without a size that are
+         * set now were allocated by the handler. Nothing refers to them once
+         * the reply is sent.
+         */
+        for (i = 0; i < lay.buf_cnt; i++) {
+            if (*lay.bufs[i].slot) {
+                free(*lay.bufs[i].slot);
+                *lay.bufs[i].slot = NULL;
+            }
+        }
+        if (!ok) {
+            break;
+        }
+    }
+    close(fd);
+}
+
+static void amvp_proc_worker_stop(AMVP_PROC_WORKER *w) {
+    if (w->fd >= 0) {
+        close(w->fd);
+        w->fd = -1;
+    }
+    if (w->pid > 0) {
+        while (waitpid(w->pid, NULL, 0) < 0 && errno == EINTR) {
+            continue;
+        }
+        w->pid = 0;
+    }
+}
+
+static void amvp_proc_pool_destroy(AMVP_PROC_POOL *pool) {
+    int i;
+
+    for (i = 0; i < pool->count; i++) {
+        amvp_proc_worker_stop(&pool->workers[i]);
+    }
+    free(pool->workers);
+    free(pool);
+}
+#endif
+
+AMVP_RESULT amvp_proc_pool_init(AMVP_CTX *ctx, int procs) {
+#ifndef _WIN32
+    AMVP_PROC_POOL *pool = NULL;
+    AMVP_AFFINITY *aff = NULL;
+    int fds[2], i, j;
+#endif
+
+    amvp_proc_pool_free(ctx);
+    if (procs < 1) {
+        return AMVP_SUCCESS;
+    }
+
+#ifdef _WIN32
+    AMVP_LOG_WARN("Worker processes are not supported on this platform, test cases will run serially");
+    return AMVP_SUCCESS;
+#else
+    pool = calloc(1, sizeof(AMVP_PROC_POOL));
+    if (!pool) {
+        return AMVP_MALLOC_FAIL;
+    }
+    pool->workers = calloc(procs, sizeof(AMVP_PROC_WORKER));
+    if (!pool->workers) {
+        free(pool);
+        return AMVP_MALLOC_FAIL;
+    }
+    for (i = 0; i < procs; i++) {
+        pool->workers[i].fd = -1;
+    }
+
+    /* Anything buffered would be written again by each worker */
+    fflush(NULL);
+    aff = amvp_affinity_new(ctx);
+    for (i = 0; i < procs; i++) {
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds)) {
+            AMVP_LOG_ERR("Failed to create the socket of worker process %d", i);
+            amvp_affinity_free(aff);
+            amvp_proc_pool_destroy(pool);
+            return AMVP_INTERNAL_ERR;
+        }
+        pool->workers[i].pid = fork();
+        if (pool->workers[i].pid < 0) {
+            AMVP_LOG_ERR("Failed to start worker process %d", i);
+            close(fds[0]);
+            close(fds[1]);
+            amvp_affinity_free(aff);
+            amvp_proc_pool_destroy(pool);
+            return AMVP_INTERNAL_ERR;
+        }
+        if (!pool->workers[i].pid) {
+            /* The worker only needs its own end of its own socket */
+            for (j = 0; j < i; j++) {
+                close(pool->workers[j].fd);
+            }
+            close(fds[0]);
+            amvp_affinity_bind(aff, i);
+            amvp_proc_worker_main(fds[1]);
+            _exit(0);
+        }
+        close(fds[1]);
+        pool->workers[i].fd = fds[0];
+        pool->workers[i].idx = -1;
+        pool->count++;
+    }
+    amvp_affinity_free(aff);
+    ctx->proc_pool = pool;
+    return AMVP_SUCCESS;
+#endif
+}
+
+void amvp_proc_pool_free(AMVP_CTX *ctx) {
+    if (!ctx || !ctx->proc_pool) {
+        return;
+    }
+#ifndef _WIN32
+    amvp_proc_pool_destroy(ctx->proc_pool);
+#endif
+    ctx->proc_pool = NULL;
+}
+
+int amvp_proc_pool_can_run(AMVP_CTX *ctx, AMVP_CAPS_LIST *cap) {
+#ifndef _WIN32
+    AMVP_PROC_LAYOUT lay;
+    AMVP_TEST_CASE tc;
+    AMVP_RSA_KEYGEN_TC rsa;
+    AMVP_HASH_TC hash;
+
+    if (!ctx || !ctx->proc_pool || !cap) {
+        return 0;
+    }
+    memzero_s(&hash, sizeof(hash));
+    memzero_s(&rsa, sizeof(rsa));
+    tc.tc.hash = &hash;
+    if (cap->cap_type == AMVP_RSA_KEYGEN_TYPE) {
+        tc.tc.rsa_keygen = &rsa;
+    }
+    return amvp_proc_layout(cap->cap_type, &tc, &lay);
+#else
+    return 0;
+#endif
+}
+
+/* Test case at position k of the run order */
+#define AMVP_PROC_TC_IDX(order, k) ((order) ? (order)[k] : (k))
+
+AMVP_RESULT amvp_proc_pool_run(AMVP_CTX *ctx, AMVP_CAPS_LIST *cap, AMVP_TEST_CASE *tcs,
+                               const int *order, int count) {
+#ifndef _WIN32
+    AMVP_PROC_POOL *pool = ctx->proc_pool;
+    AMVP_PROC_WORKER *w = NULL;
+    struct pollfd *pfds = NULL;
+    AMVP_PROC_LAYOUT lay;
+    AMVP_PROC_HDR hdr;
+    int next = 0, busy = 0, failed_idx = -1, lost = 0, i, n, idx;
+
+    pfds = calloc(pool->count, sizeof(struct pollfd));
+    if (!pfds) {
+        return AMVP_MALLOC_FAIL;
+    }
+
+    while (1) {
+        /* Hand a test case to each idle worker, unless one has failed */
+        for (i = 0; i < pool->count && failed_idx < 0; i++) {
+            w = &pool->workers[i];
+            if (w->fd < 0 || w->idx >= 0) {
+                continue;
+            }
+            while (next < count && amvp_crypto_cache_lookup(ctx, cap, &tcs[AMVP_PROC_TC_IDX(order, next)])) {
+                next++;
+            }
+            if (next == count) {
+                break;
+            }
+            idx = AMVP_PROC_TC_IDX(order, next);
+            memzero_s(&hdr, sizeof(hdr));
+            hdr.cap_type = cap->cap_type;
+            hdr.crypto_handler = cap->crypto_handler;
+            amvp_proc_layout(cap->cap_type, &tcs[idx], &lay);
+            if (!amvp_proc_send_tc(w->fd, &hdr, &lay)) {
+                AMVP_LOG_ERR("Worker process %d is gone", (int)w->pid);
+                amvp_proc_worker_stop(w);
+                lost++;
+                continue;
+            }
+            next++;
+            w->idx = idx;
+            busy++;
+        }
+        if (!busy) {
+            break;
+        }
+
+        n = 0;
+        for (i = 0; i < pool->count; i++) {
+            if (pool->workers[i].idx >= 0) {
+                pfds[n].fd = pool->workers[i].fd;
+                pfds[n].events = POLLIN;
+                pfds[n].revents = 0;
+                n++;
+            }
+        }
+        if (poll(pfds, n, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            AMVP_LOG_ERR("Failed to wait for the worker processes");
+            failed_idx = failed_idx < 0 && next < count ? AMVP_PROC_TC_IDX(order, next) : failed_idx;
+            break;
+        }
+
+        n = 0;
+        for (i = 0; i < pool->count; i++) {
+            w = &pool->workers[i];
+            if (w->idx < 0) {
+                continue;
+            }
+            if (!pfds[n++].revents) {
+                continue;
+            }
+            amvp_proc_layout(cap->cap_type, &tcs[w->idx], &lay);
+            if (!amvp_proc_recv_tc(w->fd, &hdr, &lay)) {
+                /* The module crashed or exited on this test case */
+                AMVP_LOG_ERR("Worker process %d exited during test case %d", (int)w->pid, w->idx + 1);
+                amvp_proc_worker_stop(w);
+                lost++;
+                hdr.failed = 1;
+            } else if (!hdr.failed) {
+                amvp_crypto_cache_store(ctx, cap, &tcs[w->idx]);
+            }
+            if (hdr.failed && (failed_idx < 0 || w->idx < failed_idx)) {
+                failed_idx = w->idx;
+            }
+            w->idx = -1;
+            busy--;
+        }
+    }
+    free(pfds);
+
+    if (failed_idx < 0 && next < count) {
+        /* Every worker is gone */
+        AMVP_LOG_ERR("No worker processes left to run the test cases");
+        return AMVP_CRYPTO_MODULE_FAIL;
+    }
+    if (lost) {
+        AMVP_LOG_WARN("%d of %d worker processes are gone", lost, pool->count);
+    }
+    if (failed_idx >= 0) {
+        AMVP_LOG_ERR("ERROR: crypto module failed the operation (test case %d of %d)",
+                     failed_idx + 1, count);
+        return AMVP_CRYPTO_MODULE_FAIL;
+    }
+    return AMVP_SUCCESS;
+#else
+    return AMVP_UNSUPPORTED_OP;
+#endif
+}
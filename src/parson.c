@@ -38,11 +38,31 @@
 #include <errno.h>
 #include "safe_lib.h"    /* needs to be after errno.h */
 
+/* The string scanner reads 16 aligned bytes at a time with SSE2. The loads can read past the end
+   of the string being parsed, though never into another page, which address sanitizers report. */
+#if defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define PARSON_NO_SIMD
+#endif
+#endif
+#if defined(__SANITIZE_ADDRESS__)
+#define PARSON_NO_SIMD
+#endif
+#if !defined(PARSON_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define PARSON_SSE2
+#include <emmintrin.h>
+#include <stdint.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
 /* Apparently sscanf is not implemented in some "standard" libraries, so don't use it, if you
  * don't have to. */
 #define sscanf THINK_TWICE_ABOUT_USING_SSCANF
 
 #define STARTING_CAPACITY 16
+#define OBJECT_INDEX_MIN_COUNT 8 /* objects with fewer members are searched linearly */
 #define MAX_NESTING       2048
 
 #define FLOAT_FORMAT "%1.17g" /* do not increase precision without incresing NUM_BUF_SIZE */
@@ -65,8 +85,56 @@
 #define IS_NUMBER_INVALID(x) (((x) * 0.0) != 0.0)
 #endif
 
-static JSON_Malloc_Function parson_malloc = malloc;
-static JSON_Free_Function parson_free = free;
+#if defined(_MSC_VER)
+#define PARSON_THREAD_LOCAL __declspec(thread)
+#else
+#define PARSON_THREAD_LOCAL __thread
+#endif
+
+static JSON_Malloc_Function parson_malloc_fun = malloc;
+static JSON_Free_Function parson_free_fun = free;
+
+/* Allocator override for the calling thread, see json_set_thread_allocator */
+static PARSON_THREAD_LOCAL const JSON_Allocator *parson_allocator = NULL;
+
+/* Set while json_parse_string_in_place runs on the calling thread */
+static PARSON_THREAD_LOCAL int parson_in_place = 0;
+
+static void * parson_malloc(size_t size) {
+    if (parson_allocator) {
+        return parson_allocator->malloc_fun(parson_allocator->opaque, size);
+    }
+    return parson_malloc_fun(size);
+}
+
+static void parson_free(void *ptr) {
+    if (parson_allocator) {
+        parson_allocator->free_fun(parson_allocator->opaque, ptr);
+        return;
+    }
+    parson_free_fun(ptr);
+}
+
+/*
+ * What an object or array owns (member names, the names, values and items
+ * arrays, the index) is allocated with the allocator it was created with,
+ * even when it grows or shrinks while another thread allocator is set, so
+ * a tree parsed outside an arena never ends up holding arena memory.
+ */
+static void * parson_malloc_with(const JSON_Allocator *allocator, size_t size) {
+    if (allocator) {
+        return allocator->malloc_fun(allocator->opaque, size);
+    }
+    return parson_malloc_fun(size);
+}
+
+static void parson_free_with(const JSON_Allocator *allocator, void *ptr) {
+    if (allocator) {
+        allocator->free_fun(allocator->opaque, ptr);
+        return;
+    }
+    parson_free_fun(ptr);
+}
 
 static int parson_escape_slashes = 1;
 
@@ -87,18 +155,31 @@ typedef union json_value_value {
     int          null;
 } JSON_Value_Value;
 
+#define PARSON_BORROWED_BIN 2
+
 struct json_value_t {
     JSON_Value      *parent;
     JSON_Value_Type  type;
+    int              borrowed; /* string chars point into a buffer parsed in place, not owned,
+                                  PARSON_BORROWED_BIN when decoded bytes follow the terminator */
     JSON_Value_Value value;
 };
 
+/* Open addressing hash index over the names of an object, kept up to date as members are added */
+typedef struct json_object_slot {
+    unsigned long hash;
+    size_t        item; /* index into names/values plus one, 0 for an empty slot */
+} JSON_Object_Slot;
+
 struct json_object_t {
     JSON_Value  *wrapping_value;
     char       **names;
     JSON_Value **values;
     size_t       count;
     size_t       capacity;
+    JSON_Object_Slot *index;       /* NULL below OBJECT_INDEX_MIN_COUNT members */
+    size_t       index_capacity; /* power of two, at least twice count */
+    const JSON_Allocator *allocator; /* thread allocator the object was created with, NULL for the global one */
 };
 
 struct json_array_t {
@@ -106,6 +187,7 @@ struct json_array_t {
     JSON_Value **items;
     size_t       count;
     size_t       capacity;
+    const JSON_Allocator *allocator; /* as for objects */
 };
 
 /* Various */
@@ -130,6 +212,12 @@ static JSON_Status   json_object_add(JSON_Object *object, const char *name, JSON
 static JSON_Status   json_object_addn(JSON_Object *object, const char *name, size_t name_len, JSON_Value *value);
 static JSON_Status   json_object_resize(JSON_Object *object, size_t new_capacity);
 static JSON_Value  * json_object_getn_value(const JSON_Object *object, const char *name, size_t name_len);
+static unsigned long json_object_hash(const char *name, size_t name_len);
+static JSON_Status   json_object_index_build(JSON_Object *object);
+static void          json_object_index_insert(JSON_Object *object, size_t item, unsigned long hash);
+static void          json_object_index_drop(JSON_Object *object);
+static void          json_object_index_update(JSON_Object *object);
+static JSON_Value  * json_object_find(const JSON_Object *object, const char *name, size_t name_len, unsigned long hash);
 static JSON_Status   json_object_remove_internal(JSON_Object *object, const char *name, int free_value);
 static JSON_Status   json_object_dotremove_internal(JSON_Object *object, const char *name, int free_value);
 static void          json_object_free(JSON_Object *object);
@@ -145,10 +233,13 @@ static JSON_Value * json_value_init_string_no_copy(char *string, size_t length);
 static const JSON_String * json_value_get_string_desc(const JSON_Value *value);
 
 /* Parser */
-static JSON_Status  skip_quotes(const char **string);
+static const char * scan_string(const char *string, int *plain);
 static int          parse_utf16(const char **unprocessed, char **processed);
+static JSON_Status  process_string_to(const char *input, size_t input_len, char *output, size_t *output_len);
 static char *       process_string(const char *input, size_t input_len, size_t *output_len);
 static char *       get_quoted_string(const char **string, size_t *output_string_len);
+static char *       get_quoted_string_in_place(const char **string, size_t *output_string_len);
+static void         free_quoted_string(char *string);
 static JSON_Value * parse_object_value(const char **string, size_t nesting);
 static JSON_Value * parse_array_value(const char **string, size_t nesting);
 static JSON_Value * parse_string_value(const char **string);
@@ -391,6 +482,9 @@ static JSON_Object * json_object_init(JSON_Value *wrapping_value) {
     new_obj->values = (JSON_Value**)NULL;
     new_obj->capacity = 0;
     new_obj->count = 0;
+    new_obj->index = NULL;
+    new_obj->index_capacity = 0;
+    new_obj->allocator = parson_allocator;
     return new_obj;
 }
 
@@ -406,7 +500,7 @@ static JSON_Status json_object_addn(JSON_Object *object, const char *name, size_
     if (object == NULL || name == NULL || value == NULL) {
         return JSONFailure;
     }
-    if (json_object_getn_value(object, name, name_len) != NULL) {
+    if (json_object_find(object, name, name_len, json_object_hash(name, name_len)) != NULL) {
         return JSONFailure;
     }
     if (object->count >= object->capacity) {
@@ -416,13 +510,20 @@ static JSON_Status json_object_addn(JSON_Object *object, const char *name, size_
         }
     }
     index = object->count;
-    object->names[index] = parson_strndup(name, name_len);
+    object->names[index] = (char*)parson_malloc_with(object->allocator, name_len + 1);
     if (object->names[index] == NULL) {
         return JSONFailure;
     }
+    object->names[index][name_len] = '\0';
+    memcpy_s(object->names[index], name_len + 1, name, name_len); /* SAFEC */
     value->parent = json_object_get_wrapping_value(object);
     object->values[index] = value;
     object->count++;
+    if (object->index != NULL && object->count * 2 <= object->index_capacity) {
+        json_object_index_insert(object, index, json_object_hash(name, name_len));
+    } else {
+        json_object_index_update(object);
+    }
     return JSONSuccess;
 }
 
@@ -435,13 +536,13 @@ static JSON_Status json_object_resize(JSON_Object *object, size_t new_capacity)
         new_capacity == 0) {
             return JSONFailure; /* Shouldn't happen */
     }
-    temp_names = (char**)parson_malloc(new_capacity * sizeof(char*));
+    temp_names = (char**)parson_malloc_with(object->allocator, new_capacity * sizeof(char*));
     if (temp_names == NULL) {
         return JSONFailure;
     }
-    temp_values = (JSON_Value**)parson_malloc(new_capacity * sizeof(JSON_Value*));
+    temp_values = (JSON_Value**)parson_malloc_with(object->allocator, new_capacity * sizeof(JSON_Value*));
     if (temp_values == NULL) {
-        parson_free(temp_names);
+        parson_free_with(object->allocator, temp_names);
         return JSONFailure;
     }
     if (object->names != NULL && object->values != NULL && object->count > 0) {
@@ -451,14 +552,103 @@ static JSON_Status json_object_resize(JSON_Object *object, size_t new_capacity)
         memcpy_s(temp_values, new_capacity * sizeof(JSON_Value*),
                  object->values, object->count * sizeof(JSON_Value*));
     }
-    parson_free(object->names);
-    parson_free(object->values);
+    parson_free_with(object->allocator, object->names);
+    parson_free_with(object->allocator, object->values);
     object->names = temp_names;
     object->values = temp_values;
     object->capacity = new_capacity;
     return JSONSuccess;
 }
 
+/* FNV-1a */
+static unsigned long json_object_hash(const char *name, size_t name_len) {
+    unsigned long hash = 2166136261UL;
+    size_t i;
+    for (i = 0; i < name_len; i++) {
+        hash ^= (unsigned char)name[i];
+        hash = (hash * 16777619UL) & 0xffffffffUL;
+    }
+    return hash;
+}
+
+static void json_object_index_insert(JSON_Object *object, size_t item, unsigned long hash) {
+    size_t mask = object->index_capacity - 1;
+    size_t slot = hash & mask;
+    while (object->index[slot].item != 0) {
+        slot = (slot + 1) & mask;
+    }
+    object->index[slot].hash = hash;
+    object->index[slot].item = item + 1;
+}
+
+static JSON_Status json_object_index_build(JSON_Object *object) {
+    JSON_Object_Slot *index = NULL;
+    size_t i, capacity = STARTING_CAPACITY;
+    while (capacity < object->count * 2) {
+        capacity *= 2;
+    }
+    index = (JSON_Object_Slot*)parson_malloc_with(object->allocator, capacity * sizeof(JSON_Object_Slot));
+    if (index == NULL) {
+        return JSONFailure;
+    }
+    memzero_s(index, capacity * sizeof(JSON_Object_Slot)); /* SAFEC */
+    object->index = index;
+    object->index_capacity = capacity;
+    for (i = 0; i < object->count; i++) {
+        json_object_index_insert(object, i,
+                json_object_hash(object->names[i], strnlen_s(object->names[i], STRING_NAME_MAX)));
+    }
+    return JSONSuccess;
+}
+
+static void json_object_index_drop(JSON_Object *object) {
+    if (object->index != NULL) {
+        parson_free_with(object->allocator, object->index);
+    }
+    object->index = NULL;
+    object->index_capacity = 0;
+}
+
+/*
+ * Rebuild the index after members were added or removed. Lookups never
+ * build it, so a read-only object can be shared between threads. Without
+ * memory for it the object is just searched linearly.
+ */
+static void json_object_index_update(JSON_Object *object) {
+    json_object_index_drop(object);
+    if (object->count >= OBJECT_INDEX_MIN_COUNT) {
+        json_object_index_build(object);
+    }
+}
+
+static JSON_Value * json_object_find(const JSON_Object *object, const char *name, size_t name_len, unsigned long hash) {
+    size_t mask = 0, slot = 0;
+    int diff = 1;
+    if (object == NULL) {
+        return NULL;
+    }
+    if (object->index == NULL) {
+        return json_object_getn_value(object, name, name_len);
+    }
+    mask = object->index_capacity - 1;
+    for (slot = hash & mask; object->index[slot].item != 0; slot = (slot + 1) & mask) {
+        const char *candidate = NULL;
+        if (object->index[slot].hash != hash) {
+            continue;
+        }
+        candidate = object->names[object->index[slot].item - 1];
+        if (strnlen_s(candidate, STRING_NAME_MAX) != name_len) {
+            continue;
+        }
+        strcmp_s(name, name_len, candidate, &diff); /* SAFEC */
+        if (!diff) {
+            return object->values[object->index[slot].item - 1];
+        }
+    }
+    return NULL;
+}
+
+/* Linear search, used for small objects */
 static JSON_Value * json_object_getn_value(const JSON_Object *object, const char *name, size_t name_len) {
     size_t i, name_length;
     int diff = 1;
@@ -485,7 +675,7 @@ static JSON_Status json_object_remove_internal(JSON_Object *object, const char *
         int diff = 1;
         strcmp_s(object->names[i], STRING_NAME_MAX, name, &diff); /* SAFEC */
         if (!diff) {
-            parson_free(object->names[i]);
+            parson_free_with(object->allocator, object->names[i]);
             if (free_value) {
                 json_value_free(object->values[i]);
             /* AMVP: If remove a value from an object without freeing, make sure its parent is NULL */
@@ -497,6 +687,7 @@ static JSON_Status json_object_remove_internal(JSON_Object *object, const char *
                 object->values[i] = object->values[last_item_index];
             }
             object->count -= 1;
+            json_object_index_update(object);
             return JSONSuccess;
         }
     }
@@ -534,12 +725,13 @@ static JSON_Status json_object_dotremove_internal(JSON_Object *object, const cha
 static void json_object_free(JSON_Object *object) {
     size_t i;
     for (i = 0; i < object->count; i++) {
-        parson_free(object->names[i]);
+        parson_free_with(object->allocator, object->names[i]);
         json_value_free(object->values[i]);
     }
-    parson_free(object->names);
-    parson_free(object->values);
-    parson_free(object);
+    parson_free_with(object->allocator, object->names);
+    parson_free_with(object->allocator, object->values);
+    json_object_index_drop(object);
+    parson_free_with(object->allocator, object);
 }
 
 /* JSON Array */
@@ -552,6 +744,7 @@ static JSON_Array * json_array_init(JSON_Value *wrapping_value) {
     new_array->items = (JSON_Value**)NULL;
     new_array->capacity = 0;
     new_array->count = 0;
+    new_array->allocator = parson_allocator;
     return new_array;
 }
 
@@ -573,7 +766,7 @@ static JSON_Status json_array_resize(JSON_Array *array, size_t new_capacity) {
     if (new_capacity == 0) {
         return JSONFailure;
     }
-    new_items = (JSON_Value**)parson_malloc(new_capacity * sizeof(JSON_Value*));
+    new_items = (JSON_Value**)parson_malloc_with(array->allocator, new_capacity * sizeof(JSON_Value*));
     if (new_items == NULL) {
         return JSONFailure;
     }
@@ -581,7 +774,7 @@ static JSON_Status json_array_resize(JSON_Array *array, size_t new_capacity) {
         memcpy_s(new_items, new_capacity * sizeof(JSON_Value*),
                  array->items, array->count * sizeof(JSON_Value*)); /* SAFEC */
     }
-    parson_free(array->items);
+    parson_free_with(array->allocator, array->items);
     array->items = new_items;
     array->capacity = new_capacity;
     return JSONSuccess;
@@ -592,8 +785,8 @@ static void json_array_free(JSON_Array *array) {
     for (i = 0; i < array->count; i++) {
         json_value_free(array->items[i]);
     }
-    parson_free(array->items);
-    parson_free(array);
+    parson_free_with(array->allocator, array->items);
+    parson_free_with(array->allocator, array);
 }
 
 /* JSON Value */
@@ -604,30 +797,81 @@ static JSON_Value * json_value_init_string_no_copy(char *string, size_t length)
     }
     new_value->parent = NULL;
     new_value->type = JSONString;
+    new_value->borrowed = 0;
     new_value->value.string.chars = string;
     new_value->value.string.length = length;
     return new_value;
 }
 
 /* Parser */
-static JSON_Status skip_quotes(const char **string) {
-    if (**string != '\"') {
-        return JSONFailure;
+#ifdef PARSON_SSE2
+static int first_set_bit(unsigned int mask) {
+#if defined(_MSC_VER)
+    unsigned long index = 0;
+    _BitScanForward(&index, mask);
+    return (int)index;
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+
+/* Skips to the first quote, backslash or control character (which includes the terminator) */
+static const char * scan_string_plain(const char *string) {
+    const __m128i quote = _mm_set1_epi8('\"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i control = _mm_set1_epi8(0x1F);
+    __m128i chunk, special;
+    int mask = 0;
+
+    /* Byte by byte up to a 16 byte boundary, so no load crosses into the next page */
+    while (((uintptr_t)string & 15) != 0) {
+        if (*string == '\"' || *string == '\\' || (unsigned char)*string < 0x20) {
+            return string;
+        }
+        string++;
     }
-    SKIP_CHAR(string);
-    while (**string != '\"') {
-        if (**string == '\0') {
-            return JSONFailure;
-        } else if (**string == '\\') {
-            SKIP_CHAR(string);
-            if (**string == '\0') {
-                return JSONFailure;
+    for (;;) {
+        chunk = _mm_load_si128((const __m128i*)string);
+        special = _mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash));
+        /* unsigned chunk <= 0x1F */
+        special = _mm_or_si128(special, _mm_cmpeq_epi8(_mm_min_epu8(chunk, control), chunk));
+        mask = _mm_movemask_epi8(special);
+        if (mask) {
+            return string + first_set_bit((unsigned int)mask);
+        }
+        string += 16;
+    }
+}
+#else
+static const char * scan_string_plain(const char *string) {
+    while (*string != '\"' && *string != '\\' && (unsigned char)*string >= 0x20) {
+        string++;
+    }
+    return string;
+}
+#endif
+
+/* Finds the closing quote of the string starting after an opening quote at string. Returns NULL
+   if the string isn't terminated. *plain is set if the string has no escapes or control
+   characters, in which case it can be copied as it is. */
+static const char * scan_string(const char *string, int *plain) {
+    *plain = 1;
+    for (;;) {
+        string = scan_string_plain(string);
+        if (*string == '\"') {
+            return string;
+        } else if (*string == '\0') {
+            return NULL;
+        }
+        *plain = 0;
+        if (*string == '\\') {
+            SKIP_CHAR(&string);
+            if (*string == '\0') {
+                return NULL;
             }
         }
-        SKIP_CHAR(string);
+        SKIP_CHAR(&string);
     }
-    SKIP_CHAR(string);
-    return JSONSuccess;
 }
 
 static int parse_utf16(const char **unprocessed, char **processed) {
@@ -677,18 +921,11 @@ static int parse_utf16(const char **unprocessed, char **processed) {
 }
 
 
-/* Copies and processes passed string up to supplied length.
-Example: "\u006Corem ipsum" -> lorem ipsum */
-static char* process_string(const char *input, size_t input_len, size_t *output_len) {
+/* Processes passed string up to supplied length into output, which may be input itself since
+the output is never longer. Example: "\u006Corem ipsum" -> lorem ipsum */
+static JSON_Status process_string_to(const char *input, size_t input_len, char *output, size_t *output_len) {
     const char *input_ptr = input;
-    size_t initial_size = (input_len + 1) * sizeof(char);
-    size_t final_size = 0;
-    char *output = NULL, *output_ptr = NULL, *resized_output = NULL;
-    output = (char*)parson_malloc(initial_size);
-    if (output == NULL) {
-        goto error;
-    }
-    output_ptr = output;
+    char *output_ptr = output;
     while ((*input_ptr != '\0') && (size_t)(input_ptr - input) < input_len) {
         if (*input_ptr == '\\') {
             input_ptr++;
@@ -703,14 +940,14 @@ static char* process_string(const char *input, size_t input_len, size_t *output_
                 case 't':  *output_ptr = '\t'; break;
                 case 'u':
                     if (parse_utf16(&input_ptr, &output_ptr) == JSONFailure) {
-                        goto error;
+                        return JSONFailure;
                     }
                     break;
                 default:
-                    goto error;
+                    return JSONFailure;
             }
         } else if ((unsigned char)*input_ptr < 0x20) {
-            goto error; /* 0x00-0x19 are invalid characters for json string (http://www.ietf.org/rfc/rfc4627.txt) */
+            return JSONFailure; /* 0x00-0x19 are invalid characters for json string (http://www.ietf.org/rfc/rfc4627.txt) */
         } else {
             *output_ptr = *input_ptr;
         }
@@ -718,8 +955,24 @@ static char* process_string(const char *input, size_t input_len, size_t *output_
         input_ptr++;
     }
     *output_ptr = '\0';
+    *output_len = (size_t)(output_ptr - output);
+    return JSONSuccess;
+}
+
+/* Copies and processes passed string up to supplied length. */
+static char* process_string(const char *input, size_t input_len, size_t *output_len) {
+    size_t initial_size = (input_len + 1) * sizeof(char);
+    size_t final_size = 0;
+    char *output = NULL, *resized_output = NULL;
+    output = (char*)parson_malloc(initial_size);
+    if (output == NULL) {
+        goto error;
+    }
+    if (process_string_to(input, input_len, output, output_len) == JSONFailure) {
+        goto error;
+    }
     /* resize to new length */
-    final_size = (size_t)(output_ptr-output) + 1;
+    final_size = *output_len + 1;
     /* todo: don't resize if final_size == initial_size */
     resized_output = (char*)parson_malloc(final_size);
     if (resized_output == NULL) {
@@ -737,14 +990,68 @@ error:
 /* Return processed contents of a string between quotes and
    skips passed argument to a matching quote. */
 static char * get_quoted_string(const char **string, size_t *output_string_len) {
-    const char *string_start = *string;
+    const char *string_start = *string + 1;
+    const char *string_end = NULL;
     size_t input_string_len = 0;
-    JSON_Status status = skip_quotes(string);
-    if (status != JSONSuccess) {
+    char *output = NULL;
+    int plain = 0;
+    if (parson_in_place) {
+        return get_quoted_string_in_place(string, output_string_len);
+    }
+    if (**string != '\"') {
+        return NULL;
+    }
+    string_end = scan_string(string_start, &plain);
+    if (string_end == NULL) {
         return NULL;
     }
-    input_string_len = *string - string_start - 2; /* length without quotes */
-    return process_string(string_start + 1, input_string_len, output_string_len);
+    *string = string_end + 1;
+    input_string_len = string_end - string_start; /* length without quotes */
+    if (!plain) {
+        return process_string(string_start, input_string_len, output_string_len);
+    }
+    output = (char*)parson_malloc(input_string_len + 1);
+    if (output == NULL) {
+        return NULL;
+    }
+    if (input_string_len) {
+        memcpy_s(output, input_string_len + 1, string_start, input_string_len); /* SAFEC */
+    }
+    output[input_string_len] = '\0';
+    *output_string_len = input_string_len;
+    return output;
+}
+
+/* Like get_quoted_string, for json_parse_string_in_place: the string is processed where it is
+   and terminated over its closing quote, and the result points into the buffer being parsed. */
+static char * get_quoted_string_in_place(const char **string, size_t *output_string_len) {
+    char *string_start = (char*)*string + 1; /* the buffer is writable, see json_parse_string_in_place */
+    const char *string_end = NULL;
+    int plain = 0;
+    if (**string != '\"') {
+        return NULL;
+    }
+    string_end = scan_string(string_start, &plain);
+    if (string_end == NULL) {
+        return NULL;
+    }
+    *string = string_end + 1;
+    if (!plain) {
+        if (process_string_to(string_start, string_end - string_start, string_start, output_string_len) == JSONFailure) {
+            return NULL;
+        }
+        return string_start;
+    }
+    *output_string_len = string_end - string_start;
+    string_start[*output_string_len] = '\0';
+    return string_start;
+}
+
+/* Frees a string from get_quoted_string, unless it points into a buffer parsed in place */
+static void free_quoted_string(char *string) {
+    if (!parson_in_place) {
+        parson_free(string);
+    }
 }
 
 static JSON_Value * parse_value(const char **string, size_t nesting) {
@@ -797,31 +1104,31 @@ static JSON_Value * parse_object_value(const char **string, size_t nesting) {
         /* We do not support key names with embedded \0 chars */
         if (new_key == NULL || key_len != strnlen_s(new_key, STRING_NAME_MAX)) {
             if (new_key) {
-                parson_free(new_key);
+                free_quoted_string(new_key);
             }
             json_value_free(output_value);
             return NULL;
         }
         SKIP_WHITESPACES(string);
         if (**string != ':') {
-            parson_free(new_key);
+            free_quoted_string(new_key);
             json_value_free(output_value);
             return NULL;
         }
         SKIP_CHAR(string);
         new_value = parse_value(string, nesting);
         if (new_value == NULL) {
-            parson_free(new_key);
+            free_quoted_string(new_key);
             json_value_free(output_value);
             return NULL;
         }
         if (json_object_add(output_object, new_key, new_value) == JSONFailure) {
-            parson_free(new_key);
+            free_quoted_string(new_key);
             json_value_free(new_value);
             json_value_free(output_value);
             return NULL;
         }
-        parson_free(new_key);
+        free_quoted_string(new_key);
         SKIP_WHITESPACES(string);
         if (**string != ',') {
             break;
@@ -894,9 +1201,10 @@ static JSON_Value * parse_string_value(const char **string) {
     }
     value = json_value_init_string_no_copy(new_string, new_string_len);
     if (value == NULL) {
-        parson_free(new_string);
+        free_quoted_string(new_string);
         return NULL;
     }
+    value->borrowed = parson_in_place;
     return value;
 }
 
@@ -1214,6 +1522,22 @@ JSON_Value * json_parse_string(const char *string) {
     return parse_value((const char**)&string, 0);
 }
 
+JSON_Value * json_parse_string_in_place(char *string) {
+    int prev = parson_in_place;
+    JSON_Value *output_value = NULL;
+    parson_in_place = 1;
+    output_value = json_parse_string(string);
+    parson_in_place = prev;
+    return output_value;
+}
+
+JSON_Value * json_parse_string_with_allocator(const char *string, const JSON_Allocator *allocator) {
+    const JSON_Allocator *prev = json_set_thread_allocator(allocator);
+    JSON_Value *output_value = json_parse_string(string);
+    json_set_thread_allocator(prev);
+    return output_value;
+}
+
 #if 0 /* Removed, does not currently comply with SAFEC */
 JSON_Value * json_parse_string_with_comments(const char *string) {
     JSON_Value *result = NULL;
@@ -1234,10 +1558,47 @@ JSON_Value * json_parse_string_with_comments(const char *string) {
 /* JSON Object API */
 
 JSON_Value * json_object_get_value(const JSON_Object *object, const char *name) {
+    size_t name_len = 0;
     if (object == NULL || name == NULL) {
         return NULL;
     }
-    return json_object_getn_value(object, name, strnlen_s(name, STRING_NAME_MAX)); /* SAFEC */
+    name_len = strnlen_s(name, STRING_NAME_MAX); /* SAFEC */
+    if (object->index == NULL) {
+        return json_object_getn_value(object, name, name_len);
+    }
+    return json_object_find(object, name, name_len, json_object_hash(name, name_len));
+}
+
+void json_key_init(JSON_Key *key, const char *name) {
+    if (key == NULL) {
+        return;
+    }
+    key->name = name;
+    key->len = name ? strnlen_s(name, STRING_NAME_MAX) : 0; /* SAFEC */
+    key->hash = name ? json_object_hash(name, key->len) : 0;
+}
+
+JSON_Value * json_object_get_value_key(const JSON_Object *object, const JSON_Key *key) {
+    if (object == NULL || key == NULL || key->name == NULL) {
+        return NULL;
+    }
+    return json_object_find(object, key->name, key->len, key->hash);
+}
+
+const char * json_object_get_string_key(const JSON_Object *object, const JSON_Key *key) {
+    return json_value_get_string(json_object_get_value_key(object, key));
+}
+
+double json_object_get_number_key(const JSON_Object *object, const JSON_Key *key) {
+    return json_value_get_number(json_object_get_value_key(object, key));
+}
+
+JSON_Object * json_object_get_object_key(const JSON_Object *object, const JSON_Key *key) {
+    return json_value_get_object(json_object_get_value_key(object, key));
+}
+
+JSON_Array * json_object_get_array_key(const JSON_Object *object, const JSON_Key *key) {
+    return json_value_get_array(json_object_get_value_key(object, key));
 }
 
 const char * json_object_get_string(const JSON_Object *object, const char *name) {
@@ -1418,6 +1779,14 @@ size_t json_value_get_string_len(const JSON_Value *value) {
     return str ? str->length : 0;
 }
 
+const unsigned char * json_value_get_string_bin(const JSON_Value *value) {
+    const JSON_String *str = json_value_get_string_desc(value);
+    if (str == NULL || value->borrowed != PARSON_BORROWED_BIN) {
+        return NULL;
+    }
+    return (const unsigned char*)str->chars + str->length + 1;
+}
+
 double json_value_get_number(const JSON_Value *value) {
     return json_value_get_type(value) == JSONNumber ? value->value.number : 0;
 }
@@ -1436,7 +1805,9 @@ void json_value_free(JSON_Value *value) {
             json_object_free(value->value.object);
             break;
         case JSONString:
-            parson_free(value->value.string.chars);
+            if (!value->borrowed) {
+                parson_free(value->value.string.chars);
+            }
             break;
         case JSONArray:
             json_array_free(value->value.array);
@@ -1508,6 +1879,39 @@ JSON_Value * json_value_init_string_with_len(const char *string, size_t length)
     return value;
 }
 
+JSON_Value * json_value_init_string_ref(const char *chars, size_t length, int has_bin) {
+    JSON_Value *value = NULL;
+    if (chars == NULL) {
+        return NULL;
+    }
+    value = json_value_init_string_no_copy((char*)chars, length);
+    if (value == NULL) {
+        return NULL;
+    }
+    value->borrowed = has_bin ? PARSON_BORROWED_BIN : 1;
+    return value;
+}
+
+JSON_Value * json_value_init_string_buffer(size_t length, char **chars) {
+    char *buf = NULL;
+    JSON_Value *value;
+    if (chars == NULL) {
+        return NULL;
+    }
+    buf = (char*)parson_malloc(length + 1);
+    if (buf == NULL) {
+        return NULL;
+    }
+    buf[length] = '\0';
+    value = json_value_init_string_no_copy(buf, length);
+    if (value == NULL) {
+        parson_free(buf);
+        return NULL;
+    }
+    *chars = buf;
+    return value;
+}
+
 JSON_Value * json_value_init_number(double number) {
     JSON_Value *new_value = NULL;
     if (IS_NUMBER_INVALID(number)) {
@@ -1679,7 +2083,7 @@ char * json_serialize_to_string(const JSON_Value *value, int *len) {
          */
         *len = buf_size_bytes - 1;
     }
-    buf = (char*)parson_malloc(buf_size_bytes);
+    buf = (char*)parson_malloc_fun(buf_size_bytes);
     if (buf == NULL) {
         return NULL;
     }
@@ -1746,7 +2150,7 @@ char * json_serialize_to_string_pretty(const JSON_Value *value, int *len) {
          */
         *len = buf_size_bytes - 1;
     }
-    buf = (char*)parson_malloc(buf_size_bytes);
+    buf = (char*)parson_malloc_fun(buf_size_bytes);
     if (buf == NULL) {
         return NULL;
     }
@@ -1759,7 +2163,7 @@ char * json_serialize_to_string_pretty(const JSON_Value *value, int *len) {
 }
 
 void json_free_serialized_string(char *string) {
-    parson_free(string);
+    parson_free_fun(string);
 }
 
 #if 0 /* Removed, does not currently comply with SAFEC */
@@ -1858,6 +2262,23 @@ JSON_Status json_array_clear(JSON_Array *array) {
     return JSONSuccess;
 }
 
+JSON_Status json_array_move_values(JSON_Array *to, JSON_Array *from) {
+    size_t i = 0;
+    if (to == NULL || from == NULL || to == from) {
+        return JSONFailure;
+    }
+    if (to->count + from->count > to->capacity &&
+        json_array_resize(to, MAX(to->capacity * 2, to->count + from->count)) == JSONFailure) {
+        return JSONFailure;
+    }
+    for (i = 0; i < from->count; i++) {
+        from->items[i]->parent = json_array_get_wrapping_value(to);
+        to->items[to->count++] = from->items[i];
+    }
+    from->count = 0;
+    return JSONSuccess;
+}
+
 JSON_Status json_array_append_value(JSON_Array *array, JSON_Value *value) {
     if (array == NULL || value == NULL || value->parent != NULL) {
         return JSONFailure;
@@ -2131,10 +2552,11 @@ JSON_Status json_object_clear(JSON_Object *object) {
         return JSONFailure;
     }
     for (i = 0; i < json_object_get_count(object); i++) {
-        parson_free(object->names[i]);
+        parson_free_with(object->allocator, object->names[i]);
         json_value_free(object->values[i]);
     }
     object->count = 0;
+    json_object_index_drop(object);
     return JSONSuccess;
 }
 
@@ -2294,8 +2716,19 @@ int json_boolean(const JSON_Value *value) {
 }
 
 void json_set_allocation_functions(JSON_Malloc_Function malloc_fun, JSON_Free_Function free_fun) {
-    parson_malloc = malloc_fun;
-    parson_free = free_fun;
+    parson_malloc_fun = malloc_fun;
+    parson_free_fun = free_fun;
+}
+
+void json_get_allocation_functions(JSON_Malloc_Function *malloc_fun, JSON_Free_Function *free_fun) {
+    if (malloc_fun) *malloc_fun = parson_malloc_fun;
+    if (free_fun) *free_fun = parson_free_fun;
+}
+
+const JSON_Allocator * json_set_thread_allocator(const JSON_Allocator *allocator) {
+    const JSON_Allocator *prev = parson_allocator;
+    parson_allocator = allocator;
+    return prev;
 }
 
 void json_set_escape_slashes(int escape_slashes) {
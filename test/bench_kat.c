@@ -0,0 +1,456 @@
+/** @file */
+/*
+ * Copyright (c) 2021, Cisco Systems, Inc.
+ *
+ * Licensed under the Apache License 2.0 (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://github.com/cisco/libamvp/LICENSE
+ */
+
+/*
+ * Offline benchmark for the KAT handlers, built with "make bench".
+ *
+ * Each fixture is a vector set from the json directory (or one generated
+ * here) that is scaled up by repeating its test cases, written out as an
+ * offline request file and run through amvp_run_vectors_from_file() with
+ * stub crypto handlers. That covers parsing, hex conversion, the handler
+ * itself and building the response, without any crypto or network cost.
+ *
+ * For every fixture the test cases/sec, request bytes/sec and heap
+ * allocations per test case are reported, so a change to any of those
+ * paths can be compared against the baseline with the same options. The
+ * time and request and response bytes per test case are reported too,
+ * they are the lib_us, req_bytes and rsp_bytes of the fixture's
+ * AMVP_WORKLOAD_MODEL, see amvp_set_workload_model().
+ *
+ * With -c the request file is read through its vector set cache, see
+ * amvp_set_vs_cache(), written by an untimed run before the timed ones.
+ *
+ * usage: katbench [-c] [-d json_dir] [-s scale] [-n iterations] [fixture...]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "amvp/amvp.h"
+#include "amvp/parson.h"
+
+#define BENCH_DEFAULT_SCALE 8
+#define BENCH_DEFAULT_ITERATIONS 5
+#define BENCH_HASH_TESTS 256
+#define BENCH_PATH_MAX 256
+
+/*
+ * Heap allocations are counted by interposing the allocator, which also
+ * catches the calls made from within libamvp and parson. This relies on
+ * the glibc entry points, elsewhere the count is reported as n/a.
+ */
+#if defined __GLIBC__ && !defined BENCH_NO_ALLOC_COUNT
+#define BENCH_ALLOC_COUNT
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void __libc_free(void *ptr);
+
+static unsigned long bench_allocs = 0;
+
+void *malloc(size_t size) {
+    bench_allocs++;
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size) {
+    bench_allocs++;
+    return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+    bench_allocs++;
+    return __libc_realloc(ptr, size);
+}
+
+void free(void *ptr) {
+    __libc_free(ptr);
+}
+#endif
+
+typedef struct bench_fixture_t {
+    const char *name;
+    const char *file;               /* Relative to the json dir, NULL if generated */
+    JSON_Value *(*generate)(void);  /* Builds the vector set when there is no file */
+    int (*enable)(AMVP_CTX *ctx);
+} BENCH_FIXTURE;
+
+typedef struct bench_result_t {
+    int test_cases;
+    size_t req_bytes;
+    size_t rsp_bytes;
+    double secs;
+    unsigned long allocs;
+} BENCH_RESULT;
+
+static double bench_now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/*
+ * Stub crypto handlers. They fill in the output lengths from the inputs so
+ * the response is built at its real size.
+ */
+static int bench_sym_handler(AMVP_TEST_CASE *test_case) {
+    AMVP_SYM_CIPHER_TC *tc = test_case->tc.symmetric;
+
+    if (tc->direction == AMVP_SYM_CIPH_DIR_ENCRYPT) {
+        memcpy(tc->ct, tc->pt, tc->pt_len);
+        tc->ct_len = tc->pt_len;
+    } else {
+        memcpy(tc->pt, tc->ct, tc->ct_len);
+        tc->pt_len = tc->ct_len;
+    }
+    return 0;
+}
+
+static int bench_cmac_handler(AMVP_TEST_CASE *test_case) {
+    AMVP_CMAC_TC *tc = test_case->tc.cmac;
+
+    if (tc->verify) {
+        tc->ver_disposition = AMVP_TEST_DISPOSITION_PASS;
+    } else {
+        memset(tc->mac, 0xa5, tc->mac_len);
+    }
+    return 0;
+}
+
+static int bench_hash_handler(AMVP_TEST_CASE *test_case) {
+    AMVP_HASH_TC *tc = test_case->tc.hash;
+
+    memset(tc->md, 0x5a, 32);
+    tc->md_len = 32;
+    return 0;
+}
+
+static int bench_enable_aes(AMVP_CTX *ctx) {
+    AMVP_RESULT rv;
+
+    rv = amvp_cap_sym_cipher_enable(ctx, AMVP_AES_CBC, &bench_sym_handler);
+    if (rv != AMVP_SUCCESS) return rv;
+    rv = amvp_cap_sym_cipher_set_parm(ctx, AMVP_AES_CBC, AMVP_SYM_CIPH_PARM_DIR, AMVP_SYM_CIPH_DIR_BOTH);
+    if (rv != AMVP_SUCCESS) return rv;
+    rv = amvp_cap_sym_cipher_set_parm(ctx, AMVP_AES_CBC, AMVP_SYM_CIPH_KEYLEN, 128);
+    if (rv != AMVP_SUCCESS) return rv;
+    rv = amvp_cap_sym_cipher_set_parm(ctx, AMVP_AES_CBC, AMVP_SYM_CIPH_KEYLEN, 192);
+    if (rv != AMVP_SUCCESS) return rv;
+    return amvp_cap_sym_cipher_set_parm(ctx, AMVP_AES_CBC, AMVP_SYM_CIPH_KEYLEN, 256);
+}
+
+static int bench_enable_cmac(AMVP_CTX *ctx) {
+    AMVP_RESULT rv;
+
+    rv = amvp_cap_cmac_enable(ctx, AMVP_CMAC_AES, &bench_cmac_handler);
+    if (rv != AMVP_SUCCESS) return rv;
+    rv = amvp_cap_cmac_set_parm(ctx, AMVP_CMAC_AES, AMVP_CMAC_MACLEN, 128);
+    if (rv != AMVP_SUCCESS) return rv;
+    return amvp_cap_cmac_set_parm(ctx, AMVP_CMAC_AES, AMVP_CMAC_KEYLEN, 128);
+}
+
+static int bench_enable_hash(AMVP_CTX *ctx) {
+    return amvp_cap_hash_enable(ctx, AMVP_HASH_SHA256, &bench_hash_handler);
+}
+
+/*
+ * There is no hash vector set under json/, so build a SHA2-256 AFT set
+ * with messages from 0 to 4080 bytes.
+ */
+static JSON_Value *bench_generate_hash(void) {
+    JSON_Value *vs_val = json_value_init_object();
+    JSON_Value *tests_val = json_value_init_array();
+    JSON_Value *groups_val = json_value_init_array();
+    JSON_Value *group_val = json_value_init_object();
+    JSON_Object *vs = json_value_get_object(vs_val);
+    JSON_Object *group = json_value_get_object(group_val);
+    char *msg = NULL;
+    int i, j;
+
+    msg = calloc(BENCH_HASH_TESTS * 32 + 1, sizeof(char));
+    for (i = 0; i < BENCH_HASH_TESTS; i++) {
+        JSON_Value *tv = json_value_init_object();
+        JSON_Object *to = json_value_get_object(tv);
+
+        for (j = 0; j < i * 32; j++) {
+            msg[j] = "0123456789ABCDEF"[(i + j) & 0xf];
+        }
+        msg[i * 32] = '\0';
+        json_object_set_number(to, "tcId", i + 1);
+        json_object_set_string(to, "msg", msg);
+        json_array_append_value(json_value_get_array(tests_val), tv);
+    }
+    free(msg);
+
+    json_object_set_number(group, "tgId", 1);
+    json_object_set_string(group, "testType", "AFT");
+    json_object_set_value(group, "tests", tests_val);
+    json_array_append_value(json_value_get_array(groups_val), group_val);
+    json_object_set_number(vs, "vsId", 3);
+    json_object_set_string(vs, "algorithm", "SHA2-256");
+    json_object_set_string(vs, "revision", "1.0");
+    json_object_set_value(vs, "testGroups", groups_val);
+    return vs_val;
+}
+
+static const BENCH_FIXTURE bench_fixtures[] = {
+    { "aes-cbc",  "aes/aes.json", NULL,                &bench_enable_aes },
+    { "cmac-aes", "req.json",     NULL,                &bench_enable_cmac },
+    { "sha2-256", NULL,           &bench_generate_hash, &bench_enable_hash }
+};
+#define BENCH_FIXTURE_CNT (int)(sizeof(bench_fixtures) / sizeof(BENCH_FIXTURE))
+
+/*
+ * Repeats every test group's test cases scale times with new tcIds.
+ * Returns the number of test cases in the vector set.
+ */
+static int bench_scale_vs(JSON_Object *vs, int scale) {
+    JSON_Array *groups = json_object_get_array(vs, "testGroups");
+    JSON_Array *tests = NULL;
+    size_t g, t, cnt;
+    int s, tc_id = 1, total = 0;
+
+    for (g = 0; g < json_array_get_count(groups); g++) {
+        tests = json_object_get_array(json_array_get_object(groups, g), "tests");
+        cnt = json_array_get_count(tests);
+        for (s = 1; s < scale; s++) {
+            for (t = 0; t < cnt; t++) {
+                json_array_append_value(tests, json_value_deep_copy(json_array_get_value(tests, t)));
+            }
+        }
+        for (t = 0; t < json_array_get_count(tests); t++) {
+            json_object_set_number(json_array_get_object(tests, t), "tcId", tc_id++);
+            total++;
+        }
+    }
+    return total;
+}
+
+/*
+ * Writes the offline request file for a fixture: the session identifiers
+ * followed by every vector set in the source, scaled. Returns the number
+ * of test cases, or -1 on error.
+ */
+static int bench_write_request(const BENCH_FIXTURE *fx, const char *json_dir, int scale,
+                               const char *req_file) {
+    char path[BENCH_PATH_MAX];
+    JSON_Value *src_val = NULL, *req_val = NULL, *ids_val = NULL, *urls_val = NULL, *vs_val = NULL;
+    JSON_Array *src = NULL, *req = NULL;
+    JSON_Object *ids = NULL;
+    int total = 0, vs_cnt = 0;
+    size_t i;
+
+    req_val = json_value_init_array();
+    req = json_value_get_array(req_val);
+    ids_val = json_value_init_object();
+    ids = json_value_get_object(ids_val);
+    urls_val = json_value_init_array();
+    json_object_set_string(ids, "url", "/amvp/v1/testSessions/0");
+    json_object_set_string(ids, "jwt", "bench");
+    json_object_set_boolean(ids, "isSample", 1);
+    json_object_set_value(ids, "vectorSetUrls", urls_val);
+    json_array_append_value(req, ids_val);
+
+    if (fx->file) {
+        snprintf(path, sizeof(path), "%s/%s", json_dir, fx->file);
+        src_val = json_parse_file(path);
+        src = json_value_get_array(src_val);
+        if (!src) {
+            fprintf(stderr, "Unable to parse %s\n", path);
+            goto err;
+        }
+        for (i = 0; i < json_array_get_count(src); i++) {
+            if (!json_object_has_value(json_array_get_object(src, i), "testGroups")) {
+                continue;
+            }
+            vs_val = json_value_deep_copy(json_array_get_value(src, i));
+            total += bench_scale_vs(json_value_get_object(vs_val), scale);
+            json_array_append_value(req, vs_val);
+            vs_cnt++;
+        }
+    } else {
+        vs_val = fx->generate();
+        total += bench_scale_vs(json_value_get_object(vs_val), scale);
+        json_array_append_value(req, vs_val);
+        vs_cnt++;
+    }
+    for (i = 0; i < (size_t)vs_cnt; i++) {
+        snprintf(path, sizeof(path), "/amvp/v1/testSessions/0/vectorSets/%d", (int)i + 1);
+        json_array_append_string(json_value_get_array(urls_val), path);
+    }
+
+    if (!vs_cnt || json_serialize_to_file(req_val, req_file) != JSONSuccess) {
+        fprintf(stderr, "Unable to build the request file for %s\n", fx->name);
+        goto err;
+    }
+    json_value_free(src_val);
+    json_value_free(req_val);
+    return total;
+
+err:
+    json_value_free(src_val);
+    json_value_free(req_val);
+    return -1;
+}
+
+static int bench_run_fixture(const BENCH_FIXTURE *fx, const char *json_dir, int scale,
+                             int iterations, int cache, BENCH_RESULT *res) {
+    char req_file[] = "/tmp/katbench_req_XXXXXX";
+    char cache_file[sizeof(req_file) + 8];
+    char rsp_file[] = "/tmp/katbench_rsp_XXXXXX";
+    AMVP_CTX *ctx = NULL;
+    AMVP_RESULT rv;
+    FILE *fp = NULL;
+    double start;
+    int fd, i, ret = 1;
+#ifdef BENCH_ALLOC_COUNT
+    unsigned long allocs;
+#endif
+
+    memset(res, 0, sizeof(BENCH_RESULT));
+    fd = mkstemp(req_file);
+    if (fd < 0) return 1;
+    close(fd);
+    fd = mkstemp(rsp_file);
+    if (fd < 0) {
+        unlink(req_file);
+        return 1;
+    }
+    close(fd);
+
+    res->test_cases = bench_write_request(fx, json_dir, scale, req_file);
+    if (res->test_cases < 0) {
+        goto end;
+    }
+    fp = fopen(req_file, "rb");
+    if (fp) {
+        fseek(fp, 0, SEEK_END);
+        res->req_bytes = (size_t)ftell(fp);
+        fclose(fp);
+    }
+
+    /* Iteration -1 writes the cache and isn't counted */
+    for (i = cache ? -1 : 0; i < iterations; i++) {
+        rv = amvp_create_test_session(&ctx, NULL, AMVP_LOG_LVL_NONE);
+        if (rv != AMVP_SUCCESS) goto end;
+        if (cache) amvp_set_vs_cache(ctx, 1);
+        rv = fx->enable(ctx);
+        if (rv != AMVP_SUCCESS) {
+            fprintf(stderr, "Failed to enable %s (%d)\n", fx->name, rv);
+            goto end;
+        }
+
+#ifdef BENCH_ALLOC_COUNT
+        allocs = bench_allocs;
+#endif
+        start = bench_now();
+        rv = amvp_run_vectors_from_file(ctx, req_file, rsp_file);
+        if (i >= 0) {
+            res->secs += bench_now() - start;
+#ifdef BENCH_ALLOC_COUNT
+            res->allocs += bench_allocs - allocs;
+#endif
+        }
+        if (rv != AMVP_SUCCESS) {
+            fprintf(stderr, "Offline run of %s failed (%d)\n", fx->name, rv);
+            goto end;
+        }
+        amvp_free_test_session(ctx);
+        ctx = NULL;
+    }
+    fp = fopen(rsp_file, "rb");
+    if (fp) {
+        fseek(fp, 0, SEEK_END);
+        res->rsp_bytes = (size_t)ftell(fp);
+        fclose(fp);
+    }
+    ret = 0;
+
+end:
+    if (ctx) amvp_free_test_session(ctx);
+    snprintf(cache_file, sizeof(cache_file), "%s.amvb", req_file);
+    unlink(cache_file);
+    unlink(req_file);
+    unlink(rsp_file);
+    return ret;
+}
+
+static void bench_usage(const char *prog) {
+    int i;
+
+    printf("usage: %s [-c] [-d json_dir] [-s scale] [-n iterations] [fixture...]\n", prog);
+    printf("fixtures:");
+    for (i = 0; i < BENCH_FIXTURE_CNT; i++) {
+        printf(" %s", bench_fixtures[i].name);
+    }
+    printf("\n");
+}
+
+int main(int argc, char **argv) {
+    const char *json_dir = "json";
+    int scale = BENCH_DEFAULT_SCALE, iterations = BENCH_DEFAULT_ITERATIONS;
+    BENCH_RESULT res;
+    double tcs = 0;
+    int opt, i, j, cache = 0, failed = 0;
+
+    while ((opt = getopt(argc, argv, "cd:s:n:h")) != -1) {
+        switch (opt) {
+        case 'c':
+            cache = 1;
+            break;
+        case 'd':
+            json_dir = optarg;
+            break;
+        case 's':
+            scale = atoi(optarg);
+            break;
+        case 'n':
+            iterations = atoi(optarg);
+            break;
+        default:
+            bench_usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (scale < 1 || iterations < 1) {
+        bench_usage(argv[0]);
+        return 1;
+    }
+
+    printf("%-10s %8s %12s %10s %8s %10s %10s %12s\n", "fixture", "tcs", "tcs/sec", "MB/sec",
+           "us/tc", "req B/tc", "rsp B/tc", "allocs/tc");
+    for (i = 0; i < BENCH_FIXTURE_CNT; i++) {
+        if (optind < argc) {
+            for (j = optind; j < argc; j++) {
+                if (!strcmp(argv[j], bench_fixtures[i].name)) break;
+            }
+            if (j == argc) continue;
+        }
+        if (bench_run_fixture(&bench_fixtures[i], json_dir, scale, iterations, cache, &res)) {
+            printf("%-10s failed\n", bench_fixtures[i].name);
+            failed = 1;
+            continue;
+        }
+        tcs = (double)res.test_cases * iterations;
+        printf("%-10s %8d %12.0f %10.2f ", bench_fixtures[i].name, res.test_cases,
+               tcs / res.secs, (double)res.req_bytes * iterations / res.secs / (1024 * 1024));
+        printf("%8.2f %10.0f %10.0f ", res.secs * 1e6 / tcs, (double)res.req_bytes / res.test_cases,
+               (double)res.rsp_bytes / res.test_cases);
+#ifdef BENCH_ALLOC_COUNT
+        printf("%12.1f\n", (double)res.allocs / tcs);
+#else
+        printf("%12s\n", "n/a");
+#endif
+    }
+    return failed;
+}
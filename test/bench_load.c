@@ -0,0 +1,378 @@
+/** @file */
+/*
+ * Copyright (c) 2021, Cisco Systems, Inc.
+ *
+ * Licensed under the Apache License 2.0 (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://github.com/cisco/libamvp/LICENSE
+ */
+
+/*
+ * End to end load test, built and run against mockserver (mock_server.c)
+ * with "make loadtest".
+ *
+ * Runs the whole amvp_run() flow, login, registration, vector set downloads
+ * and retries, response uploads and the results check, for -n test
+ * sessions, -w of them at a time on their own threads. Each session takes
+ * the transfer options given: -t concurrent transfers, -P pipeline depth,
+ * -2 for HTTP/2, -z for compressed and -k for chunked uploads. The crypto
+ * handlers are stubs, as in katbench, for the vector sets mockserver serves
+ * by default. The sessions aren't put in a session group, which would share
+ * connections between them, as that rules out the metrics read here; the
+ * connections mockserver counts show how well they were reused.
+ *
+ * The wall time, sessions and vector sets per second, HTTP requests, new
+ * connections (requests that did a TLS handshake) and bytes each way are
+ * printed, from the metrics of every session, so the same mockserver
+ * options give numbers that can be compared between runs and changes.
+ *
+ * usage: loadbench [-h host] [-p port] [-c cacert] [-n sessions] [-w threads]
+ *                  [-t transfers] [-P depth] [-k kbytes] [-2] [-z] [-v]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <curl/curl.h>
+#include "amvp/amvp.h"
+
+#define LOAD_DEFAULT_HOST "localhost"
+#define LOAD_DEFAULT_PORT 18443
+#define LOAD_DEFAULT_CACERT "mockserver.pem"
+#define LOAD_DEFAULT_SESSIONS 8
+#define LOAD_PATH_MAX 512
+
+typedef struct load_cfg_t {
+    const char *host;
+    int port;
+    const char *cacert;
+    int sessions;
+    int threads;
+    int transfers;
+    int pipeline_depth;
+    int chunk_kbytes;
+    int http2;
+    int compress;
+    int verbose;
+} LOAD_CFG;
+
+typedef struct load_totals_t {
+    int failed;
+    int vector_sets;
+    int test_cases;
+    int retries;
+    int requests;
+    int connections;
+    unsigned long long bytes_up;
+    unsigned long long bytes_down;
+} LOAD_TOTALS;
+
+/* Sessions waiting to be run, taken in order by the threads */
+typedef struct load_queue_t {
+    AMVP_CTX **ctxs;
+    AMVP_RESULT *results;
+    int count;
+    int next;
+    pthread_mutex_t lock;
+} LOAD_QUEUE;
+
+static int load_verbose = 0;
+
+static double load_now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static AMVP_RESULT load_progress(char *msg, AMVP_LOG_LVL level) {
+    if (load_verbose || level == AMVP_LOG_LVL_ERR) {
+        printf("%s", msg);
+    }
+    return AMVP_SUCCESS;
+}
+
+/* Stub crypto handlers, they only size the outputs */
+static int load_sym_handler(AMVP_TEST_CASE *test_case) {
+    AMVP_SYM_CIPHER_TC *tc = test_case->tc.symmetric;
+
+    if (tc->direction == AMVP_SYM_CIPH_DIR_ENCRYPT) {
+        memcpy(tc->ct, tc->pt, tc->pt_len);
+        tc->ct_len = tc->pt_len;
+    } else {
+        memcpy(tc->pt, tc->ct, tc->ct_len);
+        tc->pt_len = tc->ct_len;
+    }
+    return 0;
+}
+
+static int load_cmac_handler(AMVP_TEST_CASE *test_case) {
+    AMVP_CMAC_TC *tc = test_case->tc.cmac;
+
+    if (tc->verify) {
+        tc->ver_disposition = AMVP_TEST_DISPOSITION_PASS;
+    } else {
+        memset(tc->mac, 0xa5, tc->mac_len);
+    }
+    return 0;
+}
+
+static AMVP_RESULT load_enable_caps(AMVP_CTX *ctx) {
+    AMVP_RESULT rv;
+
+    rv = amvp_cap_sym_cipher_enable(ctx, AMVP_AES_CBC, &load_sym_handler);
+    if (rv != AMVP_SUCCESS) return rv;
+    rv = amvp_cap_sym_cipher_set_parm(ctx, AMVP_AES_CBC, AMVP_SYM_CIPH_PARM_DIR, AMVP_SYM_CIPH_DIR_BOTH);
+    if (rv != AMVP_SUCCESS) return rv;
+    rv = amvp_cap_sym_cipher_set_parm(ctx, AMVP_AES_CBC, AMVP_SYM_CIPH_KEYLEN, 128);
+    if (rv != AMVP_SUCCESS) return rv;
+    rv = amvp_cap_sym_cipher_set_parm(ctx, AMVP_AES_CBC, AMVP_SYM_CIPH_KEYLEN, 192);
+    if (rv != AMVP_SUCCESS) return rv;
+    rv = amvp_cap_sym_cipher_set_parm(ctx, AMVP_AES_CBC, AMVP_SYM_CIPH_KEYLEN, 256);
+    if (rv != AMVP_SUCCESS) return rv;
+    rv = amvp_cap_sym_cipher_set_parm(ctx, AMVP_AES_CBC, AMVP_SYM_CIPH_PTLEN, 1536);
+    if (rv != AMVP_SUCCESS) return rv;
+    rv = amvp_cap_cmac_enable(ctx, AMVP_CMAC_AES, &load_cmac_handler);
+    if (rv != AMVP_SUCCESS) return rv;
+    rv = amvp_cap_cmac_set_domain(ctx, AMVP_CMAC_AES, AMVP_CMAC_MSGLEN, 0, 65536, 8);
+    if (rv != AMVP_SUCCESS) return rv;
+    rv = amvp_cap_cmac_set_parm(ctx, AMVP_CMAC_AES, AMVP_CMAC_MACLEN, 128);
+    if (rv != AMVP_SUCCESS) return rv;
+    rv = amvp_cap_cmac_set_parm(ctx, AMVP_CMAC_AES, AMVP_CMAC_KEYLEN, 128);
+    if (rv != AMVP_SUCCESS) return rv;
+    rv = amvp_cap_cmac_set_parm(ctx, AMVP_CMAC_AES, AMVP_CMAC_DIRECTION_GEN, 1);
+    if (rv != AMVP_SUCCESS) return rv;
+    rv = amvp_cap_cmac_set_parm(ctx, AMVP_CMAC_AES, AMVP_CMAC_DIRECTION_VER, 1);
+    if (rv != AMVP_SUCCESS) return rv;
+    return amvp_cap_set_prereq(ctx, AMVP_CMAC_AES, AMVP_PREREQ_AES, "same");
+}
+
+static AMVP_RESULT load_setup_ctx(const LOAD_CFG *cfg, AMVP_CTX **ctx) {
+    AMVP_RESULT rv;
+
+    rv = amvp_create_test_session(ctx, &load_progress,
+                                  cfg->verbose ? AMVP_LOG_LVL_STATUS : AMVP_LOG_LVL_ERR);
+    if (rv != AMVP_SUCCESS) return rv;
+    rv = amvp_set_server(*ctx, cfg->host, cfg->port);
+    if (rv != AMVP_SUCCESS) return rv;
+    rv = amvp_set_path_segment(*ctx, "/amvp/v1/");
+    if (rv != AMVP_SUCCESS) return rv;
+    rv = amvp_set_cacerts(*ctx, cfg->cacert);
+    if (rv != AMVP_SUCCESS) return rv;
+    rv = amvp_set_metrics(*ctx, 1, NULL);
+    if (rv != AMVP_SUCCESS) return rv;
+    if (cfg->transfers > 1) {
+        rv = amvp_set_max_concurrent_transfers(*ctx, cfg->transfers);
+        if (rv != AMVP_SUCCESS) return rv;
+    }
+    if (cfg->pipeline_depth) {
+        rv = amvp_set_pipeline_depth(*ctx, cfg->pipeline_depth);
+        if (rv != AMVP_SUCCESS) return rv;
+    }
+    if (cfg->chunk_kbytes) {
+        rv = amvp_set_chunked_upload(*ctx, cfg->chunk_kbytes);
+        if (rv != AMVP_SUCCESS) return rv;
+    }
+    if (cfg->compress) {
+        rv = amvp_set_upload_compression(*ctx, 1);
+        if (rv != AMVP_SUCCESS) return rv;
+    }
+    if (cfg->http2) {
+        rv = amvp_set_http2(*ctx, 1);
+        if (rv != AMVP_SUCCESS) return rv;
+    }
+    return load_enable_caps(*ctx);
+}
+
+static void load_add_metrics(AMVP_CTX *ctx, LOAD_TOTALS *totals) {
+    AMVP_VS_METRICS vs;
+    AMVP_NET_TIMING net;
+    int i;
+
+    for (i = 0; amvp_get_vs_metrics(ctx, i, &vs) == AMVP_SUCCESS; i++) {
+        totals->vector_sets++;
+        totals->test_cases += vs.test_cases;
+        totals->retries += vs.retries;
+    }
+    for (i = 0; amvp_get_net_timing(ctx, i, &net) == AMVP_SUCCESS; i++) {
+        totals->requests++;
+        if (net.tls_ms > 0) totals->connections++;
+        totals->bytes_up += net.bytes_up;
+        totals->bytes_down += net.bytes_down;
+    }
+}
+
+static void *load_worker(void *arg) {
+    LOAD_QUEUE *queue = arg;
+    int i;
+
+    for (;;) {
+        pthread_mutex_lock(&queue->lock);
+        i = queue->next < queue->count ? queue->next++ : -1;
+        pthread_mutex_unlock(&queue->lock);
+        if (i < 0) break;
+        queue->results[i] = amvp_run(queue->ctxs[i], 0);
+    }
+    return NULL;
+}
+
+/* Removes the session files amvp_run() saved in dir, and dir */
+static void load_remove_dir(const char *dir) {
+    char path[LOAD_PATH_MAX];
+    struct dirent *ent = NULL;
+    DIR *d = opendir(dir);
+
+    if (d) {
+        while ((ent = readdir(d))) {
+            if (!strcmp(ent->d_name, ".") || !strcmp(ent->d_name, "..")) continue;
+            snprintf(path, sizeof(path), "%s/%s", dir, ent->d_name);
+            unlink(path);
+        }
+        closedir(d);
+    }
+    rmdir(dir);
+}
+
+static void load_usage(const char *prog) {
+    printf("usage: %s [-h host] [-p port] [-c cacert] [-n sessions] [-w threads]\n"
+           "       [-t transfers] [-P depth] [-k kbytes] [-2] [-z] [-v]\n", prog);
+}
+
+int main(int argc, char **argv) {
+    char save_dir[] = "/tmp/loadbench_XXXXXX";
+    pthread_t *tids = NULL;
+    LOAD_QUEUE queue;
+    AMVP_RESULT rv;
+    LOAD_CFG cfg;
+    LOAD_TOTALS totals;
+    double start, secs;
+    int opt, i, started = 0, ret = 1;
+
+    memset(&cfg, 0, sizeof(cfg));
+    memset(&totals, 0, sizeof(totals));
+    memset(&queue, 0, sizeof(queue));
+    cfg.host = LOAD_DEFAULT_HOST;
+    cfg.port = LOAD_DEFAULT_PORT;
+    cfg.cacert = LOAD_DEFAULT_CACERT;
+    cfg.sessions = LOAD_DEFAULT_SESSIONS;
+    cfg.threads = 1;
+    cfg.transfers = 1;
+    while ((opt = getopt(argc, argv, "h:p:c:n:w:t:P:k:2zv")) != -1) {
+        switch (opt) {
+        case 'h':
+            cfg.host = optarg;
+            break;
+        case 'p':
+            cfg.port = atoi(optarg);
+            break;
+        case 'c':
+            cfg.cacert = optarg;
+            break;
+        case 'n':
+            cfg.sessions = atoi(optarg);
+            break;
+        case 'w':
+            cfg.threads = atoi(optarg);
+            break;
+        case 't':
+            cfg.transfers = atoi(optarg);
+            break;
+        case 'P':
+            cfg.pipeline_depth = atoi(optarg);
+            break;
+        case 'k':
+            cfg.chunk_kbytes = atoi(optarg);
+            break;
+        case '2':
+            cfg.http2 = 1;
+            break;
+        case 'z':
+            cfg.compress = 1;
+            break;
+        case 'v':
+            cfg.verbose = 1;
+            break;
+        default:
+            load_usage(argv[0]);
+            return 1;
+        }
+    }
+    if (cfg.sessions < 1 || cfg.threads < 1 || cfg.port < 1 || cfg.port > 65535) {
+        load_usage(argv[0]);
+        return 1;
+    }
+    load_verbose = cfg.verbose;
+
+    /* amvp_run() saves every session's info, keep them out of the way */
+    if (!mkdtemp(save_dir)) {
+        fprintf(stderr, "Unable to create a directory for the session files\n");
+        return 1;
+    }
+    setenv("ACV_SESSION_SAVE_PATH", save_dir, 1);
+    /* Before any thread starts, as it isn't safe once several do */
+    curl_global_init(CURL_GLOBAL_DEFAULT);
+    pthread_mutex_init(&queue.lock, NULL);
+
+    queue.ctxs = calloc(cfg.sessions, sizeof(AMVP_CTX *));
+    queue.results = calloc(cfg.sessions, sizeof(AMVP_RESULT));
+    tids = calloc(cfg.threads, sizeof(pthread_t));
+    if (!queue.ctxs || !queue.results || !tids) goto end;
+    for (i = 0; i < cfg.sessions; i++) {
+        rv = load_setup_ctx(&cfg, &queue.ctxs[i]);
+        if (rv != AMVP_SUCCESS) {
+            fprintf(stderr, "Unable to set up session %d: %s\n", i + 1, amvp_lookup_error_string(rv));
+            goto end;
+        }
+    }
+    queue.count = cfg.sessions;
+
+    start = load_now();
+    for (started = 0; started < cfg.threads; started++) {
+        if (pthread_create(&tids[started], NULL, load_worker, &queue)) break;
+    }
+    if (!started) {
+        fprintf(stderr, "Unable to start the session threads\n");
+        goto end;
+    }
+    for (i = 0; i < started; i++) {
+        pthread_join(tids[i], NULL);
+    }
+    secs = load_now() - start;
+
+    for (i = 0; i < cfg.sessions; i++) {
+        if (queue.results[i] != AMVP_SUCCESS) {
+            fprintf(stderr, "Session %d failed: %s\n", i + 1, amvp_lookup_error_string(queue.results[i]));
+            totals.failed++;
+        }
+        load_add_metrics(queue.ctxs[i], &totals);
+    }
+
+    printf("%d sessions (%d failed) on %d threads, %d transfers, pipeline depth %d%s\n",
+           cfg.sessions, totals.failed, started, cfg.transfers, cfg.pipeline_depth,
+           cfg.http2 ? ", HTTP/2" : "");
+    printf("  %.3f s, %.1f sessions/s, %.1f vector sets/s, %d test cases\n", secs,
+           cfg.sessions / secs, totals.vector_sets / secs, totals.test_cases);
+    printf("  %d requests, %d new connections, %d retries, %.2f MB up, %.2f MB down\n",
+           totals.requests, totals.connections, totals.retries,
+           totals.bytes_up / (1024.0 * 1024), totals.bytes_down / (1024.0 * 1024));
+    ret = totals.failed ? 1 : 0;
+
+end:
+    if (queue.ctxs) {
+        for (i = 0; i < cfg.sessions; i++) {
+            if (queue.ctxs[i]) amvp_free_test_session(queue.ctxs[i]);
+        }
+    }
+    free(queue.ctxs);
+    free(queue.results);
+    free(tids);
+    pthread_mutex_destroy(&queue.lock);
+    load_remove_dir(save_dir);
+    amvp_cleanup(NULL);
+    return ret;
+}
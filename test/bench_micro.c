@@ -0,0 +1,363 @@
+/** @file */
+/*
+ * Copyright (c) 2021, Cisco Systems, Inc.
+ *
+ * Licensed under the Apache License 2.0 (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://github.com/cisco/libamvp/LICENSE
+ */
+
+/*
+ * Microbenchmarks for the primitives that dominate the KAT handler profile,
+ * built with "make bench" next to katbench.
+ *
+ * Each benchmark is calibrated to a batch size that takes about
+ * MICRO_BATCH_US, warmed up, then timed over a number of batches. The
+ * time per operation is reported as min/p50/p90/p99/mean, as a table or
+ * with -j as one JSON object per line.
+ *
+ * usage: microbench [-d json_dir] [-n samples] [-j] [filter]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "amvp/amvp.h"
+#include "amvp/amvp_lcl.h"
+#include "amvp/parson.h"
+
+#define MICRO_DEFAULT_SAMPLES 200
+#define MICRO_BATCH_US 500
+#define MICRO_HEX_MAX 65536
+#define MICRO_PATH_MAX 256
+
+typedef struct micro_bench_t {
+    char name[64];
+    void (*run)(void *arg, long n);
+    void *arg;
+} MICRO_BENCH;
+
+typedef struct micro_json_arg_t {
+    char *str;
+    JSON_Value *val;
+} MICRO_JSON_ARG;
+
+typedef struct micro_hex_arg_t {
+    int len;
+    unsigned char *bin;
+    char *hex;
+} MICRO_HEX_ARG;
+
+/* Keeps the compiler from dropping results */
+static volatile unsigned long micro_sink = 0;
+
+static AMVP_CTX *micro_ctx = NULL;
+
+static double micro_now_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static void micro_json_parse(void *arg, long n) {
+    MICRO_JSON_ARG *a = arg;
+    JSON_Value *val = NULL;
+    long i;
+
+    for (i = 0; i < n; i++) {
+        val = json_parse_string(a->str);
+        micro_sink += json_value_get_type(val);
+        json_value_free(val);
+    }
+}
+
+static void micro_json_serialize(void *arg, long n) {
+    MICRO_JSON_ARG *a = arg;
+    char *str = NULL;
+    long i;
+
+    for (i = 0; i < n; i++) {
+        str = json_serialize_to_string(a->val, NULL);
+        micro_sink += str[0];
+        json_free_serialized_string(str);
+    }
+}
+
+static void micro_json_serialize_pretty(void *arg, long n) {
+    MICRO_JSON_ARG *a = arg;
+    char *str = NULL;
+    long i;
+
+    for (i = 0; i < n; i++) {
+        str = json_serialize_to_string_pretty(a->val, NULL);
+        micro_sink += str[0];
+        json_free_serialized_string(str);
+    }
+}
+
+static void micro_hex_to_bin(void *arg, long n) {
+    MICRO_HEX_ARG *a = arg;
+    int len = 0;
+    long i;
+
+    for (i = 0; i < n; i++) {
+        amvp_hexstr_to_bin(a->hex, a->bin, a->len, &len);
+        micro_sink += len;
+    }
+}
+
+static void micro_bin_to_hex(void *arg, long n) {
+    MICRO_HEX_ARG *a = arg;
+    long i;
+
+    for (i = 0; i < n; i++) {
+        amvp_bin_to_hexstr(a->bin, a->len, a->hex, a->len * 2);
+        micro_sink += a->hex[0];
+    }
+}
+
+static const char *micro_alg_names[] = {
+    AMVP_ALG_SHA1, AMVP_ALG_SHA256, AMVP_ALG_SHA3_512, AMVP_ALG_HMAC_SHA2_256,
+    AMVP_ALG_CMAC_AES, AMVP_ALG_AES_GCM, AMVP_ALG_AES_CBC, AMVP_ALG_TDES_ECB,
+    AMVP_ALG_KAS_ECC_SSC, AMVP_ALG_KDA_ALG_STR, "no-such-algorithm"
+};
+#define MICRO_ALG_CNT (int)(sizeof(micro_alg_names) / sizeof(char *))
+
+static void micro_lookup_cipher(void *arg, long n) {
+    long i;
+
+    (void)arg;
+    for (i = 0; i < n; i++) {
+        micro_sink += amvp_lookup_cipher_index(micro_alg_names[i % MICRO_ALG_CNT]);
+    }
+}
+
+static const AMVP_CIPHER micro_caps[] = {
+    AMVP_HASH_SHA1, AMVP_HASH_SHA256, AMVP_HASH_SHA512, AMVP_HMAC_SHA2_256,
+    AMVP_CMAC_AES, AMVP_AES_CBC, AMVP_AES_GCM, AMVP_RSA_SIGGEN
+};
+#define MICRO_CAP_CNT (int)(sizeof(micro_caps) / sizeof(AMVP_CIPHER))
+
+static void micro_locate_cap(void *arg, long n) {
+    long i;
+
+    (void)arg;
+    for (i = 0; i < n; i++) {
+        micro_sink += (unsigned long)amvp_locate_cap_entry(micro_ctx, micro_caps[i % MICRO_CAP_CNT]) & 1;
+    }
+}
+
+static int micro_dummy_handler(AMVP_TEST_CASE *test_case) {
+    (void)test_case;
+    return 0;
+}
+
+/*
+ * A context with a handful of capabilities, only half of which are the
+ * ones looked up, so both hits and misses are measured.
+ */
+static int micro_setup_ctx(void) {
+    if (amvp_create_test_session(&micro_ctx, NULL, AMVP_LOG_LVL_NONE) != AMVP_SUCCESS) {
+        return 1;
+    }
+    if (amvp_cap_hash_enable(micro_ctx, AMVP_HASH_SHA256, &micro_dummy_handler) ||
+        amvp_cap_hash_enable(micro_ctx, AMVP_HASH_SHA384, &micro_dummy_handler) ||
+        amvp_cap_hmac_enable(micro_ctx, AMVP_HMAC_SHA2_256, &micro_dummy_handler) ||
+        amvp_cap_cmac_enable(micro_ctx, AMVP_CMAC_AES, &micro_dummy_handler) ||
+        amvp_cap_sym_cipher_enable(micro_ctx, AMVP_AES_ECB, &micro_dummy_handler) ||
+        amvp_cap_sym_cipher_enable(micro_ctx, AMVP_AES_CBC, &micro_dummy_handler)) {
+        return 1;
+    }
+    return 0;
+}
+
+static char *micro_read_file(const char *path) {
+    FILE *fp = fopen(path, "rb");
+    char *buf = NULL;
+    long len;
+
+    if (!fp) return NULL;
+    fseek(fp, 0, SEEK_END);
+    len = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    buf = calloc(len + 1, 1);
+    if (buf && fread(buf, 1, len, fp) != (size_t)len) {
+        free(buf);
+        buf = NULL;
+    }
+    fclose(fp);
+    return buf;
+}
+
+static int micro_cmp(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+/*
+ * Calibrates and times bench, filling ns[] with the time per operation
+ * of each sample. Returns the batch size used.
+ */
+static long micro_measure(MICRO_BENCH *bench, int samples, double *ns) {
+    double start, elapsed;
+    long batch = 1;
+    int i;
+
+    /* Grow the batch until it takes long enough to time reliably */
+    while (1) {
+        start = micro_now_ns();
+        bench->run(bench->arg, batch);
+        elapsed = micro_now_ns() - start;
+        if (elapsed >= MICRO_BATCH_US * 1000.0 || batch >= (1L << 30)) break;
+        batch *= 2;
+    }
+
+    /* Warm up caches and the allocator before the timed samples */
+    for (i = 0; i < samples / 10 + 1; i++) {
+        bench->run(bench->arg, batch);
+    }
+
+    for (i = 0; i < samples; i++) {
+        start = micro_now_ns();
+        bench->run(bench->arg, batch);
+        ns[i] = (micro_now_ns() - start) / batch;
+    }
+    return batch;
+}
+
+static void micro_report(MICRO_BENCH *bench, int samples, double *ns, long batch, int json) {
+    double mean = 0;
+    int i;
+
+    for (i = 0; i < samples; i++) {
+        mean += ns[i];
+    }
+    mean /= samples;
+    qsort(ns, samples, sizeof(double), micro_cmp);
+
+    if (json) {
+        printf("{\"name\": \"%s\", \"batch\": %ld, \"samples\": %d, \"minNs\": %.1f, \"p50Ns\": %.1f, "
+               "\"p90Ns\": %.1f, \"p99Ns\": %.1f, \"meanNs\": %.1f}\n",
+               bench->name, batch, samples, ns[0], ns[samples / 2], ns[samples * 90 / 100],
+               ns[samples * 99 / 100], mean);
+    } else {
+        printf("%-34s %10.1f %10.1f %10.1f %10.1f %10.1f\n", bench->name, ns[0], ns[samples / 2],
+               ns[samples * 90 / 100], ns[samples * 99 / 100], mean);
+    }
+}
+
+int main(int argc, char **argv) {
+    static const char *json_files[] = { "aes/aes.json", "req.json" };
+    static const int hex_lens[] = { 16, 64, 256, 4096, MICRO_HEX_MAX };
+    MICRO_JSON_ARG json_args[sizeof(json_files) / sizeof(char *)];
+    MICRO_HEX_ARG hex_args[sizeof(hex_lens) / sizeof(int)];
+    MICRO_BENCH benches[32];
+    const char *json_dir = "json", *filter = NULL;
+    char path[MICRO_PATH_MAX];
+    double *ns = NULL;
+    int samples = MICRO_DEFAULT_SAMPLES, json = 0;
+    int opt, i, j, cnt = 0, ret = 1;
+    long batch;
+
+    while ((opt = getopt(argc, argv, "d:n:jh")) != -1) {
+        switch (opt) {
+        case 'd':
+            json_dir = optarg;
+            break;
+        case 'n':
+            samples = atoi(optarg);
+            break;
+        case 'j':
+            json = 1;
+            break;
+        default:
+            printf("usage: %s [-d json_dir] [-n samples] [-j] [filter]\n", argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (optind < argc) {
+        filter = argv[optind];
+    }
+    if (samples < 10) {
+        samples = 10;
+    }
+    memset(json_args, 0, sizeof(json_args));
+    memset(hex_args, 0, sizeof(hex_args));
+
+    for (i = 0; i < (int)(sizeof(json_files) / sizeof(char *)); i++) {
+        snprintf(path, sizeof(path), "%s/%s", json_dir, json_files[i]);
+        json_args[i].str = micro_read_file(path);
+        json_args[i].val = json_args[i].str ? json_parse_string(json_args[i].str) : NULL;
+        if (!json_args[i].val) {
+            fprintf(stderr, "Unable to read %s\n", path);
+            goto end;
+        }
+        snprintf(benches[cnt].name, sizeof(benches[cnt].name), "json_parse_string/%s", json_files[i]);
+        benches[cnt].run = &micro_json_parse;
+        benches[cnt++].arg = &json_args[i];
+        snprintf(benches[cnt].name, sizeof(benches[cnt].name), "json_serialize/%s", json_files[i]);
+        benches[cnt].run = &micro_json_serialize;
+        benches[cnt++].arg = &json_args[i];
+        snprintf(benches[cnt].name, sizeof(benches[cnt].name), "json_serialize_pretty/%s", json_files[i]);
+        benches[cnt].run = &micro_json_serialize_pretty;
+        benches[cnt++].arg = &json_args[i];
+    }
+
+    for (i = 0; i < (int)(sizeof(hex_lens) / sizeof(int)); i++) {
+        hex_args[i].len = hex_lens[i];
+        hex_args[i].bin = calloc(hex_lens[i], 1);
+        hex_args[i].hex = calloc(hex_lens[i] * 2 + 1, 1);
+        if (!hex_args[i].bin || !hex_args[i].hex) goto end;
+        for (j = 0; j < hex_lens[i]; j++) {
+            hex_args[i].bin[j] = (unsigned char)(j * 131 + 7);
+        }
+        amvp_bin_to_hexstr(hex_args[i].bin, hex_lens[i], hex_args[i].hex, hex_lens[i] * 2);
+        snprintf(benches[cnt].name, sizeof(benches[cnt].name), "amvp_hexstr_to_bin/%d", hex_lens[i]);
+        benches[cnt].run = &micro_hex_to_bin;
+        benches[cnt++].arg = &hex_args[i];
+        snprintf(benches[cnt].name, sizeof(benches[cnt].name), "amvp_bin_to_hexstr/%d", hex_lens[i]);
+        benches[cnt].run = &micro_bin_to_hex;
+        benches[cnt++].arg = &hex_args[i];
+    }
+
+    if (micro_setup_ctx()) {
+        fprintf(stderr, "Unable to set up a context\n");
+        goto end;
+    }
+    snprintf(benches[cnt].name, sizeof(benches[cnt].name), "amvp_lookup_cipher_index");
+    benches[cnt].run = &micro_lookup_cipher;
+    benches[cnt++].arg = NULL;
+    snprintf(benches[cnt].name, sizeof(benches[cnt].name), "amvp_locate_cap_entry");
+    benches[cnt].run = &micro_locate_cap;
+    benches[cnt++].arg = NULL;
+
+    ns = calloc(samples, sizeof(double));
+    if (!ns) goto end;
+    if (!json) {
+        printf("%-34s %10s %10s %10s %10s %10s\n", "ns/op", "min", "p50", "p90", "p99", "mean");
+    }
+    for (i = 0; i < cnt; i++) {
+        if (filter && !strstr(benches[i].name, filter)) continue;
+        batch = micro_measure(&benches[i], samples, ns);
+        micro_report(&benches[i], samples, ns, batch, json);
+    }
+    ret = 0;
+
+end:
+    for (i = 0; i < (int)(sizeof(json_files) / sizeof(char *)); i++) {
+        free(json_args[i].str);
+        json_value_free(json_args[i].val);
+    }
+    for (i = 0; i < (int)(sizeof(hex_lens) / sizeof(int)); i++) {
+        free(hex_args[i].bin);
+        free(hex_args[i].hex);
+    }
+    free(ns);
+    if (micro_ctx) amvp_free_test_session(micro_ctx);
+    return ret;
+}
@@ -0,0 +1,703 @@
+/** @file */
+/*
+ * Copyright (c) 2021, Cisco Systems, Inc.
+ *
+ * Licensed under the Apache License 2.0 (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://github.com/cisco/libamvp/LICENSE
+ */
+
+/*
+ * Loopback mock of the AMVP server, built with "make loadtest" and driven
+ * by loadbench (bench_load.c).
+ *
+ * It listens on 127.0.0.1 with a self-signed certificate made at start up,
+ * written to the -c file once the socket is listening, for the client to
+ * pass to amvp_set_cacerts(). It speaks enough of the protocol for
+ * amvp_run(): login, test session registration, vector set downloads,
+ * response uploads (whole, streamed, or in resumable chunks) and the
+ * session results. The vector sets are the ones in the fixture files
+ * given, vector set n of a session being fixture n modulo their count, so
+ * the client has to enable the algorithms they are for.
+ *
+ * -r makes each vector set answer its first downloads with a retry, and
+ * -l delays every answer, to stand in for a server generating vectors and
+ * a distant one. Connections are kept alive and served by a thread each.
+ * Totals are printed on SIGINT or SIGTERM.
+ *
+ * usage: mockserver [-p port] [-c cert_file] [-n vector_sets] [-l latency_ms]
+ *                   [-r retries] [-R retry_secs] [fixture...]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <openssl/ssl.h>
+#include <openssl/err.h>
+#include <openssl/pem.h>
+#include <openssl/x509v3.h>
+#include "amvp/parson.h"
+
+#define MOCK_DEFAULT_PORT 18443
+#define MOCK_DEFAULT_CERT "mockserver.pem"
+#define MOCK_DEFAULT_VS 4
+/* libamvp treats a retry of AMVP_RETRY_TIME_MIN seconds or less as missing */
+#define MOCK_DEFAULT_RETRY_SECS 6
+#define MOCK_BUF_SIZE (16 * 1024)
+#define MOCK_PATH_MAX 512
+#define MOCK_VS_MAX 4096
+#define MOCK_SESSION_URL "/amvp/v1/testSessions/"
+
+typedef struct mock_cfg_t {
+    int port;
+    const char *cert_file;
+    int vs_count;           /* vector sets per test session */
+    int latency_ms;         /* added before every answer */
+    int retries;            /* retry answers before each vector set is served */
+    int retry_secs;
+} MOCK_CFG;
+
+typedef struct mock_session_t {
+    int *polls;             /* downloads of each vector set so far */
+    int *uploaded;
+    size_t *held;           /* bytes of a chunked upload received so far */
+} MOCK_SESSION;
+
+typedef struct mock_stats_t {
+    unsigned long conns;
+    unsigned long reqs;
+    unsigned long sessions;
+    unsigned long downloads;
+    unsigned long retries;
+    unsigned long uploads;
+    unsigned long long bytes_in;
+    unsigned long long bytes_out;
+} MOCK_STATS;
+
+/* Buffered reading of one connection */
+typedef struct mock_conn_t {
+    SSL *ssl;
+    int fd;
+    char buf[MOCK_BUF_SIZE];
+    size_t len;
+    size_t pos;
+} MOCK_CONN;
+
+typedef struct mock_req_t {
+    char method[8];
+    char path[MOCK_PATH_MAX];
+    long long content_len;
+    int chunked;
+    int expect_continue;
+    int close;
+    int has_range;
+    unsigned long long range_first;
+    unsigned long long range_last;
+    unsigned long long range_total;     /* range_first > range_last for "*" */
+} MOCK_REQ;
+
+static MOCK_CFG mock_cfg;
+static SSL_CTX *mock_ssl_ctx = NULL;
+static char **mock_fixtures = NULL;     /* "[ <vector set> ]" to serve */
+static int mock_fixture_cnt = 0;
+static MOCK_SESSION *mock_sessions = NULL;
+static int mock_session_cnt = 0;
+static MOCK_STATS mock_stats;
+static pthread_mutex_t mock_lock = PTHREAD_MUTEX_INITIALIZER;
+static volatile sig_atomic_t mock_stop = 0;
+
+static void mock_on_signal(int sig) {
+    (void)sig;
+    mock_stop = 1;
+}
+
+static void mock_count(unsigned long *counter, unsigned long long bytes_in) {
+    pthread_mutex_lock(&mock_lock);
+    if (counter) (*counter)++;
+    mock_stats.bytes_in += bytes_in;
+    pthread_mutex_unlock(&mock_lock);
+}
+
+/*
+ * Loads the vector sets of a fixture file: every object with "testGroups"
+ * in its top level array, as in the files saved by --vector_req and the
+ * ones under json/.
+ */
+static int mock_load_fixture(const char *file) {
+    JSON_Value *val = json_parse_file(file);
+    JSON_Array *arr = json_value_get_array(val);
+    size_t i, cnt = json_array_get_count(arr);
+    int loaded = 0;
+
+    for (i = 0; i < cnt; i++) {
+        JSON_Value *vs = json_array_get_value(arr, i);
+        JSON_Value *wrap = NULL;
+        char **fixtures = NULL;
+        char *body = NULL;
+
+        if (!json_object_has_value(json_value_get_object(vs), "testGroups")) continue;
+        wrap = json_value_init_array();
+        json_array_append_value(json_value_get_array(wrap), json_value_deep_copy(vs));
+        body = json_serialize_to_string(wrap, NULL);
+        json_value_free(wrap);
+        fixtures = realloc(mock_fixtures, (mock_fixture_cnt + 1) * sizeof(char *));
+        if (!body || !fixtures) {
+            json_free_serialized_string(body);
+            json_value_free(val);
+            return -1;
+        }
+        mock_fixtures = fixtures;
+        mock_fixtures[mock_fixture_cnt++] = body;
+        loaded++;
+    }
+    json_value_free(val);
+    if (!loaded) {
+        fprintf(stderr, "No vector sets in %s\n", file);
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * A self-signed P-256 certificate for localhost and 127.0.0.1. It is
+ * written to cert_file under a temporary name and renamed, so whoever waits
+ * for the file never reads half of it.
+ */
+static int mock_make_cert(const char *cert_file) {
+    EVP_PKEY_CTX *pctx = NULL;
+    EVP_PKEY *pkey = NULL;
+    X509 *x509 = NULL;
+    X509_NAME *name = NULL;
+    X509_EXTENSION *ext = NULL;
+    X509V3_CTX v3;
+    char tmp[MOCK_PATH_MAX];
+    FILE *fp = NULL;
+    int ret = -1;
+
+    pctx = EVP_PKEY_CTX_new_id(EVP_PKEY_EC, NULL);
+    if (!pctx || EVP_PKEY_keygen_init(pctx) <= 0 ||
+        EVP_PKEY_CTX_set_ec_paramgen_curve_nid(pctx, NID_X9_62_prime256v1) <= 0 ||
+        EVP_PKEY_keygen(pctx, &pkey) <= 0) {
+        goto end;
+    }
+    x509 = X509_new();
+    if (!x509) goto end;
+    X509_set_version(x509, 2);
+    ASN1_INTEGER_set(X509_get_serialNumber(x509), 1);
+    X509_gmtime_adj(X509_getm_notBefore(x509), -3600);
+    X509_gmtime_adj(X509_getm_notAfter(x509), 30L * 24 * 3600);
+    X509_set_pubkey(x509, pkey);
+    name = X509_get_subject_name(x509);
+    X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, (const unsigned char *)"localhost", -1, -1, 0);
+    X509_set_issuer_name(x509, name);
+    X509V3_set_ctx(&v3, x509, x509, NULL, NULL, 0);
+    ext = X509V3_EXT_conf_nid(NULL, &v3, NID_subject_alt_name, "DNS:localhost,IP:127.0.0.1");
+    if (!ext || !X509_add_ext(x509, ext, -1)) goto end;
+    X509_EXTENSION_free(ext);
+    ext = X509V3_EXT_conf_nid(NULL, &v3, NID_basic_constraints, "critical,CA:TRUE");
+    if (!ext || !X509_add_ext(x509, ext, -1)) goto end;
+    if (!X509_sign(x509, pkey, EVP_sha256())) goto end;
+
+    if (SSL_CTX_use_certificate(mock_ssl_ctx, x509) != 1 ||
+        SSL_CTX_use_PrivateKey(mock_ssl_ctx, pkey) != 1) {
+        goto end;
+    }
+    snprintf(tmp, sizeof(tmp), "%s.tmp", cert_file);
+    fp = fopen(tmp, "w");
+    if (!fp) goto end;
+    if (!PEM_write_X509(fp, x509)) {
+        fclose(fp);
+        goto end;
+    }
+    if (fclose(fp) || rename(tmp, cert_file)) goto end;
+    ret = 0;
+
+end:
+    if (ext) X509_EXTENSION_free(ext);
+    X509_free(x509);
+    EVP_PKEY_free(pkey);
+    EVP_PKEY_CTX_free(pctx);
+    return ret;
+}
+
+/* Returns 0 at the end of the connection */
+static int mock_fill(MOCK_CONN *c) {
+    int n;
+
+    if (c->pos == c->len) {
+        c->pos = c->len = 0;
+    } else if (c->pos) {
+        memmove(c->buf, c->buf + c->pos, c->len - c->pos);
+        c->len -= c->pos;
+        c->pos = 0;
+    }
+    if (c->len == sizeof(c->buf)) {
+        return 0;
+    }
+    n = SSL_read(c->ssl, c->buf + c->len, (int)(sizeof(c->buf) - c->len));
+    if (n <= 0) {
+        return 0;
+    }
+    c->len += (size_t)n;
+    return n;
+}
+
+/* The next line without its CRLF, or NULL at the end of the connection */
+static char *mock_read_line(MOCK_CONN *c) {
+    char *eol = NULL, *line = NULL;
+
+    while (!(eol = memchr(c->buf + c->pos, '\n', c->len - c->pos))) {
+        if (!mock_fill(c)) return NULL;
+    }
+    line = c->buf + c->pos;
+    c->pos = (size_t)(eol - c->buf) + 1;
+    *eol = '\0';
+    if (eol > line && eol[-1] == '\r') eol[-1] = '\0';
+    return line;
+}
+
+static int mock_skip(MOCK_CONN *c, unsigned long long n) {
+    while (n) {
+        size_t avail = c->len - c->pos;
+
+        if (!avail) {
+            if (!mock_fill(c)) return -1;
+            continue;
+        }
+        if (avail > n) avail = (size_t)n;
+        c->pos += avail;
+        n -= avail;
+    }
+    return 0;
+}
+
+static int mock_write(MOCK_CONN *c, const char *data, size_t len) {
+    while (len) {
+        int n = SSL_write(c->ssl, data, len > 65536 ? 65536 : (int)len);
+
+        if (n <= 0) return -1;
+        data += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+static int mock_read_request(MOCK_CONN *c, MOCK_REQ *req) {
+    char *line = NULL;
+
+    memset(req, 0, sizeof(MOCK_REQ));
+    req->content_len = -1;
+    do {
+        line = mock_read_line(c);
+        if (!line) return -1;
+    } while (!*line);
+    if (sscanf(line, "%7s %511s", req->method, req->path) != 2) {
+        return -1;
+    }
+    if (strstr(line, "HTTP/1.0")) req->close = 1;
+
+    while ((line = mock_read_line(c)) && *line) {
+        if (!strncasecmp(line, "Content-Length:", 15)) {
+            req->content_len = atoll(line + 15);
+        } else if (!strncasecmp(line, "Transfer-Encoding:", 18) && strstr(line, "chunked")) {
+            req->chunked = 1;
+        } else if (!strncasecmp(line, "Expect:", 7) && strstr(line, "100-continue")) {
+            req->expect_continue = 1;
+        } else if (!strncasecmp(line, "Connection:", 11) && strstr(line, "close")) {
+            req->close = 1;
+        } else if (!strncasecmp(line, "Content-Range:", 14)) {
+            req->has_range = 1;
+            if (sscanf(line + 14, " bytes %llu-%llu/%llu", &req->range_first, &req->range_last,
+                       &req->range_total) != 3) {
+                req->range_first = 1;
+                req->range_last = 0;
+                sscanf(line + 14, " bytes */%llu", &req->range_total);
+            }
+        }
+    }
+    return line ? 0 : -1;
+}
+
+/* Reads and drops the body, returning its size or -1 */
+static long long mock_read_body(MOCK_CONN *c, const MOCK_REQ *req) {
+    long long total = 0;
+    char *line = NULL;
+
+    if (req->expect_continue && mock_write(c, "HTTP/1.1 100 Continue\r\n\r\n", 25)) {
+        return -1;
+    }
+    if (!req->chunked) {
+        if (req->content_len > 0 && mock_skip(c, (unsigned long long)req->content_len)) {
+            return -1;
+        }
+        return req->content_len > 0 ? req->content_len : 0;
+    }
+    while ((line = mock_read_line(c))) {
+        unsigned long long size = strtoull(line, NULL, 16);
+
+        if (!size) {
+            /* Trailers, up to the empty line */
+            while ((line = mock_read_line(c)) && *line) ;
+            return line ? total : -1;
+        }
+        if (mock_skip(c, size + 2)) return -1;
+        total += (long long)size;
+    }
+    return -1;
+}
+
+static int mock_respond(MOCK_CONN *c, int status, const char *reason, const char *extra,
+                        const char *body) {
+    char head[512];
+    size_t len = body ? strlen(body) : 0;
+    int n;
+
+    if (mock_cfg.latency_ms) {
+        usleep((useconds_t)mock_cfg.latency_ms * 1000);
+    }
+    n = snprintf(head, sizeof(head), "HTTP/1.1 %d %s\r\nContent-Type: application/json\r\n"
+                 "Content-Length: %zu\r\n%s\r\n", status, reason, len, extra ? extra : "");
+    pthread_mutex_lock(&mock_lock);
+    mock_stats.bytes_out += (unsigned long long)n + len;
+    pthread_mutex_unlock(&mock_lock);
+    if (mock_write(c, head, (size_t)n)) return -1;
+    return len ? mock_write(c, body, len) : 0;
+}
+
+/* Starts a test session, returning its id (1 based) or 0 */
+static int mock_new_session(void) {
+    MOCK_SESSION *sessions = NULL, *s = NULL;
+    int id = 0;
+
+    pthread_mutex_lock(&mock_lock);
+    sessions = realloc(mock_sessions, (mock_session_cnt + 1) * sizeof(MOCK_SESSION));
+    if (sessions) {
+        mock_sessions = sessions;
+        s = &mock_sessions[mock_session_cnt];
+        s->polls = calloc(mock_cfg.vs_count, sizeof(int));
+        s->uploaded = calloc(mock_cfg.vs_count, sizeof(int));
+        s->held = calloc(mock_cfg.vs_count, sizeof(size_t));
+        if (s->polls && s->uploaded && s->held) {
+            id = ++mock_session_cnt;
+            mock_stats.sessions++;
+        } else {
+            free(s->polls);
+            free(s->uploaded);
+            free(s->held);
+        }
+    }
+    pthread_mutex_unlock(&mock_lock);
+    return id;
+}
+
+/* The session and vector set of a path, 0 based; -1 if they don't exist */
+static int mock_lookup(int ts, int vs, MOCK_SESSION **s) {
+    if (ts < 1 || ts > mock_session_cnt || vs < 1 || vs > mock_cfg.vs_count) {
+        return -1;
+    }
+    *s = &mock_sessions[ts - 1];
+    return vs - 1;
+}
+
+static int mock_register(MOCK_CONN *c) {
+    char *body = NULL, *p = NULL;
+    size_t size = 256 + (size_t)mock_cfg.vs_count * 64;
+    int ts = mock_new_session(), vs, ret;
+
+    if (!ts) {
+        return mock_respond(c, 500, "Internal Server Error", NULL, "[{\"error\":\"out of memory\"}]");
+    }
+    body = malloc(size);
+    if (!body) {
+        return mock_respond(c, 500, "Internal Server Error", NULL, "[{\"error\":\"out of memory\"}]");
+    }
+    p = body + snprintf(body, size, "[{\"url\":\"" MOCK_SESSION_URL "%d\",\"accessToken\":\"mock-session-%d\","
+                        "\"vectorSetUrls\":[", ts, ts);
+    for (vs = 1; vs <= mock_cfg.vs_count; vs++) {
+        p += snprintf(p, size - (size_t)(p - body), "%s\"" MOCK_SESSION_URL "%d/vectorSets/%d\"",
+                      vs > 1 ? "," : "", ts, vs);
+    }
+    snprintf(p, size - (size_t)(p - body), "]}]");
+    ret = mock_respond(c, 200, "OK", NULL, body);
+    free(body);
+    return ret;
+}
+
+static int mock_get_vs(MOCK_CONN *c, int ts, int vs) {
+    MOCK_SESSION *s = NULL;
+    char retry[64];
+    int i, polls;
+
+    pthread_mutex_lock(&mock_lock);
+    i = mock_lookup(ts, vs, &s);
+    polls = i < 0 ? 0 : s->polls[i]++;
+    if (i >= 0) {
+        if (polls < mock_cfg.retries) {
+            mock_stats.retries++;
+        } else {
+            mock_stats.downloads++;
+        }
+    }
+    pthread_mutex_unlock(&mock_lock);
+
+    if (i < 0) {
+        return mock_respond(c, 404, "Not Found", NULL, "[{\"error\":\"no such vector set\"}]");
+    }
+    if (polls < mock_cfg.retries) {
+        snprintf(retry, sizeof(retry), "[{\"retry\":%d}]", mock_cfg.retry_secs);
+        return mock_respond(c, 200, "OK", NULL, retry);
+    }
+    return mock_respond(c, 200, "OK", NULL, mock_fixtures[i % mock_fixture_cnt]);
+}
+
+/* Whole uploads, and each chunk of a resumable one */
+static int mock_post_results(MOCK_CONN *c, const MOCK_REQ *req, long long body_len, int ts, int vs) {
+    MOCK_SESSION *s = NULL;
+    char range[96];
+    size_t held = 0;
+    int i, done = 1;
+
+    pthread_mutex_lock(&mock_lock);
+    i = mock_lookup(ts, vs, &s);
+    if (i >= 0 && req->has_range) {
+        /* Take a chunk that starts where the last one ended, or the query */
+        if (req->range_first <= req->range_last && req->range_first == s->held[i] &&
+            (long long)(req->range_last - req->range_first + 1) == body_len) {
+            s->held[i] = (size_t)req->range_last + 1;
+        }
+        held = s->held[i];
+        done = held >= req->range_total;
+    }
+    if (i >= 0 && done) {
+        s->uploaded[i] = 1;
+        s->held[i] = 0;
+        mock_stats.uploads++;
+    }
+    pthread_mutex_unlock(&mock_lock);
+
+    if (i < 0) {
+        return mock_respond(c, 404, "Not Found", NULL, "[{\"error\":\"no such vector set\"}]");
+    }
+    if (!done) {
+        if (held) {
+            snprintf(range, sizeof(range), "Range: bytes=0-%llu\r\n", (unsigned long long)held - 1);
+        } else {
+            range[0] = '\0';
+        }
+        return mock_respond(c, 308, "Resume Incomplete", range, NULL);
+    }
+    return mock_respond(c, 200, "OK", NULL, "[{}]");
+}
+
+static int mock_get_results(MOCK_CONN *c, int ts) {
+    MOCK_SESSION *s = NULL;
+    char *body = NULL, *p = NULL;
+    size_t size = 256 + (size_t)mock_cfg.vs_count * 96;
+    int vs, passed = 1, ret;
+
+    body = malloc(size);
+    if (!body) {
+        return mock_respond(c, 500, "Internal Server Error", NULL, "[{\"error\":\"out of memory\"}]");
+    }
+    pthread_mutex_lock(&mock_lock);
+    if (mock_lookup(ts, 1, &s) < 0) {
+        pthread_mutex_unlock(&mock_lock);
+        free(body);
+        return mock_respond(c, 404, "Not Found", NULL, "[{\"error\":\"no such test session\"}]");
+    }
+    p = body + snprintf(body, size, "[{\"results\":[");
+    for (vs = 0; vs < mock_cfg.vs_count; vs++) {
+        if (!s->uploaded[vs]) passed = 0;
+        p += snprintf(p, size - (size_t)(p - body), "%s{\"vectorSetUrl\":\"" MOCK_SESSION_URL
+                      "%d/vectorSets/%d\",\"status\":\"%s\"}", vs ? "," : "", ts, vs + 1,
+                      s->uploaded[vs] ? "passed" : "unreceived");
+    }
+    pthread_mutex_unlock(&mock_lock);
+    snprintf(p, size - (size_t)(p - body), "],\"passed\":%s}]", passed ? "true" : "false");
+    ret = mock_respond(c, 200, "OK", NULL, body);
+    free(body);
+    return ret;
+}
+
+static int mock_route(MOCK_CONN *c, const MOCK_REQ *req, long long body_len) {
+    const char *path = req->path;
+    char *query = strchr(req->path, '?');
+    size_t len = 0;
+    int ts = 0, vs = 0, n = 0;
+
+    if (query) *query = '\0';
+    len = strlen(path);
+    if (!strcmp(req->method, "POST") && len >= 6 && !strcmp(path + len - 6, "/login")) {
+        return mock_respond(c, 200, "OK", NULL, "[{\"accessToken\":\"mock-login\"}]");
+    }
+    if (!strcmp(req->method, "POST") && len >= 13 && !strcmp(path + len - 13, "/testSessions")) {
+        return mock_register(c);
+    }
+    if (sscanf(path, MOCK_SESSION_URL "%d/vectorSets/%d/results%n", &ts, &vs, &n) == 2 && !path[n]) {
+        if (!strcmp(req->method, "GET")) {
+            return mock_respond(c, 200, "OK", NULL, "[{\"status\":\"passed\"}]");
+        }
+        return mock_post_results(c, req, body_len, ts, vs);
+    }
+    if (sscanf(path, MOCK_SESSION_URL "%d/vectorSets/%d%n", &ts, &vs, &n) == 2 && !path[n] &&
+        !strcmp(req->method, "GET")) {
+        return mock_get_vs(c, ts, vs);
+    }
+    if (sscanf(path, MOCK_SESSION_URL "%d/results%n", &ts, &n) == 1 && !path[n] &&
+        !strcmp(req->method, "GET")) {
+        return mock_get_results(c, ts);
+    }
+    return mock_respond(c, 404, "Not Found", NULL, "[{\"error\":\"not found\"}]");
+}
+
+static void *mock_serve(void *arg) {
+    MOCK_CONN *c = arg;
+    MOCK_REQ req;
+    long long body_len;
+
+    mock_count(&mock_stats.conns, 0);
+    if (SSL_accept(c->ssl) == 1) {
+        while (!mock_stop && !mock_read_request(c, &req)) {
+            body_len = mock_read_body(c, &req);
+            if (body_len < 0) break;
+            mock_count(&mock_stats.reqs, (unsigned long long)body_len);
+            if (mock_route(c, &req, body_len) || req.close) break;
+        }
+        SSL_shutdown(c->ssl);
+    }
+    SSL_free(c->ssl);
+    close(c->fd);
+    free(c);
+    return NULL;
+}
+
+static void mock_usage(const char *prog) {
+    printf("usage: %s [-p port] [-c cert_file] [-n vector_sets] [-l latency_ms] [-r retries]\n"
+           "       [-R retry_secs] [fixture...]\n", prog);
+}
+
+int main(int argc, char **argv) {
+    struct sockaddr_in addr;
+    struct sigaction sa;
+    pthread_attr_t attr;
+    pthread_t tid;
+    int opt, i, fd = -1, one = 1;
+
+    mock_cfg.port = MOCK_DEFAULT_PORT;
+    mock_cfg.cert_file = MOCK_DEFAULT_CERT;
+    mock_cfg.vs_count = MOCK_DEFAULT_VS;
+    mock_cfg.retry_secs = MOCK_DEFAULT_RETRY_SECS;
+    while ((opt = getopt(argc, argv, "p:c:n:l:r:R:h")) != -1) {
+        switch (opt) {
+        case 'p':
+            mock_cfg.port = atoi(optarg);
+            break;
+        case 'c':
+            mock_cfg.cert_file = optarg;
+            break;
+        case 'n':
+            mock_cfg.vs_count = atoi(optarg);
+            break;
+        case 'l':
+            mock_cfg.latency_ms = atoi(optarg);
+            break;
+        case 'r':
+            mock_cfg.retries = atoi(optarg);
+            break;
+        case 'R':
+            mock_cfg.retry_secs = atoi(optarg);
+            break;
+        default:
+            mock_usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (mock_cfg.port < 1 || mock_cfg.port > 65535 || mock_cfg.vs_count < 1 ||
+        mock_cfg.vs_count > MOCK_VS_MAX || mock_cfg.latency_ms < 0 || mock_cfg.retries < 0 ||
+        mock_cfg.retry_secs < 1) {
+        mock_usage(argv[0]);
+        return 1;
+    }
+    if (optind == argc) {
+        if (mock_load_fixture("json/aes/aes.json") || mock_load_fixture("json/req.json")) return 1;
+    }
+    for (i = optind; i < argc; i++) {
+        if (mock_load_fixture(argv[i])) return 1;
+    }
+
+    mock_ssl_ctx = SSL_CTX_new(TLS_server_method());
+    if (!mock_ssl_ctx) {
+        fprintf(stderr, "Unable to create the TLS context\n");
+        return 1;
+    }
+
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((unsigned short)mock_cfg.port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (fd < 0 || bind(fd, (struct sockaddr *)&addr, sizeof(addr)) || listen(fd, 128)) {
+        fprintf(stderr, "Unable to listen on 127.0.0.1:%d: %s\n", mock_cfg.port, strerror(errno));
+        return 1;
+    }
+    /* Listening now, so the certificate appearing means the server is up */
+    if (mock_make_cert(mock_cfg.cert_file)) {
+        fprintf(stderr, "Unable to make the certificate\n");
+        ERR_print_errors_fp(stderr);
+        return 1;
+    }
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = mock_on_signal;     /* no SA_RESTART, accept() has to return */
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    printf("mockserver on https://localhost:%d, %d vector sets a session from %d fixtures\n",
+           mock_cfg.port, mock_cfg.vs_count, mock_fixture_cnt);
+    fflush(stdout);
+
+    while (!mock_stop) {
+        MOCK_CONN *c = NULL;
+        int cfd = accept(fd, NULL, NULL);
+
+        if (cfd < 0) continue;
+        setsockopt(cfd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        c = calloc(1, sizeof(MOCK_CONN));
+        if (c) c->ssl = SSL_new(mock_ssl_ctx);
+        if (!c || !c->ssl) {
+            free(c);
+            close(cfd);
+            continue;
+        }
+        c->fd = cfd;
+        SSL_set_fd(c->ssl, cfd);
+        if (pthread_create(&tid, &attr, mock_serve, c)) {
+            SSL_free(c->ssl);
+            close(cfd);
+            free(c);
+        }
+    }
+    close(fd);
+    unlink(mock_cfg.cert_file);
+
+    pthread_mutex_lock(&mock_lock);
+    printf("mockserver: %lu connections, %lu requests, %lu sessions, %lu downloads, %lu retries, "
+           "%lu uploads, %.2f MB in, %.2f MB out\n", mock_stats.conns, mock_stats.reqs,
+           mock_stats.sessions, mock_stats.downloads, mock_stats.retries, mock_stats.uploads,
+           mock_stats.bytes_in / (1024.0 * 1024), mock_stats.bytes_out / (1024.0 * 1024));
+    pthread_mutex_unlock(&mock_lock);
+    return 0;
+}
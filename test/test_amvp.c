@@ -11,6 +11,11 @@
 
 #include "ut_common.h"
 #include "amvp/amvp_lcl.h"
+#ifndef _WIN32
+#include <pthread.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#endif
 
 AMVP_CTX *ctx;
 static char filename[] = "filename";
@@ -425,6 +430,588 @@ Test(SET_SESSION_PARAMS, mark_as_sample_null_ctx, .init = setup, .fini = teardow
     cr_assert(rv == AMVP_NO_CTX);
 }
 
+/*
+ * This test sets the number of concurrent vector set transfers
+ */
+Test(SET_SESSION_PARAMS, set_max_concurrent_transfers_good, .init = setup, .fini = teardown) {
+    rv = amvp_set_max_concurrent_transfers(ctx, 4);
+    cr_assert(rv == AMVP_SUCCESS);
+    rv = amvp_set_max_concurrent_transfers(ctx, 1);
+    cr_assert(rv == AMVP_SUCCESS);
+    rv = amvp_set_max_concurrent_transfers(ctx, AMVP_MAX_CONCURRENT_TRANSFERS);
+    cr_assert(rv == AMVP_SUCCESS);
+}
+
+/*
+ * This test sets the number of concurrent vector set transfers with bad params
+ */
+Test(SET_SESSION_PARAMS, set_max_concurrent_transfers_bad_params, .init = setup, .fini = teardown) {
+    rv = amvp_set_max_concurrent_transfers(NULL, 4);
+    cr_assert(rv == AMVP_NO_CTX);
+    rv = amvp_set_max_concurrent_transfers(ctx, 0);
+    cr_assert(rv == AMVP_INVALID_ARG);
+    rv = amvp_set_max_concurrent_transfers(ctx, AMVP_MAX_CONCURRENT_TRANSFERS + 1);
+    cr_assert(rv == AMVP_INVALID_ARG);
+}
+
+/*
+ * This test sets the order concurrently processed vector sets are started in
+ */
+Test(SET_SESSION_PARAMS, set_vs_schedule, .init = setup, .fini = teardown) {
+    rv = amvp_set_vs_schedule(NULL, AMVP_VS_SCHEDULE_COSTLIEST_FIRST);
+    cr_assert(rv == AMVP_NO_CTX);
+    rv = amvp_set_vs_schedule(ctx, (AMVP_VS_SCHEDULE)7);
+    cr_assert(rv == AMVP_INVALID_ARG);
+    rv = amvp_set_vs_schedule(ctx, AMVP_VS_SCHEDULE_COSTLIEST_FIRST);
+    cr_assert(rv == AMVP_SUCCESS);
+    cr_assert(ctx->vs_schedule == AMVP_VS_SCHEDULE_COSTLIEST_FIRST);
+    rv = amvp_set_vs_schedule(ctx, AMVP_VS_SCHEDULE_RECEIVED);
+    cr_assert(rv == AMVP_SUCCESS);
+}
+
+/*
+ * This test sets the number of worker threads, resizing the pool in between
+ */
+Test(SET_SESSION_PARAMS, set_worker_threads_good, .init = setup, .fini = teardown) {
+    rv = amvp_set_worker_threads(ctx, 4);
+    cr_assert(rv == AMVP_SUCCESS);
+    rv = amvp_set_worker_threads(ctx, 2);
+    cr_assert(rv == AMVP_SUCCESS);
+    rv = amvp_set_worker_threads(ctx, 1);
+    cr_assert(rv == AMVP_SUCCESS);
+    rv = amvp_set_worker_threads(ctx, AMVP_MAX_WORKER_THREADS);
+    cr_assert(rv == AMVP_SUCCESS);
+}
+
+/*
+ * This test sets the number of worker threads with bad params
+ */
+Test(SET_SESSION_PARAMS, set_worker_threads_bad_params, .init = setup, .fini = teardown) {
+    rv = amvp_set_worker_threads(NULL, 4);
+    cr_assert(rv == AMVP_NO_CTX);
+    rv = amvp_set_worker_threads(ctx, 0);
+    cr_assert(rv == AMVP_INVALID_ARG);
+    rv = amvp_set_worker_threads(ctx, AMVP_MAX_WORKER_THREADS + 1);
+    cr_assert(rv == AMVP_INVALID_ARG);
+}
+
+static int worker_cost_hash_handler(AMVP_TEST_CASE *test_case) {
+    AMVP_HASH_TC *tc = test_case->tc.hash;
+
+    memset(tc->md, tc->msg[0], 32);
+    tc->md_len = 32;
+    return 0;
+}
+
+/*
+ * This test runs test cases of very different cost on the worker threads
+ * and checks the largest first order they are scheduled in
+ */
+Test(SET_SESSION_PARAMS, worker_run_tcs_cost, .init = setup, .fini = teardown) {
+    AMVP_CAPS_LIST *cap = NULL;
+    AMVP_TEST_CASE tcs[16];
+    AMVP_HASH_TC stcs[16];
+    unsigned char msgs[16];
+    unsigned char mds[16][AMVP_HASH_MD_BYTE_MAX];
+    double costs[16];
+    int order[16];
+    int i;
+
+    cr_assert(amvp_rsa_keygen_cost(4096, AMVP_RSA_KEYGEN_B33, AMVP_RSA_TESTTYPE_AFT) >
+              amvp_rsa_keygen_cost(2048, AMVP_RSA_KEYGEN_B33, AMVP_RSA_TESTTYPE_AFT));
+    cr_assert(amvp_rsa_keygen_cost(2048, AMVP_RSA_KEYGEN_B33, AMVP_RSA_TESTTYPE_AFT) >
+              amvp_rsa_keygen_cost(4096, AMVP_RSA_KEYGEN_B33, AMVP_RSA_TESTTYPE_KAT));
+    cr_assert(amvp_dsa_pqggen_cost(3072, AMVP_DSA_PROBABLE) > amvp_dsa_pqggen_cost(3072, AMVP_DSA_CANONICAL));
+    cr_assert(amvp_safe_primes_cost(AMVP_SAFE_PRIMES_KEYGEN, AMVP_SAFE_PRIMES_FFDHE8192) >
+              amvp_safe_primes_cost(AMVP_SAFE_PRIMES_KEYGEN, AMVP_SAFE_PRIMES_MODP2048));
+
+    rv = amvp_cap_hash_enable(ctx, AMVP_HASH_SHA256, &worker_cost_hash_handler);
+    cr_assert(rv == AMVP_SUCCESS);
+    cap = amvp_locate_cap_entry(ctx, AMVP_HASH_SHA256);
+    cr_assert_not_null(cap);
+    rv = amvp_set_worker_threads(ctx, 4);
+    cr_assert(rv == AMVP_SUCCESS);
+
+    memset(stcs, 0, sizeof(stcs));
+    for (i = 0; i < 16; i++) {
+        msgs[i] = i + 1;
+        stcs[i].cipher = AMVP_HASH_SHA256;
+        stcs[i].test_type = AMVP_HASH_TEST_TYPE_AFT;
+        stcs[i].msg = &msgs[i];
+        stcs[i].msg_len = 1;
+        stcs[i].md = mds[i];
+        tcs[i].tc.hash = &stcs[i];
+        costs[i] = i % 4 == 0 ? 1000 : 1;
+    }
+
+    amvp_worker_order(costs, 16, order);
+    cr_assert(order[0] == 0 && order[1] == 4 && order[2] == 8 && order[3] == 12);
+    cr_assert(order[4] == 1 && order[15] == 15);
+
+    rv = amvp_worker_run_tcs_cost(ctx, cap, tcs, costs, 16);
+    cr_assert(rv == AMVP_SUCCESS);
+    for (i = 0; i < 16; i++) {
+        cr_assert(stcs[i].md_len == 32 && mds[i][0] == i + 1);
+    }
+    cr_assert(amvp_worker_steals(ctx) >= 0);
+}
+
+/*
+ * This test pins the worker threads to NUMA nodes and cores, and runs
+ * test cases on them
+ */
+Test(SET_SESSION_PARAMS, set_worker_affinity, .init = setup, .fini = teardown) {
+    AMVP_CAPS_LIST *cap = NULL;
+    AMVP_TEST_CASE tcs[16];
+    AMVP_HASH_TC stcs[16];
+    unsigned char msgs[16];
+    unsigned char mds[16][AMVP_HASH_MD_BYTE_MAX];
+    int i;
+
+    rv = amvp_set_worker_affinity(NULL, AMVP_WORKER_AFFINITY_NODE);
+    cr_assert(rv == AMVP_NO_CTX);
+    rv = amvp_set_worker_affinity(ctx, AMVP_WORKER_AFFINITY_CORE + 1);
+    cr_assert(rv == AMVP_INVALID_ARG);
+    rv = amvp_set_worker_affinity(ctx, AMVP_WORKER_AFFINITY_NODE);
+    cr_assert(rv == AMVP_SUCCESS);
+    rv = amvp_set_worker_threads(ctx, 4);
+    cr_assert(rv == AMVP_SUCCESS);
+    rv = amvp_set_worker_affinity(ctx, AMVP_WORKER_AFFINITY_CORE);
+    cr_assert(rv == AMVP_SUCCESS);
+    rv = amvp_set_worker_threads(ctx, 4);
+    cr_assert(rv == AMVP_SUCCESS);
+
+    rv = amvp_cap_hash_enable(ctx, AMVP_HASH_SHA256, &worker_cost_hash_handler);
+    cr_assert(rv == AMVP_SUCCESS);
+    cap = amvp_locate_cap_entry(ctx, AMVP_HASH_SHA256);
+    cr_assert_not_null(cap);
+    memset(stcs, 0, sizeof(stcs));
+    for (i = 0; i < 16; i++) {
+        msgs[i] = i + 1;
+        stcs[i].cipher = AMVP_HASH_SHA256;
+        stcs[i].test_type = AMVP_HASH_TEST_TYPE_AFT;
+        stcs[i].msg = &msgs[i];
+        stcs[i].msg_len = 1;
+        stcs[i].md = mds[i];
+        tcs[i].tc.hash = &stcs[i];
+    }
+    rv = amvp_worker_run_tcs(ctx, cap, tcs, 16);
+    cr_assert(rv == AMVP_SUCCESS);
+    for (i = 0; i < 16; i++) {
+        cr_assert(stcs[i].md_len == 32 && mds[i][0] == i + 1);
+    }
+
+    rv = amvp_set_worker_processes(ctx, 2);
+    cr_assert(rv == AMVP_SUCCESS);
+    rv = amvp_set_worker_processes(ctx, 0);
+    cr_assert(rv == AMVP_SUCCESS);
+    rv = amvp_set_worker_affinity(ctx, AMVP_WORKER_AFFINITY_NONE);
+    cr_assert(rv == AMVP_SUCCESS);
+}
+
+/*
+ * This test starts worker processes, replaces them, and stops them
+ */
+Test(SET_SESSION_PARAMS, set_worker_processes, .init = setup, .fini = teardown) {
+    rv = amvp_set_worker_processes(NULL, 2);
+    cr_assert(rv == AMVP_NO_CTX);
+    rv = amvp_set_worker_processes(ctx, -1);
+    cr_assert(rv == AMVP_INVALID_ARG);
+    rv = amvp_set_worker_processes(ctx, AMVP_MAX_WORKER_PROCESSES + 1);
+    cr_assert(rv == AMVP_INVALID_ARG);
+    rv = amvp_set_worker_processes(ctx, 2);
+    cr_assert(rv == AMVP_SUCCESS);
+    rv = amvp_set_worker_processes(ctx, 3);
+    cr_assert(rv == AMVP_SUCCESS);
+    rv = amvp_set_worker_processes(ctx, 0);
+    cr_assert(rv == AMVP_SUCCESS);
+}
+
+/*
+ * This test sets the pipeline depth
+ */
+Test(SET_SESSION_PARAMS, set_pipeline_depth, .init = setup, .fini = teardown) {
+    rv = amvp_set_pipeline_depth(ctx, 2);
+    cr_assert(rv == AMVP_SUCCESS);
+    rv = amvp_set_pipeline_depth(ctx, 0);
+    cr_assert(rv == AMVP_SUCCESS);
+    rv = amvp_set_pipeline_depth(ctx, AMVP_MAX_PIPELINE_DEPTH);
+    cr_assert(rv == AMVP_SUCCESS);
+    rv = amvp_set_pipeline_depth(NULL, 2);
+    cr_assert(rv == AMVP_NO_CTX);
+    rv = amvp_set_pipeline_depth(ctx, -1);
+    cr_assert(rv == AMVP_INVALID_ARG);
+    rv = amvp_set_pipeline_depth(ctx, AMVP_MAX_PIPELINE_DEPTH + 1);
+    cr_assert(rv == AMVP_INVALID_ARG);
+}
+
+/*
+ * This test toggles HTTP/2, which needs libcurl built with nghttp2
+ */
+Test(SET_SESSION_PARAMS, set_http2, .init = setup, .fini = teardown) {
+    rv = amvp_set_http2(ctx, 1);
+    cr_assert(rv == AMVP_SUCCESS || rv == AMVP_UNSUPPORTED_OP);
+    rv = amvp_set_http2(ctx, 0);
+    cr_assert(rv == AMVP_SUCCESS);
+    rv = amvp_set_http2(NULL, 1);
+    cr_assert(rv == AMVP_NO_CTX);
+}
+
+/*
+ * This test turns asynchronous logging on and off
+ */
+Test(SET_SESSION_PARAMS, set_async_logging, .init = setup, .fini = teardown) {
+    rv = amvp_set_async_logging(ctx, 64, NULL);
+    cr_assert(rv == AMVP_SUCCESS);
+    rv = amvp_set_async_logging(ctx, 0, NULL);
+    cr_assert(rv == AMVP_SUCCESS);
+    rv = amvp_set_async_logging(NULL, 64, NULL);
+    cr_assert(rv == AMVP_NO_CTX);
+    rv = amvp_set_async_logging(ctx, -1, NULL);
+    cr_assert(rv == AMVP_INVALID_ARG);
+    rv = amvp_set_async_logging(ctx, AMVP_MAX_LOG_SLOTS + 1, NULL);
+    cr_assert(rv == AMVP_INVALID_ARG);
+    /* Left enabled, teardown writes out the queue */
+    rv = amvp_set_async_logging(ctx, 64, NULL);
+    cr_assert(rv == AMVP_SUCCESS);
+}
+
+/*
+ * This test enables metrics and queries them before anything has run
+ */
+Test(SET_SESSION_PARAMS, set_metrics, .init = setup, .fini = teardown) {
+    AMVP_VS_METRICS vs;
+    AMVP_ALG_METRICS alg;
+    char *json = NULL;
+
+    rv = amvp_get_vs_metrics(ctx, 0, &vs);
+    cr_assert(rv == AMVP_NO_DATA);
+    cr_assert(amvp_get_metrics_json(ctx, NULL) == NULL);
+
+    rv = amvp_set_metrics(NULL, 1, NULL);
+    cr_assert(rv == AMVP_NO_CTX);
+    rv = amvp_set_metrics(ctx, 1, NULL);
+    cr_assert(rv == AMVP_SUCCESS);
+
+    rv = amvp_get_vs_metrics(ctx, 0, &vs);
+    cr_assert(rv == AMVP_NO_DATA);
+    rv = amvp_get_alg_metrics(ctx, 0, &alg);
+    cr_assert(rv == AMVP_NO_DATA);
+    rv = amvp_get_vs_metrics(ctx, 0, NULL);
+    cr_assert(rv == AMVP_INVALID_ARG);
+    json = amvp_get_metrics_json(ctx, NULL);
+    cr_assert_not_null(json);
+    free(json);
+
+    rv = amvp_set_metrics(ctx, 0, NULL);
+    cr_assert(rv == AMVP_SUCCESS);
+}
+
+/*
+ * Allocations made while a set is processed are charged to it and to the
+ * phase they were marked for
+ */
+Test(SET_SESSION_PARAMS, metrics_memory, .init = setup, .fini = teardown) {
+    AMVP_VS_METRICS_REC *rec = NULL;
+    AMVP_VS_METRICS vs;
+    AMVP_MEM_MARK mem;
+    JSON_Value *val = NULL;
+    JSON_Malloc_Function malloc_fun = NULL;
+    JSON_Free_Function free_fun = NULL;
+    char *buf = NULL;
+
+    rv = amvp_set_metrics(ctx, 1, NULL);
+    cr_assert(rv == AMVP_SUCCESS);
+
+    rec = amvp_metrics_begin(ctx, "/amvp/v1/testSessions/1/vectorSets/1");
+    cr_assert_not_null(rec);
+    amvp_mem_mark(&mem);
+    val = json_parse_string("{\"vsId\": 1, \"testGroups\": [{\"tgId\": 1}]}");
+    cr_assert_not_null(val);
+    amvp_metrics_mem_phase(rec, AMVP_METRICS_PARSE, &mem);
+    buf = amvp_mem_malloc(65536);
+    cr_assert_not_null(buf);
+    json_value_free(val);
+    amvp_metrics_end(ctx);
+    amvp_mem_free(buf);
+
+    rv = amvp_get_vs_metrics(ctx, 0, &vs);
+    cr_assert(rv == AMVP_SUCCESS);
+    cr_assert(vs.parse_allocs > 0);
+    cr_assert(vs.allocs > vs.parse_allocs);
+    cr_assert(vs.alloc_bytes >= vs.parse_alloc_bytes + 65536);
+    cr_assert(vs.handler_allocs == 0 && vs.upload_allocs == 0);
+
+    /* parson gets its own allocator back with the last context */
+    rv = amvp_set_metrics(ctx, 0, NULL);
+    cr_assert(rv == AMVP_SUCCESS);
+    json_get_allocation_functions(&malloc_fun, &free_fun);
+    cr_assert(malloc_fun == malloc && free_fun == free);
+}
+
+/*
+ * A request's timings are kept as given, split into setup, server wait and
+ * transfer for its vector set, and written out as a HAR trace
+ */
+Test(SET_SESSION_PARAMS, metrics_net_timing, .init = setup, .fini = teardown) {
+    AMVP_VS_METRICS_REC *rec = NULL;
+    AMVP_NET_TIMING t, out;
+    AMVP_VS_METRICS vs;
+    JSON_Value *har = NULL;
+    JSON_Object *log = NULL;
+
+    rv = amvp_set_net_trace(ctx, "net_trace_test.har");
+    cr_assert(rv == AMVP_UNSUPPORTED_OP);
+    rv = amvp_set_metrics(ctx, 1, NULL);
+    cr_assert(rv == AMVP_SUCCESS);
+    rv = amvp_set_net_trace(NULL, "net_trace_test.har");
+    cr_assert(rv == AMVP_NO_CTX);
+    rv = amvp_set_net_trace(ctx, "net_trace_test.har");
+    cr_assert(rv == AMVP_SUCCESS);
+
+    memset(&t, 0, sizeof(t));
+    strcpy_s(t.method, sizeof(t.method), "GET");
+    strcpy_s(t.url, sizeof(t.url), "https://localhost/amvp/v1/testSessions/1/vectorSets/1");
+    t.http_code = 200;
+    t.dns_ms = 1;
+    t.connect_ms = 3;
+    t.tls_ms = 10;
+    t.pretransfer_ms = 11;
+    t.first_byte_ms = 111;
+    t.total_ms = 131;
+    t.bytes_down = 4096;
+    rec = amvp_metrics_vs(ctx, "/amvp/v1/testSessions/1/vectorSets/1");
+    cr_assert_not_null(rec);
+    amvp_metrics_request(ctx, rec, &t);
+
+    rv = amvp_get_net_timing(ctx, 0, &out);
+    cr_assert(rv == AMVP_SUCCESS);
+    cr_assert(out.http_code == 200 && out.total_ms == 131 && out.bytes_down == 4096);
+    cr_assert(out.started > 0);
+    rv = amvp_get_net_timing(ctx, 1, &out);
+    cr_assert(rv == AMVP_NO_DATA);
+    rv = amvp_get_net_timing(ctx, 0, NULL);
+    cr_assert(rv == AMVP_INVALID_ARG);
+
+    rv = amvp_get_vs_metrics(ctx, 0, &vs);
+    cr_assert(rv == AMVP_SUCCESS);
+    cr_assert(vs.net_setup_ms == 10);
+    cr_assert(vs.server_wait_ms == 100);
+    cr_assert(vs.transfer_ms == 20);
+
+    amvp_metrics_emit(ctx);
+    har = json_parse_file("net_trace_test.har");
+    cr_assert_not_null(har);
+    log = json_object_get_object(json_value_get_object(har), "log");
+    cr_assert(json_array_get_count(json_object_get_array(log, "entries")) == 1);
+    json_value_free(har);
+    remove("net_trace_test.har");
+
+    rv = amvp_set_metrics(ctx, 0, NULL);
+    cr_assert(rv == AMVP_SUCCESS);
+}
+
+/*
+ * Enable and disable the metadata cache. A missing file is an empty cache.
+ */
+Test(SET_SESSION_PARAMS, set_metadata_cache, .init = setup, .fini = teardown) {
+    rv = amvp_set_metadata_cache(NULL, "meta_cache_test.json");
+    cr_assert(rv == AMVP_NO_CTX);
+    rv = amvp_set_metadata_cache(ctx, "this_file_does_not_exist/meta_cache.json");
+    cr_assert(rv == AMVP_SUCCESS);
+    rv = amvp_set_metadata_cache(ctx, NULL);
+    cr_assert(rv == AMVP_SUCCESS);
+}
+
+/*
+ * Load and drop an evidence store. A missing or malformed mapping file is
+ * an error and leaves the store as it was.
+ */
+Test(SET_SESSION_PARAMS, set_evidence_store, .init = setup, .fini = teardown) {
+    rv = amvp_set_evidence_store(NULL, "evidence.json");
+    cr_assert(rv == AMVP_NO_CTX);
+    rv = amvp_set_evidence_store(ctx, "this_file_does_not_exist/evidence.json");
+    cr_assert(rv == AMVP_JSON_ERR);
+    rv = amvp_add_evidence(ctx, "TE02.20.01", "none");
+    cr_assert(rv == AMVP_SUCCESS);
+    rv = amvp_add_evidence(ctx, NULL, "none");
+    cr_assert(rv == AMVP_MISSING_ARG);
+    rv = amvp_add_evidence_file(ctx, "TE04.11.01", "services.pdf");
+    cr_assert(rv == AMVP_SUCCESS);
+    rv = amvp_add_evidence_file(ctx, "", "services.pdf");
+    cr_assert(rv == AMVP_INVALID_ARG);
+    rv = amvp_set_evidence_store(ctx, NULL);
+    cr_assert(rv == AMVP_SUCCESS);
+}
+
+/*
+ * Enable and disable resume checkpoints
+ */
+Test(SET_SESSION_PARAMS, set_resume_checkpoints, .init = setup, .fini = teardown) {
+    rv = amvp_set_resume_checkpoints(NULL, 1);
+    cr_assert(rv == AMVP_NO_CTX);
+    rv = amvp_set_resume_checkpoints(ctx, 1);
+    cr_assert(rv == AMVP_SUCCESS);
+    rv = amvp_set_resume_checkpoints(ctx, 0);
+    cr_assert(rv == AMVP_SUCCESS);
+}
+
+/*
+ * Set and clear the response memory budget
+ */
+Test(SET_SESSION_PARAMS, set_response_memory_budget, .init = setup, .fini = teardown) {
+    rv = amvp_set_response_memory_budget(NULL, 64);
+    cr_assert(rv == AMVP_NO_CTX);
+    rv = amvp_set_response_memory_budget(ctx, -1);
+    cr_assert(rv == AMVP_INVALID_ARG);
+    rv = amvp_set_response_memory_budget(ctx, 64);
+    cr_assert(rv == AMVP_SUCCESS);
+    cr_assert(ctx->rsp_mem_budget == 64 * 1024);
+    rv = amvp_set_response_memory_budget(ctx, 0);
+    cr_assert(rv == AMVP_SUCCESS);
+}
+
+/*
+ * Set and clear the upload chunk size
+ */
+Test(SET_SESSION_PARAMS, set_chunked_upload, .init = setup, .fini = teardown) {
+    rv = amvp_set_chunked_upload(NULL, 512);
+    cr_assert(rv == AMVP_NO_CTX);
+    rv = amvp_set_chunked_upload(ctx, -1);
+    cr_assert(rv == AMVP_INVALID_ARG);
+    rv = amvp_set_chunked_upload(ctx, 512);
+    cr_assert(rv == AMVP_SUCCESS);
+    cr_assert(ctx->upload_chunk == 512 * 1024);
+    rv = amvp_set_chunked_upload(ctx, 0);
+    cr_assert(rv == AMVP_SUCCESS);
+    cr_assert(ctx->upload_chunk == 0);
+}
+
+/*
+ * Set the JWT renewal margin
+ */
+Test(SET_SESSION_PARAMS, set_jwt_renewal, .init = setup, .fini = teardown) {
+    rv = amvp_set_jwt_renewal(NULL, 60);
+    cr_assert(rv == AMVP_NO_CTX);
+    rv = amvp_set_jwt_renewal(ctx, 60);
+    cr_assert(rv == AMVP_SUCCESS);
+    cr_assert(ctx->jwt_renew_margin == 60);
+    rv = amvp_set_jwt_renewal(ctx, -5);
+    cr_assert(rv == AMVP_SUCCESS);
+    cr_assert(ctx->jwt_renew_margin == -1);
+    rv = amvp_set_jwt_renewal(ctx, 0);
+    cr_assert(rv == AMVP_SUCCESS);
+}
+
+Test(SET_SESSION_PARAMS, set_incremental_parse, .init = setup, .fini = teardown) {
+    rv = amvp_set_incremental_parse(NULL, 1);
+    cr_assert(rv == AMVP_NO_CTX);
+    rv = amvp_set_incremental_parse(ctx, 5);
+    cr_assert(rv == AMVP_SUCCESS);
+    cr_assert(ctx->incremental_parse == 1);
+    rv = amvp_set_incremental_parse(ctx, 0);
+    cr_assert(rv == AMVP_SUCCESS);
+    cr_assert(ctx->incremental_parse == 0);
+}
+
+Test(SET_SESSION_PARAMS, set_request_file_buffer, .init = setup, .fini = teardown) {
+    JSON_Value *ids = NULL, *set = NULL, *saved = NULL;
+
+    rv = amvp_set_request_file_buffer(NULL, 64, AMVP_FSYNC_NONE);
+    cr_assert(rv == AMVP_NO_CTX);
+    rv = amvp_set_request_file_buffer(ctx, -1, AMVP_FSYNC_NONE);
+    cr_assert(rv == AMVP_INVALID_ARG);
+    rv = amvp_set_request_file_buffer(ctx, AMVP_REQ_FILE_BUF_MAX_KB + 1, AMVP_FSYNC_NONE);
+    cr_assert(rv == AMVP_INVALID_ARG);
+    rv = amvp_set_request_file_buffer(ctx, 64, AMVP_FSYNC_EACH_SET + 1);
+    cr_assert(rv == AMVP_INVALID_ARG);
+    rv = amvp_set_request_file_buffer(ctx, 4, AMVP_FSYNC_EACH_SET);
+    cr_assert(rv == AMVP_SUCCESS);
+    cr_assert(ctx->req_file.buf_size == 4096);
+
+    /* The sets are streamed into one handle and read back as one array */
+    rv = amvp_mark_as_request_only(ctx, "test_req_file.json");
+    cr_assert(rv == AMVP_SUCCESS);
+    ids = json_parse_string("{\"jwt\":\"abc\",\"vectorSetUrls\":[\"/vs/1\"]}");
+    set = json_parse_string("{\"vsId\":1,\"testGroups\":[{\"tgId\":1,\"tests\":[]}]}");
+    rv = amvp_req_file_begin(ctx, ids);
+    cr_assert(rv == AMVP_SUCCESS);
+    rv = amvp_req_file_add(ctx, set);
+    cr_assert(rv == AMVP_SUCCESS);
+    rv = amvp_req_file_end(ctx);
+    cr_assert(rv == AMVP_SUCCESS);
+    cr_assert(ctx->req_file.fp == NULL);
+    saved = json_parse_file("test_req_file.json");
+    cr_assert(saved != NULL);
+    cr_assert(json_array_get_count(json_value_get_array(saved)) == 2);
+    cr_assert(json_value_equals(json_array_get_value(json_value_get_array(saved), 1), set));
+    json_value_free(ids);
+    json_value_free(set);
+    json_value_free(saved);
+    remove("test_req_file.json");
+}
+
+static int crypto_cache_calls;
+
+static int crypto_cache_hash_handler(AMVP_TEST_CASE *test_case) {
+    AMVP_HASH_TC *tc = test_case->tc.hash;
+
+    crypto_cache_calls++;
+    memset(tc->md, tc->msg[0] + crypto_cache_calls, 32);
+    tc->md_len = 32;
+    return 0;
+}
+
+/*
+ * With the crypto cache on, a repeated hash AFT test case is answered
+ * from the cache, and MCT test cases always reach the handler
+ */
+Test(SET_SESSION_PARAMS, set_crypto_cache, .init = setup, .fini = teardown) {
+    AMVP_CAPS_LIST *cap = NULL;
+    AMVP_TEST_CASE tc;
+    AMVP_HASH_TC stc;
+    unsigned char msg[4] = { 1, 2, 3, 4 };
+    unsigned char md[AMVP_HASH_MD_BYTE_MAX];
+
+    rv = amvp_set_crypto_cache(NULL, 1, NULL);
+    cr_assert(rv == AMVP_NO_CTX);
+    rv = amvp_set_crypto_cache(ctx, 1, NULL);
+    cr_assert(rv == AMVP_SUCCESS);
+    rv = amvp_cap_hash_enable(ctx, AMVP_HASH_SHA256, &crypto_cache_hash_handler);
+    cr_assert(rv == AMVP_SUCCESS);
+    cap = amvp_locate_cap_entry(ctx, AMVP_HASH_SHA256);
+    cr_assert_not_null(cap);
+
+    memset(&stc, 0, sizeof(stc));
+    stc.cipher = AMVP_HASH_SHA256;
+    stc.test_type = AMVP_HASH_TEST_TYPE_AFT;
+    stc.msg = msg;
+    stc.msg_len = sizeof(msg);
+    stc.md = md;
+    tc.tc.hash = &stc;
+
+    crypto_cache_calls = 0;
+    cr_assert(amvp_crypto_call(ctx, cap, &tc) == 0);
+    cr_assert(md[0] == 2);
+    memset(md, 0, sizeof(md));
+    stc.md_len = 0;
+    cr_assert(amvp_crypto_call(ctx, cap, &tc) == 0);
+    cr_assert(crypto_cache_calls == 1);
+    cr_assert(stc.md_len == 32 && md[0] == 2 && md[31] == 2);
+
+    msg[0] = 5;
+    cr_assert(amvp_crypto_call(ctx, cap, &tc) == 0);
+    cr_assert(crypto_cache_calls == 2);
+
+    stc.test_type = AMVP_HASH_TEST_TYPE_MCT;
+    cr_assert(amvp_crypto_call(ctx, cap, &tc) == 0);
+    cr_assert(amvp_crypto_call(ctx, cap, &tc) == 0);
+    cr_assert(crypto_cache_calls == 4);
+
+    rv = amvp_set_crypto_cache(ctx, 0, NULL);
+    cr_assert(rv == AMVP_SUCCESS);
+}
+
 /*
  * This test frees ctx
  */
@@ -451,6 +1038,137 @@ Test(FREE_TEST_SESSION, good_full, .init = setup_full_ctx) {
     cr_assert(rv == AMVP_SUCCESS);
 }
 
+/*
+ * Clones a context with capabilities, which are read only until the
+ * clone is freed
+ */
+Test(CLONE_CTX, good, .init = setup_full_ctx, .fini = teardown) {
+    AMVP_CTX *clone = NULL;
+
+    rv = amvp_ctx_clone(NULL, &clone);
+    cr_assert(rv == AMVP_NO_CTX);
+    rv = amvp_ctx_clone(ctx, NULL);
+    cr_assert(rv == AMVP_INVALID_ARG);
+
+    rv = amvp_ctx_clone(ctx, &clone);
+    cr_assert(rv == AMVP_SUCCESS);
+    cr_assert(clone != NULL);
+    cr_assert(amvp_locate_cap_entry(clone, AMVP_AES_GCM) == amvp_locate_cap_entry(ctx, AMVP_AES_GCM));
+    cr_assert(clone->vs_count == ctx->vs_count);
+    rv = amvp_ctx_clone(ctx, &clone);
+    cr_assert(rv == AMVP_CTX_NOT_EMPTY);
+
+    rv = amvp_cap_sym_cipher_set_parm(ctx, AMVP_AES_GCM, AMVP_SYM_CIPH_KEYLEN, 256);
+    cr_assert(rv != AMVP_SUCCESS);
+    rv = amvp_cap_hash_enable(clone, AMVP_HASH_SHA256, &dummy_handler_success);
+    cr_assert(rv == AMVP_UNSUPPORTED_OP);
+
+    rv = amvp_free_test_session(clone);
+    cr_assert(rv == AMVP_SUCCESS);
+    rv = amvp_cap_sym_cipher_set_parm(ctx, AMVP_AES_GCM, AMVP_SYM_CIPH_KEYLEN, 256);
+    cr_assert(rv == AMVP_SUCCESS);
+}
+
+#ifndef _WIN32
+#define CLONE_REG_THREADS 8
+#define CLONE_REG_ROUNDS 50
+
+typedef struct {
+    AMVP_CTX *clone;
+    const char *expected;
+    int mismatches;
+} CLONE_REG_ARG;
+
+static void *clone_reg_worker(void *arg) {
+    CLONE_REG_ARG *a = arg;
+    JSON_Value *reg = NULL;
+    char *str = NULL;
+    int i = 0;
+
+    for (i = 0; i < CLONE_REG_ROUNDS; i++) {
+        if (amvp_build_registration_json(a->clone, &reg) != AMVP_SUCCESS) {
+            a->mismatches++;
+            continue;
+        }
+        str = json_serialize_to_string(reg, NULL);
+        if (!str || strcmp(str, a->expected)) {
+            a->mismatches++;
+        }
+        json_free_serialized_string(str);
+        json_value_free(reg);
+    }
+    return NULL;
+}
+
+/*
+ * Clones share their capabilities, so building the registration must not
+ * write to them. Caps that expand into two registrations (IV generation
+ * source "either", ECDSA component mode "both") are built by every clone
+ * at once and must come out the same as a single threaded build.
+ */
+Test(CLONE_CTX, threaded_registration, .init = setup_full_ctx, .fini = teardown) {
+    AMVP_CTX *clones[CLONE_REG_THREADS] = { 0 };
+    CLONE_REG_ARG args[CLONE_REG_THREADS];
+    pthread_t tids[CLONE_REG_THREADS];
+    JSON_Value *reg = NULL;
+    char *expected = NULL;
+    int i = 0;
+
+    rv = amvp_cap_sym_cipher_set_parm(ctx, AMVP_AES_GCM, AMVP_SYM_CIPH_PARM_IVGEN_SRC, AMVP_SYM_CIPH_IVGEN_SRC_EITHER);
+    cr_assert(rv == AMVP_SUCCESS);
+    rv = amvp_cap_ecdsa_enable(ctx, AMVP_ECDSA_SIGGEN, &dummy_handler_success);
+    cr_assert(rv == AMVP_SUCCESS);
+    rv = amvp_cap_set_prereq(ctx, AMVP_ECDSA_SIGGEN, AMVP_PREREQ_SHA, cvalue);
+    cr_assert(rv == AMVP_SUCCESS);
+    rv = amvp_cap_set_prereq(ctx, AMVP_ECDSA_SIGGEN, AMVP_PREREQ_DRBG, cvalue);
+    cr_assert(rv == AMVP_SUCCESS);
+    rv = amvp_cap_ecdsa_set_parm(ctx, AMVP_ECDSA_SIGGEN, AMVP_ECDSA_CURVE, AMVP_EC_CURVE_P256);
+    cr_assert(rv == AMVP_SUCCESS);
+    rv = amvp_cap_ecdsa_set_parm(ctx, AMVP_ECDSA_SIGGEN, AMVP_ECDSA_CURVE, AMVP_EC_CURVE_P384);
+    cr_assert(rv == AMVP_SUCCESS);
+    rv = amvp_cap_ecdsa_set_curve_hash_alg(ctx, AMVP_ECDSA_SIGGEN, AMVP_EC_CURVE_P256, AMVP_SHA224);
+    cr_assert(rv == AMVP_SUCCESS);
+    rv = amvp_cap_ecdsa_set_parm(ctx, AMVP_ECDSA_SIGGEN, AMVP_ECDSA_HASH_ALG, AMVP_SHA256);
+    cr_assert(rv == AMVP_SUCCESS);
+    rv = amvp_cap_ecdsa_set_parm(ctx, AMVP_ECDSA_SIGGEN, AMVP_ECDSA_COMPONENT_TEST, AMVP_ECDSA_COMPONENT_MODE_BOTH);
+    cr_assert(rv == AMVP_SUCCESS);
+
+    rv = amvp_build_registration_json(ctx, &reg);
+    cr_assert(rv == AMVP_SUCCESS);
+    expected = json_serialize_to_string(reg, NULL);
+    json_value_free(reg);
+    cr_assert(expected != NULL);
+    cr_assert(strstr(expected, "\"ivGen\":\"internal\"") != NULL);
+    cr_assert(strstr(expected, "\"ivGen\":\"external\"") != NULL);
+    cr_assert(strstr(expected, "\"componentTest\":true") != NULL);
+    cr_assert(strstr(expected, "\"componentTest\":false") != NULL);
+    /* The caps are as registered after the build */
+    cr_assert(amvp_locate_cap_entry(ctx, AMVP_AES_GCM)->cap.sym_cap->ivgen_source == AMVP_SYM_CIPH_IVGEN_SRC_EITHER);
+    cr_assert(amvp_locate_cap_entry(ctx, AMVP_ECDSA_SIGGEN)->cap.ecdsa_siggen_cap->component == AMVP_ECDSA_COMPONENT_MODE_BOTH);
+    cr_assert(amvp_locate_cap_entry(ctx, AMVP_ECDSA_SIGGEN)->cap.ecdsa_siggen_cap->curves->algs[AMVP_SHA256] == 0);
+
+    for (i = 0; i < CLONE_REG_THREADS; i++) {
+        rv = amvp_ctx_clone(ctx, &clones[i]);
+        cr_assert(rv == AMVP_SUCCESS);
+        args[i].clone = clones[i];
+        args[i].expected = expected;
+        args[i].mismatches = 0;
+    }
+    for (i = 0; i < CLONE_REG_THREADS; i++) {
+        cr_assert(pthread_create(&tids[i], NULL, clone_reg_worker, &args[i]) == 0);
+    }
+    for (i = 0; i < CLONE_REG_THREADS; i++) {
+        pthread_join(tids[i], NULL);
+        cr_expect(args[i].mismatches == 0, "clone %d built %d bad registrations", i, args[i].mismatches);
+    }
+
+    for (i = 0; i < CLONE_REG_THREADS; i++) {
+        amvp_free_test_session(clones[i]);
+    }
+    json_free_serialized_string(expected);
+}
+#endif
+
 /*
  * Calls run with missing path segment
  */
@@ -563,6 +1281,72 @@ Test(RUN, null_ctx, .fini = teardown) {
     cr_assert(rv == AMVP_NO_CTX);
 }
 
+/*
+ * Session group lifecycle, freeing one attached context before the group
+ * and one after it
+ */
+Test(SESSION_GROUP, create_attach_free, .init = setup, .fini = teardown) {
+    AMVP_SESSION_GROUP *group = NULL;
+    AMVP_CTX *ctx2 = NULL;
+
+    rv = amvp_session_group_create(NULL, 2);
+    cr_assert(rv == AMVP_INVALID_ARG);
+    rv = amvp_session_group_create(&group, 0);
+    cr_assert(rv == AMVP_INVALID_ARG);
+    rv = amvp_session_group_create(&group, 2);
+    cr_assert(rv == AMVP_SUCCESS);
+    rv = amvp_session_group_create(&group, 2);
+    cr_assert(rv == AMVP_CTX_NOT_EMPTY);
+
+    rv = amvp_session_group_run(group, 0, NULL);
+    cr_assert(rv == AMVP_MISSING_ARG);
+
+    setup_empty_ctx(&ctx2);
+    rv = amvp_session_group_attach(group, ctx);
+    cr_assert(rv == AMVP_SUCCESS);
+    rv = amvp_session_group_attach(group, ctx);
+    cr_assert(rv == AMVP_UNSUPPORTED_OP);
+    rv = amvp_session_group_attach(group, ctx2);
+    cr_assert(rv == AMVP_SUCCESS);
+    rv = amvp_session_group_attach(group, NULL);
+    cr_assert(rv == AMVP_NO_CTX);
+
+    rv = amvp_free_test_session(ctx2);
+    cr_assert(rv == AMVP_SUCCESS);
+    rv = amvp_session_group_free(group);
+    cr_assert(rv == AMVP_SUCCESS);
+}
+
+/*
+ * Stepping a session that was never started, then one that was
+ */
+Test(RUN, async_step, .init = setup_full_ctx, .fini = teardown) {
+    int done = 0;
+    long timeout = 0;
+
+    rv = amvp_step(ctx, &done);
+    cr_assert(rv == AMVP_UNSUPPORTED_OP);
+    rv = amvp_async_timeout(ctx, &timeout);
+    cr_assert(rv == AMVP_SUCCESS);
+    cr_assert(timeout == -1);
+
+    rv = amvp_run_async(ctx, 0);
+    cr_assert(rv == AMVP_SUCCESS);
+    rv = amvp_run_async(ctx, 0);
+    cr_assert(rv == AMVP_UNSUPPORTED_OP);
+    rv = amvp_async_timeout(ctx, &timeout);
+    cr_assert(rv == AMVP_SUCCESS);
+    cr_assert(timeout == 0);
+
+    /* Nothing to talk to, so the session fails within a few steps */
+    while (!done) {
+        rv = amvp_step(ctx, &done);
+    }
+    cr_assert(rv != AMVP_SUCCESS);
+    rv = amvp_step(NULL, &done);
+    cr_assert(rv == AMVP_NO_CTX);
+}
+
 /*
  * Check test results with empty ctx
  */
@@ -681,6 +1465,145 @@ Test(PROCESS_TESTS, run_vectors_from_file, .init = setup_full_ctx, .fini = teard
 
 }
 
+/*
+ * Test amvp_run_vectors_from_file with lazy parsing on a file that breaks
+ * off in its second vector set: an error, not a shorter response file
+ */
+Test(PROCESS_TESTS, run_vectors_from_file_truncated, .init = setup_full_ctx, .fini = teardown) {
+    FILE *fp = NULL;
+    char *buf = NULL;
+    long len = 0;
+
+    fp = fopen("json/req.json", "rb");
+    cr_assert_not_null(fp);
+    fseek(fp, 0, SEEK_END);
+    len = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    buf = calloc(len + 1, 1);
+    cr_assert_not_null(buf);
+    cr_assert(fread(buf, 1, len, fp) == (size_t)len);
+    fclose(fp);
+
+    /* Replace the closing ']' with the start of the second vector set */
+    while (len && buf[len - 1] != ']') {
+        len--;
+    }
+    cr_assert(len > 0);
+    fp = fopen("json/req_truncated.json", "wb");
+    cr_assert_not_null(fp);
+    cr_assert(fwrite(buf, 1, len - 1, fp) == (size_t)(len - 1));
+    fputs(", { \"vsId\": 7969, \"testGroups\": [", fp);
+    fclose(fp);
+    free(buf);
+
+    rv = amvp_set_lazy_file_parsing(ctx, 1);
+    cr_assert(rv == AMVP_SUCCESS);
+
+    rv = amvp_run_vectors_from_file(ctx, "json/req_truncated.json", "json/rsp1.json");
+    cr_assert(rv == AMVP_MALFORMED_JSON);
+    remove("json/req_truncated.json");
+}
+
+/*
+ * Test amvp_shard_request_file and amvp_merge_response_files: sharding
+ * then merging gives back every vector set
+ */
+Test(PROCESS_TESTS, shard_and_merge_files, .init = setup_full_ctx, .fini = teardown) {
+    const char *shards[2] = { "json/shard.json.0", "json/shard.json.1" };
+    const char *other[2] = { "json/shard.json.0", "json/req.json" };
+    JSON_Value *val = NULL;
+
+    rv = amvp_shard_request_file(NULL, "test", shards, 2);
+    cr_assert(rv == AMVP_NO_CTX);
+
+    rv = amvp_shard_request_file(ctx, NULL, shards, 2);
+    cr_assert(rv == AMVP_MISSING_ARG);
+
+    rv = amvp_shard_request_file(ctx, "json/rsp.json", shards, 0);
+    cr_assert(rv == AMVP_INVALID_ARG);
+
+    rv = amvp_merge_response_files(ctx, shards, 2, NULL);
+    cr_assert(rv == AMVP_MISSING_ARG);
+
+    rv = amvp_shard_request_file(ctx, "json/rsp.json", shards, 2);
+    cr_assert(rv == AMVP_SUCCESS);
+
+    rv = amvp_merge_response_files(ctx, shards, 2, "json/shard.json");
+    cr_assert(rv == AMVP_SUCCESS);
+
+    val = json_parse_file("json/shard.json");
+    cr_assert_not_null(val);
+    cr_assert(json_array_get_count(json_array(val)) == 3);
+    cr_assert(json_array_get_count(json_object_get_array(json_array_get_object(json_array(val), 0),
+                                                          "vectorSetUrls")) == 2);
+    json_value_free(val);
+
+    /* req.json has fewer vector sets than URLs */
+    rv = amvp_merge_response_files(ctx, other, 2, "json/shard.json");
+    cr_assert(rv == AMVP_MALFORMED_JSON);
+}
+
+/*
+ * Test amvp_set_vs_cache: running a request file writes its cache, which
+ * then loads and finds a test case through its index, already decoded
+ */
+Test(PROCESS_TESTS, vs_cache, .init = setup_full_ctx, .fini = teardown) {
+    AMVP_VS_CACHE_MAP map;
+    JSON_Value *val = NULL, *tc = NULL;
+    int tg_id = 0;
+
+    rv = amvp_set_vs_cache(NULL, 1);
+    cr_assert(rv == AMVP_NO_CTX);
+
+    rv = amvp_set_vs_cache(ctx, 1);
+    cr_assert(rv == AMVP_SUCCESS);
+
+    remove("json/req.json" AMVP_VS_CACHE_EXT);
+    rv = amvp_vs_cache_load(ctx, "json/req.json", &map, &val);
+    cr_assert(rv == AMVP_NO_DATA);
+
+    rv = amvp_run_vectors_from_file(ctx, "json/req.json", "json/rsp1.json");
+    cr_assert(rv == AMVP_SUCCESS);
+
+    rv = amvp_vs_cache_load(ctx, "json/req.json", &map, &val);
+    cr_assert(rv == AMVP_SUCCESS);
+    cr_assert(json_array_get_count(json_array(val)) == 2);
+
+    rv = amvp_vs_cache_find(&map, 7968, 2, &tg_id, &tc);
+    cr_assert(rv == AMVP_SUCCESS);
+    cr_assert(tg_id == 1);
+    cr_assert(strcmp(json_object_get_string(json_object(tc), "key"), "B0314E37EB96321F82B7043BB8481B85") == 0);
+    cr_assert_not_null(json_value_get_string_bin(json_object_get_value(json_object(tc), "key")));
+    json_value_free(tc);
+
+    rv = amvp_vs_cache_find(&map, 7968, 100000, &tg_id, &tc);
+    cr_assert(rv == AMVP_NO_DATA);
+
+    json_value_free(val);
+    amvp_vs_cache_unmap(&map);
+
+#if !defined(_WIN32) && !defined(__APPLE__)
+    {
+        struct stat st;
+        struct timespec times[2];
+
+        /* Rewritten within the same second, with the same size */
+        cr_assert(stat("json/req.json", &st) == 0);
+        times[0] = st.st_atim;
+        times[1] = st.st_mtim;
+        times[1].tv_nsec = (times[1].tv_nsec + 1000) % 1000000000;
+        cr_assert(utimensat(AT_FDCWD, "json/req.json", times, 0) == 0);
+        cr_assert(stat("json/req.json", &st) == 0);
+        /* Skipped on file systems that only keep whole seconds */
+        if (st.st_mtim.tv_nsec == times[1].tv_nsec) {
+            rv = amvp_vs_cache_load(ctx, "json/req.json", &map, &val);
+            cr_assert(rv == AMVP_NO_DATA);
+        }
+    }
+#endif
+    remove("json/req.json" AMVP_VS_CACHE_EXT);
+}
+
 /*
  * Test amvp_load_kat_filename
  */
@@ -850,6 +1773,48 @@ Test(PROCESS_TESTS, get_vector_set_count, .init = setup_full_ctx, .fini = teardo
 
 }
 
+/*
+ * Test amvp_estimate_workload, amvp_get_workload_estimate and amvp_set_workload_model
+ */
+Test(PROCESS_TESTS, estimate_workload, .init = setup_full_ctx, .fini = teardown) {
+    AMVP_WORKLOAD_MODEL model = { 10, 0, 0, 0, 1.0, 1.0, 100, 50 };
+    AMVP_WORKLOAD_ESTIMATE total, est;
+    int i, found = 0;
+
+    rv = amvp_estimate_workload(NULL, &total);
+    cr_assert(rv == AMVP_NO_CTX);
+    rv = amvp_get_workload_estimate(ctx, 0, &est);
+    cr_assert(rv == AMVP_NO_DATA);
+
+    rv = amvp_estimate_workload(ctx, &total);
+    cr_assert(rv == AMVP_SUCCESS);
+    cr_assert(total.vector_sets == amvp_get_vector_set_count(ctx));
+    cr_assert(total.test_cases > 0);
+    cr_assert(total.cpu_secs > 0);
+    rv = amvp_get_workload_estimate(ctx, -1, &est);
+    cr_assert(rv == AMVP_INVALID_ARG);
+    rv = amvp_get_workload_estimate(ctx, total.vector_sets, &est);
+    cr_assert(rv == AMVP_NO_DATA);
+
+    model.tests = -1;
+    rv = amvp_set_workload_model(ctx, "SHA-1", &model);
+    cr_assert(rv == AMVP_INVALID_ARG);
+    model.tests = 10;
+    rv = amvp_set_workload_model(ctx, "SHA-1", &model);
+    cr_assert(rv == AMVP_SUCCESS);
+    rv = amvp_estimate_workload(ctx, &total);
+    cr_assert(rv == AMVP_SUCCESS);
+    for (i = 0; amvp_get_workload_estimate(ctx, i, &est) == AMVP_SUCCESS; i++) {
+        if (!strcmp(est.algorithm, "SHA-1")) {
+            found = 1;
+            break;
+        }
+    }
+    cr_assert(found);
+    cr_assert(est.test_cases == 10);
+    cr_assert(est.request_bytes == 1000);
+}
+
 /*
  * Test amvp_mark_as_put_after_test
  */
@@ -959,3 +1924,60 @@ Test(PROCESS_TESTS, amvp_get_expected_results, .init = setup_full_ctx, .fini = t
     rv = amvp_get_expected_results(ctx, "", NULL);
     cr_assert(rv == AMVP_MALFORMED_JSON);
 }
+
+/*
+ * Test amvp_verify_expected_results: hex is matched ignoring case, and
+ * a changed mac is reported
+ */
+Test(PROCESS_TESTS, verify_expected_results, .init = setup_full_ctx, .fini = teardown) {
+    int mismatches = -1;
+
+    rv = amvp_verify_expected_results(NULL, "json/rsp.json", "json/expectedResults.json", NULL);
+    cr_assert(rv == AMVP_NO_CTX);
+    rv = amvp_verify_expected_results(ctx, NULL, "json/expectedResults.json", NULL);
+    cr_assert(rv == AMVP_MISSING_ARG);
+    rv = amvp_verify_expected_results(ctx, "json/rsp.json", NULL, NULL);
+    cr_assert(rv == AMVP_MISSING_ARG);
+    rv = amvp_verify_expected_results(ctx, "json/nonexistent.json", "json/expectedResults.json", NULL);
+    cr_assert(rv == AMVP_MALFORMED_JSON);
+
+    rv = amvp_verify_expected_results(ctx, "json/rsp.json", "json/rsp.json", &mismatches);
+    cr_assert(rv == AMVP_SUCCESS);
+    cr_assert(mismatches == 0);
+    rv = amvp_verify_expected_results(ctx, "json/rsp.json", "json/expectedResults.json", &mismatches);
+    cr_assert(rv == AMVP_SUCCESS);
+    cr_assert(mismatches == 1);
+}
+
+/*
+ * The registration is only built again after a capability changes
+ */
+Test(GET_CURRENT_REGISTRATION, cached, .init = setup_full_ctx, .fini = teardown) {
+    JSON_Value *built = NULL;
+    char *reg = NULL, *reg2 = NULL;
+
+    reg = amvp_get_current_registration(ctx, NULL);
+    cr_assert_not_null(reg);
+    built = ctx->registration;
+    cr_assert_not_null(built);
+    reg2 = amvp_get_current_registration(ctx, NULL);
+    cr_assert_not_null(reg2);
+    cr_assert(ctx->registration == built);
+    cr_assert(strcmp(reg, reg2) == 0);
+    free(reg2);
+
+    rv = amvp_cap_hash_enable(ctx, AMVP_HASH_SHA256, &dummy_handler_success);
+    cr_assert(rv == AMVP_SUCCESS);
+    cr_assert(ctx->registration_dirty);
+    reg2 = amvp_get_current_registration(ctx, NULL);
+    cr_assert_not_null(reg2);
+    cr_assert(!ctx->registration_dirty);
+    cr_assert(strcmp(reg, reg2) != 0);
+    free(reg);
+    free(reg2);
+
+    /* So does changing a capability that is already enabled */
+    rv = amvp_cap_cmac_set_parm(ctx, AMVP_CMAC_AES, AMVP_CMAC_KEYLEN, 256);
+    cr_assert(rv == AMVP_SUCCESS);
+    cr_assert(ctx->registration_dirty);
+}
@@ -90,6 +90,178 @@ Test(EnableCapHash, invalid_args, .fini = teardown) {
     cr_assert(rv == AMVP_INVALID_ARG);
 }
 
+static int dummy_batch_handler(AMVP_TEST_CASE *test_cases, int count) {
+    if (!test_cases || count < 1) return 1;
+    return 0;
+}
+
+/*
+ * Registers and clears a batch handler for a hash cap
+ */
+Test(SetBatchHandler, hash, .fini = teardown) {
+    setup_empty_ctx(&ctx);
+
+    rv = amvp_cap_set_batch_handler(NULL, AMVP_HASH_SHA1, &dummy_batch_handler);
+    cr_assert(rv == AMVP_NO_CTX);
+
+    /* Cap has not been enabled yet */
+    rv = amvp_cap_set_batch_handler(ctx, AMVP_HASH_SHA1, &dummy_batch_handler);
+    cr_assert(rv == AMVP_NO_CAP);
+
+    rv = amvp_cap_hash_enable(ctx, AMVP_HASH_SHA1, &dummy_handler_success);
+    cr_assert(rv == AMVP_SUCCESS);
+
+    rv = amvp_cap_set_batch_handler(ctx, AMVP_HASH_SHA1, &dummy_batch_handler);
+    cr_assert(rv == AMVP_SUCCESS);
+
+    rv = amvp_cap_set_batch_handler(ctx, AMVP_HASH_SHA1, NULL);
+    cr_assert(rv == AMVP_SUCCESS);
+}
+
+/*
+ * Registers and clears an MCT handler for a hash cap
+ */
+Test(SetMctHandler, hash, .fini = teardown) {
+    setup_empty_ctx(&ctx);
+
+    rv = amvp_cap_set_mct_handler(NULL, AMVP_HASH_SHA1, &dummy_handler_success);
+    cr_assert(rv == AMVP_NO_CTX);
+
+    /* Cap has not been enabled yet */
+    rv = amvp_cap_set_mct_handler(ctx, AMVP_HASH_SHA1, &dummy_handler_success);
+    cr_assert(rv == AMVP_NO_CAP);
+
+    rv = amvp_cap_hash_enable(ctx, AMVP_HASH_SHA1, &dummy_handler_success);
+    cr_assert(rv == AMVP_SUCCESS);
+
+    rv = amvp_cap_set_mct_handler(ctx, AMVP_HASH_SHA1, &dummy_handler_success);
+    cr_assert(rv == AMVP_SUCCESS);
+
+    rv = amvp_cap_set_mct_handler(ctx, AMVP_HASH_SHA1, NULL);
+    cr_assert(rv == AMVP_SUCCESS);
+}
+
+static int dummy_group_init(AMVP_TEST_CASE *test_case, void **group_ctx) {
+    if (!test_case || !group_ctx) return 1;
+    *group_ctx = test_case;
+    return 0;
+}
+
+static void dummy_group_fini(void *group_ctx) {
+    (void)group_ctx;
+}
+
+/*
+ * Registers and clears group setup/teardown handlers for an ECDSA cap
+ */
+Test(SetGroupHandlers, ecdsa, .fini = teardown) {
+    setup_empty_ctx(&ctx);
+
+    rv = amvp_cap_set_group_handlers(NULL, AMVP_ECDSA_SIGGEN, &dummy_group_init, &dummy_group_fini);
+    cr_assert(rv == AMVP_NO_CTX);
+
+    /* Cap has not been enabled yet */
+    rv = amvp_cap_set_group_handlers(ctx, AMVP_ECDSA_SIGGEN, &dummy_group_init, &dummy_group_fini);
+    cr_assert(rv == AMVP_NO_CAP);
+
+    rv = amvp_cap_ecdsa_enable(ctx, AMVP_ECDSA_SIGGEN, &dummy_handler_success);
+    cr_assert(rv == AMVP_SUCCESS);
+
+    /* group_fini needs a group_init */
+    rv = amvp_cap_set_group_handlers(ctx, AMVP_ECDSA_SIGGEN, NULL, &dummy_group_fini);
+    cr_assert(rv == AMVP_INVALID_ARG);
+
+    rv = amvp_cap_set_group_handlers(ctx, AMVP_ECDSA_SIGGEN, &dummy_group_init, &dummy_group_fini);
+    cr_assert(rv == AMVP_SUCCESS);
+    rv = amvp_cap_set_group_handlers(ctx, AMVP_ECDSA_SIGGEN, &dummy_group_init, NULL);
+    cr_assert(rv == AMVP_SUCCESS);
+
+    rv = amvp_cap_set_group_handlers(ctx, AMVP_ECDSA_SIGGEN, NULL, NULL);
+    cr_assert(rv == AMVP_SUCCESS);
+}
+
+static int dummy_hash_init(AMVP_TEST_CASE *test_case, void **stream_ctx) {
+    if (!test_case || !stream_ctx) return 1;
+    *stream_ctx = test_case;
+    return 0;
+}
+
+static int dummy_hash_update(void *stream_ctx, const unsigned char *data, unsigned int len) {
+    (void)data;
+    (void)len;
+    return stream_ctx ? 0 : 1;
+}
+
+static int dummy_hash_final(void *stream_ctx, AMVP_TEST_CASE *test_case) {
+    return stream_ctx == test_case ? 0 : 1;
+}
+
+/*
+ * Registers the streaming hash handlers and LDT sizes used by the Large Data Test
+ */
+Test(SetHashStreamHandlers, sha2, .fini = teardown) {
+    setup_empty_ctx(&ctx);
+
+    rv = amvp_cap_set_hash_stream_handlers(NULL, AMVP_HASH_SHA256, &dummy_hash_init,
+                                           &dummy_hash_update, &dummy_hash_final);
+    cr_assert(rv == AMVP_NO_CTX);
+
+    /* Cap has not been enabled yet */
+    rv = amvp_cap_set_hash_stream_handlers(ctx, AMVP_HASH_SHA256, &dummy_hash_init,
+                                           &dummy_hash_update, &dummy_hash_final);
+    cr_assert(rv == AMVP_NO_CAP);
+
+    rv = amvp_cap_hash_enable(ctx, AMVP_HASH_SHA256, &dummy_handler_success);
+    cr_assert(rv == AMVP_SUCCESS);
+
+    /* All three or none */
+    rv = amvp_cap_set_hash_stream_handlers(ctx, AMVP_HASH_SHA256, &dummy_hash_init,
+                                           NULL, &dummy_hash_final);
+    cr_assert(rv == AMVP_INVALID_ARG);
+
+    rv = amvp_cap_set_hash_stream_handlers(ctx, AMVP_HASH_SHA256, &dummy_hash_init,
+                                           &dummy_hash_update, &dummy_hash_final);
+    cr_assert(rv == AMVP_SUCCESS);
+
+    rv = amvp_cap_hash_set_parm(ctx, AMVP_HASH_SHA256, AMVP_HASH_LARGE_DATA, 3);
+    cr_assert(rv == AMVP_INVALID_ARG);
+    rv = amvp_cap_hash_set_parm(ctx, AMVP_HASH_SHA256, AMVP_HASH_LARGE_DATA, 1);
+    cr_assert(rv == AMVP_SUCCESS);
+    rv = amvp_cap_hash_set_parm(ctx, AMVP_HASH_SHA256, AMVP_HASH_LARGE_DATA, 8);
+    cr_assert(rv == AMVP_SUCCESS);
+
+    /* SHAKE has no LDT */
+    rv = amvp_cap_hash_enable(ctx, AMVP_HASH_SHAKE_128, &dummy_handler_success);
+    cr_assert(rv == AMVP_SUCCESS);
+    rv = amvp_cap_set_hash_stream_handlers(ctx, AMVP_HASH_SHAKE_128, &dummy_hash_init,
+                                           &dummy_hash_update, &dummy_hash_final);
+    cr_assert(rv == AMVP_INVALID_ARG);
+    rv = amvp_cap_hash_set_parm(ctx, AMVP_HASH_SHAKE_128, AMVP_HASH_LARGE_DATA, 1);
+    cr_assert(rv == AMVP_INVALID_ARG);
+
+    rv = amvp_cap_set_hash_stream_handlers(ctx, AMVP_HASH_SHA256, NULL, NULL, NULL);
+    cr_assert(rv == AMVP_SUCCESS);
+}
+
+/*
+ * Registers an MCT handler for AES and TDES caps
+ */
+Test(SetMctHandler, sym_cipher, .fini = teardown) {
+    setup_empty_ctx(&ctx);
+
+    rv = amvp_cap_sym_cipher_enable(ctx, AMVP_AES_CBC, &dummy_handler_success);
+    cr_assert(rv == AMVP_SUCCESS);
+    rv = amvp_cap_set_mct_handler(ctx, AMVP_AES_CBC, &dummy_handler_success);
+    cr_assert(rv == AMVP_SUCCESS);
+
+    rv = amvp_cap_set_mct_handler(ctx, AMVP_TDES_CBC, &dummy_handler_success);
+    cr_assert(rv == AMVP_NO_CAP);
+    rv = amvp_cap_sym_cipher_enable(ctx, AMVP_TDES_CBC, &dummy_handler_success);
+    cr_assert(rv == AMVP_SUCCESS);
+    rv = amvp_cap_set_mct_handler(ctx, AMVP_TDES_CBC, &dummy_handler_success);
+    cr_assert(rv == AMVP_SUCCESS);
+}
+
 /*
  * Tests a good kdf108 api sequence
  */
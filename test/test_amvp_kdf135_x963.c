@@ -0,0 +1,164 @@
+/** @file */
+/*
+ * Copyright (c) 2021, Cisco Systems, Inc.
+ *
+ * Licensed under the Apache License 2.0 (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://github.com/cisco/libamvp/LICENSE
+ */
+
+
+#include "ut_common.h"
+#include "amvp/amvp_lcl.h"
+
+static AMVP_CTX *ctx = NULL;
+static AMVP_RESULT rv = 0;
+static JSON_Object *obj = NULL;
+static JSON_Value *val = NULL;
+
+/* One group of two test cases, zz is the "z" member of the second one and its comma, if any */
+#define X963_VS(hash, zz) \
+    "{\"vsId\": 1, \"algorithm\": \"kdf-components\", \"mode\": \"ansix9.63\"," \
+    " \"testGroups\": [{\"tgId\": 1, \"hashAlg\": \"" hash "\", \"fieldSize\": 256," \
+    " \"keyDataLength\": 128, \"sharedInfoLength\": 128, \"tests\": [" \
+    "{\"tcId\": 1, \"z\": \"00112233445566778899AABBCCDDEEFF00112233445566778899AABBCCDDEEFF\"," \
+    " \"sharedInfo\": \"000102030405060708090A0B0C0D0E0F\"}," \
+    "{\"tcId\": 2, " zz " \"sharedInfo\": \"0F0E0D0C0B0A09080706050403020100\"}]}]}"
+
+static void setup(void) {
+    setup_empty_ctx(&ctx);
+
+    rv = amvp_cap_kdf135_x963_enable(ctx, &dummy_handler_success);
+    cr_assert(rv == AMVP_SUCCESS);
+    rv = amvp_cap_kdf135_x963_set_parm(ctx, AMVP_KDF_X963_HASH_ALG, AMVP_SHA256);
+    cr_assert(rv == AMVP_SUCCESS);
+    rv = amvp_cap_kdf135_x963_set_parm(ctx, AMVP_KDF_X963_KEY_DATA_LEN, 128);
+    cr_assert(rv == AMVP_SUCCESS);
+    rv = amvp_cap_kdf135_x963_set_parm(ctx, AMVP_KDF_X963_FIELD_SIZE, 256);
+    cr_assert(rv == AMVP_SUCCESS);
+    rv = amvp_cap_kdf135_x963_set_parm(ctx, AMVP_KDF_X963_SHARED_INFO_LEN, 128);
+    cr_assert(rv == AMVP_SUCCESS);
+}
+
+static void teardown(void) {
+    if (ctx) teardown_ctx(&ctx);
+    ctx = NULL;
+}
+
+/*
+ * Test capabilites API.
+ */
+Test(Kdf135X963Api, null_ctx) {
+    val = json_parse_string(X963_VS("SHA2-256", "\"z\": \"AB\","));
+    obj = json_value_get_object(val);
+    cr_assert_not_null(obj);
+
+    /* Test with unregistered ctx */
+    rv = amvp_kdf135_x963_kat_handler(ctx, obj);
+    cr_assert(rv == AMVP_NO_CTX);
+    json_value_free(val);
+}
+
+/*
+ * Run a vector set through the KAT engine and check the response is
+ * built the way the hand written handler built it.
+ */
+Test(Kdf135X963Func, good, .init = setup, .fini = teardown) {
+    JSON_Value *rsp = NULL;
+    JSON_Object *vs = NULL, *group = NULL, *tc = NULL;
+    char *out = NULL, *groups = NULL, *mode = NULL;
+    int out_len = 0;
+
+    val = json_parse_string(X963_VS("SHA2-256", "\"z\": \"AB\","));
+    obj = json_value_get_object(val);
+    cr_assert_not_null(obj);
+
+    rv = amvp_kdf135_x963_kat_handler(ctx, obj);
+    cr_assert(rv == AMVP_SUCCESS);
+    rv = amvp_kat_resp_serialize(ctx, &out, &out_len);
+    cr_assert(rv == AMVP_SUCCESS);
+    cr_assert_not_null(out);
+
+    /* "mode" comes after the test groups, as it always has */
+    groups = strstr(out, "\"testGroups\"");
+    mode = strstr(out, "\"mode\"");
+    cr_assert(groups && mode && mode > groups);
+
+    rsp = json_parse_string(out);
+    vs = json_array_get_object(json_value_get_array(rsp), 0);
+    cr_assert_not_null(vs);
+    cr_assert_str_eq(json_object_get_string(vs, "mode"), "ansix9.63");
+    group = json_array_get_object(json_object_get_array(vs, "testGroups"), 0);
+    cr_assert(json_object_get_number(group, "tgId") == 1);
+    cr_assert(json_array_get_count(json_object_get_array(group, "tests")) == 2);
+    tc = json_array_get_object(json_object_get_array(group, "tests"), 1);
+    cr_assert(json_object_get_number(tc, "tcId") == 2);
+    /* keyDataLength of 128 bits */
+    cr_assert(strnlen_s(json_object_get_string(tc, "keyData"), 64) == 32);
+
+    json_value_free(rsp);
+    free(out);
+    json_value_free(val);
+}
+
+/*
+ * The value of a missing z is AMVP_INVALID_ARG, as it was before the
+ * handler used the KAT engine.
+ */
+Test(Kdf135X963Func, missing_z, .init = setup, .fini = teardown) {
+    val = json_parse_string(X963_VS("SHA2-256", ""));
+    obj = json_value_get_object(val);
+    cr_assert_not_null(obj);
+
+    rv = amvp_kdf135_x963_kat_handler(ctx, obj);
+    cr_assert(rv == AMVP_INVALID_ARG);
+    json_value_free(val);
+}
+
+/*
+ * A z longer than the handler allows.
+ */
+Test(Kdf135X963Func, z_too_long, .init = setup, .fini = teardown) {
+    JSON_Object *tc = NULL;
+    size_t len = AMVP_KDF135_X963_INPUT_MAX * 2 + 2;
+    char *z = NULL;
+
+    val = json_parse_string(X963_VS("SHA2-256", "\"z\": \"AB\","));
+    obj = json_value_get_object(val);
+    cr_assert_not_null(obj);
+    tc = json_array_get_object(json_object_get_array(
+             json_array_get_object(json_object_get_array(obj, "testGroups"), 0), "tests"), 1);
+    z = calloc(1, len + 1);
+    cr_assert_not_null(z);
+    memset(z, 'A', len);
+    json_object_set_string(tc, "z", z);
+    free(z);
+
+    rv = amvp_kdf135_x963_kat_handler(ctx, obj);
+    cr_assert(rv == AMVP_DATA_TOO_LARGE);
+    json_value_free(val);
+}
+
+/*
+ * Missing hashAlg, and one X9.63 doesn't allow.
+ */
+Test(Kdf135X963Func, bad_hash_alg, .init = setup, .fini = teardown) {
+    val = json_parse_string(X963_VS("SHA-1", "\"z\": \"AB\","));
+    obj = json_value_get_object(val);
+    cr_assert_not_null(obj);
+
+    rv = amvp_kdf135_x963_kat_handler(ctx, obj);
+    cr_assert(rv == AMVP_INVALID_ARG);
+    json_value_free(val);
+
+    val = json_parse_string(X963_VS("SHA2-256", "\"z\": \"AB\","));
+    obj = json_value_get_object(val);
+    cr_assert_not_null(obj);
+    json_object_remove(json_array_get_object(json_object_get_array(obj, "testGroups"), 0),
+                       "hashAlg");
+
+    rv = amvp_kdf135_x963_kat_handler(ctx, obj);
+    cr_assert(rv == AMVP_MISSING_ARG);
+    json_value_free(val);
+}
@@ -521,6 +521,30 @@ Test(TRANSPORT_DELETE, good, .init = test_setup_session_parameters, .fini = tear
 
 }
 
+/*
+ * The curl handle and share cache live on the ctx between requests;
+ * make sure releasing them is safe whether or not a request was made.
+ */
+Test(TRANSPORT_CLEANUP, good, .init = test_setup_session_parameters, .fini = teardown) {
+    amvp_transport_cleanup(NULL);
+
+    amvp_transport_cleanup(ctx);
+    cr_assert_null(ctx->curl_hnd);
+    cr_assert_null(ctx->curl_share);
+
+#ifdef TEST_TRANSPORT
+    rv = amvp_transport_delete(ctx, "uri");
+    cr_assert(rv == AMVP_TRANSPORT_FAIL);
+    cr_assert_not_null(ctx->curl_hnd);
+    rv = amvp_transport_delete(ctx, "uri");
+    cr_assert(rv == AMVP_TRANSPORT_FAIL);
+#endif
+
+    amvp_transport_cleanup(ctx);
+    cr_assert_null(ctx->curl_hnd);
+    cr_assert_null(ctx->curl_share);
+}
+
 #if 0 // TODO NIST does not have these enabled via API, we don't have Cisco server yet
 /*
  * missing vector set id url
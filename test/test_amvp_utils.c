@@ -33,6 +33,31 @@ Test(LogMsg, null_ctx) {
     amvp_cleanup(ctx);
 }
 
+static int log_arg_evals = 0;
+
+static const char *log_arg(void) {
+    log_arg_evals++;
+    return "test";
+}
+
+/*
+ * The logging macros shouldn't evaluate their arguments above the log level
+ */
+Test(LogMsg, level_checked) {
+    setup_empty_ctx(&ctx);
+
+    AMVP_LOG_VERBOSE("%s", log_arg());
+    cr_assert(log_arg_evals == 0);
+    cr_assert(!AMVP_LOG_ENABLED(AMVP_LOG_LVL_VERBOSE));
+
+    AMVP_LOG_STATUS("%s", log_arg());
+    cr_assert(log_arg_evals == 1);
+    cr_assert(AMVP_LOG_ENABLED(AMVP_LOG_LVL_STATUS));
+
+    amvp_free_test_session(ctx);
+    ctx = NULL;
+}
+
 /*
  * Try to pass NULL to amvp_cleanup
  */
@@ -72,6 +97,28 @@ Test(LocateCapEntry, null_ctx) {
     cr_assert_null(list);
 }
 
+/*
+ * amvp_locate_cap_entry should find enabled caps and nothing else
+ */
+Test(LocateCapEntry, enabled_caps) {
+    AMVP_CAPS_LIST *list;
+    AMVP_RESULT rv;
+
+    setup_empty_ctx(&ctx);
+    rv = amvp_cap_hash_enable(ctx, AMVP_HASH_SHA1, &dummy_handler_success);
+    cr_assert(rv == AMVP_SUCCESS);
+    rv = amvp_cap_hash_enable(ctx, AMVP_HASH_SHA256, &dummy_handler_success);
+    cr_assert(rv == AMVP_SUCCESS);
+
+    list = amvp_locate_cap_entry(ctx, AMVP_HASH_SHA256);
+    cr_assert_not_null(list);
+    cr_assert(list->cipher == AMVP_HASH_SHA256);
+    cr_assert_null(amvp_locate_cap_entry(ctx, AMVP_HASH_SHA224));
+    cr_assert_null(amvp_locate_cap_entry(ctx, AMVP_CIPHER_END));
+
+    teardown_ctx(&ctx);
+}
+
 
 Test(LookupCipherIndex, null_param) {
     AMVP_CIPHER cipher;
@@ -86,6 +133,23 @@ Test(LookupCipherIndex, null_param) {
 
 }
 
+Test(LookupCipherWModeIndex, null_param) {
+    AMVP_CIPHER cipher;
+    cipher = amvp_lookup_cipher_w_mode_index(AMVP_ALG_ECDSA, NULL);
+    cr_assert(cipher == AMVP_CIPHER_START);
+
+    cipher = amvp_lookup_cipher_w_mode_index(AMVP_ALG_ECDSA, "Bad Mode");
+    cr_assert(cipher == AMVP_CIPHER_START);
+
+    cipher = amvp_lookup_cipher_w_mode_index(AMVP_ALG_ECDSA, AMVP_MODE_SIGGEN);
+    cr_assert(cipher == AMVP_ECDSA_SIGGEN);
+
+    /* Without a mode the first entry for the name is used */
+    cr_assert(amvp_lookup_alg_tbl_index(AMVP_ALG_ECDSA, NULL) ==
+              amvp_lookup_alg_tbl_index(AMVP_ALG_ECDSA, AMVP_MODE_KEYGEN));
+    cr_assert(amvp_lookup_alg_tbl_index("Bad Name", NULL) == -1);
+}
+
 Test(LookupRSARandPQIndex, null_param) {
     int rv = amvp_lookup_rsa_randpq_index(NULL);
     cr_assert(!rv);
@@ -125,6 +189,31 @@ Test(JsonSerializeToFilePrettyA, null_param) {
     json_value_free(value);
 }
 
+/*
+ * With amvp_set_json_compact() files are written without indentation
+ */
+Test(JsonSerializeToFileW, compact) {
+    JSON_Value *value = json_parse_string("{\"a\": [1, 2]}");
+    char buf[64] = {0};
+    FILE *fp = NULL;
+
+    setup_empty_ctx(&ctx);
+    cr_assert(amvp_set_json_compact(ctx, 1) == AMVP_SUCCESS);
+    cr_assert(amvp_json_serialize_to_file_w(ctx, value, "test_compact.json") == AMVP_SUCCESS);
+    cr_assert(amvp_json_serialize_to_file_a(ctx, value, "test_compact.json") == AMVP_SUCCESS);
+    cr_assert(amvp_json_serialize_to_file_a(ctx, NULL, "test_compact.json") == AMVP_SUCCESS);
+
+    fp = fopen("test_compact.json", "r");
+    cr_assert_not_null(fp);
+    cr_assert_not_null(fgets(buf, sizeof(buf), fp));
+    fclose(fp);
+    cr_assert_str_eq(buf, "[ {\"a\":[1,2]}, {\"a\":[1,2]} ]");
+
+    remove("test_compact.json");
+    json_value_free(value);
+    amvp_cleanup(ctx);
+}
+
 /*
  * Exercise string_fits logic
  */
@@ -225,3 +314,477 @@ Test(GetObjFromRsp, null_ctx) {
     amvp_free_test_session(ctx);
 }
 
+
+/*
+ * Exercise the test case arena: zeroed memory, growth past one block,
+ * hex sizing, and that reset merges the blocks back into one
+ */
+Test(Arena, alloc_reset) {
+    AMVP_ARENA arena = { 0 };
+    unsigned char *buf = NULL;
+    int i;
+
+    cr_assert(amvp_arena_alloc(NULL, 16) == NULL);
+    cr_assert(amvp_arena_alloc(&arena, 0) == NULL);
+
+    for (i = 0; i < 4; i++) {
+        buf = amvp_arena_alloc(&arena, AMVP_ARENA_BLOCK_SIZE / 2 + 1);
+        cr_assert(buf != NULL);
+        cr_assert(buf[0] == 0 && buf[AMVP_ARENA_BLOCK_SIZE / 2] == 0);
+        memset(buf, 0xAA, AMVP_ARENA_BLOCK_SIZE / 2 + 1);
+    }
+    cr_assert(arena.blocks->next != NULL);
+
+    amvp_arena_reset(&arena);
+    cr_assert(arena.blocks != NULL);
+    cr_assert(arena.blocks->next == NULL);
+    buf = amvp_arena_alloc(&arena, 32);
+    cr_assert(buf[0] == 0 && buf[31] == 0);
+
+    buf = amvp_arena_alloc_hex(&arena, "00112233", 1, 16);
+    cr_assert(amvp_hexstr_to_bin("00112233", buf, 16, NULL) == AMVP_SUCCESS);
+    cr_assert(buf[3] == 0x33);
+
+    /* Too long for max_len is still rejected by the hex conversion */
+    buf = amvp_arena_alloc_hex(&arena, "0011223344", 1, 4);
+    cr_assert(buf != NULL);
+    cr_assert(amvp_hexstr_to_bin("0011223344", buf, 4, NULL) == AMVP_DATA_TOO_LARGE);
+
+    amvp_arena_free(&arena);
+    cr_assert(arena.blocks == NULL);
+}
+
+/*
+ * Round trip through the hex codec, long enough to cover the vector
+ * paths and their scalar tails, plus odd length input
+ */
+Test(HexCodec, round_trip) {
+    unsigned char bin[37], out[37];
+    char hex[75];
+    int i, len = 0;
+
+    for (i = 0; i < (int)sizeof(bin); i++) {
+        bin[i] = (unsigned char)(i * 73 + 5);
+    }
+    cr_assert(amvp_bin_to_hexstr(bin, sizeof(bin), hex, sizeof(hex)) == AMVP_SUCCESS);
+    cr_assert(strnlen_s(hex, sizeof(hex)) == 2 * sizeof(bin));
+    cr_assert(amvp_bin_to_hexstr(bin, sizeof(bin), hex, 2 * sizeof(bin) - 1) == AMVP_CONVERT_DATA_ERR);
+
+    cr_assert(amvp_hexstr_to_bin(hex, out, sizeof(out), &len) == AMVP_SUCCESS);
+    cr_assert(len == sizeof(bin));
+    cr_assert(!memcmp(bin, out, sizeof(bin)));
+
+    cr_assert(amvp_hexstr_to_bin("abC", out, 2, &len) == AMVP_SUCCESS);
+    cr_assert(len == 2);
+    cr_assert(out[0] == 0x0a && out[1] == 0xbc);
+    cr_assert(amvp_hexstr_to_bin("abC", out, 1, &len) == AMVP_DATA_TOO_LARGE);
+}
+
+/*
+ * Views of vector set strings decode in place, into the arena, and hex
+ * written back into a response tree round trips
+ */
+Test(StrView, decode_and_set_hex) {
+    AMVP_ARENA arena = { 0 };
+    JSON_Value *val = json_parse_string("{\"msg\":\"0a1B2c3\",\"n\":1}");
+    JSON_Object *obj = json_value_get_object(val);
+    AMVP_STR_VIEW view;
+    unsigned char out[4], *buf = NULL;
+    int len = 0;
+
+    view = amvp_json_view(obj, "msg");
+    cr_assert(view.str != NULL && view.len == 7);
+    cr_assert(amvp_view_to_bin(view, out, sizeof(out), &len) == AMVP_SUCCESS);
+    cr_assert(len == 4);
+    cr_assert(out[0] == 0x00 && out[1] == 0xa1 && out[2] == 0xb2 && out[3] == 0xc3);
+    cr_assert(amvp_view_to_bin(view, out, 3, &len) == AMVP_DATA_TOO_LARGE);
+
+    /* Missing members and non-strings give an empty view */
+    cr_assert(amvp_json_view(obj, "n").str == NULL);
+    cr_assert(amvp_json_view(obj, "none").str == NULL);
+
+    cr_assert(amvp_arena_decode_hex(&arena, view, 1, 8, &buf, &len) == AMVP_SUCCESS);
+    cr_assert(buf != NULL && len == 4 && buf[3] == 0xc3);
+    cr_assert(amvp_arena_decode_hex(&arena, view, 1, 3, &buf, &len) == AMVP_DATA_TOO_LARGE);
+    view = amvp_json_view(obj, "none");
+    cr_assert(amvp_arena_decode_hex(&arena, view, 16, 32, &buf, &len) == AMVP_SUCCESS);
+    cr_assert(buf != NULL && len == 0 && buf[15] == 0);
+
+    cr_assert(amvp_json_set_hex(obj, "md", out, 4) == AMVP_SUCCESS);
+    view = amvp_json_view(obj, "md");
+    cr_assert(view.len == 8);
+    cr_assert(amvp_view_to_bin(view, buf, 16, &len) == AMVP_SUCCESS);
+    cr_assert(len == 4 && !memcmp(buf, out, 4));
+    cr_assert(amvp_json_set_hex(obj, "empty", NULL, 0) == AMVP_SUCCESS);
+    cr_assert(json_object_get_string_len(obj, "empty") == 0);
+
+    amvp_arena_free(&arena);
+    json_value_free(val);
+}
+
+/*
+ * The JSON writer should produce compact output that parson reads back
+ */
+Test(JsonWriter, basic) {
+    AMVP_JSON_WRITER w;
+    JSON_Value *val = NULL, *nested = NULL;
+    JSON_Object *obj = NULL;
+    unsigned char bin[3] = { 0x01, 0xab, 0xff };
+    char *out = NULL;
+    int len = 0;
+
+    memzero_s(&w, sizeof(w));
+    nested = json_parse_string("{\"a\":[1,2]}");
+    cr_assert_not_null(nested);
+
+    amvp_jw_begin_object(&w, NULL);
+    amvp_jw_number(&w, "tcId", 5);
+    amvp_jw_string(&w, "s", "x\"y/z");
+    amvp_jw_hex(&w, "md", bin, sizeof(bin));
+    amvp_jw_bool(&w, "ok", 1);
+    amvp_jw_value(&w, "tree", nested);
+    cr_assert(amvp_jw_end_object(&w) == AMVP_SUCCESS);
+    cr_assert_str_eq(w.buf, "{\"tcId\":5,\"s\":\"x\\\"y\\/z\",\"md\":\"01ABFF\",\"ok\":true,\"tree\":{\"a\":[1,2]}}");
+
+    out = amvp_jw_detach(&w, &len);
+    cr_assert_not_null(out);
+    cr_assert(len == (int)strnlen_s(out, 1024));
+    val = json_parse_string(out);
+    obj = json_value_get_object(val);
+    cr_assert(json_object_get_number(obj, "tcId") == 5);
+    cr_assert_str_eq(json_object_get_string(obj, "md"), "01ABFF");
+    free(out);
+    json_value_free(val);
+
+    /* Unbalanced output can't be detached, and errors stick until reset */
+    amvp_jw_begin_array(&w, NULL);
+    cr_assert_null(amvp_jw_detach(&w, NULL));
+    amvp_jw_end_array(&w);
+    cr_assert(amvp_jw_end_array(&w) == AMVP_JSON_ERR);
+    cr_assert(amvp_jw_number(&w, NULL, 1) == AMVP_JSON_ERR);
+    amvp_jw_reset(&w);
+    cr_assert(amvp_jw_number(&w, NULL, 1) == AMVP_SUCCESS);
+
+    json_value_free(nested);
+    amvp_jw_free(&w);
+}
+
+/*
+ * With spill_at set, completed output moves to a temp file and reads
+ * back the same as output that stayed in memory
+ */
+Test(JsonWriter, spill) {
+    AMVP_JSON_WRITER w, ref;
+    unsigned char bin[32];
+    char *out = NULL, *ref_out = NULL;
+    char head[8];
+    int len = 0, ref_len = 0, i = 0;
+
+    memzero_s(&w, sizeof(w));
+    memzero_s(&ref, sizeof(ref));
+    memset(bin, 0x5a, sizeof(bin));
+    w.spill_at = 256;
+
+    amvp_jw_begin_array(&w, NULL);
+    amvp_jw_begin_array(&ref, NULL);
+    for (i = 0; i < 100; i++) {
+        amvp_jw_begin_object(&w, NULL);
+        amvp_jw_number(&w, "tcId", i);
+        amvp_jw_hex(&w, "md", bin, sizeof(bin));
+        amvp_jw_end_object(&w);
+        amvp_jw_begin_object(&ref, NULL);
+        amvp_jw_number(&ref, "tcId", i);
+        amvp_jw_hex(&ref, "md", bin, sizeof(bin));
+        amvp_jw_end_object(&ref);
+    }
+    cr_assert(amvp_jw_end_array(&w) == AMVP_SUCCESS);
+    amvp_jw_end_array(&ref);
+    cr_assert(w.spilled > 0);
+    cr_assert(w.len < 256 + 100);
+    cr_assert(w.spilled + w.len == ref.len);
+
+    cr_assert(amvp_jw_read_at(&w, 0, head, sizeof(head)) == sizeof(head));
+    cr_assert(memcmp(head, ref.buf, sizeof(head)) == 0);
+    cr_assert(amvp_jw_read_at(&w, ref.len, head, sizeof(head)) == 0);
+
+    out = amvp_jw_detach(&w, &len);
+    ref_out = amvp_jw_detach(&ref, &ref_len);
+    cr_assert_not_null(out);
+    cr_assert(len == ref_len);
+    cr_assert(memcmp(out, ref_out, len) == 0);
+    cr_assert(w.spilled == 0);
+
+    free(out);
+    free(ref_out);
+    amvp_jw_free(&w);
+    amvp_jw_free(&ref);
+}
+
+/*
+ * A file is base64 encoded into the output as it is read, spilling part
+ * way through the string if need be
+ */
+Test(JsonWriter, base64_file) {
+    AMVP_JSON_WRITER w;
+    FILE *fp = NULL;
+    char *out = NULL;
+    int len = 0, i = 0;
+
+    memzero_s(&w, sizeof(w));
+    fp = tmpfile();
+    cr_assert_not_null(fp);
+    fputs("ab", fp);
+    rewind(fp);
+    amvp_jw_begin_array(&w, NULL);
+    cr_assert(amvp_jw_base64_file(&w, NULL, fp) == AMVP_SUCCESS);
+    amvp_jw_end_array(&w);
+    cr_assert_str_eq(w.buf, "[\"YWI=\"]");
+
+    /* 3000 bytes of "abc" encode to 1000 "YWJj" */
+    amvp_jw_reset(&w);
+    w.spill_at = 256;
+    rewind(fp);
+    for (i = 0; i < 1000; i++) {
+        fputs("abc", fp);
+    }
+    rewind(fp);
+    amvp_jw_begin_object(&w, NULL);
+    cr_assert(amvp_jw_base64_file(&w, "TE01", fp) == AMVP_SUCCESS);
+    cr_assert(amvp_jw_end_object(&w) == AMVP_SUCCESS);
+    cr_assert(w.spilled > 0);
+    out = amvp_jw_detach(&w, &len);
+    cr_assert_not_null(out);
+    cr_assert(len == 4000 + 11);
+    cr_assert(strncmp(out, "{\"TE01\":\"YWJjYWJj", 16) == 0);
+    cr_assert_str_eq(out + len - 6, "YWJj\"}");
+    free(out);
+
+    fclose(fp);
+    amvp_jw_free(&w);
+}
+
+/*
+ * The file reader should hand back each top level element in turn
+ */
+Test(JsonFileReader, elements) {
+    AMVP_JSON_FILE_READER rdr;
+    JSON_Value *val = NULL;
+    const char *fname = "test_json_reader.json";
+    FILE *fp = NULL;
+
+    fp = fopen(fname, "w");
+    cr_assert_not_null(fp);
+    fputs(" [ {\"a\":\"x]}\\\"[\"}, [1, {\"b\": 2}] ,\n\"s,t\" ]\n", fp);
+    fclose(fp);
+
+    cr_assert(amvp_json_reader_open(&rdr, fname) == AMVP_SUCCESS);
+    cr_assert(amvp_json_reader_next(&rdr, &val) == AMVP_SUCCESS);
+    cr_assert_str_eq(json_object_get_string(json_value_get_object(val), "a"), "x]}\"[");
+    json_value_free(val);
+
+    cr_assert(amvp_json_reader_next(&rdr, &val) == AMVP_SUCCESS);
+    cr_assert(json_array_get_count(json_value_get_array(val)) == 2);
+    json_value_free(val);
+
+    cr_assert(amvp_json_reader_next(&rdr, &val) == AMVP_SUCCESS);
+    cr_assert_str_eq(json_value_get_string(val), "s,t");
+    json_value_free(val);
+
+    cr_assert(amvp_json_reader_next(&rdr, &val) == AMVP_SUCCESS);
+    cr_assert_null(val);
+    amvp_json_reader_close(&rdr);
+
+    fp = fopen(fname, "w");
+    cr_assert_not_null(fp);
+    fputs("[ {\"a\": 1} {\"b\": 2} ]", fp);
+    fclose(fp);
+
+    cr_assert(amvp_json_reader_open(&rdr, fname) == AMVP_SUCCESS);
+    cr_assert(amvp_json_reader_next(&rdr, &val) == AMVP_SUCCESS);
+    json_value_free(val);
+    cr_assert(amvp_json_reader_next(&rdr, &val) == AMVP_MALFORMED_JSON);
+    amvp_json_reader_close(&rdr);
+    remove(fname);
+}
+
+/*
+ * Trees parsed inside amvp_json_arena_begin/end come from the context's
+ * arena, while values made before it are still freed normally.
+ */
+Test(JsonArena, begin_end) {
+    AMVP_CTX *arena_ctx = calloc(1, sizeof(AMVP_CTX));
+    JSON_Value *before = NULL, *val = NULL;
+
+    cr_assert_not_null(arena_ctx);
+    cr_assert(amvp_set_json_arena(arena_ctx, 1) == AMVP_SUCCESS);
+    before = json_parse_string("{\"k\": [1, 2, 3]}");
+    cr_assert_not_null(before);
+
+    amvp_json_arena_begin(arena_ctx);
+    cr_assert(arena_ctx->json_arena_active);
+    val = json_parse_string("{\"tcId\": 5, \"msg\": \"00ff\"}");
+    cr_assert_not_null(val);
+    cr_assert_not_null(arena_ctx->json_arena.blocks);
+    cr_assert_str_eq(json_object_get_string(json_value_get_object(val), "msg"), "00ff");
+    json_value_free(before);
+    amvp_json_arena_end(arena_ctx, &val);
+    cr_assert_null(val);
+    cr_assert(!arena_ctx->json_arena_active);
+
+    /* Back on malloc/free */
+    val = json_parse_string("[true]");
+    cr_assert_not_null(val);
+    json_value_free(val);
+
+    amvp_arena_free(&arena_ctx->json_arena);
+    free(arena_ctx);
+}
+
+/*
+ * Objects large enough to get a hash index must still find every member
+ * after removals and overwrites, by name or by precomputed key.
+ */
+Test(JsonObjectIndex, lookup) {
+    JSON_Value *val = json_value_init_object();
+    JSON_Object *obj = json_value_get_object(val);
+    JSON_Key key;
+    char name[16];
+    int i;
+
+    cr_assert_not_null(obj);
+    for (i = 0; i < 64; i++) {
+        snprintf(name, sizeof(name), "k%d", i);
+        cr_assert(json_object_set_number(obj, name, i) == JSONSuccess);
+    }
+    for (i = 0; i < 64; i += 2) {
+        snprintf(name, sizeof(name), "k%d", i);
+        cr_assert(json_object_remove(obj, name) == JSONSuccess);
+    }
+    for (i = 0; i < 64; i++) {
+        snprintf(name, sizeof(name), "k%d", i);
+        json_key_init(&key, name);
+        if (i % 2) {
+            cr_assert(json_object_get_number(obj, name) == i);
+            cr_assert(json_object_get_number_key(obj, &key) == i);
+        } else {
+            cr_assert_null(json_object_get_value_key(obj, &key));
+        }
+    }
+    snprintf(name, sizeof(name), "k%d", 7);
+    cr_assert(json_object_set_string(obj, name, "seven") == JSONSuccess);
+    json_key_init(&key, name);
+    cr_assert_str_eq(json_object_get_string_key(obj, &key), "seven");
+    json_value_free(val);
+}
+
+/*
+ * Parsing in place must give the same strings as a copying parse, with
+ * escapes processed, and leave them pointing into the parsed buffer
+ */
+Test(JsonParse, in_place) {
+    const char *json = "{\"tcId\":1,\"pt\":\"00112233445566778899aabbccddeeff0011\","
+                       "\"e\\u0041\":\"a\\tb\\u00e9\",\"x\":\"\"}";
+    char buf[128];
+    JSON_Value *copy = NULL, *val = NULL;
+    JSON_Object *obj = NULL;
+    const char *pt = NULL;
+
+    strcpy_s(buf, sizeof(buf), json);
+    copy = json_parse_string(json);
+    val = json_parse_string_in_place(buf);
+    cr_assert_not_null(copy);
+    cr_assert_not_null(val);
+    obj = json_value_get_object(val);
+    pt = json_object_get_string(obj, "pt");
+    cr_assert_str_eq(pt, json_object_get_string(json_value_get_object(copy), "pt"));
+    cr_assert(pt > buf && pt < buf + sizeof(buf));
+    cr_assert_str_eq(json_object_get_string(obj, "eA"), "a\tb\xc3\xa9");
+    cr_assert_str_eq(json_object_get_string(obj, "x"), "");
+    cr_assert(json_object_set_string(obj, "pt", "ff") == JSONSuccess);
+    json_value_free(val);
+    json_value_free(copy);
+
+    strcpy_s(buf, sizeof(buf), "[\"0011\x01\"]");
+    cr_assert_null(json_parse_string_in_place(buf));
+    strcpy_s(buf, sizeof(buf), "[\"00112233445566778899aabbccddeeff");
+    cr_assert_null(json_parse_string_in_place(buf));
+}
+
+/*
+ * Exercise amvp_str_set_add, amvp_str_set_has and amvp_str_set_free,
+ * across enough adds to grow the set
+ */
+Test(StrSet, add_has) {
+    AMVP_STR_SET set = { NULL, 0, 0 };
+    char url[64];
+    int i;
+
+    cr_assert(amvp_str_set_has(&set, "none") == 0);
+    for (i = 0; i < 100; i++) {
+        snprintf(url, sizeof(url), "/amvp/v1/testSessions/1/vectorSets/%d", i);
+        cr_assert(amvp_str_set_add(&set, url) == 1);
+    }
+    for (i = 0; i < 100; i += 3) {
+        snprintf(url, sizeof(url), "/amvp/v1/testSessions/1/vectorSets/%d", i);
+        cr_assert(amvp_str_set_add(&set, url) == 0);
+    }
+    cr_assert(set.count == 100);
+    for (i = 0; i < 200; i++) {
+        snprintf(url, sizeof(url), "/amvp/v1/testSessions/1/vectorSets/%d", i);
+        cr_assert(amvp_str_set_has(&set, url) == (i < 100));
+    }
+    cr_assert(amvp_str_set_add(&set, NULL) == -1);
+    amvp_str_set_free(&set);
+    cr_assert(amvp_str_set_has(&set, "/amvp/v1/testSessions/1/vectorSets/0") == 0);
+    amvp_str_set_free(&set);
+}
+
+/*
+ * Exercise amvp_value_set_add, amvp_value_set_has and amvp_value_set_next
+ * with values in the bitmap and in merged ranges above it
+ */
+Test(ValueSet, add_has_next) {
+    AMVP_ARENA arena = { NULL };
+    AMVP_VALUE_SET set;
+    int expect[] = { 0, 8, 128, 511, 512, 513, 514, 1024, 4096, 65536 };
+    int i, v = -1;
+
+    memzero_s(&set, sizeof(set));
+    cr_assert(amvp_value_set_next(&set, &v) == 0);
+    for (i = (int)(sizeof(expect) / sizeof(expect[0])) - 1; i >= 0; i--) {
+        cr_assert(amvp_value_set_add(&arena, &set, expect[i]) == AMVP_SUCCESS);
+    }
+    cr_assert(amvp_value_set_add(&arena, &set, 128) == AMVP_SUCCESS);
+    cr_assert(amvp_value_set_add(&arena, &set, 513) == AMVP_SUCCESS);
+    cr_assert(amvp_value_set_add(&arena, &set, -1) == AMVP_INVALID_ARG);
+    cr_assert(amvp_value_set_add(NULL, &set, 8) == AMVP_NO_DATA);
+    cr_assert(set.count == 10);
+    /* 512, 513 and 514 are one range */
+    cr_assert(set.range_cnt == 4);
+    cr_assert(amvp_value_set_has(&set, 4096) == 1);
+    cr_assert(amvp_value_set_has(&set, 4095) == 0);
+    cr_assert(amvp_value_set_has(&set, 7) == 0);
+
+    v = -1;
+    for (i = 0; amvp_value_set_next(&set, &v); i++) {
+        cr_assert(v == expect[i]);
+    }
+    cr_assert(i == 10);
+    amvp_arena_free(&arena);
+}
+
+/*
+ * Read exp and iat out of a JWT payload
+ */
+Test(JwtExpiry, exp_iat) {
+    time_t iat = 0;
+
+    cr_assert(amvp_jwt_expiry("e30.eyJleHAiOjIwMDAwMDAwMDAsImlhdCI6MTk5OTk5OTAwMH0.sig", &iat) == 2000000000);
+    cr_assert(iat == 1999999000);
+    /* {} has neither */
+    cr_assert(amvp_jwt_expiry("e30.e30.sig", &iat) == 0);
+    cr_assert(iat == 0);
+    cr_assert(amvp_jwt_expiry("not-a-jwt", NULL) == 0);
+    cr_assert(amvp_jwt_expiry("e30.e$0.sig", NULL) == 0);
+    cr_assert(amvp_jwt_expiry(NULL, &iat) == 0);
+}